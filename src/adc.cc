@@ -24,8 +24,15 @@
 
 #include "adc.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
 
 #include "common/logging.h"
 
@@ -54,3 +61,99 @@ int arc_read_raw(int chan) {
 
   return atoi(buf);
 }
+
+AdcSampler::AdcSampler(unsigned channel_mask, int period_ms,
+                       const char *device_dir)
+  : channel_mask_(channel_mask), period_ms_(period_ms),
+    device_dir_(device_dir) {
+  for (Channel &c : channels_) {
+    c.last_sample = -1;
+    c.filtered = -1;
+  }
+}
+
+AdcSampler::~AdcSampler() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      stop_ = true;
+    }
+    stop_condition_.notify_all();
+    thread_.join();
+  }
+  for (Channel &c : channels_) {
+    if (c.fd >= 0) close(c.fd);
+  }
+}
+
+bool AdcSampler::OpenChannels() {
+  for (int chan = 0; chan < NUM_CHANNELS; ++chan) {
+    if (!(channel_mask_ & (1 << chan)) || channels_[chan].fd >= 0)
+      continue;
+    char node[256];
+    snprintf(node, sizeof(node), "%s/in_voltage%d_raw",
+             device_dir_.c_str(), chan);
+    channels_[chan].fd = open(node, O_RDONLY);
+    if (channels_[chan].fd < 0) {
+      Log_error("AdcSampler: unable to open %s: %s", node, strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AdcSampler::Start() {
+  if (!OpenChannels())
+    return false;
+  thread_ = std::thread(&AdcSampler::Run, this);
+  return true;
+}
+
+int AdcSampler::Value(int chan) const {
+  if (chan < 0 || chan >= NUM_CHANNELS) return -1;
+  return channels_[chan].filtered.load(std::memory_order_relaxed);
+}
+
+int AdcSampler::LastSample(int chan) const {
+  if (chan < 0 || chan >= NUM_CHANNELS) return -1;
+  return channels_[chan].last_sample.load(std::memory_order_relaxed);
+}
+
+bool AdcSampler::SampleOnce() {
+  if (!OpenChannels())
+    return false;
+  bool success = true;
+  for (Channel &c : channels_) {
+    if (c.fd < 0) continue;
+    // sysfs attributes provide a fresh value when read from the start.
+    char buf[32];
+    const ssize_t r = pread(c.fd, buf, sizeof(buf) - 1, 0);
+    if (r <= 0) {
+      success = false;
+      continue;
+    }
+    buf[r] = '\0';
+    const int value = atoi(buf);
+    c.ring[c.ring_pos] = value;
+    c.ring_pos = (c.ring_pos + 1) % FILTER_SAMPLES;
+    if (c.count < FILTER_SAMPLES) ++c.count;
+
+    int sorted[FILTER_SAMPLES];
+    std::copy(c.ring, c.ring + c.count, sorted);
+    std::nth_element(sorted, sorted + c.count / 2, sorted + c.count);
+    c.last_sample.store(value, std::memory_order_relaxed);
+    c.filtered.store(sorted[c.count / 2], std::memory_order_relaxed);
+  }
+  return success;
+}
+
+void AdcSampler::Run() {
+  std::unique_lock<std::mutex> l(mutex_);
+  while (!stop_) {
+    l.unlock();
+    SampleOnce();
+    l.lock();
+    stop_condition_.wait_for(l, std::chrono::milliseconds(period_ms_),
+                             [this]() { return stop_; });
+  }
+}
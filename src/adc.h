@@ -20,6 +20,75 @@
 #ifndef BEAGLEG_ADC_
 #define BEAGLEG_ADC_
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Read a single value of ADC channel "chan" (0..7) directly from sysfs.
+// Blocks for the time the ADC needs, so better not used while moving; see
+// AdcSampler.
 int arc_read_raw(int chan);
 
+// Samples ADC channels in a background thread, so that reading them, such
+// as for temperature control, does not stall feeding the motion queue.
+//
+// The sysfs files are opened once and re-read for every sample. For each
+// channel, a ring of the last samples is kept; the median of these is
+// available as filtered value. Values can be read from any thread
+// without locking.
+class AdcSampler {
+public:
+  enum {
+    NUM_CHANNELS = 8,
+    FILTER_SAMPLES = 8,   // Number of recent samples the median is taken of.
+  };
+
+  // Sample the channels with a bit set in "channel_mask" every "period_ms".
+  // "device_dir" is the iio device in sysfs; replaceable for testing.
+  AdcSampler(unsigned channel_mask, int period_ms,
+             const char *device_dir = "/sys/bus/iio/devices/iio:device0");
+  ~AdcSampler();
+
+  // Open the channels and start the sampling thread. Returns false if any
+  // of them could not be opened.
+  bool Start();
+
+  // Filtered value of the recent samples of "chan" or -1 if there is no
+  // sample yet.
+  int Value(int chan) const;
+
+  // The last sample of "chan" or -1 if none yet.
+  int LastSample(int chan) const;
+
+  // Sample all channels once. Called by the sampling thread; directly
+  // callable if not Start()-ed, e.g. in tests. Returns false if reading any
+  // of the channels failed.
+  bool SampleOnce();
+
+private:
+  struct Channel {
+    int fd = -1;
+    int ring[FILTER_SAMPLES];
+    int ring_pos = 0;
+    int count = 0;
+    std::atomic<int> last_sample;
+    std::atomic<int> filtered;
+  };
+
+  bool OpenChannels();
+  void Run();
+
+  const unsigned channel_mask_;
+  const int period_ms_;
+  const std::string device_dir_;
+  Channel channels_[NUM_CHANNELS];
+
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
 #endif  // BEAGLEG_ADC_
@@ -0,0 +1,92 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the background ADC sampler.
+ */
+#include "adc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+namespace {
+// A directory that looks like the iio device in sysfs.
+class FakeAdcDevice {
+public:
+  FakeAdcDevice() {
+    char tmpl[] = "/tmp/adc-test.XXXXXX";
+    dir_ = mkdtemp(tmpl);
+  }
+  ~FakeAdcDevice() {
+    for (int chan : written_) unlink(Node(chan).c_str());
+    rmdir(dir_.c_str());
+  }
+
+  // Overwrite in place, like sysfs, so that open file descriptors see it.
+  void Set(int chan, int value) {
+    FILE *f = fopen(Node(chan).c_str(), written_.count(chan) ? "r+" : "w");
+    fprintf(f, "%-8d\n", value);
+    fclose(f);
+    written_.insert(chan);
+  }
+
+  const char *dir() const { return dir_.c_str(); }
+
+private:
+  std::string Node(int chan) const {
+    return dir_ + "/in_voltage" + std::to_string(chan) + "_raw";
+  }
+
+  std::string dir_;
+  std::set<int> written_;
+};
+}  // namespace
+
+TEST(AdcSampler, MedianOfRecentSamples) {
+  FakeAdcDevice device;
+  device.Set(2, 1000);
+  AdcSampler sampler(1 << 2, 10, device.dir());
+  EXPECT_EQ(-1, sampler.Value(2));
+  EXPECT_TRUE(sampler.SampleOnce());
+  EXPECT_EQ(1000, sampler.Value(2));
+  EXPECT_EQ(-1, sampler.Value(1));  // Not sampled.
+
+  device.Set(2, 4000);              // One outlier does not count ..
+  EXPECT_TRUE(sampler.SampleOnce());
+  EXPECT_EQ(4000, sampler.LastSample(2));
+  device.Set(2, 1010);
+  EXPECT_TRUE(sampler.SampleOnce());
+  EXPECT_EQ(1010, sampler.Value(2));
+
+  for (int i = 0; i < AdcSampler::FILTER_SAMPLES; ++i) {
+    device.Set(2, 2000);            // .. but a lasting change does.
+    EXPECT_TRUE(sampler.SampleOnce());
+  }
+  EXPECT_EQ(2000, sampler.Value(2));
+}
+
+TEST(AdcSampler, SamplesInBackground) {
+  FakeAdcDevice device;
+  device.Set(0, 42);
+  AdcSampler sampler(1 << 0, 1, device.dir());
+  ASSERT_TRUE(sampler.Start());
+  for (int i = 0; i < 1000 && sampler.Value(0) < 0; ++i) usleep(1000);
+  EXPECT_EQ(42, sampler.Value(0));
+}
+
+TEST(AdcSampler, MissingChannelFailsStart) {
+  FakeAdcDevice device;
+  AdcSampler sampler(1 << 3, 10, device.dir());
+  EXPECT_FALSE(sampler.Start());
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
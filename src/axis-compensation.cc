@@ -0,0 +1,63 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "axis-compensation.h"
+
+#include <cmath>
+
+AxisCompensation::AxisCompensation() : backlash_steps_(0), spacing_steps_(0) {}
+
+AxisCompensation::AxisCompensation(float steps_per_mm, float backlash_mm,
+                                   float spacing_mm,
+                                   const std::vector<float> &error_mm)
+  : backlash_steps_(std::lround(backlash_mm * steps_per_mm)),
+    spacing_steps_(spacing_mm * steps_per_mm) {
+  if (error_mm.empty() || spacing_steps_ <= 0) return;
+  // The motors have to go the other way of the error.
+  for (float e : error_mm) {
+    table_.push_back(-e * steps_per_mm);
+  }
+  for (size_t i = 0; i + 1 < table_.size(); ++i) {
+    slope_.push_back((table_[i+1] - table_[i]) / spacing_steps_);
+  }
+}
+
+double AxisCompensation::Correction(double position) const {
+  if (table_.empty()) return 0;
+  if (position <= 0) return table_.front();
+  const size_t i = (size_t) (position / spacing_steps_);
+  if (i >= slope_.size()) return table_.back();
+  return table_[i] + slope_[i] * (position - i * spacing_steps_);
+}
+
+int AxisCompensation::MotorPosition(int position, int direction) const {
+  const int play = direction < 0 ? backlash_steps_ : 0;
+  return std::lround(position + Correction(position)) - play;
+}
+
+int AxisCompensation::AxisPosition(int motor_position, int direction) const {
+  const double p = motor_position + (direction < 0 ? backlash_steps_ : 0);
+  // The correction changes slowly with the position, so a few fixed point
+  // iterations get within rounding.
+  double result = p;
+  for (int i = 0; i < 3; ++i) {
+    result = p - Correction(result);
+  }
+  return std::lround(result);
+}
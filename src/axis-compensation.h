@@ -0,0 +1,63 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_AXIS_COMPENSATION_H_
+#define _BEAGLEG_AXIS_COMPENSATION_H_
+
+#include <vector>
+
+// Mechanical compensation of one axis: the backlash taken up when the axis
+// reverses, and the position error measured along the axis (e.g. the pitch
+// error of a lead screw). Maps the position the planner wants the axis at to
+// the position the motors have to go to; everything in steps.
+//
+// The error table is converted to steps on construction, so that a lookup
+// is a constant time linear interpolation.
+class AxisCompensation {
+public:
+  // No compensation.
+  AxisCompensation();
+
+  // "backlash_mm": play of the axis. "error_mm": the error (actual minus
+  // commanded position) measured at 0, spacing_mm, 2*spacing_mm, ...;
+  // outside the table, the first or last value applies.
+  AxisCompensation(float steps_per_mm, float backlash_mm,
+                   float spacing_mm, const std::vector<float> &error_mm);
+
+  bool enabled() const { return backlash_steps_ != 0 || !table_.empty(); }
+
+  // Motor position for the axis at planned "position", having last moved
+  // in "direction" (negative, zero for unknown or positive). Moving in
+  // negative direction, the motors stay behind by the backlash.
+  int MotorPosition(int position, int direction) const;
+
+  // The other way around: planned position of the axis if the motors are
+  // at "motor_position". Approximate inverse within a step.
+  int AxisPosition(int motor_position, int direction) const;
+
+private:
+  // Correction in steps to add at "position" from the error table.
+  double Correction(double position) const;
+
+  int backlash_steps_;
+  double spacing_steps_;
+  std::vector<double> table_;  // Correction at each spacing.
+  std::vector<double> slope_;  // Correction per step to the next one.
+};
+
+#endif  // _BEAGLEG_AXIS_COMPENSATION_H_
@@ -0,0 +1,53 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for backlash and error table compensation of an axis.
+ */
+#include "axis-compensation.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(AxisCompensation, DisabledIsIdentity) {
+  AxisCompensation comp;
+  EXPECT_FALSE(comp.enabled());
+  EXPECT_EQ(1234, comp.MotorPosition(1234, -1));
+  EXPECT_EQ(1234, comp.AxisPosition(1234, -1));
+
+  AxisCompensation no_table(100, 0, 10, std::vector<float>());
+  EXPECT_FALSE(no_table.enabled());
+}
+
+TEST(AxisCompensation, BacklashOnlyMovingNegative) {
+  AxisCompensation comp(100, 0.05, 0, std::vector<float>());
+  EXPECT_TRUE(comp.enabled());
+  EXPECT_EQ(1000, comp.MotorPosition(1000, 1));
+  EXPECT_EQ(1000, comp.MotorPosition(1000, 0));
+  EXPECT_EQ(995, comp.MotorPosition(1000, -1));
+  EXPECT_EQ(1000, comp.AxisPosition(995, -1));
+  EXPECT_EQ(1000, comp.AxisPosition(1000, 1));
+}
+
+TEST(AxisCompensation, ErrorTableIsInterpolated) {
+  // Axis goes 0.1mm too far at 10mm, 0.3mm too far at 20mm.
+  AxisCompensation comp(100, 0, 10, { 0, 0.1, 0.3 });
+  EXPECT_EQ(-100, comp.MotorPosition(-100, 1));     // Before the table,
+  EXPECT_EQ(1000 - 10, comp.MotorPosition(1000, 1));
+  EXPECT_EQ(1500 - 20, comp.MotorPosition(1500, 1));
+  EXPECT_EQ(2000 - 30, comp.MotorPosition(2000, 1));
+  EXPECT_EQ(5000 - 30, comp.MotorPosition(5000, 1));  // ... and beyond.
+
+  for (int pos : { -100, 0, 333, 1000, 1500, 1999, 2500 }) {
+    EXPECT_EQ(pos, comp.AxisPosition(comp.MotorPosition(pos, -1), -1)) << pos;
+  }
+}
+
+TEST(AxisCompensation, BacklashAndErrorTableCombine) {
+  AxisCompensation comp(100, 0.02, 10, { 0, -0.1 });
+  EXPECT_EQ(1000 + 10, comp.MotorPosition(1000, 1));
+  EXPECT_EQ(1000 + 10 - 2, comp.MotorPosition(1000, -1));
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
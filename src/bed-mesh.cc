@@ -0,0 +1,105 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bed-mesh.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace {
+// Grid cell "index" and the fraction within it for "pos" on an axis with
+// "count" grid lines. Clamped to the grid.
+void FindCell(float pos, float spacing, int count, int *index, float *frac) {
+  const float f = pos / spacing;
+  if (count < 2 || f <= 0) {
+    *index = 0;
+    *frac = 0;
+  } else if (f >= count - 1) {
+    *index = count - 2;
+    *frac = 1;
+  } else {
+    *index = (int) f;
+    *frac = f - *index;
+  }
+}
+
+// Fractions of the move from "start" to "end" on one axis at which it
+// crosses the grid lines.
+void AddCrossings(float start, float end, float spacing, int count,
+                  std::vector<float> *fractions) {
+  if (start == end) return;
+  const float low = std::min(start, end);
+  const float high = std::max(start, end);
+  for (int i = std::max(0, (int) ceilf(low / spacing)); i < count; ++i) {
+    const float line = i * spacing;
+    if (line <= low) continue;
+    if (line >= high) break;
+    fractions->push_back((line - start) / (end - start));
+  }
+}
+}  // namespace
+
+BedMesh::BedMesh(int size_x, int size_y, float spacing)
+  : size_x_(size_x), size_y_(size_y), spacing_(spacing),
+    heights_(size_x * size_y, 0.0f) {}
+
+float BedMesh::Height(float x, float y) const {
+  int ix, iy;
+  float fx, fy;
+  FindCell(x, spacing_, size_x_, &ix, &fx);
+  FindCell(y, spacing_, size_y_, &iy, &fy);
+  const int ix1 = std::min(ix + 1, size_x_ - 1);
+  const int iy1 = std::min(iy + 1, size_y_ - 1);
+  const float low = Get(ix, iy) + fx * (Get(ix1, iy) - Get(ix, iy));
+  const float high = Get(ix, iy1) + fx * (Get(ix1, iy1) - Get(ix, iy1));
+  return low + fy * (high - low);
+}
+
+void BedMesh::Subdivide(float x0, float y0, float x1, float y1,
+                        float tolerance, std::vector<float> *fractions) const {
+  fractions->clear();
+  AddCrossings(x0, x1, spacing_, size_x_, fractions);
+  AddCrossings(y0, y1, spacing_, size_y_, fractions);
+  if (fractions->empty()) return;
+  std::sort(fractions->begin(), fractions->end());
+
+  auto height_at = [&](float f) {
+    return Height(x0 + f * (x1 - x0), y0 + f * (y1 - y0));
+  };
+  // Keep the crossings at which the height bends away from the straight
+  // line between the last kept one and the next.
+  float last_f = 0;
+  float last_h = height_at(0);
+  size_t kept = 0;
+  const size_t count = fractions->size();
+  for (size_t i = 0; i < count; ++i) {
+    const float f = (*fractions)[i];
+    if (f - last_f < 1e-6) continue;   // Crossing at a grid point.
+    const float next_f = (i + 1 < count) ? (*fractions)[i+1] : 1.0f;
+    const float h = height_at(f);
+    const float straight = last_h + (height_at(next_f) - last_h)
+      * (f - last_f) / (next_f - last_f);
+    if (fabsf(h - straight) <= tolerance) continue;
+    (*fractions)[kept++] = f;
+    last_f = f;
+    last_h = h;
+  }
+  fractions->resize(kept);
+}
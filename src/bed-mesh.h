@@ -0,0 +1,58 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_BED_MESH_H_
+#define _BEAGLEG_BED_MESH_H_
+
+#include <vector>
+
+// Height map of the bed, probed on a regular grid in the XY plane starting
+// at the origin. Heights in between are interpolated bilinearly; outside
+// the grid, the height of the nearest edge applies.
+class BedMesh {
+public:
+  // Grid of "size_x" times "size_y" points, "spacing" mm apart. All
+  // heights start at zero.
+  BedMesh(int size_x, int size_y, float spacing);
+
+  int size_x() const { return size_x_; }
+  int size_y() const { return size_y_; }
+  float spacing() const { return spacing_; }
+
+  void Set(int x, int y, float height) { heights_[y * size_x_ + x] = height; }
+  float Get(int x, int y) const { return heights_[y * size_x_ + x]; }
+
+  // Interpolated height at position x, y (mm).
+  float Height(float x, float y) const;
+
+  // A straight move between grid lines sees a smooth height change, so
+  // moves only need to be broken where they cross one. Fills "fractions"
+  // with the positions (0..1, ascending) along the move from x0, y0 to
+  // x1, y1 at which it crosses grid lines and the height deviates more than
+  // "tolerance" from going straight. Empty for moves on a flat part.
+  void Subdivide(float x0, float y0, float x1, float y1, float tolerance,
+                 std::vector<float> *fractions) const;
+
+private:
+  const int size_x_;
+  const int size_y_;
+  const float spacing_;
+  std::vector<float> heights_;
+};
+
+#endif  // _BEAGLEG_BED_MESH_H_
@@ -0,0 +1,58 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the bed height map.
+ */
+#include "bed-mesh.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+TEST(BedMesh, BilinearInterpolation) {
+  BedMesh mesh(3, 2, 10);
+  mesh.Set(1, 0, 0.2);
+  mesh.Set(1, 1, 0.4);
+  EXPECT_FLOAT_EQ(0, mesh.Height(0, 0));
+  EXPECT_FLOAT_EQ(0.2, mesh.Height(10, 0));
+  EXPECT_FLOAT_EQ(0.1, mesh.Height(5, 0));
+  EXPECT_FLOAT_EQ(0.3, mesh.Height(10, 5));
+  EXPECT_FLOAT_EQ(0.15, mesh.Height(5, 5));
+
+  // Outside, the edge continues.
+  EXPECT_FLOAT_EQ(0.2, mesh.Height(10, -5));
+  EXPECT_FLOAT_EQ(0.4, mesh.Height(10, 100));
+  EXPECT_FLOAT_EQ(0, mesh.Height(-3, -3));
+}
+
+TEST(BedMesh, FlatOrTiltedNeedsNoSubdivision) {
+  BedMesh mesh(5, 5, 10);
+  std::vector<float> fractions;
+  mesh.Subdivide(0, 3, 40, 27, 0.001, &fractions);
+  EXPECT_TRUE(fractions.empty());
+
+  for (int y = 0; y < 5; ++y) {
+    for (int x = 0; x < 5; ++x) mesh.Set(x, y, 0.01 * x);
+  }
+  mesh.Subdivide(0, 3, 40, 27, 0.001, &fractions);
+  EXPECT_TRUE(fractions.empty());
+}
+
+TEST(BedMesh, SubdividedWhereSlopeChanges) {
+  BedMesh mesh(5, 1, 10);
+  mesh.Set(2, 0, 0.1);   // Bump in the middle.
+  std::vector<float> fractions;
+  mesh.Subdivide(0, 0, 40, 0, 0.001, &fractions);
+  EXPECT_EQ(std::vector<float>({ 0.25, 0.5, 0.75 }), fractions);
+
+  // Not crossing any grid line.
+  mesh.Subdivide(12, 0, 18, 0, 0.001, &fractions);
+  EXPECT_TRUE(fractions.empty());
+
+  // Backwards, and ending right at a grid line.
+  mesh.Subdivide(35, 0, 20, 0, 0.001, &fractions);
+  EXPECT_EQ(std::vector<float>({ 1.0f / 3 }), fractions);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -113,6 +113,12 @@ public:
     read_pos_ = (read_pos_ + 1) % CAPACITY;
   }
 
+  // Remove "count" elements from the front.
+  void pop_front(size_t count) {
+    assert(size() >= count);
+    read_pos_ = (read_pos_ + count) % CAPACITY;
+  }
+
   void pop_back() {
     assert(size() > 0);
     write_pos_ = (write_pos_ + CAPACITY - 1) % CAPACITY;
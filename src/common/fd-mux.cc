@@ -22,7 +22,9 @@
 #include <errno.h>
 #include <signal.h>
 #include <string.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -65,89 +67,250 @@ static void disarm_signal_handler() {
   signal(SIGFPE, SIG_DFL);
 }
 
+static int64_t get_time_usec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+FDMultiplexer::FDMultiplexer(unsigned idle_ms)
+  : idle_ms_(idle_ms), epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+    timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+    next_timer_id_(0), next_generation_(0), running_map_(NULL),
+    running_fd_(-1), last_activity_usec_(get_time_usec()) {
+  if (epoll_fd_ < 0 || timer_fd_ < 0) {
+    Log_error("Can't create epoll or timer fd: %s", strerror(errno));
+    return;
+  }
+  struct epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = timer_fd_;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev);
+}
+
+FDMultiplexer::~FDMultiplexer() {
+  close(timer_fd_);
+  close(epoll_fd_);
+}
+
 bool FDMultiplexer::RunOnReadable(int fd, const Handler &handler) {
-  return read_handlers_.insert({ fd, handler }).second;
+  return Register(fd, handler, &read_handlers_);
 }
 
 bool FDMultiplexer::RunOnWritable(int fd, const Handler &handler) {
-  return write_handlers_.insert({ fd, handler }).second;
+  return Register(fd, handler, &write_handlers_);
+}
+
+bool FDMultiplexer::Register(int fd, const Handler &handler,
+                             HandlerMap *handlers) {
+  const Registration registration = { handler, next_generation_++ };
+  auto inserted = handlers->insert({ fd, registration });
+  if (!inserted.second) {
+    if (handlers != running_map_ || fd != running_fd_)
+      return false;
+    // The running handler registers its fd again. That might be a new file
+    // with the same number, so forget what we knew about the old one.
+    inserted.first->second = registration;
+    registered_fds_.erase(fd);
+    always_ready_.erase(fd);
+  }
+  UpdateInterest(fd);
+  return true;
 }
 
 void FDMultiplexer::RunOnIdle(const Handler &handler) {
   idle_handlers_.push_back(handler);
 }
 
-void FDMultiplexer::CallHandlers(fd_set *to_call_fd_set, int *available_fds,
-                                 HandlerMap *handlers) {
-  for (auto it = handlers->begin(); *available_fds && it != handlers->end(); ) {
-    bool keep_handler = true;
-    if (FD_ISSET(it->first, to_call_fd_set)) {
-      --*available_fds;
-      keep_handler = it->second();
-    }
-    it = keep_handler ? std::next(it) : handlers->erase(it);
+int FDMultiplexer::RunAfter(uint64_t delay_usec, const Handler &handler) {
+  const int id = next_timer_id_++;
+  const TimerQueue::key_type key(get_time_usec() + delay_usec, id);
+  timers_[key] = { handler, delay_usec };
+  timer_by_id_[id] = key;
+  if (timers_.begin()->first == key)
+    ArmTimerFd();  // New earliest deadline.
+  return id;
+}
+
+void FDMultiplexer::CancelTimer(int timer_id) {
+  auto found = timer_by_id_.find(timer_id);
+  if (found == timer_by_id_.end())
+    return;
+  timers_.erase(found->second);
+  timer_by_id_.erase(found);
+  // If this was the earliest, the timer fd just fires early. That is
+  // harmless, so we don't bother re-arming here.
+}
+
+void FDMultiplexer::ArmTimerFd() {
+  struct itimerspec spec = {};  // All zero: disarm.
+  if (!timers_.empty()) {
+    const int64_t deadline = timers_.begin()->first.first;
+    spec.it_value.tv_sec = deadline / 1000000;
+    spec.it_value.tv_nsec = (deadline % 1000000) * 1000;
   }
+  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, NULL);
 }
 
-bool FDMultiplexer::SingleCycle(unsigned int timeout_ms) {
-  fd_set read_fds;
-  fd_set write_fds;
+void FDMultiplexer::RunTimers() {
+  uint64_t expirations;
+  if (read(timer_fd_, &expirations, sizeof(expirations)) < 0 &&
+      errno != EAGAIN) {
+    Log_error("Reading timer fd: %s", strerror(errno));
+  }
+  const int64_t now = get_time_usec();
+  while (!timers_.empty() && timers_.begin()->first.first <= now) {
+    const TimerQueue::key_type key = timers_.begin()->first;
+    // Handler might add or cancel timers, so take it out of the queue first.
+    Timer timer = timers_.begin()->second;
+    timers_.erase(timers_.begin());
+    timer_by_id_.erase(key.second);
+    if (timer.handler()) {
+      // Keep the rate, but don't try to catch up if we're late.
+      const TimerQueue::key_type next(
+        std::max(key.first + (int64_t)timer.interval_usec, now + 1),
+        key.second);
+      timers_[next] = timer;
+      timer_by_id_[key.second] = next;
+    }
+  }
+  ArmTimerFd();
+}
 
-  struct timeval timeout;
-  timeout.tv_sec = timeout_ms / 1000;
-  timeout.tv_usec = (timeout_ms % 1000) * 1000;
+void FDMultiplexer::UpdateInterest(int fd) {
+  uint32_t events = 0;
+  if (read_handlers_.find(fd) != read_handlers_.end()) events |= EPOLLIN;
+  if (write_handlers_.find(fd) != write_handlers_.end()) events |= EPOLLOUT;
 
-  int maxfd = -1;
-  FD_ZERO(&read_fds);
-  FD_ZERO(&write_fds);
+  if (events == 0) {
+    // The fd might already be closed, so errors don't matter here.
+    if (registered_fds_.erase(fd))
+      epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
+    always_ready_.erase(fd);
+    return;
+  }
+  if (always_ready_.find(fd) != always_ready_.end())
+    return;
 
-  // Readers
-  for (const auto &it : read_handlers_) {
-    maxfd = std::max(maxfd, it.first);
-    FD_SET(it.first, &read_fds);
+  struct epoll_event ev = {};
+  ev.events = events;
+  ev.data.fd = fd;
+  const bool known = registered_fds_.find(fd) != registered_fds_.end();
+  int result = epoll_ctl(epoll_fd_, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                         fd, &ev);
+  if (result < 0 && known && errno == ENOENT) {
+    // Closed in the meantime, so the kernel forgot about it; this is a new one.
+    result = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+  } else if (result < 0 && !known && errno == EEXIST) {
+    // Re-registered, but still the same file.
+    result = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+  }
+  if (result == 0) {
+    registered_fds_.insert(fd);
+  } else if (errno == EPERM) {
+    // Regular files can't be polled. They are always ready, like select()
+    // would report them.
+    registered_fds_.erase(fd);
+    always_ready_.insert(fd);
+  } else {
+    Log_error("epoll_ctl(fd=%d): %s", fd, strerror(errno));
   }
+}
 
-  // Writers
-  for (const auto &it : write_handlers_) {
-    maxfd = std::max(maxfd, it.first);
-    FD_SET(it.first, &write_fds);
+void FDMultiplexer::CallHandler(int fd, HandlerMap *handlers) {
+  auto found = handlers->find(fd);
+  if (found == handlers->end())
+    return;  // Removed by a handler called before in this cycle.
+  // The handler might replace its registration, so call a copy.
+  const Handler handler = found->second.handler;
+  const uint64_t generation = found->second.generation;
+  running_map_ = handlers;
+  running_fd_ = fd;
+  const bool keep_handler = handler();
+  running_map_ = NULL;
+  running_fd_ = -1;
+  if (keep_handler)
+    return;
+  // Handler might have modified the map, so look up again.
+  found = handlers->find(fd);
+  if (found != handlers->end() && found->second.generation == generation) {
+    handlers->erase(found);
+    UpdateInterest(fd);
   }
+}
 
-  if (maxfd < 0) {
-    // file descriptors only can be registred from within handlers
-    // or before running the Loop(). So if no filedesctiptors are left,
-    // there is no chance for any to re-appear, so we can exit.
-    Log_info("Exiting loop() after last file descriptor is gone.");
-    return false;
+bool FDMultiplexer::SingleCycle(unsigned int timeout_ms) {
+  if (read_handlers_.empty() && write_handlers_.empty()) {
+    if (timers_.empty()) {
+      // file descriptors only can be registred from within handlers
+      // or before running the Loop(). So if no filedesctiptors are left,
+      // there is no chance for any to re-appear, so we can exit.
+      Log_info("Exiting loop() after last file descriptor is gone.");
+      return false;
+    }
   }
 
-  int fds_ready = select(maxfd + 1, &read_fds, &write_fds, nullptr, &timeout);
+  enum { MAX_EVENTS = 16 };
+  struct epoll_event events[MAX_EVENTS];
+  const int wait_ms = always_ready_.empty() ? (int)timeout_ms : 0;
+  const int fds_ready = epoll_wait(epoll_fd_, events, MAX_EVENTS, wait_ms);
   if (fds_ready < 0) {
     if (!caught_signal)
-      perror("select() failed");
+      perror("epoll_wait() failed");
     return false;
   }
 
-  if (fds_ready == 0) {             // No FDs ready: timeout situation.
+  bool timer_due = false;
+  bool fd_activity = false;
+  for (int i = 0; i < fds_ready; ++i) {
+    const int fd = events[i].data.fd;
+    if (fd == timer_fd_) {
+      timer_due = true;
+      continue;
+    }
+    fd_activity = true;
+    // Hangup and errors are reported as readable, as select() does.
+    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+      CallHandler(fd, &read_handlers_);
+    if (events[i].events & (EPOLLOUT | EPOLLERR))
+      CallHandler(fd, &write_handlers_);
+  }
+
+  if (!always_ready_.empty()) {
+    fd_activity = true;
+    const std::set<int> ready = always_ready_;  // Handlers might modify.
+    for (int fd : ready) {
+      CallHandler(fd, &read_handlers_);
+      CallHandler(fd, &write_handlers_);
+    }
+  }
+
+  if (timer_due) {
+    RunTimers();
+  }
+
+  if (!fd_activity && !timer_due) {  // Timeout situation.
     for (auto it = idle_handlers_.begin(); it != idle_handlers_.end(); /**/) {
       const bool keep_handler = (*it)();
       it = keep_handler ? std::next(it) : idle_handlers_.erase(it);
     }
-    return true;
   }
 
-  CallHandlers(&read_fds, &fds_ready, &read_handlers_);
-  CallHandlers(&write_fds, &fds_ready, &write_handlers_);
-
+  if (fd_activity || !timer_due) {
+    last_activity_usec_ = get_time_usec();
+  }
   return true;
 }
 
 int FDMultiplexer::Loop() {
-  const unsigned timeout = idle_ms_;
-
   arm_signal_handler();
-  while (SingleCycle(timeout) && !caught_signal) {
-    /**/
+  last_activity_usec_ = get_time_usec();
+  for (;;) {
+    // Timers don't interrupt idle: wait relative to the last real activity.
+    const int64_t since_ms = (get_time_usec() - last_activity_usec_) / 1000;
+    const unsigned timeout = since_ms >= idle_ms_ ? 0 : idle_ms_ - since_ms;
+    if (!SingleCycle(timeout) || caught_signal)
+      break;
   }
   disarm_signal_handler();
 
@@ -20,16 +20,20 @@
 #ifndef FD_MUX_H_
 #define FD_MUX_H_
 
+#include <stdint.h>
+
 #include <map>
 #include <functional>
 #include <list>
+#include <set>
 
-#include <sys/select.h>
-
+// Linux event multiplexer based on epoll. Timers are kept in a single
+// timerfd, so they have sub-millisecond precision.
 // This needs a better name.
 class FDMultiplexer {
 public:
-  FDMultiplexer(unsigned idle_ms = 50) : idle_ms_(idle_ms) {}
+  FDMultiplexer(unsigned idle_ms = 50);
+  ~FDMultiplexer();
 
   // Handlers for events from this multiplexer.
   // Returns true if we want to continue to be called in the future or false
@@ -38,40 +42,82 @@ public:
 
   // These can only be set before Loop() is called or from a
   // running handler itself.
-  // Returns false if that filedescriptor is already registered.
+  // Returns false if that filedescriptor is already registered. The one
+  // exception is the handler currently running for "fd": registering again
+  // replaces it, even if it then returns false. This way, a handler can
+  // close its fd and register a new one that got the same number.
   bool RunOnReadable(int fd, const Handler &handler);
   bool RunOnWritable(int fd, const Handler &handler);
 
   // Handler called regularly every idle_ms in case there's nothing to do.
+  // Timers firing don't count as something to do.
   void RunOnIdle(const Handler &handler);
 
+  // Run "handler" once after "delay_usec" microseconds. If it returns true,
+  // it is scheduled again after the same delay.
+  // Returns an id that can be passed to CancelTimer().
+  int RunAfter(uint64_t delay_usec, const Handler &handler);
+
+  // Cancel a pending timer. No-op if it is not pending (anymore).
+  void CancelTimer(int timer_id);
+
   // Run the main loop. Blocks while there is still a filedescriptor
-  // registered (return 0) or until a signal is triggered (return 1).
+  // registered or a timer pending (return 0) or until a signal is
+  // triggered (return 1).
   int Loop();
 
 protected:
-  // Run a single cycle resulting in exactly one call of a handler function.
-  // This means that one of these happened:
-  //   (1) The next file descriptor became ready and its Handler is called
-  //   (2) We encountered a timeout and the idle-Handler has been called.
-  //   (3) Signal received or select() issue. Returns false in this case.
+  // Run a single cycle. This means that one of these happened:
+  //   (1) File descriptors became ready and their Handlers are called. Timers
+  //       that are due are called as well.
+  //   (2) Only timers became due; their Handlers are called.
+  //   (3) We encountered a timeout and the idle-Handlers have been called.
+  //   (4) Signal received or epoll issue. Returns false in this case.
   //
   // This is broken out to make it simple to test steps in unit tests.
   bool SingleCycle(unsigned timeout_ms);
 
 private:
-  typedef std::map<int, Handler> HandlerMap;
+  // Each registration gets a new generation, so that a handler returning
+  // false only removes itself, not what got registered on its fd meanwhile.
+  struct Registration {
+    Handler handler;
+    uint64_t generation;
+  };
+  typedef std::map<int, Registration> HandlerMap;
+
+  struct Timer {
+    Handler handler;
+    uint64_t interval_usec;
+  };
+  // Ordered by (deadline in usec, id).
+  typedef std::map<std::pair<int64_t, int>, Timer> TimerQueue;
+
+  bool Register(int fd, const Handler &handler, HandlerMap *handlers);
+
+  // Tell epoll about the events we're interested in for "fd".
+  void UpdateInterest(int fd);
 
-  // Call all the handlers available in fd_set, removing the ones that
-  // return 'false'. "available_fds" is an optimizatin that tells CallHandlers
-  // how many fds there are in the first place.
-  void CallHandlers(fd_set *to_call_fd_set, int *available_fds,
-                    HandlerMap *handlers);
+  // Call the handler for "fd" in "handlers", remove it if it returns false.
+  void CallHandler(int fd, HandlerMap *handlers);
+  void RunTimers();
+  void ArmTimerFd();
 
   const unsigned idle_ms_;
+  const int epoll_fd_;
+  const int timer_fd_;
   HandlerMap read_handlers_;
   HandlerMap write_handlers_;
+  std::set<int> registered_fds_;  // in epoll
+  std::set<int> always_ready_;    // Regular files. Can't epoll(), always ready
   std::list<Handler> idle_handlers_;
+  TimerQueue timers_;
+  std::map<int, TimerQueue::key_type> timer_by_id_;
+  int next_timer_id_;
+  uint64_t next_generation_;
+  const HandlerMap *running_map_;  // Map and fd of the handler being called.
+  int running_fd_;
+  int64_t last_activity_usec_;
 };
 
 #endif // FD_MUX_H_
@@ -0,0 +1,127 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the event multiplexer.
+ */
+#include "fd-mux.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "logging.h"
+
+class TestMultiplexer : public FDMultiplexer {
+public:
+  using FDMultiplexer::SingleCycle;
+};
+
+TEST(FDMultiplexer, timers_run_in_order_of_deadline) {
+  TestMultiplexer mux;
+  std::vector<int> fired;
+  mux.RunAfter(2000, [&fired]() { fired.push_back(2); return false; });
+  mux.RunAfter(1000, [&fired]() { fired.push_back(1); return false; });
+  const int cancelled = mux.RunAfter(1500, [&fired]() {
+      fired.push_back(-1); return false;
+    });
+  mux.CancelTimer(cancelled);
+
+  while (fired.size() < 2) {
+    ASSERT_TRUE(mux.SingleCycle(100));
+  }
+  ASSERT_EQ(2, (int)fired.size());
+  EXPECT_EQ(1, fired[0]);
+  EXPECT_EQ(2, fired[1]);
+
+  // Nothing left: no file descriptors nor timers.
+  EXPECT_FALSE(mux.SingleCycle(0));
+}
+
+TEST(FDMultiplexer, repeating_timer_until_handler_returns_false) {
+  TestMultiplexer mux;
+  int count = 0;
+  mux.RunAfter(500, [&count]() { return ++count < 3; });
+  while (mux.SingleCycle(100)) {}
+  EXPECT_EQ(3, count);
+}
+
+TEST(FDMultiplexer, timers_are_not_idle_activity) {
+  TestMultiplexer mux;
+  int fd[2];
+  ASSERT_EQ(0, pipe(fd));
+  mux.RunOnReadable(fd[0], []() { return true; });
+  int idle_calls = 0;
+  mux.RunOnIdle([&idle_calls]() { ++idle_calls; return true; });
+
+  bool timer_fired = false;
+  mux.RunAfter(0, [&timer_fired]() { timer_fired = true; return false; });
+  ASSERT_TRUE(mux.SingleCycle(100));
+  EXPECT_TRUE(timer_fired);
+  EXPECT_EQ(0, idle_calls);
+
+  ASSERT_TRUE(mux.SingleCycle(0));  // Nothing happening: idle.
+  EXPECT_EQ(1, idle_calls);
+  close(fd[0]);
+  close(fd[1]);
+}
+
+TEST(FDMultiplexer, regular_files_are_always_readable) {
+  TestMultiplexer mux;
+  FILE *tmp = tmpfile();
+  ASSERT_TRUE(tmp != NULL);
+  int calls = 0;
+  mux.RunOnReadable(fileno(tmp), [&calls]() { return ++calls < 2; });
+  ASSERT_TRUE(mux.SingleCycle(1000));
+  ASSERT_TRUE(mux.SingleCycle(1000));
+  EXPECT_EQ(2, calls);
+  EXPECT_FALSE(mux.SingleCycle(0));  // Handler removed itself.
+  fclose(tmp);
+}
+
+// A handler closing its fd and registering a new one that got the same
+// number keeps the new registration, even though it returns false.
+TEST(FDMultiplexer, handler_can_register_recycled_fd) {
+  TestMultiplexer mux;
+  int first[2];
+  ASSERT_EQ(0, pipe(first));
+  ASSERT_EQ(1, write(first[1], "x", 1));
+  int second[2] = { -1, -1 };
+  int new_calls = 0;
+  mux.RunOnReadable(first[0], [&]() {
+      close(first[0]);
+      close(first[1]);
+      EXPECT_EQ(0, pipe(second));
+      EXPECT_EQ(first[0], second[0]);  // Lowest free number is recycled.
+      EXPECT_EQ(1, write(second[1], "y", 1));
+      EXPECT_TRUE(mux.RunOnReadable(second[0], [&new_calls]() {
+            ++new_calls;
+            return false;
+          }));
+      return false;
+    });
+  ASSERT_TRUE(mux.SingleCycle(100));  // Old handler replaces itself.
+  EXPECT_EQ(0, new_calls);
+  ASSERT_TRUE(mux.SingleCycle(100));
+  EXPECT_EQ(1, new_calls);
+  EXPECT_FALSE(mux.SingleCycle(0));  // Now it is gone.
+  close(second[0]);
+  close(second[1]);
+}
+
+// Other than the running handler, nothing can take over a registered fd.
+TEST(FDMultiplexer, fd_can_only_be_registered_once) {
+  TestMultiplexer mux;
+  int fd[2];
+  ASSERT_EQ(0, pipe(fd));
+  EXPECT_TRUE(mux.RunOnReadable(fd[0], []() { return true; }));
+  EXPECT_FALSE(mux.RunOnReadable(fd[0], []() { return true; }));
+  close(fd[0]);
+  close(fd[1]);
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/stderr");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
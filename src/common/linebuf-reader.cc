@@ -17,51 +17,139 @@
  * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "linebuf-reader.h"
+
+#include <errno.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+
+#include "logging.h"
 #include "string-util.h"
 
-LinebufReader::LinebufReader(size_t buf_size)
-  : len_(buf_size),
+// We always keep one byte at the end, so that IncompleteLine() can
+// terminate the content.
+LinebufReader::LinebufReader(size_t buf_size, size_t max_buf_size)
+  : max_len_(std::max(buf_size, max_buf_size)), len_(buf_size),
     buffer_start_(new char [len_]), buffer_end_(buffer_start_ + len_),
     content_start_(buffer_start_), content_end_(buffer_start_),
-    cr_seen_(false) {
+    scanned_(0), cr_seen_(false) {
 }
 LinebufReader::~LinebufReader() { delete [] buffer_start_; }
 
-int LinebufReader::Update(ReadFun read_fun) {
-  if (content_start_ - buffer_start_ > (int)(len_ / 2)) {
-    const size_t copy_len = size();
-    memmove(buffer_start_, content_start_, copy_len);
+size_t LinebufReader::MakeRoom(size_t needed) {
+  const size_t content_len = size();
+  size_t available = buffer_end_ - content_end_ - 1;
+  if (available >= needed && content_start_ - buffer_start_ <= (int)(len_ / 2))
+    return available;
+
+  // Move to front; this is all we need most of the time.
+  if (content_start_ != buffer_start_) {
+    memmove(buffer_start_, content_start_, content_len);
     content_start_ = buffer_start_;
-    content_end_ = buffer_start_ + copy_len;
+    content_end_ = buffer_start_ + content_len;
+    available = buffer_end_ - content_end_ - 1;
+  }
+  if (available >= needed || len_ >= max_len_)
+    return available;
+
+  // Long line: grow.
+  size_t new_len = len_;
+  while (new_len - content_len - 1 < needed && new_len < max_len_)
+    new_len = std::min(2 * new_len, max_len_);
+  char *new_buffer = new char [new_len];
+  memcpy(new_buffer, content_start_, content_len);
+  delete [] buffer_start_;
+  len_ = new_len;
+  buffer_start_ = new_buffer;
+  buffer_end_ = buffer_start_ + len_;
+  content_start_ = buffer_start_;
+  content_end_ = buffer_start_ + content_len;
+  return buffer_end_ - content_end_ - 1;
+}
+
+int LinebufReader::Update(ReadFun read_fun) {
+  // Reading into a full buffer would look like end-of-stream.
+  const size_t available = MakeRoom(1);
+  if (available == 0) {  // Caller needs to ReadLine() first.
+    errno = ENOBUFS;
+    return -1;
   }
-  ssize_t r = read_fun(content_end_, buffer_end_ - content_end_);
-  // TODO(hzeller): if we get zero, we should consider this as end-of-stream
-  // and potentially regard the buffer as 'complete' even if it doesn't have a
-  // full line yet.
-  if (r >= 0) content_end_ += r;   // so, what if r < 0 ?
+  ssize_t r = read_fun(content_end_, available);
+  if (r > 0) content_end_ += r;
   return r;
 }
 
+int LinebufReader::Update(int fd, int max_reads) {
+  // What doesn't fit into the buffer spills over here and is appended after
+  // growing the buffer. Only as much as we can keep within max_len_.
+  char spill[16384];
+  int total = 0;
+  for (int i = 0; i < max_reads; ++i) {
+    const size_t available = MakeRoom(1);
+    if (available == 0) {  // At limit; caller needs to ReadLine() first.
+      if (total > 0) break;
+      errno = ENOBUFS;
+      return -1;
+    }
+    const size_t can_grow = max_len_ - len_;
+    struct iovec iov[2];
+    iov[0].iov_base = content_end_;
+    iov[0].iov_len = available;
+    iov[1].iov_base = spill;
+    iov[1].iov_len = std::min(sizeof(spill), can_grow);
+    const ssize_t r = readv(fd, iov, iov[1].iov_len > 0 ? 2 : 1);
+    if (r <= 0)
+      return total > 0 ? total : r;  // Report EOF or error next time.
+    total += r;
+    if ((size_t)r <= available) {
+      content_end_ += r;
+      if ((size_t)r < available) break;  // Drained.
+      continue;
+    }
+    content_end_ += available;
+    const size_t spilled = r - available;
+    MakeRoom(spilled);  // Fits, as we limited the spill to can_grow.
+    memcpy(content_end_, spill, spilled);
+    content_end_ += spilled;
+    if (spilled < iov[1].iov_len) break;  // Drained.
+  }
+  return total;
+}
+
 const char* LinebufReader::IncompleteLine() {
-  *content_end_ = '\n';
+  *content_end_ = '\n';  // There is always space for that.
   content_end_++;
   return ReadLine();
 }
 
 const char* LinebufReader::ReadLine() {
-  for (char *i = content_start_; i < content_end_; ++i) {
+  for (char *i = content_start_ + scanned_; i < content_end_; ++i) {
     if (cr_seen_ && *i == '\n') {
       cr_seen_ = false;
       content_start_ = i + 1;
       continue;
     }
+    cr_seen_ = false;
     if (*i == '\r' || *i == '\n') {
       cr_seen_ = (*i == '\r') ? true : false;
       *i = '\0';
       const char *line = content_start_;
       content_start_ = i + 1;
+      scanned_ = 0;
       return line;
     }
   }
+  scanned_ = size();
+
+  // Buffer is full at its limit without a newline. Return what we have,
+  // the rest of the line comes with the next call.
+  if (len_ >= max_len_ && content_start_ == buffer_start_ &&
+      content_end_ == buffer_end_ - 1) {
+    Log_error("Line longer than %zu bytes; splitting.", max_len_ - 1);
+    *content_end_ = '\0';
+    content_start_ = content_end_ = buffer_start_;
+    scanned_ = 0;
+    return buffer_start_;
+  }
   return NULL;
 }
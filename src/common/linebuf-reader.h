@@ -35,9 +35,10 @@ public:
   // and a negative number to indicate error.
   typedef std::function<ssize_t(char *buf, size_t size)> ReadFun;
 
-  // The "buffer_size" determines the longest line we expect at maximum.
-  // TODO(hzeller): right now, we don't gracefully deal with overlong lines.
-  LinebufReader(size_t buffer_size = 16384);
+  // The buffer starts with "buffer_size" and grows if it needs to hold a
+  // longer line, up to "max_buffer_size". Lines longer than that are
+  // returned in pieces, so no data is lost.
+  LinebufReader(size_t buffer_size = 16384, size_t max_buffer_size = 1 << 20);
   ~LinebufReader();
 
   // Update content. It will be calling the ReadFun exactly once and updates
@@ -50,11 +51,12 @@ public:
 
   // The tpical way this will be called: with a file descriptor that has some
   // bytes ready.
-  int Update(int fd) {
-    return Update([fd](char *buf, size_t len) {
-            return read(fd, buf, len);
-           });
-  }
+  // Uses readv() to also read beyond the free space in the buffer with one
+  // system call. With "max_reads" > 1, keeps reading up to that many times
+  // while the previous read was filled completely; only use that with
+  // non-blocking file descriptors.
+  // Returns the total bytes read, 0 on end-of-stream or negative on error.
+  int Update(int fd, int max_reads = 1);
 
   // Return a current line if it is available. The line is a nul terminated
   // c-string without the newline character(s).
@@ -63,24 +65,35 @@ public:
   // you reach NULL to empty the buffer before the next Update() comes in.
   const char* ReadLine();
 
-  // TODO(hzeller): maybe a function to get the remaining buffer when we
-  // are closing the connection ? There might be some incomplete line in there.
+  // Return the remaining buffer as line, e.g. the last line of a stream
+  // that didn't end in a newline.
   const char* IncompleteLine();
 
   void Flush() {
     content_start_ = buffer_start_;
     content_end_ = buffer_start_;
+    scanned_ = 0;
   }
 
   // Currently stored in buffer.
   size_t size() const { return content_end_ - content_start_; }
 
+  // Current allocated buffer size.
+  size_t buffer_size() const { return len_; }
+
 private:
-  const size_t len_;
-  char *const buffer_start_;
-  const char *const buffer_end_;
+  // Make sure there are at least "needed" bytes free at the end of the
+  // buffer by moving content to the front or growing, within the limit.
+  // Returns the number of bytes available to write to.
+  size_t MakeRoom(size_t needed);
+
+  const size_t max_len_;
+  size_t len_;
+  char *buffer_start_;
+  char *buffer_end_;
   char *content_start_;
   char *content_end_;
+  size_t scanned_;   // Bytes after content_start_ known to have no newline.
 
   bool cr_seen_;
 };
@@ -19,8 +19,14 @@
 
 #include "linebuf-reader.h"
 
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <string>
 #include <memory>
+#include <vector>
 #include <gtest/gtest.h>
 
 // Raw lines that we use as samples.
@@ -139,9 +145,78 @@ INSTANTIATE_TEST_CASE_P(PortableEndLineTests,
                         LinebufReaderTest,
                         ::testing::Values("\n", "\r", "\r\n"));
 
-// TODO(hzeller): more testing
-//   - Implementation of a more graceful handling if our buffer is too small
-//     to hold a full line.
+// A line that does not fit the initial buffer makes it grow.
+TEST(LinebufReaderGrowTest, LongLineGrowsBuffer) {
+  const std::string long_line(1000, 'x');
+  const std::string input = "short\n" + long_line + "\nend\n";
+  LinebufReader reader(16, 4096);
+  size_t pos = 0;
+  std::vector<std::string> lines;
+  while (pos < input.size()) {
+    reader.Update([&](char *buf, size_t size) {
+        const size_t n = std::min(size, input.size() - pos);
+        memcpy(buf, input.data() + pos, n);
+        pos += n;
+        return (ssize_t)n;
+      });
+    while (const char *line = reader.ReadLine()) lines.push_back(line);
+  }
+  ASSERT_EQ(3, (int)lines.size());
+  EXPECT_EQ("short", lines[0]);
+  EXPECT_EQ(long_line, lines[1]);
+  EXPECT_EQ("end", lines[2]);
+  EXPECT_GE(reader.buffer_size(), long_line.size());
+}
+
+// Beyond the hard limit, the line is returned in pieces without losing
+// any bytes.
+TEST(LinebufReaderGrowTest, OverlongLineIsSplit) {
+  const std::string long_line(100, 'x');
+  const std::string input = long_line + "\nend\n";
+  LinebufReader reader(8, 32);
+  size_t pos = 0;
+  std::string reassembled;
+  std::vector<std::string> lines;
+  while (pos < input.size()) {
+    reader.Update([&](char *buf, size_t size) {
+        const size_t n = std::min(size, input.size() - pos);
+        memcpy(buf, input.data() + pos, n);
+        pos += n;
+        return (ssize_t)n;
+      });
+    while (const char *line = reader.ReadLine()) lines.push_back(line);
+  }
+  EXPECT_EQ(32u, reader.buffer_size());
+  ASSERT_GT(lines.size(), 2u);
+  EXPECT_EQ("end", lines.back());
+  for (size_t i = 0; i < lines.size() - 1; ++i) reassembled += lines[i];
+  EXPECT_EQ(long_line, reassembled);
+}
+
+// Reading from a file descriptor with more data than fits into the
+// current buffer gets everything in one call.
+TEST(LinebufReaderGrowTest, VectoredReadFromFiledescriptor) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  std::string input;
+  for (int i = 0; i < 200; ++i) input += "G1 X" + std::to_string(i) + "\n";
+  ASSERT_EQ((ssize_t)input.size(), write(fds[1], input.data(), input.size()));
+
+  LinebufReader reader(64, 1 << 16);
+  EXPECT_EQ((int)input.size(), reader.Update(fds[0], 4));
+  int count = 0;
+  while (const char *line = reader.ReadLine()) {
+    EXPECT_EQ("G1 X" + std::to_string(count), line);
+    ++count;
+  }
+  EXPECT_EQ(200, count);
+
+  close(fds[1]);
+  EXPECT_EQ(0, reader.Update(fds[0], 4));  // EOF
+  close(fds[0]);
+}
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
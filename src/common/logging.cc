@@ -31,6 +31,12 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 static int log_fd = 2;  // Allow logging before Log_init().
 
 static const char *const kInfoHighlight  = "\033[1mINFO  ";
@@ -64,59 +70,212 @@ void Log_init(const char *filename) {
   }
 }
 
-static void Log_internal(int fd, const char *markup_start,
-                         const char *format, va_list ap) {
-  struct timeval now;
-  gettimeofday(&now, NULL);
+// Write "text" with a time stamp of "time" prefixed.
+static void Log_write(int fd, const char *markup_start,
+                      const struct timeval &time, const char *text,
+                      size_t text_len) {
   struct tm time_breakdown;
-  localtime_r(&now.tv_sec, &time_breakdown);
+  localtime_r(&time.tv_sec, &time_breakdown);
   char fmt_buf[128];
   strftime(fmt_buf, sizeof(fmt_buf), "%F %T", &time_breakdown);
+  char prefix[192];
   struct iovec parts[3];
-  parts[0].iov_len = asprintf((char**) &parts[0].iov_base,
-                              "%s[%s.%06ld]%s ",
-                              markup_start, fmt_buf, now.tv_usec,
+  parts[0].iov_base = prefix;
+  parts[0].iov_len = snprintf(prefix, sizeof(prefix), "%s[%s.%06ld]%s ",
+                              markup_start, fmt_buf, (long)time.tv_usec,
                               markup_end_);
-  parts[1].iov_len = vasprintf((char**) &parts[1].iov_base, format, ap);
+  parts[1].iov_base = (void*) text;
+  parts[1].iov_len = text_len;
   parts[2].iov_base = (void*) "\n";
   parts[2].iov_len = 1;
-  int already_newline
-    = (parts[1].iov_len > 0 &&
-       ((const char*)parts[1].iov_base)[parts[1].iov_len-1] == '\n');
+  int already_newline = (text_len > 0 && text[text_len-1] == '\n');
   if (writev(fd, parts, already_newline ? 2 : 3) < 0) {
     // Logging trouble. Ignore.
   }
+}
+
+static void Log_internal(int fd, const char *markup_start,
+                         const char *format, va_list ap) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  char *text;
+  const int len = vasprintf(&text, format, ap);
+  if (len < 0) return;
+  Log_write(fd, markup_start, now, text, len);
+  free(text);
+}
+
+namespace {
+// Queue of formatted messages, written by a background thread.
+class AsyncLogger {
+public:
+  AsyncLogger() : pending_(0), next_(0), running_(true),
+                  dropped_(0), reported_dropped_(0),
+                  writer_(&AsyncLogger::Run, this) {
+  }
+
+  // Writes all pending messages before it returns.
+  ~AsyncLogger() {
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      running_ = false;
+    }
+    have_messages_.notify_one();
+    writer_.join();
+  }
+
+  void Add(int priority, const char *markup, const char *format, va_list ap) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    std::unique_lock<std::mutex> l(mutex_);
+    if (!RateLimitAllows(format, now.tv_sec) || pending_ == LOG_QUEUE_LEN) {
+      ++dropped_;
+      return;
+    }
+    Message *m = &queue_[(next_ + pending_) % LOG_QUEUE_LEN];
+    m->priority = priority;
+    m->markup = markup;
+    m->time = now;
+    const int len = vsnprintf(m->text, sizeof(m->text), format, ap);
+    m->len = (len < 0) ? 0 : std::min(len, (int)sizeof(m->text) - 1);
+    ++pending_;
+    l.unlock();
+    have_messages_.notify_one();
+  }
+
+  unsigned long dropped() {
+    std::lock_guard<std::mutex> l(mutex_);
+    return dropped_;
+  }
+
+private:
+  struct Message {
+    int priority;         // syslog priority
+    const char *markup;   // for log file.
+    struct timeval time;
+    int len;
+    char text[LOG_MESSAGE_LEN];
+  };
+
+  // Messages per second of a log statement.
+  struct RateLimit {
+    const char *format;
+    time_t second;
+    int count;
+  };
+
+  bool RateLimitAllows(const char *format, time_t second) {
+    RateLimit *r = &rate_limits_[((uintptr_t)format >> 3) % RATE_LIMIT_SLOTS];
+    if (r->format != format || r->second != second) {
+      r->format = format;   // Another statement sharing the slot: start over.
+      r->second = second;
+      r->count = 0;
+    }
+    return ++r->count <= LOG_RATE_LIMIT;
+  }
+
+  void Run() {
+    Message m;
+    std::unique_lock<std::mutex> l(mutex_);
+    for (;;) {
+      have_messages_.wait(l, [this]() { return pending_ > 0 || !running_; });
+      if (pending_ == 0 && !running_)
+        break;
+      const unsigned long newly_dropped = dropped_ - reported_dropped_;
+      reported_dropped_ = dropped_;
+      bool have_message = false;
+      if (pending_ > 0) {
+        m = queue_[next_];
+        next_ = (next_ + 1) % LOG_QUEUE_LEN;
+        --pending_;
+        have_message = true;
+      }
+      l.unlock();  // Writing can take its time.
+      if (newly_dropped > 0)
+        Log_error("Logging: dropped %lu messages.", newly_dropped);
+      if (have_message) Write(m);
+      l.lock();
+    }
+  }
+
+  static void Write(const Message &m) {
+    if (log_fd < 0) {
+      syslog(m.priority, "%s", m.text);
+    } else {
+      Log_write(log_fd, m.markup, m.time, m.text, m.len);
+    }
+  }
+
+  enum { RATE_LIMIT_SLOTS = 64 };
+
+  std::mutex mutex_;
+  std::condition_variable have_messages_;
+  Message queue_[LOG_QUEUE_LEN];
+  int pending_;
+  int next_;   // Oldest pending message.
+  bool running_;
+  RateLimit rate_limits_[RATE_LIMIT_SLOTS] = {};
+  unsigned long dropped_;
+  unsigned long reported_dropped_;
+  std::thread writer_;  // Last, so that everything is set up for it.
+};
+}  // namespace
+
+// Only changed while nothing logs.
+static AsyncLogger *async_logger = NULL;
+static std::atomic<unsigned long> async_dropped(0);  // Of previous loggers.
+
+void Log_start_async() {
+  if (async_logger) return;
+  static bool registered_exit = false;
+  if (!registered_exit) {
+    atexit(Log_stop_async);  // Don't lose messages if exiting early.
+    registered_exit = true;
+  }
+  async_logger = new AsyncLogger();
+}
+
+void Log_stop_async() {
+  if (!async_logger) return;
+  AsyncLogger *logger = async_logger;
+  async_logger = NULL;
+  async_dropped += logger->dropped();
+  delete logger;
+}
 
-  free(parts[0].iov_base);
-  free(parts[1].iov_base);
+unsigned long Log_dropped_messages() {
+  return async_dropped + (async_logger ? async_logger->dropped() : 0);
+}
+
+static void Log_dispatch(int priority, const char *markup_start,
+                         const char *format, va_list ap) {
+  if (async_logger) {
+    async_logger->Add(priority, markup_start, format, ap);
+  } else if (log_fd < 0) {
+    vsyslog(priority, format, ap);
+  } else {
+    Log_internal(log_fd, markup_start, format, ap);
+  }
 }
 
 void Log_debug(const char *format, ...) {
   if (log_fd < 0) return;
   va_list ap;
   va_start(ap, format);
-  Log_internal(log_fd, debug_markup_start_, format, ap);
+  Log_dispatch(LOG_DEBUG, debug_markup_start_, format, ap);
   va_end(ap);
 }
 
 void Log_info(const char *format, ...) {
   va_list ap;
   va_start(ap, format);
-  if (log_fd < 0) {
-    vsyslog(LOG_INFO, format, ap);
-  } else {
-    Log_internal(log_fd, info_markup_start_, format, ap);
-  }
+  Log_dispatch(LOG_INFO, info_markup_start_, format, ap);
   va_end(ap);
 }
 
 void Log_error(const char *format, ...) {
   va_list ap;
   va_start(ap, format);
-  if (log_fd < 0) {
-    vsyslog(LOG_ERR, format, ap);
-  } else {
-    Log_internal(log_fd, error_markup_start_, format, ap);
-  }
+  Log_dispatch(LOG_ERR, error_markup_start_, format, ap);
   va_end(ap);
 }
@@ -36,4 +36,26 @@ void Log_error(const char *format, ...) PRINTF_FMT_CHECK(1, 2);
 
 #undef PRINTF_FMT_CHECK
 
+enum {
+  LOG_QUEUE_LEN = 256,    // Messages waiting in asynchronous mode.
+  LOG_MESSAGE_LEN = 256,  // Longer messages are truncated in async mode.
+  LOG_RATE_LIMIT = 10     // Messages per second and log statement.
+};
+
+// Switch to asynchronous logging: messages are formatted by the caller into
+// a preallocated queue and written by a background thread, so logging does
+// not block on a slow disk or syslog. If the queue is full, messages are
+// dropped. Each log statement (identified by its format string) logs at most
+// LOG_RATE_LIMIT messages per second; the number of messages dropped is
+// logged later. Pending messages are written at exit.
+// Call after Log_init(), and not before a fork(): the writer is a thread.
+void Log_start_async();
+
+// Write all pending messages and go back to logging synchronously. Only
+// call while no other thread logs.
+void Log_stop_async();
+
+// Number of messages dropped in asynchronous mode so far.
+unsigned long Log_dropped_messages();
+
 #endif /* BEAGLEG_LOGGING_H */
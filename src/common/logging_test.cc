@@ -0,0 +1,85 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for asynchronous logging.
+ */
+#include "logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+std::string TempFile() {
+  char name[] = "/tmp/logging_test.XXXXXX";
+  close(mkstemp(name));
+  return name;
+}
+
+int CountLines(const std::string &file, const char *containing) {
+  FILE *f = fopen(file.c_str(), "r");
+  if (!f) return -1;
+  char buffer[1024];
+  int count = 0;
+  while (fgets(buffer, sizeof(buffer), f)) {
+    if (strstr(buffer, containing)) ++count;
+  }
+  fclose(f);
+  return count;
+}
+}  // namespace
+
+TEST(Logging, AsyncMessagesWrittenWhenStopped) {
+  const std::string file = TempFile();
+  Log_init(file.c_str());
+  Log_start_async();
+  Log_info("first %d", 1);
+  Log_error("second %s", "message");
+  Log_stop_async();
+  EXPECT_EQ(1, CountLines(file, "first 1"));
+  EXPECT_EQ(1, CountLines(file, "second message"));
+  unlink(file.c_str());
+}
+
+TEST(Logging, AsyncRateLimitPerStatement) {
+  const std::string file = TempFile();
+  Log_init(file.c_str());
+  const unsigned long dropped_before = Log_dropped_messages();
+  Log_start_async();
+  for (int i = 0; i < 3 * LOG_RATE_LIMIT; ++i) {
+    Log_info("repeated %d", i);
+  }
+  Log_info("other statement");
+  Log_stop_async();
+
+  // Unless we crossed into the next second, only the first ones are logged.
+  const int written = CountLines(file, "repeated");
+  EXPECT_GE(written, LOG_RATE_LIMIT);
+  EXPECT_LE(written, 2 * LOG_RATE_LIMIT);
+  EXPECT_EQ(3 * LOG_RATE_LIMIT - written,
+            (int)(Log_dropped_messages() - dropped_before));
+  EXPECT_EQ(1, CountLines(file, "repeated 0"));
+  EXPECT_EQ(1, CountLines(file, "other statement"));
+  EXPECT_GE(CountLines(file, "dropped"), 1);
+  unlink(file.c_str());
+}
+
+TEST(Logging, AsyncLongMessagesTruncated) {
+  const std::string file = TempFile();
+  Log_init(file.c_str());
+  Log_start_async();
+  const std::string long_message(2 * LOG_MESSAGE_LEN, 'x');
+  Log_info("%s", long_message.c_str());
+  Log_stop_async();
+  EXPECT_EQ(1, CountLines(file, std::string(LOG_MESSAGE_LEN - 1, 'x').c_str()));
+  EXPECT_EQ(0, CountLines(file, std::string(LOG_MESSAGE_LEN, 'x').c_str()));
+  unlink(file.c_str());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,153 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Files might be larger than 2GB, even on 32 bit systems. Only used
+// inside this translation unit, the interface uses int64_t.
+#define _FILE_OFFSET_BITS 64
+
+#include "mmap-line-reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "logging.h"
+
+static size_t page_size() {
+  static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+  return kPageSize;
+}
+
+MMapLineReader::MMapLineReader(size_t window_size)
+  : window_size_(std::max((window_size + page_size() - 1) & ~(page_size() - 1),
+                          2 * page_size())),
+    fd_(-1), file_size_(0), pos_(0), skip_newline_(false),
+    map_(NULL), map_offset_(0), map_len_(0), read_ahead_pos_(0) {
+}
+
+MMapLineReader::~MMapLineReader() { Close(); }
+
+bool MMapLineReader::Map(int fd) {
+  Close();
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+  fd_ = fd;
+  file_size_ = st.st_size;
+  pos_ = 0;
+  skip_newline_ = false;
+  read_ahead_pos_ = 0;
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return file_size_ == 0 || MapWindowAt(0);
+}
+
+void MMapLineReader::Close() {
+  if (map_) munmap((void*)map_, map_len_);
+  map_ = NULL;
+  map_len_ = 0;
+  fd_ = -1;
+  file_size_ = 0;
+  pos_ = 0;
+}
+
+bool MMapLineReader::MapWindowAt(int64_t pos) {
+  if (map_ && pos >= map_offset_ && pos < map_offset_ + (int64_t)map_len_)
+    return true;
+  if (map_) munmap((void*)map_, map_len_);
+  map_offset_ = pos & ~(int64_t)(page_size() - 1);
+  map_len_ = std::min((int64_t)window_size_, file_size_ - map_offset_);
+  void *m = mmap(NULL, map_len_, PROT_READ, MAP_PRIVATE, fd_, map_offset_);
+  if (m == MAP_FAILED) {
+    Log_error("mmap() of %zu bytes at %lld: %s", map_len_,
+              (long long)map_offset_, strerror(errno));
+    map_ = NULL;
+    map_len_ = 0;
+    return false;
+  }
+  map_ = (const char*) m;
+  madvise(m, map_len_, MADV_SEQUENTIAL);
+  return true;
+}
+
+// Once we're half way through the current window, ask the kernel to get
+// the next one from disk, so that we never wait for it.
+void MMapLineReader::ReadAhead() {
+  const int64_t window_end = map_offset_ + map_len_;
+  if (read_ahead_pos_ >= window_end + (int64_t)window_size_ ||
+      pos_ < map_offset_ + (int64_t)map_len_ / 2)
+    return;
+  read_ahead_pos_ = std::max(read_ahead_pos_, window_end);
+  posix_fadvise(fd_, read_ahead_pos_, window_size_, POSIX_FADV_WILLNEED);
+  read_ahead_pos_ += window_size_;
+}
+
+bool MMapLineReader::ReadLine(StringPiece *line) {
+  if (fd_ < 0) return false;
+  if (skip_newline_) {
+    skip_newline_ = false;
+    if (pos_ < file_size_ && MapWindowAt(pos_) &&
+        map_[pos_ - map_offset_] == '\n') {
+      ++pos_;
+    }
+  }
+  if (pos_ >= file_size_ || !MapWindowAt(pos_))
+    return false;
+
+  for (;;) {
+    const char *const start = map_ + (pos_ - map_offset_);
+    const char *const end = map_ + map_len_;
+    const char *eol = start;
+    while (eol < end && *eol != '\n' && *eol != '\r')
+      ++eol;
+    if (eol < end) {
+      line->assign(start, eol - start);
+      skip_newline_ = (*eol == '\r');
+      pos_ += eol - start + 1;
+      ReadAhead();
+      return true;
+    }
+
+    const bool window_at_file_end = map_offset_ + (int64_t)map_len_ >= file_size_;
+    // If the window already starts at the page of this line, remapping does
+    // not gain anything.
+    const bool line_exceeds_window
+      = map_offset_ == (pos_ & ~(int64_t)(page_size() - 1));
+    if (window_at_file_end || line_exceeds_window) {
+      // Last line without newline, or one we can't fit; return what we have.
+      if (line_exceeds_window && !window_at_file_end) {
+        Log_error("Line at file offset %lld longer than %zu bytes; splitting.",
+                  (long long)pos_, window_size_);
+      }
+      line->assign(start, end - start);
+      pos_ += end - start;
+      return true;
+    }
+
+    // The line continues beyond the window. Map starting at this line.
+    munmap((void*)map_, map_len_);
+    map_ = NULL;
+    if (!MapWindowAt(pos_))
+      return false;
+  }
+}
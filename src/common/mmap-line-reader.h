@@ -0,0 +1,72 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_MMAP_LINE_READER_H
+#define _BEAGLEG_MMAP_LINE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "string-util.h"
+
+// Reads lines from a regular file by memory mapping it, so lines are
+// returned as StringPiece pointing into the page cache without copying.
+//
+// Only a window of the file is mapped at a time, so this works with files
+// larger than the address space. The kernel is asked to read ahead the next
+// window while we're still working on the current one.
+class MMapLineReader {
+public:
+  // "window_size" is rounded up to a multiple of the page size, at least
+  // two pages. Lines longer than window_size minus a page are split.
+  explicit MMapLineReader(size_t window_size = 16 << 20);
+  ~MMapLineReader();
+
+  // Start reading from the regular file "fd". Does not take ownership.
+  // Returns false if it can't be mapped.
+  bool Map(int fd);
+
+  // Unmap. Called on destruction.
+  void Close();
+
+  // Get the next line without the newline character(s). Line endings are
+  // "\n", "\r\n" or "\r". The last line does not need a line ending.
+  // The line is valid until the next call of ReadLine().
+  // Returns false at the end of the file.
+  bool ReadLine(StringPiece *line);
+
+  bool AtEnd() const { return pos_ >= file_size_; }
+
+private:
+  // Make sure that the byte at "pos" is mapped.
+  bool MapWindowAt(int64_t pos);
+  void ReadAhead();
+
+  const size_t window_size_;
+  int fd_;
+  int64_t file_size_;
+  int64_t pos_;            // Absolute file position of the next line.
+  bool skip_newline_;      // Last line ended in '\r', skip a following '\n'
+
+  const char *map_;        // Mapped window.
+  int64_t map_offset_;
+  size_t map_len_;
+  int64_t read_ahead_pos_;  // Up to where we've asked for read-ahead.
+};
+
+#endif  // _BEAGLEG_MMAP_LINE_READER_H
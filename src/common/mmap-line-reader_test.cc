@@ -0,0 +1,99 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for reading lines from a memory mapped file.
+ */
+#include "mmap-line-reader.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "logging.h"
+
+// Temporary file with the given content.
+class TempFile {
+public:
+  TempFile(const std::string &content) : f_(tmpfile()) {
+    fwrite(content.data(), 1, content.size(), f_);
+    fflush(f_);
+  }
+  ~TempFile() { fclose(f_); }
+  int fd() { return fileno(f_); }
+
+private:
+  FILE *const f_;
+};
+
+static std::vector<std::string> ReadAll(MMapLineReader *reader) {
+  std::vector<std::string> result;
+  StringPiece line;
+  while (reader->ReadLine(&line)) result.push_back(line.ToString());
+  return result;
+}
+
+TEST(MMapLineReader, line_endings) {
+  TempFile file("G1 X1\nG1 X2\r\nG1 X3\r\rG1 X4");
+  MMapLineReader reader;
+  ASSERT_TRUE(reader.Map(file.fd()));
+  std::vector<std::string> lines = ReadAll(&reader);
+  ASSERT_EQ(5, (int)lines.size());
+  EXPECT_EQ("G1 X1", lines[0]);
+  EXPECT_EQ("G1 X2", lines[1]);
+  EXPECT_EQ("G1 X3", lines[2]);
+  EXPECT_EQ("", lines[3]);
+  EXPECT_EQ("G1 X4", lines[4]);  // Without newline at end of file.
+  EXPECT_TRUE(reader.AtEnd());
+}
+
+TEST(MMapLineReader, lines_crossing_window_boundaries) {
+  // Windows are only two pages; lines of varying length cross these.
+  const size_t page = sysconf(_SC_PAGESIZE);
+  std::string content;
+  std::vector<std::string> expected;
+  for (int i = 0; content.size() < 9 * page; ++i) {
+    expected.push_back(std::string(i % 97, 'a' + i % 26));
+    content.append(expected.back()).append(i % 3 ? "\n" : "\r\n");
+  }
+  TempFile file(content);
+  MMapLineReader reader(2 * page);
+  ASSERT_TRUE(reader.Map(file.fd()));
+  EXPECT_EQ(expected, ReadAll(&reader));
+}
+
+TEST(MMapLineReader, empty_file_and_non_files) {
+  TempFile file("");
+  MMapLineReader reader;
+  ASSERT_TRUE(reader.Map(file.fd()));
+  StringPiece line;
+  EXPECT_FALSE(reader.ReadLine(&line));
+
+  int fd[2];
+  ASSERT_EQ(0, pipe(fd));
+  EXPECT_FALSE(reader.Map(fd[0]));
+  close(fd[0]);
+  close(fd[1]);
+}
+
+TEST(MMapLineReader, overlong_lines_are_split) {
+  const size_t page = sysconf(_SC_PAGESIZE);
+  const std::string overlong(3 * page, 'x');
+  TempFile file("G1 X1\n" + overlong + "\nG1 X2\n");
+  MMapLineReader reader(2 * page);
+  ASSERT_TRUE(reader.Map(file.fd()));
+  std::vector<std::string> lines = ReadAll(&reader);
+  ASSERT_LE(3, (int)lines.size());
+  EXPECT_EQ("G1 X1", lines.front());
+  EXPECT_EQ("G1 X2", lines.back());
+  std::string joined;
+  for (size_t i = 1; i < lines.size() - 1; ++i) joined += lines[i];
+  EXPECT_EQ(overlong, joined);  // Nothing lost.
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/stderr");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
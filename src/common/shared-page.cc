@@ -0,0 +1,147 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shared-page.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <new>
+
+#include "logging.h"
+
+// The payload follows the header.
+static void *payload(SharedPageHeader *header) {
+  return (char *) header + sizeof(*header);
+}
+static const void *payload(const SharedPageHeader *header) {
+  return (const char *) header + sizeof(*header);
+}
+
+SharedPageWriter::SharedPageWriter()
+  : size_(0), header_(nullptr), mapping_(nullptr), mapping_size_(0) {}
+
+SharedPageWriter::~SharedPageWriter() {
+  if (!mapping_) return;
+  munmap(mapping_, mapping_size_);
+  shm_unlink(name_.c_str());
+}
+
+bool SharedPageWriter::Create(const char *name, size_t size) {
+  // Whatever a previous run left behind was written by someone else.
+  shm_unlink(name);
+  const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    Log_error("Can't create shared memory %s: %s", name, strerror(errno));
+    return false;
+  }
+  // The umask might have taken away read access for others.
+  fchmod(fd, 0644);
+  const size_t mapping_size = sizeof(SharedPageHeader) + size;
+  if (ftruncate(fd, mapping_size) < 0) {
+    Log_error("Can't size shared memory %s: %s", name, strerror(errno));
+    close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    Log_error("Can't map shared memory %s: %s", name, strerror(errno));
+    shm_unlink(name);
+    return false;
+  }
+  name_ = name;
+  size_ = size;
+  mapping_ = mapping;
+  mapping_size_ = mapping_size;
+  header_ = new (mapping) SharedPageHeader();  // Zeroed by ftruncate().
+  header_->size = size;
+  return true;
+}
+
+void SharedPageWriter::Publish(const void *data) {
+  const uint32_t seq = header_->sequence.load(std::memory_order_relaxed);
+  header_->sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(payload(header_), data, size_);
+  header_->sequence.store(seq + 2, std::memory_order_release);
+}
+
+SharedPageReader::SharedPageReader()
+  : size_(0), header_(nullptr), mapping_(nullptr), mapping_size_(0) {}
+
+SharedPageReader::~SharedPageReader() {
+  if (mapping_) munmap(mapping_, mapping_size_);
+}
+
+bool SharedPageReader::Open(const char *name, size_t size) {
+  const int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    Log_error("Can't open shared memory %s: %s", name, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SharedPageHeader)) {
+    Log_error("Shared memory %s is not initialized.", name);
+    close(fd);
+    return false;
+  }
+  void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    Log_error("Can't map shared memory %s: %s", name, strerror(errno));
+    return false;
+  }
+  const SharedPageHeader *header = (const SharedPageHeader *) mapping;
+  if (header->size < size
+      || sizeof(SharedPageHeader) + header->size > (size_t)st.st_size) {
+    Log_error("Shared memory %s has %u bytes, expected at least %u.",
+              name, header->size, (unsigned) size);
+    munmap(mapping, st.st_size);
+    return false;
+  }
+  if (mapping_) munmap(mapping_, mapping_size_);
+  size_ = size;
+  header_ = header;
+  mapping_ = mapping;
+  mapping_size_ = st.st_size;
+  return true;
+}
+
+bool SharedPageReader::Read(void *data, int max_tries) const {
+  for (int i = 0; i < max_tries; ++i) {
+    const uint32_t before = header_->sequence.load(std::memory_order_acquire);
+    if (before & 1) continue;   // Update in progress.
+    memcpy(data, payload(header_), size_);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->sequence.load(std::memory_order_relaxed) == before)
+      return true;
+  }
+  return false;
+}
+
+uint32_t SharedPageReader::sequence() const {
+  return header_->sequence.load(std::memory_order_acquire);
+}
@@ -0,0 +1,86 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_SHARED_PAGE_H_
+#define _BEAGLEG_SHARED_PAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+// Beginning of the POSIX shared memory object, followed by the payload.
+// The sequence number is a seqlock: odd while the writer updates the
+// payload, incremented again when done. Readers copy the payload and take
+// it if the sequence was the same even number before and after.
+struct SharedPageHeader {
+  std::atomic<uint32_t> sequence;
+  uint32_t size;  // of the payload.
+};
+
+// Publishes a small struct in shared memory, e.g. "/dev/shm/<name>", that
+// other processes on the same machine read without locks; neither side
+// does a system call for an update.
+// There must be only one writer.
+class SharedPageWriter {
+public:
+  SharedPageWriter();
+  ~SharedPageWriter();   // Unmaps and removes the shared memory object.
+
+  // Create shared memory object "name" (with leading slash, see
+  // shm_overview(7)) for a payload of "size" bytes, readable by everyone.
+  // Returns false if it can't be created.
+  bool Create(const char *name, size_t size);
+
+  // Copy "size" bytes from "data" to the page.
+  void Publish(const void *data);
+
+private:
+  std::string name_;
+  size_t size_;
+  SharedPageHeader *header_;
+  void *mapping_;
+  size_t mapping_size_;
+};
+
+// Reads the page published by a SharedPageWriter.
+class SharedPageReader {
+public:
+  SharedPageReader();
+  ~SharedPageReader();
+
+  // Map the shared memory object "name" read-only. Returns false if it does
+  // not exist or its payload is smaller than "size".
+  bool Open(const char *name, size_t size);
+
+  // Copy a consistent payload of "size" bytes to "data". Returns false if
+  // the writer was busy every time in "max_tries" attempts.
+  bool Read(void *data, int max_tries = 1000) const;
+
+  // Sequence number of the last update; only changes if there was one.
+  uint32_t sequence() const;
+
+private:
+  size_t size_;
+  const SharedPageHeader *header_;
+  void *mapping_;
+  size_t mapping_size_;
+};
+
+#endif  // _BEAGLEG_SHARED_PAGE_H_
@@ -0,0 +1,94 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the shared memory page.
+ */
+#include "shared-page.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "logging.h"
+
+namespace {
+struct Payload {
+  uint32_t values[64];
+};
+
+std::string TestPageName() {
+  return "/beagleg-shared-page-test-" + std::to_string(getpid());
+}
+}  // namespace
+
+TEST(SharedPage, ReaderSeesPublishedPayload) {
+  const std::string name = TestPageName();
+  SharedPageReader reader;
+  EXPECT_FALSE(reader.Open(name.c_str(), sizeof(Payload)));
+
+  Payload payload = {};
+  {
+    SharedPageWriter writer;
+    ASSERT_TRUE(writer.Create(name.c_str(), sizeof(Payload)));
+    EXPECT_FALSE(reader.Open(name.c_str(), sizeof(Payload) + 1));
+    ASSERT_TRUE(reader.Open(name.c_str(), sizeof(Payload)));
+
+    Payload read = {};
+    ASSERT_TRUE(reader.Read(&read));   // All zero before the first update.
+    EXPECT_EQ(0u, read.values[0]);
+
+    const uint32_t before = reader.sequence();
+    payload.values[0] = 42;
+    payload.values[63] = 4711;
+    writer.Publish(&payload);
+    EXPECT_NE(before, reader.sequence());
+    ASSERT_TRUE(reader.Read(&read));
+    EXPECT_EQ(42u, read.values[0]);
+    EXPECT_EQ(4711u, read.values[63]);
+  }
+
+  // Removed with the writer.
+  SharedPageReader late_reader;
+  EXPECT_FALSE(late_reader.Open(name.c_str(), sizeof(Payload)));
+}
+
+TEST(SharedPage, ReadsAreConsistentWhileWriting) {
+  const std::string name = TestPageName();
+  SharedPageWriter writer;
+  ASSERT_TRUE(writer.Create(name.c_str(), sizeof(Payload)));
+  SharedPageReader reader;
+  ASSERT_TRUE(reader.Open(name.c_str(), sizeof(Payload)));
+
+  std::atomic<bool> done(false);
+  std::thread writer_thread([&]() {
+      Payload payload;
+      for (uint32_t i = 1; i <= 200000; ++i) {
+        for (uint32_t &v : payload.values) v = i;
+        writer.Publish(&payload);
+      }
+      done = true;
+    });
+
+  // Every value of a successful read comes from the same update.
+  int reads = 0;
+  uint32_t last = 0;
+  while (!done) {
+    Payload read;
+    if (!reader.Read(&read)) continue;
+    ++reads;
+    for (uint32_t v : read.values) ASSERT_EQ(read.values[0], v);
+    ASSERT_GE(read.values[0], last);
+    last = read.values[0];
+  }
+  writer_thread.join();
+  EXPECT_GT(reads, 0);
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2015 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BEAGLEG_SPSC_RING_H_
+#define _BEAGLEG_SPSC_RING_H_
+
+#include <stddef.h>
+
+#include <atomic>
+
+// A fixed size, compile-time allocated ring buffer that is safe to be used
+// without locks between exactly one producer thread and one consumer thread.
+// Can hold up to CAPACITY - 1 elements.
+//
+// Elements are written and read in place: the producer gets a slot with
+// write_slot(), fills it and publishes it with commit_write(); the consumer
+// looks at it with read_slot() and hands it back with commit_read().
+template <typename T, int CAPACITY>
+class SPSCRing {
+public:
+  SPSCRing() : write_pos_(0), read_pos_(0) {}
+
+  // -- Producer side.
+
+  // Return the next slot to write or NULL if ring is full.
+  T *write_slot() {
+    const unsigned w = write_pos_.load(std::memory_order_relaxed);
+    if ((w + 1) % CAPACITY == read_pos_.load(std::memory_order_acquire))
+      return NULL;
+    return &buffer_[w];
+  }
+
+  // Make the element previously returned by write_slot() visible to the
+  // consumer.
+  void commit_write() {
+    const unsigned w = write_pos_.load(std::memory_order_relaxed);
+    write_pos_.store((w + 1) % CAPACITY, std::memory_order_release);
+  }
+
+  // -- Consumer side.
+
+  // Return the oldest element or NULL if the ring is empty.
+  T *read_slot() {
+    const unsigned r = read_pos_.load(std::memory_order_relaxed);
+    if (r == write_pos_.load(std::memory_order_acquire))
+      return NULL;
+    return &buffer_[r];
+  }
+
+  // Release element previously returned by read_slot() to the producer.
+  void commit_read() {
+    const unsigned r = read_pos_.load(std::memory_order_relaxed);
+    read_pos_.store((r + 1) % CAPACITY, std::memory_order_release);
+  }
+
+  // Note, only a snapshot if called while the other side is active.
+  bool empty() const {
+    return read_pos_.load(std::memory_order_acquire)
+      == write_pos_.load(std::memory_order_acquire);
+  }
+
+private:
+  T buffer_[CAPACITY];
+  std::atomic<unsigned> write_pos_;
+  std::atomic<unsigned> read_pos_;
+};
+
+#endif // _BEAGLEG_SPSC_RING_H_
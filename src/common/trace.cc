@@ -0,0 +1,181 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include "logging.h"
+
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0,
+              "TRACE_RING_SIZE needs to be a power of two");
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord is written as-is");
+
+// A thread block in the trace file: this header, followed by "count"
+// TraceRecords.
+struct TraceFileBlock {
+  uint32_t magic;
+  int32_t tid;
+  uint32_t count;
+};
+static const uint32_t kTraceMagic = 0x52544742;  // "BGTR"
+
+namespace {
+// Written only by its thread; read by Trace_write() from any thread.
+struct TraceBuffer {
+  int tid;
+  std::atomic<uint64_t> count;   // Number of events ever recorded.
+  TraceRecord records[TRACE_RING_SIZE];
+};
+
+// Buffers of all threads that ever recorded. Never freed, so that events of
+// threads that are already gone still make it into the trace.
+std::mutex buffers_mutex;
+std::vector<TraceBuffer*> *buffers = NULL;
+
+thread_local TraceBuffer *thread_buffer = NULL;
+
+TraceBuffer *NewThreadBuffer() {
+  TraceBuffer *buffer = new TraceBuffer();
+  buffer->tid = syscall(SYS_gettid);
+  buffer->count.store(0);
+  std::lock_guard<std::mutex> l(buffers_mutex);
+  if (buffers == NULL) buffers = new std::vector<TraceBuffer*>();
+  buffers->push_back(buffer);
+  return buffer;
+}
+
+// Copy the events still in the ring, oldest first.
+void CopyEvents(const TraceBuffer *buffer, std::vector<TraceRecord> *out) {
+  const uint64_t end = buffer->count.load(std::memory_order_acquire);
+  uint64_t begin = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+  out->clear();
+  for (uint64_t i = begin; i < end; ++i)
+    out->push_back(buffer->records[i & (TRACE_RING_SIZE - 1)]);
+
+  // While we copied, the thread might have overwritten the oldest ones.
+  const uint64_t now = buffer->count.load(std::memory_order_acquire);
+  if (now > TRACE_RING_SIZE && now - TRACE_RING_SIZE > begin) {
+    const uint64_t overwritten = now - TRACE_RING_SIZE - begin;
+    out->erase(out->begin(),
+               out->begin() + std::min<uint64_t>(overwritten, out->size()));
+  }
+}
+}  // namespace
+
+namespace trace_internal {
+std::atomic<bool> enabled(false);
+
+void Record(TraceEvent event, TracePhase phase, uint32_t arg) {
+  if (thread_buffer == NULL) thread_buffer = NewThreadBuffer();
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  const uint64_t index = thread_buffer->count.load(std::memory_order_relaxed);
+  TraceRecord *r = &thread_buffer->records[index & (TRACE_RING_SIZE - 1)];
+  r->time_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  r->arg = arg;
+  r->event = (uint8_t)event;
+  r->phase = (uint8_t)phase;
+  r->reserved = 0;
+  thread_buffer->count.store(index + 1, std::memory_order_release);
+}
+}  // namespace trace_internal
+
+void Trace_enable(bool on) {
+  trace_internal::enabled.store(on);
+}
+
+bool Trace_write(const char *filename) {
+  FILE *out = fopen(filename, "wb");
+  if (!out) {
+    Log_error("Can't open trace file %s: %s", filename, strerror(errno));
+    return false;
+  }
+  std::vector<TraceBuffer*> all_buffers;
+  {
+    std::lock_guard<std::mutex> l(buffers_mutex);
+    if (buffers) all_buffers = *buffers;
+  }
+  bool success = true;
+  std::vector<TraceRecord> records;
+  for (const TraceBuffer *buffer : all_buffers) {
+    CopyEvents(buffer, &records);
+    const TraceFileBlock block = { kTraceMagic, buffer->tid,
+                                   (uint32_t)records.size() };
+    success &= fwrite(&block, sizeof(block), 1, out) == 1;
+    if (!records.empty()) {
+      success &= (fwrite(records.data(), sizeof(TraceRecord), records.size(),
+                         out) == records.size());
+    }
+  }
+  success &= (fclose(out) == 0);
+  if (!success)
+    Log_error("Writing trace file %s: %s", filename, strerror(errno));
+  return success;
+}
+
+bool Trace_read(const char *filename, std::vector<TraceThread> *threads) {
+  FILE *in = fopen(filename, "rb");
+  if (!in) {
+    Log_error("Can't open trace file %s: %s", filename, strerror(errno));
+    return false;
+  }
+  threads->clear();
+  bool success = true;
+  TraceFileBlock block;
+  while (fread(&block, sizeof(block), 1, in) == 1) {
+    if (block.magic != kTraceMagic) {
+      Log_error("%s: not a trace file.", filename);
+      success = false;
+      break;
+    }
+    threads->push_back(TraceThread());
+    TraceThread *thread = &threads->back();
+    thread->tid = block.tid;
+    thread->records.resize(block.count);
+    if (block.count > 0 &&
+        fread(thread->records.data(), sizeof(TraceRecord), block.count, in)
+        != block.count) {
+      Log_error("%s: truncated trace file.", filename);
+      success = false;
+      break;
+    }
+  }
+  fclose(in);
+  return success;
+}
+
+const char *Trace_event_name(uint8_t event) {
+  switch ((TraceEvent)event) {
+  case TraceEvent::PARSE_LINE:       return "parse-line";
+  case TraceEvent::PLANNER_MOVE:     return "planner-move";
+  case TraceEvent::SEGMENT_SPLIT:    return "segment-split";
+  case TraceEvent::QUEUE_ENQUEUE:    return "queue-enqueue";
+  case TraceEvent::QUEUE_WAIT_EMPTY: return "queue-wait-empty";
+  case TraceEvent::NUM_EVENTS:       break;
+  }
+  return "unknown";
+}
@@ -0,0 +1,117 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BEAGLEG_TRACE_H
+#define BEAGLEG_TRACE_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+// Tracing of events in the hot paths, to see where the time goes under
+// real load. Unlike Log_debug(), this does not format anything or make
+// system calls, so it barely changes the timing it is looking at.
+//
+// Each thread records into its own fixed size ring buffer, keeping the most
+// recent TRACE_RING_SIZE events. Trace_write() dumps all of them into a
+// binary file; the trace2json tool converts that to the Chrome trace format
+// (chrome://tracing or https://ui.perfetto.dev).
+//
+// Nothing is recorded until Trace_enable(); before that, an event only
+// costs a test of a flag.
+
+enum { TRACE_RING_SIZE = 16384 };  // Events per thread; power of two.
+
+enum class TraceEvent : uint8_t {
+  PARSE_LINE,        // Parsing a line of G-code. Arg: line number.
+  PLANNER_MOVE,      // Planner taking a new move. Arg: segments planned.
+  SEGMENT_SPLIT,     // A move split into queue segments. Arg: segments.
+  QUEUE_ENQUEUE,     // Enqueue into the motion queue, including waiting
+                     // for free slots. Arg: segments.
+  QUEUE_WAIT_EMPTY,  // Waiting for the motion queue to be empty.
+  NUM_EVENTS
+};
+
+enum class TracePhase : uint8_t {
+  BEGIN,    // Start of a duration.
+  END,      // End of the duration started last.
+  INSTANT,  // Single point in time.
+};
+
+struct TraceRecord {
+  uint64_t time_ns;   // CLOCK_MONOTONIC
+  uint32_t arg;       // Meaning depends on the event.
+  uint8_t event;      // TraceEvent
+  uint8_t phase;      // TracePhase
+  uint16_t reserved;
+};
+
+// Events recorded by one thread, oldest first.
+struct TraceThread {
+  int tid;
+  std::vector<TraceRecord> records;
+};
+
+// Start or stop recording.
+void Trace_enable(bool on);
+
+// Write the recorded events of all threads to "filename". Can be called
+// while other threads still record; their most recent events might then be
+// missing. Returns false on error.
+bool Trace_write(const char *filename);
+
+// Read a file written by Trace_write(). Returns false on error.
+bool Trace_read(const char *filename, std::vector<TraceThread> *threads);
+
+// Human readable name of the event.
+const char *Trace_event_name(uint8_t event);
+
+namespace trace_internal {
+extern std::atomic<bool> enabled;
+void Record(TraceEvent event, TracePhase phase, uint32_t arg);
+}
+
+inline void Trace_begin(TraceEvent event, uint32_t arg = 0) {
+  if (trace_internal::enabled.load(std::memory_order_relaxed))
+    trace_internal::Record(event, TracePhase::BEGIN, arg);
+}
+inline void Trace_end(TraceEvent event, uint32_t arg = 0) {
+  if (trace_internal::enabled.load(std::memory_order_relaxed))
+    trace_internal::Record(event, TracePhase::END, arg);
+}
+inline void Trace_instant(TraceEvent event, uint32_t arg = 0) {
+  if (trace_internal::enabled.load(std::memory_order_relaxed))
+    trace_internal::Record(event, TracePhase::INSTANT, arg);
+}
+
+// Traces the duration of the scope it lives in.
+class TraceScope {
+public:
+  explicit TraceScope(TraceEvent event, uint32_t arg = 0)
+    : event_(event) {
+    Trace_begin(event, arg);
+  }
+  ~TraceScope() { Trace_end(event_); }
+
+private:
+  const TraceEvent event_;
+};
+
+#endif /* BEAGLEG_TRACE_H */
@@ -0,0 +1,132 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "logging.h"
+
+namespace {
+// Records "count" events in a new thread; returns its thread id.
+int RecordInThread(int count) {
+  int tid = 0;
+  std::thread t([&tid, count]() {
+      tid = syscall(SYS_gettid);
+      for (int i = 0; i < count; ++i) {
+        TraceScope scope(TraceEvent::PARSE_LINE, i);
+        Trace_instant(TraceEvent::SEGMENT_SPLIT, 2);
+      }
+    });
+  t.join();
+  return tid;
+}
+
+const TraceThread *FindThread(const std::vector<TraceThread> &threads,
+                              int tid) {
+  for (const TraceThread &t : threads) {
+    if (t.tid == tid) return &t;
+  }
+  return NULL;
+}
+
+std::string TempFile() {
+  char name[] = "/tmp/trace_test.XXXXXX";
+  close(mkstemp(name));
+  return name;
+}
+}  // namespace
+
+TEST(Trace, NothingRecordedWhenDisabled) {
+  Trace_enable(false);
+  const int tid = RecordInThread(10);
+  const std::string file = TempFile();
+  ASSERT_TRUE(Trace_write(file.c_str()));
+  std::vector<TraceThread> threads;
+  ASSERT_TRUE(Trace_read(file.c_str(), &threads));
+  EXPECT_TRUE(FindThread(threads, tid) == NULL);
+  unlink(file.c_str());
+}
+
+TEST(Trace, EventsOfEachThreadInOrder) {
+  Trace_enable(true);
+  const int first = RecordInThread(3);
+  const int second = RecordInThread(1);
+  Trace_enable(false);
+
+  const std::string file = TempFile();
+  ASSERT_TRUE(Trace_write(file.c_str()));
+  std::vector<TraceThread> threads;
+  ASSERT_TRUE(Trace_read(file.c_str(), &threads));
+  unlink(file.c_str());
+
+  const TraceThread *t = FindThread(threads, first);
+  ASSERT_TRUE(t != NULL);
+  ASSERT_EQ(9u, t->records.size());
+  for (int i = 0; i < 3; ++i) {
+    const TraceRecord &begin = t->records[3*i];
+    EXPECT_EQ((uint8_t)TraceEvent::PARSE_LINE, begin.event);
+    EXPECT_EQ((uint8_t)TracePhase::BEGIN, begin.phase);
+    EXPECT_EQ((uint32_t)i, begin.arg);
+    EXPECT_EQ((uint8_t)TracePhase::INSTANT, t->records[3*i + 1].phase);
+    EXPECT_EQ((uint8_t)TracePhase::END, t->records[3*i + 2].phase);
+  }
+  for (size_t i = 1; i < t->records.size(); ++i) {
+    EXPECT_LE(t->records[i-1].time_ns, t->records[i].time_ns);
+  }
+  ASSERT_TRUE(FindThread(threads, second) != NULL);
+  EXPECT_EQ(3u, FindThread(threads, second)->records.size());
+}
+
+TEST(Trace, KeepsMostRecentEvents) {
+  Trace_enable(true);
+  const int tid = RecordInThread(TRACE_RING_SIZE);  // 3x the ring size.
+  Trace_enable(false);
+
+  const std::string file = TempFile();
+  ASSERT_TRUE(Trace_write(file.c_str()));
+  std::vector<TraceThread> threads;
+  ASSERT_TRUE(Trace_read(file.c_str(), &threads));
+  unlink(file.c_str());
+
+  const TraceThread *t = FindThread(threads, tid);
+  ASSERT_TRUE(t != NULL);
+  ASSERT_EQ((size_t)TRACE_RING_SIZE, t->records.size());
+  EXPECT_EQ((uint8_t)TracePhase::END, t->records.back().phase);
+  EXPECT_EQ((uint32_t)TRACE_RING_SIZE - 1,
+            t->records[t->records.size() - 3].arg);
+}
+
+TEST(Trace, EventNames) {
+  EXPECT_STREQ("parse-line", Trace_event_name((uint8_t)TraceEvent::PARSE_LINE));
+  EXPECT_STREQ("unknown", Trace_event_name(200));
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -110,11 +110,12 @@ void ConfigParser::Reader::ReportError(int line_no, const std::string &msg) {
   Log_error("%d: %s", line_no, msg.c_str());
 }
 
-ConfigParser::ConfigParser() : parse_success_(true) {}
+ConfigParser::ConfigParser() : parse_success_(true), tokenized_(false) {}
 
 bool ConfigParser::SetContentFromFile(const char *filename) {
   if (!filename) return false;
   parse_success_ = true;
+  tokenized_ = false;
   std::ifstream file_stream(filename, std::ios::binary);
   content_.assign(std::istreambuf_iterator<char>(file_stream),
                   std::istreambuf_iterator<char>());
@@ -123,6 +124,7 @@ bool ConfigParser::SetContentFromFile(const char *filename) {
 
 void ConfigParser::SetContent(const std::string &content) {
   parse_success_ = true;
+  tokenized_ = false;
   content_ = content;
 }
 
@@ -155,14 +157,8 @@ static std::string CanonicalizeName(const StringPiece &s) {
   return ToLower(TrimWhitespace(s));
 }
 
-bool ConfigParser::EmitConfigValues(Reader *reader) {
-  // The first pass collects all the parse errors and emits them. Later on,
-  // we refuse to run another time.
-  if (!parse_success_)
-    return false;
-  bool success = true;
-  bool current_section_interested = false;
-  std::string current_section;
+void ConfigParser::Tokenize() {
+  entries_.clear();
   int line_no = 0;
   StringPiece content_data(content_.data(), content_.length());
   StringPiece line = NextLine(&content_data);
@@ -172,41 +168,83 @@ bool ConfigParser::EmitConfigValues(Reader *reader) {
     if (line.empty())
       continue;
 
+    Entry entry;
+    entry.line_no = line_no;
     // Sections start with '['
     if (line[0] == '[') {
       if (line[line.length() - 1] != ']') {
-        reader->ReportError(line_no, "Section line does not end in ']'");
-        parse_success_ = false;
-        current_section_interested = false;  // rest is probably bogus.
-        continue;
+        entry.type = Entry::SECTION_ERROR;
+        entry.name = "Section line does not end in ']'";
+      } else {
+        entry.type = Entry::SECTION;
+        entry.name = CanonicalizeName(line.substr(1, line.length() - 2));
       }
-
-      StringPiece section = line.substr(1, line.length() - 2);
-      current_section = CanonicalizeName(section);
-      current_section_interested = reader->SeenSection(line_no, current_section);
     }
     else {
       StringPiece::iterator eq_pos = std::find(line.begin(), line.end(), '=');
       if (eq_pos == line.end()) {
-        reader->ReportError(line_no, "name=value pair expected.");
-        parse_success_ = false;
-        continue;
+        entry.type = Entry::LINE_ERROR;
+        entry.name = "name=value pair expected.";
+      } else {
+        entry.type = Entry::NAME_VALUE;
+        entry.name = CanonicalizeName(StringPiece(line.begin(),
+                                                  eq_pos - line.begin()));
+        entry.value = TrimWhitespace(
+          StringPiece(eq_pos + 1, line.end() - eq_pos - 1)).ToString();
       }
-      if (current_section_interested) {
-        std::string name = CanonicalizeName(StringPiece(line.begin(),
-                                                        eq_pos - line.begin()));
-        StringPiece value_piece
-          = TrimWhitespace(StringPiece(eq_pos + 1, line.end() - eq_pos - 1));
-        std::string value = value_piece.ToString();
-        bool could_parse = reader->SeenNameValue(line_no, name, value);
+    }
+    entries_.push_back(entry);
+  }
+  tokenized_ = true;
+}
+
+bool ConfigParser::EmitConfigValues(Reader *reader) {
+  return EmitConfigValues(std::vector<Reader*>(1, reader));
+}
+
+bool ConfigParser::EmitConfigValues(const std::vector<Reader*> &readers) {
+  // The first pass collects all the parse errors and emits them. Later on,
+  // we refuse to run another time.
+  if (!parse_success_ || readers.empty())
+    return false;
+  if (!tokenized_) Tokenize();
+  bool success = true;
+  // Readers interested in the current section.
+  std::vector<Reader*> interested;
+  std::string current_section;
+  for (const Entry &entry : entries_) {
+    switch (entry.type) {
+    case Entry::SECTION_ERROR:
+      interested.clear();  // rest is probably bogus.
+      // fallthrough
+    case Entry::LINE_ERROR:
+      readers[0]->ReportError(entry.line_no, entry.name);
+      parse_success_ = false;
+      break;
+
+    case Entry::SECTION:
+      current_section = entry.name;
+      interested.clear();
+      for (Reader *reader : readers) {
+        if (reader->SeenSection(entry.line_no, current_section))
+          interested.push_back(reader);
+      }
+      break;
+
+    case Entry::NAME_VALUE:
+      for (Reader *reader : interested) {
+        bool could_parse = reader->SeenNameValue(entry.line_no,
+                                                 entry.name, entry.value);
         if (!could_parse) {
-          reader->ReportError(line_no,
+          reader->ReportError(entry.line_no,
                               StringPrintf("In section [%s]: Couldn't handle '%s = %s'",
                                            current_section.c_str(),
-                                           name.c_str(), value.c_str()));
+                                           entry.name.c_str(),
+                                           entry.value.c_str()));
         }
         success &= could_parse;
       }
+      break;
     }
   }
   return parse_success_ && success;
@@ -76,9 +76,27 @@ public:
   // Reader is not taken over.
   bool EmitConfigValues(Reader *reader);
 
+  // Same, but in one pass over the configuration for all "readers"; each
+  // of them gets the name/values of the sections it is interested in.
+  // Syntax errors are reported to the first reader.
+  bool EmitConfigValues(const std::vector<Reader*> &readers);
+
 private:
+  // A line of the configuration, split up. Done once for all readers.
+  struct Entry {
+    enum Type { SECTION, NAME_VALUE, SECTION_ERROR, LINE_ERROR };
+    Type type;
+    int line_no;
+    std::string name;    // Canonicalized section or name; error message.
+    std::string value;
+  };
+
+  void Tokenize();
+
   std::string content_;
   bool parse_success_;
+  bool tokenized_;
+  std::vector<Entry> entries_;
   std::map<std::string, bool> claimed_sections_;
 };
 #endif // _BEAGLEG_CONFIG_PARSER_H
@@ -69,6 +69,31 @@ TEST(ConfigParserTest, ErrorReporting) {
   EXPECT_FALSE(p.EmitConfigValues(&events));
 }
 
+TEST(ConfigParserTest, OnePassForAllReaders) {
+  ConfigParser p;
+  p.SetContent("[first]\n"
+               "a = 1\n"
+               "[second]\n"
+               "b = 2\n");
+  MockConfigReader one, two;
+  EXPECT_CALL(one, SeenSection(1, "first")).WillOnce(Return(true));
+  EXPECT_CALL(two, SeenSection(1, "first")).WillOnce(Return(false));
+  EXPECT_CALL(one, SeenNameValue(2, "a", "1")).WillOnce(Return(true));
+  EXPECT_CALL(one, SeenSection(3, "second")).WillOnce(Return(true));
+  EXPECT_CALL(two, SeenSection(3, "second")).WillOnce(Return(true));
+  EXPECT_CALL(one, SeenNameValue(4, "b", "2")).WillOnce(Return(true));
+  EXPECT_CALL(two, SeenNameValue(4, "b", "2")).WillOnce(Return(false));
+  EXPECT_CALL(two, ReportError(4, "In section [second]: Couldn't handle 'b = 2'"));
+  EXPECT_FALSE(p.EmitConfigValues({ &one, &two }));
+
+  // Each reader in turn sees the same.
+  MockConfigReader three;
+  EXPECT_CALL(three, SeenSection(1, "first")).WillOnce(Return(false));
+  EXPECT_CALL(three, SeenSection(3, "second")).WillOnce(Return(true));
+  EXPECT_CALL(three, SeenNameValue(4, "b", "2")).WillOnce(Return(true));
+  EXPECT_TRUE(p.EmitConfigValues(&three));
+}
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
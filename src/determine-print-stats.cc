@@ -23,12 +23,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
 
 #include "gcode-parser/gcode-parser.h"
 
 #include "gcode-machine-control.h"
 #include "motor-operations.h"
 #include "hardware-mapping.h"
+#include "planner.h"
 #include "spindle-control.h"
 
 namespace {
@@ -54,6 +60,10 @@ public:
   void wait_temperature() final { delegatee_->wait_temperature(); }
   void motors_enable(bool b) final { delegatee_->motors_enable(b); }
   void go_home(AxisBitmap_t axes) final { /* ignore */ }
+  void input_idle(bool first) final { delegatee_->input_idle(first); }
+  float arc_segment_length(float radius, float feed) final {
+    return delegatee_->arc_segment_length(radius, feed);
+  }
   void inform_origin_offset(const AxesRegister& axes, const char *n) final {
     delegatee_->inform_origin_offset(axes, n);
   }
@@ -96,9 +106,41 @@ private:
   GCodeParser::EventReceiver *const delegatee_;
 };
 
+// Segments ending within this many seconds count towards the segment rate.
+static constexpr double kSegmentRateWindow = 0.1;
+
 class StatsMotorOperations : public MotorOperations {
 public:
-  StatsMotorOperations(BeagleGPrintStats *stats) : print_stats_(stats) {}
+  StatsMotorOperations(BeagleGPrintStats *stats)
+    : print_stats_(stats), planner_stats_(false), motion_time_(0),
+      junction_speed_sum_(0), last_segment_{}, last_max_steps_(0) {
+    bzero(mm_per_step_, sizeof(mm_per_step_));
+  }
+
+  // Also record segment, junction and rate statistics. The axes are mapped
+  // to motors in "hardware", with the steps/mm of "config".
+  void CollectPlannerStats(HardwareMapping *hardware,
+                           const MachineControlConfig &config) {
+    for (const GCodeParserAxis axis : AllAxes()) {
+      const float steps_per_mm = fabsf(config.steps_per_mm[axis]);
+      if (steps_per_mm <= 0) continue;
+      const HardwareMapping::MotorBitmap map = hardware->GetMotorMap(axis);
+      for (int motor = 0; motor < BEAGLEG_NUM_MOTORS; ++motor) {
+        if (map & (1 << motor)) {  // Mirrored motors: only count the first.
+          mm_per_step_[motor] = 1.0 / steps_per_mm;
+          break;
+        }
+      }
+    }
+    planner_stats_ = true;
+  }
+
+  ~StatsMotorOperations() {
+    if (print_stats_->junctions > 0) {
+      print_stats_->avg_junction_speed
+        = junction_speed_sum_ / print_stats_->junctions;
+    }
+  }
 
   void Enqueue(const LinearSegmentSteps &param) final {
     int max_steps = 0;
@@ -109,8 +151,10 @@ public:
     }
 
     // max_steps = a/2*t^2 + v0*t; a = (v1-v0)/t
-    print_stats_->total_time_seconds += 2 * max_steps / (param.v0 + param.v1);
+    const double seconds = 2 * max_steps / (param.v0 + param.v1);
+    print_stats_->total_time_seconds += seconds;
     //printf("HZ:v0=%7.1f v1=%7.1f steps=%d\n", param.v0, param.v1, max_steps);
+    if (planner_stats_) record_planner_stats(param, max_steps, seconds);
   }
 
   void MotorEnable(bool on) final {}
@@ -119,17 +163,209 @@ public:
   void SetExternalPosition(int axis, int pos) final {}
 
 private:
+  // Length of the segment in mm; "dir" is set to the direction.
+  double segment_length(const LinearSegmentSteps &param, double *dir) const {
+    double length_sq = 0;
+    for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+      dir[i] = param.steps[i] * mm_per_step_[i];
+      length_sq += dir[i] * dir[i];
+    }
+    const double length = sqrt(length_sq);
+    if (length > 0) {
+      for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) dir[i] /= length;
+    }
+    return length;
+  }
+
+  void record_planner_stats(const LinearSegmentSteps &param, int max_steps,
+                            double seconds) {
+    print_stats_->segments++;
+    motion_time_ += seconds;
+    segment_ends_.push_back(motion_time_);
+    while (segment_ends_.front() <= motion_time_ - kSegmentRateWindow)
+      segment_ends_.pop_front();
+    print_stats_->peak_segment_rate
+      = std::max(print_stats_->peak_segment_rate,
+                 (float)(segment_ends_.size() / kSegmentRateWindow));
+
+    // The pieces of one planned move all go the same direction, so a
+    // change of direction or a stop is a junction between moves.
+    double dir[BEAGLEG_NUM_MOTORS], last_dir[BEAGLEG_NUM_MOTORS];
+    if (segment_length(param, dir) <= 0) return;
+    if (last_max_steps_ > 0) {
+      const double last_length = segment_length(last_segment_, last_dir);
+      double cos_angle = 0;
+      for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i)
+        cos_angle += dir[i] * last_dir[i];
+      if (cos_angle < 1 - 1e-6 || last_segment_.v1 <= 0) {
+        const float speed = last_segment_.v1 * last_length / last_max_steps_;
+        if (print_stats_->junctions == 0
+            || speed < print_stats_->min_junction_speed) {
+          print_stats_->min_junction_speed = speed;
+        }
+        print_stats_->junctions++;
+        junction_speed_sum_ += speed;
+      }
+    }
+    last_segment_ = param;
+    last_max_steps_ = max_steps;
+  }
+
   BeagleGPrintStats *const print_stats_;
+  bool planner_stats_;
+  double mm_per_step_[BEAGLEG_NUM_MOTORS];
+  double motion_time_;
+  std::deque<double> segment_ends_;
+  double junction_speed_sum_;
+  LinearSegmentSteps last_segment_;
+  int last_max_steps_;
+};
+
+// Lightweight stand-in for the GCodeMachineControl: only the moves are sent
+// to a planner, all timing arrives in the stats of the motor operations.
+// Feedrates and speed factors are handled the same way.
+class PrintTimeEstimator : public GCodeParser::EventReceiver {
+public:
+  PrintTimeEstimator(const MachineControlConfig &config,
+                     BeagleGPrintStats *stats)
+    : cfg_(config), motor_ops_(stats), planner_(nullptr),
+      g0_feedrate_(0), current_feedrate_(-1), prog_speed_factor_(1) {}
+
+  ~PrintTimeEstimator() { delete planner_; }
+
+  bool Init() {
+    for (const GCodeParserAxis axis : AllAxes()) {
+      cfg_.steps_per_mm[axis] = fabsf(cfg_.steps_per_mm[axis]);
+      g0_feedrate_ = std::max(g0_feedrate_, cfg_.max_feedrate[axis]);
+      if (cfg_.steps_per_mm[axis] > 0 && !hardware_.HasMotorFor(axis)) {
+        const int motor = hardware_.GetFirstFreeMotor();
+        if (motor == 0) return false;
+        hardware_.AddMotorMapping(axis, motor, false);
+      }
+    }
+    motor_ops_.CollectPlannerStats(&hardware_, cfg_);
+    planner_ = new Planner(&cfg_, &hardware_, &motor_ops_);
+    return true;
+  }
+
+  void gcode_start(GCodeParser *p) final {}
+  void gcode_finished(bool eos) final { planner_->BringPathToHalt(); }
+  void input_idle(bool is_first) final { planner_->BringPathToHalt(); }
+  void dwell(float value) final { planner_->BringPathToHalt(); }
+  void motors_enable(bool b) final { planner_->BringPathToHalt(); }
+  void set_fanspeed(float speed) final {}
+  void set_temperature(float f) final {}
+  void wait_temperature() final {}
+  void go_home(AxisBitmap_t axes) final {}
+
+  void set_speed_factor(float value) final {
+    if (value < 0) value = 1.0f + value;
+    if (value >= 0.005) prog_speed_factor_ = value;
+  }
+
+  bool coordinated_move(float feed, const AxesRegister &axes) final {
+    if (feed > 0) current_feedrate_ = cfg_.speed_factor * feed;
+    if (current_feedrate_ <= 0) return false;
+    planner_->Enqueue(axes, prog_speed_factor_ * current_feedrate_);
+    return true;
+  }
+
+  bool rapid_move(float feed, const AxesRegister &axes) final {
+    const float given = cfg_.speed_factor * prog_speed_factor_ * feed;
+    if (given > 0 && current_feedrate_ <= 0) current_feedrate_ = given;
+    planner_->Enqueue(axes, given > 0 ? given : g0_feedrate_);
+    return true;
+  }
+
+  float arc_segment_length(float radius, float feed) final {
+    return cfg_.ArcSegmentLength(radius, cfg_.speed_factor * prog_speed_factor_
+                                 * feed);
+  }
+
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    if (letter == 'M' && (int)value == 400) planner_->BringPathToHalt();
+    return NULL;
+  }
+
+private:
+  MachineControlConfig cfg_;
+  HardwareMapping hardware_;  // Never initialized, just sim mode.
+  StatsMotorOperations motor_ops_;
+  Planner *planner_;
+  float g0_feedrate_;
+  float current_feedrate_;
+  float prog_speed_factor_;
+};
+
+// Send parse events to all estimators.
+class BroadcastEventReceiver : public GCodeParser::EventReceiver {
+public:
+  BroadcastEventReceiver(PrintTimeEstimator *const *receivers, int count)
+    : receivers_(receivers), count_(count) {}
+
+  void gcode_start(GCodeParser *p) final {}
+  void gcode_finished(bool eos) final {
+    for (int i = 0; i < count_; ++i) receivers_[i]->gcode_finished(eos);
+  }
+  void input_idle(bool first) final {
+    for (int i = 0; i < count_; ++i) receivers_[i]->input_idle(first);
+  }
+  void set_speed_factor(float f) final {
+    for (int i = 0; i < count_; ++i) receivers_[i]->set_speed_factor(f);
+  }
+  void set_fanspeed(float speed) final {}
+  void set_temperature(float f) final {}
+  void wait_temperature() final {}
+  void go_home(AxisBitmap_t axes) final {}
+  void dwell(float value) final {
+    for (int i = 0; i < count_; ++i) receivers_[i]->dwell(value);
+  }
+  void motors_enable(bool b) final {
+    for (int i = 0; i < count_; ++i) receivers_[i]->motors_enable(b);
+  }
+  bool coordinated_move(float feed, const AxesRegister &axes) final {
+    bool result = true;
+    for (int i = 0; i < count_; ++i)
+      result &= receivers_[i]->coordinated_move(feed, axes);
+    return result;
+  }
+  bool rapid_move(float feed, const AxesRegister &axes) final {
+    for (int i = 0; i < count_; ++i) receivers_[i]->rapid_move(feed, axes);
+    return true;
+  }
+  // The parser creates one set of segments for all of them, so we use the
+  // finest of all configurations.
+  float arc_segment_length(float radius, float feed) final {
+    float result = -1;
+    for (int i = 0; i < count_; ++i) {
+      const float length = receivers_[i]->arc_segment_length(radius, feed);
+      if (result < 0 || length < result) result = length;
+    }
+    return result;
+  }
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    for (int i = 0; i < count_; ++i)
+      receivers_[i]->unprocessed(letter, value, rest);
+    return NULL;
+  }
+
+private:
+  PrintTimeEstimator *const *const receivers_;
+  const int count_;
 };
 }
 
-bool determine_print_stats(int input_fd, const MachineControlConfig &config,
-                           FILE *msg_out,
-                           struct BeagleGPrintStats *result) {
+static void init_stats(struct BeagleGPrintStats *result) {
   bzero(result, sizeof(*result));
   result->x_min = 1e7;
   result->y_min = 1e7;
-  result->y_min = 1e7;
+  result->z_min = 1e7;
+}
+
+bool determine_print_stats(int input_fd, const MachineControlConfig &config,
+                           FILE *msg_out,
+                           struct BeagleGPrintStats *result) {
+  init_stats(result);
   HardwareMapping hardware;  // We never initialize, just sim mode.
 
   // Motor control that just determines the time spent turning the motor.
@@ -141,6 +377,7 @@ bool determine_print_stats(int input_fd, const MachineControlConfig &config,
                                   &hardware, nullptr, nullptr);
   if (!machine_control)
     return false;
+  stats_motor_ops.CollectPlannerStats(&hardware, config);
 
   // We intercept gcode events to update some stats, then pass on to
   // machine event receiver.
@@ -155,3 +392,45 @@ bool determine_print_stats(int input_fd, const MachineControlConfig &config,
   delete machine_control;
   return success;
 }
+
+bool estimate_print_stats(int input_fd,
+                          const MachineControlConfig *const *configs,
+                          int count,
+                          FILE *msg_out,
+                          struct BeagleGPrintStats *results) {
+  // Dwell time and coordinates are the same for all, we collect them in
+  // 'common'; each estimator adds the time of its moves to its result.
+  struct BeagleGPrintStats common;
+  init_stats(&common);
+  std::vector<PrintTimeEstimator*> estimators;
+  bool success = true;
+  for (int i = 0; i < count; ++i) {
+    bzero(&results[i], sizeof(results[i]));
+    estimators.push_back(new PrintTimeEstimator(*configs[i], &results[i]));
+    success &= estimators.back()->Init();
+  }
+  if (success) {
+    BroadcastEventReceiver broadcast(estimators.data(), count);
+    StatsCollectingEventDelegator stats_event_receiver(&common, &broadcast);
+    GCodeParser::Config parser_cfg;
+    GCodeParser::Config::ParamMap parameters;
+    parser_cfg.parameters = &parameters;
+    GCodeParser parser(parser_cfg, &stats_event_receiver);
+    success = parser.ReadFile(fdopen(input_fd, "r"), msg_out)
+      && parser.error_count() == 0;
+  } else {
+    close(input_fd);
+  }
+  for (int i = 0; i < count; ++i) {
+    delete estimators[i];   // Destructor of planner flushes remaining moves.
+    const BeagleGPrintStats moves = results[i];
+    results[i] = common;
+    results[i].total_time_seconds += moves.total_time_seconds;
+    results[i].segments = moves.segments;
+    results[i].junctions = moves.junctions;
+    results[i].min_junction_speed = moves.min_junction_speed;
+    results[i].avg_junction_speed = moves.avg_junction_speed;
+    results[i].peak_segment_rate = moves.peak_segment_rate;
+  }
+  return success;
+}
@@ -31,6 +31,12 @@ struct BeagleGPrintStats {
   float last_z_extruding;        // Last z with extrusion = printed height.
   float filament_len;            // total filament length
 
+  // Planner behavior.
+  int segments;                  // Motion segments sent to the motors.
+  int junctions;                 // Direction changes between segments.
+  float min_junction_speed;      // mm/s at these junctions.
+  float avg_junction_speed;
+  float peak_segment_rate;       // Segments/s the queue must take at most.
 };
 
 // Given the input file-descriptor (which is read to EOF and then closed)
@@ -40,4 +46,17 @@ bool determine_print_stats(int input_fd,
                            const MachineControlConfig &config,
                            FILE *msg_out,
                            struct BeagleGPrintStats *result);
+
+// Estimate the statistics for "count" machine configurations in a single
+// pass over the file; results[i] is for configs[i].
+// Instead of a full machine control, only a planner per configuration is
+// run. The time is the same for regular G-code; M-codes are not interpreted
+// beyond M400 (so the rest of a block after an M-code is ignored), and
+// collinear-tolerance is not applied. With several configurations, arcs are
+// cut into segments as fine as needed for any of them.
+bool estimate_print_stats(int input_fd,
+                          const MachineControlConfig *const *configs,
+                          int count,
+                          FILE *msg_out,
+                          struct BeagleGPrintStats *results);
 #endif // _BEAGLEG_DETERMINE_PRINT_STATS_H
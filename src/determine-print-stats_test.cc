@@ -0,0 +1,111 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for print time estimation.
+ */
+#include "determine-print-stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "gcode-machine-control.h"
+
+static const char kGCode[] =
+  "G21 G90\n"
+  "G1 X10 Y10 F3000\n"
+  "G1 X20 Y5 E1\n"
+  "G2 X30 Y5 I5 J0\n"
+  "G4 P500\n"
+  "M220 S50\n"
+  "G0 X0 Y0 Z5\n"
+  "M400\n"
+  "G1 X50 F6000\n";
+
+// Write the G-code to a temporary file and return an open descriptor.
+static int GCodeFd() {
+  char tmpl[] = "/tmp/print-stats-test.XXXXXX";
+  const int fd = mkstemp(tmpl);
+  unlink(tmpl);
+  if (write(fd, kGCode, sizeof(kGCode) - 1) != (ssize_t)sizeof(kGCode) - 1)
+    return -1;
+  lseek(fd, 0, SEEK_SET);
+  return fd;
+}
+
+static void InitConfig(MachineControlConfig *config, float accel) {
+  for (const GCodeParserAxis axis : { AXIS_X, AXIS_Y, AXIS_Z, AXIS_E }) {
+    config->steps_per_mm[axis] = 100;
+    config->max_feedrate[axis] = 200;
+    config->acceleration[axis] = accel;
+  }
+  config->require_homing = false;
+  config->range_check = false;
+  config->threshold_angle = 10;
+}
+
+// The estimate gives the same results as running the full machine control.
+TEST(PrintStats, EstimateAsFullMachineControl) {
+  MachineControlConfig config;
+  InitConfig(&config, 1000);
+  BeagleGPrintStats full;
+  ASSERT_TRUE(determine_print_stats(GCodeFd(), config, NULL, &full));
+
+  const MachineControlConfig *configs[] = { &config };
+  BeagleGPrintStats estimate;
+  ASSERT_TRUE(estimate_print_stats(GCodeFd(), configs, 1, NULL, &estimate));
+
+  EXPECT_GT(full.total_time_seconds, 0.5);   // At least the dwell.
+  EXPECT_NEAR(full.total_time_seconds, estimate.total_time_seconds, 1e-4);
+  EXPECT_FLOAT_EQ(full.x_max, estimate.x_max);
+  EXPECT_FLOAT_EQ(0, estimate.x_min);
+  EXPECT_FLOAT_EQ(50, estimate.x_max);
+  EXPECT_FLOAT_EQ(0, estimate.z_min);
+  EXPECT_FLOAT_EQ(5, estimate.z_max);
+  EXPECT_FLOAT_EQ(1, estimate.filament_len);
+}
+
+// Several machines in one go; each gets its own time.
+TEST(PrintStats, EstimateMultipleConfigs) {
+  MachineControlConfig slow, fast;
+  InitConfig(&slow, 100);
+  InitConfig(&fast, 1000);
+  const MachineControlConfig *configs[] = { &slow, &fast };
+  BeagleGPrintStats results[2];
+  ASSERT_TRUE(estimate_print_stats(GCodeFd(), configs, 2, NULL, results));
+  EXPECT_GT(results[0].total_time_seconds, results[1].total_time_seconds);
+
+  BeagleGPrintStats single;
+  ASSERT_TRUE(estimate_print_stats(GCodeFd(), &configs[1], 1, NULL, &single));
+  EXPECT_FLOAT_EQ(single.total_time_seconds, results[1].total_time_seconds);
+  EXPECT_FLOAT_EQ(single.z_max, results[0].z_max);
+}
+
+// Each estimated configuration reports how its planner joins the moves.
+TEST(PrintStats, PlannerStats) {
+  MachineControlConfig corner_stop, junction;
+  InitConfig(&corner_stop, 1000);
+  corner_stop.threshold_angle = 0;
+  InitConfig(&junction, 1000);
+  junction.junction_deviation = 0.05;
+  const MachineControlConfig *configs[] = { &corner_stop, &junction };
+  BeagleGPrintStats results[2];
+  ASSERT_TRUE(estimate_print_stats(GCodeFd(), configs, 2, NULL, results));
+  for (const BeagleGPrintStats &r : results) {
+    EXPECT_GT(r.segments, r.junctions);
+    EXPECT_GT(r.junctions, 3);
+    EXPECT_GT(r.peak_segment_rate, 0);
+    EXPECT_LE(r.min_junction_speed, r.avg_junction_speed);
+  }
+  // The junction deviation keeps going where the angle threshold stops.
+  EXPECT_FLOAT_EQ(0, results[0].min_junction_speed);
+  EXPECT_LT(results[0].avg_junction_speed, results[1].avg_junction_speed);
+  EXPECT_LT(results[1].total_time_seconds, results[0].total_time_seconds);
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
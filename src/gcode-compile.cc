@@ -0,0 +1,118 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Parse G-code once and write the resulting parse events as precompiled
+// G-code, which machine-control replays without parsing.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/logging.h"
+#include "config-parser.h"
+#include "gcode-machine-control.h"
+#include "gcode-parser/compiled-gcode.h"
+#include "gcode-parser/gcode-parser.h"
+
+static int usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] <gcode-file> <output-file>\n"
+          "Options:\n"
+          "\t-c <config>       : Machine config. Needed for the home "
+          "position (G28).\n"
+          "\t-p <paramfile>    : Parameter file to read variables from.\n"
+          "Use filename '-' for stdin/stdout.\n", prog);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  const char *config_file = NULL;
+  const char *param_file = "";
+  int opt;
+  while ((opt = getopt(argc, argv, "c:p:")) != -1) {
+    switch (opt) {
+    case 'c':
+      config_file = optarg;
+      break;
+    case 'p':
+      param_file = optarg;
+      break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+  if (argc - optind != 2)
+    return usage(argv[0]);
+  const char *in_file = argv[optind];
+  const char *out_file = argv[optind + 1];
+
+  Log_init("/dev/null");
+
+  GCodeParser::Config parser_cfg(param_file);
+  GCodeParser::Config::ParamMap parameters;
+  parser_cfg.parameters = &parameters;
+  if (*param_file) parser_cfg.LoadParams();
+
+  if (config_file) {
+    ConfigParser config_parser;
+    MachineControlConfig config;
+    if (!config_parser.SetContentFromFile(config_file)
+        || !config.ConfigureFromFile(&config_parser)) {
+      fprintf(stderr, "Cannot read config file '%s'\n", config_file);
+      return 1;
+    }
+    // Same as GCodeMachineControl::GetHomePos()
+    for (const GCodeParserAxis axis : AllAxes()) {
+      parser_cfg.machine_origin[axis]
+        = (config.homing_trigger[axis] & HardwareMapping::TRIGGER_MAX)
+        ? config.move_range_mm[axis] : 0;
+    }
+  }
+
+  FILE *in = strcmp(in_file, "-") == 0 ? stdin : fopen(in_file, "r");
+  if (in == NULL) {
+    perror(in_file);
+    return 1;
+  }
+  FILE *out = strcmp(out_file, "-") == 0 ? stdout : fopen(out_file, "w");
+  if (out == NULL) {
+    perror(out_file);
+    return 1;
+  }
+
+  CompiledGCodeWriter writer(out);
+  GCodeParser parser(parser_cfg, &writer);
+  parser.ReadFile(in, stderr);  // Closes input.
+  const bool write_ok = writer.ok() && fclose(out) == 0;
+
+  if (parser.error_count() > 0) {
+    fprintf(stderr, "%d errors parsing %s\n", parser.error_count(), in_file);
+  }
+  if (writer.probe_count() > 0) {
+    fprintf(stderr, "Note: %d probe (G30) commands. Offsets resulting "
+            "from probing are not known when compiling.\n",
+            writer.probe_count());
+  }
+  if (!write_ok) {
+    fprintf(stderr, "Error writing %s\n", out_file);
+    return 1;
+  }
+  return parser.error_count() == 0 ? 0 : 1;
+}
@@ -34,14 +34,22 @@
 #include <unistd.h>
 #include <time.h>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include "common/container.h"
+#include "common/fd-mux.h"
 #include "common/logging.h"
 #include "common/string-util.h"
 #include "gcode-parser/gcode-parser.h"
+#include "gcode-parser/gcode-streamer.h"
 
 #include "adc.h"
+#include "bed-mesh.h"
 #include "generic-gpio.h"
 #include "hardware-mapping.h"
+#include "kinematics.h"
 #include "motor-operations.h"
 #include "planner.h"
 #include "pwm-timer.h"
@@ -50,6 +58,12 @@
 // In case we get a zero feedrate, send this frequency to motors instead.
 #define ZERO_FEEDRATE_OVERRIDE_HZ 5
 
+// Max number of coordinated moves merged into one with collinear-tolerance.
+#define MAX_MERGED_MOVES 32
+
+// Shortest ramp for feed hold and override, in seconds.
+#define MIN_SPEED_RAMP_SECONDS 0.01f
+
 #define VERSION_STRING "PROTOCOL_VERSION:0.1 FIRMWARE_NAME:BeagleG "    \
   "CAPE:" CAPE_NAME " FIRMWARE_URL:http%3A//github.com/hzeller/beagleg"
 
@@ -70,15 +84,25 @@ public:
   bool Init();
 
   ~Impl() {
+    delete adc_sampler_;
+    delete bed_mesh_;
     delete planner_;
   }
 
   const MachineControlConfig &config() const { return cfg_; }
-  void set_msg_stream(FILE *msg) { msg_stream_ = msg; }
+  bool reload_config(const MachineControlConfig &config);
+  void set_msg_stream(FILE *msg) {
+    msg_stream_ = msg;
+    pending_acks_ = 0;  // Belonged to the previous connection.
+  }
+  void RunAsync(FDMultiplexer *event_server, GCodeStreamer *streamer);
   EStopState GetEStopStatus();
+  bool CheckEStopAndPause();
   HomingState GetHomeStatus();
   bool GetMotorsEnabled();
   void GetCurrentPosition(AxesRegister *pos);
+  float GetCurrentFeedrate();
+  int GetSpindleRpm() { return spindle_rpm_; }
 
   // -- GCodeParser::Events interface implementation --
   void gcode_start(GCodeParser *parser) final;
@@ -101,17 +125,43 @@ public:
   void clamp_to_range(AxisBitmap_t affected, AxesRegister *axes) final;
   bool coordinated_move(float feed_mm_p_sec, const AxesRegister &target) final;
   bool rapid_move(float feed_mm_p_sec, const AxesRegister &target) final;
+  void arc_move(float feed_mm_p_sec, GCodeParserAxis normal_axis,
+                bool clockwise, const AxesRegister &start,
+                const AxesRegister &center, const AxesRegister &end) final;
+  void raster_move(float feed_mm_p_sec,
+                   const AxesRegister &start, const AxesRegister &end,
+                   const uint8_t *power, int count) final;
+  float arc_segment_length(float radius, float feed_mm_p_sec) final;
   const char *unprocessed(char letter, float value, const char *) final;
 
 private:
+  // Values derived from the configuration that can change in a reload.
+  void derive_config_values();
+  // All halts go through here, so that a reloaded configuration takes
+  // effect while the machine stands still.
+  void bring_path_to_halt();
+  void apply_pending_config();
   bool in_estop();
   void set_estop(bool hard);
   bool clear_estop();
   bool check_for_estop();
+  bool check_for_estop(const HardwareMapping::InputSnapshot &inputs);
   bool check_for_pause();
   void issue_motor_move_if_possible();
   bool test_homing_status_ok();
+  bool extend_merged_move(const AxesRegister &target, float feedrate);
+  void flush_merged_move();
+  // Last position sent to the planner, without the bed mesh correction.
+  void last_program_position(AxesRegister *pos);
+  // Enqueue a linear move, following the bed mesh if there is one.
+  void enqueue_line(const AxesRegister &target, float feedrate);
+  void probe_bed_mesh();                // G29
   bool test_within_machine_limits(const AxesRegister &axes);
+  bool test_arc_within_machine_limits(GCodeParserAxis normal_axis,
+                                      bool clockwise,
+                                      const AxesRegister &start,
+                                      const AxesRegister &center,
+                                      const AxesRegister &end);
   void mprint_endstop_status();
   void mprint_current_position();
   const char *aux_bit_commands(char letter, float value, const char *);
@@ -120,25 +170,40 @@ private:
                               enum GCodeParserAxis defining_axis);
   int move_to_endstop(enum GCodeParserAxis axis,
                       float feedrate, HardwareMapping::AxisTrigger trigger);
+  void move_to_endstops(AxisBitmap_t axes, float feedrate);
   int move_to_probe(enum GCodeParserAxis axis, float feedrate, const int dir,
                     int max_steps);
-  void home_axis(enum GCodeParserAxis axis);
+  void home_axes(AxisBitmap_t axes);
   void set_output_flags(HardwareMapping::NamedOutput out, bool is_on);
   void handle_M105();
   // Parse GCode spindle M3/M4 block.
   const char *set_spindle_on(bool is_ccw, const char *);
   void set_spindle_off();
+  void hold_input_while_spindle_busy();
+  void finish_dwell();
+  void hold_motion_while_paused();
+  void cancel_auto_disable();
+  void schedule_output_update();
+  void acknowledge_command();
+  bool motion_outlasts_idle();
+  void flush_acknowledgements();
 
   // Print to msg_stream.
   void mprintf(const char *format, ...);
 
 private:
-  const struct MachineControlConfig cfg_;
+  // Only changed in Init() and by a config reload at halt; the planner
+  // points to it as well. Everything else treats it as const.
+  struct MachineControlConfig cfg_;
   MotorOperations *const motor_ops_;
   HardwareMapping *const hardware_mapping_;
   Spindle *const spindle_;
 
   Planner *planner_ = nullptr;
+  AdcSampler *adc_sampler_ = nullptr;   // Only with real hardware.
+  BedMesh *bed_mesh_ = nullptr;         // Z correction probed with G29.
+  std::unique_ptr<MachineControlConfig> pending_config_;  // To be reloaded.
+  std::vector<float> mesh_splits_;      // Reused by enqueue_line().
   FILE *msg_stream_ = nullptr;
   GCodeParser *parser_ = nullptr;
 
@@ -146,20 +211,106 @@ private:
   float g0_feedrate_mm_per_sec_;         // Highest of all axes; used for G0
                                          // (will be trimmed if needed)
   AxisBitmap_t axis_clamped_;            // All axes that are clamped to range
+  AxesRegister range_max_;               // move_range_mm or INFINITY.
   // Current machine configuration
   AxesRegister coordinate_display_origin_; // parser tells us
   std::string coordinate_display_origin_name_;
   float current_feedrate_mm_per_sec_;    // Set via Fxxx and remembered
   float prog_speed_factor_;              // Speed factor set by program (M220)
+                                         // that is applied in planning...
+  float live_speed_factor_ = 1;          // ... and the one applied to the
+                                         // queued moves by the motor ops.
+  float speed_ramp_seconds_ = MIN_SPEED_RAMP_SECONDS;  // For the live one.
+  int spindle_rpm_ = 0;                  // Negative: counterclockwise.
   time_t next_auto_disable_motor_;
   time_t next_auto_disable_fan_;
+
+  // If set, we wait in timers instead of blocking.
+  FDMultiplexer *event_server_ = nullptr;
+  GCodeStreamer *streamer_ = nullptr;
+  int auto_disable_timer_ = -1;
+  int output_timer_ = -1;               // Polls for PWM changes to set.
+  int pending_acks_ = 0;                // Commands not acknowledged yet.
+  bool idle_halt_deferred_ = false;     // Input idle, but queue still busy.
   bool pause_enabled_;                  // Enabled via M120, disabled via M121
 
   GCodeMachineControl::HomingState homing_state_;
+
+  // Run of coordinated moves that are merged into one while they stay
+  // within the collinear-tolerance of the line from start to end.
+  struct MergedMove {
+    bool pending = false;                 // There is a move to be enqueued.
+    AxesRegister start;
+    AxesRegister end;
+    AxesRegister via[MAX_MERGED_MOVES];  // Dropped end points in between.
+    int via_count = 0;
+    float feedrate;
+    HardwareMapping::AuxBitmap aux_bits;
+  } merged_;
 };
 
 static inline int round2int(float x) { return (int) roundf(x); }
 
+// Check the values that can also change in a reload. Returns the number of
+// errors found.
+static int count_planning_config_errors(const MachineControlConfig &cfg) {
+  int error_count = 0;
+  for (const GCodeParserAxis axis : AllAxes()) {
+    if (cfg.max_feedrate[axis] < 0) {
+      Log_error("Invalid negative feedrate %.1f for axis %c\n",
+                cfg.max_feedrate[axis], gcodep_axis2letter(axis));
+      ++error_count;
+    }
+    if (cfg.acceleration[axis] < 0) {
+      Log_error("Invalid negative acceleration %.1f for axis %c\n",
+                cfg.acceleration[axis], gcodep_axis2letter(axis));
+      ++error_count;
+    }
+  }
+
+  if (cfg.lookahead_segments < 1
+      || cfg.lookahead_segments > Planner::MAX_LOOKAHEAD) {
+    Log_error("lookahead-segments: needs to be in range [1..%d], got %d",
+              Planner::MAX_LOOKAHEAD, cfg.lookahead_segments);
+    ++error_count;
+  }
+
+  if (cfg.junction_deviation < 0) {
+    Log_error("junction-deviation: needs to be >= 0, got %.3f",
+              cfg.junction_deviation);
+    ++error_count;
+  }
+
+  if (cfg.ack_window < 1) {
+    Log_error("ack-window: needs to be >= 1, got %d", cfg.ack_window);
+    ++error_count;
+  }
+
+  if (cfg.idle_halt_queue_depth < 0 || cfg.idle_halt_queue_depth >= QUEUE_LEN) {
+    Log_error("idle-halt-queue-depth: needs to be in range [0..%d), got %d",
+              QUEUE_LEN, cfg.idle_halt_queue_depth);
+    ++error_count;
+  }
+
+  if (cfg.collinear_tolerance < 0) {
+    Log_error("collinear-tolerance: needs to be >= 0, got %.3f",
+              cfg.collinear_tolerance);
+    ++error_count;
+  }
+
+  if (cfg.arc_tolerance <= 0) {
+    Log_error("arc-tolerance: needs to be > 0, got %.3f", cfg.arc_tolerance);
+    ++error_count;
+  }
+
+  if (cfg.s_curve_fraction < 0 || cfg.s_curve_fraction > 1) {
+    Log_error("s-curve-fraction: needs to be in range [0..1], got %.3f",
+              cfg.s_curve_fraction);
+    ++error_count;
+  }
+  return error_count;
+}
+
 GCodeMachineControl::Impl::Impl(const MachineControlConfig &config,
                                 MotorOperations *motor_ops,
                                 HardwareMapping *hardware_mapping,
@@ -190,30 +341,18 @@ bool GCodeMachineControl::Impl::Init() {
                 gcodep_axis2letter(axis));
       return false;
     }
-    // Permissible hard override. We want to keep cfg_ const for most of the
-    // places, so writing here in Init() is permissible.
-    const_cast<MachineControlConfig&>(cfg_).steps_per_mm[axis]
-                                           = fabsf(cfg_.steps_per_mm[axis]);
-    if (cfg_.max_feedrate[axis] < 0) {
-      Log_error("Invalid negative feedrate %.1f for axis %c\n",
-                cfg_.max_feedrate[axis], gcodep_axis2letter(axis));
-      return false;
-    }
-    if (cfg_.acceleration[axis] < 0) {
-      Log_error("Invalid negative acceleration %.1f for axis %c\n",
-                cfg_.acceleration[axis], gcodep_axis2letter(axis));
+    cfg_.steps_per_mm[axis] = fabsf(cfg_.steps_per_mm[axis]);
+    if (!cfg_.error_map[axis].empty() && cfg_.error_map_spacing[axis] <= 0) {
+      Log_error("error-map for axis %c needs an error-map-spacing > 0",
+                gcodep_axis2letter(axis));
       return false;
     }
   }
 
-  for (const GCodeParserAxis axis : AllAxes()) {
-    if (cfg_.max_feedrate[axis] > g0_feedrate_mm_per_sec_) {
-      g0_feedrate_mm_per_sec_ = cfg_.max_feedrate[axis];
-    }
-  }
+  derive_config_values();
   prog_speed_factor_ = 1.0f;
 
-  int error_count = 0;
+  int error_count = count_planning_config_errors(cfg_);
 
   // Check if things are plausible: we only allow one home endstop per axis.
   for (const GCodeParserAxis axis : AllAxes()) {
@@ -235,6 +374,13 @@ bool GCodeMachineControl::Impl::Init() {
     }
   }
 
+  Kinematics *kinematics;
+  if (Kinematics::Create(cfg_, &kinematics)) {
+    delete kinematics;  // Just checking; the planner has its own.
+  } else {
+    ++error_count;
+  }
+
   axis_clamped_ = 0;
   for (char c : cfg_.clamp_to_range) {
     const GCodeParserAxis clamped_axis = gcodep_letter2axis(c);
@@ -319,9 +465,107 @@ bool GCodeMachineControl::Impl::Init() {
     return false;
 
   planner_ = new Planner(&cfg_, hardware_mapping_, motor_ops_);
+
+  if (!hardware_mapping_->IsHardwareSimulated()) {
+    adc_sampler_ = new AdcSampler((1 << AdcSampler::NUM_CHANNELS) - 1, 50);
+    if (!adc_sampler_->Start()) {
+      Log_info("No ADC available; M105 will report no values.");
+      delete adc_sampler_;
+      adc_sampler_ = nullptr;
+    }
+  }
   return true;
 }
 
+void GCodeMachineControl::Impl::derive_config_values() {
+  g0_feedrate_mm_per_sec_ = -1;
+  for (const GCodeParserAxis axis : AllAxes()) {
+    if (cfg_.max_feedrate[axis] > g0_feedrate_mm_per_sec_) {
+      g0_feedrate_mm_per_sec_ = cfg_.max_feedrate[axis];
+    }
+  }
+
+  for (const GCodeParserAxis axis : AllAxes()) {
+    range_max_[axis] = (cfg_.move_range_mm[axis] > 0)
+      ? cfg_.move_range_mm[axis] : INFINITY;
+  }
+
+  // The live speed factor changes linearly in time. Take long enough to
+  // stop from the highest feedrate of any axis with its acceleration.
+  speed_ramp_seconds_ = MIN_SPEED_RAMP_SECONDS;
+  for (const GCodeParserAxis axis : AllAxes()) {
+    if (cfg_.acceleration[axis] <= 0) continue;
+    const float seconds = cfg_.max_feedrate[axis] / cfg_.acceleration[axis];
+    if (seconds > speed_ramp_seconds_) speed_ramp_seconds_ = seconds;
+  }
+}
+
+// Only values that the planner and we can pick up while standing still can
+// change; anything that determines where the axes are needs a restart.
+bool GCodeMachineControl::Impl::reload_config(
+  const MachineControlConfig &config) {
+  MachineControlConfig c = config;
+  const char *needs_restart = nullptr;
+  for (const GCodeParserAxis axis : AllAxes()) {
+    c.steps_per_mm[axis] = fabsf(c.steps_per_mm[axis]);
+    if (c.steps_per_mm[axis] != cfg_.steps_per_mm[axis])
+      needs_restart = "steps-per-mm";
+    else if (c.homing_trigger[axis] != cfg_.homing_trigger[axis])
+      needs_restart = "home-pos";
+    else if (c.backlash_mm[axis] != cfg_.backlash_mm[axis]
+             || c.error_map_spacing[axis] != cfg_.error_map_spacing[axis]
+             || c.error_map[axis] != cfg_.error_map[axis])
+      needs_restart = "axis compensation";
+    if (needs_restart) break;
+  }
+  if (c.kinematics != cfg_.kinematics
+      || c.delta_radius != cfg_.delta_radius
+      || c.delta_rod_length != cfg_.delta_rod_length)
+    needs_restart = "kinematics";
+  if (c.clamp_to_range != cfg_.clamp_to_range)
+    needs_restart = "clamp-to-range";
+  if (needs_restart) {
+    Log_error("Config reload: changing %s needs a restart; not reloaded.",
+              needs_restart);
+    return false;
+  }
+  int error_count = count_planning_config_errors(c);
+  for (const GCodeParserAxis axis : AllAxes()) {
+    if (hardware_mapping_->HasMotorFor(axis) && c.max_feedrate[axis] <= 0) {
+      Log_error("Motor axis %c needs a max-feedrate > 0",
+                gcodep_axis2letter(axis));
+      ++error_count;
+    }
+  }
+  if (error_count > 0) {
+    Log_error("Config reload: invalid values; not reloaded.");
+    return false;
+  }
+
+  pending_config_.reset(new MachineControlConfig(c));
+  if (!merged_.pending && planner_->IsPathHalted()) {
+    apply_pending_config();
+  } else {
+    Log_info("Config reload: takes effect when the machine stops.");
+  }
+  return true;
+}
+
+void GCodeMachineControl::Impl::apply_pending_config() {
+  // The planner refers to our config, so it sees the change in the same
+  // moment.
+  cfg_ = *pending_config_;
+  pending_config_.reset();
+  derive_config_values();
+  planner_->ConfigChanged();
+  Log_info("Config reload: new configuration in effect.");
+}
+
+void GCodeMachineControl::Impl::bring_path_to_halt() {
+  planner_->BringPathToHalt();
+  if (pending_config_) apply_pending_config();
+}
+
 // machine-printf. Only prints if there is a msg-stream.
 void GCodeMachineControl::Impl::mprintf(const char *format, ...) {
   va_list ap;
@@ -338,14 +582,60 @@ void GCodeMachineControl::Impl::wait_temperature() {
   mprintf("// BeagleG: wait_temperature() not implemented.\n");
 }
 void GCodeMachineControl::Impl::motors_enable(bool b) {
-  planner_->BringPathToHalt();
+  if (b && hardware_mapping_->MotorsEnabled())
+    return;  // Nothing changes, so no need to stop, e.g. for M17 per layer.
+  flush_merged_move();
+  bring_path_to_halt();
   motor_ops_->MotorEnable(b);
   if (!b && homing_state_ == GCodeMachineControl::HomingState::HOMED) {
     homing_state_ = GCodeMachineControl::HomingState::HOMED_BUT_MOTORS_UNPOWERED;
   }
 }
 void GCodeMachineControl::Impl::gcode_command_done(char l, float v) {
-  if (cfg_.acknowledge_lines) mprintf("ok\n");
+  if (auto_disable_timer_ >= 0) cancel_auto_disable();  // Not idle anymore.
+  idle_halt_deferred_ = false;
+  hold_motion_while_paused();
+  if (cfg_.acknowledge_lines) acknowledge_command();
+}
+
+// With an ack-window, the sender doesn't wait for an 'ok' after each line
+// but keeps sending up to the window size; one 'ok <n>' acknowledges n
+// commands at once, together with the free slots in the motion queue.
+// If the motion queue runs low, we acknowledge right away so that the
+// sender fills it up again without waiting for the window to complete.
+void GCodeMachineControl::Impl::acknowledge_command() {
+  if (cfg_.ack_window <= 1) {
+    mprintf("ok\n");
+    return;
+  }
+  ++pending_acks_;
+  MotionQueueStats stats;
+  if (pending_acks_ >= cfg_.ack_window
+      || (motor_ops_->GetQueueStats(&stats)
+          && stats.queue_depth < QUEUE_LEN / 4)) {
+    flush_acknowledgements();
+  }
+}
+
+void GCodeMachineControl::Impl::flush_acknowledgements() {
+  if (pending_acks_ == 0) return;
+  MotionQueueStats stats;
+  if (motor_ops_->GetQueueStats(&stats)) {
+    mprintf("ok %d Q:%d\n", pending_acks_,
+            std::max(0, QUEUE_LEN - (int)stats.queue_depth));
+  } else {
+    mprintf("ok %d\n", pending_acks_);
+  }
+  pending_acks_ = 0;
+}
+
+void GCodeMachineControl::Impl::RunAsync(FDMultiplexer *event_server,
+                                         GCodeStreamer *streamer) {
+  event_server_ = event_server;
+  streamer_ = streamer;
+  if (spindle_) {
+    spindle_->RunAsync(event_server, [this]() { streamer_->Release(); });
+  }
 }
 void GCodeMachineControl::Impl::inform_origin_offset(const AxesRegister &o,
                                                      const char *named) {
@@ -354,17 +644,35 @@ void GCodeMachineControl::Impl::inform_origin_offset(const AxesRegister &o,
 }
 
 void GCodeMachineControl::Impl::set_fanspeed(float speed) {
+  flush_merged_move();
   if (speed < 0.0 || speed > 255.0) return;
   float duty_cycle = speed / 255.0;
-  // The fan can be mapped to an aux and/or pwm signal
+  // The fan can be mapped to an aux and/or pwm signal. Both are set along
+  // with the next move.
   set_output_flags(HardwareMapping::NamedOutput::FAN, duty_cycle > 0.0);
-  hardware_mapping_->SetPWMOutput(HardwareMapping::NamedOutput::FAN, duty_cycle);
+  hardware_mapping_->UpdatePWMOutput(HardwareMapping::NamedOutput::FAN,
+                                     duty_cycle);
+  schedule_output_update();
+}
+
+// The motion queue can't set PWM outputs; they are set when we see the
+// segment they come with being executed. So we look frequently while there
+// are changes on their way.
+void GCodeMachineControl::Impl::schedule_output_update() {
+  if (!event_server_ || output_timer_ >= 0) return;
+  output_timer_ = event_server_->RunAfter(1000, [this]() {
+      if (motor_ops_->UpdateOutputs() || planner_->HasPendingPWMChanges())
+        return true;
+      output_timer_ = -1;
+      return false;
+    });
 }
 
 // number of checks to ensure the pause switch is inactive
 #define PAUSE_ACTIVE_DETECT	2
 
 void GCodeMachineControl::Impl::wait_for_start() {
+  flush_merged_move();
   // Interlock: can't start while wait is still active.
   if (pause_enabled_ && check_for_pause()) {
     mprintf("// BeagleG: pause switch active\n");
@@ -420,10 +728,15 @@ bool GCodeMachineControl::Impl::clear_estop() {
 }
 
 bool GCodeMachineControl::Impl::check_for_estop() {
+  return check_for_estop(hardware_mapping_->ReadInputs());
+}
+
+bool GCodeMachineControl::Impl::check_for_estop(
+  const HardwareMapping::InputSnapshot &inputs) {
   // TODO(Hartley): in case of (estop() == true) should we just return just
   // that? Because right now, we only return if we see the EStop switch the
   // first time.
-  if (!in_estop() && hardware_mapping_->TestEStopSwitch()) {
+  if (!in_estop() && inputs.EStopSwitch()) {
     Log_info("E-Stop input detected, forcing Software E-Stop.");
     set_estop(true);
     return true;
@@ -437,8 +750,8 @@ bool GCodeMachineControl::Impl::check_for_pause() {
 
 void GCodeMachineControl::Impl::handle_M105() {
   mprintf("// ");
-  for (int chan = 0; chan < 8; chan++) {
-    int raw = arc_read_raw(chan);
+  for (int chan = 0; chan < AdcSampler::NUM_CHANNELS; chan++) {
+    const int raw = adc_sampler_ ? adc_sampler_->Value(chan) : -1;
     mprintf("RAW%d:%d ", chan, raw);
   }
   mprintf("\n");
@@ -454,8 +767,9 @@ const char *GCodeMachineControl::Impl::set_spindle_on(bool is_ccw,
   char letter;
   float value;
 
-  // Ensure that the PRU queue is flushed before turning on the spindle.
-  planner_->BringPathToHalt();
+  // Ensure that the PRU queue is flushed before turning on the spindle,
+  // unless it is switched along with the moves.
+  if (!spindle_->IsSynchronous()) bring_path_to_halt();
   for (;;) {
     after_pair = parser_->ParsePair(remaining, &letter, &value, msg_stream_);
     if (after_pair == NULL) break;
@@ -463,24 +777,62 @@ const char *GCodeMachineControl::Impl::set_spindle_on(bool is_ccw,
     else break;
     remaining = after_pair;
   }
-  if (spindle_rpm >= 0) spindle_->On(is_ccw, spindle_rpm);
+  if (spindle_rpm >= 0) {
+    spindle_->On(is_ccw, spindle_rpm);
+    spindle_rpm_ = is_ccw ? -spindle_rpm : spindle_rpm;
+  }
+  if (spindle_->IsSynchronous()) schedule_output_update();
+  hold_input_while_spindle_busy();
   return remaining;
 }
 
 void GCodeMachineControl::Impl::set_spindle_off() {
   if (!spindle_) return;
-  // Ensure that the PRU queue is flushed before turning off the spindle.
-  planner_->BringPathToHalt();
+  // Ensure that the PRU queue is flushed before turning off the spindle,
+  // unless it is switched along with the moves.
+  if (!spindle_->IsSynchronous()) bring_path_to_halt();
   spindle_->Off();
+  spindle_rpm_ = 0;
+  if (spindle_->IsSynchronous()) schedule_output_update();
+  hold_input_while_spindle_busy();
+}
+
+// Until the spindle is at speed, we can't continue with the program. The
+// spindle releases the input once done.
+void GCodeMachineControl::Impl::hold_input_while_spindle_busy() {
+  if (streamer_ && spindle_->IsBusy()) streamer_->Hold();
+}
+
+// Commands that only report something or switch outputs right away don't
+// care where the motion is; moves before and after them can still be merged.
+// Everything else needs the moves before it in the planner: aux bits go out
+// with the next segment, and a few wait for the path to halt themselves
+// (M400, spindle that is not synchronous, E-Stop).
+static bool depends_on_motion_order(char letter, int code) {
+  if (letter != 'M') return true;
+  switch (code) {
+  case 64: case 65:                         // aux pin set immediately
+  case 80: case 81:                         // ATX power
+  case 105: case 115: case 117: case 119:   // reports and messages
+  case 120: case 121:                       // pause switch enable
+    return false;
+  default:
+    return true;
+  }
 }
 
 const char *GCodeMachineControl::Impl::unprocessed(char letter, float value,
                                                    const char *remaining) {
+  if (depends_on_motion_order(letter, (int)value)) flush_merged_move();
   return special_commands(letter, value, remaining);
 }
 
 const char *GCodeMachineControl::Impl::special_commands(char letter, float value,
                                                         const char *remaining) {
+  if (letter == 'G' && (int)value == 29) {
+    probe_bed_mesh();
+    return remaining;
+  }
   // Only M commands are handled here
   if (letter != 'M') return remaining;
 
@@ -514,6 +866,10 @@ const char *GCodeMachineControl::Impl::special_commands(char letter, float value
   case 119: mprint_endstop_status(); break;
   case 120: pause_enabled_ = true; break;
   case 121: pause_enabled_ = false; break;
+  case 561:                                 // Forget the bed mesh.
+    delete bed_mesh_;
+    bed_mesh_ = nullptr;
+    break;
   default:
     mprintf("// BeagleG: didn't understand ('%c', %d, '%s')\n",
             letter, code, remaining);
@@ -608,6 +964,12 @@ GCodeMachineControl::EStopState GCodeMachineControl::Impl::GetEStopStatus() {
   return GCodeMachineControl::EStopState::NONE;
 }
 
+bool GCodeMachineControl::Impl::CheckEStopAndPause() {
+  check_for_estop();
+  hold_motion_while_paused();
+  return !in_estop();
+}
+
 GCodeMachineControl::HomingState GCodeMachineControl::Impl::GetHomeStatus() {
   return homing_state_;
 }
@@ -623,6 +985,12 @@ void GCodeMachineControl::Impl::GetCurrentPosition(AxesRegister *pos) {
   }
 }
 
+float GCodeMachineControl::Impl::GetCurrentFeedrate() {
+  if (current_feedrate_mm_per_sec_ <= 0) return 0;
+  return live_speed_factor_ * prog_speed_factor_
+    * current_feedrate_mm_per_sec_;
+}
+
 void GCodeMachineControl::Impl::mprint_current_position() {
   AxesRegister current_pos;
   planner_->GetCurrentPosition(&current_pos);
@@ -663,6 +1031,7 @@ void GCodeMachineControl::Impl::mprint_current_position() {
 }
 
 void GCodeMachineControl::Impl::mprint_endstop_status() {
+  const HardwareMapping::InputSnapshot inputs = hardware_mapping_->ReadInputs();
   bool any_endstops_found = false;
   for (const GCodeParserAxis axis : AllAxes()) {
     HardwareMapping::AxisTrigger triggers = hardware_mapping_->AvailableAxisSwitch(axis);
@@ -671,7 +1040,7 @@ void GCodeMachineControl::Impl::mprint_endstop_status() {
               tolower(gcodep_axis2letter(axis)),
               cfg_.homing_trigger[axis] == HardwareMapping::TRIGGER_MIN
               ? "home" : "limit",
-              hardware_mapping_->TestAxisSwitch(axis, HardwareMapping::TRIGGER_MIN)
+              inputs.AxisSwitch(axis, HardwareMapping::TRIGGER_MIN)
               ? "TRIGGERED" : "open");
       any_endstops_found = true;
     }
@@ -680,7 +1049,7 @@ void GCodeMachineControl::Impl::mprint_endstop_status() {
               tolower(gcodep_axis2letter(axis)),
               cfg_.homing_trigger[axis] == HardwareMapping::TRIGGER_MAX
               ? "home" : "limit",
-              hardware_mapping_->TestAxisSwitch(axis, HardwareMapping::TRIGGER_MAX)
+              inputs.AxisSwitch(axis, HardwareMapping::TRIGGER_MAX)
               ? "TRIGGERED" : "open");
       any_endstops_found = true;
     }
@@ -699,8 +1068,10 @@ void GCodeMachineControl::Impl::gcode_start(GCodeParser *parser) {
 }
 
 void GCodeMachineControl::Impl::gcode_finished(bool end_of_stream) {
-  planner_->BringPathToHalt();
+  flush_acknowledgements();
+  flush_merged_move();
   set_spindle_off();
+  bring_path_to_halt();
   if (end_of_stream && cfg_.auto_motor_disable_seconds > 0)
     motors_enable(false);
 }
@@ -718,6 +1089,16 @@ bool GCodeMachineControl::Impl::test_within_machine_limits(const AxesRegister &a
   if (!cfg_.range_check)
     return true;
 
+  // The common case: all within range. Checking all axes without branches
+  // is cheaper than finding the first one outside.
+  int outside = 0;
+  for (const GCodeParserAxis i : AllAxes()) {
+    outside |= (axes[i] < 0) | (axes[i] > range_max_[i]);
+  }
+  if (!outside)
+    return true;
+
+  // Now find which one it was to tell about it.
   for (const GCodeParserAxis i : AllAxes()) {
     // Min range ...
     if (axes[i] < 0) {
@@ -802,12 +1183,108 @@ bool GCodeMachineControl::Impl::coordinated_move(float feed,
   }
 
   float feedrate = prog_speed_factor_ * current_feedrate_mm_per_sec_;
-  planner_->Enqueue(axis, feedrate);
+  if (cfg_.collinear_tolerance <= 0) {
+    enqueue_line(axis, feedrate);
+    return true;
+  }
+  if (merged_.pending && extend_merged_move(axis, feedrate))
+    return true;
+  flush_merged_move();
+  last_program_position(&merged_.start);
+  merged_.pending = true;
+  merged_.end = axis;
+  merged_.feedrate = feedrate;
+  merged_.aux_bits = hardware_mapping_->GetAuxBits();
   return true;
 }
 
+// Check if the path start->via...->target is close enough to a straight
+// line start->target, and if so, make target the new end of the merged move.
+// The points have to progress along the line; we don't merge reversals.
+bool GCodeMachineControl::Impl::extend_merged_move(const AxesRegister &target,
+                                                   float feedrate) {
+  if (merged_.via_count >= MAX_MERGED_MOVES
+      || feedrate != merged_.feedrate
+      || hardware_mapping_->GetAuxBits() != merged_.aux_bits)
+    return false;
+  float line_len_sq = 0;
+  for (const GCodeParserAxis a : AllAxes()) {
+    const float d = target[a] - merged_.start[a];
+    line_len_sq += d*d;
+  }
+  if (line_len_sq <= 0)
+    return false;
+  const float tolerance_sq = cfg_.collinear_tolerance * cfg_.collinear_tolerance;
+  float last_t = 0;
+  for (int i = 0; i <= merged_.via_count; ++i) {
+    const AxesRegister &p = (i < merged_.via_count) ? merged_.via[i]
+                                                    : merged_.end;
+    float dot = 0;
+    for (const GCodeParserAxis a : AllAxes()) {
+      dot += (p[a] - merged_.start[a]) * (target[a] - merged_.start[a]);
+    }
+    const float t = dot / line_len_sq;   // Position along the line.
+    if (t < last_t || t > 1)
+      return false;
+    last_t = t;
+    float dist_sq = 0;
+    for (const GCodeParserAxis a : AllAxes()) {
+      const float on_line = merged_.start[a]
+        + t * (target[a] - merged_.start[a]);
+      dist_sq += (p[a] - on_line) * (p[a] - on_line);
+    }
+    if (dist_sq > tolerance_sq)
+      return false;
+  }
+  merged_.via[merged_.via_count++] = merged_.end;
+  merged_.end = target;
+  return true;
+}
+
+// Hand the merged move, if any, to the planner. Needs to be called before
+// anything else talks to the planner or changes the state of the machine.
+void GCodeMachineControl::Impl::flush_merged_move() {
+  if (!merged_.pending) return;
+  enqueue_line(merged_.end, merged_.feedrate);
+  merged_.pending = false;
+  merged_.via_count = 0;
+}
+
+void GCodeMachineControl::Impl::last_program_position(AxesRegister *pos) {
+  planner_->GetLastTargetPosition(pos);
+  if (bed_mesh_)
+    (*pos)[AXIS_Z] -= bed_mesh_->Height((*pos)[AXIS_X], (*pos)[AXIS_Y]);
+}
+
+// Within a grid cell of the bed mesh, the height changes smoothly, so the
+// move is only broken up where it crosses into a cell with another slope.
+void GCodeMachineControl::Impl::enqueue_line(const AxesRegister &target,
+                                             float feedrate) {
+  if (!bed_mesh_) {
+    planner_->Enqueue(target, feedrate);
+    return;
+  }
+  AxesRegister start;
+  last_program_position(&start);
+  bed_mesh_->Subdivide(start[AXIS_X], start[AXIS_Y],
+                       target[AXIS_X], target[AXIS_Y], cfg_.arc_tolerance,
+                       &mesh_splits_);
+  AxesRegister piece;
+  for (const float f : mesh_splits_) {
+    for (const GCodeParserAxis a : AllAxes()) {
+      piece[a] = start[a] + f * (target[a] - start[a]);
+    }
+    piece[AXIS_Z] += bed_mesh_->Height(piece[AXIS_X], piece[AXIS_Y]);
+    planner_->Enqueue(piece, feedrate);
+  }
+  piece = target;
+  piece[AXIS_Z] += bed_mesh_->Height(target[AXIS_X], target[AXIS_Y]);
+  planner_->Enqueue(piece, feedrate);
+}
+
 bool GCodeMachineControl::Impl::rapid_move(float feed,
                                            const AxesRegister &axis) {
+  flush_merged_move();
   if (!test_homing_status_ok())
     return false;
   if (!test_within_machine_limits(axis))
@@ -817,35 +1294,277 @@ bool GCodeMachineControl::Impl::rapid_move(float feed,
   if (given > 0 && current_feedrate_mm_per_sec_ <= 0) {
     current_feedrate_mm_per_sec_ = given;  // At least something for G1.
   }
-  planner_->Enqueue(axis, given > 0 ? given : rapid_feed);
+  enqueue_line(axis, given > 0 ? given : rapid_feed);
+  return true;
+}
+
+// The extremes of an arc are where it crosses the quadrants of its circle,
+// so besides the end point, these are the points to check.
+bool GCodeMachineControl::Impl::test_arc_within_machine_limits(
+  GCodeParserAxis normal_axis, bool clockwise, const AxesRegister &start,
+  const AxesRegister &center, const AxesRegister &end) {
+  if (!test_within_machine_limits(end))
+    return false;
+  GCodeParserAxis plane[3];
+  switch (normal_axis) {
+  case AXIS_Z: plane[0] = AXIS_X; plane[1] = AXIS_Y; plane[2] = AXIS_Z; break;
+  case AXIS_X: plane[0] = AXIS_Y; plane[1] = AXIS_Z; plane[2] = AXIS_X; break;
+  default:     plane[0] = AXIS_X; plane[1] = AXIS_Z; plane[2] = AXIS_Y; break;
+  }
+  const float r_0 = start[plane[0]] - center[plane[0]];
+  const float r_1 = start[plane[1]] - center[plane[1]];
+  const float rt_0 = end[plane[0]] - center[plane[0]];
+  const float rt_1 = end[plane[1]] - center[plane[1]];
+  const float radius = hypotf(r_0, r_1);
+  float travel = atan2f(r_0*rt_1 - r_1*rt_0, r_0*rt_0 + r_1*rt_1);
+  if (clockwise && travel >= 0) travel -= 2*M_PI;
+  if (!clockwise && travel <= 0) travel += 2*M_PI;
+  const float start_angle = atan2f(r_1, r_0);
+  const float quarter = M_PI / 2;
+  for (int k = -8; k <= 8; ++k) {
+    const float angle = k * quarter;
+    const float f = (angle - start_angle) / travel;
+    if (f <= 0 || f >= 1) continue;
+    AxesRegister extreme = end;
+    extreme[plane[0]] = center[plane[0]] + radius * cosf(angle);
+    extreme[plane[1]] = center[plane[1]] + radius * sinf(angle);
+    extreme[plane[2]] = start[plane[2]] + f * (end[plane[2]] - start[plane[2]]);
+    if (!test_within_machine_limits(extreme))
+      return false;
+  }
   return true;
 }
 
+// With native-arcs, arcs are sent to the planner as such. If it can't
+// deal with them, they are broken into line segments as usual.
+void GCodeMachineControl::Impl::arc_move(float feed,
+                                         GCodeParserAxis normal_axis,
+                                         bool clockwise,
+                                         const AxesRegister &start,
+                                         const AxesRegister &center,
+                                         const AxesRegister &end) {
+  flush_merged_move();
+  // The bed mesh works on line segments.
+  if (cfg_.native_arcs && bed_mesh_ == nullptr && test_homing_status_ok()
+      && test_arc_within_machine_limits(normal_axis, clockwise,
+                                        start, center, end)) {
+    if (feed > 0) {
+      current_feedrate_mm_per_sec_ = cfg_.speed_factor * feed;
+    }
+    if (current_feedrate_mm_per_sec_ > 0
+        && planner_->EnqueueArc(normal_axis, clockwise, center, end,
+                                prog_speed_factor_
+                                * current_feedrate_mm_per_sec_)) {
+      return;
+    }
+  }
+  GCodeParser::EventReceiver::arc_move(feed, normal_axis, clockwise,
+                                       start, center, end);
+}
+
+// The PRU can only switch the laser on or off per pixel, so the power is
+// turned into bits with a simple error diffusion along the line. The PWM
+// power stays what was set with M3 S-.
+// Pixels only switch the spindle output of a synchronous (laser) spindle
+// that is on; otherwise, this is a plain move.
+void GCodeMachineControl::Impl::raster_move(float feed,
+                                            const AxesRegister &start,
+                                            const AxesRegister &end,
+                                            const uint8_t *power, int count) {
+  const HardwareMapping::AuxBitmap laser_bits =
+    hardware_mapping_->GetAuxMapping(HardwareMapping::NamedOutput::SPINDLE);
+  if (!spindle_ || !spindle_->IsSynchronous() || laser_bits == 0
+      || (hardware_mapping_->GetAuxBits() & laser_bits) == 0 || count <= 0) {
+    coordinated_move(feed, end);
+    return;
+  }
+  flush_merged_move();
+  if (!test_homing_status_ok())
+    return;
+  if (!test_within_machine_limits(end))
+    return;
+  if (feed > 0) {
+    current_feedrate_mm_per_sec_ = cfg_.speed_factor * feed;
+  }
+  if (current_feedrate_mm_per_sec_ <= 0) {
+    mprintf("// Error: No feedrate set yet.\n");
+    return;
+  }
+  const float feedrate = prog_speed_factor_ * current_feedrate_mm_per_sec_;
+
+  uint8_t bits[BEAGLEG_MAX_RASTER_PIXELS / 8];
+  int error = 0;
+  for (int chunk_start = 0; chunk_start < count;
+       chunk_start += BEAGLEG_MAX_RASTER_PIXELS) {
+    const int pixels = std::min(count - chunk_start,
+                                (int)BEAGLEG_MAX_RASTER_PIXELS);
+    memset(bits, 0, sizeof(bits));
+    for (int i = 0; i < pixels; ++i) {
+      const int value = power[chunk_start + i] + error;
+      const bool on = (value >= 128);
+      error = value - (on ? 255 : 0);
+      if (on) bits[i / 8] |= 1 << (i % 8);
+    }
+    const float fraction = 1.0f * (chunk_start + pixels) / count;
+    AxesRegister piece_end;
+    for (const GCodeParserAxis a : AllAxes()) {
+      piece_end[a] = start[a] + fraction * (end[a] - start[a]);
+    }
+    if (bed_mesh_) {   // Raster lines are short; just correct the end.
+      piece_end[AXIS_Z] += bed_mesh_->Height(piece_end[AXIS_X],
+                                             piece_end[AXIS_Y]);
+    }
+    if (planner_->EnqueueRaster(piece_end, feedrate, laser_bits,
+                                bits, pixels)) {
+      continue;
+    }
+    // No raster support in the backend: one move per run of equal pixels.
+    for (int i = 0; i < pixels; /**/) {
+      const bool on = bits[i / 8] & (1 << (i % 8));
+      int run_end = i + 1;
+      while (run_end < pixels && on == !!(bits[run_end / 8]
+                                          & (1 << (run_end % 8)))) {
+        ++run_end;
+      }
+      const float f = 1.0f * (chunk_start + run_end) / count;
+      AxesRegister run_target;
+      for (const GCodeParserAxis a : AllAxes()) {
+        run_target[a] = start[a] + f * (end[a] - start[a]);
+      }
+      if (bed_mesh_) {
+        run_target[AXIS_Z] += bed_mesh_->Height(run_target[AXIS_X],
+                                                run_target[AXIS_Y]);
+      }
+      hardware_mapping_->UpdateAuxBitmap(HardwareMapping::NamedOutput::SPINDLE,
+                                         on);
+      planner_->Enqueue(run_target, feedrate);
+      i = run_end;
+    }
+    hardware_mapping_->UpdateAuxBitmap(HardwareMapping::NamedOutput::SPINDLE,
+                                       true);
+  }
+}
+
+float GCodeMachineControl::Impl::arc_segment_length(float radius,
+                                                    float feed_mm_p_sec) {
+  return cfg_.ArcSegmentLength(radius, cfg_.speed_factor * prog_speed_factor_
+                               * feed_mm_p_sec);
+}
+
 void GCodeMachineControl::Impl::dwell(float value) {
-  planner_->BringPathToHalt();
+  flush_merged_move();
+  bring_path_to_halt();
   motor_ops_->WaitQueueEmpty();
   if (hardware_mapping_->IsHardwareSimulated()) {
     if (value > 999.0) {
       // Let some interactive user know that they can't expect dwell time here.
       mprintf("// FYI: hardware simulated. All dwelling is immediate.\n", value);
     }
+  } else if (event_server_ && value > 0) {
+    // Hold the input and continue when the timer fires; that way, other
+    // connections are served while we wait. Timers are precise to the
+    // microsecond, which is needed e.g. by rpt2pnp.
+    streamer_->Hold();
+    event_server_->RunAfter(value * 1000, [this]() {
+        finish_dwell();
+        streamer_->Release();
+        return false;
+      });
+    return;
   } else {
-    // TODO: this needs to wait in the event multiplexer.
-    // Since we might need pretty high precision (see rpt2pnp), this can't
-    // just be quantized to 50ms.
     usleep((int) (value * 1000));
   }
+  finish_dwell();
+}
 
-  if (!check_for_estop()) {
-    if (pause_enabled_ && check_for_pause()) {
+void GCodeMachineControl::Impl::finish_dwell() {
+  const HardwareMapping::InputSnapshot inputs = hardware_mapping_->ReadInputs();
+  if (!check_for_estop(inputs)) {
+    if (pause_enabled_ && inputs.PauseSwitch()) {
       Log_debug("Pause input detected, waiting for Start");
       wait_for_start();
     }
   }
 }
 
+// Feed hold: if the pause switch is pressed, stop the motors right where
+// they are, keeping the queue, until the switch is released and the start
+// switch pressed. Motor operations that can't do that pause at the next
+// dwell (see finish_dwell()).
+void GCodeMachineControl::Impl::hold_motion_while_paused() {
+  if (!pause_enabled_ || !check_for_pause())
+    return;
+  if (!motor_ops_->SetSpeedOverride(0, speed_ramp_seconds_))
+    return;
+  mprintf("// BeagleG: feed hold\n");
+  int pause_active = PAUSE_ACTIVE_DETECT;
+  while (pause_active || !hardware_mapping_->TestStartSwitch()) {
+    usleep(1000);
+    if (check_for_estop())
+      break;  // The motors are off, no need to hold them.
+    if (check_for_pause())
+      pause_active = PAUSE_ACTIVE_DETECT;
+    else if (pause_active > 0)
+      pause_active--;
+  }
+  motor_ops_->SetSpeedOverride(live_speed_factor_, speed_ramp_seconds_);
+  mprintf("// BeagleG: feed hold released\n");
+}
+
+void GCodeMachineControl::Impl::cancel_auto_disable() {
+  event_server_->CancelTimer(auto_disable_timer_);
+  auto_disable_timer_ = -1;
+}
+
+// A short gap in the input, e.g. a network hiccup, doesn't need to stop the
+// machine as long as the motion queue has enough to do: the planner keeps
+// its lookahead and we check again the next time we are idle.
+bool GCodeMachineControl::Impl::motion_outlasts_idle() {
+  if (cfg_.idle_halt_queue_depth <= 0 || planner_->IsPathHalted())
+    return false;
+  MotionQueueStats stats;
+  return motor_ops_->GetQueueStats(&stats)
+    && (int)stats.queue_depth > cfg_.idle_halt_queue_depth;
+}
+
 void GCodeMachineControl::Impl::input_idle(bool is_first) {
-  planner_->BringPathToHalt();
+  flush_acknowledgements();  // The sender might wait for them.
+  if (is_first || idle_halt_deferred_) {
+    if (motion_outlasts_idle()) {
+      idle_halt_deferred_ = true;
+      check_for_estop();
+      hold_motion_while_paused();
+      return;
+    }
+    is_first = true;  // Idle starts now, as far as the motors are concerned.
+    idle_halt_deferred_ = false;
+  }
+  flush_merged_move();
+  bring_path_to_halt();
+  if (event_server_) {
+    // Schedule motors and then fan off; new commands cancel this.
+    if (is_first && cfg_.auto_motor_disable_seconds > 0) {
+      if (auto_disable_timer_ >= 0) cancel_auto_disable();
+      auto_disable_timer_ = event_server_->RunAfter(
+        cfg_.auto_motor_disable_seconds * 1000000ULL, [this]() {
+          motors_enable(false);
+          auto_disable_timer_ = -1;
+          if (cfg_.auto_fan_disable_seconds > 0) {
+            auto_disable_timer_ = event_server_->RunAfter(
+              cfg_.auto_fan_disable_seconds * 1000000ULL, [this]() {
+                set_fanspeed(0);
+                bring_path_to_halt();  // Only sends the fan change.
+                auto_disable_timer_ = -1;
+                return false;
+              });
+          }
+          return false;
+        });
+    }
+    check_for_estop();
+    hold_motion_while_paused();
+    return;
+  }
   if (cfg_.auto_motor_disable_seconds > 0) {
     if (is_first) {
       next_auto_disable_motor_ = time(NULL) + cfg_.auto_motor_disable_seconds;
@@ -861,9 +1580,11 @@ void GCodeMachineControl::Impl::input_idle(bool is_first) {
   }
   if (next_auto_disable_fan_ != -1 && time(NULL) >= next_auto_disable_fan_) {
     set_fanspeed(0);
+    bring_path_to_halt();  // Only sends the fan change.
     next_auto_disable_fan_ = -1;
   }
   check_for_estop();
+  hold_motion_while_paused();
 }
 
 void GCodeMachineControl::Impl::set_speed_factor(float value) {
@@ -875,9 +1596,26 @@ void GCodeMachineControl::Impl::set_speed_factor(float value) {
             100.0f * value);
     return;
   }
-  prog_speed_factor_ = value;
+  // Slowing down applies right away to the queued moves if the motor ops
+  // can do that; faster is planned, so that we stay within the limits.
+  const float live = std::min(value, 1.0f);
+  if (motor_ops_->SetSpeedOverride(live, speed_ramp_seconds_)) {
+    live_speed_factor_ = live;
+    prog_speed_factor_ = value / live;
+  } else {
+    prog_speed_factor_ = value;
+  }
 }
 
+// Without the motion queue watching the switch, homing moves towards it in
+// steps of kHomingMM while polling it. Then it backs off in steps of
+// kBackoffMM until the switch is released.
+static const float kHomingMM = 0.5;               // TODO: make configurable?
+static const float kBackoffMM = kHomingMM / 10.0; // TODO: make configurable?
+// Moves the motion queue stops at the switch are not longer than this, so
+// that E-Stop is checked in between.
+static const float kWatchedMoveMM = kHomingMM;
+
 // Moves to endstop and returns how many steps it moved in the process.
 int GCodeMachineControl::Impl::move_to_endstop(enum GCodeParserAxis axis,
                                                float feedrate,
@@ -885,28 +1623,96 @@ int GCodeMachineControl::Impl::move_to_endstop(enum GCodeParserAxis axis,
   if (hardware_mapping_->IsHardwareSimulated())
     return 0;  // There are no switches to trigger, so pretend we stopped.
 
-  const float kHomingMM = 0.5;                    // TODO: make configurable?
-  const float kBackoffMM = kHomingMM / 10.0;      // TODO: make configurable?
-
   int total_movement = 0;
   const int dir = trigger == HardwareMapping::TRIGGER_MIN ? -1 : 1;
   float v0 = 0;
   float v1 = feedrate;
-  while (!hardware_mapping_->TestAxisSwitch(axis, trigger)) {
-    if (hardware_mapping_->TestEStopSwitch()) return 0;
+
+  // If the motion queue can watch the switch, get there in moves that stop
+  // right at it. Whatever is left is done by polling below.
+  HardwareMapping::SwitchInput input;
+  if (cfg_.move_range_mm[axis] > 0 &&
+      hardware_mapping_->GetAxisSwitchInput(axis, trigger, &input)) {
+    const float travel = 1.5 * cfg_.move_range_mm[axis];
+    bool watching = true;
+    bool triggered = false;
+    for (float done = 0; watching && !triggered && done < travel;
+         done += kWatchedMoveMM) {
+      if (hardware_mapping_->TestEStopSwitch()) return 0;
+      int moved;
+      watching = planner_->DirectDriveToInput(axis, dir * kWatchedMoveMM,
+                                              feedrate, input,
+                                              &moved, &triggered);
+      if (watching) total_movement += moved;
+    }
+    if (watching && !triggered) v0 = v1;  // Still moving on in the polling loop.
+  }
+
+  for (;;) {
+    const HardwareMapping::InputSnapshot inputs = hardware_mapping_->ReadInputs();
+    if (inputs.AxisSwitch(axis, trigger)) break;
+    if (inputs.EStopSwitch()) return 0;
     total_movement += planner_->DirectDrive(axis, dir * kHomingMM, v0, v1);
     v0 = v1;  // TODO: possibly acceleration over multiple segments.
   }
 
   // Go back until switch is not triggered anymore.
-  while (hardware_mapping_->TestAxisSwitch(axis, trigger)) {
-    if (hardware_mapping_->TestEStopSwitch()) return 0;
+  for (;;) {
+    const HardwareMapping::InputSnapshot inputs = hardware_mapping_->ReadInputs();
+    if (!inputs.AxisSwitch(axis, trigger)) break;
+    if (inputs.EStopSwitch()) return 0;
     total_movement += planner_->DirectDrive(axis, -dir * kBackoffMM, v0, v1);
   }
 
   return total_movement;
 }
 
+// Moves all "axes" to their endstop together; each stops as soon as its own
+// switch triggers while the others go on. The motion queue can only stop a
+// move on one input, so this always polls the switches.
+void GCodeMachineControl::Impl::move_to_endstops(AxisBitmap_t axes,
+                                                 float feedrate) {
+  if (hardware_mapping_->IsHardwareSimulated())
+    return;  // There are no switches to trigger, so pretend we stopped.
+
+  float v0 = 0;
+  for (AxisBitmap_t moving = axes; moving; /**/) {
+    const HardwareMapping::InputSnapshot inputs = hardware_mapping_->ReadInputs();
+    if (inputs.EStopSwitch()) return;
+    AxesRegister distance;
+    for (const GCodeParserAxis a : AllAxes()) {
+      if (!(moving & (1 << a))) continue;
+      const HardwareMapping::AxisTrigger trigger = cfg_.homing_trigger[a];
+      if (inputs.AxisSwitch(a, trigger))
+        moving &= ~(1 << a);
+      else
+        distance[a] = (trigger == HardwareMapping::TRIGGER_MIN ? -1 : 1)
+          * kHomingMM;
+    }
+    if (!moving) break;
+    planner_->DirectDrive(distance, v0, feedrate);
+    v0 = feedrate;
+  }
+
+  // Go back until the switches are not triggered anymore.
+  for (AxisBitmap_t pressed = axes; pressed; /**/) {
+    const HardwareMapping::InputSnapshot inputs = hardware_mapping_->ReadInputs();
+    if (inputs.EStopSwitch()) return;
+    AxesRegister distance;
+    for (const GCodeParserAxis a : AllAxes()) {
+      if (!(pressed & (1 << a))) continue;
+      const HardwareMapping::AxisTrigger trigger = cfg_.homing_trigger[a];
+      if (!inputs.AxisSwitch(a, trigger))
+        pressed &= ~(1 << a);
+      else
+        distance[a] = (trigger == HardwareMapping::TRIGGER_MIN ? 1 : -1)
+          * kBackoffMM;
+    }
+    if (!pressed) break;
+    planner_->DirectDrive(distance, v0, feedrate);
+  }
+}
+
 int GCodeMachineControl::Impl::move_to_probe(enum GCodeParserAxis axis,
                                              float feedrate, const int dir,
                                              int max_steps) {
@@ -918,6 +1724,28 @@ int GCodeMachineControl::Impl::move_to_probe(enum GCodeParserAxis axis,
   int total_movement = 0;
   float v0 = 0;
   float v1 = feedrate;
+
+  // Stopped right at the probe by the motion queue if it can.
+  HardwareMapping::SwitchInput input;
+  if (hardware_mapping_->GetProbeSwitchInput(&input)) {
+    const float travel = max_steps / cfg_.steps_per_mm[axis];
+    bool watching = true;
+    bool triggered = false;
+    for (float done = 0; watching && !triggered && done < travel;
+         done += kWatchedMoveMM) {
+      if (check_for_estop()) return total_movement;
+      const float distance = std::min(kWatchedMoveMM, travel - done);
+      int moved;
+      watching = planner_->DirectDriveToInput(axis, dir * distance, feedrate,
+                                              input, &moved, &triggered);
+      if (watching) total_movement += moved;
+    }
+    if (watching) {
+      if (!triggered) mprintf("// G30: max probe reached\n");
+      return total_movement;
+    }
+  }
+
   while (!hardware_mapping_->TestProbeSwitch()) {
     total_movement += planner_->DirectDrive(axis, dir * kProbeMM, v0, v1);
     v0 = v1;  // TODO: possibly acceleration over multiple segments.
@@ -931,29 +1759,63 @@ int GCodeMachineControl::Impl::move_to_probe(enum GCodeParserAxis axis,
 }
 
 // TODO(hzeller): Should planner provide homing features ?
-void GCodeMachineControl::Impl::home_axis(enum GCodeParserAxis axis) {
-  const HardwareMapping::AxisTrigger trigger = cfg_.homing_trigger[axis];
-  if (trigger == HardwareMapping::TRIGGER_NONE)
-    return;  // TODO: warn that there is no swich ? Should we pretend go back?
-  const float home_pos = ((trigger == HardwareMapping::TRIGGER_MAX)
-                          ? cfg_.move_range_mm[axis]
-                          : 0.0f);
+void GCodeMachineControl::Impl::home_axes(AxisBitmap_t axes) {
+  int count = 0;
+  GCodeParserAxis last = AXIS_X;
+  for (const GCodeParserAxis a : AllAxes()) {
+    if (!(axes & (1 << a))) continue;
+    // TODO: warn that there is no swich ? Should we pretend go back?
+    if (cfg_.homing_trigger[a] == HardwareMapping::TRIGGER_NONE) {
+      axes &= ~(1 << a);
+      continue;
+    }
+    ++count;
+    last = a;
+  }
+  if (count == 0) return;
   const float kHomingSpeed = 15; // mm/sec  (make configurable ?)
 
-  planner_->BringPathToHalt();
-  move_to_endstop(axis, kHomingSpeed, trigger);
-  planner_->SetExternalPosition(axis, home_pos);
+  bring_path_to_halt();
+  if (count == 1) {
+    // The motion queue might be able to stop just one right at the switch.
+    move_to_endstop(last, kHomingSpeed, cfg_.homing_trigger[last]);
+  } else {
+    move_to_endstops(axes, kHomingSpeed);
+  }
+  for (const GCodeParserAxis a : AllAxes()) {
+    if (!(axes & (1 << a))) continue;
+    const HardwareMapping::AxisTrigger trigger = cfg_.homing_trigger[a];
+    const float home_pos = ((trigger == HardwareMapping::TRIGGER_MAX)
+                            ? cfg_.move_range_mm[a]
+                            : 0.0f);
+    planner_->SetExternalPosition(a, home_pos);
+  }
 }
 
 void GCodeMachineControl::Impl::go_home(AxisBitmap_t axes_bitmap) {
-  planner_->BringPathToHalt();
+  flush_merged_move();
+  bring_path_to_halt();
   if (!clear_estop()) return;
+  // The axes of a comma separated group in the home order, e.g. "Z,XY", are
+  // homed together. Without commas, each on its own.
+  const bool grouped = cfg_.home_order.find(',') != std::string::npos;
+  AxisBitmap_t group = 0;
   for (const char axis_letter : cfg_.home_order) {
+    if (axis_letter == ',') {
+      home_axes(group);
+      group = 0;
+      continue;
+    }
     const enum GCodeParserAxis axis = gcodep_letter2axis(axis_letter);
     if (axis == GCODE_NUM_AXES || !(axes_bitmap & (1 << axis)))
       continue;
-    home_axis(axis);
+    group |= (1 << axis);
+    if (!grouped) {
+      home_axes(group);
+      group = 0;
+    }
   }
+  home_axes(group);
   if (check_for_estop()) return;
   homing_state_ = GCodeMachineControl::HomingState::HOMED;
 }
@@ -961,10 +1823,11 @@ void GCodeMachineControl::Impl::go_home(AxisBitmap_t axes_bitmap) {
 bool GCodeMachineControl::Impl::probe_axis(float feedrate,
                                            enum GCodeParserAxis axis,
                                            float *probe_result) {
+  flush_merged_move();
   if (!test_homing_status_ok())
     return false;
 
-  planner_->BringPathToHalt();
+  bring_path_to_halt();
 
   if (!hardware_mapping_->HasProbeSwitch(axis)) {
     mprintf("// BeagleG: No probe - axis %c does not have a probe switch\n",
@@ -992,6 +1855,55 @@ bool GCodeMachineControl::Impl::probe_axis(float feedrate,
   return true;
 }
 
+// Probe the Z height on a grid over the X/Y range, starting from the current
+// position, which needs to be safely above the bed. Heights are relative to
+// the origin, so that the Z that had been set there stays valid.
+void GCodeMachineControl::Impl::probe_bed_mesh() {
+  if (cfg_.bed_mesh_spacing <= 0) {
+    mprintf("// BeagleG: G29 needs a bed-mesh-spacing in the configuration\n");
+    return;
+  }
+  if (!test_homing_status_ok())
+    return;
+
+  delete bed_mesh_;   // Probe the plain machine.
+  bed_mesh_ = nullptr;
+
+  const float spacing = cfg_.bed_mesh_spacing;
+  const int size_x = std::max(1, (int)(cfg_.move_range_mm[AXIS_X] / spacing) + 1);
+  const int size_y = std::max(1, (int)(cfg_.move_range_mm[AXIS_Y] / spacing) + 1);
+  BedMesh *mesh = new BedMesh(size_x, size_y, spacing);
+
+  AxesRegister start;
+  planner_->GetLastTargetPosition(&start);
+  float reference = 0;
+  for (int y = 0; y < size_y; ++y) {
+    for (int i = 0; i < size_x; ++i) {
+      const int x = (y % 2 == 0) ? i : size_x - 1 - i;  // Zig-zag.
+      AxesRegister above = start;
+      above[AXIS_X] = x * spacing;
+      above[AXIS_Y] = y * spacing;
+      planner_->Enqueue(above, g0_feedrate_mm_per_sec_);
+      float height;
+      if (!probe_axis(0, AXIS_Z, &height)) {
+        delete mesh;
+        return;
+      }
+      planner_->Enqueue(above, g0_feedrate_mm_per_sec_);
+      if (x == 0 && y == 0) reference = height;
+      mesh->Set(x, y, height - reference);
+    }
+  }
+  planner_->Enqueue(start, g0_feedrate_mm_per_sec_);
+
+  for (int y = 0; y < size_y; ++y) {
+    mprintf("// Y%-7.1f", y * spacing);
+    for (int x = 0; x < size_x; ++x) mprintf(" %7.3f", mesh->Get(x, y));
+    mprintf("\n");
+  }
+  bed_mesh_ = mesh;
+}
+
 GCodeMachineControl::GCodeMachineControl(Impl *impl) : impl_(impl) {
 }
 GCodeMachineControl::~GCodeMachineControl() {
@@ -1023,10 +1935,18 @@ void GCodeMachineControl::GetHomePos(AxesRegister *home_pos) {
   }
 }
 
+bool GCodeMachineControl::ReloadConfig(const MachineControlConfig &config) {
+  return impl_->reload_config(config);
+}
+
 GCodeMachineControl::EStopState GCodeMachineControl::GetEStopStatus() {
   return impl_->GetEStopStatus();
 }
 
+bool GCodeMachineControl::CheckEStopAndPause() {
+  return impl_->CheckEStopAndPause();
+}
+
 GCodeMachineControl::HomingState GCodeMachineControl::GetHomeStatus() {
   return impl_->GetHomeStatus();
 }
@@ -1039,6 +1959,14 @@ void GCodeMachineControl::GetCurrentPosition(AxesRegister *pos) {
   impl_->GetCurrentPosition(pos);
 }
 
+float GCodeMachineControl::GetCurrentFeedrate() {
+  return impl_->GetCurrentFeedrate();
+}
+
+int GCodeMachineControl::GetSpindleRpm() {
+  return impl_->GetSpindleRpm();
+}
+
 GCodeParser::EventReceiver *GCodeMachineControl::ParseEventReceiver() {
   return impl_;
 }
@@ -1046,3 +1974,8 @@ GCodeParser::EventReceiver *GCodeMachineControl::ParseEventReceiver() {
 void GCodeMachineControl::SetMsgOut(FILE *msg_stream) {
   impl_->set_msg_stream(msg_stream);
 }
+
+void GCodeMachineControl::RunAsync(FDMultiplexer *event_server,
+                                   GCodeStreamer *streamer) {
+  impl_->RunAsync(event_server, streamer);
+}
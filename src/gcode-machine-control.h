@@ -24,9 +24,12 @@
 #include "hardware-mapping.h"
 
 #include <string>
+#include <vector>
 
 class MotorOperations;
 class ConfigParser;
+class FDMultiplexer;
+class GCodeStreamer;
 class Spindle;
 typedef AxesRegister FloatAxisConfig;
 
@@ -40,6 +43,17 @@ struct MachineControlConfig {
   // Read values from configuration file.
   bool ConfigureFromFile(ConfigParser *parser);
 
+  // Planner configurations to compare in a dry-run: each
+  // [planner-variant <name>] section in the file is a copy of this
+  // configuration with the [general] options given there changed.
+  bool ConfigurePlannerVariants(ConfigParser *parser,
+                                std::vector<std::string> *names,
+                                std::vector<MachineControlConfig> *variants) const;
+
+  // Length of the line segments to follow an arc or spline of the given
+  // radius at "speed" (mm/s, all speed factors applied).
+  float ArcSegmentLength(float radius, float speed) const;
+
   // Arrays with values for each axis
   FloatAxisConfig steps_per_mm;   // Steps per mm for each logical axis.
   FloatAxisConfig move_range_mm;  // Range of axes in mm (0..range[axis]). -1: no limit
@@ -47,11 +61,30 @@ struct MachineControlConfig {
   FloatAxisConfig max_feedrate;   // Max feedrate for axis (mm/s)
   FloatAxisConfig acceleration;   // Max acceleration for axis (mm/s^2)
 
+  FloatAxisConfig backlash_mm;    // Play taken up when the axis reverses.
+  FloatAxisConfig error_map_spacing;  // mm between values of error_map.
+  // Position error (actual minus commanded, mm) measured at 0,
+  // error_map_spacing, 2 * error_map_spacing ... Compensated by the planner.
+  std::vector<float> error_map[GCODE_NUM_AXES];
+
   float speed_factor;         // Multiply feed with. Should be 1.0 by default.
   float threshold_angle;      // Threshold angle to ignore speed changes
   float speed_tune_angle;     // Angle added to the angle between vectors for speed tuning
-
-  std::string home_order;        // Order in which axes are homed.
+  float junction_deviation;   // mm. If > 0, use for cornering speed instead
+                              // of threshold_angle.
+  float arc_tolerance;        // mm. Max deviation of arc segments from arc.
+  float collinear_tolerance;  // mm. If > 0, merge G1 moves deviating less.
+  bool native_arcs;           // Send arcs as such to the motion queue.
+  int lookahead_segments;     // Number of segments the planner looks ahead.
+  float s_curve_fraction;     // Fraction of accel time spent changing accel.
+                              // 0: constant acceleration. Range [0..1].
+  float bed_mesh_spacing;     // mm between the points G29 probes. 0: none.
+  std::string kinematics;     // "cartesian", "corexy" or "delta".
+  float delta_radius;         // mm from the center to the delta towers.
+  float delta_rod_length;     // mm length of the delta rods.
+
+  std::string home_order;        // Order in which axes are homed. With
+                                 // commas, groups homed together ("Z,XY").
 
   FixedArray<HardwareMapping::AxisTrigger, GCODE_NUM_AXES> homing_trigger;
 
@@ -59,6 +92,9 @@ struct MachineControlConfig {
   int auto_fan_disable_seconds; // Disable fan automatically after these seconds.
   int auto_fan_pwm;             // PWM value to automatically enable fan with.
   bool acknowledge_lines;       // Respond w/ 'ok' on each command on msg_stream.
+  int ack_window;               // If > 1, one 'ok <n>' for up to n commands.
+  int idle_halt_queue_depth;    // Gap in input only halts with at most that
+                                // many segments left in the motion queue.
   bool require_homing;          // Require homing before any moves.
   bool range_check;             // Do machine limit checks. Default 1.
   std::string clamp_to_range;   // Clamp these axes to machine range before
@@ -97,6 +133,20 @@ class GCodeMachineControl {
   // Set where messages should go.
   void SetMsgOut(FILE *msg_stream);
 
+  // Wait for dwells, spindle ramps and auto-disabling motors and fan in
+  // timers of the "event_server" instead of sleeping; meanwhile the input
+  // from "streamer" is held. Without, these block the caller.
+  void RunAsync(FDMultiplexer *event_server, GCodeStreamer *streamer);
+
+  // Use "config" from now on, e.g. after the configuration file changed.
+  // Only the feedrates, accelerations, ranges and planning options can
+  // change; steps/mm, homing, kinematics and axis compensation need a
+  // restart. Takes effect right away if the machine stands still, otherwise
+  // at the next halt of the path. Returns false if the configuration can't
+  // be used; the current one stays in effect then.
+  // Can only be called in the same thread that also handles gcode updates.
+  bool ReloadConfig(const MachineControlConfig &config);
+
   // Get the physical home position of this machine which depend
   // on the position of the endstops configured for homing.
   // return in *pos register.
@@ -110,6 +160,12 @@ class GCodeMachineControl {
   // Can only be called in the same thread that also handles gcode updates.
   EStopState GetEStopStatus();
 
+  // For motion that doesn't come from gcode, e.g. segments replayed from the
+  // segment cache: look at the E-Stop and pause switch as between gcode
+  // commands, holding the motion while paused. Returns false if in E-Stop.
+  // Can only be called in the same thread that also handles gcode updates.
+  bool CheckEStopAndPause();
+
   // Return the Homing status.
   // Can only be called in the same thread that also handles gcode updates.
   HomingState GetHomeStatus();
@@ -122,6 +178,16 @@ class GCodeMachineControl {
   // Can only be called in the same thread that also handles gcode updates.
   void GetCurrentPosition(AxesRegister *pos);
 
+  // Return the feedrate in mm/s for coordinated moves, including the
+  // speed factors; 0 if none has been programmed yet.
+  // Can only be called in the same thread that also handles gcode updates.
+  float GetCurrentFeedrate();
+
+  // Return the last programmed spindle speed in RPM; negative for
+  // counterclockwise, 0 if off or there is no spindle.
+  // Can only be called in the same thread that also handles gcode updates.
+  int GetSpindleRpm();
+
  private:
   class Impl;
 
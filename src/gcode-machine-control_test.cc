@@ -10,6 +10,7 @@
 #include "gcode-machine-control.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <gtest/gtest.h>
@@ -59,6 +60,23 @@ public:
   void WaitQueueEmpty() final {}
   bool GetPhysicalStatus(PhysicalStatus *status) final { return false; }
   void SetExternalPosition(int axis, int steps) final { }
+  bool SetSpeedOverride(float factor, float ramp_seconds) final {
+    if (!supports_speed_override) return false;
+    speed_override = factor;
+    return true;
+  }
+  bool GetQueueStats(MotionQueueStats *stats) final {
+    if (queue_depth < 0) return false;
+    memset(stats, 0, sizeof(*stats));
+    stats->queue_depth = queue_depth;
+    return true;
+  }
+
+  int enqueued() const { return (int)(current_ - expect_); }
+
+  bool supports_speed_override = false;
+  float speed_override = 1.0;
+  int queue_depth = -1;   // Reported by GetQueueStats(), if >= 0.
 
 private:
   // Helpers to compare and print MotorMovements.
@@ -94,9 +112,11 @@ class Harness {
  public:
   // Initialize harness with the expected sequence of motor movements
   // and return the callback struct to receive simulated gcode calls.
-  Harness(const LinearSegmentSteps *expected) : expect_motor_ops_(expected) {
+  Harness(const LinearSegmentSteps *expected, float collinear_tolerance = 0)
+    : expect_motor_ops_(expected) {
     struct MachineControlConfig config;
     init_test_config(&config, &hardware_);
+    config.collinear_tolerance = collinear_tolerance;
     machine_control = GCodeMachineControl::Create(config, &expect_motor_ops_,
                                                   &hardware_,
                                                   NULL,   // spindle
@@ -166,6 +186,29 @@ TEST(GCodeMachineControlTest, straight_segments_same_speed) {
   harness.gcode_emit()->motors_enable(false);  // finish movement.
 }
 
+// M220 slowing down goes to the motor operations if they can apply it to the
+// queued segments; these are planned with the full speed then.
+TEST(GCodeMachineControlTest, speed_factor_applied_live) {
+  static const struct LinearSegmentSteps expected[] = {
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ { 500}},  // accel
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {9000}},  // @100mm/s
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ { 500}},  // decel
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  Harness harness(expected);
+  harness.expect_motor_ops_.supports_speed_override = true;
+
+  harness.gcode_emit()->set_speed_factor(0.5);
+  EXPECT_EQ(0.5, harness.expect_motor_ops_.speed_override);
+
+  AxesRegister coordinates;
+  coordinates[AXIS_X] = 100;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+  EXPECT_EQ(50, harness.machine_control->GetCurrentFeedrate());
+
+  harness.gcode_emit()->motors_enable(false);  // finish movement.
+}
+
 // Since the speed limit of Y doubles the X speed limit, and the steps ratio is
 // 1:12 we expect the speed of the defining axis (Y) to be 6/5 of the X speed
 // limit. The same concept in the same way is extended to acceleration.
@@ -216,6 +259,196 @@ TEST(GCodeMachineControlTest, straight_segments_speed_change) {
   harness.gcode_emit()->motors_enable(false);  // finish movement.
 }
 
+// With collinear-tolerance, nearly straight segments become one move.
+TEST(GCodeMachineControlTest, collinear_segments_merged) {
+  static const struct LinearSegmentSteps expected[] = {
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ {  500}},  // accel
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {19000}},  // all moves
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ {  500}},  // decel
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  Harness harness(expected, 0.01);
+
+  AxesRegister coordinates;
+  for (int i = 1; i <= 4; ++i) {
+    coordinates[AXIS_X] = 50 * i;
+    coordinates[AXIS_Y] = (i % 2) ? 0.005 : 0;  // Wiggle within tolerance.
+    harness.gcode_emit()->coordinated_move(100, coordinates);
+  }
+
+  harness.gcode_emit()->motors_enable(false);  // finish movement.
+}
+
+// Corners are not merged, neither are segments that go back.
+TEST(GCodeMachineControlTest, collinear_merge_keeps_corners) {
+  static const struct LinearSegmentSteps expected[] = {
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ {  500}},
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ { 9000}},
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ {  500}},
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ { -500}},
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {-4000}},
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ { -500}},
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  Harness harness(expected, 0.01);
+
+  AxesRegister coordinates;
+  coordinates[AXIS_X] = 100;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+  coordinates[AXIS_X] = 50;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+
+  harness.gcode_emit()->motors_enable(false);  // finish movement.
+}
+
+// Messages between moves don't interrupt the motion, aux bits do.
+TEST(GCodeMachineControlTest, messages_keep_moves_merged) {
+  static const struct LinearSegmentSteps expected[] = {
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ {  500}},  // accel
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {14500}},  // M117 between
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ { 4500}},  // M7 before
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ {  500}},  // decel
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  Harness harness(expected, 0.01);
+
+  AxesRegister coordinates;
+  coordinates[AXIS_X] = 50;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+  harness.gcode_emit()->unprocessed('M', 117, "Layer 2");
+  coordinates[AXIS_X] = 100;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+  coordinates[AXIS_X] = 150;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+  harness.gcode_emit()->unprocessed('M', 7, "");  // Mist on with next move.
+  coordinates[AXIS_X] = 200;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+
+  harness.gcode_emit()->motors_enable(false);  // finish movement.
+}
+
+// Moves beyond the range of an axis are refused.
+TEST(GCodeMachineControlTest, moves_outside_range_rejected) {
+  static const struct LinearSegmentSteps expected[] = {
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  MockMotorOps motor_ops(expected);
+  HardwareMapping hardware;
+  struct MachineControlConfig config;
+  init_test_config(&config, &hardware);
+  config.move_range_mm[AXIS_Y] = 100;
+  GCodeMachineControl *machine_control
+    = GCodeMachineControl::Create(config, &motor_ops, &hardware, NULL, NULL);
+  ASSERT_TRUE(machine_control != NULL);
+  GCodeParser::EventReceiver *receiver = machine_control->ParseEventReceiver();
+
+  AxesRegister coordinates;
+  coordinates[AXIS_Y] = 101;
+  EXPECT_FALSE(receiver->rapid_move(-1, coordinates));
+  coordinates[AXIS_Y] = 50;
+  coordinates[AXIS_Z] = -1;
+  EXPECT_FALSE(receiver->rapid_move(-1, coordinates));
+  delete machine_control;
+}
+
+// A reloaded configuration waits for the machine to stop; the move already
+// planned keeps the old acceleration.
+TEST(GCodeMachineControlTest, reload_config_at_halt) {
+  static const struct LinearSegmentSteps expected[] = {
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ { 500}},  // accel
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {9000}},  // @100mm/s
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ { 500}},  // decel
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ {1000}},  // half accel
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {8000}},
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ {1000}},
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  Harness harness(expected);
+
+  AxesRegister coordinates;
+  coordinates[AXIS_X] = 100;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+
+  MachineControlConfig config;
+  HardwareMapping hardware;
+  init_test_config(&config, &hardware);
+  config.steps_per_mm[AXIS_Y] = 200;   // Would lose the position.
+  EXPECT_FALSE(harness.machine_control->ReloadConfig(config));
+  config.steps_per_mm[AXIS_Y] = 100;
+  config.acceleration[AXIS_X] = -1;
+  EXPECT_FALSE(harness.machine_control->ReloadConfig(config));
+  config.acceleration[AXIS_X] = 500;
+  EXPECT_TRUE(harness.machine_control->ReloadConfig(config));
+
+  harness.gcode_emit()->motors_enable(false);  // Halt: now in effect.
+  coordinates[AXIS_X] = 200;
+  harness.gcode_emit()->coordinated_move(100, coordinates);
+  harness.gcode_emit()->motors_enable(false);
+}
+
+// A gap in the input only halts the path once the motion queue runs low.
+TEST(GCodeMachineControlTest, input_idle_halts_when_queue_runs_low) {
+  static const struct LinearSegmentSteps expected[] = {
+    { /*v0*/     0.0, /*v1*/ 10000.0, 0, /*steps*/ { 500}},  // accel
+    { /*v0*/ 10000.0, /*v1*/ 10000.0, 0, /*steps*/ {9000}},  // @100mm/s
+    { /*v0*/ 10000.0, /*v1*/     0.0, 0, /*steps*/ { 500}},  // decel
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  MockMotorOps motor_ops(expected);
+  HardwareMapping hardware;
+  struct MachineControlConfig config;
+  init_test_config(&config, &hardware);
+  config.idle_halt_queue_depth = 4;
+  GCodeMachineControl *machine_control
+    = GCodeMachineControl::Create(config, &motor_ops, &hardware, NULL, NULL);
+  ASSERT_TRUE(machine_control != NULL);
+  GCodeParser::EventReceiver *receiver = machine_control->ParseEventReceiver();
+
+  AxesRegister coordinates;
+  coordinates[AXIS_X] = 100;
+  receiver->coordinated_move(100, coordinates);
+  motor_ops.queue_depth = 10;
+  receiver->input_idle(true);
+  EXPECT_EQ(0, motor_ops.enqueued());   // Could still get more to plan.
+
+  motor_ops.queue_depth = 4;
+  receiver->input_idle(false);
+  EXPECT_EQ(3, motor_ops.enqueued());
+  delete machine_control;
+}
+
+// With an ack-window, commands are acknowledged in groups; whatever is
+// left is acknowledged once the input goes idle.
+TEST(GCodeMachineControlTest, acknowledge_window) {
+  static const struct LinearSegmentSteps expected[] = {
+    { 0.0, 0.0, END_SENTINEL, {}},
+  };
+  MockMotorOps motor_ops(expected);
+  HardwareMapping hardware;
+  struct MachineControlConfig config;
+  init_test_config(&config, &hardware);
+  config.ack_window = 3;
+  char *buffer = NULL;
+  size_t size = 0;
+  FILE *msg = open_memstream(&buffer, &size);
+  GCodeMachineControl *machine_control
+    = GCodeMachineControl::Create(config, &motor_ops, &hardware, NULL, msg);
+  ASSERT_TRUE(machine_control != NULL);
+  GCodeParser::EventReceiver *receiver = machine_control->ParseEventReceiver();
+
+  for (int i = 0; i < 7; ++i) receiver->gcode_command_done('G', 1);
+  fflush(msg);
+  EXPECT_EQ("ok 3\nok 3\n", std::string(buffer, size));
+
+  receiver->input_idle(true);
+  fflush(msg);
+  EXPECT_EQ("ok 3\nok 3\nok 1\n", std::string(buffer, size));
+
+  delete machine_control;
+  fclose(msg);
+  free(buffer);
+}
+
 int main(int argc, char *argv[]) {
   Log_init("/dev/stderr");
   ::testing::InitGoogleTest(&argc, argv);
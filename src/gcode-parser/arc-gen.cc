@@ -21,7 +21,7 @@
 #include <math.h>
 #include <stdio.h>
 
-#include <functional>
+#include <algorithm>
 
 #if 0
 #  include "logging.h"
@@ -39,18 +39,35 @@
 // Normal axis is the axis perpendicular to the plane the arc is
 // created in.
 
-// Small arc segments increase accuracy, though might create some
-// CPU load. With 0.1mm arc segments, we can generate about 90 meter/second
-// of arcs with the BeagleBone Black CPU. Sufficient :)
-#define MM_PER_ARC_SEGMENT      0.1
+// Segment length is chosen by the EventReceiver given radius and feedrate;
+// per default from the allowed chord error. So large arcs result in few,
+// long segments, while tight arcs are still followed closely.
+#define DEFAULT_ARC_TOLERANCE_MM   0.005
+
+// Never split a full circle in fewer segments than this, so that very
+// tight arcs still look like arcs.
+#define MIN_SEGMENTS_PER_CIRCLE    8
+
+// Limit of bisections of a spline: not more than 2^10 segments.
+#define MAX_SPLINE_DEPTH           10
+
+float gcodep_chord_length(float radius, float tolerance) {
+  if (tolerance >= radius) return 2 * radius;
+  return 2 * sqrtf(tolerance * (2 * radius - tolerance));
+}
+
+// The callbacks below are template parameters, so that passing them does not
+// need a std::function, which might allocate for every move.
 
 // Generate an arc. Input is the
+template <typename SegmentLength, typename SegmentOutput>
 static void arc_gen(enum GCodeParserAxis normal_axis,  // Normal axis
                     bool is_cw,                        // 0 CCW, 1 CW
                     AxesRegister *position_out,   // start position. Will be updated.
                     const AxesRegister &center,     // Offset to center.
                     const AxesRegister &target,     // Target position.
-                    std::function<void(const AxesRegister&)> segment_output) {
+                    const SegmentLength &segment_length,
+                    const SegmentOutput &segment_output) {
   // Depending on the normal vector, pre-calc plane
   enum GCodeParserAxis plane[3];
   switch (normal_axis) {
@@ -101,8 +118,16 @@ static void arc_gen(enum GCodeParserAxis normal_axis,  // Normal axis
   if (mm_of_travel < 0.00001)
     return;
 
-  // Figure out how many segments for this gcode
-  const int segments = floorf(mm_of_travel / MM_PER_ARC_SEGMENT);
+  // Figure out how many segments for this gcode. The chord error only
+  // depends on the travel in the plane; a helix is just stretched.
+  const float max_segment = segment_length(radius);
+  const float min_by_angle = fabsf(angular_travel) * MIN_SEGMENTS_PER_CIRCLE
+    / (2 * M_PI);
+  const float min_by_length = max_segment > 0
+    ? fabsf(angular_travel) * radius / max_segment
+    : 0;
+  const int segments = std::max(1, (int)ceilf(std::max(min_by_length,
+                                                       min_by_angle)));
 
   const float theta_per_segment = angular_travel / segments;
   const float linear_per_segment = linear_travel / segments;
@@ -152,11 +177,77 @@ static AxesRegister calc_bezier_point(float t,
   return p;
 }
 
+// Distance of point "p" from the line through "a" and "b" in the XY plane.
+static float distance_from_line(const AxesRegister &p,
+                                const AxesRegister &a, const AxesRegister &b) {
+  const float dx = b[AXIS_X] - a[AXIS_X];
+  const float dy = b[AXIS_Y] - a[AXIS_Y];
+  const float len = hypotf(dx, dy);
+  if (len < 1e-6) return hypotf(p[AXIS_X] - a[AXIS_X], p[AXIS_Y] - a[AXIS_Y]);
+  return fabsf(dx * (a[AXIS_Y] - p[AXIS_Y]) - dy * (a[AXIS_X] - p[AXIS_X]))
+    / len;
+}
+
+// Emit line segments approximating the bezier piece between t0 and t1 by
+// bisecting until each piece is short enough for its curvature.
+// The curve stays within the convex hull of its control points, so the
+// distance of the control points from the chord bounds the error d. From
+// that, we estimate the radius with the sagitta relation d = len^2 / (8r).
+template <typename SegmentLength, typename SegmentOutput>
+static void spline_piece(float t0, float t1,
+                         const AxesRegister &p0, const AxesRegister &p1,
+                         const AxesRegister &p2, const AxesRegister &p3,
+                         int depth,
+                         const SegmentLength &segment_length,
+                         const SegmentOutput &out) {
+  const AxesRegister a = calc_bezier_point(t0, p0, p1, p2, p3);
+  const AxesRegister b = calc_bezier_point(t1, p0, p1, p2, p3);
+  if (depth < MAX_SPLINE_DEPTH) {
+    // Control points of the piece [t0, t1] (de Casteljau); only the inner
+    // ones matter.
+    const float h = (t1 - t0) / 3;
+    AxesRegister c1 = a, c2 = b;
+    for (const GCodeParserAxis axis : { AXIS_X, AXIS_Y }) {
+      const float u0 = 1 - t0, u1 = 1 - t1;
+      const float d0 = 3 * (u0 * u0 * (p1[axis] - p0[axis])
+                            + 2 * u0 * t0 * (p2[axis] - p1[axis])
+                            + t0 * t0 * (p3[axis] - p2[axis]));
+      const float d1 = 3 * (u1 * u1 * (p1[axis] - p0[axis])
+                            + 2 * u1 * t1 * (p2[axis] - p1[axis])
+                            + t1 * t1 * (p3[axis] - p2[axis]));
+      c1[axis] = a[axis] + h * d0;
+      c2[axis] = b[axis] - h * d1;
+    }
+    const float len = hypotf(b[AXIS_X] - a[AXIS_X], b[AXIS_Y] - a[AXIS_Y]);
+    const float deviation = std::max(distance_from_line(c1, a, b),
+                                     distance_from_line(c2, a, b));
+    // Control polygon much longer than the chord: e.g. a loop or cusp, in
+    // which the deviation from the chord says little. A few bisections
+    // untangle that.
+    const float hull_len = (hypotf(c1[AXIS_X] - a[AXIS_X], c1[AXIS_Y] - a[AXIS_Y])
+                            + hypotf(c2[AXIS_X] - c1[AXIS_X],
+                                     c2[AXIS_Y] - c1[AXIS_Y])
+                            + hypotf(b[AXIS_X] - c2[AXIS_X],
+                                     b[AXIS_Y] - c2[AXIS_Y]));
+    const float radius = deviation > 0 ? len * len / (8 * deviation) : INFINITY;
+    if ((depth < 4 && hull_len > 2 * len + 1e-4)
+        || len > segment_length(radius)) {
+      const float mid = (t0 + t1) / 2;
+      spline_piece(t0, mid, p0, p1, p2, p3, depth+1, segment_length, out);
+      spline_piece(mid, t1, p0, p1, p2, p3, depth+1, segment_length, out);
+      return;
+    }
+  }
+  out(b);
+}
+
+template <typename SegmentLength, typename SegmentOutput>
 static void spline_gen(const AxesRegister &start,
                        const AxesRegister &cp1,
                        const AxesRegister &cp2,
                        const AxesRegister &target,
-                std::function<void (const AxesRegister& pos)> segment_output) {
+                       const SegmentLength &segment_length,
+                       const SegmentOutput &segment_output) {
 #if 0
   Log_debug("spline_gen: start:%.3f,%.3f cp1:%.3f,%.3f cp2:%.3f,%.3f end:%.3f,%.3f\n",
             position[AXIS_X], position[AXIS_Y],
@@ -165,9 +256,15 @@ static void spline_gen(const AxesRegister &start,
             target[AXIS_X], target[AXIS_Y]);
 #endif
 
-  for (float t = 0; t < 1; t += 0.01f) {
-    segment_output(calc_bezier_point(t, start, cp1, cp2, target));
-  }
+  // The last point is exactly the target, not the bezier evaluation of it.
+  AxesRegister last;
+  bool have_last = false;
+  spline_piece(0, 1, start, cp1, cp2, target, 0, segment_length,
+               [&](const AxesRegister &pos) {
+                 if (have_last) segment_output(last);
+                 last = pos;
+                 have_last = true;
+               });
   segment_output(target);
 }
 
@@ -178,8 +275,11 @@ void GCodeParser::EventReceiver::arc_move(float feed_mm_p_sec,
                                           const AxesRegister &center,
                                           const AxesRegister &end) {
   AxesRegister position = start;
-  arc_gen(normal_axis, clockwise, &position,
-          center, end, [this, feed_mm_p_sec](const AxesRegister &pos) {
+  arc_gen(normal_axis, clockwise, &position, center, end,
+          [this, feed_mm_p_sec](float radius) {
+            return arc_segment_length(radius, feed_mm_p_sec);
+          },
+          [this, feed_mm_p_sec](const AxesRegister &pos) {
             coordinated_move(feed_mm_p_sec, pos);
           });
 }
@@ -190,7 +290,22 @@ void GCodeParser::EventReceiver::spline_move(float feed_mm_p_sec,
                                              const AxesRegister &cp2,
                                              const AxesRegister &end) {
   spline_gen(start, cp1, cp2, end,
+             [this, feed_mm_p_sec](float radius) {
+               return arc_segment_length(radius, feed_mm_p_sec);
+             },
              [this, feed_mm_p_sec](const AxesRegister &pos) {
                coordinated_move(feed_mm_p_sec, pos);
              });
 }
+
+void GCodeParser::EventReceiver::raster_move(float feed_mm_p_sec,
+                                             const AxesRegister &start,
+                                             const AxesRegister &end,
+                                             const uint8_t *power, int count) {
+  coordinated_move(feed_mm_p_sec, end);
+}
+
+float GCodeParser::EventReceiver::arc_segment_length(float radius,
+                                                     float feed_mm_p_sec) {
+  return gcodep_chord_length(radius, DEFAULT_ARC_TOLERANCE_MM);
+}
@@ -52,6 +52,9 @@ public:
     return true;
   }
 
+  // Fine segments, so that the chords add up to the arc length.
+  float arc_segment_length(float radius, float feed) final { return 0.1; }
+
   float total_len() const { return total_len_; }
 
   bool rapid_move(float feed_mm_p_sec,
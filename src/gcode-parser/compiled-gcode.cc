@@ -0,0 +1,470 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "compiled-gcode.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "common/logging.h"
+
+static const char kMagic[4] = { 'B', 'G', 'C', 'C' };
+static const uint32_t kVersion = 1;
+
+// Record types. Only append; the values are part of the file format.
+enum RecordType {
+  REC_START = 1,
+  REC_PROGRAM_END,         // gcode_finished(false), e.g. M2
+  REC_ORIGIN_OFFSET,       // register, string
+  REC_COMMAND_DONE,        // char, float
+  REC_WAIT_FOR_START,
+  REC_GO_HOME,             // uint32 bitmap
+  REC_PROBE,               // float feed, uint8 axis
+  REC_SPINDLE_SPEED,       // float
+  REC_SPEED_FACTOR,        // float
+  REC_FANSPEED,            // float
+  REC_SET_TEMPERATURE,     // float
+  REC_WAIT_TEMPERATURE,
+  REC_DWELL,               // float
+  REC_MOTORS_ENABLE,       // uint8
+  REC_CLAMP,               // uint32 bitmap; applies to the next move.
+  REC_COORDINATED_MOVE,    // float feed, register
+  REC_RAPID_MOVE,          // float feed, register
+  REC_ARC,                 // float feed, uint8 axis, uint8 cw, 3 registers
+  REC_SPLINE,              // float feed, 4 registers
+  REC_UNPROCESSED,         // char, float, string
+  REC_RASTER,              // float feed, 2 registers, uint16 count, bytes
+};
+
+CompiledGCodeWriter::CompiledGCodeWriter(FILE *out)
+  : out_(out), parser_(NULL), ok_(true), probe_count_(0) {
+  Write(kMagic, sizeof(kMagic));
+  Write(&kVersion, sizeof(kVersion));
+}
+
+void CompiledGCodeWriter::Write(const void *data, size_t len) {
+  if (ok_ && fwrite(data, 1, len, out_) != len)
+    ok_ = false;
+}
+
+void CompiledGCodeWriter::WriteType(int type) {
+  const uint8_t t = type;
+  Write(&t, 1);
+}
+
+void CompiledGCodeWriter::WriteString(const char *str) {
+  const uint16_t len = str ? strnlen(str, 0xffff) : 0;
+  Write(&len, sizeof(len));
+  Write(str, len);
+}
+
+// Bitmap of changed axes, followed by their values.
+void CompiledGCodeWriter::WriteRegister(const AxesRegister &reg) {
+  uint16_t changed = 0;
+  for (const GCodeParserAxis a : AllAxes()) {
+    if (reg[a] != last_register_[a]) changed |= (1 << a);
+  }
+  Write(&changed, sizeof(changed));
+  for (const GCodeParserAxis a : AllAxes()) {
+    if (changed & (1 << a)) WriteFloat(reg[a]);
+  }
+  last_register_ = reg;
+}
+
+void CompiledGCodeWriter::gcode_start(GCodeParser *parser) {
+  parser_ = parser;
+  WriteType(REC_START);
+}
+
+void CompiledGCodeWriter::gcode_finished(bool end_of_stream) {
+  // The end of stream is reported by whoever replays it; only the
+  // program end (M2, M30) is part of the content.
+  if (!end_of_stream) WriteType(REC_PROGRAM_END);
+}
+
+void CompiledGCodeWriter::inform_origin_offset(const AxesRegister &offset,
+                                               const char *named_offset) {
+  WriteType(REC_ORIGIN_OFFSET);
+  WriteRegister(offset);
+  WriteString(named_offset);
+}
+
+void CompiledGCodeWriter::gcode_command_done(char letter, float val) {
+  WriteType(REC_COMMAND_DONE);
+  Write(&letter, 1);
+  WriteFloat(val);
+}
+
+void CompiledGCodeWriter::wait_for_start() { WriteType(REC_WAIT_FOR_START); }
+
+void CompiledGCodeWriter::go_home(AxisBitmap_t axis_bitmap) {
+  WriteType(REC_GO_HOME);
+  Write(&axis_bitmap, sizeof(axis_bitmap));
+}
+
+bool CompiledGCodeWriter::probe_axis(float feed_mm_p_sec,
+                                     enum GCodeParserAxis axis,
+                                     float *probed_position) {
+  WriteType(REC_PROBE);
+  WriteFloat(feed_mm_p_sec);
+  const uint8_t a = axis;
+  Write(&a, 1);
+  ++probe_count_;
+  return false;  // We don't know the outcome.
+}
+
+void CompiledGCodeWriter::change_spindle_speed(float value) {
+  WriteType(REC_SPINDLE_SPEED);
+  WriteFloat(value);
+}
+
+void CompiledGCodeWriter::set_speed_factor(float factor) {
+  WriteType(REC_SPEED_FACTOR);
+  WriteFloat(factor);
+}
+
+void CompiledGCodeWriter::set_fanspeed(float value) {
+  WriteType(REC_FANSPEED);
+  WriteFloat(value);
+}
+
+void CompiledGCodeWriter::set_temperature(float degrees_c) {
+  WriteType(REC_SET_TEMPERATURE);
+  WriteFloat(degrees_c);
+}
+
+void CompiledGCodeWriter::wait_temperature() {
+  WriteType(REC_WAIT_TEMPERATURE);
+}
+
+void CompiledGCodeWriter::dwell(float time_ms) {
+  WriteType(REC_DWELL);
+  WriteFloat(time_ms);
+}
+
+void CompiledGCodeWriter::motors_enable(bool enable) {
+  WriteType(REC_MOTORS_ENABLE);
+  const uint8_t e = enable;
+  Write(&e, 1);
+}
+
+// Clamping depends on the machine, so it is done when replaying.
+void CompiledGCodeWriter::clamp_to_range(AxisBitmap_t affected,
+                                         AxesRegister *axes) {
+  WriteType(REC_CLAMP);
+  Write(&affected, sizeof(affected));
+}
+
+bool CompiledGCodeWriter::coordinated_move(float feed_mm_p_sec,
+                                           const AxesRegister &absolute_pos) {
+  WriteType(REC_COORDINATED_MOVE);
+  WriteFloat(feed_mm_p_sec);
+  WriteRegister(absolute_pos);
+  return true;
+}
+
+bool CompiledGCodeWriter::rapid_move(float feed_mm_p_sec,
+                                     const AxesRegister &absolute_pos) {
+  WriteType(REC_RAPID_MOVE);
+  WriteFloat(feed_mm_p_sec);
+  WriteRegister(absolute_pos);
+  return true;
+}
+
+void CompiledGCodeWriter::arc_move(float feed_mm_p_sec,
+                                   GCodeParserAxis normal_axis, bool clockwise,
+                                   const AxesRegister &start,
+                                   const AxesRegister &center,
+                                   const AxesRegister &end) {
+  WriteType(REC_ARC);
+  WriteFloat(feed_mm_p_sec);
+  const uint8_t flags[2] = { (uint8_t)normal_axis, (uint8_t)clockwise };
+  Write(flags, sizeof(flags));
+  WriteRegister(start);
+  WriteRegister(center);
+  WriteRegister(end);
+}
+
+void CompiledGCodeWriter::raster_move(float feed_mm_p_sec,
+                                      const AxesRegister &start,
+                                      const AxesRegister &end,
+                                      const uint8_t *power, int count) {
+  if (count > 0xffff) {
+    ok_ = false;  // Can't be represented.
+    return;
+  }
+  WriteType(REC_RASTER);
+  WriteFloat(feed_mm_p_sec);
+  WriteRegister(start);
+  WriteRegister(end);
+  const uint16_t len = count;
+  Write(&len, sizeof(len));
+  Write(power, len);
+}
+
+void CompiledGCodeWriter::spline_move(float feed_mm_p_sec,
+                                      const AxesRegister &start,
+                                      const AxesRegister &cp1,
+                                      const AxesRegister &cp2,
+                                      const AxesRegister &end) {
+  WriteType(REC_SPLINE);
+  WriteFloat(feed_mm_p_sec);
+  WriteRegister(start);
+  WriteRegister(cp1);
+  WriteRegister(cp2);
+  WriteRegister(end);
+}
+
+// We don't know how much of the line the receiver will consume. Typically,
+// that is the parameters up to the next G or M command, so we keep these
+// and let the parser continue with the rest. Whatever the receiver does
+// not consume at replay is parsed then.
+const char *CompiledGCodeWriter::unprocessed(char letter, float value,
+                                             const char *rest_of_line) {
+  const char *remaining = NULL;
+  if (parser_ && !(letter == 'M' && (int)value == 117)) {  // M117: message
+    const char *pos = rest_of_line;
+    char l;
+    float v;
+    const char *next;
+    while ((next = parser_->ParsePair(pos, &l, &v, NULL)) != NULL) {
+      if (l == 'G' || l == 'M') {
+        remaining = pos;
+        break;
+      }
+      pos = next;
+    }
+  }
+  const std::string params = remaining
+    ? std::string(rest_of_line, remaining - rest_of_line)
+    : std::string(rest_of_line);
+  WriteType(REC_UNPROCESSED);
+  Write(&letter, 1);
+  WriteFloat(value);
+  WriteString(params.c_str());
+  return remaining;
+}
+
+CompiledGCodeReader::CompiledGCodeReader()
+  : fd_(-1), file_pos_(0), buffer_pos_(0), at_end_(true),
+    have_clamp_(false), clamp_axes_(0) {
+}
+
+bool CompiledGCodeReader::Open(int fd) {
+  char header[sizeof(kMagic) + sizeof(kVersion)];
+  if (pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header)
+      || memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  uint32_t version;
+  memcpy(&version, header + sizeof(kMagic), sizeof(version));
+  if (version != kVersion) {
+    Log_error("Compiled G-code version %u; only understand %u.",
+              version, kVersion);
+    return false;
+  }
+  fd_ = fd;
+  file_pos_ = sizeof(header);
+  buffer_.clear();
+  buffer_pos_ = 0;
+  at_end_ = false;
+  last_register_.zero();
+  have_clamp_ = false;
+  return true;
+}
+
+void CompiledGCodeReader::Close() {
+  fd_ = -1;
+  buffer_.clear();
+  buffer_pos_ = 0;
+  at_end_ = true;
+}
+
+bool CompiledGCodeReader::Read(void *data, size_t len) {
+  if (buffer_pos_ + len > buffer_.size()) {
+    // Refill: keep what is not consumed yet and read the next chunk.
+    enum { kChunkSize = 65536 };
+    file_pos_ += buffer_pos_;
+    buffer_.erase(0, buffer_pos_);
+    buffer_pos_ = 0;
+    const size_t have = buffer_.size();
+    buffer_.resize(have + std::max(len, (size_t)kChunkSize));
+    const ssize_t r = pread(fd_, &buffer_[have], buffer_.size() - have,
+                            file_pos_ + have);
+    buffer_.resize(have + (r > 0 ? r : 0));
+    if (len > buffer_.size())
+      return false;
+  }
+  memcpy(data, buffer_.data() + buffer_pos_, len);
+  buffer_pos_ += len;
+  return true;
+}
+
+bool CompiledGCodeReader::ReadString(std::string *str) {
+  uint16_t len;
+  if (!Read(&len, sizeof(len))) return false;
+  str->resize(len);
+  return len == 0 || Read(&(*str)[0], len);
+}
+
+bool CompiledGCodeReader::ReadRegister(AxesRegister *reg) {
+  uint16_t changed;
+  if (!Read(&changed, sizeof(changed))) return false;
+  for (const GCodeParserAxis a : AllAxes()) {
+    if ((changed & (1 << a)) && !ReadFloat(&last_register_[a]))
+      return false;
+  }
+  *reg = last_register_;
+  return true;
+}
+
+bool CompiledGCodeReader::ReplayNext(GCodeParser *parser,
+                                     GCodeParser::EventReceiver *receiver,
+                                     FILE *msg_stream) {
+  if (at_end_) return false;
+  uint8_t type;
+  if (!Read(&type, 1)) {
+    at_end_ = true;   // Regular end.
+    return false;
+  }
+
+  // Scratch space for all records.
+  float f = 0;
+  uint8_t b[2] = { 0, 0 };
+  uint32_t bitmap = 0;
+  char letter = 0;
+  std::string str;
+  AxesRegister r1, r2, r3, r4;
+  bool ok = true;
+
+  switch (type) {
+  case REC_START:
+    receiver->gcode_start(parser);
+    break;
+  case REC_PROGRAM_END:
+    receiver->gcode_finished(false);
+    break;
+  case REC_ORIGIN_OFFSET:
+    ok = ReadRegister(&r1) && ReadString(&str);
+    if (ok) receiver->inform_origin_offset(r1, str.c_str());
+    break;
+  case REC_COMMAND_DONE:
+    ok = Read(&letter, 1) && ReadFloat(&f);
+    if (ok) receiver->gcode_command_done(letter, f);
+    break;
+  case REC_WAIT_FOR_START:
+    receiver->wait_for_start();
+    break;
+  case REC_GO_HOME:
+    ok = Read(&bitmap, sizeof(bitmap));
+    if (ok) receiver->go_home(bitmap);
+    break;
+  case REC_PROBE:
+    ok = ReadFloat(&f) && Read(b, 1) && b[0] < GCODE_NUM_AXES;
+    if (ok) {
+      float probed;
+      receiver->probe_axis(f, (GCodeParserAxis)b[0], &probed);
+    }
+    break;
+  case REC_SPINDLE_SPEED:
+    ok = ReadFloat(&f);
+    if (ok) receiver->change_spindle_speed(f);
+    break;
+  case REC_SPEED_FACTOR:
+    ok = ReadFloat(&f);
+    if (ok) receiver->set_speed_factor(f);
+    break;
+  case REC_FANSPEED:
+    ok = ReadFloat(&f);
+    if (ok) receiver->set_fanspeed(f);
+    break;
+  case REC_SET_TEMPERATURE:
+    ok = ReadFloat(&f);
+    if (ok) receiver->set_temperature(f);
+    break;
+  case REC_WAIT_TEMPERATURE:
+    receiver->wait_temperature();
+    break;
+  case REC_DWELL:
+    ok = ReadFloat(&f);
+    if (ok) receiver->dwell(f);
+    break;
+  case REC_MOTORS_ENABLE:
+    ok = Read(b, 1);
+    if (ok) receiver->motors_enable(b[0] != 0);
+    break;
+  case REC_CLAMP:
+    ok = Read(&clamp_axes_, sizeof(clamp_axes_));
+    have_clamp_ = ok;
+    break;
+  case REC_COORDINATED_MOVE:
+  case REC_RAPID_MOVE:
+    ok = ReadFloat(&f) && ReadRegister(&r1);
+    if (!ok) break;
+    if (have_clamp_) {
+      receiver->clamp_to_range(clamp_axes_, &r1);
+      have_clamp_ = false;
+    }
+    if (type == REC_COORDINATED_MOVE)
+      receiver->coordinated_move(f, r1);
+    else
+      receiver->rapid_move(f, r1);
+    break;
+  case REC_ARC:
+    ok = ReadFloat(&f) && Read(b, 2) && b[0] < GCODE_NUM_AXES
+      && ReadRegister(&r1) && ReadRegister(&r2) && ReadRegister(&r3);
+    if (ok) receiver->arc_move(f, (GCodeParserAxis)b[0], b[1] != 0,
+                               r1, r2, r3);
+    break;
+  case REC_SPLINE:
+    ok = ReadFloat(&f) && ReadRegister(&r1) && ReadRegister(&r2)
+      && ReadRegister(&r3) && ReadRegister(&r4);
+    if (ok) receiver->spline_move(f, r1, r2, r3, r4);
+    break;
+  case REC_RASTER:
+    ok = ReadFloat(&f) && ReadRegister(&r1) && ReadRegister(&r2)
+      && ReadString(&str);
+    if (!ok) break;
+    if (have_clamp_) {
+      receiver->clamp_to_range(clamp_axes_, &r2);
+      have_clamp_ = false;
+    }
+    receiver->raster_move(f, r1, r2, (const uint8_t *)str.data(), str.size());
+    break;
+  case REC_UNPROCESSED:
+    ok = Read(&letter, 1) && ReadFloat(&f) && ReadString(&str);
+    if (ok) {
+      const char *remain = receiver->unprocessed(letter, f, str.c_str());
+      if (remain && *remain) parser->ParseBlock(remain, msg_stream);
+    }
+    break;
+  default:
+    Log_error("Compiled G-code: unknown record type %d", type);
+    ok = false;
+  }
+
+  if (!ok) {
+    Log_error("Compiled G-code: corrupt or truncated record.");
+    at_end_ = true;
+  }
+  return ok;
+}
@@ -0,0 +1,143 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_COMPILED_GCODE_H_
+#define _BEAGLEG_COMPILED_GCODE_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "gcode-parser.h"
+
+// Precompiled G-code: a binary stream of the EventReceiver calls the
+// GCodeParser emitted for a file. Replaying it gives the receiver the same
+// calls without lexing, expression evaluation or coordinate-system handling
+// at run time.
+//
+// Format: magic "BGCC", uint32 version, then records of one type byte plus
+// payload in host byte order (little endian on the BeagleBone).
+// Axis registers are only stored for axes that changed since the previously
+// stored register, which keeps dense moves small.
+//
+// Limitations: everything is resolved at compile time, so results the
+// machine only knows at run time (G30 probing, parameters loaded from the
+// parameter file) are not reflected in later positions.
+
+// EventReceiver that writes all events it receives to a compiled stream.
+class CompiledGCodeWriter : public GCodeParser::EventReceiver {
+public:
+  // Writes to "out", which is not closed.
+  explicit CompiledGCodeWriter(FILE *out);
+
+  // Returns false if there was an error writing.
+  bool ok() const { return ok_; }
+
+  // Number of G30 probes recorded; their outcome is not known at compile
+  // time.
+  int probe_count() const { return probe_count_; }
+
+  void gcode_start(GCodeParser *parser) final;
+  void gcode_finished(bool end_of_stream) final;
+  void inform_origin_offset(const AxesRegister &offset,
+                            const char *named_offset) final;
+  void gcode_command_done(char letter, float val) final;
+  void wait_for_start() final;
+  void go_home(AxisBitmap_t axis_bitmap) final;
+  bool probe_axis(float feed_mm_p_sec, enum GCodeParserAxis axis,
+                  float *probed_position) final;
+  void change_spindle_speed(float value) final;
+  void set_speed_factor(float factor) final;
+  void set_fanspeed(float value) final;
+  void set_temperature(float degrees_c) final;
+  void wait_temperature() final;
+  void dwell(float time_ms) final;
+  void motors_enable(bool enable) final;
+  void clamp_to_range(AxisBitmap_t affected, AxesRegister *axes) final;
+  bool coordinated_move(float feed_mm_p_sec,
+                        const AxesRegister &absolute_pos) final;
+  bool rapid_move(float feed_mm_p_sec,
+                  const AxesRegister &absolute_pos) final;
+  void arc_move(float feed_mm_p_sec,
+                GCodeParserAxis normal_axis, bool clockwise,
+                const AxesRegister &start,
+                const AxesRegister &center,
+                const AxesRegister &end) final;
+  void spline_move(float feed_mm_p_sec,
+                   const AxesRegister &start,
+                   const AxesRegister &cp1, const AxesRegister &cp2,
+                   const AxesRegister &end) final;
+  void raster_move(float feed_mm_p_sec,
+                   const AxesRegister &start, const AxesRegister &end,
+                   const uint8_t *power, int count) final;
+  const char *unprocessed(char letter, float value,
+                          const char *rest_of_line) final;
+
+private:
+  void Write(const void *data, size_t len);
+  void WriteType(int type);
+  void WriteFloat(float f) { Write(&f, sizeof(f)); }
+  void WriteString(const char *str);
+  void WriteRegister(const AxesRegister &reg);
+
+  FILE *const out_;
+  GCodeParser *parser_;
+  bool ok_;
+  int probe_count_;
+  AxesRegister last_register_;
+};
+
+// Replays a compiled stream from a file descriptor to an EventReceiver, one
+// event at a time, so that it can be interleaved with other work.
+class CompiledGCodeReader {
+public:
+  CompiledGCodeReader();
+
+  // Start reading "fd" if it is a compiled stream; otherwise return false
+  // and leave "fd" untouched. Uses pread(), so needs a regular file; the
+  // file descriptor is not closed.
+  bool Open(int fd);
+  void Close();
+
+  // Replay the next event to "receiver". "parser" is handed to the receiver
+  // in gcode_start() and parses what the receiver did not consume of
+  // an unprocessed() command.
+  // Returns false if there is nothing more to replay.
+  bool ReplayNext(GCodeParser *parser, GCodeParser::EventReceiver *receiver,
+                  FILE *msg_stream);
+
+  bool AtEnd() const { return at_end_; }
+
+private:
+  bool Read(void *data, size_t len);
+  bool ReadFloat(float *f) { return Read(f, sizeof(*f)); }
+  bool ReadString(std::string *str);
+  bool ReadRegister(AxesRegister *reg);
+
+  int fd_;
+  off_t file_pos_;          // File offset of buffer_[0].
+  std::string buffer_;
+  size_t buffer_pos_;
+  bool at_end_;
+  AxesRegister last_register_;
+  bool have_clamp_;              // Clamp to apply to the next move.
+  AxisBitmap_t clamp_axes_;
+};
+
+#endif  // _BEAGLEG_COMPILED_GCODE_H_
@@ -0,0 +1,205 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for precompiled G-code.
+ */
+#include "compiled-gcode.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "common/string-util.h"
+
+namespace {
+// Records all events as text, so that we can compare event streams.
+class EventRecorder : public GCodeParser::EventReceiver {
+public:
+  void gcode_start(GCodeParser *p) final { log += "start\n"; parser = p; }
+  void gcode_finished(bool eos) final {
+    log += StringPrintf("finished %d\n", eos);
+  }
+  void inform_origin_offset(const AxesRegister &o, const char *n) final {
+    log += StringPrintf("origin %s %s\n", Register(o).c_str(), n);
+  }
+  void gcode_command_done(char l, float v) final {
+    log += StringPrintf("done %c%g\n", l, v);
+  }
+  void go_home(AxisBitmap_t axes) final {
+    log += StringPrintf("home %x\n", axes);
+  }
+  void change_spindle_speed(float v) final {
+    log += StringPrintf("spindle %g\n", v);
+  }
+  void set_speed_factor(float f) final { log += StringPrintf("factor %g\n", f); }
+  void set_fanspeed(float v) final { log += StringPrintf("fan %g\n", v); }
+  void set_temperature(float t) final { log += StringPrintf("temp %g\n", t); }
+  void wait_temperature() final { log += "wait-temp\n"; }
+  void dwell(float ms) final { log += StringPrintf("dwell %g\n", ms); }
+  void motors_enable(bool on) final { log += StringPrintf("motors %d\n", on); }
+  void clamp_to_range(AxisBitmap_t affected, AxesRegister *axes) final {
+    log += StringPrintf("clamp %x\n", affected);
+  }
+  bool coordinated_move(float feed, const AxesRegister &pos) final {
+    log += StringPrintf("G1 %g %s\n", feed, Register(pos).c_str());
+    return true;
+  }
+  bool rapid_move(float feed, const AxesRegister &pos) final {
+    log += StringPrintf("G0 %g %s\n", feed, Register(pos).c_str());
+    return true;
+  }
+  void arc_move(float feed, GCodeParserAxis normal, bool cw,
+                const AxesRegister &start, const AxesRegister &center,
+                const AxesRegister &end) final {
+    log += StringPrintf("arc %g %d %d %s %s %s\n", feed, normal, cw,
+                        Register(start).c_str(), Register(center).c_str(),
+                        Register(end).c_str());
+  }
+  // Consumes the S parameter with ParsePair(), like the machine control.
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    log += StringPrintf("unprocessed %c%g", letter, value);
+    char l;
+    float v;
+    const char *after = parser->ParsePair(rest, &l, &v, NULL);
+    if (after && l == 'S') {
+      log += StringPrintf(" S%g", v);
+      rest = after;
+    }
+    log += "\n";
+    return rest;
+  }
+
+  static std::string Register(const AxesRegister &r) {
+    return StringPrintf("%g,%g,%g,%g", r[AXIS_X], r[AXIS_Y], r[AXIS_Z],
+                        r[AXIS_E]);
+  }
+
+  std::string log;
+  GCodeParser *parser = NULL;
+};
+
+GCodeParser::Config MakeConfig(GCodeParser::Config::ParamMap *params) {
+  GCodeParser::Config config;
+  config.machine_origin[AXIS_Z] = 100;
+  config.parameters = params;
+  return config;
+}
+
+// Parse "gcode" directly into "direct". Compile it into a temporary file
+// and replay that into "replayed".
+void ParseAndReplay(const char *gcode, EventRecorder *direct,
+                    EventRecorder *replayed) {
+  GCodeParser::Config::ParamMap p1, p2, p3;
+  GCodeParser::Config c1 = MakeConfig(&p1);
+  GCodeParser::Config c2 = MakeConfig(&p2);
+  GCodeParser::Config c3 = MakeConfig(&p3);
+  {
+    GCodeParser parser(c1, direct);
+    parser.ReadFile(fmemopen((void*)gcode, strlen(gcode), "r"), NULL);
+  }
+
+  FILE *compiled = tmpfile();
+  {
+    CompiledGCodeWriter writer(compiled);
+    GCodeParser parser(c2, &writer);
+    parser.ReadFile(fmemopen((void*)gcode, strlen(gcode), "r"), NULL);
+    EXPECT_TRUE(writer.ok());
+  }
+  fflush(compiled);
+
+  CompiledGCodeReader reader;
+  ASSERT_TRUE(reader.Open(fileno(compiled)));
+  GCodeParser replay_parser(c3, replayed);
+  replayed->log.clear();  // Initial state is in the compiled stream.
+  while (reader.ReplayNext(&replay_parser, replayed, NULL))
+    ;
+  EXPECT_TRUE(reader.AtEnd());
+  replayed->gcode_finished(true);  // Like the streamer at EOF.
+  fclose(compiled);
+}
+}  // namespace
+
+TEST(CompiledGCode, ReplayGivesSameEventsAsParsing) {
+  const char *gcode =
+    "G28\n"
+    "G1 X10 Y20 F600\n"
+    "G91 G1 X5 E0.5\n"
+    "G90 G92 X0\n"
+    "G0 X1 Y2\n"
+    "#1=3\n"
+    "G1 X[#1*2] Z[10-#1]\n"
+    "G2 X10 Y10 I5 J0\n"
+    "G4 P200\n"
+    "M106 S128\n"
+    "M3 S1000 G1 X7\n"   // Unprocessed with remainder.
+    "M2\n";
+  EventRecorder direct, replayed;
+  ParseAndReplay(gcode, &direct, &replayed);
+  EXPECT_FALSE(direct.log.empty());
+  EXPECT_EQ(direct.log, replayed.log);
+}
+
+TEST(CompiledGCode, DenseMovesAreSmallerThanText) {
+  std::string gcode;
+  for (int i = 0; i < 1000; ++i) {
+    gcode += StringPrintf("G1 X%.3f Y%.3f E%.4f F1800\n",
+                          i * 0.1, i * 0.2, i * 0.01);
+  }
+  FILE *compiled = tmpfile();
+  {
+    GCodeParser::Config::ParamMap params;
+    GCodeParser::Config config = MakeConfig(&params);
+    CompiledGCodeWriter writer(compiled);
+    GCodeParser parser(config, &writer);
+    parser.ReadFile(fmemopen((void*)gcode.data(), gcode.size(), "r"), NULL);
+  }
+  const long compiled_size = ftell(compiled);
+  EXPECT_LT(compiled_size, (long)gcode.size());
+  fclose(compiled);
+}
+
+TEST(CompiledGCode, TextIsNotRecognizedAsCompiled) {
+  FILE *text = tmpfile();
+  fputs("G1 X10\n", text);
+  fflush(text);
+  CompiledGCodeReader reader;
+  EXPECT_FALSE(reader.Open(fileno(text)));
+  EXPECT_EQ(0, lseek(fileno(text), 0, SEEK_CUR) - ftell(text));
+  fclose(text);
+}
+
+TEST(CompiledGCode, TruncatedFileStopsReplay) {
+  const char *gcode = "G1 X10 Y20 F600\nG1 X20\nG1 X30\n";
+  FILE *compiled = tmpfile();
+  {
+    GCodeParser::Config::ParamMap params;
+    GCodeParser::Config config = MakeConfig(&params);
+    CompiledGCodeWriter writer(compiled);
+    GCodeParser parser(config, &writer);
+    parser.ReadFile(fmemopen((void*)gcode, strlen(gcode), "r"), NULL);
+  }
+  fflush(compiled);
+  // The last records are the move to X30 (11 bytes) and its 'done' (6 bytes).
+  ASSERT_EQ(0, ftruncate(fileno(compiled), ftell(compiled) - 8));
+
+  EventRecorder replayed;
+  GCodeParser::Config::ParamMap params;
+  GCodeParser::Config config = MakeConfig(&params);
+  GCodeParser parser(config, &replayed);
+  CompiledGCodeReader reader;
+  ASSERT_TRUE(reader.Open(fileno(compiled)));
+  int events = 0;
+  while (reader.ReplayNext(&parser, &replayed, NULL))
+    ++events;
+  EXPECT_TRUE(reader.AtEnd());
+  EXPECT_GT(events, 0);
+  EXPECT_EQ(std::string::npos, replayed.log.find("G1 -1 30"));
+  fclose(compiled);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -23,26 +23,14 @@
 #include <sys/types.h>
 #include <stdio.h>
 
-#include "common/logging.h"
-
-bool GCodeParser::Config::LoadParams() {
-  if (paramfile.empty())
-    return false;
-  if (parameters == NULL) {
-    Log_error("No parameters to load into.");
-    return false;
-  }
-
-  // The default coordinate system at start-up is G54
-  (*parameters)["5220"] = 1.0f;  // Only non-zero default.
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
-  FILE *fp = fopen(paramfile.c_str(), "r");
-  if (!fp) {
-    Log_error("Unable to read param file %s (%s)",
-              paramfile.c_str(), strerror(errno));
-    return false;
-  }
+#include "common/logging.h"
 
+// Parameters name/value per line, the same in the file and the journal.
+static int ReadParams(FILE *fp, GCodeParser::Config::ParamMap *parameters) {
   int pcount = 0;
   char line[256];
   while (fgets(line, sizeof(line), fp)) {
@@ -56,19 +44,17 @@ bool GCodeParser::Config::LoadParams() {
       ++pcount;
     }
   }
-  Log_debug("Loaded %d parameters from %s", pcount, paramfile.c_str());
-  fclose(fp);
-  return true;
+  return pcount;
 }
 
-bool GCodeParser::Config::SaveParams() const {
-  if (paramfile.empty())
-    return false;
-  if (parameters == NULL) {
-    Log_error("No parameters to save.");
-    return false;
-  }
+// Only these are persisted; everything else is local to the program.
+static bool IsPersistentParam(const std::string &name) {
+  if (isdigit(name[0])) return atoi(name.c_str()) != 0;
+  return name[0] == '_';   // Global parameters.
+}
 
+static bool WriteParamFile(const std::string &paramfile,
+                           const GCodeParser::Config::ParamMap &parameters) {
   const std::string tmp_name = paramfile + ".tmp";
   // create new param file
   FILE *fp = fopen(tmp_name.c_str(), "w");
@@ -93,7 +79,7 @@ bool GCodeParser::Config::SaveParams() const {
   // sorted alphanumerically, which is not the same as numerically. So we
   // simply copy them to a temporary structure that sorts them numerically.
   std::map<int, float> numeric_params;
-  for (const auto name_value : *parameters) {
+  for (const auto name_value : parameters) {
     if (!isdigit(name_value.first[0]))
       break;
     numeric_params[atoi(name_value.first.c_str())] = name_value.second;
@@ -110,7 +96,7 @@ bool GCodeParser::Config::SaveParams() const {
 
   // Now, all the non-numeric parmeters
   int start_alpha = pcount;
-  for (const auto name_value : *parameters) {
+  for (const auto name_value : parameters) {
     if (isdigit(name_value.first[0])) continue;  // Numeric: already written
     if (name_value.first[0] != '_') continue;    // Only write global parameters
     if (name_value.second == 0) continue;        // Don't write boring zeroes.
@@ -124,10 +110,179 @@ bool GCodeParser::Config::SaveParams() const {
 
   if (fflush(fp) == 0 && fdatasync(fileno(fp)) == 0 && fclose(fp) == 0) {
     rename(paramfile.c_str(), (paramfile + ".bak").c_str());
-    if (rename(tmp_name.c_str(), paramfile.c_str()) == 0)
+    if (rename(tmp_name.c_str(), paramfile.c_str()) == 0) {
+      // Everything in the journal is in the file now.
+      unlink((paramfile + ".journal").c_str());
       return true;
+    }
   }
   Log_error("Trouble writing parameter file %s (%s)", paramfile.c_str(),
             strerror(errno));
   return false;
 }
+
+// Appends changed parameters to "<paramfile>.journal" in a background
+// thread. Saves that come in while it is writing are coalesced, so only the
+// last value of each parameter is written.
+class GCodeParser::Config::ParamJournal {
+public:
+  // Merge the journal into the file after that many entries.
+  static constexpr int kCompactEntries = 1000;
+
+  ParamJournal(const std::string &paramfile, const ParamMap &persisted)
+    : paramfile_(paramfile), journal_file_(JournalFile(paramfile)),
+      persisted_(persisted), thread_(&ParamJournal::Run, this) {}
+
+  ~ParamJournal() {
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      stop_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();   // Writes what is still pending.
+  }
+
+  static std::string JournalFile(const std::string &paramfile) {
+    return paramfile + ".journal";
+  }
+
+  void Save(const ParamMap &parameters) {
+    std::lock_guard<std::mutex> l(mutex_);
+    for (const auto &name_value : parameters) {
+      if (!IsPersistentParam(name_value.first)) continue;
+      // What is already pending or written doesn't need to go again.
+      auto pending = pending_.find(name_value.first);
+      if (pending != pending_.end()) {
+        pending->second = name_value.second;
+        continue;
+      }
+      auto found = persisted_.find(name_value.first);
+      const float before = (found == persisted_.end()) ? 0 : found->second;
+      if (before != name_value.second)
+        pending_[name_value.first] = name_value.second;
+    }
+    if (!pending_.empty()) changed_.notify_all();
+  }
+
+  void Flush() {
+    std::unique_lock<std::mutex> l(mutex_);
+    written_.wait(l, [this]() { return pending_.empty() && !writing_; });
+  }
+
+private:
+  void Run() {
+    std::unique_lock<std::mutex> l(mutex_);
+    for (;;) {
+      changed_.wait(l, [this]() { return stop_ || !pending_.empty(); });
+      if (pending_.empty()) break;  // Stopped, and all written.
+      ParamMap to_write;
+      to_write.swap(pending_);
+      // Saves coming in while we write compare against these.
+      for (const auto &name_value : to_write)
+        persisted_[name_value.first] = name_value.second;
+      writing_ = true;
+      l.unlock();
+      const bool success = Append(to_write);
+      l.lock();
+      journal_entries_ += to_write.size();
+      if (success && journal_entries_ >= kCompactEntries) {
+        const ParamMap snapshot = persisted_;
+        l.unlock();
+        // Removes the journal once the file is in place; before that, it
+        // is read on top, which is the same.
+        const bool compacted = WriteParamFile(paramfile_, snapshot);
+        l.lock();
+        if (compacted) journal_entries_ = 0;
+      }
+      writing_ = false;
+      written_.notify_all();
+    }
+  }
+
+  bool Append(const ParamMap &to_write) {
+    FILE *fp = fopen(journal_file_.c_str(), "a");
+    if (!fp) {
+      Log_error("Unable to append to param journal %s (%s)",
+                journal_file_.c_str(), strerror(errno));
+      return false;
+    }
+    for (const auto &name_value : to_write) {
+      fprintf(fp, "%s\t%f\n", name_value.first.c_str(), name_value.second);
+    }
+    if (fflush(fp) == 0 && fdatasync(fileno(fp)) == 0 && fclose(fp) == 0)
+      return true;
+    Log_error("Trouble writing param journal %s (%s)", journal_file_.c_str(),
+              strerror(errno));
+    return false;
+  }
+
+  const std::string paramfile_;
+  const std::string journal_file_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::condition_variable written_;
+  ParamMap persisted_;     // What is in, or being written to, file or journal.
+  ParamMap pending_;       // Changes not written yet.
+  int journal_entries_ = 0;
+  bool writing_ = false;
+  bool stop_ = false;
+  std::thread thread_;     // Last, so that it starts with all set up.
+};
+
+bool GCodeParser::Config::LoadParams() {
+  if (paramfile.empty())
+    return false;
+  if (parameters == NULL) {
+    Log_error("No parameters to load into.");
+    return false;
+  }
+
+  // The default coordinate system at start-up is G54
+  (*parameters)["5220"] = 1.0f;  // Only non-zero default.
+
+  FILE *fp = fopen(paramfile.c_str(), "r");
+  if (!fp) {
+    Log_error("Unable to read param file %s (%s)",
+              paramfile.c_str(), strerror(errno));
+    return false;
+  }
+
+  int pcount = ReadParams(fp, parameters);
+  fclose(fp);
+
+  // Changes since the parameter file was last written.
+  if (journal_) journal_->Flush();
+  fp = fopen(ParamJournal::JournalFile(paramfile).c_str(), "r");
+  if (fp) {
+    pcount += ReadParams(fp, parameters);
+    fclose(fp);
+  }
+  Log_debug("Loaded %d parameters from %s", pcount, paramfile.c_str());
+  return true;
+}
+
+bool GCodeParser::Config::SaveParams() const {
+  if (paramfile.empty())
+    return false;
+  if (parameters == NULL) {
+    Log_error("No parameters to save.");
+    return false;
+  }
+
+  if (journal_) {
+    journal_->Save(*parameters);
+    return true;
+  }
+  return WriteParamFile(paramfile, *parameters);
+}
+
+void GCodeParser::Config::EnableWriteBehind() {
+  if (paramfile.empty() || parameters == NULL || journal_)
+    return;
+  journal_.reset(new ParamJournal(paramfile, *parameters));
+}
+
+void GCodeParser::Config::FlushParams() const {
+  if (journal_) journal_->Flush();
+}
@@ -31,6 +31,7 @@
 #include <math.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -39,8 +40,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <unordered_map>
+#include <vector>
+
 #include "common/logging.h"
 #include "common/string-util.h"
+#include "common/trace.h"
 
 #include "simple-lexer.h"
 
@@ -204,16 +209,91 @@ private:
     return 4;
   }
 
+  // Expressions are compiled into a small stack machine program before they
+  // are evaluated. Within loops, the compiled form is kept for all following
+  // iterations, so the loop body only needs to be parsed once.
+  enum InstructionCode {
+    PUSH_CONSTANT,        // Push "constant".
+    PUSH_PARAMETER,       // Push value of params[param].
+    PUSH_INDIRECT,        // Replace top with parameter numbered by its value.
+    UNARY,                // Replace top with "op" applied to it.
+    ATAN2,                // Replace top two with their ATAN[a]/[b].
+    BINARY                // Replace top two with their "op" result.
+  };
+  struct Instruction {
+    InstructionCode code;
+    Operation op;
+    float constant;
+    int param;
+  };
+
+  // A parameter as referenced in an expression. The entry in the parameter
+  // map is looked up once and then accessed directly; entries in the map
+  // are never removed, so the address stays valid.
+  struct ParamRef {
+    std::string key;      // Lower-case name as stored in the parameter map.
+    bool writable;
+    float *value;         // Entry in the parameter map once it exists.
+  };
+
+  struct Expression {
+    std::vector<Instruction> code;
+    std::vector<ParamRef> params;
+    int depth = 0;        // Stack depth while compiling.
+    int max_depth = 0;    // Stack needed to evaluate.
+  };
+
+  // Parameter assignment statement, e.g. #1 = [#2 + 1] or #<foo>++
+  struct Assignment {
+    enum Kind { QUERY, INCREMENT, DECREMENT, ASSIGN, UPDATE, TERNARY };
+    Kind kind;
+    Expression target;    // params[target_param] is the target; for an
+    int target_param;     // indirect target such as ##1, the code computes
+    bool indirect_target; // its number.
+    Operation op;         // For UPDATE, e.g. #1 += 5
+    Expression value;     // Value or condition for TERNARY.
+    Expression if_true;
+    Expression if_false;
+    const char *end;      // Remaining line after the statement.
+  };
+
+  // Compiled forms of everything parsed while a loop is executed, indexed
+  // by their position in the input. These positions are stable as the loop
+  // body is kept in memory while the loop runs.
+  struct CompiledScope {
+    std::unordered_map<const char *, Expression> values;
+    std::unordered_map<const char *, const char *> value_ends;
+    std::unordered_map<const char *, Assignment> assignments;
+  };
+
+  void emit(Expression *expr, InstructionCode code,
+            Operation op = NO_OPERATION, float constant = 0, int param = -1);
+  const char *compile_param_name(const char *line, Expression *expr,
+                                 int *param, bool *indirect);
+  const char *compile_parameter(const char *line, Expression *expr);
+  const char *compile_unary(const char *line, Expression *expr);
+  const char *compile_expression(const char *line, Expression *expr);
+  const char *compile_value(const char *line, Expression *expr);
+  bool compile_assignment(const char *line, Assignment *assignment);
+
+  float *resolve_parameter(ParamRef *ref, bool create);
+  float read_parameter(ParamRef *ref) {
+    const float *value = resolve_parameter(ref, false);
+    return value ? *value : 0.0f;
+  }
+  void store_parameter(ParamRef *ref, float value);
+
+  bool evaluate(Expression *expr, float *result);
+  const char *run_assignment(Assignment *assignment);
+
   bool execute_unary(float *value, Operation op);
-  const char *gcodep_atan(const char *line, float *value);
   const char *gcodep_operation_unary(const char *line, Operation *op);
-  const char *gcodep_unary(const char *line, float *value);
 
   bool execute_binary(float *left, Operation op, float *right);
   const char *gcodep_operation(const char *line, Operation *op);
 
-  const char *gcodep_expression(const char *line, float *value);
-
+  // Parse and evaluate a value: a number, a parameter, a unary function or
+  // an expression in brackets.
   const char *gcodep_value(const char *line, float *value);
 
   const char *gcodep_set_parameter(const char *line);
@@ -244,6 +324,7 @@ private:
   const char *handle_move(const char *line, bool force_change);
   const char *handle_arc(const char *line, bool is_cw);
   const char *handle_spline(float sub_command, const char *line);
+  const char *handle_raster(const char *line);
   const char *handle_z_probe(const char *line);
   const char *handle_M111(const char *line);
 
@@ -254,12 +335,6 @@ private:
   const char *set_param(char param_letter, EventValueSetter setter,
                         float factor, const char *line);
 
-  const char *gcodep_parameter(const char *line, float *value);
-
-  // Read name of parameter (after #) which is either a number or a
-  // non-alphanumeric character.
-  const char *read_param_name(const char *line, std::string *result);
-
   // Read parameter. Do range check.
   bool read_parameter(StringPiece param_name, float *result) const {
     if (config_.parameters == NULL)
@@ -368,6 +443,10 @@ private:
   bool do_while_;
   std::string while_condition_;
   std::string while_loop_;
+  CompiledScope *compiled_scope_;  // Only set while a loop is executed.
+  std::vector<float> eval_stack_;
+  Expression scratch_expr_;            // Reused outside of loops.
+  std::vector<uint8_t> raster_power_;  // Pixels of the G7 being parsed.
 
   unsigned int debug_level_;  // OR-ed bits from DebugLevel enum
   bool allow_m111_;
@@ -401,7 +480,8 @@ GCodeParser::Impl::Impl(const GCodeParser::Config &parse_config,
     current_origin_(&machine_origin_),
     current_global_offset_(&kZeroOffset),
     arc_normal_(AXIS_Z),
-    while_err_stream_(NULL), do_while_(false),
+    while_owner_(NULL), while_err_stream_(NULL), do_while_(false),
+    compiled_scope_(NULL),
     debug_level_(DEBUG_NONE),
     error_count_(0)
 {
@@ -488,11 +568,59 @@ static const char *skip_white(const char *line) {
   return line;
 }
 
+// Fast path for the plain decimal numbers that make up almost all of
+// G-code: optional sign, digits, optional point and fraction.
+// Accumulates the digits as integer and scales at the end. For up to 15
+// significant digits, both are exact in a double, so the division gives
+// the correctly rounded double. Narrowing that to float rounds the same as
+// strtof(), unless it landed exactly half-way between two floats; that rare
+// case and anything else returns NULL, so that the caller can use the
+// general path.
+static const char *ParseDecimalNumber(const char *line, float *value) {
+  static const double kPow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                   1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                   1e15 };
+  const char *pos = line;
+  const bool negative = (*pos == '-');
+  if (*pos == '-' || *pos == '+') ++pos;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int fraction_digits = 0;
+  while (*pos >= '0' && *pos <= '9') {
+    mantissa = 10 * mantissa + (*pos++ - '0');
+    ++digits;
+  }
+  if (*pos == '.') {
+    ++pos;
+    while (*pos >= '0' && *pos <= '9') {
+      mantissa = 10 * mantissa + (*pos++ - '0');
+      ++digits;
+      ++fraction_digits;
+    }
+  }
+  if (digits == 0 || digits > 15)
+    return NULL;
+  const double result = mantissa / kPow10[fraction_digits];
+  // The 29 bits of the double below float precision being exactly 100..0
+  // is a tie, which the double rounding might have created.
+  uint64_t bits;
+  memcpy(&bits, &result, sizeof(bits));
+  const uint64_t kBelowFloat = (1ULL << 29) - 1;
+  if ((bits & kBelowFloat) == (1ULL << 28))
+    return NULL;
+  *value = (float)(negative ? -result : result);
+  return pos;
+}
+
 // Parse number from "line" and store in "value". Returns the position in the
 // string after the value had been parsed; if there was an error parsing,
 // returns the beginning of the line.
 static const char *ParseGcodeNumber(const char *line, float *value) {
   line = skip_white(line);
+  const char *fast_end = ParseDecimalNumber(line, value);
+  if (fast_end != NULL)
+    return fast_end;
+
   // We need to copy the number into a temporary buffer as strtof() does
   // not accept an end-limiter.
   char buffer[40];
@@ -518,12 +646,30 @@ static const char *ParseGcodeNumber(const char *line, float *value) {
   return (parsed_end == dst) ? src : line;
 }
 
+void GCodeParser::Impl::emit(Expression *expr, InstructionCode code,
+                             Operation op, float constant, int param) {
+  expr->code.push_back({code, op, constant, param});
+  switch (code) {
+  case PUSH_CONSTANT: case PUSH_PARAMETER:
+    if (++expr->depth > expr->max_depth) expr->max_depth = expr->depth;
+    break;
+  case ATAN2: case BINARY:
+    --expr->depth;
+    break;
+  case PUSH_INDIRECT: case UNARY:
+    break;
+  }
+}
+
 // Parameter/variable names can be simple integers (traditional NIST), or
-// a named one.
+// a named one. The parameter is added to the "params" of "expr"; if its
+// number is only known at runtime (e.g. ##1), the code computing it is
+// emitted into "expr" and "indirect" is set.
 // Returns the remainder of the line or NULL if parameter name could not
 // be parsed.
-const char* GCodeParser::Impl::read_param_name(const char *line,
-                                               std::string *result) {
+const char* GCodeParser::Impl::compile_param_name(const char *line,
+                                                  Expression *expr,
+                                                  int *param, bool *indirect) {
   line = skip_white(line);
   if (*line == '\0') {
     gprintf(GLOG_SYNTAX_ERR, "expected value after '#'\n");
@@ -541,19 +687,29 @@ const char* GCodeParser::Impl::read_param_name(const char *line,
     return NULL;
   }
 
+  std::string name;
+  *indirect = false;
   // if (!numeric_parameter && strict_nist) warn("using extension");
   if (numeric_parameter) {
-    float index;
-    const char *endptr = gcodep_value(line, &index);
+    const size_t code_start = expr->code.size();
+    const char *endptr = compile_value(line, expr);
     if (endptr == NULL) {
       gprintf(GLOG_SYNTAX_ERR,
               "'#' is not followed by a number but '%s'\n", line);
       return NULL;
     }
     line = endptr;
-    *result = StringPrintf("%d", (int) index);
+    if (expr->code.size() == code_start + 1
+        && expr->code.back().code == PUSH_CONSTANT) {
+      char number[16];
+      snprintf(number, sizeof(number), "%d", (int) expr->code.back().constant);
+      name = number;
+      expr->code.pop_back();
+      --expr->depth;
+    } else {
+      *indirect = true;
+    }
   } else {
-    result->clear();
     // Allowing alpha-numeric parameters.
     while (*line
            && ((*line >= '0' && *line <= '9')
@@ -562,7 +718,7 @@ const char* GCodeParser::Impl::read_param_name(const char *line,
                || *line == '_'
                || (bracketed && isspace(*line)))) {
       if (!isspace(*line)) {
-        result->append(1, *line);
+        name.append(1, *line);
       }
       ++line;
     }
@@ -571,23 +727,57 @@ const char* GCodeParser::Impl::read_param_name(const char *line,
   if (bracketed) {
     if (*line != '>') {
       gprintf(GLOG_SYNTAX_ERR, "Missed closing bracket for parameter <%s>\n",
-              result->c_str());
+              name.c_str());
       return NULL;
     }
     ++line;
   }
 
-  return result->empty() ? NULL : skip_white(line);
+  if (name.empty() && !*indirect)
+    return NULL;
+
+  ParamRef ref;
+  ref.key = ToLower(name);
+  // zero parameter can never be written.
+  ref.writable = !(ref.key == "0" || atoi(ref.key.c_str()) >= 5400);
+  ref.value = NULL;
+  *param = expr->params.size();
+  expr->params.push_back(ref);
+  return skip_white(line);
 }
 
-const char *GCodeParser::Impl::gcodep_parameter(const char *line, float *value) {
-  std::string param_name;
-  line = read_param_name(line, &param_name);
+const char *GCodeParser::Impl::compile_parameter(const char *line,
+                                                 Expression *expr) {
+  int param;
+  bool indirect;
+  line = compile_param_name(line, expr, &param, &indirect);
   if (line == NULL) return NULL;
+  emit(expr, indirect ? PUSH_INDIRECT : PUSH_PARAMETER,
+       NO_OPERATION, 0, param);
+  return line;  // We parsed something; return whatever is remaining.
+}
 
-  read_parameter(param_name, value);
+float *GCodeParser::Impl::resolve_parameter(ParamRef *ref, bool create) {
+  if (ref->value != NULL || config_.parameters == NULL)
+    return ref->value;
+  if (create) {
+    ref->value = &(*config_.parameters)[ref->key];
+  } else {
+    Config::ParamMap::iterator found = config_.parameters->find(ref->key);
+    if (found != config_.parameters->end()) ref->value = &found->second;
+  }
+  return ref->value;
+}
 
-  return line;  // We parsed something; return whatever is remaining.
+void GCodeParser::Impl::store_parameter(ParamRef *ref, float value) {
+  if (config_.parameters == NULL)
+    return;
+  if (!ref->writable) {
+    gprintf(GLOG_SEMANTIC_ERR, "writing unsupported parameter number (%s)\n",
+            ref->key.c_str());
+    return;
+  }
+  *resolve_parameter(ref, true) = value;
 }
 
 bool GCodeParser::Impl::execute_unary(float *value, Operation op) {
@@ -655,35 +845,6 @@ bool GCodeParser::Impl::execute_unary(float *value, Operation op) {
   return true;
 }
 
-const char *GCodeParser::Impl::gcodep_atan(const char *line, float *value) {
-  if (*line != '/') {
-    gprintf(GLOG_SYNTAX_ERR, "expected '/' after ATAN got '%s'\n", line);
-    return NULL;
-  }
-  line++;
-
-  if (*line != '[') {
-    gprintf(GLOG_SYNTAX_ERR, "expected '[' after ATAN/ got '%s'\n", line);
-    return NULL;
-  }
-  line++;
-
-  float value2;
-  const char *endptr;
-  endptr = gcodep_expression(line, &value2);
-  if (endptr == NULL) {
-    gprintf(GLOG_SYNTAX_ERR, "expected value got '%s'\n", line);
-    return NULL;
-  }
-  line = endptr;
-
-  float val = (atan2f(*value, value2) * 180.0f) / M_PI;
-  gprintf(GLOG_EXPRESSION, "%s[%f]/[%f] -> %f\n",
-          op_parse_.AsString(ATAN), *value, value2, val);
-  *value = val;
-  return line;
-}
-
 const char *GCodeParser::Impl::gcodep_operation_unary(const char *line,
                                                       Operation *op) {
   *op = op_parse_.MatchNext(&line);
@@ -695,15 +856,17 @@ const char *GCodeParser::Impl::gcodep_operation_unary(const char *line,
   }
 }
 
-const char *GCodeParser::Impl::gcodep_unary(const char *line, float *value) {
+const char *GCodeParser::Impl::compile_unary(const char *line,
+                                             Expression *expr) {
   Operation op;
   const char *endptr;
 
-  line = gcodep_operation_unary(line, &op);
-  if (line == NULL) {
+  endptr = gcodep_operation_unary(line, &op);
+  if (endptr == NULL) {
     gprintf(GLOG_SYNTAX_ERR, "unknown unary got '%s'\n", line);
     return NULL;
   }
+  line = endptr;
 
   if (*line != '[') {
     gprintf(GLOG_SYNTAX_ERR, "expected '[' got '%s'\n", line);
@@ -711,7 +874,7 @@ const char *GCodeParser::Impl::gcodep_unary(const char *line, float *value) {
   }
   line = skip_white(line + 1);
 
-  endptr = gcodep_expression(line, value);
+  endptr = compile_expression(line, expr);
   if (endptr == NULL) {
     gprintf(GLOG_SYNTAX_ERR, "expected value got '%s'\n", line);
     return NULL;
@@ -719,17 +882,27 @@ const char *GCodeParser::Impl::gcodep_unary(const char *line, float *value) {
   line = skip_white(endptr);
 
   if (op == ATAN) {
-    endptr = gcodep_atan(line, value);
+    if (*line != '/') {
+      gprintf(GLOG_SYNTAX_ERR, "expected '/' after ATAN got '%s'\n", line);
+      return NULL;
+    }
+    line++;
+
+    if (*line != '[') {
+      gprintf(GLOG_SYNTAX_ERR, "expected '[' after ATAN/ got '%s'\n", line);
+      return NULL;
+    }
+    line++;
+
+    endptr = compile_expression(line, expr);
     if (endptr == NULL) {
       gprintf(GLOG_SYNTAX_ERR, "expected value got '%s'\n", line);
       return NULL;
     }
     line = skip_white(endptr);
+    emit(expr, ATAN2, ATAN);
   } else {
-    if (!execute_unary(value, op)) {
-      gprintf(GLOG_SYNTAX_ERR, "unary operation failed\n");
-      return NULL;
-    }
+    emit(expr, UNARY, op);
   }
 
   return line;
@@ -819,15 +992,15 @@ const char *GCodeParser::Impl::gcodep_operation(const char *line,
 // the expression stack needs to be at least one greater than the max precedence
 #define MAX_STACK   6
 
-const char *GCodeParser::Impl::gcodep_expression(const char *line, float *value) {
-  float vals[MAX_STACK];
+const char *GCodeParser::Impl::compile_expression(const char *line,
+                                                  Expression *expr) {
   Operation ops[MAX_STACK];
   int stack = 0;
   const char *endptr;
   line = skip_white(line);
 
   for (ops[0] = NO_OPERATION; ops[0] != RIGHT_BRACKET; ) {
-    endptr = gcodep_value(line, &vals[stack]);
+    endptr = compile_value(line, expr);
     if (endptr == NULL) {
       if (*line == '-') {
         line = skip_white(line+1);
@@ -836,7 +1009,7 @@ const char *GCodeParser::Impl::gcodep_expression(const char *line, float *value)
           return NULL;
         }
         // make [-expression] work like [-1 * expression]
-        vals[stack] = -1.0f;
+        emit(expr, PUSH_CONSTANT, NO_OPERATION, -1.0f);
         ops[stack] = TIMES;
         stack++;
         continue;
@@ -869,8 +1042,8 @@ const char *GCodeParser::Impl::gcodep_expression(const char *line, float *value)
       }
     } else {  // precedence of latest operator is <= previous precedence
       for ( ; precedence(ops[stack]) <= precedence(ops[stack - 1]); ) {
-        if (!execute_binary(&vals[stack - 1], ops[stack - 1], &vals[stack]))
-          return NULL;
+        // The two values are on top of the evaluation stack.
+        emit(expr, BINARY, ops[stack - 1]);
 
         ops[stack - 1] = ops[stack];
         if (stack > 1 && precedence(ops[stack - 1]) <= precedence(ops[stack - 2]))
@@ -880,15 +1053,15 @@ const char *GCodeParser::Impl::gcodep_expression(const char *line, float *value)
       }
     }
   }
-  *value = vals[0];
 
   return line;
 }
 
-// Parse a value out of the line.
+// Compile a value out of the line.
 // The value may be a number, a parameter value, a unary function, or an
 // expression.
-const char *GCodeParser::Impl::gcodep_value(const char *line, float *value) {
+const char *GCodeParser::Impl::compile_value(const char *line,
+                                             Expression *expr) {
   char c = toupper(*line);
   if (isalpha(c)) c = 'U';  // indicates a unary in the switch below
 
@@ -898,18 +1071,21 @@ const char *GCodeParser::Impl::gcodep_value(const char *line, float *value) {
     endptr = NULL;
     break;
   case '[':
-    endptr = gcodep_expression(line + 1, value);
+    endptr = compile_expression(line + 1, expr);
     break;
   case '#':
-    endptr = gcodep_parameter(line + 1, value);
+    endptr = compile_parameter(line + 1, expr);
     break;
   case 'U':
-    endptr = gcodep_unary(line, value);
+    endptr = compile_unary(line, expr);
     break;
-  default:
-    endptr = ParseGcodeNumber(line, value);
+  default: {
+    float value;
+    endptr = ParseGcodeNumber(line, &value);
+    if (endptr != line) emit(expr, PUSH_CONSTANT, NO_OPERATION, value);
     break;
   }
+  }
   if (line == endptr || endptr == NULL)
     return NULL;
 
@@ -917,30 +1093,108 @@ const char *GCodeParser::Impl::gcodep_value(const char *line, float *value) {
   return line;
 }
 
-const char *GCodeParser::Impl::gcodep_set_parameter(const char *line) {
-  std::string param_name;
-  line = read_param_name(line, &param_name);
-  if (line == NULL) return NULL;
-  const char *log_name = param_name.c_str();
+bool GCodeParser::Impl::evaluate(Expression *expr, float *result) {
+  if ((int)eval_stack_.size() < expr->max_depth)
+    eval_stack_.resize(expr->max_depth);
+  float *const stack = eval_stack_.data();
+  int top = -1;
+  for (const Instruction &i : expr->code) {
+    switch (i.code) {
+    case PUSH_CONSTANT:
+      stack[++top] = i.constant;
+      break;
+    case PUSH_PARAMETER:
+      stack[++top] = read_parameter(&expr->params[i.param]);
+      break;
+    case PUSH_INDIRECT: {
+      ParamRef *const ref = &expr->params[i.param];
+      char number[16];
+      snprintf(number, sizeof(number), "%d", (int) stack[top]);
+      ref->key = number;
+      ref->value = NULL;
+      stack[top] = read_parameter(ref);
+      break;
+    }
+    case UNARY:
+      if (!execute_unary(&stack[top], i.op)) {
+        gprintf(GLOG_SYNTAX_ERR, "unary operation failed\n");
+        return false;
+      }
+      break;
+    case ATAN2: {
+      const float val = (atan2f(stack[top - 1], stack[top]) * 180.0f) / M_PI;
+      gprintf(GLOG_EXPRESSION, "%s[%f]/[%f] -> %f\n",
+              op_parse_.AsString(ATAN), stack[top - 1], stack[top], val);
+      stack[--top] = val;
+      break;
+    }
+    case BINARY:
+      if (!execute_binary(&stack[top - 1], i.op, &stack[top]))
+        return false;
+      --top;
+      break;
+    }
+  }
+  *result = stack[0];
+  return true;
+}
 
-  float value;
+const char *GCodeParser::Impl::gcodep_value(const char *line, float *value) {
+  const char c = *line;
+  if (c != '[' && c != '#' && !isalpha(c)) {
+    // Plain number; the common case, so no need to compile anything.
+    if (c == '\0') return NULL;
+    const char *endptr = ParseGcodeNumber(line, value);
+    if (endptr == line) return NULL;
+    return skip_white(endptr);
+  }
+
+  if (compiled_scope_ == NULL) {
+    // Keeps the capacity of the previous expression, so no allocation.
+    scratch_expr_.code.clear();
+    scratch_expr_.params.clear();
+    scratch_expr_.depth = scratch_expr_.max_depth = 0;
+    const char *endptr = compile_value(line, &scratch_expr_);
+    if (endptr == NULL || !evaluate(&scratch_expr_, value)) return NULL;
+    return endptr;
+  }
+
+  std::unordered_map<const char *, Expression>::iterator found
+    = compiled_scope_->values.find(line);
+  if (found == compiled_scope_->values.end()) {
+    Expression expr;
+    const char *endptr = compile_value(line, &expr);
+    if (endptr == NULL) return NULL;
+    found = compiled_scope_->values.insert(
+      std::make_pair(line, std::move(expr))).first;
+    compiled_scope_->value_ends[line] = endptr;
+  }
+  if (!evaluate(&found->second, value)) return NULL;
+  return compiled_scope_->value_ends[line];
+}
+
+bool GCodeParser::Impl::compile_assignment(const char *line,
+                                           Assignment *assignment) {
+  line = compile_param_name(line, &assignment->target,
+                            &assignment->target_param,
+                            &assignment->indirect_target);
+  if (line == NULL) return false;
+  const char *log_name
+    = assignment->target.params[assignment->target_param].key.c_str();
+
+  assignment->op = NO_OPERATION;
+  assignment->end = NULL;
   if (*line     == '+' &&
       *(line+1) == '+') {
-    line = skip_white(line+2);
-    read_parameter(param_name, &value);
-    value++;
-    store_parameter(param_name, value);
-    gprintf(GLOG_EXPRESSION, "#%s++ -> #%s=%f\n", log_name, log_name, value);
-    return line;
+    assignment->kind = Assignment::INCREMENT;
+    assignment->end = skip_white(line+2);
+    return true;
   }
   if (*line     == '-' &&
       *(line+1) == '-') {
-    line = skip_white(line+2);
-    read_parameter(param_name, &value);
-    value--;
-    store_parameter(param_name, value);
-    gprintf(GLOG_EXPRESSION, "#%s-- -> #%s=%f\n", log_name, log_name, value);
-    return line;
+    assignment->kind = Assignment::DECREMENT;
+    assignment->end = skip_white(line+2);
+    return true;
   }
 
   Operation op = NO_OPERATION;
@@ -964,78 +1218,134 @@ const char *GCodeParser::Impl::gcodep_set_parameter(const char *line) {
     line = skip_white(line+1);
   } else {
     if (*line == '\0') {
-      value = 0.0;
-      read_parameter(param_name, &value);
-      gprintf(GLOG_INFO, "#%s = %f\n", log_name, value);
-    } else {
-      gprintf(GLOG_SYNTAX_ERR,
-              "gcodep_set_parameter: expected '=' after '#%s' got '%s'\n",
-              log_name, line);
+      assignment->kind = Assignment::QUERY;
+      return true;
     }
-    return NULL;
+    gprintf(GLOG_SYNTAX_ERR,
+            "gcodep_set_parameter: expected '=' after '#%s' got '%s'\n",
+            log_name, line);
+    return false;
   }
 
   // Assignment
   const char *endptr;
-  endptr = gcodep_value(line, &value);
+  endptr = compile_value(line, &assignment->value);
   if (endptr == NULL) {
     gprintf(GLOG_SYNTAX_ERR,
             "gcodep_set_parameter: expected value after '#%s=' got '%s'\n",
             log_name, line);
-    return NULL;
+    return false;
   }
   line = skip_white(endptr);
 
   if (op != NO_OPERATION) {
-    float left;
-    read_parameter(param_name, &left);
-    if (!execute_binary(&left, op, &value))
-      return NULL;
-    value = left;
-  } else {
-    // see if this is a ternary operation '? :'
-    if (*line == '?') {
-      bool condition = (value != 0.0f);
-      line = skip_white(line+1);
-
-      endptr = gcodep_value(line, &value);
-      if (endptr == NULL) {
-        gprintf(GLOG_SYNTAX_ERR,
-                "gcodep_set_parameter: expected value after '#%s=[%d] ? ' got '%s'\n",
-                log_name, line, condition);
-        return NULL;
-      }
-      line = skip_white(endptr);
-      float true_value = value;
+    assignment->kind = Assignment::UPDATE;
+    assignment->op = op;
+  } else if (*line == '?') {
+    // this is a ternary operation '? :'
+    assignment->kind = Assignment::TERNARY;
+    line = skip_white(line+1);
 
-      if (*line == ':') {
-        line = skip_white(line+1);
-        endptr = gcodep_value(line, &value);
-        if (endptr == NULL) {
-          gprintf(GLOG_SYNTAX_ERR,
-                  "gcodep_set_parameter: expected value after '#%s=[%d] ? %f :' got '%s'\n",
-                  log_name, line, condition, true_value);
-          return NULL;
-        }
-        line = skip_white(endptr);
+    endptr = compile_value(line, &assignment->if_true);
+    if (endptr == NULL) {
+      gprintf(GLOG_SYNTAX_ERR,
+              "gcodep_set_parameter: expected value after '#%s=[...] ? ' "
+              "got '%s'\n", log_name, line);
+      return false;
+    }
+    line = skip_white(endptr);
 
-        if (condition)
-          value = true_value;
-      } else {
-        gprintf(GLOG_SYNTAX_ERR,
-                "gcodep_set_parameter: expected ':' after '#%s=[%d] ? %f' got '%s'\n",
-                log_name, line, condition, true_value);
-        return NULL;
-      }
+    if (*line != ':') {
+      gprintf(GLOG_SYNTAX_ERR,
+              "gcodep_set_parameter: expected ':' after '#%s=[...] ? ...' "
+              "got '%s'\n", log_name, line);
+      return false;
     }
+    line = skip_white(line+1);
+    endptr = compile_value(line, &assignment->if_false);
+    if (endptr == NULL) {
+      gprintf(GLOG_SYNTAX_ERR,
+              "gcodep_set_parameter: expected value after '#%s=[...] ? ... :' "
+              "got '%s'\n", log_name, line);
+      return false;
+    }
+    line = skip_white(endptr);
+  } else {
+    assignment->kind = Assignment::ASSIGN;
+  }
+  assignment->end = line;
+  return true;
+}
+
+const char *GCodeParser::Impl::run_assignment(Assignment *assignment) {
+  ParamRef *const target
+    = &assignment->target.params[assignment->target_param];
+  if (assignment->indirect_target) {
+    float number;
+    if (!evaluate(&assignment->target, &number)) return NULL;
+    target->key = StringPrintf("%d", (int) number);
+    target->writable = !(target->key == "0" || number >= 5400);
+    target->value = NULL;
+  }
+  const char *log_name = target->key.c_str();
+
+  float value = 0;
+  switch (assignment->kind) {
+  case Assignment::QUERY:
+    gprintf(GLOG_INFO, "#%s = %f\n", log_name, read_parameter(target));
+    return NULL;
+  case Assignment::INCREMENT:
+  case Assignment::DECREMENT:
+    value = read_parameter(target);
+    value += (assignment->kind == Assignment::INCREMENT) ? 1 : -1;
+    store_parameter(target, value);
+    gprintf(GLOG_EXPRESSION, "#%s%s -> #%s=%f\n", log_name,
+            (assignment->kind == Assignment::INCREMENT) ? "++" : "--",
+            log_name, value);
+    return assignment->end;
+  case Assignment::ASSIGN:
+    if (!evaluate(&assignment->value, &value)) return NULL;
+    break;
+  case Assignment::UPDATE: {
+    if (!evaluate(&assignment->value, &value)) return NULL;
+    float left = read_parameter(target);
+    if (!execute_binary(&left, assignment->op, &value))
+      return NULL;
+    value = left;
+    break;
+  }
+  case Assignment::TERNARY:
+    if (!evaluate(&assignment->value, &value)) return NULL;
+    if (!evaluate(value != 0.0f ? &assignment->if_true : &assignment->if_false,
+                  &value))
+      return NULL;
+    break;
   }
 
-  store_parameter(param_name, value);
+  store_parameter(target, value);
   callbacks()->gcode_command_done('#', value);
 
   gprintf(GLOG_EXPRESSION, "#%s=%f\n", log_name, value);
 
-  return line;
+  return assignment->end;
+}
+
+const char *GCodeParser::Impl::gcodep_set_parameter(const char *line) {
+  if (compiled_scope_ == NULL) {
+    Assignment assignment;
+    if (!compile_assignment(line, &assignment)) return NULL;
+    return run_assignment(&assignment);
+  }
+
+  std::unordered_map<const char *, Assignment>::iterator found
+    = compiled_scope_->assignments.find(line);
+  if (found == compiled_scope_->assignments.end()) {
+    Assignment assignment;
+    if (!compile_assignment(line, &assignment)) return NULL;
+    found = compiled_scope_->assignments.insert(
+      std::make_pair(line, std::move(assignment))).first;
+  }
+  return run_assignment(&found->second);
 }
 
 void GCodeParser::Impl::gcodep_conditional(const char *line) {
@@ -1046,8 +1356,8 @@ void GCodeParser::Impl::gcodep_conditional(const char *line) {
 
   float value = 0.0f;
   const char *endptr;
-  endptr = gcodep_expression(line + 1, &value);
-  if (line == endptr || endptr == NULL)
+  endptr = gcodep_value(line, &value);
+  if (endptr == NULL)
     return;
 
   const bool condition = (value == 1.0f) ? true : false;
@@ -1106,33 +1416,46 @@ void GCodeParser::Impl::gcodep_conditional(const char *line) {
 }
 
 void GCodeParser::Impl::gcodep_while_end() {
-    int loops = 0;
-    while (1) {
-      const char *line = while_condition_.c_str();
-      const char *endptr;
-      float value;
-      // the '[' was already parsed
-      endptr = gcodep_expression(line, &value);
-      if (endptr == NULL) {
-        gprintf(GLOG_SYNTAX_ERR, "expected value got '%s'\n", line);
-        return;
-      }
-      if (value == 0.0f)
-        break;
+  // Local copies: a WHILE in the loop body would overwrite the members.
+  const std::string condition = while_condition_;
+  std::vector<std::string> body;
+  for (StringPiece piece : SplitString(while_loop_, "\n"))
+    body.push_back(piece.ToString());
+  GCodeParser *const owner = while_owner_;
+  FILE *const err_stream = while_err_stream_;
+
+  // Everything in the loop is compiled in the first iteration; the following
+  // iterations only evaluate.
+  CompiledScope scope;
+  CompiledScope *const outer_scope = compiled_scope_;
+  compiled_scope_ = &scope;
+  int loops = 0;
+  bool success = true;
+  while (1) {
+    const char *line = condition.c_str();
+    const char *endptr;
+    float value;
+    endptr = gcodep_value(line, &value);
+    if (endptr == NULL) {
+      gprintf(GLOG_SYNTAX_ERR, "expected value got '%s'\n", line);
+      success = false;
+      break;
+    }
+    if (value == 0.0f)
+      break;
 
-      line = skip_white(endptr);
-      if (control_parse_.ExpectNext(&line, CK_DO)) {
-        std::vector<StringPiece> piece = SplitString(while_loop_, "\n");
-        for (size_t i=0; i < piece.size(); i++)
-          ParseBlock(while_owner_, piece[i].ToString().c_str(),
-                     while_err_stream_);
-      } else {
-        gprintf(GLOG_SYNTAX_ERR, "expected DO got '%s'\n", line);
-        return;
-      }
-      loops++;
+    line = endptr;
+    if (!control_parse_.ExpectNext(&line, CK_DO)) {
+      gprintf(GLOG_SYNTAX_ERR, "expected DO got '%s'\n", line);
+      success = false;
+      break;
     }
-    gprintf(GLOG_INFO, "Executed %d loops\n", loops);
+    for (const std::string &block : body)
+      ParseBlock(owner, block.c_str(), err_stream);
+    loops++;
+  }
+  compiled_scope_ = outer_scope;
+  if (success) gprintf(GLOG_INFO, "Executed %d loops\n", loops);
 }
 
 void GCodeParser::Impl::gcodep_while_do(const char *line) {
@@ -1153,9 +1476,8 @@ void GCodeParser::Impl::gcodep_while_start(const char *line) {
     gprintf(GLOG_SYNTAX_ERR, "expected '[' after WHILE got '%s'\n", line);
     return;
   }
-  line = skip_white(line+1);
 
-  while_condition_ = line;
+  while_condition_ = line;  // Including the '['
   while_loop_ = "";
   do_while_= true;
 }
@@ -1796,6 +2118,91 @@ const char *GCodeParser::Impl::handle_spline(float sub_command, const char *line
   return line;
 }
 
+static int base64_value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+// Decode the base64 data at "line", appending to "out". Returns the end of
+// the data.
+static const char *decode_base64(const char *line, std::vector<uint8_t> *out) {
+  uint32_t bits = 0;
+  int bit_count = 0;
+  int value;
+  for (/**/; (value = base64_value(*line)) >= 0; ++line) {
+    bits = (bits << 6) | value;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      out->push_back((bits >> bit_count) & 0xff);
+    }
+  }
+  while (*line == '=') ++line;  // Padding.
+  return line;
+}
+
+// G7 X- Y- Z- <F-> D- (Laser raster line; BeagleG extension)
+//   D - base64 encoded laser power of the pixels; one byte per pixel, from
+//       0 (off) to 255 (full power).
+//
+// Moves in a straight line to the given position, like G1, while the laser
+// power follows the pixels, which are of equal length along the line.
+// One G7 per scan line replaces a long sequence of short G1 with S changes.
+//
+// For example, five pixels going from off to full power and back in a
+// 10mm line along X:
+//
+// G0 X0 Y0
+// G7 X10 F3000 DAID/gAA=
+//
+// It is an error if D is missing or empty.
+const char *GCodeParser::Impl::handle_raster(const char *line) {
+  AxesRegister target = axes_pos_;
+  AxisBitmap_t affected_axes = 0;
+  float feedrate = -1;
+  bool have_d = false;
+  raster_power_.clear();
+  const char *remaining_line;
+  char letter;
+  float value;
+  for (;;) {
+    line = skip_white(line);
+    if (toupper(*line) == 'D') {
+      // Base64 is case sensitive, so is not read as a number.
+      line = decode_base64(skip_white(line + 1), &raster_power_);
+      have_d = true;
+      continue;
+    }
+    if ((remaining_line = gparse_pair(line, &letter, &value)) == NULL)
+      break;
+    const float unit_value = value * unit_to_mm_factor_;
+    if (letter == 'F') {
+      feedrate = f_param_to_feedrate(unit_value);
+    } else {
+      const enum GCodeParserAxis axis = gcodep_letter2axis(letter);
+      if (axis == GCODE_NUM_AXES)
+        break;  // Possibly start of new command.
+      target[axis] = abs_axis_pos(axis, unit_value);
+      affected_axes |= (1 << axis);
+    }
+    line = remaining_line;
+  }
+
+  if (!have_d || raster_power_.empty()) {
+    gprintf(GLOG_SYNTAX_ERR, "handle_raster: G7 missing D\n");
+    return NULL;
+  }
+  callbacks()->clamp_to_range(affected_axes, &target);
+  callbacks()->raster_move(feedrate, axes_pos_, target,
+                           raster_power_.data(), raster_power_.size());
+  axes_pos_ = target;
+  return line;
+}
+
 const char *GCodeParser::Impl::handle_z_probe(const char *line) {
   char letter;
   float value;
@@ -1850,7 +2257,10 @@ void GCodeParser::Impl::ParseBlock(GCodeParser *owner,
   }
 
   ++line_number_;
+  TraceScope trace(TraceEvent::PARSE_LINE, line_number_);
   err_msg_ = err_stream;  // remember as 'instance' variable.
+  while_owner_ = owner;
+  while_err_stream_ = err_stream;
   char letter;
   float value;
   while ((line = gparse_pair(line, &letter, &value))) {
@@ -1874,6 +2284,7 @@ void GCodeParser::Impl::ParseBlock(GCodeParser *owner,
         have_first_spline_ = last_spline;
         line = handle_spline(value, line);
         break;
+      case  7: line = handle_raster(line); break;
       case 10: line = handle_G10(line); break;
       case 17: arc_normal_ = AXIS_Z; break;
       case 18: arc_normal_ = AXIS_Y; break;
@@ -37,6 +37,7 @@
 
 #include <string>
 #include <map>
+#include <memory>
 
 #include "common/container.h"
 
@@ -69,6 +70,10 @@ inline bool is_rotational_axis(GCodeParserAxis axis) {
   return axis == AXIS_A || axis == AXIS_B || axis == AXIS_C;
 }
 
+// Longest chord of a circle with "radius" that stays within "tolerance" of
+// the circle. Useful to determine how to split arcs into segments.
+float gcodep_chord_length(float radius, float tolerance);
+
 // A parser for GCode that handles all the nitty gritty details of GCode,
 // then sends the resulting machine path to the EventReceiver callbacks.
 //
@@ -139,6 +144,17 @@ struct GCodeParser::Config {
   bool LoadParams();
   bool SaveParams() const;
 
+  // Write-behind mode, for programs that save parameters often: from now
+  // on, SaveParams() does not rewrite the file, but only hands the
+  // parameters changed since the last save to a background thread. It
+  // appends them to a journal next to the parameter file and merges that
+  // into the file once it grows long. LoadParams() reads both.
+  // Call after LoadParams(). Copies of this Config share the mode.
+  void EnableWriteBehind();
+
+  // In write-behind mode, wait until everything saved so far is written.
+  void FlushParams() const;
+
   // Allow using M111 to change debug messages.
   bool allow_m111 = false;
 
@@ -153,7 +169,10 @@ struct GCodeParser::Config {
   ParamMap *parameters;
 
 private:
+  class ParamJournal;
+
   const std::string paramfile;
+  std::shared_ptr<ParamJournal> journal_;
 };
 
 // Parse Event Callbacks called by the parser and to be implemented by the
@@ -267,7 +286,7 @@ public:
   // interpolated from their current position (e.g. creating a spiral).
   //
   // The default implementation linearlizes it and calls coordinated_move()
-  // with small line segments.
+  // with line segments no longer than arc_segment_length() allows.
   //
   // TODO(hzeller): We could probably generalize this by having a
   //  'normal vector' instead of normal_axis + clockwise. This would allow for
@@ -288,6 +307,23 @@ public:
                            const AxesRegister &cp1, const AxesRegister &cp2,
                            const AxesRegister &end);
 
+  // G7 (laser raster, BeagleG extension)
+  // Move in a straight line from absolute "start" to "end", while the
+  // laser power follows "power": "count" pixels of equal length along the
+  // line, from 0 (off) to 255 (full power).
+  // The default implementation ignores the power and calls
+  // coordinated_move().
+  virtual void raster_move(float feed_mm_p_sec,
+                           const AxesRegister &start, const AxesRegister &end,
+                           const uint8_t *power, int count);
+
+  // Maximum length of the line segments the default arc_move() and
+  // spline_move() use for a curve with the given radius, traversed with
+  // the given feedrate. The default keeps the chord error (distance of the
+  // segment to the curve) below 0.005mm; that gives few, long segments on
+  // large arcs, and short ones where the curve is tight.
+  virtual float arc_segment_length(float radius, float feed_mm_p_sec);
+
   // Hand out G-code command that could not be interpreted.
   // Parameters: letter + value of the command that was not understood,
   // string of rest of line (the letter is always upper-case).
@@ -7,11 +7,27 @@
 #include <string.h>
 #include <strings.h>
 #include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <new>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "common/string-util.h"
 
+// Heap allocations so far, to check that the common case doesn't need any.
+static int allocation_count = 0;
+void *operator new(size_t size) {
+  ++allocation_count;
+  void *result = malloc(size ? size : 1);
+  if (!result) throw std::bad_alloc();
+  return result;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
 // 'home' position of our simulated machine. Arbitrary values.
 #define HOME_X 123
 #define HOME_Y 456
@@ -233,6 +249,25 @@ TEST(GCodeParserTest, InvalidNumbers) {
   }
 }
 
+TEST(GCodeParserTest, DecimalNumbersSameAsStrtof) {
+  // Plain numbers take a fast path, numbers with many digits the general
+  // one. Both should come out the same as strtof() would. The last ones
+  // are close to half-way between two floats; going through double first
+  // would round them to the wrong side.
+  const char *numbers[] = { "12.345", "-0.001", "+7.5", "3.", "-.25",
+                            "0.1234567", "99999.999", "123456789012345",
+                            "1.23456789012345678", "16777217", "0.0000000001",
+                            "1.00000661611557", "1.00001460313797",
+                            "-1.00002783536911", NULL };
+  for (const char **n = numbers; *n; ++n) {
+    ParseTester counter;
+    EXPECT_TRUE(counter.TestParseLine((std::string("G1 X") + *n).c_str()));
+    EXPECT_EQ(HOME_X + strtof(*n, NULL), counter.abs_pos[AXIS_X]) << *n;
+    EXPECT_TRUE(counter.TestParseLine((std::string("#1=") + *n).c_str()));
+    EXPECT_EQ(strtof(*n, NULL), counter.get_parameter(1)) << *n;
+  }
+}
+
 TEST(GCodeParserTest, absolute_relative) {
   ParseTester counter;
 
@@ -623,6 +658,51 @@ TEST(GCodeParserTest, arc_generation) {
   }
 }
 
+// Full circles in the XY plane at the home position: number of segments
+// only grows with the square root of the radius.
+static int CountFullCircleSegments(float radius) {
+  ArcTester counter;
+  counter.TestParseLine("G17");
+  counter.TestParseLine(StringPrintf("G1 X%f Y0", radius).c_str());
+  counter.ExpectCircle({HOME_X, HOME_Y, HOME_Z}, AXIS_Z, radius);
+  const int before = counter.call_count[CALL_coordinated_move];
+  counter.TestParseLine(StringPrintf("G2 X%f Y0 I%f J0",
+                                     radius, -radius).c_str());
+  return counter.call_count[CALL_coordinated_move] - before;
+}
+
+TEST(GCodeParserTest, arc_segments_adapt_to_radius) {
+  // Chord error 0.005mm: a 200mm radius circle needs ~ 2*pi*200 / 2.83mm.
+  const int large = CountFullCircleSegments(200);
+  EXPECT_GT(large, 400);
+  EXPECT_LT(large, 500);
+
+  const int small = CountFullCircleSegments(1);
+  EXPECT_GT(small, 25);
+  EXPECT_LT(small, 40);
+
+  // Even tiny circles are not degenerated to a few lines.
+  EXPECT_GE(CountFullCircleSegments(0.001), 8);
+}
+
+TEST(GCodeParserTest, spline_segments_adapt_to_curvature) {
+  ParseTester counter;
+  counter.TestParseLine("G1 X0 Y0");
+  int before = counter.call_count[CALL_coordinated_move];
+  // Control points on the line: no need for more than one segment.
+  counter.TestParseLine("G5 X30 Y0 I10 J0 P-10 Q0");
+  EXPECT_EQ(1, counter.call_count[CALL_coordinated_move] - before);
+  EXPECT_FLOAT_EQ(HOME_X + 30, counter.abs_pos[AXIS_X]);
+
+  before = counter.call_count[CALL_coordinated_move];
+  counter.TestParseLine("G5 X60 Y0 I0 J30 P0 Q-30");  // S-curve.
+  const int curved = counter.call_count[CALL_coordinated_move] - before;
+  EXPECT_GT(curved, 10);
+  EXPECT_LT(curved, 200);
+  EXPECT_FLOAT_EQ(HOME_X + 60, counter.abs_pos[AXIS_X]);
+  EXPECT_FLOAT_EQ(HOME_Y, counter.abs_pos[AXIS_Y]);
+}
+
 TEST(GCodeParserTest, expressions) {
   ParseTester counter;
 
@@ -895,6 +975,122 @@ TEST(GCodeParserTest, WhileLoop) {
   EXPECT_EQ(1024, counter.get_parameter(2));
 }
 
+// Loop bodies are compiled once; make sure every iteration still sees the
+// current parameter values, also in G-code words and indirect parameters.
+TEST(GCodeParserTest, WhileLoopBodyEvaluatedEachIteration) {
+  ParseTester counter;
+
+  EXPECT_TRUE(counter.TestParseLine("#1=0"));
+  EXPECT_TRUE(counter.TestParseLine("WHILE [#1 < 5] DO\n"));
+  EXPECT_TRUE(counter.TestParseLine("#2 = [100 + #1]\n"));
+  EXPECT_TRUE(counter.TestParseLine("##2 = [#1 * #1]\n"));
+  EXPECT_TRUE(counter.TestParseLine("IF [#1 == 3] THEN #<seen> = #1\n"));
+  EXPECT_TRUE(counter.TestParseLine("G1 X[#1 * 2] F100\n"));
+  EXPECT_TRUE(counter.TestParseLine("#1++\n"));
+  EXPECT_TRUE(counter.TestParseLine("END\n"));
+  EXPECT_EQ(5, counter.get_parameter(1));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(i * i, counter.get_parameter(100 + i));
+  }
+  EXPECT_EQ(3, counter.get_parameter("seen"));
+  EXPECT_EQ(5, counter.call_count[CALL_coordinated_move]);
+  EXPECT_EQ(HOME_X + 8, counter.abs_pos[AXIS_X]);
+}
+
+class RasterTester : public ParseTester {
+public:
+  void raster_move(float feed_mm_p_sec,
+                   const AxesRegister &start, const AxesRegister &end,
+                   const uint8_t *power, int count) final {
+    raster_start = start;
+    abs_pos = end;
+    pixels.assign(power, power + count);
+  }
+
+  AxesRegister raster_start;
+  std::vector<int> pixels;
+};
+
+TEST(GCodeParserTest, RasterLineDecodesPixels) {
+  RasterTester counter;
+  EXPECT_TRUE(counter.TestParseLine("G1 X10 Y5 F100"));
+  EXPECT_TRUE(counter.TestParseLine("G7 X20 DAID/gAA="));
+  EXPECT_EQ(std::vector<int>({ 0, 128, 255, 128, 0 }), counter.pixels);
+  EXPECT_EQ(HOME_X + 10, counter.raster_start[AXIS_X]);
+  EXPECT_EQ(HOME_X + 20, counter.abs_pos[AXIS_X]);
+  EXPECT_EQ(HOME_Y + 5, counter.abs_pos[AXIS_Y]);
+
+  EXPECT_FALSE(counter.TestParseLine("G7 X30"));  // Pixels are required.
+}
+
+// Plain moves, moves using parameters and expressions, and the segments of
+// arcs and splines are parsed without any heap allocation.
+TEST(GCodeParserTest, NoAllocationsPerLine) {
+  ParseTester counter;
+  EXPECT_TRUE(counter.TestParseLine("#1 = 5 #<speed> = 3000"));
+  EXPECT_TRUE(counter.TestParseLine("G1 X1 Y2 F100"));  // Warm up.
+  EXPECT_TRUE(counter.TestParseLine("G1 X#1 Y[#<speed> / 100 + 2]"));
+  const int before = allocation_count;
+  const char *const lines[] = {
+    "G1 X10 Y20 Z0.3 F3000",
+    "G1 X10.5 Y-20.25 E0.0125",
+    "X11 Y21",
+    "G0 X0 Y0",
+    "G1 X#1 Y[#<speed> / 100 + 2]",
+    "G1 X[SIN[#1] * 2] Y[#2 + 1]",
+    "G2 I5 J0",                       // Full circle.
+    "G5 I1 J2 P-3 Q4 X10 Y0",
+  };
+  for (const char *line : lines) {
+    EXPECT_TRUE(counter.TestParseLine(line));
+    EXPECT_EQ(before, allocation_count) << line;
+  }
+}
+
+TEST(GCodeParserTest, ParamsWriteBehindJournal) {
+  char paramfile[] = "/tmp/gcode-parser-test-params.XXXXXX";
+  const int fd = mkstemp(paramfile);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  const std::string journal = std::string(paramfile) + ".journal";
+  {
+    GCodeParser::Config::ParamMap params;
+    GCodeParser::Config config(paramfile);
+    config.parameters = &params;
+    EXPECT_TRUE(config.LoadParams());
+    config.EnableWriteBehind();
+    params["5221"] = 10;
+    params["_tool"] = 3;
+    params["_local_only"] = 0;
+    params["<#local>"] = 42;   // Not persisted.
+    EXPECT_TRUE(config.SaveParams());
+    params["5221"] = 12;
+    params["_tool"] = 0;       // Now back to zero, needs to be recorded.
+    EXPECT_TRUE(config.SaveParams());
+    config.FlushParams();
+    EXPECT_EQ(0, access(journal.c_str(), F_OK));  // Not merged yet.
+  }
+
+  GCodeParser::Config::ParamMap loaded;
+  GCodeParser::Config config(paramfile);
+  config.parameters = &loaded;
+  EXPECT_TRUE(config.LoadParams());
+  EXPECT_FLOAT_EQ(12, loaded["5221"]);
+  EXPECT_FLOAT_EQ(0, loaded["_tool"]);
+  EXPECT_FLOAT_EQ(1, loaded["5220"]);
+  EXPECT_TRUE(loaded.find("<#local>") == loaded.end());
+
+  // A regular save has it all in the file.
+  EXPECT_TRUE(config.SaveParams());
+  EXPECT_NE(0, access(journal.c_str(), F_OK));
+  loaded.clear();
+  EXPECT_TRUE(config.LoadParams());
+  EXPECT_FLOAT_EQ(12, loaded["5221"]);
+
+  unlink(paramfile);
+  unlink((std::string(paramfile) + ".bak").c_str());
+}
+
 int main(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -25,7 +25,8 @@
 GCodeStreamer::GCodeStreamer(FDMultiplexer *event_server, GCodeParser *parser,
                              GCodeParser::EventReceiver *parse_events)
   : event_server_(event_server), parser_(parser), parse_events_(parse_events),
-    is_processing_(false), connection_fd_(-1), lines_processed_(0) {
+    is_mapped_(false), is_compiled_(false), is_processing_(false), connection_fd_(-1), lines_processed_(0),
+    reads_per_event_(1), wakeup_fd_(-1), is_suspended_(false), is_held_(false) {
   // Let's start the input idle tasklet
   // TODO: the lifetime implications are a bit problematic as we need to
   // outlive the Loop() of the event server.
@@ -46,6 +47,12 @@ bool GCodeStreamer::ConnectStream(int fd, FILE *msg_stream) {
   msg_stream_ = msg_stream;
   connection_fd_ = fd;
   lines_processed_ = 0;
+  is_compiled_ = compiled_file_.Open(fd);
+  is_mapped_ = !is_compiled_ && mapped_file_.Map(fd);
+  if (is_compiled_) Log_info("Replaying precompiled G-code.");
+  // A non-blocking socket can be drained with several reads per event
+  // without risking to block.
+  reads_per_event_ = (fcntl(fd, F_GETFL) & O_NONBLOCK) ? 4 : 1;
 
   event_server_->RunOnReadable(connection_fd_, [this](){
     return ReadData();
@@ -53,19 +60,128 @@ bool GCodeStreamer::ConnectStream(int fd, FILE *msg_stream) {
   return true;
 }
 
+void GCodeStreamer::SetFlowControl(int wakeup_fd,
+                                   const std::function<void()> &on_wakeup,
+                                   const std::function<bool()> &can_proceed) {
+  wakeup_fd_ = wakeup_fd;
+  on_wakeup_ = on_wakeup;
+  can_proceed_ = can_proceed;
+}
+
+void GCodeStreamer::Suspend() {
+  is_suspended_ = true;
+  // If we are called from within WakeupEvent(), we're already registered.
+  event_server_->RunOnReadable(wakeup_fd_, [this](){
+    return WakeupEvent();
+  });
+}
+
+// The receiver made progress. See if we can continue parsing.
+bool GCodeStreamer::WakeupEvent() {
+  if (on_wakeup_) on_wakeup_();
+  if (!can_proceed_()) return true;  // Still waiting.
+  is_suspended_ = false;
+  if (!is_held_ && ParseBufferedLines()) {
+    // All buffered lines done. Listen to new data again.
+    event_server_->RunOnReadable(connection_fd_, [this](){
+      return ReadData();
+    });
+  }
+  // Keep listening to wakeup events only if we got suspended again.
+  return is_suspended_;
+}
+
+void GCodeStreamer::Hold() {
+  is_held_ = true;
+}
+
+void GCodeStreamer::Release() {
+  if (!is_held_) return;
+  is_held_ = false;
+  // If suspended, the wakeup event continues once the receiver is ready.
+  if (is_suspended_ || connection_fd_ < 0) return;
+  if (ParseBufferedLines()) {
+    event_server_->RunOnReadable(connection_fd_, [this](){
+      return ReadData();
+    });
+  }
+}
+
+// Next line or NULL if none is available right now.
+const char *GCodeStreamer::NextLine() {
+  if (!is_mapped_) return reader_.ReadLine();
+  StringPiece line;
+  if (!mapped_file_.ReadLine(&line)) return NULL;
+  // The parser needs a nul-terminated string. This short copy is the only
+  // one: no read() into a buffer and no moving around partial lines.
+  mapped_line_.assign(line.data(), line.length());
+  return mapped_line_.c_str();
+}
+
+bool GCodeStreamer::ParseBufferedLines() {
+  // A mapped file has all lines available. Return after a batch, so that we
+  // don't starve other handlers in the event loop.
+  enum { kMappedLinesPerCycle = 256 };
+  int batch = 0;
+  const char *line;
+  for (;;) {
+    if (is_held_) return false;
+    if (can_proceed_ && wakeup_fd_ >= 0 && !can_proceed_()) {
+      Suspend();
+      return false;
+    }
+    if ((is_mapped_ || is_compiled_) && ++batch > kMappedLinesPerCycle)
+      break;
+    if (is_compiled_) {
+      if (!compiled_file_.ReplayNext(parser_, parse_events_, msg_stream_))
+        break;
+      ++lines_processed_;
+      continue;
+    }
+    if ((line = NextLine()) == NULL)
+      break;
+    // NOTE:(important)
+    // This should return true or false in case the line was movement or not
+    // and only if is, reset the timer.
+    parser_->ParseBlock(line, msg_stream_);
+    ++lines_processed_;
+  }
+  return true;
+}
+
 void GCodeStreamer::CloseStream() {
   if (msg_stream_) {
     fflush(msg_stream_);
   }
+  if (is_mapped_) mapped_file_.Close();
+  if (is_compiled_) compiled_file_.Close();
+  is_mapped_ = false;
+  is_compiled_ = false;
   close(connection_fd_);
   connection_fd_ = -1;
   Log_info("Processed %d GCode blocks.", lines_processed_);
+  if (on_finished_) on_finished_();
+}
+
+// A batch of lines from a mapped file is ready to be parsed.
+bool GCodeStreamer::ParseMappedFile() {
+  is_processing_ = true;
+  if (!ParseBufferedLines())
+    return false;  // Suspended. Will be re-registered when we continue.
+  if (is_compiled_ ? !compiled_file_.AtEnd() : !mapped_file_.AtEnd())
+    return true;   // Regular files are always ready: next batch next cycle.
+  Log_info("Reached EOF.");
+  parse_events_->gcode_finished(true);
+  is_processing_ = false;
+  CloseStream();  // Might connect the next stream.
+  return false;
 }
 
 // New data to be fed into the linebuffer
 bool GCodeStreamer::ReadData() {
+  if (is_mapped_ || is_compiled_) return ParseMappedFile();
   // Update buffer
-  if (reader_.Update(connection_fd_) == 0) {
+  if (reader_.Update(connection_fd_, reads_per_event_) == 0) {
     Log_info("Reached EOF.");
 
     // Parse any potentially remaining gcode from previous connections.
@@ -76,27 +192,22 @@ bool GCodeStreamer::ReadData() {
 
     // always call gcode_finished() to disable motors at end of stream
     parse_events_->gcode_finished(true);
-    CloseStream();
     is_processing_ = false;
+    CloseStream();
     return false;  // We're done processing, remove us from fd-mux
   }
 
   is_processing_ = true;
-  const char *line;
-  while ((line = reader_.ReadLine())) {
-    // NOTE:(important)
-    // This should return true or false in case the line was movement or not
-    // and only if is, reset the timer.
-    parser_->ParseBlock(line, msg_stream_);
-    ++lines_processed_;
-  }
 
-  // Loop again
-  return true;
+  // If we got suspended, we stop reading until the receiver is ready again.
+  return ParseBufferedLines();
 }
 
 // We didn't receive a line within x milliseconds.
 bool GCodeStreamer::Timeout() {
+  // While suspended, we are not idle: we are just waiting for the receiver
+  // to catch up.
+  if (is_suspended_ || is_held_) return true;
   parse_events_->input_idle(is_processing_);
   is_processing_ = false;
   return true;
@@ -19,8 +19,13 @@
 #ifndef FD_GCODE_STREAMER_H_
 #define FD_GCODE_STREAMER_H_
 
+#include <functional>
+#include <string>
+
 #include "common/fd-mux.h"
 #include "common/linebuf-reader.h"
+#include "common/mmap-line-reader.h"
+#include "gcode-parser/compiled-gcode.h"
 #include "gcode-parser/gcode-parser.h"
 
 class GCodeStreamer {
@@ -32,25 +37,73 @@ public:
   // Reads GCode lines from "fd" and feeds them to the GCodeParser.
   // Error messages are sent to "err_stream" if non-NULL.
   // Reads until EOF.
+  // If "fd" is a regular file, it is memory mapped and parsed in batches of
+  // lines, so that other handlers in the FDMultiplexer keep running.
+  // A regular file with precompiled G-code (see compiled-gcode.h) is
+  // replayed to the event receiver directly, bypassing the parser.
   // The input file descriptor is closed.
   bool ConnectStream(int fd, FILE *msg_stream);
 
   // Returns true if we are already connected to a stream.
   bool IsStreaming() { return connection_fd_ >= 0; }
 
+  // Optional flow control. Before each line is parsed, "can_proceed" is
+  // asked if the receiver can accept more without blocking. If not, parsing
+  // is suspended and no more data is read until "wakeup_fd" becomes readable
+  // and "can_proceed" returns true again. While suspended, the rest of the
+  // FDMultiplexer handlers keep running.
+  // "on_wakeup" is called each time "wakeup_fd" is readable and needs to
+  // consume the event.
+  void SetFlowControl(int wakeup_fd,
+                      const std::function<void()> &on_wakeup,
+                      const std::function<bool()> &can_proceed);
+
+  // Stop parsing after the current block until Release() is called, e.g.
+  // while the receiver waits for a timer. The rest of the FDMultiplexer
+  // handlers keep running. Like flow control, this is not considered idle.
+  void Hold();
+  void Release();
+
+  // Called whenever a stream got to its end and is closed, so that the
+  // next one can be connected, which can be done right from "on_finished".
+  void SetOnStreamFinished(const std::function<void()> &on_finished) {
+    on_finished_ = on_finished;
+  }
+
 private:
   void CloseStream();
 
+  // Parse lines available in the reader_. Returns false if parsing has been
+  // suspended due to flow control.
+  bool ParseBufferedLines();
+  const char *NextLine();  // Next line from reader_ or mapped_file_
+  bool ParseMappedFile();
+  void Suspend();
+  bool WakeupEvent();
+
   FDMultiplexer *const event_server_;
   GCodeParser *const parser_;
   GCodeParser::EventReceiver *const parse_events_;
 
   LinebufReader reader_;
+  MMapLineReader mapped_file_;
+  bool is_mapped_;
+  std::string mapped_line_;  // nul-terminated copy of the current line.
+  CompiledGCodeReader compiled_file_;
+  bool is_compiled_;
   bool is_processing_;
 
   FILE *msg_stream_;
   int connection_fd_;
   int lines_processed_;
+  int reads_per_event_;
+
+  int wakeup_fd_;
+  std::function<void()> on_wakeup_;
+  std::function<bool()> can_proceed_;
+  bool is_suspended_;
+  bool is_held_;
+  std::function<void()> on_finished_;
 
   bool ReadData();
   bool Timeout();
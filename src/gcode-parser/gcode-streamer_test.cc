@@ -59,7 +59,7 @@ public:
   StreamTester()
     : parser_(new GCodeParser(GCodeParser::Config(), this)),
       streamer_(new GCodeStreamer(&event_server_, parser_.get(), this)),
-      stream_mock_(NULL) {}
+      stream_mock_(NULL), receiver_ready_(true) {}
 
   bool OpenStream() {
     assert(stream_mock_ == NULL);
@@ -67,6 +67,17 @@ public:
     return streamer_->ConnectStream(stream_mock_->GetReceiverFiledescriptor(), NULL);
   }
 
+  // Stream from a regular file with "content".
+  bool OpenFile(const std::string &content) {
+    FILE *f = tmpfile();
+    fwrite(content.data(), 1, content.size(), f);
+    fflush(f);
+    const int fd = dup(fileno(f));  // Streamer closes it.
+    fclose(f);
+    lseek(fd, 0, SEEK_SET);
+    return streamer_->ConnectStream(fd, NULL);
+  }
+
   void CloseStream() {
     stream_mock_->CloseSender();
     delete stream_mock_;
@@ -81,6 +92,26 @@ public:
     event_server_.SingleCycle(0);
   }
 
+  // Flow control simulation: the receiver can only proceed if "ready" is set.
+  // Whenever it changes, we signal that via the wakeup pipe.
+  void EnableFlowControl() {
+    streamer_->SetFlowControl(
+      wakeup_.GetReceiverFiledescriptor(),
+      [this]() {
+        char c;
+        read(wakeup_.GetReceiverFiledescriptor(), &c, 1);
+      },
+      [this]() { return receiver_ready_; });
+  }
+  void SetReceiverReady(bool ready) {
+    receiver_ready_ = ready;
+    wakeup_.SendData("x");
+  }
+
+  // Hold input whenever a dwell is seen.
+  void dwell(float time_ms) override { streamer_->Hold(); }
+  void Release() { streamer_->Release(); }
+
   MOCK_METHOD1(gcode_start, void(GCodeParser *parser));
   MOCK_METHOD1(gcode_finished, void(bool end_of_stream));
   MOCK_METHOD1(input_idle, void(bool is_first));
@@ -92,7 +123,6 @@ public:
   void set_fanspeed(float value) override {}
   void set_temperature(float degrees_c) override {}
   void wait_temperature() override {}
-  void dwell(float time_ms) override {}
   void motors_enable(bool enable) override {}
   bool rapid_move(float feed_mm_p_sec,
                   const AxesRegister &axes) override { return true;}
@@ -109,6 +139,8 @@ private:
   std::unique_ptr<GCodeParser> parser_;
   std::unique_ptr<GCodeStreamer> streamer_;
   MockStream *stream_mock_;
+  MockStream wakeup_;
+  bool receiver_ready_;
 };
 
 using namespace ::testing;
@@ -174,6 +206,108 @@ TEST(Streaming, basic_stream) {
   tester.Cycle(); // Wait the stream to close
 }
 
+// If the receiver can't accept more, we stop parsing until it tells us
+// it is ready again. This is not considered idle.
+TEST(Streaming, flow_control_suspends_parsing) {
+  StreamTester tester;
+  tester.EnableFlowControl();
+  tester.SetReceiverReady(false);
+
+  EXPECT_CALL(tester, gcode_start(_)).Times(AnyNumber());
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(0);
+  EXPECT_CALL(tester, input_idle(_)).Times(0);
+  tester.OpenStream();
+  tester.SendString("G1X200F1000\nG1X100F1000\n");
+  tester.Cycle();  // Reads data, but receiver is not ready.
+  tester.Cycle();  // Wakeup, but still not ready.
+  tester.Cycle();  // Timeout. But we're suspended, so not idle.
+  Mock::VerifyAndClearExpectations(&tester);
+
+  EXPECT_CALL(tester, gcode_start(_)).Times(AnyNumber());
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(2);
+  tester.SetReceiverReady(true);
+  tester.Cycle();  // Wakeup; now we process the pending lines.
+  Mock::VerifyAndClearExpectations(&tester);
+
+  // Back to reading the stream.
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(1);
+  EXPECT_CALL(tester, gcode_finished(_)).Times(1);
+  tester.SendString("G1X200F1000\n");
+  tester.Cycle();
+  tester.CloseStream();
+  tester.Cycle();
+}
+
+// A receiver holding the input stops parsing until it is released, without
+// being idle.
+TEST(Streaming, hold_stops_parsing_until_released) {
+  StreamTester tester;
+
+  EXPECT_CALL(tester, gcode_start(_)).Times(AnyNumber());
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(1);
+  EXPECT_CALL(tester, input_idle(_)).Times(0);
+  tester.OpenStream();
+  tester.SendString("G1X200F1000\nG4P100\nG1X100F1000\n");
+  tester.Cycle();  // Reads data, parses up to the dwell.
+  tester.Cycle();  // Timeout. But we're held, so not idle.
+  Mock::VerifyAndClearExpectations(&tester);
+
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(2);
+  tester.Release();  // Parses the rest of the buffered line.
+  tester.SendString("G1X200F1000\n");
+  tester.Cycle();
+  Mock::VerifyAndClearExpectations(&tester);
+
+  EXPECT_CALL(tester, gcode_finished(_)).Times(1);
+  tester.CloseStream();
+  tester.Cycle();
+}
+
+// Regular files are memory mapped and parsed in batches of lines.
+TEST(Streaming, regular_file_is_parsed_in_batches) {
+  StreamTester tester;
+  std::string content;
+  for (int i = 0; i < 1000; ++i) content.append("G1X200F1000\n");
+  content.append("G1X100");  // Last line without newline.
+
+  EXPECT_CALL(tester, gcode_start(_)).Times(1);
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(256);
+  EXPECT_CALL(tester, gcode_finished(_)).Times(0);
+  ASSERT_TRUE(tester.OpenFile(content.c_str()));
+  tester.Cycle();
+  Mock::VerifyAndClearExpectations(&tester);
+
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(1001 - 256);
+  EXPECT_CALL(tester, gcode_finished(true)).Times(1);
+  for (int i = 0; i < 4; ++i) tester.Cycle();
+}
+
+// Precompiled G-code is replayed to the receiver instead of being parsed.
+TEST(Streaming, compiled_file_is_replayed) {
+  std::string gcode;
+  for (int i = 0; i < 300; ++i) gcode.append("G1X200F1000\n");
+  FILE *f = tmpfile();
+  {
+    GCodeParser::Config::ParamMap params;
+    GCodeParser::Config config;
+    config.parameters = &params;
+    CompiledGCodeWriter writer(f);
+    GCodeParser parser(config, &writer);
+    parser.ReadFile(fmemopen((void*)gcode.data(), gcode.size(), "r"), NULL);
+  }
+  std::string compiled(ftell(f), '\0');
+  rewind(f);
+  ASSERT_EQ(compiled.size(), fread(&compiled[0], 1, compiled.size(), f));
+  fclose(f);
+
+  StreamTester tester;
+  EXPECT_CALL(tester, gcode_start(_)).Times(1);
+  EXPECT_CALL(tester, coordinated_move(_, _)).Times(300);
+  EXPECT_CALL(tester, gcode_finished(true)).Times(1);
+  ASSERT_TRUE(tester.OpenFile(compiled));
+  for (int i = 0; i < 10; ++i) tester.Cycle();
+}
+
 int main(int argc, char *argv[]) {
   Log_init("/dev/stderr");
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,153 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "job-spool.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/logging.h"
+
+JobSpool::JobSpool(FDMultiplexer *event_server, GCodeStreamer *streamer,
+                   int max_jobs)
+  : event_server_(event_server), streamer_(streamer), max_jobs_(max_jobs),
+    job_counter_(0) {
+  streamer_->SetOnStreamFinished([this]() { StartNext(); });
+}
+
+JobSpool::~JobSpool() {
+  streamer_->SetOnStreamFinished(nullptr);
+  for (Job *job : jobs_) {
+    // Only destructed after the event server Loop() has finished, so
+    // receive handlers of incomplete jobs are not called anymore.
+    if (!job->complete) CloseConnection(job);
+    if (job->spool) fclose(job->spool);
+    delete job;
+  }
+}
+
+bool JobSpool::Submit(int fd, FILE *msg_stream, const std::string &name) {
+  if (!streamer_->IsStreaming() && jobs_.empty()) {
+    if (on_start_) on_start_(msg_stream);
+    return streamer_->ConnectStream(fd, msg_stream);
+  }
+  if ((int)jobs_.size() >= max_jobs_)
+    return false;
+
+  FILE *spool = tmpfile();
+  if (!spool) {
+    Log_error("Can't create spool file: %s", strerror(errno));
+    return false;
+  }
+  Job *job = new Job();
+  job->name = name;
+  job->fd = fd;
+  job->msg_stream = msg_stream;
+  job->spool = spool;
+  job->bytes = 0;
+  job->complete = false;
+  jobs_.push_back(job);
+  ++job_counter_;
+  Log_info("Spooling job #%d from %s; %d waiting.", job_counter_,
+           name.c_str(), (int)jobs_.size());
+  if (msg_stream) {
+    fprintf(msg_stream, "// Machine busy. Receiving job #%d into spool "
+            "at position %d.\n", job_counter_, (int)jobs_.size());
+    fflush(msg_stream);
+  }
+  event_server_->RunOnReadable(fd, [this, job]() { return ReceiveData(job); });
+  return true;
+}
+
+bool JobSpool::ReceiveData(Job *job) {
+  char buffer[65536];
+  // Connections are non-blocking, so we can drain them here.
+  for (int i = 0; i < 16; ++i) {
+    const ssize_t r = read(job->fd, buffer, sizeof(buffer));
+    if (r == 0) {
+      FinishReceive(job, true);
+      return false;
+    }
+    if (r < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return true;
+      Log_error("Reading job from %s: %s", job->name.c_str(), strerror(errno));
+      FinishReceive(job, false);
+      return false;
+    }
+    if (fwrite(buffer, 1, r, job->spool) != (size_t)r) {
+      Log_error("Writing spool file: %s", strerror(errno));
+      FinishReceive(job, false);
+      return false;
+    }
+    job->bytes += r;
+  }
+  return true;
+}
+
+void JobSpool::CloseConnection(Job *job) {
+  if (job->msg_stream)
+    fclose(job->msg_stream);  // Closes the connection as well.
+  else
+    close(job->fd);
+  job->msg_stream = NULL;
+  job->fd = -1;
+}
+
+void JobSpool::FinishReceive(Job *job, bool success) {
+  if (success && fflush(job->spool) != 0) success = false;
+  if (job->msg_stream) {
+    if (success) {
+      fprintf(job->msg_stream, "// Received %zu bytes. Job will run when "
+              "the machine is ready.\n", job->bytes);
+    } else {
+      fprintf(job->msg_stream, "// Receiving job failed. Not run.\n");
+    }
+  }
+  CloseConnection(job);
+  if (!success) {
+    jobs_.remove(job);
+    fclose(job->spool);
+    delete job;
+    return;
+  }
+  Log_info("Received job from %s (%zu bytes).", job->name.c_str(), job->bytes);
+  job->complete = true;
+  StartNext();
+}
+
+void JobSpool::StartNext() {
+  if (streamer_->IsStreaming() || jobs_.empty() || !jobs_.front()->complete)
+    return;
+  Job *job = jobs_.front();
+  jobs_.pop_front();
+  const int fd = dup(fileno(job->spool));
+  fclose(job->spool);
+  Log_info("Starting spooled job from %s; %d more waiting.",
+           job->name.c_str(), (int)jobs_.size());
+  delete job;
+  if (fd < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+    Log_error("Can't read spool file: %s", strerror(errno));
+    if (fd >= 0) close(fd);
+    StartNext();
+    return;
+  }
+  if (on_start_) on_start_(NULL);
+  streamer_->ConnectStream(fd, NULL);
+}
@@ -0,0 +1,88 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_JOB_SPOOL_H_
+#define _BEAGLEG_JOB_SPOOL_H_
+
+#include <stdio.h>
+
+#include <functional>
+#include <list>
+#include <string>
+
+#include "common/fd-mux.h"
+#include "gcode-parser/gcode-streamer.h"
+
+// Queue of G-code jobs in front of a GCodeStreamer, so that the next job
+// can be sent while the current one is still running.
+//
+// If nothing is running or waiting, a new connection is streamed right away,
+// as an interactive session. Otherwise, its content is received in the
+// background into a spool file (regular file in the temp directory), and
+// run after all jobs before it are done. Jobs run in the order they were
+// submitted.
+class JobSpool {
+public:
+  // At most "max_jobs" can wait, including the ones still being received.
+  // Zero means: only one job at a time, nothing is spooled.
+  // Both, "event_server" and "streamer" need to outlive the JobSpool.
+  JobSpool(FDMultiplexer *event_server, GCodeStreamer *streamer,
+           int max_jobs);
+  ~JobSpool();
+
+  // Called right before a job starts to be streamed. The "msg_stream" is the
+  // one given in Submit() for a job that starts right away, or NULL for a
+  // job from the spool (its connection is already closed).
+  void SetOnJobStart(const std::function<void(FILE *msg_stream)> &on_start) {
+    on_start_ = on_start;
+  }
+
+  // Take a new connection "fd" with its "msg_stream" (which writes to "fd",
+  // or NULL).
+  // Both are owned by the JobSpool from here on. A spooled connection gets a
+  // message once its job is received completely and is closed.
+  // Returns false if the spool is full; then nothing is taken over.
+  bool Submit(int fd, FILE *msg_stream, const std::string &name);
+
+  // Number of jobs waiting, including the ones still being received.
+  int waiting() const { return jobs_.size(); }
+
+private:
+  struct Job {
+    std::string name;
+    int fd;           // Connection while receiving.
+    FILE *msg_stream; // Writing to the connection.
+    FILE *spool;      // Received data.
+    size_t bytes;
+    bool complete;
+  };
+
+  bool ReceiveData(Job *job);
+  void FinishReceive(Job *job, bool success);
+  void CloseConnection(Job *job);
+  void StartNext();
+
+  FDMultiplexer *const event_server_;
+  GCodeStreamer *const streamer_;
+  const int max_jobs_;
+  std::function<void(FILE *msg_stream)> on_start_;
+  std::list<Job*> jobs_;
+  int job_counter_;
+};
+
+#endif  // _BEAGLEG_JOB_SPOOL_H_
@@ -0,0 +1,168 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the job spool.
+ */
+#include "job-spool.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+namespace {
+// Remembers the X position of all moves in the order they come in.
+class MoveRecorder : public GCodeParser::EventReceiver {
+public:
+  void gcode_start(GCodeParser *parser) final {}
+  void gcode_finished(bool end_of_stream) final { ++finished; }
+  void go_home(AxisBitmap_t axis_bitmap) final {}
+  void set_speed_factor(float factor) final {}
+  void set_fanspeed(float value) final {}
+  void set_temperature(float degrees_c) final {}
+  void wait_temperature() final {}
+  void dwell(float time_ms) final {}
+  void motors_enable(bool enable) final {}
+  bool coordinated_move(float feed, const AxesRegister &pos) final {
+    x.push_back(pos[AXIS_X]);
+    return true;
+  }
+  bool rapid_move(float feed, const AxesRegister &pos) final { return true; }
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    return NULL;
+  }
+
+  std::vector<float> x;
+  int finished = 0;
+};
+
+// A connection: the spool reads from one end, the test writes to the other.
+class Connection {
+public:
+  Connection() {
+    if (pipe(fd_) < 0) perror("pipe()");
+    fcntl(fd_[0], F_SETFL, O_NONBLOCK);
+    if (pipe(msg_) < 0) perror("pipe()");
+    fcntl(msg_[0], F_SETFL, O_NONBLOCK);
+  }
+  ~Connection() {
+    if (fd_[1] >= 0) close(fd_[1]);
+    close(msg_[0]);
+  }
+
+  int fd() const { return fd_[0]; }
+  FILE *msg_stream() const { return fdopen(msg_[1], "w"); }
+
+  void Send(const char *data) {
+    if (write(fd_[1], data, strlen(data)) < 0) perror("write()");
+  }
+  void Close() { close(fd_[1]); fd_[1] = -1; }
+
+  std::string Messages() {
+    char buffer[1024];
+    const ssize_t r = read(msg_[0], buffer, sizeof(buffer));
+    return r > 0 ? std::string(buffer, r) : "";
+  }
+
+private:
+  int fd_[2];
+  int msg_[2];
+};
+
+class SpoolHarness {
+public:
+  explicit SpoolHarness(int max_jobs)
+    : parser_(GCodeParser::Config(), &recorder_),
+      streamer_(&event_server_, &parser_, &recorder_),
+      spool_(&event_server_, &streamer_, max_jobs) {
+    spool_.SetOnJobStart([this](FILE *msg) { start_msg_streams.push_back(msg); });
+  }
+
+  bool Submit(Connection *c) {
+    return spool_.Submit(c->fd(), c->msg_stream(), "test");
+  }
+  void Cycles(int n) {
+    for (int i = 0; i < n; ++i) event_server_.SingleCycle(10);
+  }
+
+  JobSpool *spool() { return &spool_; }
+  const MoveRecorder &recorder() const { return recorder_; }
+
+  std::vector<FILE*> start_msg_streams;
+
+private:
+  class TestMultiplexer : public FDMultiplexer {
+  public:
+    using FDMultiplexer::SingleCycle;
+  };
+
+  TestMultiplexer event_server_;
+  MoveRecorder recorder_;
+  GCodeParser parser_;
+  GCodeStreamer streamer_;
+  JobSpool spool_;
+};
+}  // namespace
+
+TEST(JobSpool, JobsArrivingWhileBusyRunInOrder) {
+  SpoolHarness h(2);
+  Connection first, second, third;
+  ASSERT_TRUE(h.Submit(&first));  // Directly streamed.
+  EXPECT_EQ(0, h.spool()->waiting());
+  ASSERT_EQ(1u, h.start_msg_streams.size());
+  EXPECT_TRUE(h.start_msg_streams[0] != NULL);
+
+  ASSERT_TRUE(h.Submit(&second));
+  ASSERT_TRUE(h.Submit(&third));
+  EXPECT_EQ(2, h.spool()->waiting());
+
+  // Next jobs are received while the first one still runs.
+  second.Send("G1 X2 F100\nG1 X3\n");
+  second.Close();
+  third.Send("G1 X4\n");
+  third.Close();
+  first.Send("G1 X1 F100\n");
+  h.Cycles(3);
+  EXPECT_EQ(std::vector<float>({ 1 }), h.recorder().x);
+  EXPECT_NE(std::string::npos, second.Messages().find("Received 17 bytes"));
+  EXPECT_EQ(1u, h.start_msg_streams.size());
+
+  first.Close();
+  h.Cycles(10);
+  EXPECT_EQ(std::vector<float>({ 1, 2, 3, 4 }), h.recorder().x);
+  EXPECT_EQ(3, h.recorder().finished);
+  EXPECT_EQ(0, h.spool()->waiting());
+  ASSERT_EQ(3u, h.start_msg_streams.size());
+  EXPECT_TRUE(h.start_msg_streams[1] == NULL);  // Spooled: no connection.
+}
+
+TEST(JobSpool, RejectWhenFull) {
+  SpoolHarness h(1);
+  Connection first, second, third;
+  ASSERT_TRUE(h.Submit(&first));
+  ASSERT_TRUE(h.Submit(&second));
+  FILE *msg = third.msg_stream();
+  EXPECT_FALSE(h.spool()->Submit(third.fd(), msg, "test"));
+  fclose(msg);
+  close(third.fd());
+}
+
+TEST(JobSpool, NoSpoolingWithoutRoom) {
+  SpoolHarness h(0);
+  Connection first, second;
+  ASSERT_TRUE(h.Submit(&first));
+  FILE *msg = second.msg_stream();
+  EXPECT_FALSE(h.spool()->Submit(second.fd(), msg, "test"));
+  fclose(msg);
+  close(second.fd());
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -30,32 +30,24 @@ static const char *skip_white(const char *line) {
   return line;
 }
 
-class SimpleLexerBase::Node {
-public:
-  Node() : value(0) {
-    memset(&next_character, 0, 256*sizeof(Node*));
-  }
-
-  Node *next_character[256];
-  int value;
-};
-
-SimpleLexerBase::SimpleLexerBase() : root_(new Node()) {
+SimpleLexerBase::SimpleLexerBase() {
+  BuildTable();
 }
 
-SimpleLexerBase::~SimpleLexerBase() {
-  for (size_t i = 0; i < to_delete_.size(); ++i) {
-    delete to_delete_[i];
-  }
-  delete root_;
-}
+SimpleLexerBase::~SimpleLexerBase() {}
 
 void SimpleLexerBase::AddKeywordIntValue(const char *keyword, int value) {
   assert(value > 0);
-  AddKeywordAtNode(root_, keyword, value);
+  std::string upper;
+  for (const char *c = keyword; *c; ++c) {
+    assert(!isspace(*c));  // Keywords cannot have spaces.
+    upper.push_back(toupper(*c));
+  }
+  keywords_.push_back(std::make_pair(upper, value));
   if (keyword_mappings_.find(value) == keyword_mappings_.end()) {
     keyword_mappings_[value] = keyword;
   }
+  BuildTable();  // Only a handful of keywords, all added in the beginning.
 }
 
 const char *SimpleLexerBase::ReverseMapToString(int value) {
@@ -66,32 +58,50 @@ const char *SimpleLexerBase::ReverseMapToString(int value) {
   return found->second;
 }
 
-void SimpleLexerBase::AddKeywordAtNode(Node *node, const char *keyword,
-                                       int value) {
-  if (*keyword == '\0') {
-    assert(node->value == 0);  // otherwise, the same keyword is already there.
-    node->value = value;
-  } else {
-    assert(!isspace(*keyword));  // Keywords cannot have spaces.
-    const int up = toupper(*keyword);
-    if (node->next_character[up] == NULL) {
-      node->next_character[up] = new Node();
-      to_delete_.push_back(node->next_character[up]);
+void SimpleLexerBase::BuildTable() {
+  memset(char_class_, 0, sizeof(char_class_));
+  num_classes_ = 1;
+  for (const auto &keyword : keywords_) {
+    for (const char c : keyword.first) {
+      const uint8_t up = c;
+      if (char_class_[up] != 0) continue;
+      char_class_[up] = num_classes_;
+      char_class_[(uint8_t) tolower(up)] = num_classes_;
+      ++num_classes_;
+    }
+  }
+
+  transitions_.assign(num_classes_, 0);   // Start state.
+  state_value_.assign(1, 0);
+  for (const auto &keyword : keywords_) {
+    int state = 0;
+    for (const char c : keyword.first) {
+      uint16_t *next = &transitions_[state * num_classes_
+                                     + char_class_[(uint8_t) c]];
+      if (*next == 0) {
+        *next = state_value_.size();
+        state_value_.push_back(0);
+        transitions_.resize(transitions_.size() + num_classes_, 0);
+        // The resize might have moved the table.
+        next = &transitions_[state * num_classes_ + char_class_[(uint8_t) c]];
+      }
+      state = *next;
     }
-    AddKeywordAtNode(node->next_character[up], keyword + 1, value);
+    assert(state_value_[state] == 0);  // otherwise, keyword already there.
+    state_value_[state] = keyword.second;
   }
 }
 
-int SimpleLexerBase::ConsumeKeyword(const char **input) {
+int SimpleLexerBase::ConsumeKeyword(const char **input) const {
   int result = 0;
-  const char *word = *input;
-  word = skip_white(word);
-  for (const Node *node = root_; node; ++word) {
-    if (node->value > 0) {
+  const char *word = skip_white(*input);
+  for (int state = 0; /**/; ++word) {
+    if (state_value_[state] > 0) {
       *input = skip_white(word);
-      result = node->value;
+      result = state_value_[state];
     }
-    node = node->next_character[toupper(*word)];
+    state = transitions_[state * num_classes_ + char_class_[(uint8_t) *word]];
+    if (state == 0) break;
   }
   return result;
 }
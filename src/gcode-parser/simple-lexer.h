@@ -16,7 +16,10 @@
  * You should have received a copy of the GNU General Public License
  * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <stdint.h>
+
 #include <map>
+#include <string>
 #include <vector>
 
 class SimpleLexerBase {
@@ -28,20 +31,27 @@ protected:
   // Add a keyword and the corresponding value it should be associated with.
   // "value" needs to be > 0.
   void AddKeywordIntValue(const char *keyword, int value);
-  int ConsumeKeyword(const char **input);
+  int ConsumeKeyword(const char **input) const;
   const char *ReverseMapToString(int value);
 
 private:
-  class Node;
   typedef std::map<int, const char*> KeywordMap;
 
-  void AddKeywordAtNode(Node *node, const char *keyword, int value);
+  void BuildTable();
 
-  Node *root_;
-  std::vector<Node*> to_delete_;
+  // All keywords, upper case, with their value.
+  std::vector<std::pair<std::string, int> > keywords_;
   KeywordMap keyword_mappings_;
-};
 
+  // The keywords as state machine: each character that appears in any
+  // keyword has a class > 0, the same for upper and lower case; all others
+  // are class 0. The row of a state has the next state for each class, with
+  // 0 meaning there is none (the start state can't be reached again).
+  uint8_t char_class_[256];
+  int num_classes_;
+  std::vector<uint16_t> transitions_;  // num states * num_classes_
+  std::vector<int> state_value_;       // Keyword value at each state or 0.
+};
 // A simple keyword matcher that can deal with ambiguous prefixes
 // (e.g. '<' and '<=').
 // It is matching keywords and maps it to a particular enumeration.
@@ -67,12 +77,12 @@ public:
   // The "input" pointer is modified to point to the first non-whitespace
   // character after the matched keyword on success.
   // Returns value of matched keyword or 0 if there was no match.
-  Enum MatchNext(const char **input) {
+  Enum MatchNext(const char **input) const {
     return static_cast<Enum>(ConsumeKeyword(input));
   }
 
   // Expect and consume a particular keyword, otherwise return false.
-  bool ExpectNext(const char **input, Enum e) {
+  bool ExpectNext(const char **input, Enum e) const {
     const char *end = *input;
     if (MatchNext(&end) == e) {
       *input = end;
@@ -80,6 +80,22 @@ TEST(SimpleLexerTest, ParserEatsWhitespaceAround) {
     EXPECT_EQ(std::string("nextthing"), word);
 }
 
+TEST(SimpleLexerTest, CaseInsensitive) {
+    SimpleLexer<MyKeywords> lexer;
+    lexer.AddKeyword("Else",   KEYWORD_ELSE);
+    lexer.AddKeyword("ELSEIF", KEYWORD_ELSEIF);
+    lexer.AddKeyword("if",     KEYWORD_IF);
+
+    const char *word = "eLsE";
+    EXPECT_EQ(KEYWORD_ELSE, lexer.MatchNext(&word));
+    word = "elseIF x";
+    EXPECT_EQ(KEYWORD_ELSEIF, lexer.MatchNext(&word));
+    EXPECT_EQ(std::string("x"), word);
+    word = "IFfy";
+    EXPECT_EQ(KEYWORD_IF, lexer.MatchNext(&word));
+    EXPECT_EQ(std::string("fy"), word);
+}
+
 TEST(SimpleLexerTest, ReverseMapping) {
     SimpleLexer<MyKeywords> lexer;
     // Alternative keywords for the same enum value. The first is remembered
@@ -26,6 +26,12 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "common/logging.h"
 
 #include "determine-print-stats.h"
@@ -35,54 +41,168 @@
 int usage(const char *prog) {
   fprintf(stderr, "Usage: %s [options] <gcode-file> [<gcode-file> ..]\n"
           "Options:\n"
-          "\t-c <config>       : Machine config\n"
+          "\t-c <config>       : Machine config. Can be given multiple times\n"
+          "\t                    to estimate for several machines at once.\n"
           "\t-f <factor>       : Speedup-factor for feedrate.\n"
+          "\t-j <jobs>         : Number of files to process in parallel;\n"
+          "\t                    0 for one per CPU core. Default 1.\n"
+          "\t-o <format>       : Output format: table (default), csv, json.\n"
           "\t-H                : Toggle print header line\n"
           "Use filename '-' for stdin.\n", prog);
   return 1;
 }
 
-static void print_file_stats(const char *filename, int indentation,
-                             FILE *msg_out,
-                             const MachineControlConfig &config) {
-  struct BeagleGPrintStats result;
+enum OutputFormat { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON };
+
+// Results of one file for all configurations.
+struct FileStats {
+  bool success = false;
+  std::vector<BeagleGPrintStats> results;
+};
+
+// Each file gets its own parser and machines; only the configurations are
+// shared, which are only read.
+static void estimate_file_stats(const char *filename, FILE *msg_out,
+                                const std::vector<const MachineControlConfig*> &configs,
+                                FileStats *stats) {
+  const int count = configs.size();
+  stats->results.resize(count);
   int fd = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY);
-  if (determine_print_stats(fd, config, msg_out, &result)) {
+  if (fd < 0) return;
+  stats->success = estimate_print_stats(fd, configs.data(), count, msg_out,
+                                        stats->results.data());
+}
+
+static void print_header(OutputFormat format, int indentation,
+                         bool with_config) {
+  switch (format) {
+  case FORMAT_TABLE:
+    printf("%-*s ", indentation, "#[filename]");
+    if (with_config) printf("%-20s ", "config");
+    printf("%10s %7s %7s %7s %7s %7s %7s %7s %7s\n", "time",
+           "min_x", "max_x", "min_y", "max_y", "min_z", "max_z",
+           "z-last", "filament-mm");
+    break;
+  case FORMAT_CSV:
+    printf("filename,%stime,min_x,max_x,min_y,max_y,min_z,max_z,"
+           "z-last,filament-mm\n", with_config ? "config," : "");
+    break;
+  case FORMAT_JSON:
+    break;
+  }
+}
+
+// File and config names as CSV or JSON string. CSV doubles the quotes,
+// JSON escapes them.
+static std::string quoted(const char *str, OutputFormat format) {
+  std::string result = "\"";
+  for (const char *c = str; *c; ++c) {
+    if (*c == '"') result.push_back(format == FORMAT_JSON ? '\\' : '"');
+    else if (*c == '\\' && format == FORMAT_JSON) result.push_back('\\');
+    result.push_back(*c);
+  }
+  result.push_back('"');
+  return result;
+}
+
+static void print_file_stats(const char *filename, int indentation,
+                             OutputFormat format,
+                             const std::vector<const char*> &config_names,
+                             const FileStats &stats) {
+  const int count = stats.results.size();
+  if (!stats.success) {
+    switch (format) {
+    case FORMAT_TABLE:
+      printf("#%s not-processed\n", filename);
+      break;
+    case FORMAT_CSV:       // Empty values.
+      printf("%s,%s,,,,,,,,\n", quoted(filename, format).c_str(),
+             count > 1 ? "," : "");
+      break;
+    case FORMAT_JSON:
+      printf("{\"filename\":%s, \"processed\":false}\n",
+             quoted(filename, format).c_str());
+      break;
+    }
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    const BeagleGPrintStats &result = stats.results[i];
     // Filament length looks a bit high, is this input or extruded ?
-    printf("%-*s %10.0f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f",
-           indentation, filename,
-           result.total_time_seconds,
-           result.x_min, result.x_max,
-           result.y_min, result.y_max,
-           result.z_min, result.z_max,
-           result.last_z_extruding,
-           result.filament_len);
-    printf("\n");
-  } else {
-    printf("#%s not-processed\n", filename);
+    switch (format) {
+    case FORMAT_TABLE:
+      printf("%-*s ", indentation, filename);
+      if (count > 1) printf("%-20s ", config_names[i]);
+      printf("%10.0f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f %7.1f\n",
+             result.total_time_seconds,
+             result.x_min, result.x_max,
+             result.y_min, result.y_max,
+             result.z_min, result.z_max,
+             result.last_z_extruding,
+             result.filament_len);
+      break;
+    case FORMAT_CSV:
+      printf("%s,", quoted(filename, format).c_str());
+      if (count > 1) printf("%s,", quoted(config_names[i], format).c_str());
+      printf("%.0f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+             result.total_time_seconds,
+             result.x_min, result.x_max,
+             result.y_min, result.y_max,
+             result.z_min, result.z_max,
+             result.last_z_extruding,
+             result.filament_len);
+      break;
+    case FORMAT_JSON:
+      // One object per line, so that it can be read while it is written.
+      printf("{\"filename\":%s, ", quoted(filename, format).c_str());
+      if (count > 1) printf("\"config\":%s, ",
+                            quoted(config_names[i], format).c_str());
+      printf("\"processed\":true, \"time\":%.0f, "
+             "\"min_x\":%.1f, \"max_x\":%.1f, "
+             "\"min_y\":%.1f, \"max_y\":%.1f, "
+             "\"min_z\":%.1f, \"max_z\":%.1f, "
+             "\"z_last\":%.1f, \"filament_mm\":%.1f}\n",
+             result.total_time_seconds,
+             result.x_min, result.x_max,
+             result.y_min, result.y_max,
+             result.z_min, result.z_max,
+             result.last_z_extruding,
+             result.filament_len);
+      break;
+    }
   }
 }
 
 int main(int argc, char *argv[]) {
-  struct MachineControlConfig config;
-
   float factor = 1.0;        // print speed factor.
-  char print_header = 1;
-  const char *config_file = NULL;
+  char with_header = 1;
+  int jobs = 1;
+  OutputFormat format = FORMAT_TABLE;
+  std::vector<const char*> config_files;
   const char *msg_out_file = "/dev/null";
 
   int opt;
-  while ((opt = getopt(argc, argv, "c:f:Hv")) != -1) {
+  while ((opt = getopt(argc, argv, "c:f:j:o:Hv")) != -1) {
     switch (opt) {
     case 'c':
-      config_file = strdup(optarg);
+      config_files.push_back(strdup(optarg));
       break;
     case 'f':
       factor = (float)atof(optarg);
       if (factor <= 0) return usage(argv[0]);
       break;
+    case 'j':
+      jobs = atoi(optarg);
+      if (jobs < 0) return usage(argv[0]);
+      break;
+    case 'o':
+      if (strcmp(optarg, "table") == 0) format = FORMAT_TABLE;
+      else if (strcmp(optarg, "csv") == 0) format = FORMAT_CSV;
+      else if (strcmp(optarg, "json") == 0) format = FORMAT_JSON;
+      else return usage(argv[0]);
+      break;
     case 'H':
-      print_header = !print_header;
+      with_header = !with_header;
       break;
     case 'v':
       msg_out_file = "/dev/stderr";
@@ -95,7 +215,7 @@ int main(int argc, char *argv[]) {
   if (optind >= argc)
     return usage(argv[0]);
 
-  if (!config_file) {
+  if (config_files.empty()) {
     fprintf(stderr, "Expected config file -c <config>\n");
     return 1;
   }
@@ -103,23 +223,29 @@ int main(int argc, char *argv[]) {
   FILE *msg_out = fopen(msg_out_file, "w");
   Log_init("/dev/null");
 
-  ConfigParser config_parser;
-  if (!config_parser.SetContentFromFile(config_file)) {
-    fprintf(stderr, "Cannot read config file '%s'\n", config_file);
-    return 1;
-  }
-  if (!config.ConfigureFromFile(&config_parser)) {
-    fprintf(stderr, "Exiting. Parse error in configuration file '%s'\n", config_file);
-    return 1;
-  }
+  std::vector<const MachineControlConfig*> configs;
+  for (const char *config_file : config_files) {
+    ConfigParser config_parser;
+    if (!config_parser.SetContentFromFile(config_file)) {
+      fprintf(stderr, "Cannot read config file '%s'\n", config_file);
+      return 1;
+    }
+    MachineControlConfig *config = new MachineControlConfig();
+    if (!config->ConfigureFromFile(&config_parser)) {
+      fprintf(stderr, "Exiting. Parse error in configuration file '%s'\n",
+              config_file);
+      return 1;
+    }
 
-  config.speed_factor = factor;
-  config.range_check = false;  // don't care about clipping.
+    config->speed_factor = factor;
+    config->range_check = false;  // don't care about clipping.
 
-  // This is not connected to any machine. Don't assume homing.
-  config.require_homing = false;
-  for (int i = 0; i < GCODE_NUM_AXES; ++i) {
-    config.homing_trigger[i] = HardwareMapping::TRIGGER_NONE;
+    // This is not connected to any machine. Don't assume homing.
+    config->require_homing = false;
+    for (int i = 0; i < GCODE_NUM_AXES; ++i) {
+      config->homing_trigger[i] = HardwareMapping::TRIGGER_NONE;
+    }
+    configs.push_back(config);
   }
 
   int longest_filename = strlen("#[filename]"); // table header
@@ -127,15 +253,39 @@ int main(int argc, char *argv[]) {
     int len = strlen(argv[i]);
     if (len > longest_filename) longest_filename = len;
   }
-  if (print_header) {
-    printf("%-*s %10s %7s %7s %7s %7s %7s %7s %7s %7s\n", longest_filename,
-           "#[filename]", "time",
-           "min_x", "max_x", "min_y", "max_y", "min_z", "max_z",
-           "z-last", "filament-mm");
+  if (with_header) {
+    print_header(format, longest_filename, configs.size() > 1);
   }
-  for (int i = optind; i < argc; ++i) {
-    print_file_stats(argv[i], longest_filename, msg_out, config);
+
+  // Workers take the next file until all are done. The output is in the
+  // order of the files given, independent of the order they finish.
+  const int file_count = argc - optind;
+  if (jobs == 0) jobs = std::max(1u, std::thread::hardware_concurrency());
+  jobs = std::min(jobs, file_count);
+  std::vector<FileStats> stats(file_count);
+  if (jobs <= 1) {
+    // Print as we go.
+    for (int i = 0; i < file_count; ++i) {
+      estimate_file_stats(argv[optind + i], msg_out, configs, &stats[i]);
+      print_file_stats(argv[optind + i], longest_filename, format,
+                       config_files, stats[i]);
+    }
+  } else {
+    std::atomic<int> next_file(0);
+    auto worker = [&]() {
+      for (int i; (i = next_file++) < file_count; /**/) {
+        estimate_file_stats(argv[optind + i], msg_out, configs, &stats[i]);
+      }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 0; t < jobs; ++t) workers.emplace_back(worker);
+    for (std::thread &t : workers) t.join();
+    for (int i = 0; i < file_count; ++i) {
+      print_file_stats(argv[optind + i], longest_filename, format,
+                       config_files, stats[i]);
+    }
   }
   fclose(msg_out);
+  for (const MachineControlConfig *config : configs) delete config;
   return 0;
 }
@@ -54,6 +54,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -61,8 +62,11 @@
 #include <algorithm>
 #include <complex>
 #include <functional>
+#include <thread>
 
 #include "common/logging.h"
+#include "common/string-util.h"
+#include "gcode-parser/compiled-gcode.h"
 #include "gcode-parser/gcode-parser.h"
 
 #include "motion-queue.h"
@@ -131,6 +135,87 @@ enum class ProcessingStep {
   GenerateOutput
 };
 
+// Level of detail: merges consecutive lineto3d that deviate less than the
+// tolerance (the size of something barely visible on the page) from a
+// straight line. Each point comes with the PostScript text to draw it; only
+// the text of the last point of a merged line is printed.
+// Everything else printed to the file needs to Flush() first.
+class PathSimplifier {
+public:
+  explicit PathSimplifier(FILE *file) : file_(file) {}
+
+  // Tolerance in mm. Zero switches off merging.
+  void SetTolerance(float tolerance) { tolerance_ = tolerance; }
+  void SetOutput(FILE *file) { file_ = file; }
+
+  // New start of the path, e.g. after a moveto3d.
+  void MoveTo(float x, float y, float z) {
+    Flush();
+    anchor_[0] = x; anchor_[1] = y; anchor_[2] = z;
+    have_anchor_ = true;
+  }
+
+  void LineTo(float x, float y, float z, const std::string &text) {
+    const float p[3] = { x, y, z };
+    if (tolerance_ <= 0 || !have_anchor_) {
+      fputs(text.c_str(), file_);
+      MoveTo(x, y, z);
+      return;
+    }
+    if (pending_count_ > 0 && !CanReach(p)) {
+      Flush();
+    }
+    if (pending_count_ == kMaxPendingPoints) {
+      Flush();
+    }
+    memcpy(pending_[pending_count_++], p, sizeof(p));
+    pending_text_ = text;
+  }
+
+  // Print the pending line end.
+  void Flush() {
+    if (pending_count_ == 0) return;
+    fputs(pending_text_.c_str(), file_);
+    memcpy(anchor_, pending_[pending_count_ - 1], sizeof(anchor_));
+    pending_count_ = 0;
+  }
+
+private:
+  enum { kMaxPendingPoints = 256 };
+
+  // Would a line from the anchor to p pass all pending points closely enough?
+  bool CanReach(const float p[3]) const {
+    float d[3];
+    float len2 = 0;
+    for (int i = 0; i < 3; ++i) {
+      d[i] = p[i] - anchor_[i];
+      len2 += d[i] * d[i];
+    }
+    for (int n = 0; n < pending_count_; ++n) {
+      float t = 0;
+      if (len2 > 0) {
+        for (int i = 0; i < 3; ++i) t += (pending_[n][i] - anchor_[i]) * d[i];
+        t = std::max(0.0f, std::min(1.0f, t / len2));
+      }
+      float dist2 = 0;
+      for (int i = 0; i < 3; ++i) {
+        const float e = pending_[n][i] - (anchor_[i] + t * d[i]);
+        dist2 += e * e;
+      }
+      if (dist2 > tolerance_ * tolerance_) return false;
+    }
+    return true;
+  }
+
+  FILE *file_;
+  float tolerance_ = 0;
+  bool have_anchor_ = false;
+  float anchor_[3];
+  float pending_[kMaxPendingPoints][3];
+  int pending_count_ = 0;
+  std::string pending_text_;
+};
+
 // Simple gcode visualizer. Takes the gcode and shows its range.
 // Takes two passes: first determines the bounding box to show axes, second
 // draws within these.
@@ -140,7 +225,7 @@ public:
                        const AxesRegister &move_range,
                        const VisualizationOptions &options)
     : file_(file), machine_origin_(machine_origin),
-      opts_(options) {
+      opts_(options), path_(file) {
     if (!opts_.include_machine_bounding_box) {
       // Make sure that we capture the true ranges of things.
       // TODO: we can use this later to determine if such axis was used,
@@ -158,6 +243,16 @@ public:
   // Pass 1 - preparation, pass 2 - writing.
   void SetPass(ProcessingStep p) { pass_ = p; }
 
+  // Change where the output goes to.
+  void SetOutput(FILE *file) {
+    path_.Flush();
+    file_ = file;
+    path_.SetOutput(file);
+  }
+
+  // Merge path segments that deviate less than this many mm.
+  void SetDetailTolerance(float mm) { path_.SetTolerance(mm); }
+
   void set_speed_factor(float f) final {}
   void set_temperature(float f) final {}
   void set_fanspeed(float speed) final {}
@@ -165,6 +260,8 @@ public:
   void motors_enable(bool b) final {}
   void go_home(AxisBitmap_t axes) final {
     if (pass_ == ProcessingStep::GenerateOutput) {
+      path_.MoveTo(machine_origin_[AXIS_X], machine_origin_[AXIS_Y],
+                   machine_origin_[AXIS_Z]);
       fprintf(file_, "%f %f %f moveto3d  %% G28\n",
               machine_origin_[AXIS_X], machine_origin_[AXIS_Y],
               machine_origin_[AXIS_Z]);
@@ -173,7 +270,9 @@ public:
     just_homed_ = true;
   }
   void inform_origin_offset(const AxesRegister& axes, const char *n) final {
-    if (pass_ == ProcessingStep::GenerateOutput) {
+    // The initial origin, set up before the program starts, is not shown.
+    if (pass_ == ProcessingStep::GenerateOutput && in_program_) {
+      path_.Flush();
       ShowNamedOrigin(axes, n);
 #if 0
     // Should we print an origin marker here ?
@@ -202,6 +301,7 @@ public:
       RememberMinMax(axes);
     } else {
       if (rapid != last_move_rapid_) {
+        path_.Flush();
         fprintf(file_, "%s switch-color %.3f setlinewidth %% %s move\n",
                 rapid ? kGcodeRapidMoveColor : kGcodeMoveColor,
                 rapid ? 0.0 : GetDiagonalLength() / 1000.0,
@@ -214,12 +314,19 @@ public:
           && laser_intensity_ != last_laser_intensity_) {
         const float scaled_intensity = (laser_intensity_ - laser_min_)
           / (laser_max_ - laser_min_);
+        path_.Flush();
         fprintf(file_, "%.2f setgray ", 1 - scaled_intensity);
         last_laser_intensity_ = laser_intensity_;
       }
-      fprintf(file_, "%.3f %.3f %.3f %s\n",
-              axes[AXIS_X], axes[AXIS_Y], axes[AXIS_Z],
-              not_show_after_home ? "moveto3d % post-G28" : "lineto3ds");
+      if (not_show_after_home) {
+        path_.MoveTo(axes[AXIS_X], axes[AXIS_Y], axes[AXIS_Z]);
+        fprintf(file_, "%.3f %.3f %.3f moveto3d %% post-G28\n",
+                axes[AXIS_X], axes[AXIS_Y], axes[AXIS_Z]);
+      } else {
+        path_.LineTo(axes[AXIS_X], axes[AXIS_Y], axes[AXIS_Z],
+                     StringPrintf("%.3f %.3f %.3f lineto3ds\n",
+                                  axes[AXIS_X], axes[AXIS_Y], axes[AXIS_Z]));
+      }
       if (opts_.output_js_vertices)
         fprintf(stdout, " [%.3f, %.3f, %.3f, %s],\n",   // ThreeJS
                 axes[AXIS_X], axes[AXIS_Y], axes[AXIS_Z],
@@ -236,6 +343,7 @@ public:
                 const AxesRegister &end) final {
     if (pass_ == ProcessingStep::GenerateOutput && opts_.show_ijk) {
       const float line_size = GetDiagonalLength() / 500.0;
+      path_.Flush();
       fprintf(file_,
               "stroke currentpoint3d\n"  // remember for after the place
               "currentpoint3d gsave moveto3d\n\t "   // save restore
@@ -258,6 +366,7 @@ public:
                    const AxesRegister &end) final {
     if (pass_ == ProcessingStep::GenerateOutput && opts_.show_ijk) {
       const float line_size = GetDiagonalLength() / 500.0;
+      path_.Flush();
       fprintf(file_,
               "stroke currentpoint3d\n"  // remember for after the place
               "currentpoint3d gsave moveto3d\n\t "   // save restore
@@ -300,12 +409,15 @@ public:
   }
 
   void gcode_start(GCodeParser *parser) final {
+    in_program_ = true;
     if (pass_ == ProcessingStep::GenerateOutput) {
       fprintf(file_, "\n%% -- Path generated from GCode.\n");
       fprintf(file_, "%.3f setlinewidth 0 0 0 setrgbcolor\n",
               GetDiagonalLength() / 1000.0);
 
       if (opts_.include_machine_origin) {
+        path_.MoveTo(machine_origin_[AXIS_X], machine_origin_[AXIS_Y],
+                     machine_origin_[AXIS_Z]);
         fprintf(file_, "%f %f %f moveto3d  %% Machine origin but not homed.\n",
                 machine_origin_[AXIS_X], machine_origin_[AXIS_Y],
                 machine_origin_[AXIS_Z]);
@@ -318,12 +430,14 @@ public:
   }
 
   void gcode_finished(bool end_of_stream) final {
+    in_program_ = false;
     if (pass_ == ProcessingStep::Preprocess) {
       if (min_[AXIS_X] > max_[AXIS_X]) min_[AXIS_X] = max_[AXIS_X] = 0;
       if (min_[AXIS_Y] > max_[AXIS_Y]) min_[AXIS_Y] = max_[AXIS_Y] = 0;
       if (min_[AXIS_Z] > max_[AXIS_Z]) min_[AXIS_Z] = max_[AXIS_Z] = 0;
     }
     if (pass_ == ProcessingStep::GenerateOutput && end_of_stream) {
+      path_.Flush();
       fprintf(file_, "stroke\n");
       fprintf(file_, "%% -- Finished GCode Path.\n");
 
@@ -358,19 +472,19 @@ public:
     draw(false, width, -size); draw(true, width, size);  // second tick.
     const char *fmt = show_metric ? kMillimeterUnitFormat : kInchUnitFormat;
     std::string measure = StringPrintf(fmt, show_metric ? width : width / 25.4);
-    DrawText(measure, width/2, -size, TextAlign::kCenter, size, draw);
+    text_.Draw(measure, width/2, -size, TextAlign::kCenter, size, draw);
     // For the small start/end markers, don't include the unit for compatness.
     fmt = show_metric ? kMillimeterFormat : kInchFormat;
     measure = StringPrintf(fmt, show_metric ? min : min / 25.4);
-    DrawText(measure, 0, size/10, TextAlign::kCenter, size * 0.6,
-               [draw, size](bool d, float x, float y) {
-                draw(d, -y, x);
-              });
+    text_.Draw(measure, 0, size/10, TextAlign::kCenter, size * 0.6,
+                 [draw, size](bool d, float x, float y) {
+                  draw(d, -y, x);
+                });
     measure = StringPrintf(fmt, show_metric ? max : max / 25.4);
-    DrawText(measure, 0, 0, TextAlign::kCenter, size * 0.6,
-              [draw, size, width](bool d, float x, float y) {
-                draw(d, width-y+0.6*size, x);
-              });
+    text_.Draw(measure, 0, 0, TextAlign::kCenter, size * 0.6,
+                [draw, size, width](bool d, float x, float y) {
+                  draw(d, width-y+0.6*size, x);
+                });
   }
 
   void PrintHeader(float margin, float eye_distance, int animation_frames) {
@@ -537,8 +651,8 @@ public:
       const float max_x_space = (max_[AXIS_X] - min_[AXIS_X]) - 2*size;
       if (text_width > max_x_space)
         text_size *= max_x_space / text_width;
-      DrawText(opts_.show_title, size, 0.3*size,
-               TextAlign::kLeft, text_size, x_xy_draw);
+      text_.Draw(opts_.show_title, size, 0.3*size,
+                 TextAlign::kLeft, text_size, x_xy_draw);
       fprintf(file_, "stroke\n");
     }
     fprintf(file_, "0.8 0 0 setrgbcolor               %% X-axis\n");
@@ -556,12 +670,12 @@ public:
     fprintf(file_, "currentpoint3d stroke gsave "
             "%s setrgbcolor 0 setlinewidth ",
             kGcodeOriginTextColor);
-    DrawText(named, 0, size, TextAlign::kCenter, 1.5*size,
-             [this, origin](bool d, float x, float y) {
-               fprintf(file_, "%.3f %.3f %.3f %s\n",
-                       origin[AXIS_X] + x, origin[AXIS_Y] + y, origin[AXIS_Z],
-                       d ? "lineto3d" : "moveto3d");
-             });
+    text_.Draw(named, 0, size, TextAlign::kCenter, 1.5*size,
+               [this, origin](bool d, float x, float y) {
+                 fprintf(file_, "%.3f %.3f %.3f %s\n",
+                         origin[AXIS_X] + x, origin[AXIS_Y] + y, origin[AXIS_Z],
+                         d ? "lineto3d" : "moveto3d");
+               });
     fprintf(file_, "stroke %s setrgbcolor\n", kGcodeOriginMarkColor);
     const float x = origin[AXIS_X];
     const float y = origin[AXIS_Y];
@@ -603,8 +717,9 @@ public:
     fprintf(file_, "grestore moveto3d\n");
   }
 
-  void PrintPostscriptBoundingBox(float margin_x, float margin_y, float scale,
-                                  float boundingbox_width) {
+  // Returns the scale used, i.e. the size on the page in mm of one mm.
+  float PrintPostscriptBoundingBox(float margin_x, float margin_y, float scale,
+                                   float boundingbox_width) {
     // gs is notoriously bad in dealing with negative origin of the bounding
     // box, so move everything up with the translation box.
     const float range = 1.05 * GetDiagonalLength();
@@ -620,6 +735,7 @@ public:
             "72 25.4 div dup scale %.3f dup scale} def\n",
             ToPoint(scale * (range+margin_x)/2),
             ToPoint(scale * (range+margin_y)/2), scale);
+    return scale;
   }
 
 private:
@@ -636,7 +752,7 @@ private:
     return roundf(mm / 25.4 * 72);
   }
 
-  FILE *const file_;
+  FILE *file_;
   const AxesRegister machine_origin_;
   const VisualizationOptions opts_;
 
@@ -646,8 +762,11 @@ private:
   float last_laser_intensity_ = 1.0;
   bool last_move_rapid_ = false;
   bool just_homed_ = true;
+  bool in_program_ = false;
 
   float laser_min_ = 1e6, laser_max_ = -1e6;
+  PathSimplifier path_;
+  TextRenderer text_;  // Axis labels are drawn in the same few sizes.
   AxesRegister min_;
   AxesRegister max_;
   ProcessingStep pass_ = ProcessingStep::Init;
@@ -663,7 +782,7 @@ class MotorOperationsPrinter : public MotorOperations {
 public:
   MotorOperationsPrinter(FILE *file, const MachineControlConfig &config,
                          float tool_dia, const VisualizationOptions &options)
-    : file_(file), config_(config), opts_(options) {
+    : file_(file), config_(config), opts_(options), path_(file) {
     fprintf(file_, "\n%% -- Machine path. %s\n",
             opts_.show_speeds ? "Visualizing travel speeds" : "Simple.");
     fprintf(file_, "%% Note, larger tool diameters slow down "
@@ -672,6 +791,7 @@ public:
 
     fprintf(file_, "tool-diameter setlinewidth\n");
     fprintf(file_, "0 0 0 moveto3d\n");
+    path_.MoveTo(0, 0, 0);
     if (!opts_.show_speeds) {
       fprintf(file_, "%s setrgbcolor\n", kMachineMoveColor);
     }
@@ -687,6 +807,7 @@ public:
   }
 
   ~MotorOperationsPrinter() {
+    path_.Flush();
     fprintf(file_, "stroke\n%% -- Finished Machine Path.\n");
   }
 
@@ -755,6 +876,9 @@ public:
     color_segment_length_ = length;
   }
 
+  // Merge path segments that deviate less than this many mm.
+  void SetDetailTolerance(float mm) { path_.SetTolerance(mm); }
+
   // Try to highlight if we are outside of coordinate system.
   bool inRange(int machine_pos, GCodeParserAxis axis) const {
     if (machine_pos < 0) return false;
@@ -828,34 +952,40 @@ public:
           new_color = kOutOfRangeColor;
         }
         if (new_color) {
+          path_.Flush();
           fprintf(file_, "%s switch-color ", new_color);
         }
 #define TO_ABS_AXIS(a) (float(current_pos_[a]) + \
               float((i+1)*param.steps[a])/segments) / config_.steps_per_mm[a]
-
-        fprintf(file_, "%.3f %.3f %.3f lineto3d",
-                TO_ABS_AXIS(AXIS_X), TO_ABS_AXIS(AXIS_Y), TO_ABS_AXIS(AXIS_Z));
+        const float x = TO_ABS_AXIS(AXIS_X);
+        const float y = TO_ABS_AXIS(AXIS_Y);
+        const float z = TO_ABS_AXIS(AXIS_Z);
 #undef TO_ABS_AXIS
 
-        fprintf(file_, " %% %.1f mm/s [%s]", v,
-                param.v0 == param.v1 ? "=" : (param.v0 < param.v1 ? "^" : "v"));
+        std::string line = StringPrintf("%.3f %.3f %.3f lineto3d", x, y, z);
+        line += StringPrintf(" %% %.1f mm/s [%s]", v,
+                             param.v0 == param.v1
+                             ? "=" : (param.v0 < param.v1 ? "^" : "v"));
         if (i == 0)
-          fprintf(file_, " (%d,%d,%d)",
-                  param.steps[AXIS_X], param.steps[AXIS_Y], param.steps[AXIS_Z]);
-        fprintf(file_, "\n");
+          line += StringPrintf(" (%d,%d,%d)", param.steps[AXIS_X],
+                               param.steps[AXIS_Y], param.steps[AXIS_Z]);
+        line += "\n";
+        path_.LineTo(x, y, z, line);
       }
     } else {
       if (last_outside_machine_cube != is_valid_position) {
         // only print changes.
+        path_.Flush();
         fprintf(file_, "%s setrgbcolor ",
                 is_valid_position ? kMachineMoveColor : kOutOfRangeColor);
         last_outside_machine_cube = is_valid_position;
       }
-      fprintf(file_, "%f %f %f lineto3d %% %d %d %d\n",
-              new_pos[AXIS_X] / config_.steps_per_mm[AXIS_X],
-              new_pos[AXIS_Y] / config_.steps_per_mm[AXIS_Y],
-              new_pos[AXIS_Z] / config_.steps_per_mm[AXIS_Z],
-              new_pos[AXIS_X], new_pos[AXIS_Y], new_pos[AXIS_Z]);
+      const float x = new_pos[AXIS_X] / config_.steps_per_mm[AXIS_X];
+      const float y = new_pos[AXIS_Y] / config_.steps_per_mm[AXIS_Y];
+      const float z = new_pos[AXIS_Z] / config_.steps_per_mm[AXIS_Z];
+      path_.LineTo(x, y, z, StringPrintf("%f %f %f lineto3d %% %d %d %d\n",
+                                         x, y, z, new_pos[AXIS_X],
+                                         new_pos[AXIS_Y], new_pos[AXIS_Z]));
     }
 
     current_pos_ = new_pos;
@@ -872,14 +1002,17 @@ public:
   }
 
   void EmitMovetoPos() {
+    const float x = current_pos_[AXIS_X] / config_.steps_per_mm[AXIS_X];
+    const float y = current_pos_[AXIS_Y] / config_.steps_per_mm[AXIS_Y];
+    const float z = current_pos_[AXIS_Z] / config_.steps_per_mm[AXIS_Z];
+    path_.MoveTo(x, y, z);
     fprintf(file_, "%f %f %f moveto3d  %% Homing one or more axes.\n",
-            current_pos_[AXIS_X] / config_.steps_per_mm[AXIS_X],
-            current_pos_[AXIS_Y] / config_.steps_per_mm[AXIS_Y],
-            current_pos_[AXIS_Z] / config_.steps_per_mm[AXIS_Z]);
+            x, y, z);
   }
 
   void PrintColorLegend(float x, float y, float width) {
     assert(pass_ == ProcessingStep::GenerateOutput);
+    path_.Flush();
     if (min_color_range_ >= max_color_range_)
       return;
     const float barheight = 0.05 * width;
@@ -946,6 +1079,7 @@ private:
   float max_color_range_;
 
   bool last_outside_machine_cube = false;
+  PathSimplifier path_;
 
   MotorOperationsPrinter(const MotorOperationsPrinter &);
 };
@@ -985,6 +1119,10 @@ static int usage(const char *progname, bool description = false) {
           "showing rotation around vertical.\n"
           "\t-g<grid>          : Show grid on XY plane. Optional with 'in' unit suffix (default: mm).\n"
           "\t-C<caption>       : Caption text\n"
+          "\t-L<detail>        : Level of detail: merge path segments that "
+          "deviate less than\n"
+          "\t                    this many points on the page (e.g. 0.5). "
+          "Shrinks output of dense files.\n"
           "[---- Rotation. Multiple can be applied in sequence ----]\n"
           "\t-R<roll>          : Roll: Rotate around axis pointing towards and through canvas\n"
           "\t-P<roll>          : Pitch: Rotate around horizontal axis.\n"
@@ -1011,14 +1149,60 @@ G28
 M02)", nullptr); // M02 needs to be last.
 }
 
-static bool ParseFile(GCodeParser *parser, const char *filename,
-                      FILE *msg_stream) {
-  if (!parser->ReadFile(fopen(filename, "r"), msg_stream)) {
+// Output of the passes is collected in temporary files, so that they can
+// run in parallel; a large buffer keeps the many small writes cheap.
+static FILE *CreateBufferFile() {
+  FILE *result = tmpfile();
+  if (result) setvbuf(result, NULL, _IOFBF, 1 << 20);
+  return result;
+}
+
+static void AppendAndClose(FILE *buffer, FILE *out) {
+  char block[65536];
+  size_t len;
+  rewind(buffer);
+  while ((len = fread(block, 1, sizeof(block), buffer)) > 0) {
+    fwrite(block, 1, len, out);
+  }
+  fclose(buffer);
+}
+
+// Parse the file once into its compiled form (see compiled-gcode.h), which
+// all the passes then replay. Returns the file descriptor of the compiled
+// data or -1 on failure.
+static int CompileFile(const GCodeParser::Config &parser_cfg,
+                       const char *filename, FILE *msg_stream,
+                       int *error_count) {
+  FILE *in = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+  if (!in) {
     fprintf(stderr, "Cannot open %s\n", filename);
-    return false;
+    return -1;
   }
+  FILE *compiled = CreateBufferFile();
+  if (!compiled) {
+    fprintf(stderr, "Cannot create temporary file.\n");
+    return -1;
+  }
+  CompiledGCodeWriter writer(compiled);
+  GCodeParser parser(parser_cfg, &writer);
+  parser.ReadFile(in, msg_stream);  // Closes input.
+  *error_count = parser.error_count();
+  if (!writer.ok() || fflush(compiled) != 0) {
+    fprintf(stderr, "Cannot write temporary file.\n");
+    return -1;
+  }
+  return fileno(compiled);
+}
 
-  return true;
+// Send the compiled events to the receiver as if parsing the file. Can be
+// called from multiple threads at the same time.
+static void ReplayFile(int compiled_fd, GCodeParser *parser,
+                       GCodeParser::EventReceiver *receiver, FILE *msg_stream) {
+  CompiledGCodeReader reader;
+  if (!reader.Open(compiled_fd))
+    return;
+  while (reader.ReplayNext(parser, receiver, msg_stream)) {}
+  receiver->gcode_finished(true);
 }
 
 static bool ParseConfigIfAvailable(const char *config_file,
@@ -1103,9 +1287,10 @@ int main(int argc, char *argv[]) {
   int animation_frames = -1;
   bool quiet = false;
   float grid = -1;
+  float detail_points = 0;
 
   int opt;
-  while ((opt = getopt(argc, argv, "a:A:c:C:De:g:GilMo:P:qrR:sS:t:T:V:w:Y:")) != -1) {
+  while ((opt = getopt(argc, argv, "a:A:c:C:De:g:GiL:lMo:P:qrR:sS:t:T:V:w:Y:")) != -1) {
     switch (opt) {
     case 'o':
       out_filename = optarg;
@@ -1157,6 +1342,9 @@ int main(int argc, char *argv[]) {
         bounding_box_width_mm = bounding_box_width_mm / 72 * 25.4;
       }
       break;
+    case 'L':
+      detail_points = atof(optarg);
+      break;
     case 'e':
       eye_distance = atof(optarg);
       break;
@@ -1229,7 +1417,6 @@ int main(int argc, char *argv[]) {
 
   Log_init("/dev/null");
 
-  // TODO(hzeller): only parse the file once, so that we can read from stdin.
   const char *filename = argv[optind];
 
   GCodeParser::Config parser_cfg;
@@ -1243,19 +1430,91 @@ int main(int argc, char *argv[]) {
   GCodeParser::Config::ParamMap parameters;  // TODO: read from file ?
   parser_cfg.parameters = &parameters;
 
+  // The file is only parsed once. The passes below replay the result; the
+  // independent ones run in parallel: first the bounding box of the G-code
+  // and the speed range of the machine moves, then the output of both paths.
+  setvbuf(output_file, NULL, _IOFBF, 1 << 20);
+  int parse_errors = 0;
+  const int compiled_fd = CompileFile(parser_cfg, filename, msg_stream,
+                                      &parse_errors);
+  if (compiled_fd < 0)
+    return 1;
+
+  // The replays run in parallel; leftover text not precompiled is parsed
+  // at runtime and might set parameters, so each gets its own copy.
+  GCodeParser::Config::ParamMap viz_parameters = parameters;
+  GCodeParser::Config viz_cfg = parser_cfg;
+  viz_cfg.parameters = &viz_parameters;
+  GCodeParser::Config::ParamMap machine_parameters = parameters;
+  GCodeParser::Config machine_cfg = parser_cfg;
+  machine_cfg.parameters = &machine_parameters;
+
   GCodePrintVisualizer gcode_printer(output_file, parser_cfg.machine_origin,
                                      machine_config.move_range_mm,
                                      vis_options);
+  GCodeParser gcode_viz_parser(viz_cfg, &gcode_printer);
+
+  // We never initialize the hardware mapping from the config file, so
+  // we have a convenient mapping of gcode-axis == motor-number
+  // Non-initialized hardware mapping behaves like initialized
+  HardwareMapping hardware;
+  FILE *machine_out = nullptr;
+  MotorOperationsPrinter *motor_operations_printer = nullptr;
+  GCodeMachineControl *machine_control = nullptr;
+  GCodeParser *machine_parser = nullptr;
+  if (config_file && show_machine_path) {
+    machine_config.threshold_angle = threshold_angle;
+    machine_config.speed_tune_angle = speed_tune_angle;
+    machine_config.acknowledge_lines = false;
+    machine_config.range_check = range_check;
+
+    machine_out = CreateBufferFile();
+    motor_operations_printer = new MotorOperationsPrinter(
+      machine_out, machine_config, tool_diameter_mm, vis_options);
+    machine_control
+      = GCodeMachineControl::Create(machine_config, motor_operations_printer,
+                                    &hardware, nullptr, msg_stream);
+    if (!machine_control) {
+      // Ups, let's do it again with logging enabled to human-readably
+      // print anything that might hint what the problem is.
+      Log_init("/dev/stderr");
+      Log_error("Cannot initialize machine:");
+      GCodeMachineControl::Create(machine_config, motor_operations_printer,
+                                  &hardware, nullptr, stderr);
+    } else {
+      machine_control->SetMsgOut(NULL);
+      machine_parser = new GCodeParser(machine_cfg,
+                                       machine_control->ParseEventReceiver());
+    }
+  }
+
+  std::thread machine_pass;
+  if (machine_control) {
+    motor_operations_printer->SetPass(ProcessingStep::Preprocess);
+    machine_pass = std::thread(ReplayFile, compiled_fd, machine_parser,
+                               machine_control->ParseEventReceiver(),
+                               msg_stream);
+  }
   gcode_printer.SetPass(ProcessingStep::Preprocess);
-  GCodeParser gcode_viz_parser(parser_cfg, &gcode_printer);
-  ParseFile(&gcode_viz_parser, filename, msg_stream);
+  ReplayFile(compiled_fd, &gcode_viz_parser, &gcode_printer, msg_stream);
   Reset(&gcode_viz_parser, &gcode_printer);
+  if (machine_pass.joinable()) {
+    machine_pass.join();
+    Reset(machine_parser, nullptr);
+  }
 
-  gcode_printer.PrintPostscriptBoundingBox(
+  const float page_scale = gcode_printer.PrintPostscriptBoundingBox(
     printMargin,
     printMargin + (vis_options.show_speeds ? 15 : 0),
     scale, bounding_box_width_mm);
 
+  if (detail_points > 0) {
+    const float tolerance_mm = detail_points / 72 * 25.4 / page_scale;
+    gcode_printer.SetDetailTolerance(tolerance_mm);
+    if (motor_operations_printer)
+      motor_operations_printer->SetDetailTolerance(tolerance_mm);
+  }
+
   gcode_printer.PrintHeader(printMargin, eye_distance, animation_frames);
 
   if (animation_frames > 0) {
@@ -1278,61 +1537,45 @@ int main(int argc, char *argv[]) {
   if (grid > 0) gcode_printer.DrawGrid(grid);
   if (show_dimensions) gcode_printer.ShowMesaureLines();
 
-  if (config_file && show_machine_path) {
-    machine_config.threshold_angle = threshold_angle;
-    machine_config.speed_tune_angle = speed_tune_angle;
-    machine_config.acknowledge_lines = false;
-    machine_config.range_check = range_check;
-
-    // We never initialize the hardware mapping from the config file, so
-    // we have a convenient mapping of gcode-axis == motor-number
-    // Non-initialized hardware mapping behaves like initialized
-    HardwareMapping hardware;
-
-    MotorOperationsPrinter motor_operations_printer(
-      output_file, machine_config, tool_diameter_mm, vis_options);
-    GCodeMachineControl *machine_control
-      = GCodeMachineControl::Create(machine_config, &motor_operations_printer,
-                                    &hardware, nullptr, msg_stream);
-    if (!machine_control) {
-      // Ups, let's do it again with logging enabled to human-readably
-      // print anything that might hint what the problem is.
-      Log_init("/dev/stderr");
-      Log_error("Cannot initialize machine:");
-      GCodeMachineControl::Create(machine_config, &motor_operations_printer,
-                                  &hardware, nullptr, stderr);
-    } else {
-      machine_control->SetMsgOut(NULL);
-      motor_operations_printer.SetPass(ProcessingStep::Preprocess);
-      GCodeParser parser(parser_cfg, machine_control->ParseEventReceiver());
-      ParseFile(&parser, filename, msg_stream);
-      Reset(&parser, nullptr);
-
-      machine_control->SetMsgOut(msg_stream);
-      // The moves are segmented into colored segments. Don't make segments
-      // unnecessarily small but somehow relate it to the maximum size of the
-      // result.
-      motor_operations_printer.SetColorSegmentLength(
-        gcode_printer.GetDiagonalLength()/100);
-      motor_operations_printer.SetPass(ProcessingStep::GenerateOutput);
-      ParseFile(&parser, filename, msg_stream);
-
-      if (vis_options.show_speeds) {
-        float x, y, w, h;
-        gcode_printer.GetDimensions(&x, &y, &w, &h);
-        motor_operations_printer.PrintColorLegend(x+0.05*w, y+h, 0.9*w);
-      }
-    }
-    delete machine_control;
+  if (machine_control) {
+    machine_control->SetMsgOut(msg_stream);
+    // The moves are segmented into colored segments. Don't make segments
+    // unnecessarily small but somehow relate it to the maximum size of the
+    // result.
+    motor_operations_printer->SetColorSegmentLength(
+      gcode_printer.GetDiagonalLength()/100);
+    motor_operations_printer->SetPass(ProcessingStep::GenerateOutput);
+    machine_pass = std::thread(ReplayFile, compiled_fd, machine_parser,
+                               machine_control->ParseEventReceiver(),
+                               msg_stream);
   }
 
-  gcode_printer.ShowHomePos(parser_cfg.machine_origin);
+  FILE *gcode_out = nullptr;
   if (show_gcode_path) {
     // We print the gcode on top of the colored machine visualization.
+    gcode_out = CreateBufferFile();
+    gcode_printer.SetOutput(gcode_out);
     gcode_printer.SetPass(ProcessingStep::GenerateOutput);
-    ParseFile(&gcode_viz_parser, filename, msg_stream);
+    ReplayFile(compiled_fd, &gcode_viz_parser, &gcode_printer, msg_stream);
+    gcode_printer.SetOutput(output_file);
   }
 
+  if (machine_pass.joinable()) {
+    machine_pass.join();
+    if (vis_options.show_speeds) {
+      float x, y, w, h;
+      gcode_printer.GetDimensions(&x, &y, &w, &h);
+      motor_operations_printer->PrintColorLegend(x+0.05*w, y+h, 0.9*w);
+    }
+  }
+  delete machine_parser;
+  delete machine_control;
+  delete motor_operations_printer;   // Finishes machine path.
+  if (machine_out) AppendAndClose(machine_out, output_file);
+
+  gcode_printer.ShowHomePos(parser_cfg.machine_origin);
+  if (gcode_out) AppendAndClose(gcode_out, output_file);
+
   if (animation_frames > 0) {
     fprintf(output_file, "} def\n");
     fprintf(output_file, "%s", R"(
@@ -1372,7 +1615,7 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  return gcode_viz_parser.error_count() == 0 ? 0 : 1;
+  return parse_errors == 0 ? 0 : 1;
 }
 
 namespace {
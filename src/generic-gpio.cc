@@ -59,6 +59,24 @@ static volatile uint32_t *get_gpio_base(uint32_t gpio_def) {
   }
 }
 
+int get_gpio_bank(uint32_t gpio_def) {
+  switch (gpio_def & 0xfffff000) {
+  case GPIO_0_BASE: return 0;
+  case GPIO_1_BASE: return 1;
+  case GPIO_2_BASE: return 2;
+  case GPIO_3_BASE: return 3;
+  default: return -1;
+  }
+}
+
+void get_gpio_banks(unsigned bank_mask, uint32_t levels[4]) {
+  volatile uint32_t *const banks[4] = { gpio_0, gpio_1, gpio_2, gpio_3 };
+  for (int i = 0; i < 4; ++i) {
+    if ((bank_mask & (1 << i)) && banks[i])
+      levels[i] = banks[i][GPIO_DATAIN/4];
+  }
+}
+
 int get_gpio(uint32_t gpio_def) {
   volatile uint32_t *gpio_port = get_gpio_base(gpio_def);
   uint32_t bitmask = 1 << (gpio_def & 0x1f);
@@ -156,19 +174,15 @@ static void cfg_gpio_io() {
 
   // Preserve GPIO output settings that might already be set by other tasks,
   // so we only selectively set the bits we are interested in.
-
-  // Set the output enable register for each GPIO bank.
-  // Output direction is signified with a zero.
-  gpio_0[GPIO_OE/4] &= ~output_mask[0];
-  gpio_1[GPIO_OE/4] &= ~output_mask[1];
-  gpio_2[GPIO_OE/4] &= ~output_mask[2];
-  gpio_3[GPIO_OE/4] &= ~output_mask[3];
-
-  // All the inputs we need. Inputs are signified with a one.
-  gpio_0[GPIO_OE/4] |= input_mask[0];
-  gpio_1[GPIO_OE/4] |= input_mask[1];
-  gpio_2[GPIO_OE/4] |= input_mask[2];
-  gpio_3[GPIO_OE/4] |= input_mask[3];
+  // In the output enable register of each GPIO bank, output direction is
+  // signified with a zero, input with a one. After a restart, they are
+  // usually set up already; then we leave the registers alone.
+  volatile uint32_t *const banks[4] = { gpio_0, gpio_1, gpio_2, gpio_3 };
+  for (int i = 0; i < 4; ++i) {
+    const uint32_t current = banks[i][GPIO_OE/4];
+    const uint32_t wanted = (current & ~output_mask[i]) | input_mask[i];
+    if (current != wanted) banks[i][GPIO_OE/4] = wanted;
+  }
 }
 
 static volatile uint32_t *map_port(int fd, size_t length, off_t offset) {
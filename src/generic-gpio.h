@@ -24,6 +24,14 @@
 
 int get_gpio(uint32_t gpio_def);
 
+// Number of the GPIO bank (0..3) "gpio_def" is on, or -1 if none.
+int get_gpio_bank(uint32_t gpio_def);
+
+// Read the input levels of all the GPIO banks with a bit set in "bank_mask"
+// (bit 0 for GPIO_0 etc.) into "levels", with one read per bank. Banks not
+// read are left as is.
+void get_gpio_banks(unsigned bank_mask, uint32_t levels[4]);
+
 void set_gpio(uint32_t gpio_def);
 void clr_gpio(uint32_t gpio_def);
 
@@ -19,6 +19,7 @@
 
 #include "hardware-mapping.h"
 
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 
@@ -30,6 +31,10 @@
 #include "pwm-timer.h"
 #include "motor-operations.h"  // LinearSegmentSteps
 
+// The planner passes our PWM outputs along with the segments.
+static_assert((int)HardwareMapping::NUM_PWM_OUTPUTS == BEAGLEG_NUM_PWM_OUTPUTS,
+              "PWM outputs in hardware mapping and motor operations differ");
+
 HardwareMapping::HardwareMapping()
   : estop_input_(0), pause_input_(0), start_input_(0), probe_input_(0),
     estop_state_(true), motors_enabled_(false), aux_bits_(0),
@@ -87,6 +92,7 @@ bool HardwareMapping::AddPWMMapping(NamedOutput output, int pwm) {
               pwm, CAPE_NAME);
   }
   output_to_pwm_gpio_[output] = gpio_descriptor;
+  output_to_pwm_[output] = pwm;
   return true;
 }
 bool HardwareMapping::HasPWMMapping(NamedOutput output) const {
@@ -166,8 +172,10 @@ bool HardwareMapping::InitializeHardware() {
   // startup, which is of course an impossible mechanical state.
   // Since we don't know in which direction to move out of the way, we have to
   // bail for safety.
+  const InputSnapshot inputs = ReadInputs();
   for (GCodeParserAxis axis : AllAxes()) {
-    if (TestAxisSwitch(axis, TRIGGER_MIN) && TestAxisSwitch(axis, TRIGGER_MAX)) {
+    if (inputs.AxisSwitch(axis, TRIGGER_MIN)
+        && inputs.AxisSwitch(axis, TRIGGER_MAX)) {
       Log_error("Error: Both min and max switch for axis %c are triggered at "
                 "the same time. No way to safely proceed. Bailing out",
                 gcodep_axis2letter(axis));
@@ -239,12 +247,8 @@ bool HardwareMapping::MotorsEnabled() {
   return motors_enabled_;
 }
 
-void HardwareMapping::SetPWMOutput(NamedOutput type, float value) {
-#ifdef _DISABLE_PWM_TIMERS
-  return;
-#else
-  if (!is_hardware_initialized_) return;
-  const uint32_t gpio = output_to_pwm_gpio_[type];
+static void set_pwm_gpio(uint32_t gpio, float value) {
+#ifndef _DISABLE_PWM_TIMERS
   if (value <= 0.0) {
     pwm_timer_start(gpio, false);
   } else {
@@ -254,6 +258,21 @@ void HardwareMapping::SetPWMOutput(NamedOutput type, float value) {
 #endif
 }
 
+void HardwareMapping::SetPWMOutput(NamedOutput type, float value) {
+  if (!is_hardware_initialized_) return;
+  set_pwm_gpio(output_to_pwm_gpio_[type], value);
+}
+
+void HardwareMapping::UpdatePWMOutput(NamedOutput type, float value) {
+  const int pwm = output_to_pwm_[type];
+  if (pwm > 0) pwm_duty_[pwm - 1] = value;
+}
+
+void HardwareMapping::SetPWMChannel(int channel, float value) {
+  if (!is_hardware_initialized_) return;
+  set_pwm_gpio(get_pwm_gpio_descriptor(channel + 1), value);
+}
+
 std::string HardwareMapping::DebugMotorString(LogicAxis axis) {
   const MotorBitmap motormap_for_axis = axis_to_driver_[axis];
   std::string result;
@@ -278,7 +297,7 @@ void HardwareMapping::AssignMotorSteps(LogicAxis axis, int steps,
 }
 
 int HardwareMapping::GetAxisSteps(LogicAxis axis, const PhysicalStatus &status) {
-  uint8_t mask = axis_to_driver_[axis];
+  MotorBitmap mask = axis_to_driver_[axis];
   int m = 0;
   while (((mask & 0x01) != 0x01) && m < NUM_MOTORS) {
     // while the first bit is not 1, iterate.
@@ -310,6 +329,68 @@ bool HardwareMapping::TestSwitch(const int switch_number, bool def_result) {
   return def_result;
 }
 
+unsigned HardwareMapping::SwitchBankMask() const {
+  unsigned mask = 0;
+  auto add_switch = [&mask](int switch_number) {
+    const int bank = get_gpio_bank(get_endstop_gpio_descriptor(switch_number));
+    if (bank >= 0) mask |= (1 << bank);
+  };
+  for (const GCodeParserAxis axis : AllAxes()) {
+    add_switch(axis_to_min_endstop_[axis]);
+    add_switch(axis_to_max_endstop_[axis]);
+  }
+  add_switch(estop_input_);
+  add_switch(pause_input_);
+  add_switch(start_input_);
+  add_switch(probe_input_);
+  return mask;
+}
+
+HardwareMapping::InputSnapshot HardwareMapping::ReadInputs() const {
+  InputSnapshot result(this);
+  memset(result.gpio_levels_, 0, sizeof(result.gpio_levels_));
+  if (is_hardware_initialized_)
+    get_gpio_banks(SwitchBankMask(), result.gpio_levels_);
+  return result;
+}
+
+bool HardwareMapping::InputSnapshot::Switch(int switch_number,
+                                            bool def_result) const {
+  if (!hw_->is_hardware_initialized_) return def_result;
+  const GPIODefinition gpio_def = get_endstop_gpio_descriptor(switch_number);
+  const int bank = get_gpio_bank(gpio_def);
+  if (gpio_def == GPIO_NOT_MAPPED || bank < 0)
+    return def_result;
+  const bool level = (gpio_levels_[bank] >> (gpio_def & 0x1f)) & 1;
+  return level == hw_->trigger_level_[switch_number-1];
+}
+
+bool HardwareMapping::InputSnapshot::AxisSwitch(
+  LogicAxis axis, AxisTrigger requested_trigger) const {
+  bool result = false;
+  if (requested_trigger & TRIGGER_MIN)
+    result |= Switch(hw_->axis_to_min_endstop_[axis], false);
+  if (requested_trigger & TRIGGER_MAX)
+    result |= Switch(hw_->axis_to_max_endstop_[axis], false);
+  return result;
+}
+
+bool HardwareMapping::InputSnapshot::EStopSwitch() const {
+  return Switch(hw_->estop_input_, false);
+}
+
+bool HardwareMapping::InputSnapshot::PauseSwitch() const {
+  return Switch(hw_->pause_input_, false);
+}
+
+bool HardwareMapping::InputSnapshot::StartSwitch() const {
+  return Switch(hw_->start_input_, true);
+}
+
+bool HardwareMapping::InputSnapshot::ProbeSwitch() const {
+  return Switch(hw_->probe_input_, true);
+}
+
 bool HardwareMapping::TestAxisSwitch(LogicAxis axis, AxisTrigger requested_trigger) {
   bool result = false;
   if (requested_trigger & TRIGGER_MIN)
@@ -335,6 +416,30 @@ bool HardwareMapping::TestProbeSwitch() {
   return TestSwitch(probe_input_, true);
 }
 
+bool HardwareMapping::GetSwitchInput(int switch_number,
+                                     SwitchInput *input) const {
+  if (!is_hardware_initialized_) return false;
+  const GPIODefinition gpio_def = get_endstop_gpio_descriptor(switch_number);
+  if (gpio_def == GPIO_NOT_MAPPED) return false;
+  input->gpio_def = gpio_def;
+  input->trigger_level = trigger_level_[switch_number-1];
+  return true;
+}
+
+bool HardwareMapping::GetAxisSwitchInput(LogicAxis axis,
+                                         AxisTrigger requested_trigger,
+                                         SwitchInput *input) const {
+  switch (requested_trigger) {
+  case TRIGGER_MIN: return GetSwitchInput(axis_to_min_endstop_[axis], input);
+  case TRIGGER_MAX: return GetSwitchInput(axis_to_max_endstop_[axis], input);
+  default: return false;
+  }
+}
+
+bool HardwareMapping::GetProbeSwitchInput(SwitchInput *input) const {
+  return GetSwitchInput(probe_input_, input);
+}
+
 class HardwareMapping::ConfigReader : public ConfigParser::Reader {
 public:
   ConfigReader(HardwareMapping *config) : config_(config){}
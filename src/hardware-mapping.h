@@ -75,12 +75,12 @@ public:
     NUM_SWITCHES      =  9,
     NUM_BOOL_OUTPUTS  = 16,
     NUM_PWM_OUTPUTS   =  4,
-    NUM_MOTORS        =  8
+    NUM_MOTORS        =  BEAGLEG_NUM_MOTORS
   };
 
   // A register containing all the necessary bits.
   typedef uint16_t AuxBitmap;
-  typedef uint8_t  MotorBitmap;
+  typedef uint16_t MotorBitmap;
 
   typedef GCodeParserAxis LogicAxis;  // This is provided by the gcode parser.
 
@@ -127,6 +127,11 @@ public:
   bool AddAuxMapping(NamedOutput output, int aux);
   bool HasAuxMapping(NamedOutput output) const;
 
+  // The aux bits the given logic output is mapped to; 0 if not mapped.
+  AuxBitmap GetAuxMapping(NamedOutput output) const {
+    return output_to_aux_bits_[output];
+  }
+
   // Connect logic output to pwm pin in the range [1..NUM_PWM_OUTPUTS]
   // A value of 0 for 'pwm' is accpeted, but does not connect it to anything.
   bool AddPWMMapping(NamedOutput output, int pwm);
@@ -200,10 +205,22 @@ public:
   // Set PWM value for given output immediately.
   void SetPWMOutput(NamedOutput type, float value);
 
+  // Set PWM value for the given output synchronously with the motor
+  // movements: only updates the buffered value, which the planner sends
+  // along with the next segments (see GetPWMDuty()).
+  void UpdatePWMOutput(NamedOutput type, float value);
+
+  // Get the buffered PWM value of the given PWM output "channel" in the
+  // range [0..NUM_PWM_OUTPUTS-1], as set with UpdatePWMOutput().
+  float GetPWMDuty(int channel) const { return pwm_duty_[channel]; }
+
+  // Set PWM value of the given PWM output "channel" immediately.
+  void SetPWMChannel(int channel, float value);
+
   // -- Motor outputs
 
   // Given the logic axis, return a mask of the physical output drivers.
-  uint8_t GetMotorMap(LogicAxis axis) { return axis_to_driver_[axis]; }
+  MotorBitmap GetMotorMap(LogicAxis axis) { return axis_to_driver_[axis]; }
 
   // Given the logic axis and number of steps, assign these steps to the mapped
   // motors in the LinearSegmentSteps
@@ -240,6 +257,43 @@ public:
   // Returns true if the probe input is active (or it's not available)
   bool TestProbeSwitch();
 
+  // The state of all input switches, sampled at the same time with one read
+  // per GPIO bank. Gives a consistent view of all inputs and is cheaper
+  // than testing several switches one by one. Tests have the same meaning
+  // as the Test*Switch() functions above.
+  class InputSnapshot {
+  public:
+    bool AxisSwitch(LogicAxis axis, AxisTrigger requested_trigger) const;
+    bool EStopSwitch() const;
+    bool PauseSwitch() const;
+    bool StartSwitch() const;
+    bool ProbeSwitch() const;
+
+  private:
+    friend class HardwareMapping;
+    explicit InputSnapshot(const HardwareMapping *hw) : hw_(hw) {}
+    bool Switch(int switch_number, bool default_result) const;
+
+    const HardwareMapping *hw_;
+    uint32_t gpio_levels_[4];
+  };
+
+  // Sample all configured input switches.
+  InputSnapshot ReadInputs() const;
+
+  // An input switch, for the motion queue to watch while moving.
+  struct SwitchInput {
+    uint32_t gpio_def;    // GPIO of the switch.
+    bool trigger_level;   // Level at which it is triggered.
+  };
+
+  // Get the switch input for the endstop of "axis" at the "requested_trigger"
+  // end (TRIGGER_MIN or TRIGGER_MAX) or the probe. Returns false if there is
+  // no such switch or we don't run on real hardware.
+  bool GetAxisSwitchInput(LogicAxis axis, AxisTrigger requested_trigger,
+                          SwitchInput *input) const;
+  bool GetProbeSwitchInput(SwitchInput *input) const;
+
   bool HasProbeSwitch(LogicAxis axis) const {
     if (axis == AXIS_Z) return probe_input_ != 0;
     return false;
@@ -272,11 +326,17 @@ private:
   // default result.
   bool TestSwitch(const int switch_number, bool default_result);
 
+  bool GetSwitchInput(int switch_number, SwitchInput *input) const;
+
+  // GPIO banks (bit 0..3) any of the configured switches is on.
+  unsigned SwitchBankMask() const;
+
   void ResetHardware();  // Initialize to a safe state.
 
   // Mapping of logical outputs to hardware outputs.
   FixedArray<AuxBitmap, (int)NamedOutput::NUM_OUTPUTS, NamedOutput> output_to_aux_bits_;
   FixedArray<GPIODefinition, (int)NamedOutput::NUM_OUTPUTS, NamedOutput> output_to_pwm_gpio_;
+  FixedArray<int, (int)NamedOutput::NUM_OUTPUTS, NamedOutput> output_to_pwm_;  // pwm_number
 
     // "axis_to_driver": Which axis is mapped to which physical output drivers.
   // This allows to have a logical axis (e.g. X, Y, Z) output to any physical
@@ -297,6 +357,7 @@ private:
   bool motors_enabled_;
 
   AuxBitmap aux_bits_;       // Set via M42 or various other settings.
+  FixedArray<float, NUM_PWM_OUTPUTS> pwm_duty_;  // Set via UpdatePWMOutput()
 
   bool is_hardware_initialized_;
 };
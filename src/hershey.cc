@@ -69,6 +69,52 @@ void DrawText(StringPiece str, float tx, float ty, TextAlign align, float size,
   }
 }
 
+const std::vector<TextPoint> &TextRenderer::ScaledGlyph(ScaledFont *font,
+                                                       float size, char c) {
+  const int index = c - 32;
+  std::vector<TextPoint> &points = font->glyph[index];
+  if (font->scaled[index]) return points;
+  size /= 25.0f;
+  const HersheyGlyph &glyph = hershey_simplex[index];
+  bool pen_up = true;
+  for (int op = 0; op < glyph.number_of_ops; ++op) {
+    const auto &coor = glyph.operations[op];
+    if (coor.x == -1 && coor.y == -1) {
+      pen_up = true;
+      continue;
+    }
+    points.push_back({ !pen_up, size*coor.x, size*coor.y });
+    pen_up = false;
+  }
+  font->scaled[index] = true;
+  return points;
+}
+
+void TextRenderer::Render(StringPiece str, float tx, float ty, TextAlign align,
+                          float size, std::vector<TextPoint> *out) {
+  ScaledFont *font = &fonts_[size];
+  if (align == TextAlign::kRight) tx -= TextWidth(str, size);
+  else if (align == TextAlign::kCenter) tx -= TextWidth(str, size) / 2;
+  const float scale = size / 25.0f;
+  float x = tx, y = ty;
+  for (char c : str) {
+    if (c == '\n') { y -= 30 * scale; x = tx; }
+    if (c < 32 || c > 126) continue;
+    for (const TextPoint &p : ScaledGlyph(font, size, c)) {
+      out->push_back({ p.do_line, x + p.x, y + p.y });
+    }
+    x += scale * hershey_simplex[c - 32].width;
+  }
+}
+
+void TextRenderer::Draw(StringPiece str, float tx, float ty, TextAlign align,
+                        float size,
+                        const std::function<void(bool, float, float)> &draw) {
+  points_.clear();
+  Render(str, tx, ty, align, size, &points_);
+  for (const TextPoint &p : points_) draw(p.do_line, p.x, p.y);
+}
+
 /*
  * This is a transcoding of the Simplex Hershey Font glyphys into a C-struct.
  * The Hershey font glyph data itself is covered by a permissive use and
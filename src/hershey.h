@@ -20,6 +20,8 @@
 #define _BEAGLEG_HERSHEY_H_
 
 #include <functional>
+#include <map>
+#include <vector>
 
 #include "common/string-util.h"
 
@@ -39,4 +41,35 @@ enum class TextAlign { kLeft, kCenter, kRight };
 void DrawText(StringPiece str, float tx, float ty, TextAlign align, float size,
                std::function<void(bool do_line, float x, float y)> draw);
 
+// A point of drawn text: line or move to x, y.
+struct TextPoint {
+  bool do_line;
+  float x, y;
+};
+
+// Same as DrawText(), but the glyphs are scaled only once for each size
+// they are used in, then only moved into place. For drawing a lot of text.
+class TextRenderer {
+public:
+  // Append the whole text as one polyline to "out".
+  void Render(StringPiece str, float tx, float ty, TextAlign align,
+              float size, std::vector<TextPoint> *out);
+
+  // Like DrawText().
+  void Draw(StringPiece str, float tx, float ty, TextAlign align, float size,
+            const std::function<void(bool do_line, float x, float y)> &draw);
+
+private:
+  // The points of all printable characters in one size.
+  struct ScaledFont {
+    std::vector<TextPoint> glyph[95];
+    bool scaled[95] = {};
+  };
+  const std::vector<TextPoint> &ScaledGlyph(ScaledFont *font, float size,
+                                            char c);
+
+  std::map<float, ScaledFont> fonts_;
+  std::vector<TextPoint> points_;   // Reused in Draw().
+};
+
 #endif // _BEAGLEG_HERSHEY_H_
@@ -0,0 +1,171 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kinematics.h"
+
+#include <math.h>
+
+#include <string>
+
+#include "common/logging.h"
+#include "common/string-util.h"
+#include "gcode-machine-control.h"
+
+namespace {
+// Two motors moving the X/Y gantry together: both turning the same way
+// moves X, opposite ways moves Y.
+class CoreXYKinematics : public Kinematics {
+public:
+  bool IsLinear() const final { return true; }
+
+  bool Inverse(KinematicsBatch *batch) const final {
+    for (int i = 0; i < batch->count; ++i) {
+      const float x = batch->x[i];
+      const float y = batch->y[i];
+      batch->x[i] = x + y;
+      batch->y[i] = x - y;
+    }
+    return true;
+  }
+
+  bool Forward(const float joint[3], float pos[3]) const final {
+    pos[0] = (joint[0] + joint[1]) / 2;
+    pos[1] = (joint[0] - joint[1]) / 2;
+    pos[2] = joint[2];
+    return true;
+  }
+};
+
+// Linear delta: three carriages on vertical towers placed around the
+// center in a circle of "radius", each connected with rods of "rod_length"
+// to the effector. The towers of the X, Y and Z motors are at 210, 330 and
+// 90 degrees.
+class LinearDeltaKinematics : public Kinematics {
+public:
+  LinearDeltaKinematics(float center_x, float center_y, float radius,
+                        float rod_length)
+    : rod_sq_(rod_length * rod_length) {
+    for (int t = 0; t < 3; ++t) {
+      const double angle = (210 + 120 * t) * M_PI / 180;
+      tower_x_[t] = center_x + radius * cos(angle);
+      tower_y_[t] = center_y + radius * sin(angle);
+    }
+  }
+
+  bool IsLinear() const final { return false; }
+
+  // Carriage height is the Z of the effector plus the height of the rod
+  // above it.
+  bool Inverse(KinematicsBatch *batch) const final {
+    float *const joint[3] = { batch->x, batch->y, batch->z };
+    float height_sq[3][KinematicsBatch::MAX_POINTS];
+    float lowest = rod_sq_;
+    for (int t = 0; t < 3; ++t) {
+      for (int i = 0; i < batch->count; ++i) {
+        const float dx = batch->x[i] - tower_x_[t];
+        const float dy = batch->y[i] - tower_y_[t];
+        height_sq[t][i] = rod_sq_ - dx*dx - dy*dy;
+        lowest = fminf(lowest, height_sq[t][i]);
+      }
+    }
+    if (lowest <= 0) return false;
+    // X and Y are not needed anymore; Z is last for the Z tower.
+    for (int t = 0; t < 3; ++t) {
+      for (int i = 0; i < batch->count; ++i) {
+        joint[t][i] = batch->z[i] + sqrtf(height_sq[t][i]);
+      }
+    }
+    return true;
+  }
+
+  // The effector is where the spheres of rod length around the three
+  // carriages meet, below them.
+  bool Forward(const float joint[3], float pos[3]) const final {
+    double p[3][3];
+    for (int t = 0; t < 3; ++t) {
+      p[t][0] = tower_x_[t];
+      p[t][1] = tower_y_[t];
+      p[t][2] = joint[t];
+    }
+    double ex[3], ey[3], ez[3], d13[3];
+    for (int k = 0; k < 3; ++k) {
+      ex[k] = p[1][k] - p[0][k];
+      d13[k] = p[2][k] - p[0][k];
+    }
+    const double d = sqrt(dot(ex, ex));
+    for (int k = 0; k < 3; ++k) ex[k] /= d;
+    const double i = dot(ex, d13);
+    for (int k = 0; k < 3; ++k) ey[k] = d13[k] - i * ex[k];
+    const double j = sqrt(dot(ey, ey));
+    for (int k = 0; k < 3; ++k) ey[k] /= j;
+    ez[0] = ex[1]*ey[2] - ex[2]*ey[1];
+    ez[1] = ex[2]*ey[0] - ex[0]*ey[2];
+    ez[2] = ex[0]*ey[1] - ex[1]*ey[0];
+    // All spheres have the same radius.
+    const double x = d / 2;
+    const double y = (i*i + j*j) / (2 * j) - i * x / j;
+    const double z_sq = rod_sq_ - x*x - y*y;
+    if (z_sq < 0) return false;
+    const double z = (ez[2] > 0) ? -sqrt(z_sq) : sqrt(z_sq);
+    for (int k = 0; k < 3; ++k) {
+      pos[k] = p[0][k] + x * ex[k] + y * ey[k] + z * ez[k];
+    }
+    return true;
+  }
+
+private:
+  static double dot(const double a[3], const double b[3]) {
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+  }
+
+  const float rod_sq_;
+  float tower_x_[3];
+  float tower_y_[3];
+};
+}  // namespace
+
+bool Kinematics::Create(const MachineControlConfig &config,
+                        Kinematics **result) {
+  *result = nullptr;
+  const std::string name = ToLower(config.kinematics);
+  if (name == "cartesian")
+    return true;
+  if (name == "corexy") {
+    *result = new CoreXYKinematics();
+    return true;
+  }
+  if (name == "delta") {
+    if (config.delta_radius <= 0
+        || config.delta_rod_length <= config.delta_radius) {
+      Log_error("kinematics = delta needs a delta-radius > 0 and a longer "
+                "delta-rod-length, got %.1f and %.1f",
+                config.delta_radius, config.delta_rod_length);
+      return false;
+    }
+    // Centered in the X/Y range, so that positions are positive.
+    *result = new LinearDeltaKinematics(config.move_range_mm[AXIS_X] / 2,
+                                        config.move_range_mm[AXIS_Y] / 2,
+                                        config.delta_radius,
+                                        config.delta_rod_length);
+    return true;
+  }
+  Log_error("kinematics: expected cartesian, corexy or delta; got '%s'",
+            config.kinematics.c_str());
+  return false;
+}
@@ -0,0 +1,62 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_KINEMATICS_H_
+#define _BEAGLEG_KINEMATICS_H_
+
+struct MachineControlConfig;
+
+// Positions of the X, Y and Z axis in mm. Structure of arrays, so that the
+// kinematics do the same arithmetic on consecutive values, which the
+// compiler can vectorize.
+struct KinematicsBatch {
+  enum { MAX_POINTS = 64 };
+  int count;
+  float x[MAX_POINTS];
+  float y[MAX_POINTS];
+  float z[MAX_POINTS];
+};
+
+// Mapping of the cartesian X, Y, Z position to the joints that are driven
+// by the motors of the X, Y and Z axis, e.g. the carriages of the towers of
+// a delta; in mm of joint travel. The other axes are not affected.
+// Machines without special kinematics (the default) don't have one.
+class Kinematics {
+public:
+  virtual ~Kinematics() {}
+
+  // Create the kinematics of "config". Returns false if the configuration
+  // is invalid; otherwise "result" is the new kinematics or nullptr for a
+  // plain cartesian machine.
+  static bool Create(const MachineControlConfig &config, Kinematics **result);
+
+  // If the joints are a linear function of the position, straight moves
+  // stay straight and don't need to be broken up. Homing and probing then
+  // work on the cartesian axes, otherwise on the joints.
+  virtual bool IsLinear() const = 0;
+
+  // Replace the positions in "batch" with the joint positions. Returns
+  // false if any of them can't be reached.
+  virtual bool Inverse(KinematicsBatch *batch) const = 0;
+
+  // Cartesian position "pos" of the "joint" positions. Returns false if
+  // there is none.
+  virtual bool Forward(const float joint[3], float pos[3]) const = 0;
+};
+
+#endif  // _BEAGLEG_KINEMATICS_H_
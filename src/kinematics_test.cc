@@ -0,0 +1,105 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the CoreXY and delta kinematics.
+ */
+#include "kinematics.h"
+
+#include <math.h>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "gcode-machine-control.h"
+
+namespace {
+Kinematics *CreateKinematics(const char *name) {
+  MachineControlConfig config;
+  config.kinematics = name;
+  config.move_range_mm[AXIS_X] = 200;
+  config.move_range_mm[AXIS_Y] = 200;
+  config.delta_radius = 100;
+  config.delta_rod_length = 250;
+  Kinematics *result = nullptr;
+  EXPECT_TRUE(Kinematics::Create(config, &result));
+  return result;
+}
+}  // namespace
+
+TEST(Kinematics, CartesianHasNone) {
+  EXPECT_TRUE(CreateKinematics("cartesian") == nullptr);
+
+  MachineControlConfig config;
+  config.kinematics = "scara";
+  Kinematics *result;
+  EXPECT_FALSE(Kinematics::Create(config, &result));
+  config.kinematics = "delta";   // Without dimensions.
+  EXPECT_FALSE(Kinematics::Create(config, &result));
+}
+
+TEST(Kinematics, CoreXY) {
+  Kinematics *kinematics = CreateKinematics("CoreXY");
+  ASSERT_TRUE(kinematics != nullptr);
+  EXPECT_TRUE(kinematics->IsLinear());
+  KinematicsBatch batch;
+  batch.count = 2;
+  batch.x[0] = 10; batch.y[0] = 0;  batch.z[0] = 5;
+  batch.x[1] = 10; batch.y[1] = 30; batch.z[1] = 7;
+  ASSERT_TRUE(kinematics->Inverse(&batch));
+  EXPECT_FLOAT_EQ(10, batch.x[0]);
+  EXPECT_FLOAT_EQ(10, batch.y[0]);
+  EXPECT_FLOAT_EQ(40, batch.x[1]);
+  EXPECT_FLOAT_EQ(-20, batch.y[1]);
+  EXPECT_FLOAT_EQ(7, batch.z[1]);
+
+  const float joint[3] = { 40, -20, 7 };
+  float pos[3];
+  ASSERT_TRUE(kinematics->Forward(joint, pos));
+  EXPECT_FLOAT_EQ(10, pos[0]);
+  EXPECT_FLOAT_EQ(30, pos[1]);
+  EXPECT_FLOAT_EQ(7, pos[2]);
+  delete kinematics;
+}
+
+TEST(Kinematics, DeltaForwardIsInverseOfInverse) {
+  Kinematics *kinematics = CreateKinematics("delta");
+  ASSERT_TRUE(kinematics != nullptr);
+  EXPECT_FALSE(kinematics->IsLinear());
+  KinematicsBatch batch;
+  batch.count = 0;
+  for (float x = 20; x <= 180; x += 40) {
+    for (float y = 20; y <= 180; y += 40) {
+      batch.x[batch.count] = x;
+      batch.y[batch.count] = y;
+      batch.z[batch.count] = x / 10;
+      ++batch.count;
+    }
+  }
+  const KinematicsBatch cartesian = batch;
+  ASSERT_TRUE(kinematics->Inverse(&batch));
+
+  // In the center, all carriages are at the same height.
+  EXPECT_NEAR(batch.x[12], batch.y[12], 1e-3);
+  EXPECT_NEAR(batch.x[12], batch.z[12], 1e-3);
+  EXPECT_NEAR(10 + sqrtf(250*250 - 100*100), batch.x[12], 1e-3);
+
+  for (int i = 0; i < batch.count; ++i) {
+    const float joint[3] = { batch.x[i], batch.y[i], batch.z[i] };
+    float pos[3];
+    ASSERT_TRUE(kinematics->Forward(joint, pos));
+    EXPECT_NEAR(cartesian.x[i], pos[0], 1e-3) << i;
+    EXPECT_NEAR(cartesian.y[i], pos[1], 1e-3) << i;
+    EXPECT_NEAR(cartesian.z[i], pos[2], 1e-3) << i;
+  }
+
+  // Far outside, the rods don't reach.
+  batch.count = 1;
+  batch.x[0] = 1000;
+  batch.y[0] = batch.z[0] = 0;
+  EXPECT_FALSE(kinematics->Inverse(&batch));
+  delete kinematics;
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
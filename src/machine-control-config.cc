@@ -21,7 +21,12 @@
 
 #include "gcode-machine-control.h"
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
 
 #include "common/logging.h"
 #include "common/string-util.h"
@@ -35,6 +40,8 @@ static const char kHomeOrder[] = "ZXY";
 MachineControlConfig::MachineControlConfig() {
   speed_factor = 1;
   acknowledge_lines = true;
+  ack_window = 1;
+  idle_halt_queue_depth = 0;
   debug_print = false;
   synchronous = false;
   range_check = true;
@@ -44,6 +51,16 @@ MachineControlConfig::MachineControlConfig() {
   home_order = kHomeOrder;
   threshold_angle = -1;
   speed_tune_angle = 0;
+  junction_deviation = 0;
+  arc_tolerance = 0.005;
+  collinear_tolerance = 0;
+  native_arcs = false;
+  lookahead_segments = 16;
+  s_curve_fraction = 0;
+  bed_mesh_spacing = 0;
+  kinematics = "cartesian";
+  delta_radius = 0;
+  delta_rod_length = 0;
   auto_motor_disable_seconds = -1;
   auto_fan_disable_seconds = -1;
   auto_fan_pwm = 0;
@@ -85,11 +102,24 @@ public:
       ACCEPT_VALUE("clamp-to-range", String, &config_->clamp_to_range);
       ACCEPT_VALUE("synchronous",    Bool,   &config_->synchronous);
       ACCEPT_VALUE("enable-pause",   Bool,   &config_->enable_pause);
+      ACCEPT_VALUE("native-arcs",    Bool,   &config_->native_arcs);
       ACCEPT_VALUE("auto-motor-disable-seconds",
                    Int,   &config_->auto_motor_disable_seconds);
       ACCEPT_VALUE("auto-fan-disable-seconds",
                    Int,  &config_->auto_fan_disable_seconds);
       ACCEPT_VALUE("auto-fan-pwm",   Int,    &config_->auto_fan_pwm);
+      ACCEPT_VALUE("lookahead-segments", Int, &config_->lookahead_segments);
+      ACCEPT_VALUE("ack-window",     Int,    &config_->ack_window);
+      ACCEPT_VALUE("idle-halt-queue-depth",
+                   Int,    &config_->idle_halt_queue_depth);
+      ACCEPT_EXPR("junction-deviation", &config_->junction_deviation);
+      ACCEPT_EXPR("arc-tolerance", &config_->arc_tolerance);
+      ACCEPT_EXPR("collinear-tolerance", &config_->collinear_tolerance);
+      ACCEPT_EXPR("s-curve-fraction", &config_->s_curve_fraction);
+      ACCEPT_EXPR("bed-mesh-spacing", &config_->bed_mesh_spacing);
+      ACCEPT_VALUE("kinematics",     String, &config_->kinematics);
+      ACCEPT_EXPR("delta-radius", &config_->delta_radius);
+      ACCEPT_EXPR("delta-rod-length", &config_->delta_rod_length);
       return false;
     }
 
@@ -104,8 +134,14 @@ public:
 
       ACCEPT_EXPR("range",            &config_->move_range_mm[current_axis_]);
 
+      ACCEPT_EXPR("backlash",         &config_->backlash_mm[current_axis_]);
+      ACCEPT_EXPR("error-map-spacing",
+                  &config_->error_map_spacing[current_axis_]);
+
       if (name == "home-pos")
         return SetHomePos(line_no, current_axis_, value);
+      if (name == "error-map")
+        return SetErrorMap(line_no, current_axis_, value);
     }
     ReportError(line_no, StringPrintf("Unexpected configuration option '%s'",
                                       name.c_str()));
@@ -143,13 +179,116 @@ private:
     return true;
   }
 
+  // Comma separated list of errors in mm, which can be negative.
+  bool SetErrorMap(int line_no, enum GCodeParserAxis axis,
+                   const std::string &value) {
+    std::vector<float> &map = config_->error_map[axis];
+    map.clear();
+    for (const StringPiece &item : SplitString(value, ",")) {
+      const std::string number = TrimWhitespace(item).ToString();
+      char *end;
+      const double error = strtod(number.c_str(), &end);
+      if (number.empty() || *end != '\0') {
+        ReportError(line_no,
+                    StringPrintf("error-map[%c]: expected comma separated "
+                                 "numbers, but got '%s'",
+                                 gcodep_axis2letter(axis), value.c_str()));
+        return false;
+      }
+      map.push_back(error);
+    }
+    return true;
+  }
+
   MachineControlConfig *const config_;
   enum GCodeParserAxis current_axis_;
   std::string current_section_;
 };
+
+// Each [planner-variant <name>] section starts with a copy of the base
+// configuration and takes the options of [general], plus the angles that
+// are otherwise only given on the command line.
+class PlannerVariantReader : public ConfigParser::Reader {
+public:
+  PlannerVariantReader(const MachineControlConfig &base,
+                       std::vector<std::string> *names,
+                       std::vector<MachineControlConfig> *variants)
+    : base_(base), names_(names), variants_(variants) {}
+
+  bool SeenSection(int line_no, const std::string &section_name) final {
+    static const char kPrefix[] = "planner-variant";
+    reader_.reset();
+    if (section_name.compare(0, strlen(kPrefix), kPrefix) != 0)
+      return false;
+    const std::string name
+      = TrimWhitespace(section_name.substr(strlen(kPrefix))).ToString();
+    if (name.empty()) {
+      ReportError(line_no, "[planner-variant <name>] needs a name");
+      return false;
+    }
+    names_->push_back(name);
+    variants_->push_back(base_);
+    reader_.reset(new MachineControlConfigReader(&variants_->back()));
+    return reader_->SeenSection(line_no, "general");
+  }
+
+  bool SeenNameValue(int line_no, const std::string &name,
+                     const std::string &value) final {
+    MachineControlConfig *const config = &variants_->back();
+    if (name == "threshold-angle")
+      return ParseFloatExpr(value, &config->threshold_angle);
+    if (name == "speed-tune-angle")
+      return ParseFloatExpr(value, &config->speed_tune_angle);
+    return reader_->SeenNameValue(line_no, name, value);
+  }
+
+  void ReportError(int line_no, const std::string &msg) final {
+    Log_error("Line %d: %s", line_no, msg.c_str());
+  }
+
+private:
+  const MachineControlConfig &base_;
+  std::vector<std::string> *const names_;
+  std::vector<MachineControlConfig> *const variants_;
+  std::unique_ptr<MachineControlConfigReader> reader_;
+};
+}
+
+// Arcs become a sequence of corners for the planner, each turning by
+// length/radius. Beyond the chord tolerance, segments are kept short enough
+// that these corners can be taken at the feedrate instead of slowing down.
+float MachineControlConfig::ArcSegmentLength(float radius, float speed) const {
+  float length = gcodep_chord_length(radius, arc_tolerance);
+  if (junction_deviation > 0) {
+    float accel = -1;
+    for (const GCodeParserAxis axis : { AXIS_X, AXIS_Y, AXIS_Z }) {
+      const float a = acceleration[axis];
+      if (a > 0 && (accel < 0 || a < accel)) accel = a;
+    }
+    // On the arc itself, the centripetal acceleration limits the speed
+    // anyway. For small turning angles phi, the junction speed is about
+    // sqrt(8 * accel * deviation) / phi.
+    if (accel > 0) speed = std::min(speed, sqrtf(accel * radius));
+    if (accel > 0 && speed > 0) {
+      length = std::min(length, radius * sqrtf(8 * accel * junction_deviation)
+                        / speed);
+    }
+  } else if (threshold_angle > 0) {
+    length = std::min(length, radius * threshold_angle * (float)M_PI / 180);
+  }
+  return length;
 }
 
 bool MachineControlConfig::ConfigureFromFile(ConfigParser *parser) {
   MachineControlConfigReader reader(this);
   return parser->EmitConfigValues(&reader);
 }
+
+bool MachineControlConfig::ConfigurePlannerVariants(
+  ConfigParser *parser, std::vector<std::string> *names,
+  std::vector<MachineControlConfig> *variants) const {
+  names->clear();
+  variants->clear();
+  PlannerVariantReader reader(*this, names, variants);
+  return parser->EmitConfigValues(&reader);
+}
@@ -69,6 +69,54 @@ TEST(MachineControlConfig, AxisMapping) {
   EXPECT_EQ(HardwareMapping::TRIGGER_MIN, config.homing_trigger[AXIS_Y]);
 }
 
+TEST(MachineControlConfig, AxisCompensation) {
+  ConfigParser p;
+  p.SetContent("[ X-Axis ]\n"
+               "backlash = 0.05\n"
+               "error-map-spacing = 50\n"
+               "error-map = 0, 0.012, -0.03 ,0.1\n"
+               );
+  MachineControlConfig config;
+  EXPECT_TRUE(config.ConfigureFromFile(&p));
+  EXPECT_FLOAT_EQ(0.05f, config.backlash_mm[AXIS_X]);
+  EXPECT_FLOAT_EQ(50.0f, config.error_map_spacing[AXIS_X]);
+  EXPECT_EQ(std::vector<float>({ 0, 0.012f, -0.03f, 0.1f }),
+            config.error_map[AXIS_X]);
+  EXPECT_TRUE(config.error_map[AXIS_Y].empty());
+
+  ConfigParser invalid;
+  invalid.SetContent("[ X-Axis ]\n"
+                     "error-map = 0, 0.1mm\n");
+  EXPECT_FALSE(config.ConfigureFromFile(&invalid));
+}
+
+TEST(MachineControlConfig, PlannerVariants) {
+  ConfigParser p;
+  p.SetContent("[ general ]\n"
+               "lookahead-segments = 8\n"
+               "[ X-Axis ]\n"
+               "max-acceleration = 1000\n"
+               "[ planner-variant deep ]\n"
+               "lookahead-segments = 64\n"
+               "[ planner-variant junction ]\n"
+               "junction-deviation = 0.02\n"
+               "threshold-angle = 0\n");
+  MachineControlConfig config;
+  ASSERT_TRUE(config.ConfigureFromFile(&p));
+  EXPECT_EQ(8, config.lookahead_segments);
+
+  std::vector<std::string> names;
+  std::vector<MachineControlConfig> variants;
+  ASSERT_TRUE(config.ConfigurePlannerVariants(&p, &names, &variants));
+  EXPECT_EQ(std::vector<std::string>({ "deep", "junction" }), names);
+  ASSERT_EQ(2u, variants.size());
+  EXPECT_EQ(64, variants[0].lookahead_segments);
+  EXPECT_FLOAT_EQ(1000, variants[0].acceleration[AXIS_X]);
+  EXPECT_EQ(8, variants[1].lookahead_segments);
+  EXPECT_FLOAT_EQ(0.02, variants[1].junction_deviation);
+  EXPECT_FLOAT_EQ(0, variants[1].threshold_angle);
+}
+
 #if 0
 // TODO: needs to move to hardware mapping test
 TEST(MachineControlConfig, MotorMapping) {
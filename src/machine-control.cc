@@ -23,33 +23,49 @@
 #include <getopt.h>
 #include <grp.h>
 #include <math.h>
+#include <netdb.h>
 #include <netinet/in.h>
 #include <pwd.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <cmath>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "common/fd-mux.h"
 #include "common/logging.h"
+#include "common/shared-page.h"
 #include "common/string-util.h"
+#include "common/trace.h"
 #include "config-parser.h"
+#include "determine-print-stats.h"
 #include "gcode-machine-control.h"
 #include "gcode-parser/gcode-parser.h"
 #include "gcode-parser/gcode-streamer.h"
+#include "gcode-parser/job-spool.h"
 #include "hardware-mapping.h"
 #include "motion-queue.h"
+#include "motor-interface-constants.h"
 #include "motor-operations.h"
 #include "pru-hardware-interface.h"
 #include "sim-firmware.h"
+#include "path-preview.h"
+#include "segment-cache.h"
 #include "spindle-control.h"
+#include "threaded-motor-operations.h"
 
 static int usage(const char *prog, const char *msg) {
   if (msg) {
@@ -62,17 +78,33 @@ static int usage(const char *prog, const char *msg) {
           "  -p, --port <port>          : Listen on this TCP port for GCode.\n"
           "  -b, --bind-addr <bind-ip>  : Bind to this IP (Default: 0.0.0.0).\n"
           "  -l, --logfile <logfile>    : Logfile to use. If empty, messages go to syslog (Default: /dev/stderr).\n"
+          "      --log-async            : Write log messages from a background thread; rate limited, never blocks (Default: off).\n"
           "      --param <paramfile>    : Parameter file to use.\n"
+          "      --param-write-behind   : Save parameters in the background to a journal next to <paramfile> (Default: off).\n"
           "  -d, --daemon               : Run as daemon.\n"
           "      --priv <uid>[:<gid>]   : After opening GPIO: drop privileges to this (default: daemon:daemon)\n"
+          "      --motion-thread[=<prio>] : Feed motion queue from a separate thread with realtime priority (Default: off; prio 50).\n"
+          "      --segment-cache <dir>  : When running a file: cache planned motion segments in <dir>; re-runs of the same job replay them.\n"
+          "      --spool <jobs>         : With --port: receive up to this many jobs in the background while one runs; they run in order (Default: 0).\n"
+          "      --preview <file>       : Write the G-code path as it is processed to <file> for a live view (JSON lines; a FIFO blocks until read).\n"
+          "      --preview-rate <ms>    : Interval between preview frames (Default: 250).\n"
+          "      --stream-to <host:port>[,<host:port>...] : Plan the file here, without hardware, and stream the motion segments to machines started with --segment-port.\n"
+          "      --segment-port <port>  : Instead of G-code, receive planned motion segments from --stream-to on this TCP port.\n"
           "      --help                 : Display this help text and exit.\n"
           "\nMostly for testing and debugging:\n"
           "  -f <factor>                : Feedrate speed factor (Default 1.0).\n"
           "  -n                         : Dryrun; don't send to motors, no GPIO or PRU needed (Default: off).\n"
+          "      --planner-dry-run      : Only plan the file, with the config and each of its [planner-variant <name>] sections; print time, segments, junction speeds and peak segment rate of each.\n"
           // -N dry-run with simulation output; mostly for development, so not mentioned here.
+          // --sim-sample <ms>: with -N, fast simulation printing a sample every <ms>.
           "  -P                         : Verbose: Show some more debug output (Default: off).\n"
           "  -S                         : Synchronous: don't queue (Default: off).\n"
           "      --allow-m111           : Allow changing the debug level with M111 (Default: off).\n"
+          "      --trace <file>         : Record timing of parsing, planning and motion queue; written to <file> on exit. Convert with src/trace2json.\n"
+          "      --status-server <port> : Experimental status server on this TCP port.\n"
+          "      --status-rate <hz>     : Rate status server pushes to subscribers (Default: 10).\n"
+          "      --status-page <name>   : Publish the status in shared memory /dev/shm/<name> for local clients.\n"
+          "      --status-page-rate <hz>: Rate the status page is updated (Default: 1000).\n"
           "\nSegment acceleration tuning:\n"
           "     --threshold-angle       : Specifies the threshold angle used for segment acceleration (Default: 10 degrees).\n"
           "     --speed-tune-angle      : Specifies the angle used for proportional speed-tuning. (Default: 60 degrees)\n\n"
@@ -139,6 +171,202 @@ static void send_file_to_machine(GCodeMachineControl *machine,
   streamer->ConnectStream(fd, stderr);
 }
 
+// Key for the segment cache: everything that influences the planned segments.
+// Returns false if the job can't be identified.
+static bool make_segment_cache_key(const char *gcode_filename,
+                                   const char *config_file,
+                                   const std::string &paramfile,
+                                   const MachineControlConfig &config,
+                                   SegmentCacheKey *key) {
+  if (!key->AddFile(gcode_filename) || !key->AddFile(config_file))
+    return false;
+  if (!paramfile.empty()) key->AddFile(paramfile.c_str());  // Might not exist.
+  // The program itself, with the PRU firmware compiled in. Its version
+  // string is no help: it is unknown outside git and doesn't change with
+  // local modifications.
+  if (!key->AddFile("/proc/self/exe"))
+    return false;
+  // Command line overrides.
+  key->Add(StringPrintf("%g %g %g %d %d %d", config.speed_factor,
+                        config.threshold_angle, config.speed_tune_angle,
+                        config.require_homing, config.range_check,
+                        config.synchronous));
+  return true;
+}
+
+// Replay a segment cache hit in the event loop: homing as in the original
+// job, then the segments straight into the motion queue, a few batches
+// whenever it has room. In between, signals, E-Stop and the pause switch
+// are handled as while running GCode.
+static void run_segment_cache_replay(SegmentCacheReader *cache,
+                                     FDMultiplexer *event_server,
+                                     GCodeMachineControl *machine,
+                                     MotorOperations *motor_ops,
+                                     MotionQueue *motion_backend) {
+  if (cache->home_axes())
+    machine->ParseEventReceiver()->go_home(cache->home_axes());
+  motor_ops->WaitQueueEmpty();
+  enum { kBatchesPerCall = 4 };
+  auto replay_some = [=]() {
+    if (!machine->CheckEStopAndPause()) {
+      Log_info("Segment cache: E-Stop; stopping replay.");
+      return false;
+    }
+    for (int i = 0; i < kBatchesPerCall; ++i) {
+      if (!motion_backend->HasFreeSlots(SegmentCacheReader::kBatchSize))
+        return true;  // Wait until the queue made progress.
+      if (!cache->ReplayBatch(motion_backend))
+        return false;
+    }
+    return true;
+  };
+  // The queue tells us when elements are done; without that, we look
+  // regularly. A queue that reports free slots it doesn't have blocks in
+  // ReplayBatch() then, but only until the batch fits.
+  const int queue_event_fd = motion_backend->EventFd();
+  if (queue_event_fd >= 0) {
+    event_server->RunAfter(0, [=]() {
+        if (replay_some()) {
+          event_server->RunOnReadable(queue_event_fd, [=]() {
+              motion_backend->AcknowledgeEvent();
+              return replay_some();
+            });
+        }
+        return false;
+      });
+  } else {
+    event_server->RunAfter(1000, replay_some);
+  }
+}
+
+// Replay a segment stream: homing as in the original job, then the
+// segments straight into the motion queue.
+static void replay_segment_cache(SegmentCacheReader *cache,
+                                 GCodeMachineControl *machine,
+                                 MotorOperations *motor_ops,
+                                 MotionQueue *motion_backend) {
+  if (cache->home_axes())
+    machine->ParseEventReceiver()->go_home(cache->home_axes());
+  motor_ops->WaitQueueEmpty();
+  cache->Replay(motion_backend);
+}
+
+// Connect to "host:port" of a machine receiving the segment stream.
+// Returns the socket or -1.
+static int connect_to_machine(const std::string &host_port) {
+  const size_t colon = host_port.find_last_of(':');
+  if (colon == std::string::npos) {
+    Log_error("Expected <host>:<port>, got '%s'", host_port.c_str());
+    return -1;
+  }
+  const std::string host = host_port.substr(0, colon);
+  const std::string port = host_port.substr(colon + 1);
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *addresses;
+  const int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+  if (err != 0) {
+    Log_error("Can't resolve %s: %s", host_port.c_str(), gai_strerror(err));
+    return -1;
+  }
+  int s = -1;
+  for (struct addrinfo *a = addresses; a != NULL && s < 0; a = a->ai_next) {
+    s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (s >= 0 && connect(s, a->ai_addr, a->ai_addrlen) != 0) {
+      close(s);
+      s = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (s < 0) {
+    Log_error("Can't connect to %s: %s", host_port.c_str(), strerror(errno));
+    return -1;
+  }
+  Log_info("Streaming segments to %s", host_port.c_str());
+  return s;
+}
+
+// Receive segment streams, one after the other, and replay them as they
+// come in. While that happens, the event loop is blocked; the motion queue
+// is all there is to do.
+static void run_segment_server(int listen_socket, FDMultiplexer *event_server,
+                               GCodeMachineControl *machine,
+                               MotorOperations *motor_ops,
+                               MotionQueue *motion_backend,
+                               const char *bind_addr, int port) {
+  if (listen(listen_socket, 2) < 0) {
+    Log_error("listen(fd=%d) failed: %s", listen_socket, strerror(errno));
+    return;
+  }
+  Log_info("Ready to accept segment streams on %s:%d",
+           bind_addr ? bind_addr : "0.0.0.0", port);
+  event_server->RunOnReadable(listen_socket,
+                              [=]() {
+    struct sockaddr_in client;
+    socklen_t socklen = sizeof(client);
+    int connection = accept(listen_socket, (struct sockaddr*) &client, &socklen);
+    if (connection < 0) {
+      Log_error("accept(): %s", strerror(errno));
+      return true;
+    }
+    char ip_buffer[INET_ADDRSTRLEN];
+    const char *print_ip = inet_ntop(AF_INET, &client.sin_addr,
+                                     ip_buffer, sizeof(ip_buffer));
+    SegmentCacheReader stream;
+    if (!stream.OpenStream(connection))
+      return true;
+    Log_info("Replaying segment stream from %s", print_ip ? print_ip : "?");
+    replay_segment_cache(&stream, machine, motor_ops, motion_backend);
+    motion_backend->WaitQueueEmpty();
+    Log_info("Segment stream done.");
+    return true;
+  });
+}
+
+// Run the file through the planner of the configuration and of each of its
+// [planner-variant] sections, without any machine, and print how they
+// compare.
+static int run_planner_dry_run(const char *gcode_filename,
+                               ConfigParser *config_parser,
+                               const MachineControlConfig &config) {
+  std::vector<std::string> names;
+  std::vector<MachineControlConfig> variants;
+  if (!config.ConfigurePlannerVariants(config_parser, &names, &variants)) {
+    Log_error("Exiting. Errors in [planner-variant] sections.");
+    return 1;
+  }
+  names.insert(names.begin(), "general");
+  variants.insert(variants.begin(), config);
+  std::vector<const MachineControlConfig*> configs;
+  for (MachineControlConfig &c : variants) {
+    c.range_check = false;  // Only the planning is of interest.
+    c.require_homing = false;
+    configs.push_back(&c);
+  }
+  const int fd = strcmp(gcode_filename, "-") == 0
+    ? STDIN_FILENO : open(gcode_filename, O_RDONLY);
+  if (fd < 0) {
+    Log_error("Exiting. Couldn't open %s: %s", gcode_filename, strerror(errno));
+    return 1;
+  }
+  std::vector<BeagleGPrintStats> results(configs.size());
+  if (!estimate_print_stats(fd, configs.data(), configs.size(), stderr,
+                            results.data())) {
+    Log_error("Exiting. Couldn't process %s", gcode_filename);
+    return 1;
+  }
+  printf("%-20s %10s %9s %9s %9s %9s %10s\n", "#variant", "time-s",
+         "segments", "junctions", "min-mm/s", "avg-mm/s", "peak-seg/s");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BeagleGPrintStats &r = results[i];
+    printf("%-20s %10.2f %9d %9d %9.1f %9.1f %10.0f\n", names[i].c_str(),
+           r.total_time_seconds, r.segments, r.junctions,
+           r.min_junction_speed, r.avg_junction_speed, r.peak_segment_rate);
+  }
+  return 0;
+}
+
 // Open server. Return file-descriptor or -1 if listen fails.
 // Bind to "bind_addr" (can be NULL, then it is 0.0.0.0) and "port".
 static int open_server(const char *bind_addr, int port) {
@@ -171,24 +399,50 @@ static int open_server(const char *bind_addr, int port) {
   return s;
 }
 
+// With systemd socket activation, the listening socket is passed to us as
+// the first file descriptor after stderr. It stays open in systemd when we
+// restart, so clients connecting meanwhile wait in its backlog instead of
+// being refused. Returns -1 if we were not started that way.
+static int systemd_listen_socket() {
+  const char *pid = getenv("LISTEN_PID");
+  const char *fds = getenv("LISTEN_FDS");
+  if (!pid || !fds || atoi(pid) != getpid() || atoi(fds) < 1)
+    return -1;
+  // Not to be seen by anything we start.
+  unsetenv("LISTEN_PID");
+  unsetenv("LISTEN_FDS");
+  unsetenv("LISTEN_FDNAMES");
+  const int fd = 3;  // SD_LISTEN_FDS_START
+  fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return fd;
+}
+
 // Accept connections and receive GCode.
 // Only one connection can be active at a time.
 // Socket must already be opened by open_server(). "bind_addr" and "port"
 // are just FYI information for nicer log-messages.
 static void run_gcode_server(int listen_socket, FDMultiplexer *event_server,
                              GCodeMachineControl *machine,
-                             GCodeStreamer *streamer,
+                             JobSpool *spool, int spool_jobs,
                              const char *bind_addr, int port) {
-  if (listen(listen_socket, 2) < 0) {
+  // Messages go to the connection of the job that is currently running.
+  spool->SetOnJobStart([machine](FILE *msg_stream) {
+    machine->SetMsgOut(msg_stream);
+  });
+  if (listen(listen_socket, 2 + spool_jobs) < 0) {
     Log_error("listen(fd=%d) failed: %s", listen_socket, strerror(errno));
     return;
   }
 
-  Log_info("Ready to accept GCode-connections on %s:%d",
-           bind_addr ? bind_addr : "0.0.0.0", port);
+  if (port > 0) {
+    Log_info("Ready to accept GCode-connections on %s:%d",
+             bind_addr ? bind_addr : "0.0.0.0", port);
+  } else {
+    Log_info("Ready to accept GCode-connections on socket from systemd.");
+  }
 
   event_server->RunOnReadable(listen_socket,
-                              [listen_socket,machine,streamer]() {
+                              [listen_socket,spool,spool_jobs]() {
     struct sockaddr_in client;
     socklen_t socklen = sizeof(client);
     int connection = accept(listen_socket, (struct sockaddr*) &client, &socklen);
@@ -209,34 +463,211 @@ static void run_gcode_server(int listen_socket, FDMultiplexer *event_server,
       Log_error("fcntl(): %s", strerror(errno));
       return true;
     }
-
-    if (streamer->IsStreaming()) {
-      // For now, only one. Though we could have multiple.
-      dprintf(connection, "// Sorry, can only handle one connection at a time."
-              "There is only one machine after all.\n");
-      close(connection);
-      return true;
-    }
+    // While we wait for the motion queue, the sender can keep sending;
+    // a larger receive buffer absorbs stalls of the network meanwhile.
+    // The kernel limits it to net.core.rmem_max.
+    const int receive_buffer = 1 << 20;
+    setsockopt(connection, SOL_SOCKET, SO_RCVBUF,
+               &receive_buffer, sizeof(receive_buffer));
 
     char ip_buffer[INET_ADDRSTRLEN];
     const char *print_ip = inet_ntop(AF_INET, &client.sin_addr,
                                      ip_buffer, sizeof(ip_buffer));
-    Log_info("Accepting new connection from %s\n", print_ip);
-
     FILE *msg_stream = fdopen(connection, "w");
-    machine->SetMsgOut(msg_stream);
-    streamer->ConnectStream(connection, msg_stream);
+    if (!spool->Submit(connection, msg_stream, print_ip ? print_ip : "?")) {
+      if (spool_jobs > 0) {
+        fprintf(msg_stream, "// Sorry, machine busy and job spool full.\n");
+      } else {
+        fprintf(msg_stream, "// Sorry, can only handle one connection at a "
+                "time. There is only one machine after all.\n");
+      }
+      fclose(msg_stream);
+      return true;
+    }
+    Log_info("Accepting new connection from %s\n", print_ip);
     return true;
   });
 }
 
+// Compact status record pushed to binary subscribers. Host byte order
+// (little endian on the BeagleBone). Starts with its own size so that clients
+// can frame the stream and newer versions can append fields.
+struct BinaryStatusRecord {
+  uint16_t size;              // sizeof(BinaryStatusRecord)
+  uint8_t num_axes;           // Number of entries in pos[]
+  uint8_t estop;              // 0: none, 1: soft, 2: hard
+  uint8_t homed;              // 0: never, 1: homed but unpowered, 2: homed
+  uint8_t motors_enabled;
+  uint16_t queue_depth;       // Motion queue elements pending.
+  uint32_t sequence;          // Incremented with every sample.
+  float feedrate;             // mm/s
+  float pos[GCODE_NUM_AXES];  // Position relative to origin, in mm.
+  int32_t spindle_rpm;        // Negative: counterclockwise; 0: off.
+} __attribute__((packed));
+
+// A snapshot of all we report to subscribers. Taken once per tick, no
+// matter how many subscribers there are.
+struct StatusSample {
+  AxesRegister pos;
+  GCodeMachineControl::EStopState estop;
+  GCodeMachineControl::HomingState homed;
+  bool motors_enabled;
+  float feedrate;
+  int queue_depth;  // -1 if not known.
+  int spindle_rpm;
+};
+
+static void TakeStatusSample(GCodeMachineControl *machine,
+                             MotorOperations *motor_ops,
+                             StatusSample *sample) {
+  machine->GetCurrentPosition(&sample->pos);
+  sample->estop = machine->GetEStopStatus();
+  sample->homed = machine->GetHomeStatus();
+  sample->motors_enabled = machine->GetMotorsEnabled();
+  sample->feedrate = machine->GetCurrentFeedrate();
+  sample->spindle_rpm = machine->GetSpindleRpm();
+  MotionQueueStats stats;
+  sample->queue_depth = motor_ops->GetQueueStats(&stats)
+    ? (int)stats.queue_depth : -1;
+}
+
+static void FormatBinaryStatus(const StatusSample &sample, uint32_t sequence,
+                               BinaryStatusRecord *record) {
+  record->size = sizeof(*record);
+  record->num_axes = GCODE_NUM_AXES;
+  record->estop = (uint8_t)sample.estop;
+  record->homed = (uint8_t)sample.homed;
+  record->motors_enabled = sample.motors_enabled;
+  record->queue_depth = sample.queue_depth < 0 ? 0 : sample.queue_depth;
+  record->sequence = sequence;
+  record->feedrate = sample.feedrate;
+  for (const GCodeParserAxis a : AllAxes()) record->pos[a] = sample.pos[a];
+  record->spindle_rpm = sample.spindle_rpm;
+}
+
+static const char *EStopName(GCodeMachineControl::EStopState s) {
+  switch (s) {
+  case GCodeMachineControl::EStopState::NONE: return "none";
+  case GCodeMachineControl::EStopState::SOFT: return "soft";
+  case GCodeMachineControl::EStopState::HARD: return "hard";
+  }
+  return "unknown";
+}
+
+static const char *HomingName(GCodeMachineControl::HomingState s) {
+  switch (s) {
+  case GCodeMachineControl::HomingState::NEVER_HOMED: return "no";
+  case GCodeMachineControl::HomingState::HOMED_BUT_MOTORS_UNPOWERED:
+    return "maybe";
+  case GCodeMachineControl::HomingState::HOMED: return "yes";
+  }
+  return "unknown";
+}
+
+// Observers of the status server that get a StatusSample pushed at a
+// regular interval, driven by a timer in the event loop. The timer only
+// runs while there are subscribers.
+class StatusSubscribers {
+public:
+  enum Encoding { JSON, BINARY };
+
+  StatusSubscribers(FDMultiplexer *event_server, GCodeMachineControl *machine,
+                    MotorOperations *motor_ops, int rate_hz)
+    : event_server_(event_server), machine_(machine), motor_ops_(motor_ops),
+      rate_hz_(rate_hz), timer_(-1), sequence_(0) {}
+
+  void Subscribe(int fd, Encoding encoding) {
+    if (subscribers_.empty()) {
+      timer_ = event_server_->RunAfter(1000000 / rate_hz_, [this]() {
+          Publish();
+          return true;
+        });
+    }
+    subscribers_[fd] = encoding;
+  }
+
+  void Unsubscribe(int fd) {
+    if (subscribers_.erase(fd) && subscribers_.empty()) {
+      event_server_->CancelTimer(timer_);
+      timer_ = -1;
+    }
+  }
+
+private:
+  void Publish() {
+    StatusSample sample;
+    TakeStatusSample(machine_, motor_ops_, &sample);
+    ++sequence_;
+
+    // Each encoding is only formatted if someone wants it.
+    std::string json;
+    BinaryStatusRecord record;
+    bool have_record = false;
+    for (const auto &subscriber : subscribers_) {
+      const void *data;
+      size_t len;
+      if (subscriber.second == BINARY) {
+        if (!have_record) {
+          FormatBinaryStatus(sample, sequence_, &record);
+          have_record = true;
+        }
+        data = &record;
+        len = sizeof(record);
+      } else {
+        if (json.empty()) FormatJson(sample, &json);
+        data = json.data();
+        len = json.size();
+      }
+      // Never block the event loop on a slow observer: if it does not keep
+      // up, it just misses samples.
+      send(subscriber.first, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+  }
+
+  void FormatJson(const StatusSample &sample, std::string *out) {
+    // JSON {"seq":n, "pos":{"X":fval, ...}, "feedrate":fval, "queue":n,
+    //       "estop":"status", "homed":"status", "motors":bool,
+    //       "spindle":rpm}
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf), "{\"seq\":%u, \"pos\":{", sequence_);
+    for (const GCodeParserAxis a : AllAxes()) {
+      len += snprintf(buf + len, sizeof(buf) - len, "%s\"%c\":%.3f",
+                      a == AXIS_X ? "" : ", ", gcodep_axis2letter(a),
+                      sample.pos[a]);
+    }
+    snprintf(buf + len, sizeof(buf) - len,
+             "}, \"feedrate\":%.3f, \"queue\":%d, \"estop\":\"%s\", "
+             "\"homed\":\"%s\", \"motors\":%s, \"spindle\":%d}\n",
+             sample.feedrate, sample.queue_depth, EStopName(sample.estop),
+             HomingName(sample.homed),
+             sample.motors_enabled ? "true" : "false", sample.spindle_rpm);
+    out->assign(buf);
+  }
+
+  FDMultiplexer *const event_server_;
+  GCodeMachineControl *const machine_;
+  MotorOperations *const motor_ops_;
+  const int rate_hz_;
+  int timer_;
+  uint32_t sequence_;
+  std::map<int, Encoding> subscribers_;
+};
+
 // THIS IS A SAMPLE ONLY at this point. We need to come up with a proper
 // definition first what we want from a status server.
 // At this point: whenever it receives the character 'p' it prints the
-// position as json.
-static void run_status_server(const char *bind_addr, int port,
+// position as json, 's' the machine status and 'q' statistics about
+// feeding the motion queue.
+// 'j' subscribes the connection to a JSON line of position (all axes),
+// feedrate, queue depth and estop/homing/motor state pushed "rate_hz" times
+// a second; 'b' does the same with a BinaryStatusRecord. 'u' unsubscribes.
+// 'r' re-reads the configuration file with "reload_config" and replies with
+// {"reload":bool}.
+static void run_status_server(const char *bind_addr, int port, int rate_hz,
                               FDMultiplexer *event_server,
-                              GCodeMachineControl *machine) {
+                              GCodeMachineControl *machine,
+                              MotorOperations *motor_ops,
+                              std::function<bool()> reload_config) {
   const int listen_socket = open_server(bind_addr, port);
   if (listen_socket < 0) return;
   if (listen(listen_socket, 2) < 0) {
@@ -246,8 +677,13 @@ static void run_status_server(const char *bind_addr, int port,
 
   Log_info("Starting experimental status server on port %d", port);
 
+  // Lives as long as the event server.
+  StatusSubscribers *subscribers
+    = new StatusSubscribers(event_server, machine, motor_ops, rate_hz);
+
   event_server->RunOnReadable(
-    listen_socket, [listen_socket, machine, event_server]() {
+    listen_socket, [listen_socket, machine, motor_ops, event_server,
+                    subscribers, reload_config]() {
       struct sockaddr_in client;
       socklen_t socklen = sizeof(client);
       int conn = accept(listen_socket, (struct sockaddr*) &client, &socklen);
@@ -256,9 +692,11 @@ static void run_status_server(const char *bind_addr, int port,
         return true;
       }
 
-      event_server->RunOnReadable(conn, [conn, machine]() {
+      event_server->RunOnReadable(conn, [conn, machine, motor_ops,
+                                         subscribers, reload_config]() {
           char query;
           if (read(conn, &query, 1) <= 0) {
+            subscribers->Unsubscribe(conn);
             close(conn);
             return false;
           }
@@ -271,17 +709,38 @@ static void run_status_server(const char *bind_addr, int port,
                     pos[AXIS_X], pos[AXIS_Y], pos[AXIS_Z]);
           }
           if (query == 's') {
-            GCodeMachineControl::EStopState estop_status = machine->GetEStopStatus();
-	    GCodeMachineControl::HomingState home_status = machine->GetHomeStatus();
             // JSON {"estop":"status", "homed":"status", "motors":bool}
             dprintf(conn, "{\"estop\":\"%s\", \"homed\":\"%s\", \"motors\":%s}\n",
-                    estop_status == GCodeMachineControl::EStopState::NONE ? "none" :
-                    estop_status == GCodeMachineControl::EStopState::SOFT ? "soft" :
-                    estop_status == GCodeMachineControl::EStopState::HARD ? "hard" : "unknown",
-                    home_status == GCodeMachineControl::HomingState::NEVER_HOMED ? "no" :
-                    home_status == GCodeMachineControl::HomingState::HOMED_BUT_MOTORS_UNPOWERED ? "maybe" :
-                    home_status == GCodeMachineControl::HomingState::HOMED ? "yes" : "unknown",
-		    machine->GetMotorsEnabled() ? "true" : "false");
+                    EStopName(machine->GetEStopStatus()),
+                    HomingName(machine->GetHomeStatus()),
+                    machine->GetMotorsEnabled() ? "true" : "false");
+          }
+          MotionQueueStats stats;
+          if (query == 'q' && motor_ops->GetQueueStats(&stats)) {
+            // JSON {"segments":n, "underruns":n, "waits":n,
+            //       "wait_usec_total":n, "wait_usec_max":n,
+            //       "depth_histogram":[n, ...]}
+            dprintf(conn, "{\"segments\":%lu, \"underruns\":%lu, "
+                    "\"waits\":%lu, \"wait_usec_total\":%lu, "
+                    "\"wait_usec_max\":%lu, \"depth_histogram\":[",
+                    stats.segments, stats.underruns, stats.waits,
+                    stats.wait_usec_total, stats.wait_usec_max);
+            for (int i = 0; i < MotionQueueStats::DEPTH_BUCKETS; ++i) {
+              dprintf(conn, "%s%lu", i ? ", " : "", stats.depth_histogram[i]);
+            }
+            dprintf(conn, "]}\n");
+          }
+          if (query == 'j' || query == 'b') {
+            subscribers->Subscribe(conn, query == 'b'
+                                   ? StatusSubscribers::BINARY
+                                   : StatusSubscribers::JSON);
+          }
+          if (query == 'u') {
+            subscribers->Unsubscribe(conn);
+          }
+          if (query == 'r') {
+            dprintf(conn, "{\"reload\":%s}\n",
+                    reload_config() ? "true" : "false");
           }
           return true;
         });
@@ -289,6 +748,29 @@ static void run_status_server(const char *bind_addr, int port,
     });
 }
 
+// Publish a BinaryStatusRecord "rate_hz" times a second in the shared memory
+// object "name" for clients on the same machine, e.g. an HMI. They read it
+// with a SharedPageReader, without any system call or connection.
+static std::unique_ptr<SharedPageWriter> run_status_page(
+  const char *name, int rate_hz, FDMultiplexer *event_server,
+  GCodeMachineControl *machine, MotorOperations *motor_ops) {
+  std::unique_ptr<SharedPageWriter> page(new SharedPageWriter());
+  if (!page->Create(name, sizeof(BinaryStatusRecord)))
+    return nullptr;
+  Log_info("Publishing status in shared memory %s", name);
+  SharedPageWriter *const writer = page.get();
+  uint32_t sequence = 0;
+  event_server->RunAfter(1000000 / rate_hz, [=]() mutable {
+      StatusSample sample;
+      TakeStatusSample(machine, motor_ops, &sample);
+      BinaryStatusRecord record;
+      FormatBinaryStatus(sample, ++sequence, &record);
+      writer->Publish(&record);
+      return true;
+    });
+  return page;
+}
+
 // Create an absolute filename from a path, without the file not needed
 // to exist (so works where realpath() doesn't)
 static std::string MakeAbsoluteFile(const char *in) {
@@ -320,7 +802,22 @@ int main(int argc, char *argv[]) {
     OPT_PRIVS,
     OPT_ENABLE_M111,
     OPT_PARAM_FILE,
-    OPT_STATUS_SERVER
+    OPT_PARAM_WRITE_BEHIND,
+    OPT_STATUS_SERVER,
+    OPT_STATUS_RATE,
+    OPT_STATUS_PAGE,
+    OPT_STATUS_PAGE_RATE,
+    OPT_MOTION_THREAD,
+    OPT_SEGMENT_CACHE,
+    OPT_PREVIEW,
+    OPT_PREVIEW_RATE,
+    OPT_SPOOL,
+    OPT_TRACE,
+    OPT_LOG_ASYNC,
+    OPT_SIM_SAMPLE,
+    OPT_PLANNER_DRY_RUN,
+    OPT_STREAM_TO,
+    OPT_SEGMENT_PORT,
   };
 
   static struct option long_options[] = {
@@ -340,10 +837,25 @@ int main(int argc, char *argv[]) {
     { "loop",               optional_argument, NULL, OPT_LOOP },
     { "logfile",            required_argument, NULL, 'l'},
     { "param",              required_argument, NULL, OPT_PARAM_FILE },
+    { "param-write-behind", no_argument,       NULL, OPT_PARAM_WRITE_BEHIND },
     { "daemon",             no_argument,       NULL, 'd'},
     { "priv",               required_argument, NULL, OPT_PRIVS },
     { "allow-m111",         no_argument,       NULL, OPT_ENABLE_M111 },
     { "status-server",      required_argument, NULL, OPT_STATUS_SERVER },
+    { "status-rate",        required_argument, NULL, OPT_STATUS_RATE },
+    { "status-page",        required_argument, NULL, OPT_STATUS_PAGE },
+    { "status-page-rate",   required_argument, NULL, OPT_STATUS_PAGE_RATE },
+    { "motion-thread",      optional_argument, NULL, OPT_MOTION_THREAD },
+    { "segment-cache",      required_argument, NULL, OPT_SEGMENT_CACHE },
+    { "preview",            required_argument, NULL, OPT_PREVIEW },
+    { "preview-rate",       required_argument, NULL, OPT_PREVIEW_RATE },
+    { "spool",              required_argument, NULL, OPT_SPOOL },
+    { "trace",              required_argument, NULL, OPT_TRACE },
+    { "log-async",          no_argument,       NULL, OPT_LOG_ASYNC },
+    { "sim-sample",         required_argument, NULL, OPT_SIM_SAMPLE },
+    { "planner-dry-run",    no_argument,       NULL, OPT_PLANNER_DRY_RUN },
+    { "stream-to",          required_argument, NULL, OPT_STREAM_TO },
+    { "segment-port",       required_argument, NULL, OPT_SEGMENT_PORT },
 
     // possibly deprecated soon.
     { "threshold-angle",    required_argument, NULL, OPT_SET_THRESHOLD_ANGLE },
@@ -354,11 +866,26 @@ int main(int argc, char *argv[]) {
 
   int listen_port = -1;
   int status_server_port = -1;
+  int status_rate = 10;
+  const char *status_page_name = NULL;
+  int status_page_rate = 1000;
   char *bind_addr = NULL;
   bool require_homing = false;
   bool dont_require_homing = false;
   bool disable_range_check = false;
   bool allow_m111 = false;
+  bool param_write_behind = false;
+  int motion_thread_priority = -1;  // Negative: no motion thread.
+  std::string segment_cache_dir;
+  std::string preview_file;
+  int preview_rate_ms = 250;
+  int spool_jobs = 0;
+  std::string trace_file;
+  bool log_async = false;
+  double sim_sample_ms = 0;  // With simulation output: 0 for every loop.
+  bool planner_dry_run = false;
+  std::vector<StringPiece> stream_to;  // Machines to send the segments to.
+  int segment_port = -1;
   config.threshold_angle = 10;
   config.speed_tune_angle = 60;
   int opt;
@@ -408,6 +935,19 @@ int main(int argc, char *argv[]) {
     case OPT_STATUS_SERVER:
       status_server_port = atoi(optarg);
       break;
+    case OPT_STATUS_RATE:
+      status_rate = atoi(optarg);
+      if (status_rate < 1 || status_rate > 1000)
+        return usage(argv[0], "Status rate must be in range 1..1000 Hz");
+      break;
+    case OPT_STATUS_PAGE:
+      status_page_name = strdup(optarg);
+      break;
+    case OPT_STATUS_PAGE_RATE:
+      status_page_rate = atoi(optarg);
+      if (status_page_rate < 1 || status_page_rate > 10000)
+        return usage(argv[0], "Status page rate must be in range 1..10000 Hz");
+      break;
     case 'b':
       bind_addr = strdup(optarg);
       break;
@@ -417,6 +957,9 @@ int main(int argc, char *argv[]) {
     case OPT_PARAM_FILE:
       paramfile = MakeAbsoluteFile(optarg);
       break;
+    case OPT_PARAM_WRITE_BEHIND:
+      param_write_behind = true;
+      break;
     case 'd':
       as_daemon = true;
       break;
@@ -431,6 +974,42 @@ int main(int argc, char *argv[]) {
     case OPT_ENABLE_M111:
       allow_m111 = true;
       break;
+    case OPT_MOTION_THREAD:
+      motion_thread_priority = optarg ? atoi(optarg) : 50;
+      break;
+    case OPT_SEGMENT_CACHE:
+      segment_cache_dir = MakeAbsoluteFile(optarg);
+      break;
+    case OPT_PREVIEW:
+      preview_file = MakeAbsoluteFile(optarg);
+      break;
+    case OPT_PREVIEW_RATE:
+      preview_rate_ms = atoi(optarg);
+      break;
+    case OPT_SPOOL:
+      spool_jobs = atoi(optarg);
+      if (spool_jobs < 0) return usage(argv[0], "--spool needs a positive number of jobs.");
+      break;
+    case OPT_SIM_SAMPLE:
+      sim_sample_ms = atof(optarg);
+      if (sim_sample_ms <= 0) return usage(argv[0], "--sim-sample needs a positive interval.");
+      break;
+    case OPT_LOG_ASYNC:
+      log_async = true;
+      break;
+    case OPT_PLANNER_DRY_RUN:
+      planner_dry_run = true;
+      break;
+    case OPT_STREAM_TO:
+      stream_to = SplitString(optarg, ",");
+      dry_run = true;  // The hardware is elsewhere.
+      break;
+    case OPT_SEGMENT_PORT:
+      segment_port = atoi(optarg);
+      break;
+    case OPT_TRACE:
+      trace_file = MakeAbsoluteFile(optarg);
+      break;
     case OPT_HELP:
       return usage(argv[0], NULL);
     default:
@@ -447,9 +1026,17 @@ int main(int argc, char *argv[]) {
     return usage(argv[0], "Choose one: --homing-required or --nohoming-required.");
   }
 
+  const int activated_socket = systemd_listen_socket();
   const bool has_filename = (optind < argc);
-  if (! (has_filename ^ (listen_port > 0))) {
-    return usage(argv[0], "Choose one: <gcode-filename> or --port <port>.");
+  const bool receive_segments = (segment_port > 0);
+  if (has_filename + (listen_port > 0 || activated_socket >= 0)
+      + receive_segments != 1) {
+    return usage(argv[0], "Choose one: <gcode-filename>, --port <port> "
+                 "or --segment-port <port>.");
+  }
+  if (!stream_to.empty() && (!has_filename || !segment_cache_dir.empty())) {
+    return usage(argv[0], "--stream-to needs a <gcode-filename> and no "
+                 "--segment-cache.");
   }
 
   // As daemon, we use whatever the user chose as logfile
@@ -466,6 +1053,26 @@ int main(int argc, char *argv[]) {
               min_speed_adj, max_speed_adj, config.threshold_angle, config.speed_tune_angle);
   }
 
+  // Opening the PRU driver and loading the firmware takes a while; do that
+  // while we read the configuration. Without root, this would fail anyway;
+  // the hardware initialization below tells about it.
+  PruHardwareInterface *pru_hw_interface = NULL;
+  std::future<bool> pru_loaded;
+
+  // As a server, SIGHUP reloads the configuration. It is received with a
+  // signalfd in the event loop; it needs to be blocked before we start
+  // any threads, as they inherit the signal mask.
+  sigset_t reload_signal;
+  sigemptyset(&reload_signal);
+  sigaddset(&reload_signal, SIGHUP);
+  if (!has_filename) pthread_sigmask(SIG_BLOCK, &reload_signal, NULL);
+
+  if (!dry_run && !planner_dry_run && geteuid() == 0) {
+    pru_hw_interface = new UioPrussInterface();
+    pru_loaded = std::async(std::launch::async,
+                            &PruHardwareInterface::Init, pru_hw_interface);
+  }
+
   // If reading from file: don't print 'ok' for every line.
   config.acknowledge_lines = !has_filename;
 
@@ -476,6 +1083,9 @@ int main(int argc, char *argv[]) {
     Log_info("Reading config %s", config_file);
   }
 
+  // Reloading starts again from the command line configuration.
+  const MachineControlConfig command_line_config = config;
+
   ConfigParser config_parser;
   if (!config_parser.SetContentFromFile(config_file)) {
     Log_error("Exiting. Cannot read config file '%s'", config_file);
@@ -508,17 +1118,36 @@ int main(int argc, char *argv[]) {
   if (dont_require_homing) config.require_homing = false;
   if (disable_range_check) config.range_check = false;
 
+  if (planner_dry_run) {
+    if (!has_filename)
+      return usage(argv[0], "--planner-dry-run needs a <gcode-filename>.");
+    return run_planner_dry_run(argv[optind], &config_parser, config);
+  }
+
+  // Threads don't survive becoming a daemon, so loading needs to be done.
+  if (pru_loaded.valid() && !pru_loaded.get()) {
+    Log_error("Exiting. Couldn't load the PRU firmware.");
+    return 1;
+  }
+
   if (as_daemon && daemon(0, 0) != 0) {
     Log_error("Can't become daemon: %s", strerror(errno));
   }
+  if (log_async) Log_start_async();  // The thread needs to be in our process.
 
   FDMultiplexer event_server;
   // Open socket early, so that we
   //  (a) can bail out early before messing with GPIO/PRU settings if
   //      someone is alrady listening (starting as daemon twice?).
   //  (b) open socket while we have not dropped privileges yet.
-  int listen_socket = -1;
-  if (!has_filename) {
+  int listen_socket = activated_socket;
+  if (receive_segments) {
+    listen_socket = open_server(bind_addr, segment_port);
+    if (listen_socket < 0) {
+      Log_error("Exiting. Couldn't bind to socket to listen.");
+      return 1;
+    }
+  } else if (!has_filename && listen_socket < 0) {
     listen_socket = open_server(bind_addr, listen_port);
     if (listen_socket < 0) {
       Log_error("Exiting. Couldn't bind to socket to listen.");
@@ -529,11 +1158,24 @@ int main(int argc, char *argv[]) {
   // The backend for our stepmotor control. We either talk to the PRU or
   // just ignore them on dummy.
   MotionQueue *motion_backend;
-  PruHardwareInterface *pru_hw_interface = NULL;
-  if (dry_run) {
+  SegmentStreamer *segment_streamer = NULL;
+  if (!stream_to.empty()) {
+    std::vector<int> machines;
+    for (const StringPiece &machine : stream_to) {
+      const int fd = connect_to_machine(machine.ToString());
+      if (fd < 0) {
+        Log_error("Exiting. Can't stream to all machines.");
+        return 1;
+      }
+      machines.push_back(fd);
+    }
+    segment_streamer = new SegmentStreamer(machines);
+    motion_backend = segment_streamer;
+  } else if (dry_run) {
     // The backend
     if (simulation_output) {
-      motion_backend = new SimFirmwareQueue(stdout, 3); // TODO: derive from cfg
+      motion_backend = new SimFirmwareQueue(stdout, 3, // TODO: derive from cfg
+                                            sim_sample_ms / 1000.0);
     } else {
       motion_backend = new DummyMotionQueue();
     }
@@ -543,10 +1185,44 @@ int main(int argc, char *argv[]) {
                 "Use the dryrun option -n to not write to GPIO).");
       return 1;
     }
-    pru_hw_interface = new UioPrussInterface();
+    if (!pru_hw_interface) pru_hw_interface = new UioPrussInterface();
     motion_backend = new PRUMotionQueue(&hardware_mapping, pru_hw_interface);
   }
 
+  // With a segment cache, a job seen before is replayed from the cache,
+  // otherwise we record what is sent to the motion queue.
+  std::unique_ptr<SegmentCacheReader> segment_cache;
+  std::unique_ptr<SegmentRecorder> segment_recorder;
+  if (has_filename && !segment_cache_dir.empty()) {
+    SegmentCacheKey key;
+    if (make_segment_cache_key(argv[optind], config_file, paramfile, config,
+                               &key)) {
+      segment_cache.reset(new SegmentCacheReader());
+      if (segment_cache->Open(segment_cache_dir, key)) {
+        Log_info("Segment cache: replaying %s", key.filename().c_str());
+      } else {
+        segment_cache.reset();
+        segment_recorder.reset(new SegmentRecorder(motion_backend,
+                                                   segment_cache_dir, key));
+      }
+    }
+  }
+
+  MotionQueueMotorOperations queue_motor_operations(
+    &hardware_mapping,
+    segment_recorder ? segment_recorder.get() : motion_backend);
+  MotorOperations *motor_operations = &queue_motor_operations;
+
+  // Optionally, feed the motion queue from a separate thread so that slow
+  // parsing doesn't starve it. Created while we still have the privileges
+  // to request realtime scheduling.
+  std::unique_ptr<ThreadedMotorOperations> threaded_motor_operations;
+  if (motion_thread_priority >= 0) {
+    threaded_motor_operations.reset(
+      new ThreadedMotorOperations(motor_operations, motion_thread_priority));
+    motor_operations = threaded_motor_operations.get();
+  }
+
   // Listen port bound, GPIO initialized. Ready to drop privileges.
   if (geteuid() == 0 && strlen(privs) > 0) {
     if (drop_privileges(privs)) {
@@ -557,11 +1233,10 @@ int main(int argc, char *argv[]) {
     }
   }
   Log_info("BeagleG running with PID %d", getpid());
-
-  MotionQueueMotorOperations motor_operations(&hardware_mapping, motion_backend);
+  if (!trace_file.empty()) Trace_enable(true);
 
   GCodeMachineControl *machine_control
-    = GCodeMachineControl::Create(config, &motor_operations,
+    = GCodeMachineControl::Create(config, motor_operations,
                                   &hardware_mapping, spindle.get(),
                                   stderr);
   if (machine_control == NULL) {
@@ -573,35 +1248,147 @@ int main(int argc, char *argv[]) {
   GCodeParser::Config::ParamMap parameters;
   parser_cfg.parameters = &parameters;
   parser_cfg.LoadParams();
+  if (param_write_behind) parser_cfg.EnableWriteBehind();
+
+  GCodeParser::EventReceiver *event_receiver
+    = machine_control->ParseEventReceiver();
+  // Recording or streaming segments, we need to know if the job does
+  // anything the segments can't reproduce.
+  std::unique_ptr<SegmentCacheEventFilter> segment_cache_filter;
+  SegmentWriter *segment_writer = segment_recorder
+    ? (SegmentWriter*) segment_recorder.get() : segment_streamer;
+  if (segment_writer) {
+    segment_cache_filter.reset(
+      new SegmentCacheEventFilter(event_receiver, segment_writer));
+    event_receiver = segment_cache_filter.get();
+  }
+  std::unique_ptr<PathPreview> preview;
+  FILE *preview_out = NULL;
+  if (!preview_file.empty()) {
+    preview_out = fopen(preview_file.c_str(), "w");
+    if (!preview_out) {
+      Log_error("Can't open preview file %s: %s", preview_file.c_str(),
+                strerror(errno));
+      return 1;
+    }
+    preview.reset(new PathPreview(event_receiver, preview_out,
+                                  preview_rate_ms));
+    event_receiver = preview.get();
+  }
 
   machine_control->GetHomePos(&parser_cfg.machine_origin);
-  GCodeParser *parser = new GCodeParser(parser_cfg,
-                                        machine_control->ParseEventReceiver());
+  GCodeParser *parser = new GCodeParser(parser_cfg, event_receiver);
   GCodeStreamer *streamer =
-    new GCodeStreamer(&event_server, parser,
-                      machine_control->ParseEventReceiver());
+    new GCodeStreamer(&event_server, parser, event_receiver);
+  // Dwell and spindle ramps wait in the event loop, not blocking it.
+  machine_control->RunAsync(&event_server, streamer);
+  // If the motion queue can tell us when it has room again, we don't block
+  // the event loop while waiting for it, but suspend reading GCode instead.
+  // That way, other connections (such as the status server) stay responsive.
+  // With a motion thread, the motion queue is not fed from this thread, so
+  // flow control is not needed.
+  const int queue_event_fd = motion_backend->EventFd();
+  if (queue_event_fd >= 0 && !threaded_motor_operations) {
+    streamer->SetFlowControl(
+      queue_event_fd,
+      [motion_backend]() { motion_backend->AcknowledgeEvent(); },
+      [motion_backend]() { return motion_backend->HasFreeSlots(QUEUE_LEN / 4); });
+  }
+
+  // Only the machine control configuration can be reloaded; the hardware
+  // and spindle configuration need a restart.
+  auto reload_config = [&]() {
+    Log_info("Reloading config %s", config_file);
+    ConfigParser parser;
+    MachineControlConfig new_config = command_line_config;
+    if (!parser.SetContentFromFile(config_file)
+        || !new_config.ConfigureFromFile(&parser)) {
+      Log_error("Config reload: can't read %s; not reloaded.", config_file);
+      return false;
+    }
+    if (require_homing)      new_config.require_homing = true;
+    if (dont_require_homing) new_config.require_homing = false;
+    if (disable_range_check) new_config.range_check = false;
+    return machine_control->ReloadConfig(new_config);
+  };
+  if (!has_filename) {
+    const int reload_fd = signalfd(-1, &reload_signal, SFD_CLOEXEC);
+    if (reload_fd < 0) {
+      Log_error("signalfd(): %s; no reload on SIGHUP.", strerror(errno));
+    } else {
+      event_server.RunOnReadable(reload_fd, [reload_fd, reload_config]() {
+          struct signalfd_siginfo info;
+          if (read(reload_fd, &info, sizeof(info)) == sizeof(info))
+            reload_config();
+          return true;
+        });
+    }
+  }
+
   int ret = 0;
-  if (has_filename) {
+  std::unique_ptr<JobSpool> spool;
+  if (segment_cache) {
+    run_segment_cache_replay(segment_cache.get(), &event_server,
+                             machine_control, motor_operations,
+                             motion_backend);
+  } else if (has_filename) {
     const char *filename = argv[optind];
     send_file_to_machine(machine_control, streamer, filename);
+  } else if (receive_segments) {
+    run_segment_server(listen_socket, &event_server, machine_control,
+                       motor_operations, motion_backend, bind_addr,
+                       segment_port);
   } else {
+    spool.reset(new JobSpool(&event_server, streamer, spool_jobs));
     run_gcode_server(listen_socket, &event_server, machine_control,
-                     streamer,  bind_addr, listen_port);
+                     spool.get(), spool_jobs, bind_addr, listen_port);
   }
 
   if (status_server_port > 0 && !has_filename) {
-    run_status_server(bind_addr, status_server_port,
-                      &event_server, machine_control);
+    run_status_server(bind_addr, status_server_port, status_rate,
+                      &event_server, machine_control, motor_operations,
+                      reload_config);
+  }
+
+  std::unique_ptr<SharedPageWriter> status_page;
+  if (status_page_name) {
+    // Shared memory names have one leading slash.
+    const std::string name = std::string("/")
+      + (status_page_name[0] == '/' ? status_page_name + 1 : status_page_name);
+    status_page = run_status_page(name.c_str(), status_page_rate,
+                                  &event_server, machine_control,
+                                  motor_operations);
+    if (!status_page) return 1;
   }
 
-  event_server.Loop();  // Run service until Ctrl-C or all sockets closed.
+  ret = event_server.Loop();  // Run service until Ctrl-C or all sockets closed.
   Log_info("Exiting.");
 
+  const int parse_errors = parser->error_count();
+  spool.reset();
+  status_page.reset();
   delete streamer;
   delete parser;
+  preview.reset();
+  if (preview_out) fclose(preview_out);
   delete machine_control;
+  threaded_motor_operations.reset();  // Finish feeding before shutdown.
 
   const bool caught_signal = (ret == 1);
+  if (segment_recorder) {
+    // Everything planned has reached the recorder by now.
+    segment_recorder->Finish(segment_cache_filter->cacheable()
+                             && parse_errors == 0 && !caught_signal);
+  }
+  if (segment_streamer) {
+    if (!segment_streamer->Finish()) {
+      Log_error("Not all machines received the complete job.");
+      ret = 1;
+    } else if (!segment_cache_filter->cacheable() && !caught_signal) {
+      Log_error("The machines only did the moves of this job; the rest "
+                "can't be streamed (see above).");
+    }
+  }
   if (caught_signal) {
     Log_info("Caught signal: immediate exit. "
              "Skipping potential remaining queue.");
@@ -614,7 +1401,15 @@ int main(int argc, char *argv[]) {
   free(bind_addr);
 
   parser_cfg.SaveParams();
+  parser_cfg.FlushParams();
+
+  if (!trace_file.empty()) {
+    Trace_enable(false);
+    if (Trace_write(trace_file.c_str()))
+      Log_info("Wrote trace to %s", trace_file.c_str());
+  }
 
   Log_info("Shutdown.");
+  Log_stop_async();
   return ret;
 }
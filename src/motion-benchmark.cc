@@ -0,0 +1,385 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2015 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmark of the motion pipeline: replays G-code through the parser,
+// machine control, planner and MotionQueueMotorOperations into a
+// DummyMotionQueue and reports throughput, time per stage and number of
+// allocations, so that we can catch regressions before they hit a
+// BeagleBone. With a budget given, it fails if the pipeline gets slower.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <new>
+#include <string>
+
+#include "common/logging.h"
+#include "config-parser.h"
+#include "gcode-machine-control.h"
+#include "gcode-parser/gcode-parser.h"
+#include "hardware-mapping.h"
+#include "motion-queue.h"
+#include "motor-operations.h"
+
+// -- Allocation counting. Replaces the global allocator for this binary.
+static uint64_t allocation_count = 0;
+
+void *operator new(size_t size) {
+  ++allocation_count;
+  void *result = malloc(size ? size : 1);
+  if (result == NULL) throw std::bad_alloc();
+  return result;
+}
+void operator delete(void *p) noexcept { free(p); }
+
+static int64_t get_time_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+namespace {
+// Accumulates time spent between construction and destruction.
+class ScopedTimer {
+public:
+  ScopedTimer(int64_t *accumulator)
+    : accumulator_(accumulator), start_(get_time_ns()) {}
+  ~ScopedTimer() { *accumulator_ += get_time_ns() - start_; }
+
+private:
+  int64_t *const accumulator_;
+  const int64_t start_;
+};
+
+struct StageStats {
+  StageStats() : count(0), time_ns(0) {}
+  uint64_t count;
+  int64_t time_ns;
+};
+
+// Parse events that are not passed anywhere; to measure the parser alone.
+class NullEventReceiver : public GCodeParser::EventReceiver {
+public:
+  void gcode_start(GCodeParser *p) final {}
+  void go_home(AxisBitmap_t axes) final {}
+  void set_speed_factor(float f) final {}
+  void set_fanspeed(float speed) final {}
+  void set_temperature(float f) final {}
+  void wait_temperature() final {}
+  void dwell(float value) final {}
+  void motors_enable(bool b) final {}
+  bool coordinated_move(float feed, const AxesRegister &axes) final {
+    return true;
+  }
+  bool rapid_move(float feed, const AxesRegister &axes) final {
+    return true;
+  }
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    return NULL;
+  }
+};
+
+// Passes parse events on to the machine control, but skips everything that
+// would make us wait in real time.
+class NoWaitEventDelegator : public GCodeParser::EventReceiver {
+public:
+  NoWaitEventDelegator(GCodeParser::EventReceiver *delegatee)
+    : delegatee_(delegatee) {}
+
+  void gcode_start(GCodeParser *p) final { delegatee_->gcode_start(p); }
+  void gcode_finished(bool eos) final { delegatee_->gcode_finished(eos); }
+  void set_speed_factor(float f) final { delegatee_->set_speed_factor(f); }
+  void set_temperature(float f) final { delegatee_->set_temperature(f); }
+  void set_fanspeed(float speed) final { delegatee_->set_fanspeed(speed); }
+  void wait_temperature() final { }
+  void motors_enable(bool b) final { delegatee_->motors_enable(b); }
+  void go_home(AxisBitmap_t axes) final { }
+  void dwell(float value) final { delegatee_->dwell(0); }
+  void inform_origin_offset(const AxesRegister &axes, const char *n) final {
+    delegatee_->inform_origin_offset(axes, n);
+  }
+  bool rapid_move(float feed, const AxesRegister &axes) final {
+    return delegatee_->rapid_move(feed, axes);
+  }
+  bool coordinated_move(float feed, const AxesRegister &axes) final {
+    return delegatee_->coordinated_move(feed, axes);
+  }
+  const char *unprocessed(char letter, float value, const char *remain) final {
+    return delegatee_->unprocessed(letter, value, remain);
+  }
+
+private:
+  GCodeParser::EventReceiver *const delegatee_;
+};
+
+// Measures time spent in the wrapped MotorOperations.
+class TimingMotorOperations : public MotorOperations {
+public:
+  TimingMotorOperations(MotorOperations *delegate, StageStats *stats)
+    : delegate_(delegate), stats_(stats) {}
+
+  void Enqueue(const LinearSegmentSteps &segment) final {
+    ScopedTimer t(&stats_->time_ns);
+    stats_->count++;
+    delegate_->Enqueue(segment);
+  }
+  void MotorEnable(bool on) final { delegate_->MotorEnable(on); }
+  void WaitQueueEmpty() final { delegate_->WaitQueueEmpty(); }
+  bool GetPhysicalStatus(PhysicalStatus *status) final {
+    return delegate_->GetPhysicalStatus(status);
+  }
+  void SetExternalPosition(int axis, int pos) final {
+    delegate_->SetExternalPosition(axis, pos);
+  }
+  float MaxStepFrequency(unsigned motor_mask) const final {
+    return delegate_->MaxStepFrequency(motor_mask);
+  }
+
+private:
+  MotorOperations *const delegate_;
+  StageStats *const stats_;
+};
+
+// DummyMotionQueue that counts what it receives.
+class CountingMotionQueue : public DummyMotionQueue {
+public:
+  CountingMotionQueue(StageStats *stats) : stats_(stats) {}
+  void Enqueue(MotionSegment *segment) final { stats_->count++; }
+  void EnqueueBatch(MotionSegment *segments, int count) final {
+    stats_->count += count;
+  }
+
+private:
+  StageStats *const stats_;
+};
+}  // namespace
+
+// Append content of file to "content", return number of lines or -1 on error.
+static int ReadFileContent(const char *filename, std::string *content) {
+  FILE *f = fopen(filename, "r");
+  if (f == NULL) {
+    perror(filename);
+    return -1;
+  }
+  int lines = 0;
+  char buffer[8192];
+  while (fgets(buffer, sizeof(buffer), f)) {
+    content->append(buffer);
+    ++lines;
+  }
+  fclose(f);
+  if (!content->empty() && (*content)[content->size()-1] != '\n')
+    content->append("\n");
+  return lines;
+}
+
+// Parse G-code from memory, so that we don't measure file I/O. Using
+// ReadFile() as this is what handles loops.
+static void ParseContent(GCodeParser *parser, const std::string &content,
+                         FILE *msg_out) {
+  FILE *f = fmemopen((void*)content.data(), content.size(), "r");
+  parser->ReadFile(f, msg_out);  // Closes stream.
+}
+
+// Dense plain moves as emitted by slicers: exercises number parsing.
+static int GenerateMoves(int count, std::string *content) {
+  char line[128];
+  for (int i = 0; i < count; ++i) {
+    snprintf(line, sizeof(line), "G1 X%.3f Y%.3f Z%.2f E%.5f F%d\n",
+             100 + 50 * sin(i * 0.01), 100 + 50 * cos(i * 0.01),
+             0.2 + (i / 1000) * 0.2, i * 0.0331, 1200 + (i % 7) * 100);
+    content->append(line);
+  }
+  return count;
+}
+
+static void PrintStage(const char *name, const char *unit,
+                       const StageStats &s) {
+  printf("  %-22s %10llu %-9s %10.1f ns/op %12.0f ops/s\n", name,
+         (unsigned long long)s.count, unit,
+         s.count ? 1.0 * s.time_ns / s.count : 0.0,
+         s.time_ns ? 1e9 * s.count / s.time_ns : 0.0);
+}
+
+static int usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options] [<gcode-file> ..]\n"
+          "Options:\n"
+          "\t-c <config>       : Machine config (Required)\n"
+          "\t-r <repeat>       : Replay input this many times (Default: 1)\n"
+          "\t-g <lines>        : Add this many generated G1 moves to input.\n"
+          "\t-P                : Only run the parser stage.\n"
+          "\t-m <usec>         : Fail if the pipeline takes longer per line.\n",
+          prog);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  const char *config_file = NULL;
+  int repeat = 1;
+  int generated_lines = 0;
+  bool parser_only = false;
+  double max_usec_per_line = -1;  // No budget.
+  int opt;
+  while ((opt = getopt(argc, argv, "c:r:g:Pm:")) != -1) {
+    switch (opt) {
+    case 'c':
+      config_file = optarg;
+      break;
+    case 'r':
+      repeat = atoi(optarg);
+      if (repeat < 1) return usage(argv[0]);
+      break;
+    case 'g':
+      generated_lines = atoi(optarg);
+      if (generated_lines < 0) return usage(argv[0]);
+      break;
+    case 'P':
+      parser_only = true;
+      break;
+    case 'm':
+      max_usec_per_line = atof(optarg);
+      if (max_usec_per_line <= 0) return usage(argv[0]);
+      break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+  if ((optind >= argc && generated_lines == 0) || config_file == NULL)
+    return usage(argv[0]);
+
+  Log_init("/dev/null");
+
+  std::string gcode;
+  uint64_t line_count = 0;
+  for (int i = optind; i < argc; ++i) {
+    const int lines = ReadFileContent(argv[i], &gcode);
+    if (lines < 0)
+      return 1;
+    line_count += lines;
+  }
+  line_count += GenerateMoves(generated_lines, &gcode);
+  FILE *msg_out = fopen("/dev/null", "w");
+
+  ConfigParser config_parser;
+  if (!config_parser.SetContentFromFile(config_file)) {
+    fprintf(stderr, "Cannot read config file '%s'\n", config_file);
+    return 1;
+  }
+  MachineControlConfig config;
+  HardwareMapping hardware;  // We never initialize, just sim mode.
+  if (!config.ConfigureFromFile(&config_parser) ||
+      !hardware.ConfigureFromFile(&config_parser)) {
+    fprintf(stderr, "Parse error in configuration file '%s'\n", config_file);
+    return 1;
+  }
+  // Not connected to a machine: no homing, don't care about range.
+  config.range_check = false;
+  config.require_homing = false;
+  for (int i = 0; i < GCODE_NUM_AXES; ++i) {
+    config.homing_trigger[i] = HardwareMapping::TRIGGER_NONE;
+  }
+
+  // Stage 1: parser alone.
+  StageStats parse_stats;
+  {
+    NullEventReceiver null_receiver;
+    GCodeParser::Config parser_cfg;
+    GCodeParser::Config::ParamMap parameters;
+    parser_cfg.parameters = &parameters;
+    GCodeParser parser(parser_cfg, &null_receiver);
+    ScopedTimer t(&parse_stats.time_ns);
+    for (int r = 0; r < repeat; ++r) {
+      ParseContent(&parser, gcode, msg_out);
+    }
+    parse_stats.count = repeat * line_count;
+  }
+  if (parser_only) {
+    PrintStage("parser", "lines", parse_stats);
+    printf("  %-22s %10.1f MB/s\n", "parser input",
+           repeat * gcode.size() / (parse_stats.time_ns / 1e9) / 1e6);
+    fclose(msg_out);
+    return 0;
+  }
+
+  // Stage 2: full pipeline.
+  StageStats pipeline_stats, motor_op_stats, queue_stats;
+  uint64_t pipeline_allocations;
+  {
+    CountingMotionQueue motion_queue(&queue_stats);
+    MotionQueueMotorOperations queue_motor_ops(&hardware, &motion_queue);
+    TimingMotorOperations motor_ops(&queue_motor_ops, &motor_op_stats);
+    GCodeMachineControl *machine_control
+      = GCodeMachineControl::Create(config, &motor_ops,
+                                    &hardware, nullptr, nullptr);
+    if (!machine_control) {
+      fprintf(stderr, "Cannot create machine control.\n");
+      return 1;
+    }
+    NoWaitEventDelegator receiver(machine_control->ParseEventReceiver());
+    GCodeParser::Config parser_cfg;
+    GCodeParser::Config::ParamMap parameters;
+    parser_cfg.parameters = &parameters;
+    GCodeParser parser(parser_cfg, &receiver);
+
+    const uint64_t allocations_before = allocation_count;
+    {
+      ScopedTimer t(&pipeline_stats.time_ns);
+      for (int r = 0; r < repeat; ++r) {
+        ParseContent(&parser, gcode, msg_out);  // Flushes planner at end.
+      }
+    }
+    pipeline_allocations = allocation_count - allocations_before;
+    pipeline_stats.count = repeat * line_count;
+    delete machine_control;
+  }
+
+  // Everything in the pipeline not spent in parsing or the motor operations
+  // is machine control and planning.
+  StageStats planner_stats;
+  planner_stats.count = pipeline_stats.count;
+  planner_stats.time_ns = pipeline_stats.time_ns - parse_stats.time_ns
+    - motor_op_stats.time_ns;
+
+  const double seconds = pipeline_stats.time_ns / 1e9;
+  printf("%llu lines; pipeline %.3fs: %.0f lines/s; %.0f segments/s; "
+         "%.2f allocations/line\n",
+         (unsigned long long)pipeline_stats.count, seconds,
+         pipeline_stats.count / seconds, motor_op_stats.count / seconds,
+         1.0 * pipeline_allocations / pipeline_stats.count);
+  PrintStage("parser", "lines", parse_stats);
+  PrintStage("machine+planner", "lines", planner_stats);
+  PrintStage("motor-operations", "segments", motor_op_stats);
+  printf("  %-22s %10llu %-9s\n", "motion-queue",
+         (unsigned long long)queue_stats.count, "elements");
+  fclose(msg_out);
+
+  const double usec_per_line = pipeline_stats.count
+    ? pipeline_stats.time_ns / 1e3 / pipeline_stats.count : 0;
+  if (max_usec_per_line > 0 && usec_per_line > max_usec_per_line) {
+    fprintf(stderr, "Pipeline took %.2f usec/line; budget is %.2f usec/line\n",
+            usec_per_line, max_usec_per_line);
+    return 1;
+  }
+  return 0;
+}
@@ -22,11 +22,27 @@
 #include <stdint.h>
 #include "common/container.h"
 
+#include "motor-operations.h"  // BEAGLEG_NUM_MOTORS
 #include "pru-hardware-interface.h"
 
 // Number of motors handled by motion segment.
-// TODO: this and BEAGLEG_NUM_MOTORS should be coming from the same place.
-#define MOTION_MOTOR_COUNT 8
+#define MOTION_MOTOR_COUNT BEAGLEG_NUM_MOTORS
+
+// Raster segments use fractions[6] and [7], and the bits in the masks of
+// the segment need to cover all motors.
+static_assert(MOTION_MOTOR_COUNT >= 8 && MOTION_MOTOR_COUNT <= 16,
+              "BEAGLEG_NUM_MOTORS needs to be in the range [8..16]");
+
+// A bit per motor.
+#if MOTION_MOTOR_COUNT > 8
+typedef uint16_t MotionMotorMask;
+#else
+typedef uint8_t MotionMotorMask;
+#endif
+
+// Maximum number of loops of all three phases of a MotionSegment: the
+// motion queues report the loops left of the current segment in 24 bit.
+#define MOTION_MAX_LOOPS_PER_SEGMENT ((1 << 24) - 1)
 
 // Lowlevel interface allowing to enqueue MotionSegments to the hardware.
 // The motion planning running on the host-OS prepares these parameters
@@ -51,12 +67,15 @@ struct MotionSegment {
   // Queue header
   uint8_t state;           // see motor-interface-constants.h STATE_* constants.
 
-  uint8_t direction_bits;
+  MotionMotorMask direction_bits;
+  MotionMotorMask motor_mask;      // Motors moving in this segment; others skipped.
+  uint8_t raster;          // Non-zero: laser raster segment, see below.
 
-  // TravelParameters (needs to match TravelParameters in motor-interface-pru.p)
-  uint16_t loops_accel;    // Phase 1: loops spent in acceleration
-  uint16_t loops_travel;   // Phase 2: lops spent in travel
-  uint16_t loops_decel;    // Phase 3: loops spent in deceleration
+  // TravelParameters. The sum of the loops is at most
+  // MOTION_MAX_LOOPS_PER_SEGMENT.
+  uint32_t loops_accel;    // Phase 1: loops spent in acceleration
+  uint32_t loops_travel;   // Phase 2: lops spent in travel
+  uint32_t loops_decel;    // Phase 3: loops spent in deceleration
   uint16_t aux;            // all 16 bits can be used
   uint32_t accel_series_index;  // index in taylor
 
@@ -65,6 +84,30 @@ struct MotionSegment {
 
   uint32_t fractions[MOTION_MOTOR_COUNT]; // fixed point fractions to add each step.
 
+  // ArcParameters (needs to match ArcParameters in motor-interface-pru.p)
+  // If arc_shift is non-zero, the segment is a circular arc: after each loop,
+  // the fractions of the motors in arc_fall_mask and arc_rise_mask (which
+  // all start with the same value within each group) are rotated by
+  // 2^-arc_shift radians:
+  //   fall -= rise >> arc_shift   (not going below zero)
+  //   rise += fall >> arc_shift
+  MotionMotorMask arc_rise_mask;   // Motors getting faster in this arc.
+  MotionMotorMask arc_fall_mask;   // Motors getting slower.
+  uint8_t arc_shift;       // 0 for linear segments.
+  uint8_t stop_on_input;   // Non-zero: stop at the input, see WatchInput().
+
+  // Laser raster segments (raster != 0) switch aux bits for each pixel
+  // while moving, and the fractions have a different meaning:
+  //  - all motors in motor_mask step with RASTER_MOTOR_FRACTION, so they
+  //    need to do the same number of steps.
+  //  - fractions[0..RASTER_PIXEL_WORDS-1] are the pixels: bit n of the
+  //    words, LSB first, is pixel n.
+  //  - fractions[6] is added to a pixel clock after each loop; the first
+  //    addition starts pixel 0, each carry of the clock the next one.
+  //  - fractions[7] are the aux bits the pixels switch: they are set on
+  //    pixels that are 1, cleared otherwise. At the end of the segment,
+  //    "aux" is set again.
+
 #if JERK_EXPERIMENT
   /*
    * The following not handled yet in PRU, just experimental in sim right now.
@@ -85,6 +128,36 @@ struct QueueStatus {
   uint32_t counter : 24; // remaining number of cycles to be performed
   uint32_t index : 8;    // represent the executing slot [0 to QUEUE_LEN - 1]
 };
+
+// Encoding of a MotionSegment in the PRU ring buffer (needs to match
+// motor-interface-queue.hp): only the fractions of the motors in motor_mask
+// follow, in order; raster segments have all of them. The elements follow
+// each other; if there is no room for the largest one behind an element,
+// the next one starts at the beginning of the ring buffer.
+// The loop counters are split: the PRU counts the low 16 bit in registers
+// and only looks at the high bits whenever these run out.
+struct PackedSegment {
+  uint8_t state;
+  uint8_t direction_bits;
+  uint8_t motor_mask;
+  uint8_t raster;
+  uint16_t loops_accel;
+  uint16_t loops_travel;
+  uint16_t loops_decel;
+  uint16_t aux;
+  uint32_t accel_series_index;
+  uint32_t hires_accel_cycles;
+  uint32_t travel_delay_cycles;
+  uint8_t arc_rise_mask;
+  uint8_t arc_fall_mask;
+  uint8_t arc_shift;
+  uint8_t stop_on_input;
+  uint8_t loops_accel_high;
+  uint8_t loops_travel_high;
+  uint8_t loops_decel_high;
+  uint8_t loops_high_total;  // Sum of the three above.
+  uint32_t fractions[MOTION_MOTOR_COUNT];  // As many as used.
+} __attribute__((packed));
 }
 
 typedef FixedArray<int, MOTION_MOTOR_COUNT> MotorsRegister;
@@ -99,9 +172,57 @@ public:
   // Might change values in MotionSegment.
   virtual void Enqueue(MotionSegment *segment) = 0;
 
+  // Enqueue "count" segments in sequence. Implementations can use this to
+  // amortize the cost of transferring segments to the hardware. Blocks until
+  // all segments have been accepted.
+  // Might change values in the MotionSegments.
+  virtual void EnqueueBatch(MotionSegment *segments, int count) {
+    for (int i = 0; i < count; ++i) Enqueue(&segments[i]);
+  }
+
   // Block and wait for queue to be empty.
   virtual void WaitQueueEmpty() = 0;
 
+  // Returns true if at least "count" elements can be enqueued without
+  // blocking.
+  virtual bool HasFreeSlots(int count) { return true; }
+
+  // For use in event loops: a file descriptor that becomes readable when
+  // the hardware finished executing elements, or -1 if not supported.
+  // After it became readable, AcknowledgeEvent() needs to be called.
+  virtual int EventFd() { return -1; }
+  virtual void AcknowledgeEvent() {}
+
+  // Stopping at an input, for homing and probing at speed. Segments with
+  // stop_on_input set end in the loop the input "gpio_def" is seen with
+  // "trigger_level"; after that, following segments with stop_on_input are
+  // skipped. A "gpio_def" of 0 switches it off. Only to be called while the
+  // queue is empty. Returns false if not supported.
+  virtual bool WatchInput(uint32_t gpio_def, bool trigger_level) {
+    return false;
+  }
+
+  // Returns true if the input triggered since WatchInput(). In
+  // "loops_done", the number of loops executed in stop_on_input segments
+  // since then is returned. Only meaningful while the queue is empty.
+  virtual bool InputTriggered(uint32_t *loops_done) { return false; }
+
+  // Steps each motor did since start, as the hardware executed the segments:
+  // up, or down for motors with the direction bit set. Can be called any
+  // time. Returns false if not supported.
+  virtual bool GetStepCounters(int32_t counters[MOTION_MOTOR_COUNT]) {
+    return false;
+  }
+
+  // Speed override applied by the hardware to all segments, including the
+  // ones already in the queue: from now on, motors move at "factor" (0..1)
+  // of the speed of the segments; 0 holds them until a factor > 0 is set.
+  // The change goes linearly in time, from 0 to full speed in "ramp_seconds".
+  // Can be called any time. Returns false if not supported.
+  virtual bool SetSpeedFactor(float factor, float ramp_seconds) {
+    return false;
+  }
+
   // Immediately enable motors, indepenent of queue.
   virtual void MotorEnable(bool on) = 0;
 
@@ -130,7 +251,15 @@ public:
   ~PRUMotionQueue();
 
   void Enqueue(MotionSegment *segment);
+  void EnqueueBatch(MotionSegment *segments, int count);
   void WaitQueueEmpty();
+  bool HasFreeSlots(int count);
+  int EventFd();
+  void AcknowledgeEvent();
+  bool WatchInput(uint32_t gpio_def, bool trigger_level);
+  bool InputTriggered(uint32_t *loops_done);
+  bool GetStepCounters(int32_t counters[MOTION_MOTOR_COUNT]);
+  bool SetSpeedFactor(float factor, float ramp_seconds);
   void MotorEnable(bool on);
   void Shutdown(bool flush_queue);
   int GetPendingElements(uint32_t *head_item_progress);
@@ -138,11 +267,33 @@ public:
 private:
   bool Init();
 
+  // Forget about the elements at the tail the PRU is done with, adding
+  // their steps to done_steps_.
+  void ReleaseDone();
+
+  // Of the "loops" of a stop_on_input element, the ones done, given the
+  // loops reported by the PRU.
+  uint32_t WatchedLoopsDone(uint32_t loops);
+
+  // Number of the "count" segments (of the maximum size if NULL) that fit
+  // into the ring buffer now.
+  int FreeSlots(const MotionSegment *segments, int count);
+
   HardwareMapping *const hardware_mapping_;
   PruHardwareInterface *const pru_interface_;
 
   volatile struct PRUCommunication *pru_data_;
-  unsigned int queue_pos_;
+  unsigned int queue_pos_;      // Index of the next element.
+  unsigned int write_offset_;   // Offset of the next element in ring_buffer
+  unsigned int last_offset_;    // ... and of the last one we wrote.
+  unsigned int tail_offset_;    // Oldest element the PRU might not be done with
+  int in_flight_;               // ... and number of elements from there on.
+
+  // The PRU doesn't count steps; we do from the elements it is done with.
+  MotionSegment *const enqueued_;  // Copy of each, by queue position.
+  int32_t done_steps_[MOTION_MOTOR_COUNT];
+  uint32_t watched_loops_;      // Of stop_on_input elements released.
+  bool started_;                // The PRU reported an element.
 };
 
 
@@ -31,12 +31,71 @@
 #define STATE_FILLED 1   // Queue element filled by host, to be picked up by PRU
 #define STATE_EXIT   2   // Filled by host, no parameters; tells PRU to exit.
 
-#define QUEUE_LEN 16
+// Maximum number of elements in the ring-buffer. Can be set at compile time
+// (see Makefile). Elements only carry the fractions of the motors that
+// move, so how many fit into the QUEUE_BYTES of the ring-buffer depends on
+// the segments.
+#ifndef QUEUE_LEN
+#define QUEUE_LEN 192
+#endif
+#define QUEUE_BYTES 8132
+
+// Cost of one step generation loop in the PRU besides the delay, in units
+// of TIMER_FREQUENCY: a fixed part plus a part for each motor that is active
+// in the segment (inactive motors are skipped). This determines the highest
+// step frequency we can generate.
+// These are measured running the firmware in the emulator, for the BUMPS
+// cape (see motor-interface-pru_test.cc); keep them in sync.
+// In dual PRU mode, reading the delay from PRU1 takes a little longer than
+// calculating a travel delay, but is the same in all phases.
+#ifdef DUAL_PRU
+#define LOOP_BASE_CYCLES  30
+#else
+#define LOOP_BASE_CYCLES  25
+#endif
+#define LOOP_MOTOR_CYCLES 5
+// Additional cost per loop in arc segments (see MotionSegment::arc_shift),
+// also measured.
+#ifdef DUAL_PRU
+#define LOOP_ARC_CYCLES   18
+#else
+#define LOOP_ARC_CYCLES   19
+#endif
+// Additional cost per loop in raster segments (see MotionSegment::raster),
+// and for each change of pixel in them; measured as well.
+#define LOOP_RASTER_CYCLES  5
+#define RASTER_PIXEL_CYCLES 36
+// Additional cost per loop in segments that stop at an input (see
+// MotionSegment::stop_on_input); mostly waiting for the GPIO read.
+#define LOOP_INPUT_CYCLES   40
+
+// In raster segments, all moving motors step with this fraction, and the
+// first RASTER_PIXEL_WORDS fractions hold the pixels.
+#define RASTER_MOTOR_FRACTION 0x7fffffff
+#define RASTER_PIXEL_WORDS 6
+
+// Speed override of the PRU (feed hold, feed override): the delay of each
+// loop is multiplied by SPEED_SCALE_ONE / scale. Scales between 0 (hold) and
+// SPEED_SCALE_MIN are not used: the firmware stops or starts from there.
+#define SPEED_SCALE_SHIFT     12
+#define SPEED_SCALE_ONE       4096   // 1 << SPEED_SCALE_SHIFT
+#define SPEED_SCALE_MIN_SHIFT 6
+#define SPEED_SCALE_MIN       64     // 1 << SPEED_SCALE_MIN_SHIFT
+// The scale changes at most once in this time, in units of TIMER_FREQUENCY:
+// 164us. Ramps longer than SPEED_SCALE_ONE of these take longer ticks.
+#define SPEED_RAMP_TICK       16384
 
 // In calculation of delay cycles: number of bits shifted
 // for higher resolution.
 #define DELAY_CYCLE_SHIFT 5
 
+// Dual PRU mode (see DUAL_PRU in the Makefile): PRU1 passes the delays of
+// each loop to PRU0 in a FIFO in the shared RAM: the write index (counted
+// up by PRU1), the read index (PRU0), then DELAY_FIFO_LEN delays.
+#define PRU_SHARED_RAM    0x00010000
+#define DELAY_FIFO_LEN    32   // Power of two, less than QUEUE_LEN
+#define DELAY_FIFO_OFFSET 8
+
 // Memory space mapped to the GPIO registers
 #define GPIO_0_BASE       0x44e07000
 #define GPIO_1_BASE       0x4804c000
@@ -19,7 +19,7 @@
 
 
 #include "motor-interface-constants.h"
-#include "idiv.hp"
+#include "motor-interface-queue.hp"
 
 .origin 0
 .entrypoint INIT
@@ -27,43 +27,24 @@
 #define PRU0_ARM_INTERRUPT 19
 #define CONST_PRUDRAM	   C24
 
-#define QUEUE_ELEMENT_SIZE (SIZE(QueueHeader) + SIZE(TravelParameters))
-#define QUEUE_OFFSET 4
-
-#define PARAM_START r7
-#define PARAM_END  r19
-.struct TravelParameters
-	// We do at most 2^16 loops to avoid accumulating too much rounding
-	// error in the fraction addition. Longer moves are split into separate
-	// requests by the host.
-	.u16 loops_accel	 // Phase 1: steps spent in acceleration.
-	.u16 loops_travel	 // Phase 2: steps spent in travel.
-	.u16 loops_decel         // Phase 3: steps spent in deceleration.
-
-	.u16 aux		 // all 16 bits can be used
-
-	.u32 accel_series_index  // index into the taylor series.
-	.u32 hires_accel_cycles  // initial delay cycles, for acceleration
-	                         // shifted by DELAY_CYCLE_SHIFT
-	                         // Changes in the different phases.
-	.u32 travel_delay_cycles // Exact cycle value for travel (do not rely
-	                         // on accel approx to exactly reach that)
-
-	// 1.31 Fixed point increments for each motor
-	.u32 fraction_1
-	.u32 fraction_2
-	.u32 fraction_3
-	.u32 fraction_4
-	.u32 fraction_5
-	.u32 fraction_6
-	.u32 fraction_7
-	.u32 fraction_8
-.ends
-
-.struct QueueHeader
-	.u8 state
-	.u8 direction_bits
-.ends
+;; Cycles spent in ReadDelay (dual PRU mode), about.
+#define READ_DELAY_CYCLES 20
+;; Delay loops between two reads of the speed target while holding: 10us.
+#define SPEED_HOLD_POLL 1000
+;; Cycles spent in ScaleDelay if the speed is scaled, about; in units of
+;; the delay loop.
+#define SCALE_DELAY_CYCLES ((IDIV_MACRO_CYCLE_COUNT + 20) / 2)
+
+;; Behind the queue: rising and falling fraction of the current arc.
+#define ARC_STATE_OFFSET (QUEUE_OFFSET + QUEUE_BYTES)
+;; ... followed by pixel clock and pixel number of a raster segment.
+#define RASTER_STATE_OFFSET (ARC_STATE_OFFSET + 8)
+;; ... and the input to stop at: GPIO input register address, bit mask and
+;; trigger level, then the triggered flag and loop count we report.
+#define INPUT_WATCH_OFFSET (RASTER_STATE_OFFSET + 8)
+#define INPUT_TRIGGERED_OFFSET (INPUT_WATCH_OFFSET + 12)
+;; ... then the LoopsHigh of the current segment, counting down.
+#define LOOPS_HIGH_OFFSET (INPUT_TRIGGERED_OFFSET + 8)
 
 ;; counter states of the motors
 #define STATE_START r20   	; after PARAM_END
@@ -80,92 +61,273 @@
 .ends
 .assign MotorState, STATE_START, STATE_END, mstate
 
-;;; Calculate the current delay depending on the phase (acceleration, travel,
-;;; deceleration). Modifies the values in params, which is of type
-;;; TravelParameters.
-;;; Needs one state_register to keep its own state and two scratch registers.
-;;; Outputs the resulting delay in output_reg.
-;;; Returns special value 0 when done.
-;;; Only used once, so just macro.
-;;;
-;;; We are approximating the needed sqrt() operation with a few terms
-;;; from an Taylor series which brings sufficient accuracy and boils down
-;;; to a single (somewhat expensive) division. I tried as well using an
-;;; integer sqrt directly, but the rounding errors were worse.
-;;; Thanks to this paper for inspiration:
-;;;   http://embedded.com/design/mcus-processors-and-socs/4006438/stepper
-.macro CalculateDelay
-.mparam output_reg, params, state_register, divident_tmp, divisor_tmp
-;;; We use the 'state_register' to store the remainder of the division
-;;; to carry it to the next division for higher accuracy.
-;;; Note, we are inlining the division macro twice here instead of wrapping it
-;;; in a function. There is no need, we have enough code-space.
-PHASE_1_ACCELERATION:	; ==================================================
-	QBEQ PHASE_2_TRAVEL, params.loops_accel, 0
-	QBEQ accel_calc_done, params.accel_series_index, 0 // first ? no calc.
-
-	;; divident = (hires_accel_cycles << 1) + remainder
-	LSL divident_tmp, params.hires_accel_cycles, 1
-	;; Add previous remainder for higher resolution.
-	ADD divident_tmp, divident_tmp, state_register
-
-	;; divisor = (accel_series_index << 2) + 1
-	LSL divisor_tmp, params.accel_series_index, 2
-	ADD divisor_tmp, divisor_tmp, 1
-
-	idiv_macro divident_tmp, divisor_tmp, state_register
-
-	;; params.hires_accel_cycles -= quotient (divident_tmp became quotient)
-	SUB params.hires_accel_cycles, params.hires_accel_cycles, divident_tmp
-accel_calc_done:
-	ADD params.accel_series_index, params.accel_series_index, 1 ; series++
-	SUB params.loops_accel, params.loops_accel, 1		; loops_accel--
-
-	;; The calculation is done in higher resolution with DELAY_CYCLE_SHIFT
-	;; more bits. Shift back: output_reg = hires_cycles >> DELAY_CYCLE_SHIFT
-	LSR output_reg, params.hires_accel_cycles, DELAY_CYCLE_SHIFT
-
-	;; Correct Timing: Substract the number of cycles we have spent in this
-	;; routine. We take half, because the delay-loop needs 2 cycles.
-	SUB output_reg, output_reg, (IDIV_MACRO_CYCLE_COUNT + 9) / 2
-	JMP DONE_CALCULATE_DELAY
-
-PHASE_2_TRAVEL:		; ==================================================
-	QBEQ PHASE_3_DECELERATION, params.loops_travel, 0
-	SUB params.loops_travel, params.loops_travel, 1	        ; loops_travel--
-	MOV output_reg, params.travel_delay_cycles
-	SUB output_reg, output_reg, (4 / 2) ; substract cycles spent here
-	JMP DONE_CALCULATE_DELAY
-
-PHASE_3_DECELERATION:	; ==================================================
-	QBNE calc_decel, params.loops_decel, 0
-	ZERO &output_reg, 4                // we are done. Special stop value 0
-	JMP DONE_CALCULATE_DELAY
-calc_decel:
-	;; divident = (hires_accel_cycles << 1) + remainder
-	LSL divident_tmp, params.hires_accel_cycles, 1
-	ADD divident_tmp, divident_tmp, state_register
-
-	;; divisor = (accel_series_index << 2) - 1
-	LSL divisor_tmp, params.accel_series_index, 2
-	SUB divisor_tmp, divisor_tmp, 1
-
-	idiv_macro divident_tmp, divisor_tmp, state_register
-
-	;; params.hires_accel_cycles += quotient (divident_tmp became quotient)
-	ADD params.hires_accel_cycles, params.hires_accel_cycles, divident_tmp
-
-	SUB params.accel_series_index, params.accel_series_index, 1 ; series--
-	SUB params.loops_decel, params.loops_decel, 1	        ; loops_decel--
-
-	;; The calculation is done in higher resolution with DELAY_CYCLE_SHIFT
-	;; more bits. Shift back: output_reg = hires_cycles >> DELAY_CYCLE_SHIFT
-	LSR output_reg, params.hires_accel_cycles, DELAY_CYCLE_SHIFT
-
-	;; Correct timing: Substract the number of cycles we have spent here.
-	SUB output_reg, output_reg, (IDIV_MACRO_CYCLE_COUNT + 11) / 2
-
-DONE_CALCULATE_DELAY:
+
+;;; Move the fractions, packed in the first registers, to the ones of
+;;; their motors: for each inactive motor, the ones above move up by one,
+;;; and its own is zero. Costs a few cycles per segment, but lets the queue
+;;; carry only the fractions of the motors that move.
+.macro UnpackFractions
+.mparam params, mask
+	QBBS unpack_1, mask, 0
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, params.fraction_6
+	MOV params.fraction_6, params.fraction_5
+	MOV params.fraction_5, params.fraction_4
+	MOV params.fraction_4, params.fraction_3
+	MOV params.fraction_3, params.fraction_2
+	MOV params.fraction_2, params.fraction_1
+	MOV params.fraction_1, 0
+unpack_1:
+	QBBS unpack_2, mask, 1
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, params.fraction_6
+	MOV params.fraction_6, params.fraction_5
+	MOV params.fraction_5, params.fraction_4
+	MOV params.fraction_4, params.fraction_3
+	MOV params.fraction_3, params.fraction_2
+	MOV params.fraction_2, 0
+unpack_2:
+	QBBS unpack_3, mask, 2
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, params.fraction_6
+	MOV params.fraction_6, params.fraction_5
+	MOV params.fraction_5, params.fraction_4
+	MOV params.fraction_4, params.fraction_3
+	MOV params.fraction_3, 0
+unpack_3:
+	QBBS unpack_4, mask, 3
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, params.fraction_6
+	MOV params.fraction_6, params.fraction_5
+	MOV params.fraction_5, params.fraction_4
+	MOV params.fraction_4, 0
+unpack_4:
+	QBBS unpack_5, mask, 4
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, params.fraction_6
+	MOV params.fraction_6, params.fraction_5
+	MOV params.fraction_5, 0
+unpack_5:
+	QBBS unpack_6, mask, 5
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, params.fraction_6
+	MOV params.fraction_6, 0
+unpack_6:
+	QBBS unpack_7, mask, 6
+	MOV params.fraction_8, params.fraction_7
+	MOV params.fraction_7, 0
+unpack_7:
+	QBBS unpack_8, mask, 7
+	MOV params.fraction_8, 0
+unpack_8:
+.endm
+
+;;; Rotate the velocity vector of an arc segment by 2^-shift radians:
+;;;   fall -= rise >> shift   (not going below zero)
+;;;   rise += fall >> shift
+;;; using the updated value of fall for the second step, which keeps the
+;;; vector on a closed path. All rising (falling) motors get the same value.
+;;; The two current values are kept behind the queue, as we have no
+;;; registers left. Uses r0 and the scratch registers r4..r6.
+.macro RotateArc
+.mparam params, rise_mask, fall_mask
+	MOV r0, ARC_STATE_OFFSET
+	LBCO r4, CONST_PRUDRAM, r0, 8	; r4 = rise, r5 = fall
+	LSR r6, r4, params.aux		; shift is kept in the aux field.
+	QBLE arc_fall_ok, r5, r6	; r6 <= r5: no underflow
+	MOV r6, r5
+arc_fall_ok:
+	SUB r5, r5, r6
+	LSR r6, r5, params.aux
+	ADD r4, r4, r6
+	SBCO r4, CONST_PRUDRAM, r0, 8
+
+	QBBC arc_rise_1, rise_mask, 0
+	MOV params.fraction_1, r4
+arc_rise_1:
+	QBBC arc_rise_2, rise_mask, 1
+	MOV params.fraction_2, r4
+arc_rise_2:
+	QBBC arc_rise_3, rise_mask, 2
+	MOV params.fraction_3, r4
+arc_rise_3:
+	QBBC arc_rise_4, rise_mask, 3
+	MOV params.fraction_4, r4
+arc_rise_4:
+	QBBC arc_rise_5, rise_mask, 4
+	MOV params.fraction_5, r4
+arc_rise_5:
+	QBBC arc_rise_6, rise_mask, 5
+	MOV params.fraction_6, r4
+arc_rise_6:
+	QBBC arc_rise_7, rise_mask, 6
+	MOV params.fraction_7, r4
+arc_rise_7:
+	QBBC arc_rise_8, rise_mask, 7
+	MOV params.fraction_8, r4
+arc_rise_8:
+
+	QBBC arc_fall_1, fall_mask, 0
+	MOV params.fraction_1, r5
+arc_fall_1:
+	QBBC arc_fall_2, fall_mask, 1
+	MOV params.fraction_2, r5
+arc_fall_2:
+	QBBC arc_fall_3, fall_mask, 2
+	MOV params.fraction_3, r5
+arc_fall_3:
+	QBBC arc_fall_4, fall_mask, 3
+	MOV params.fraction_4, r5
+arc_fall_4:
+	QBBC arc_fall_5, fall_mask, 4
+	MOV params.fraction_5, r5
+arc_fall_5:
+	QBBC arc_fall_6, fall_mask, 5
+	MOV params.fraction_6, r5
+arc_fall_6:
+	QBBC arc_fall_7, fall_mask, 6
+	MOV params.fraction_7, r5
+arc_fall_7:
+	QBBC arc_fall_8, fall_mask, 7
+	MOV params.fraction_8, r5
+arc_fall_8:
+.endm
+
+;;; Store the initial rising and falling fraction of an arc segment.
+.macro StartArc
+.mparam params, rise_mask, fall_mask
+	QBBC arc_start_rise_1, rise_mask, 0
+	MOV r4, params.fraction_1
+arc_start_rise_1:
+	QBBC arc_start_rise_2, rise_mask, 1
+	MOV r4, params.fraction_2
+arc_start_rise_2:
+	QBBC arc_start_rise_3, rise_mask, 2
+	MOV r4, params.fraction_3
+arc_start_rise_3:
+	QBBC arc_start_rise_4, rise_mask, 3
+	MOV r4, params.fraction_4
+arc_start_rise_4:
+	QBBC arc_start_rise_5, rise_mask, 4
+	MOV r4, params.fraction_5
+arc_start_rise_5:
+	QBBC arc_start_rise_6, rise_mask, 5
+	MOV r4, params.fraction_6
+arc_start_rise_6:
+	QBBC arc_start_rise_7, rise_mask, 6
+	MOV r4, params.fraction_7
+arc_start_rise_7:
+	QBBC arc_start_rise_8, rise_mask, 7
+	MOV r4, params.fraction_8
+arc_start_rise_8:
+
+	QBBC arc_start_fall_1, fall_mask, 0
+	MOV r5, params.fraction_1
+arc_start_fall_1:
+	QBBC arc_start_fall_2, fall_mask, 1
+	MOV r5, params.fraction_2
+arc_start_fall_2:
+	QBBC arc_start_fall_3, fall_mask, 2
+	MOV r5, params.fraction_3
+arc_start_fall_3:
+	QBBC arc_start_fall_4, fall_mask, 3
+	MOV r5, params.fraction_4
+arc_start_fall_4:
+	QBBC arc_start_fall_5, fall_mask, 4
+	MOV r5, params.fraction_5
+arc_start_fall_5:
+	QBBC arc_start_fall_6, fall_mask, 5
+	MOV r5, params.fraction_6
+arc_start_fall_6:
+	QBBC arc_start_fall_7, fall_mask, 6
+	MOV r5, params.fraction_7
+arc_start_fall_7:
+	QBBC arc_start_fall_8, fall_mask, 7
+	MOV r5, params.fraction_8
+arc_start_fall_8:
+	MOV r0, ARC_STATE_OFFSET
+	SBCO r4, CONST_PRUDRAM, r0, 8
+.endm
+
+;;; Raster segments: all moving motors step with the same fraction, as the
+;;; fraction parameters are used for the pixels (fraction_1..6), the
+;;; increment of the pixel clock (fraction_7) and the aux bits the pixels
+;;; switch (fraction_8). After each loop the pixel clock advances; on
+;;; carry, the next pixel is read from the queue element and the aux bits
+;;; are set accordingly.
+;;; Pixel clock and pixel number are kept behind the arc state.
+;;; Uses r0, r1 and the scratch registers r4..r6; keeps r3.
+.macro RasterStep
+.mparam params
+	MOV r4, RASTER_MOTOR_FRACTION
+	ADD mstate.m1, mstate.m1, r4	; Motors not in r29.b0 don't step
+	ADD mstate.m2, mstate.m2, r4	; anyway, no need to skip them.
+	ADD mstate.m3, mstate.m3, r4
+	ADD mstate.m4, mstate.m4, r4
+	ADD mstate.m5, mstate.m5, r4
+	ADD mstate.m6, mstate.m6, r4
+	ADD mstate.m7, mstate.m7, r4
+	ADD mstate.m8, mstate.m8, r4
+
+	MOV r0, RASTER_STATE_OFFSET
+	LBCO r4, CONST_PRUDRAM, r0, 8	; r4 = pixel clock, r5 = pixel number
+	ADD r4, r4, params.fraction_7
+	QBLE raster_same_pixel, r4, params.fraction_7	; no carry
+	ADD r5, r5, 1
+	SBCO r4, CONST_PRUDRAM, r0, 8
+
+	;; r6 = byte containing the pixel, shifted to bit 0.
+	LSR r1, r5, 3
+	ADD r1, r1, r2
+	LBBO r6, r1, QUEUE_FIXED_SIZE, 1
+	AND r1, r5, 7
+	LSR r6, r6.b0, r1
+
+	;; Aux bits of the segment, with the pixel bits set or cleared.
+	LBBO r1, r2, SIZE(QueueHeader) + OFFSET(TravelParameters.aux), 2
+	QBBS raster_pixel_on, r6, 0
+	NOT r4, params.fraction_8
+	AND r1, r1, r4
+	QBA raster_set_aux
+raster_pixel_on:
+	OR r1, r1, params.fraction_8
+raster_set_aux:
+	MOV r0, r3			; SetAuxBits takes r3.
+	MOV r3, r1
+	CALL SetAuxBits
+	MOV r3, r0
+	QBA raster_done
+raster_same_pixel:
+	SBCO r4, CONST_PRUDRAM, r0, 4
+raster_done:
+.endm
+
+;;; Segments that stop at an input: read the watched GPIO and if it shows
+;;; the trigger level, report the loops done and end the segment right here.
+;;; The remaining loops of the segment are in the lower 24 bit of r28.
+;;; Uses r0 and the scratch registers r4..r6.
+.macro CheckInput
+	MOV r0, INPUT_WATCH_OFFSET
+	LBCO r4, CONST_PRUDRAM, r0, 12	; r4 = address, r5 = mask, r6 = level
+	LBBO r4, r4, 0, 4
+	AND r4, r4, r5
+	QBNE input_not_triggered, r4, r6
+
+	MOV r0, INPUT_TRIGGERED_OFFSET
+	LBCO r4, CONST_PRUDRAM, r0, 8	; r4 = triggered, r5 = loops
+	MOV r4, 1
+	MOV r6, 0x00ffffff
+	AND r6, r28, r6
+	SUB r5, r5, r6			; Counted all of them at segment start.
+	SBCO r4, CONST_PRUDRAM, r0, 8
+
+	;; Nothing left to do in this segment.
+	MOV r28.w0, 0
+	MOV r28.b2, 0
+	MOV r0, 0
+	SBCO r28, CONST_PRUDRAM, r0, 4
+	JMP SKIP_SEGMENT
+input_not_triggered:
 .endm
 
 ;;; This macro decrease the counter that holds the overall number of loops left
@@ -179,6 +341,84 @@ DONE_CALCULATE_DELAY:
 	SUB r1, r1, (4 / 2) ; Subtract the loops consumed for this macro.
 .endm
 
+;;; Apply the speed override of the host to the delay in r1: it is
+;;; stretched by SPEED_SCALE_ONE / SpeedScale.current. Until current is at
+;;; the target, it moves towards it by ramp for each ramp_tick of time, as
+;;; counted in ramp_time by the loops of the ramp. At a current of zero, the
+;;; motors are held after this loop (see SPEED_HOLD). At full speed, this
+;;; costs a few cycles. Uses r0, r4..r6.
+;;; Only used once, so just macro.
+.macro ScaleDelay
+	SUB r1, r1, (10 / 2)		; Cycles spent here at full speed.
+	LBCO r4, CONST_PRUDRAM, SPEED_SCALE_OFFSET, 6 ; r4.w0 current, w2 target
+	QBEQ speed_steady, r4.w0, r4.w2		      ; r5.w0 ramp
+	LBCO r6, CONST_PRUDRAM, SPEED_SCALE_OFFSET + OFFSET(SpeedScale.ramp_time), 4
+	LBCO r0, CONST_PRUDRAM, SPEED_SCALE_OFFSET + OFFSET(SpeedScale.ramp_tick), 4
+speed_tick:
+	QBGT speed_store, r6, r0		; Less than a tick since the last change.
+	SUB r6, r6, r0
+	QBLT speed_up, r4.w2, r4.w0
+	SUB r5.w2, r4.w0, r4.w2
+	QBGE speed_at_target, r5.w2, r5.w0
+	SUB r4.w0, r4.w0, r5.w0
+	QBLE speed_tick, r4.w0, SPEED_SCALE_MIN
+	QBA speed_at_target			; Slow enough to stop.
+speed_up:
+	SUB r5.w2, r4.w2, r4.w0
+	QBGE speed_at_target, r5.w2, r5.w0
+	ADD r4.w0, r4.w0, r5.w0
+	QBLE speed_tick, r4.w0, SPEED_SCALE_MIN
+	MOV r4.w0, SPEED_SCALE_MIN		; Start at the slowest speed.
+	QBA speed_tick
+speed_at_target:
+	MOV r4.w0, r4.w2
+	MOV r6, 0				; The next ramp starts afresh.
+speed_store:
+	SBCO r4.w0, CONST_PRUDRAM, SPEED_SCALE_OFFSET, 2
+	SBCO r6, CONST_PRUDRAM, SPEED_SCALE_OFFSET + OFFSET(SpeedScale.ramp_time), 4
+	QBEQ speed_hold, r4.w0, 0
+	MOV r6, SPEED_SCALE_ONE
+	QBEQ speed_count, r4.w0, r6
+	QBA speed_scale
+speed_steady:
+	QBEQ speed_hold, r4.w0, 0
+	MOV r6, SPEED_SCALE_ONE
+	QBEQ speed_scaled, r4.w0, r6
+speed_scale:
+	;; r1 = (r1 << SPEED_SCALE_SHIFT) / current. Long delays would
+	;; overflow; these are divided first.
+	MOV r5, r4.w0
+	MOV r6, 0x100000
+	QBLE speed_long_delay, r1, r6
+	LSL r1, r1, SPEED_SCALE_SHIFT
+	idiv_macro r1, r5, r6
+	QBA speed_correct
+speed_long_delay:
+	idiv_macro r1, r5, r6
+	MOV r6, 0x100000
+	QBLT speed_shift, r6, r1
+	MOV r1, 0xfffff			; Longest delay we can do.
+speed_shift:
+	LSL r1, r1, SPEED_SCALE_SHIFT
+speed_correct:
+	;; Subtract the cycles spent here, but keep some delay to count down.
+	QBLT speed_correct_sub, r1, SCALE_DELAY_CYCLES + 4
+	MOV r1, SCALE_DELAY_CYCLES + 4
+speed_correct_sub:
+	SUB r1, r1, SCALE_DELAY_CYCLES
+speed_count:
+	;; While ramping, count the time of this loop, about.
+	QBEQ speed_scaled, r4.w0, r4.w2
+	LBCO r6, CONST_PRUDRAM, SPEED_SCALE_OFFSET + OFFSET(SpeedScale.ramp_time), 4
+	ADD r6, r6, r1
+	ADD r6, r6, SCALE_DELAY_CYCLES + LOOP_BASE_CYCLES
+	SBCO r6, CONST_PRUDRAM, SPEED_SCALE_OFFSET + OFFSET(SpeedScale.ramp_time), 4
+	QBA speed_scaled
+speed_hold:
+	JMP SPEED_HOLD
+speed_scaled:
+.endm
+
 INIT:
 	;; Clear STANDBY_INIT in SYSCFG register.
 	LBCO r0, C4, 4, 4
@@ -195,11 +435,22 @@ QUEUE_READ:
 	;;
 
 	;; Check queue header at our read-position until it contains something.
-	.assign QueueHeader, r1.w0, r1.w0, queue_header
+	.assign QueueHeader, r1, r1, queue_header
 	LBCO queue_header, CONST_PRUDRAM, r2, SIZE(queue_header)
 	QBEQ QUEUE_READ, queue_header.state, STATE_EMPTY ; wait until got data.
 
-	QBEQ FINISH, queue_header.state, STATE_EXIT
+	;; FINISH is too far away for a quick branch.
+	QBNE QUEUE_ELEMENT, queue_header.state, STATE_EXIT
+	JMP FINISH
+QUEUE_ELEMENT:
+
+	;; Remember which motors are active, so that the step loop only needs
+	;; to deal with these.
+	MOV r29.b0, queue_header.motor_mask
+	AND r29.b1, queue_header.motor_mask, 0xf0
+	QBEQ RASTER_CHECK_DONE, queue_header.raster, 0
+	SET r29.b1, r29.b1, 0		; Raster segment: bit 0 of r29.b1.
+RASTER_CHECK_DONE:
 
 	;; Set direction bits
 	MOV r3, queue_header.direction_bits
@@ -208,36 +459,111 @@ QUEUE_READ:
 	;; queue_header processed, r1 is free to use
 	ADD r1, r2, SIZE(QueueHeader) ; r2 stays at queue pos
 	.assign TravelParameters, PARAM_START, PARAM_END, travel_params
-	LBCO travel_params, CONST_PRUDRAM, r1, SIZE(travel_params)
+	LBCO travel_params, CONST_PRUDRAM, r1, QUEUE_TIMING_SIZE
 
 	;; Set the Aux bits
 	MOV r3, travel_params.aux
 	CALL SetAuxBits
 
+	;; Arc parameters: rising and falling motors go to r29.b2 and r29.b3;
+	;; the aux bits are set, so the shift can live in their place.
+	ADD r0, r1, QUEUE_TIMING_SIZE
+	LBCO r29.w2, CONST_PRUDRAM, r0, 2
+	ADD r0, r0, 2
+	LBCO r4, CONST_PRUDRAM, r0, 2	; r4.b0 = shift, r4.b1 = stop_on_input
+	MOV travel_params.aux, r4.b0
+	QBEQ INPUT_FLAG_DONE, r4.b1, 0
+	SET r29.b1, r29.b1, 1		; Stop at input: bit 1 of r29.b1.
+INPUT_FLAG_DONE:
+
+	;; High bits of the loop counters; CalculateDelay counts these down
+	;; in a copy.
+	ADD r0, r0, 2
+	LBCO r4, CONST_PRUDRAM, r0, SIZE(LoopsHigh)
+	MOV r5, LOOPS_HIGH_OFFSET
+	SBCO r4, CONST_PRUDRAM, r5, SIZE(LoopsHigh)
+
+	;; The fractions follow; only the ones of the active motors, unless
+	;; this is a raster segment. Reading all eight stays within the queue.
+	ADD r0, r0, SIZE(LoopsHigh)
+	LBCO travel_params.fraction_1, CONST_PRUDRAM, r0, 4 * 8
+	QBBS FRACTIONS_UNPACKED, r29.b1, 0
+	UnpackFractions travel_params, r29.b0
+FRACTIONS_UNPACKED:
+	QBEQ ARC_START_DONE, r29.w2, 0
+	StartArc travel_params, r29.b2, r29.b3
+ARC_START_DONE:
+
+	;; Raster segments: the first loop brings the pixel clock to zero and
+	;; pixel number -1 to pixel 0.
+	QBBC RASTER_START_DONE, r29.b1, 0
+	RSB r4, travel_params.fraction_7, 0
+	FILL &r5, 4
+	MOV r0, RASTER_STATE_OFFSET
+	SBCO r4, CONST_PRUDRAM, r0, 8
+RASTER_START_DONE:
+
+	;; Segments that stop at an input are skipped once it triggered.
+	;; Otherwise, count all their loops; we subtract the ones not done
+	;; if the input triggers.
+	QBBC INPUT_START_DONE, r29.b1, 1
+	MOV r0, INPUT_WATCH_OFFSET + 4
+	LBCO r4, CONST_PRUDRAM, r0, 4	; mask
+	QBNE input_watched, r4, 0
+	CLR r29.b1, r29.b1, 1		; Not watching anything.
+	QBA INPUT_START_DONE
+input_watched:
+	MOV r0, INPUT_TRIGGERED_OFFSET
+	LBCO r4, CONST_PRUDRAM, r0, 8	; r4 = triggered, r5 = loops
+	QBEQ input_not_triggered_yet, r4, 0
+	JMP SKIP_SEGMENT		; Too far for a quick branch.
+input_not_triggered_yet:
+	ADD r5, r5, travel_params.loops_accel
+	ADD r5, r5, travel_params.loops_travel
+	ADD r5, r5, travel_params.loops_decel
+	MOV r6, LOOPS_HIGH_OFFSET + OFFSET(LoopsHigh.total)
+	LBCO r6, CONST_PRUDRAM, r6, 1
+	LSL r6, r6.b0, 16
+	ADD r5, r5, r6
+	SBCO r4, CONST_PRUDRAM, r0, 8
+INPUT_START_DONE:
+
 	ZERO &mstate, SIZE(mstate)	; clear the motor states
 	ZERO &r3, 4			; initialize delay calculation state register.
 
 	;; STATUS REGISTER
 	;; ! We are assuming that writing the 4 bytes status register is atomic
 	;; and we guarantee that the bottom three bytes are all zero so we just need
-	;; to sum up the 3 loop counters. The upper bound of this sum will always be
-	;; less than 2^18, thus fit in the lower 24 bits allocated for it.
+	;; to sum up the 3 loop counters. The host keeps this sum below 2^24,
+	;; thus it fits in the lower 24 bits allocated for it.
 	;; At each loop executed this counter is decreased of one unit.
 	ADD r28, r28, travel_params.loops_accel
 	ADD r28, r28, travel_params.loops_travel
 	ADD r28, r28, travel_params.loops_decel
+	MOV r0, LOOPS_HIGH_OFFSET + OFFSET(LoopsHigh.total)
+	LBCO r4, CONST_PRUDRAM, r0, 1
+	ADD r28.b2, r28.b2, r4.b0
 
 	MOV r0, 0 ; Status register address in PRU memory.
 	SBCO r28, CONST_PRUDRAM, r0, 4
+	JMP STEP_GEN
+
+	;; Close to STEP_GEN, to be in reach of a quick branch from there.
+RASTER_STEP:
+	RasterStep travel_params
+	JMP ARC_DONE
 
 	;; Registers
-	;; r0, r1 free for calculation
+	;; r0, r1 free for calculation (r0 is scratch for RotateArc)
 	;; r2 = queue pos
-	;; r3 = state for CalculateDelay
-	;; scratch:           r4..r6
+	;; r3 = state for CalculateDelay (not used in dual PRU mode)
+	;; scratch:           r4..r6 (r5, r6 also in CalculateDelay, ScaleDelay)
 	;; parameter:         r7..r19
 	;; motor-state:       r20..r27
 	;; status-variable:   r28
+	;; active motors:     r29.b0 (motor_mask), r29.b1 (any of motor 5..8;
+	;;                    bit 0: raster segment; bit 1: stop at input)
+	;; arc motors:        r29.b2 (rising), r29.b3 (falling)
 	;; call/ret:          r30
 STEP_GEN:
 	;;
@@ -246,20 +572,38 @@ STEP_GEN:
 
 	;;; Update the state registers with the 1.31 resolution fraction.
 	;;; The 31st bit contains the overflow that causes a step.
+	;;; Fractions of inactive motors are zero; skip the upper ones if
+	;;; all of them are inactive (typical machines have <= 4 motors).
+	QBBC INPUT_CHECK_DONE, r29.b1, 1
+	CheckInput
+INPUT_CHECK_DONE:
+	QBBS RASTER_STEP, r29.b1, 0	; Raster segments have their own.
 	ADD mstate.m1, mstate.m1, travel_params.fraction_1
 	ADD mstate.m2, mstate.m2, travel_params.fraction_2
 	ADD mstate.m3, mstate.m3, travel_params.fraction_3
 	ADD mstate.m4, mstate.m4, travel_params.fraction_4
+	QBEQ FRACTIONS_DONE, r29.b1, 0
 	ADD mstate.m5, mstate.m5, travel_params.fraction_5
 	ADD mstate.m6, mstate.m6, travel_params.fraction_6
 	ADD mstate.m7, mstate.m7, travel_params.fraction_7
 	ADD mstate.m8, mstate.m8, travel_params.fraction_8
+FRACTIONS_DONE:
+
+	;; Arcs: turn the fractions for the next loop.
+	QBEQ ARC_DONE, r29.w2, 0
+	RotateArc travel_params, r29.b2, r29.b3
+ARC_DONE:
 
-	;; Set the step bits (Need to check timing)
+	;; Set the step bits of the active motors (r29.b0).
 	CALL SetSteps
 
-	CalculateDelay r1, travel_params, r3, r5, r6
+#ifdef DUAL_PRU
+	CALL ReadDelay			; Calculated by the other PRU.
+#else
+	CalculateDelay r1, travel_params, r3, r5, r6, LOOPS_HIGH_OFFSET
+#endif
 	QBEQ DONE_STEP_GEN, r1, 0       ; special value 0: all steps consumed.
+	ScaleDelay
 	UpdateQueueStatus
 STEP_DELAY:				; Create time delay between steps.
 	SUB r1, r1, 1                   ; two cycles per loop.
@@ -267,20 +611,59 @@ STEP_DELAY:				; Create time delay between steps.
 
 	JMP STEP_GEN
 
+	;; Feed hold (see ScaleDelay): this loop is done as far as the host
+	;; sees, the motors stay where they are until it sets a target again.
+	;; Then the rest of the delay is the one of the slowest speed.
+SPEED_HOLD:
+	UpdateQueueStatus
+SPEED_HOLD_WAIT:
+	MOV r6, SPEED_HOLD_POLL
+SPEED_HOLD_DELAY:
+	SUB r6, r6, 1
+	QBNE SPEED_HOLD_DELAY, r6, 0
+	LBCO r4, CONST_PRUDRAM, SPEED_SCALE_OFFSET, 4
+	QBEQ SPEED_HOLD_WAIT, r4.w2, 0
+	MOV r4.w0, SPEED_SCALE_MIN
+	SBCO r4.w0, CONST_PRUDRAM, SPEED_SCALE_OFFSET, 2
+	MOV r6, 1 << (32 - SPEED_SCALE_SHIFT + SPEED_SCALE_MIN_SHIFT)
+	QBLT SPEED_HOLD_SCALE, r6, r1
+	MOV r1, (1 << (32 - SPEED_SCALE_SHIFT + SPEED_SCALE_MIN_SHIFT)) - 1
+SPEED_HOLD_SCALE:
+	LSL r1, r1, SPEED_SCALE_SHIFT - SPEED_SCALE_MIN_SHIFT
+	JMP STEP_DELAY
+
+SKIP_SEGMENT:				; Ending a segment early.
+#ifdef DUAL_PRU
+	CALL ReadDelay			; Drop the delays of the rest of it.
+	QBNE SKIP_SEGMENT, r1, 0
+#endif
+
 DONE_STEP_GEN:
+	;; Raster segments leave the aux bits of the last pixel; go back to
+	;; the ones of the segment.
+	QBBC RASTER_END_DONE, r29.b1, 0
+	LBBO r3, r2, SIZE(QueueHeader) + OFFSET(TravelParameters.aux), 2
+	CALL SetAuxBits
+RASTER_END_DONE:
+
 	;; We are done with instruction. Mark slot as empty...
+	LBCO queue_header, CONST_PRUDRAM, r2, SIZE(queue_header)
+	QueueElementSize r0, queue_header
 	MOV queue_header.state, STATE_EMPTY
 	SBCO queue_header.state, CONST_PRUDRAM, r2, 1
 	MOV R31.b0, PRU0_ARM_INTERRUPT+16 ; signal host program free slot.
 
 	;; Next position in ring buffer
-	ADD r2, r2, QUEUE_ELEMENT_SIZE
+	ADD r2, r2, r0
 	ADD r28.b3, r28.b3, 1                  ; add + 1 to the MSB byte
-	MOV r1, QUEUE_LEN * QUEUE_ELEMENT_SIZE ; end-of-queue
-	QBLT QUEUE_READ, r1, r2
-	MOV r2, QUEUE_OFFSET
+	QBNE QUEUE_INDEX_DONE, r28.b3, QUEUE_LEN
 	ZERO &r28, 4
-	JMP QUEUE_READ
+QUEUE_INDEX_DONE:
+	MOV r1, QUEUE_LAST_OFFSET              ; room for the largest element?
+	QBLE QUEUE_POS_DONE, r1, r2
+	MOV r2, QUEUE_OFFSET
+QUEUE_POS_DONE:
+	JMP QUEUE_READ			; Too far for a quick branch.
 
 FINISH:
 	MOV queue_header.state, STATE_EMPTY
@@ -289,6 +672,29 @@ FINISH:
 
 	HALT
 
+;;; Dual PRU mode: the other PRU (motor-interface-pru1.p) calculates the
+;;; delays of all loops ahead and passes them through a FIFO in the shared
+;;; RAM, followed by 0 at the end of each segment. Returns the next one in
+;;; r1, corrected by the cycles spent here, waiting if the other PRU did
+;;; not catch up yet. Uses r0 and the scratch registers r4..r6.
+#ifdef DUAL_PRU
+ReadDelay:
+	MOV r0, PRU_SHARED_RAM
+read_delay_wait:
+	LBBO r4, r0, 0, 8		; r4 = write index, r5 = read index
+	QBEQ read_delay_wait, r4, r5
+	AND r6, r5, DELAY_FIFO_LEN - 1
+	LSL r6, r6, 2
+	ADD r6, r6, DELAY_FIFO_OFFSET
+	LBBO r1, r0, r6, 4
+	ADD r5, r5, 1
+	SBBO r5, r0, 4, 4
+	QBEQ read_delay_done, r1, 0
+	SUB r1, r1, READ_DELAY_CYCLES / 2
+read_delay_done:
+	RET
+#endif
+
 ;;; This include file needs to provide the subroutines
 ;;;    SetAuxBits
 ;;;    SetDirections
@@ -0,0 +1,103 @@
+;; -*- asm -*-
+;;
+;; (c) 2016 Henner Zeller <h.zeller@acm.org>
+;;
+;; This file is part of BeagleG. http://github.com/hzeller/beagleg
+;;
+;; BeagleG is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+;;
+;; BeagleG is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+;;
+;; You should have received a copy of the GNU General Public License
+;; along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Program of PRU1 in dual PRU mode (DUAL_PRU in the Makefile).
+;;;
+;;; Follows the queue the host fills in the data RAM of PRU0 and calculates
+;;; the delay of each loop of the segments ahead of time. These are passed
+;;; to PRU0 through a FIFO in the shared RAM, followed by 0 at the end of
+;;; each segment. That way, PRU0 does not spend the cycles of the division
+;;; in its step loop.
+;;;
+;;; We only read the queue; PRU0 marks the elements done and tells the host.
+;;; If PRU0 ends a segment early, it drops the rest of its delays. As each
+;;; segment needs at least two entries in the FIFO, we can never be more
+;;; than DELAY_FIFO_LEN / 2 elements ahead of PRU0 in the queue.
+
+#define DELAY_CALCULATED_AHEAD
+
+#include "motor-interface-constants.h"
+#include "motor-interface-queue.hp"
+
+.origin 0
+.entrypoint INIT
+
+#define CONST_PRU0_DRAM	   C25		; The other PRU's data RAM.
+
+;; In our own data RAM: LoopsHigh of the current segment, counting down.
+#define LOOPS_HIGH_OFFSET 0
+
+;; Registers
+;; r1 = queue header, then delay
+;; r2 = queue pos
+;; r3 = state for CalculateDelay
+;; scratch:           r4..r6
+;; parameter:         r7..r19
+;; shared RAM:        r20
+;; FIFO write index:  r21
+;; element size:      r22
+INIT:
+	MOV r2, QUEUE_OFFSET
+	MOV r20, PRU_SHARED_RAM
+	MOV r21, 0			; The host cleared the FIFO.
+
+QUEUE_READ:
+	.assign QueueHeader, r1, r1, queue_header
+	LBCO queue_header, CONST_PRU0_DRAM, r2, SIZE(queue_header)
+	QBEQ QUEUE_READ, queue_header.state, STATE_EMPTY ; wait until got data.
+
+	QBEQ FINISH, queue_header.state, STATE_EXIT
+
+	;; Before PRU0 is done with it and the host reuses the memory.
+	QueueElementSize r22, queue_header
+	ADD r1, r2, SIZE(QueueHeader)
+	.assign TravelParameters, PARAM_START, PARAM_END, travel_params
+	LBCO travel_params, CONST_PRU0_DRAM, r1, QUEUE_TIMING_SIZE
+	ADD r4, r1, QUEUE_TIMING_SIZE + SIZE(ArcParameters)
+	LBCO r5, CONST_PRU0_DRAM, r4, SIZE(LoopsHigh)
+	MOV r4, LOOPS_HIGH_OFFSET
+	SBCO r5, C24, r4, SIZE(LoopsHigh)
+	ZERO &r3, 4			; initialize delay calculation state register.
+
+DELAY_GEN:
+	CalculateDelay r1, travel_params, r3, r5, r6, LOOPS_HIGH_OFFSET
+
+FIFO_WAIT:				; Until there is room in the FIFO.
+	LBBO r4, r20, 4, 4		; read index of PRU0
+	SUB r4, r21, r4
+	QBLE FIFO_WAIT, r4, DELAY_FIFO_LEN
+
+	AND r4, r21, DELAY_FIFO_LEN - 1
+	LSL r4, r4, 2
+	ADD r4, r4, DELAY_FIFO_OFFSET
+	SBBO r1, r20, r4, 4
+	ADD r21, r21, 1
+	SBBO r21, r20, 0, 4		; Publish once the delay is written.
+
+	QBNE DELAY_GEN, r1, 0		; 0: end of segment.
+
+	;; Next position in ring buffer
+	ADD r2, r2, r22
+	MOV r1, QUEUE_LAST_OFFSET	; room for the largest element?
+	QBLE QUEUE_READ, r1, r2
+	MOV r2, QUEUE_OFFSET
+	JMP QUEUE_READ
+
+FINISH:
+	HALT
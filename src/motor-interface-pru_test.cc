@@ -0,0 +1,666 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the PRU firmware motor-interface-pru.p: assembled with the
+ * PruAssembler and run in the PruEmulator, driven by the PRUMotionQueue.
+ *
+ * Cycle counts are the ones of the emulator's timing model; they don't
+ * replace a measurement on the BeagleBone, but show what a change in the
+ * firmware costs.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "hardware-mapping.h"
+#include "motion-queue.h"
+#include "motor-interface-constants.h"
+#include "motor-operations.h"
+#include "pru-assembler.h"
+#include "pru-emulator.h"
+
+namespace {
+// Instruction RAM of each PRU: 8KiB.
+enum { PRU_INSTRUCTION_WORDS = 2048 };
+
+// Where the PRU reads the SpeedScale, its current first: behind the status
+// register (see motor-interface-queue.hp).
+enum { SPEED_SCALE_ADDRESS = 4 };
+
+// The mode the host is compiled for; the LOOP_*_CYCLES are for that one.
+#ifdef DUAL_PRU
+static constexpr bool kDualPru = true;
+#else
+static constexpr bool kDualPru = false;
+#endif
+
+// Firmware "file" for the cape we compile for; the default BUMPS cape has
+// all motors mapped.
+const PruAssembler *AssembleFirmware(const char *file, bool dual_pru) {
+  PruAssembler *assembler = new PruAssembler();
+  assembler->AddIncludeDir(std::string("../hardware/") + CAPE_NAME);
+  assembler->Define("QUEUE_LEN", std::to_string(QUEUE_LEN));
+  if (dual_pru) assembler->Define("DUAL_PRU");
+  if (!assembler->AssembleFile(file))
+    fprintf(stderr, "Can't assemble %s\n", file);
+  return assembler;
+}
+
+// The program of PRU0, alone or with PRU1 calculating the delays.
+const PruAssembler &Firmware(bool dual_pru = false) {
+  static const PruAssembler *const single =
+    AssembleFirmware("motor-interface-pru.p", false);
+  static const PruAssembler *const dual =
+    AssembleFirmware("motor-interface-pru.p", true);
+  return dual_pru ? *dual : *single;
+}
+
+// The program of PRU1 in dual PRU mode.
+const PruAssembler &Pru1Firmware() {
+  static const PruAssembler *const pru1 =
+    AssembleFirmware("motor-interface-pru1.p", true);
+  return *pru1;
+}
+
+// The status register, as the PRU writes it in each loop.
+struct StatusUpdate {
+  uint64_t cycle;
+  uint32_t loops_left;
+  uint32_t delay;      // The delay loop count at that time, in r1.
+};
+
+class FirmwareTest : public ::testing::Test {
+protected:
+  void SetUp() override { Start(kDualPru); }
+
+  void Start(bool dual_pru) {
+    const std::vector<uint32_t> &program = Firmware(dual_pru).program();
+    ASSERT_FALSE(program.empty());
+    if (dual_pru) {
+      const std::vector<uint32_t> &pru1_program = Pru1Firmware().program();
+      ASSERT_FALSE(pru1_program.empty());
+      pru_.reset(new EmulatedPruInterface(program.data(), program.size(),
+                                          pru1_program.data(),
+                                          pru1_program.size()));
+    } else {
+      pru_.reset(new EmulatedPruInterface(program.data(), program.size()));
+    }
+    emulator()->SetStoreObserver([this](uint32_t address, int bytes) {
+        if (address != 0 || bytes != 4) return;
+        uint32_t status;
+        memcpy(&status, emulator()->data_ram(), sizeof(status));
+        updates_.push_back({ emulator()->cycles(), status & 0xffffff,
+                             emulator()->reg(1) });
+      });
+    emulator()->SetBusWriteObserver([this](uint32_t address, uint32_t value) {
+        FollowOutputs(address, value);
+      });
+    queue_.reset(new PRUMotionQueue(&hardware_, pru_.get()));
+  }
+
+  void TearDown() override {
+    if (queue_) queue_->Shutdown(true);
+  }
+
+  PruEmulator *emulator() { return pru_->emulator(); }
+
+  // Run "segment" and return the status updates of its loops.
+  std::vector<StatusUpdate> Run(const MotionSegment &segment) {
+    updates_.clear();
+    MotionSegment copy = segment;
+    queue_->Enqueue(&copy);
+    queue_->WaitQueueEmpty();
+    return updates_;
+  }
+
+  // Cycles of each loop of the segment besides the delay it counts down,
+  // from the second loop on. The first one ends setting up the segment.
+  std::vector<uint64_t> LoopOverhead(const MotionSegment &segment) {
+    const uint32_t loops = (segment.loops_accel + segment.loops_travel
+                            + segment.loops_decel);
+    const std::vector<StatusUpdate> updates = Run(segment);
+    std::vector<uint64_t> result;
+    for (size_t i = 1; i < updates.size(); ++i) {
+      const StatusUpdate &previous = updates[i-1];
+      if (previous.loops_left >= loops
+          || updates[i].loops_left + 1 != previous.loops_left)
+        continue;
+      // Two cycles per count; UpdateQueueStatus subtracts two more after
+      // writing the status.
+      const uint64_t delay_cycles = 2 * (previous.delay - 2);
+      result.push_back(updates[i].cycle - previous.cycle - delay_cycles);
+    }
+    return result;
+  }
+
+  // Follow the GPIO writes to count the step pulses of each motor and to
+  // record the changes of AUX_1 with the steps of motor 1 at that time.
+  void FollowOutputs(uint32_t address, uint32_t value) {
+    static const uint32_t kStepPins[MOTION_MOTOR_COUNT] = {
+      MOTOR_1_STEP_GPIO, MOTOR_2_STEP_GPIO, MOTOR_3_STEP_GPIO,
+      MOTOR_4_STEP_GPIO, MOTOR_5_STEP_GPIO, MOTOR_6_STEP_GPIO,
+      MOTOR_7_STEP_GPIO, MOTOR_8_STEP_GPIO,
+    };
+    const uint32_t reg = address & 0xfff;
+    if (reg != GPIO_SETDATAOUT && reg != GPIO_CLEARDATAOUT) return;
+    const bool high = (reg == GPIO_SETDATAOUT);
+    auto is_pin = [address, value](uint32_t gpio_def) {
+      return ((gpio_def & 0xfffff000) == (address & 0xfffff000)
+              && (value & (1u << (gpio_def & 0x1f))) != 0);
+    };
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      if (!is_pin(kStepPins[i])) continue;
+      if (high && !step_high_[i]) ++pulses_[i];
+      step_high_[i] = high;
+    }
+    if (is_pin(AUX_1_GPIO) && high != aux_1_high_) {
+      aux_1_changes_.push_back(pulses_[0]);
+      aux_1_high_ = high;
+    }
+  }
+
+  static uint64_t Max(const std::vector<uint64_t> &values) {
+    uint64_t result = 0;
+    for (uint64_t v : values) result = std::max(result, v);
+    return result;
+  }
+
+  HardwareMapping hardware_;  // Unconfigured: nothing to switch.
+  std::unique_ptr<EmulatedPruInterface> pru_;
+  std::unique_ptr<PRUMotionQueue> queue_;
+  std::vector<StatusUpdate> updates_;
+  bool step_high_[MOTION_MOTOR_COUNT] = {};
+  int pulses_[MOTION_MOTOR_COUNT] = {};
+  bool aux_1_high_ = false;
+  std::vector<int> aux_1_changes_;  // Motor 1 steps at each change.
+};
+
+// Travel segment of "motors" motors stepping at the highest rate: all of
+// them finish a step in the same loop, which is the most expensive.
+MotionSegment TravelSegment(int motors, uint32_t loops, uint32_t delay) {
+  MotionSegment segment = {};
+  segment.state = STATE_FILLED;
+  segment.motor_mask = (1 << motors) - 1;
+  segment.loops_travel = loops;
+  segment.travel_delay_cycles = delay;
+  for (int i = 0; i < motors; ++i) {
+    segment.fractions[i] = 0x7fffffff;
+  }
+  return segment;
+}
+
+// Arc segment of "motors" motors, alternating rising and falling, at 45
+// degrees and the highest rate. It turns slowly enough that they all keep
+// stepping in the same loop.
+MotionSegment ArcSegment(int motors, uint32_t loops, uint32_t delay) {
+  MotionSegment segment = TravelSegment(motors, loops, delay);
+  segment.arc_shift = 24;
+  for (int i = 0; i < motors; ++i) {
+    segment.fractions[i] = 0x7f000000;
+    if (i % 2 == 0)
+      segment.arc_rise_mask |= 1 << i;
+    else
+      segment.arc_fall_mask |= 1 << i;
+  }
+  return segment;
+}
+
+// Raster segment of "motors" motors, with a pixel clock that advances by
+// "pixel_clock" in each loop. The pixels alternate, so that each new one
+// switches AUX_1.
+MotionSegment RasterSegment(int motors, uint32_t loops, uint32_t delay,
+                            uint32_t pixel_clock) {
+  MotionSegment segment = TravelSegment(motors, loops, delay);
+  segment.raster = 1;
+  for (int i = 0; i < RASTER_PIXEL_WORDS; ++i) {
+    segment.fractions[i] = 0x55555555;
+  }
+  segment.fractions[RASTER_PIXEL_WORDS] = pixel_clock;
+  segment.fractions[RASTER_PIXEL_WORDS + 1] = 1;  // AUX_1
+  return segment;
+}
+
+// Passes everything on to the PRUMotionQueue, counting the arc and raster
+// segments.
+class SegmentCountingQueue : public MotionQueue {
+public:
+  explicit SegmentCountingQueue(MotionQueue *delegate) : delegate_(delegate) {}
+
+  void Enqueue(MotionSegment *segment) final {
+    if (segment->arc_shift) ++arc_segments_;
+    if (segment->raster) ++raster_segments_;
+    delegate_->Enqueue(segment);
+  }
+  void WaitQueueEmpty() final { delegate_->WaitQueueEmpty(); }
+  bool HasFreeSlots(int count) final { return delegate_->HasFreeSlots(count); }
+  bool GetStepCounters(int32_t counters[MOTION_MOTOR_COUNT]) final {
+    return delegate_->GetStepCounters(counters);
+  }
+  void MotorEnable(bool on) final { delegate_->MotorEnable(on); }
+  void Shutdown(bool flush_queue) final { delegate_->Shutdown(flush_queue); }
+  int GetPendingElements(uint32_t *head_item_progress) final {
+    return delegate_->GetPendingElements(head_item_progress);
+  }
+
+  int arc_segments() const { return arc_segments_; }
+  int raster_segments() const { return raster_segments_; }
+
+private:
+  MotionQueue *const delegate_;
+  int arc_segments_ = 0;
+  int raster_segments_ = 0;
+};
+
+// The tests of the behavior, for both the single and dual PRU mode.
+class SingleAndDualPruTest : public FirmwareTest,
+                             public ::testing::WithParamInterface<bool> {
+protected:
+  void SetUp() override { Start(GetParam()); }
+};
+
+// PRU0 running with PRU1 calculating the delays.
+class DualPruTest : public FirmwareTest {
+protected:
+  void SetUp() override { Start(true); }
+};
+
+// Cost of a loop as the host assumes it (see hardware_frequency_limit()),
+// in cycles.
+int AssumedLoopCycles(int base, int per_motor, int motors) {
+  return 2 * (base + per_motor * motors);
+}
+}  // namespace
+
+TEST_P(SingleAndDualPruTest, FitsInstructionRam) {
+  EXPECT_LE(Firmware(GetParam()).program().size(),
+            (size_t)PRU_INSTRUCTION_WORDS);
+  if (GetParam()) {
+    EXPECT_LE(Pru1Firmware().program().size(), (size_t)PRU_INSTRUCTION_WORDS);
+  }
+}
+
+TEST_P(SingleAndDualPruTest, TravelLoopTiming) {
+  const std::vector<StatusUpdate> updates = Run(TravelSegment(2, 100, 5000));
+  ASSERT_EQ(101u, updates.size());  // Start of the segment, then each loop.
+  // The delay asked for, plus the part of the loop overhead the firmware
+  // does not subtract: it only knows about its delay calculation.
+  const uint64_t period = updates[50].cycle - updates[49].cycle;
+  EXPECT_GE(period, 2 * 5000u);
+  EXPECT_LT(period, 2 * 5000u + AssumedLoopCycles(LOOP_BASE_CYCLES,
+                                                  LOOP_MOTOR_CYCLES, 2));
+}
+
+// The LOOP_*_CYCLES constants are the cost of the step loop measured here:
+// the smallest values that cover each number of motors.
+TEST_F(FirmwareTest, LoopCyclesOfLinearSegments) {
+  uint64_t overhead[MOTION_MOTOR_COUNT + 1] = {};
+  for (int motors = 1; motors <= MOTION_MOTOR_COUNT; ++motors) {
+    overhead[motors] = Max(LoopOverhead(TravelSegment(motors, 64, 1000)));
+    fprintf(stderr, "%d motors: %llu cycles\n", motors,
+            (unsigned long long)overhead[motors]);
+  }
+  auto covered = [&](int base, int per_motor) {
+    for (int motors = 1; motors <= MOTION_MOTOR_COUNT; ++motors) {
+      if ((int)overhead[motors] > AssumedLoopCycles(base, per_motor, motors))
+        return false;
+    }
+    return true;
+  };
+  EXPECT_TRUE(covered(LOOP_BASE_CYCLES, LOOP_MOTOR_CYCLES));
+  EXPECT_FALSE(covered(LOOP_BASE_CYCLES - 1, LOOP_MOTOR_CYCLES));
+  EXPECT_FALSE(covered(LOOP_BASE_CYCLES, LOOP_MOTOR_CYCLES - 1));
+}
+
+// The host simulates the integer rotation of the firmware to know where an
+// arc ends, and corrects the last steps in a linear segment. If the two
+// differed, we'd not end up at the requested steps.
+TEST_P(SingleAndDualPruTest, ArcEndsAtTheRequestedSteps) {
+  SegmentCountingQueue counting_queue(queue_.get());
+  MotionQueueMotorOperations motor_operations(&hardware_, &counting_queue);
+
+  LinearSegmentSteps segment = {
+    20000 /* v0 */, 20000 /* v1 */, 0 /* aux */,
+    {2000, -2000, 10, 0, 0, 0, 0, 0} /* steps */
+  };
+  segment.arc_radius = 2000;
+  segment.arc_start = 0;
+  segment.arc_end = M_PI / 2;
+  segment.arc_rise_motors = (1 << 0);
+  segment.arc_fall_motors = (1 << 1);
+  motor_operations.Enqueue(segment);
+  motor_operations.WaitQueueEmpty();
+  EXPECT_GE(counting_queue.arc_segments(), 1);
+
+  const int expected_pulses[MOTION_MOTOR_COUNT] = {2000, 2000, 10};
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    EXPECT_EQ(expected_pulses[i], pulses_[i]) << "motor " << i + 1;
+  }
+  PhysicalStatus status;
+  ASSERT_TRUE(motor_operations.GetPhysicalStatus(&status));
+  EXPECT_EQ(2000, status.pos_steps[0]);
+  EXPECT_EQ(-2000, status.pos_steps[1]);
+  EXPECT_EQ(10, status.pos_steps[2]);
+}
+
+// LOOP_ARC_CYCLES is what turning the fractions adds to the step loop.
+TEST_F(FirmwareTest, LoopCyclesOfArcSegments) {
+  uint64_t overhead[MOTION_MOTOR_COUNT + 1] = {};
+  for (int motors = 2; motors <= MOTION_MOTOR_COUNT; ++motors) {
+    overhead[motors] = Max(LoopOverhead(ArcSegment(motors, 64, 1000)));
+    fprintf(stderr, "arc %d motors: %llu cycles\n", motors,
+            (unsigned long long)overhead[motors]);
+  }
+  auto covered = [&](int arc_cycles) {
+    for (int motors = 2; motors <= MOTION_MOTOR_COUNT; ++motors) {
+      if ((int)overhead[motors] > AssumedLoopCycles(
+            LOOP_BASE_CYCLES + arc_cycles, LOOP_MOTOR_CYCLES, motors))
+        return false;
+    }
+    return true;
+  };
+  EXPECT_TRUE(covered(LOOP_ARC_CYCLES));
+  EXPECT_FALSE(covered(LOOP_ARC_CYCLES - 1));
+}
+
+// The pixels of a raster line are spread evenly over its steps.
+TEST_P(SingleAndDualPruTest, RasterPixelsSwitchAuxAlongTheLine) {
+  SegmentCountingQueue counting_queue(queue_.get());
+  MotionQueueMotorOperations motor_operations(&hardware_, &counting_queue);
+
+  const int kPixels = 16;
+  const int kSteps = 400;
+  LinearSegmentSteps segment = {
+    10000 /* v0 */, 10000 /* v1 */, 0x2 /* aux: AUX_2 */,
+    {kSteps, -kSteps, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  segment.raster_pixels = kPixels;
+  segment.raster_aux_bits = 0x1;  // AUX_1
+  segment.raster_data[0] = 0xb6;  // Pixels 1, 2, 4, 5, 7 ...
+  segment.raster_data[1] = 0x19;  // ... and 8, 11, 12.
+  motor_operations.Enqueue(segment);
+  motor_operations.WaitQueueEmpty();
+  EXPECT_EQ(1, counting_queue.raster_segments());
+  EXPECT_EQ(kSteps, pulses_[0]);
+  EXPECT_EQ(kSteps, pulses_[1]);
+
+  // Pixel n starts at about step n * kSteps / kPixels.
+  std::vector<int> expected;
+  bool on = false;
+  for (int p = 0; p < kPixels; ++p) {
+    const bool pixel = segment.raster_data[p / 8] & (1 << (p % 8));
+    if (pixel != on) expected.push_back(p * kSteps / kPixels);
+    on = pixel;
+  }
+  if (on) expected.push_back(kSteps);  // Back to the aux bits of the segment.
+  ASSERT_EQ(expected.size(), aux_1_changes_.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(expected[i], aux_1_changes_[i], 1) << "change " << i;
+  }
+  EXPECT_FALSE(aux_1_high_);
+}
+
+// LOOP_RASTER_CYCLES is what a raster segment adds to the step loop,
+// RASTER_PIXEL_CYCLES the cost of going to the next pixel on top of that.
+TEST_F(FirmwareTest, LoopCyclesOfRasterSegments) {
+  uint64_t same_pixel[MOTION_MOTOR_COUNT + 1] = {};
+  uint64_t next_pixel[MOTION_MOTOR_COUNT + 1] = {};
+  for (int motors = 1; motors <= MOTION_MOTOR_COUNT; ++motors) {
+    same_pixel[motors] = Max(LoopOverhead(RasterSegment(motors, 64, 1000, 0)));
+    next_pixel[motors] = Max(LoopOverhead(RasterSegment(motors, 64, 1000,
+                                                        0xffffffff)));
+    fprintf(stderr, "raster %d motors: %llu/%llu cycles\n", motors,
+            (unsigned long long)same_pixel[motors],
+            (unsigned long long)next_pixel[motors]);
+  }
+  auto covered = [](const uint64_t *overhead, int extra_cycles) {
+    for (int motors = 1; motors <= MOTION_MOTOR_COUNT; ++motors) {
+      if ((int)overhead[motors] > AssumedLoopCycles(
+            LOOP_BASE_CYCLES + extra_cycles, LOOP_MOTOR_CYCLES, motors))
+        return false;
+    }
+    return true;
+  };
+  EXPECT_TRUE(covered(same_pixel, LOOP_RASTER_CYCLES));
+  EXPECT_FALSE(covered(same_pixel, LOOP_RASTER_CYCLES - 1));
+  EXPECT_TRUE(covered(next_pixel, LOOP_RASTER_CYCLES + RASTER_PIXEL_CYCLES));
+  EXPECT_FALSE(covered(next_pixel,
+                       LOOP_RASTER_CYCLES + RASTER_PIXEL_CYCLES - 1));
+}
+
+// The host packs the elements in the ring buffer with only the fractions of
+// the moving motors and wraps around when there is no room behind
+// QUEUE_LAST_OFFSET for the largest one; the PRU has to follow it.
+TEST_P(SingleAndDualPruTest, PackedElementsWrapAroundTheRingBuffer) {
+  // Several rounds through the ring buffer, with elements of each size.
+  const int kSegments = 3 * QUEUE_LEN;
+  std::vector<MotionSegment> segments;
+  uint32_t random = 42;
+  for (int s = 0; s < kSegments; ++s) {
+    random = random * 1103515245 + 12345;
+    MotionSegment segment = {};
+    segment.state = STATE_FILLED;
+    segment.motor_mask = (random >> 16) & 0xff;
+    segment.direction_bits = (random >> 8) & 0xff;
+    segment.loops_travel = 8 + s % 13;
+    segment.travel_delay_cycles = 200;
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      if (segment.motor_mask & (1 << i))
+        segment.fractions[i] = 0x7fffffff / (1 + (i + s) % 4);
+    }
+    segments.push_back(segment);
+  }
+
+  // Expected pulses: a motor starts each of its segments from zero and its
+  // step output is bit 31 of the sum of its fractions. The PRU adds them
+  // once more than there are loops, before it finds the segment done.
+  int expected[MOTION_MOTOR_COUNT] = {};
+  bool high[MOTION_MOTOR_COUNT] = {};
+  size_t bytes = 0;
+  for (const MotionSegment &segment : segments) {
+    bytes += (sizeof(internal::PackedSegment)
+              - 4 * (MOTION_MOTOR_COUNT
+                     - __builtin_popcount(segment.motor_mask)));
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      if ((segment.motor_mask & (1 << i)) == 0) continue;
+      uint32_t state = 0;
+      for (uint32_t loop = 0; loop <= segment.loops_travel; ++loop) {
+        state += segment.fractions[i];
+        const bool step = state >> 31;
+        if (step && !high[i]) ++expected[i];
+        high[i] = step;
+      }
+    }
+  }
+  ASSERT_GT(bytes, 2u * QUEUE_BYTES);
+
+  std::vector<MotionSegment> copy = segments;
+  queue_->EnqueueBatch(copy.data(), copy.size());
+  queue_->WaitQueueEmpty();
+  EXPECT_EQ(0, queue_->GetPendingElements(NULL));
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    EXPECT_EQ(expected[i], pulses_[i]) << "motor " << i + 1;
+  }
+}
+
+// The host counts the steps from the loops the PRU reports; at each of
+// them, these are the step pulses so far.
+TEST_P(SingleAndDualPruTest, StepCountersFollowThePulses) {
+  int mismatches = 0;
+  emulator()->SetStoreObserver([this, &mismatches](uint32_t address,
+                                                   int bytes) {
+      if (address != 0 || bytes != 4) return;
+      int32_t counters[MOTION_MOTOR_COUNT];
+      ASSERT_TRUE(queue_->GetStepCounters(counters));
+      for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+        const int expected = (i == 1) ? -pulses_[i] : pulses_[i];
+        if (counters[i] != expected && mismatches++ < 5) {
+          ADD_FAILURE() << "motor " << i + 1 << ": " << counters[i]
+                        << " instead of " << expected;
+        }
+      }
+    });
+
+  // Motor 2 goes backwards.
+  MotionSegment linear = TravelSegment(3, 300, 200);
+  linear.direction_bits = 0x02;
+  linear.fractions[1] = 0x7fffffff / 3;
+  linear.fractions[2] = 0x12345678;
+  MotionSegment arc = ArcSegment(2, 1000, 300);
+  arc.direction_bits = 0x02;
+  arc.arc_shift = 9;
+  MotionSegment raster = RasterSegment(2, 100, 400, 0x10000000);
+  raster.direction_bits = 0x02;
+  for (const MotionSegment &segment : { linear, arc, linear, raster }) {
+    Run(segment);
+  }
+  EXPECT_EQ(0, mismatches);
+  EXPECT_GT(pulses_[0], 0);
+  EXPECT_GT(pulses_[1], 0);
+}
+
+// The point of the dual PRU mode: PRU0 doesn't calculate the delays, so
+// accelerating and decelerating costs no more than traveling.
+TEST_F(DualPruTest, LoopCyclesAreTheSameInAllPhases) {
+  MotionSegment segment = TravelSegment(2, 32, 1000);
+  segment.loops_accel = 32;
+  segment.loops_decel = 32;
+  segment.accel_series_index = 100;
+  segment.hires_accel_cycles = 3000 << DELAY_CYCLE_SHIFT;
+  const std::vector<uint64_t> overhead = LoopOverhead(segment);
+  ASSERT_EQ(95u, overhead.size());
+  EXPECT_EQ(Max(LoopOverhead(TravelSegment(2, 96, 1000))), Max(overhead));
+}
+
+// Each phase can have more loops than fit in the 16 bit counters; the high
+// bits are counted down in LoopsHigh.
+TEST_P(SingleAndDualPruTest, PhasesLongerThanSixteenBits) {
+  MotionSegment segment = TravelSegment(1, 2 * 65536 + 5, 200);
+  segment.loops_accel = 65536 + 1;
+  segment.loops_decel = 65536;  // Low 16 bits zero.
+  segment.accel_series_index = 100;
+  segment.hires_accel_cycles = 3000 << DELAY_CYCLE_SHIFT;
+  const uint32_t accel_end = segment.loops_accel;
+  const uint32_t travel_end = accel_end + segment.loops_travel;
+  const uint32_t loops = travel_end + segment.loops_decel;
+  const std::vector<StatusUpdate> updates = Run(segment);
+
+  // One update when the segment starts, then one for each loop.
+  ASSERT_EQ(loops + 1, updates.size());
+  for (uint32_t i = 0; i <= loops; ++i) {
+    ASSERT_EQ(loops - i, updates[i].loops_left) << i;
+  }
+  EXPECT_EQ((int)(loops + 1) / 2, pulses_[0]);
+
+  // Each loop has the delay of its phase: getting shorter while
+  // accelerating, the same in travel, longer while decelerating.
+  const uint32_t travel_delay = updates[travel_end].delay;
+  EXPECT_GT(updates[1].delay, updates[accel_end].delay);
+  for (uint32_t i = 2; i <= accel_end; ++i) {
+    ASSERT_LE(updates[i].delay, updates[i-1].delay) << i;
+  }
+  for (uint32_t i = accel_end + 1; i <= travel_end; ++i) {
+    ASSERT_EQ(travel_delay, updates[i].delay) << i;
+  }
+  for (uint32_t i = travel_end + 2; i <= loops; ++i) {
+    ASSERT_GE(updates[i].delay, updates[i-1].delay) << i;
+  }
+  EXPECT_GT(updates[loops].delay, updates[travel_end + 1].delay);
+}
+
+// With a speed factor, the loops take that much longer once the ramp is
+// done; the steps stay the same.
+TEST_P(SingleAndDualPruTest, SpeedFactorStretchesTheLoops) {
+  const uint32_t loops = 200;
+  auto period = [](const std::vector<StatusUpdate> &updates) {
+    return ((updates.back().cycle - updates[10].cycle)
+            / (updates.size() - 11));
+  };
+  const uint64_t full_speed = period(Run(TravelSegment(1, loops, 5000)));
+  ASSERT_TRUE(queue_->SetSpeedFactor(0.5, 0));
+  const std::vector<StatusUpdate> updates = Run(TravelSegment(1, loops, 5000));
+  ASSERT_EQ(loops + 1, updates.size());
+  EXPECT_NEAR(2 * full_speed, period(updates), full_speed / 50);
+  EXPECT_EQ((int)(loops + 1) / 2 * 2, pulses_[0]);
+}
+
+// The ramp takes the same time, no matter how long the loops are.
+TEST_P(SingleAndDualPruTest, SpeedRampGoesByTime) {
+  uint64_t ramp_end = 0;
+  emulator()->SetStoreObserver([this, &ramp_end](uint32_t address, int bytes) {
+      if (address == 0 && bytes == 4 && updates_.empty())
+        updates_.push_back({ emulator()->cycles(), 0, 0 });
+      if (address != SPEED_SCALE_ADDRESS || ramp_end != 0) return;
+      uint16_t current;
+      memcpy(&current, emulator()->data_ram() + address, sizeof(current));
+      if (current == SPEED_SCALE_ONE / 2) ramp_end = emulator()->cycles();
+    });
+  // 5ms for half the speed; 1e6 cycles.
+  const uint64_t expected = 5 * 200000;
+  for (uint32_t delay : { 500, 5000 }) {
+    ASSERT_TRUE(queue_->SetSpeedFactor(1, 0));
+    Run(TravelSegment(1, 4000000 / delay, delay));  // Back at full speed.
+    ASSERT_TRUE(queue_->SetSpeedFactor(0.5, 0.01));
+    ramp_end = 0;
+    const MotionSegment segment = TravelSegment(1, 4000000 / delay, delay);
+    const uint64_t start = Run(segment).front().cycle;
+    ASSERT_NE(0u, ramp_end) << delay;
+    EXPECT_NEAR(expected, ramp_end - start, expected / 20) << delay;
+  }
+}
+
+// Feed hold: the motors stop within the ramp and stay there, with the
+// status and the step counters up to date, until the speed is set again.
+TEST_P(SingleAndDualPruTest, FeedHoldAndContinue) {
+  const uint32_t loops = 2000;
+  int holding_polls = 0;
+  int held_pulses = -1;
+  emulator()->SetLoadObserver([&](uint32_t address, int bytes) {
+      if (address != SPEED_SCALE_ADDRESS || bytes != 4) return;  // Holding.
+      if (++holding_polls == 1) {
+        held_pulses = pulses_[0];
+        int32_t counters[MOTION_MOTOR_COUNT];
+        ASSERT_TRUE(queue_->GetStepCounters(counters));
+        EXPECT_EQ(pulses_[0], counters[0]);
+      }
+      EXPECT_EQ(held_pulses, pulses_[0]);
+      if (holding_polls == 100) queue_->SetSpeedFactor(1, 0.001);
+    });
+  emulator()->SetStoreObserver([this](uint32_t address, int bytes) {
+      if (address != 0 || bytes != 4) return;
+      uint32_t status;
+      memcpy(&status, emulator()->data_ram(), sizeof(status));
+      updates_.push_back({ emulator()->cycles(), status & 0xffffff,
+                           emulator()->reg(1) });
+      if (updates_.size() == 500) queue_->SetSpeedFactor(0, 0.001);
+    });
+  const std::vector<StatusUpdate> updates = Run(TravelSegment(1, loops, 500));
+  EXPECT_EQ(100, holding_polls);
+  EXPECT_GT(held_pulses, 250);
+  EXPECT_LT(held_pulses, (int)loops / 2);
+
+  // Each loop once, and a long one while holding.
+  ASSERT_EQ(loops + 1, updates.size());
+  uint64_t longest = 0;
+  for (size_t i = 1; i < updates.size(); ++i) {
+    ASSERT_EQ(updates[i-1].loops_left - 1, updates[i].loops_left);
+    longest = std::max(longest, updates[i].cycle - updates[i-1].cycle);
+  }
+  EXPECT_GT(longest, 100u * 2 * 1000);
+  EXPECT_EQ((int)loops / 2, pulses_[0]);
+}
+
+INSTANTIATE_TEST_CASE_P(Firmware, SingleAndDualPruTest,
+                        ::testing::Values(false, true));
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/stderr");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
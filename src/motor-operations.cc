@@ -26,10 +26,15 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
-#include <deque>
+#include <time.h>
 
+#include <algorithm>
+
+#include "common/container.h"
 #include "common/logging.h"
+#include "common/trace.h"
 
 #include "motor-interface-constants.h"
 #include "motion-queue.h"
@@ -41,22 +46,56 @@
 // more than one bit output per step (probably only with hand-built drivers).
 #define LOOPS_PER_STEP (1 << 1)
 
-// If we do more than these number of steps, the fixed point fraction
-// accumulate too much error.
-#define MAX_STEPS_PER_SEGMENT (65535 / LOOPS_PER_STEP)
-
-// TODO: don't store this singleton like, but keep in user_data of the MotorOperations
-static float hardware_frequency_limit_ = 1e6;    // Don't go over 1 Mhz
+// Longer moves are split, as the motion queue counts at most
+// MOTION_MAX_LOOPS_PER_SEGMENT loops per segment. The fixed point fractions
+// lose less than a step over these.
+#define MAX_STEPS_PER_SEGMENT (MOTION_MAX_LOOPS_PER_SEGMENT / LOOPS_PER_STEP)
 
 static inline float sq(float x) { return x * x; }  // square a number
 static inline double sqd(double x) { return x * x; }  // square a number
 static inline int round2int(float x) { return (int) roundf(x); }
 
-// Clip speed to maximum we can reach with hardware.
-static float clip_hardware_frequency_limit(float v) {
-  return v < hardware_frequency_limit_ ? v : hardware_frequency_limit_;
+static int64_t get_time_usec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Arc segments turn the velocity vector by 2^-shift radians per loop. The
+// distance along the circle in each loop is then radius * 2^-shift steps,
+// which we keep below this value (linear segments: at most half a step).
+#define ARC_MAX_STEPS_PER_LOOP 0.49
+
+// Most loops in one arc segment; longer arcs are split. Each piece starts
+// with the exact velocity vector again, so this is kept short to not let
+// the integer rotation drift.
+#define MAX_LOOPS_PER_ARC_SEGMENT 65534
+
+// The step frequency we can reach with hardware depends on how many motors
+// the PRU has to update in each loop, and what else it has to do there
+// ("extra_cycles", e.g. LOOP_ARC_CYCLES).
+static float hardware_frequency_limit(unsigned motor_mask,
+                                      int extra_cycles = 0) {
+  const int active_motors = __builtin_popcount(motor_mask & ((1 << MOTION_MOTOR_COUNT) - 1));
+  return TIMER_FREQUENCY /
+    (LOOPS_PER_STEP * (LOOP_BASE_CYCLES + LOOP_MOTOR_CYCLES * active_motors
+                       + extra_cycles));
 }
 
+// Raster segments keep the pixels in the fractions; the moving motors all
+// step with the fraction the defining axis has in linear segments.
+static_assert(BEAGLEG_MAX_RASTER_PIXELS == 32 * RASTER_PIXEL_WORDS,
+              "Raster pixels need to fit in the MotionSegment fractions");
+static_assert(RASTER_MOTOR_FRACTION == 0xFFFFFFFF / LOOPS_PER_STEP,
+              "Raster motors need to step like the defining axis");
+
+static bool raster_pixel(const LinearSegmentSteps &param, int n) {
+  return (param.raster_data[n / 8] & (1 << (n % 8))) != 0;
+}
+
+// Evaluated once per accelerating or decelerating segment; the PRU steps on
+// from there. Not worth a table: the acceleration is derived for each
+// segment, so there are no few values to precompute it for.
 static float calcAccelerationCurveValueAt(int index, float acceleration) {
   // counter_freq * sqrt(2 / accleration)
   const float accel_factor = TIMER_FREQUENCY
@@ -66,6 +105,90 @@ static float calcAccelerationCurveValueAt(int index, float acceleration) {
   return c0 * (sqrtf(index + 1) - sqrtf(index));
 }
 
+// Set up the speed profile of "element" going from v0 to v1 within
+// "total_loops" loops, which is "defining_steps" of the axis the speeds are
+// given for. A travel speed is limited to "max_speed".
+static void fill_timing(float v0, float v1, float defining_steps,
+                        int total_loops, float max_speed,
+                        MotionSegment *element) {
+  struct MotionSegment &new_element = *element;
+  // TODO: clamp acceleration to be a minimum value.
+  // There are three cases: either we accelerate, travel or decelerate.
+  if (v0 == v1) {
+    // Travel
+    new_element.loops_accel = new_element.loops_decel = 0;
+    new_element.loops_travel = total_loops;
+    const float travel_speed = v0 < max_speed ? v0 : max_speed;
+    new_element.travel_delay_cycles = round2int(TIMER_FREQUENCY / (LOOPS_PER_STEP * travel_speed));
+  } else if (v0 < v1) {
+    // acclereate
+    new_element.loops_travel = new_element.loops_decel = new_element.travel_delay_cycles = 0;
+    new_element.loops_accel = total_loops;
+
+    // v1 = v0 + a*t -> t = (v1 - v0)/a
+    // s = a/2 * t^2 + v0 * t; subsitution t from above.
+    // a = (v1^2-v0^2)/(2*s)
+    float acceleration = (sq(v1) - sq(v0)) / (2.0f * defining_steps);
+    //fprintf(stderr, "M-OP HZ: defining=%.1f ; accel=%.2f\n", defining_steps, acceleration);
+    // If we accelerated from zero to our first speed, this is how many steps
+    // we needed. We need to go this index into our taylor series.
+    const int accel_loops_from_zero =
+      round2int(LOOPS_PER_STEP * (sq(v0 - 0) / (2.0f * acceleration)));
+
+    new_element.accel_series_index = accel_loops_from_zero;
+    new_element.hires_accel_cycles =
+      round2int((1 << DELAY_CYCLE_SHIFT) * calcAccelerationCurveValueAt(new_element.accel_series_index, acceleration));
+  } else {  // v0 > v1
+    // decelerate
+    new_element.loops_travel = new_element.loops_accel = new_element.travel_delay_cycles = 0;
+    new_element.loops_decel = total_loops;
+
+    float acceleration = (sq(v0) - sq(v1)) / (2.0f * defining_steps);
+    //fprintf(stderr, "M-OP HZ: defining=%.1f ; decel=%.2f\n", defining_steps, acceleration);
+    // We are into the taylor sequence this value up and reduce from there.
+    const int accel_loops_from_zero =
+      round2int(LOOPS_PER_STEP * (sq(v0 - 0) / (2.0f * acceleration)));
+
+    new_element.accel_series_index = accel_loops_from_zero;
+    new_element.hires_accel_cycles =
+      round2int((1 << DELAY_CYCLE_SHIFT) * calcAccelerationCurveValueAt(new_element.accel_series_index, acceleration));
+  }
+}
+
+// Number of steps each motor does in "segment", as the motion queue
+// executes it: one fraction addition per loop (plus the final one that
+// finds the segment done), a step for each transition of the top bit, and,
+// in arcs, a rotation of the fractions after each addition.
+static void simulate_segment_steps(const MotionSegment &segment,
+                                   int steps[MOTION_MOTOR_COUNT]) {
+  uint32_t fractions[MOTION_MOTOR_COUNT];
+  uint32_t state[MOTION_MOTOR_COUNT] = {};
+  uint32_t rise = 0, fall = 0;
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    fractions[i] = segment.fractions[i];
+    if (segment.arc_rise_mask & (1 << i)) rise = fractions[i];
+    if (segment.arc_fall_mask & (1 << i)) fall = fractions[i];
+    steps[i] = 0;
+  }
+  const int loops = segment.loops_accel + segment.loops_travel
+    + segment.loops_decel;
+  for (int loop = 0; loop <= loops; ++loop) {
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      const uint32_t before = state[i];
+      state[i] += fractions[i];
+      if (~before & state[i] & 0x80000000) ++steps[i];
+    }
+    if (segment.arc_shift == 0) continue;
+    const uint32_t fall_delta = rise >> segment.arc_shift;
+    fall -= (fall_delta <= fall) ? fall_delta : fall;
+    rise += fall >> segment.arc_shift;
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      if (segment.arc_rise_mask & (1 << i)) fractions[i] = rise;
+      if (segment.arc_fall_mask & (1 << i)) fractions[i] = fall;
+    }
+  }
+}
+
 #if 0
 // Is acceleration in acceptable range ?
 static char test_acceleration_ok(float acceleration) {
@@ -98,30 +221,99 @@ struct HistoryPositionInfo {
 
 // Store the required informations needed to backtrack the absolute position.
 struct MotionQueueMotorOperations::HistorySegment {
+  // Take over the outputs "param" sets; PWM not set there stays as is.
+  void SetOutputs(const LinearSegmentSteps &param) {
+    aux_bits = param.aux_bits;
+    for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+      if (param.pwm_mask & (1 << i)) pwm_duty[i] = param.pwm_duty[i];
+    }
+  }
+
   HistoryPositionInfo pos_info[MOTION_MOTOR_COUNT];
   unsigned short aux_bits;
+  float pwm_duty[BEAGLEG_NUM_PWM_OUTPUTS];
+};
+
+// History of the segments in the motion queue; the oldest element is the
+// one currently executed, the newest the last one enqueued. The motion queue
+// never has more than QUEUE_LEN elements, so we need to keep at most that
+// plus the newest position. RingDeque holds one less than its capacity.
+class MotionQueueMotorOperations::ShadowQueue
+  : public RingDeque<HistorySegment, QUEUE_LEN + 2> {};
+
+struct MotionQueueMotorOperations::WatchedSegment {
+  uint32_t loops;        // Total loops of the segment.
+  HistorySegment end;    // Position at the end of it.
 };
 
 MotionQueueMotorOperations::
 MotionQueueMotorOperations(HardwareMapping *hw, MotionQueue *backend)
   : hardware_mapping_(hw),
     backend_(backend),
-    shadow_queue_(new std::deque<struct HistorySegment>()) {
+    shadow_queue_(new ShadowQueue()),
+    watching_input_(false),
+    watched_segments_(new std::vector<WatchedSegment>()) {
   // Initialize the history queue.
-  shadow_queue_->push_front({});
+  *shadow_queue_->append() = {};
+  bzero(&stats_, sizeof(stats_));
+  bzero(applied_pwm_, sizeof(applied_pwm_));
+  bzero(counter_offset_, sizeof(counter_offset_));
 }
 
 MotionQueueMotorOperations::~MotionQueueMotorOperations() {
+  delete watched_segments_;
   delete shadow_queue_;
 }
 
+void MotionQueueMotorOperations::PushHistory(const HistorySegment &segment) {
+  // If full, the oldest element can't be referenced by the queue anymore.
+  if (shadow_queue_->size() == QUEUE_LEN + 1)
+    shadow_queue_->pop_front();
+  *shadow_queue_->append() = segment;
+}
+
+void MotionQueueMotorOperations::ShrinkHistory(int pending_elements) {
+  const size_t keep = pending_elements > 0 ? pending_elements : 1;
+  if (shadow_queue_->size() > keep)
+    shadow_queue_->pop_front(shadow_queue_->size() - keep);
+
+  // The PRU can't set PWM outputs, so we set them here as soon as we see
+  // that the segment asking for them is executing.
+  const HistorySegment &executing = *(*shadow_queue_)[0];
+  for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+    if (executing.pwm_duty[i] == applied_pwm_[i]) continue;
+    hardware_mapping_->SetPWMChannel(i, executing.pwm_duty[i]);
+    applied_pwm_[i] = executing.pwm_duty[i];
+  }
+}
+
+bool MotionQueueMotorOperations::UpdateOutputs() {
+  ShrinkHistory(backend_->GetPendingElements(NULL));
+  const HistorySegment &newest = *shadow_queue_->back();
+  for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+    if (newest.pwm_duty[i] != applied_pwm_[i]) return true;
+  }
+  return false;
+}
+
 void MotionQueueMotorOperations::EnqueueInternal(const LinearSegmentSteps &param,
                                                  int defining_axis_steps) {
-  struct MotionSegment new_element = {};
+  struct MotionSegment new_element;
+  FillMotionSegment(param, defining_axis_steps, &new_element);
+  backend_->MotorEnable(true);
+  backend_->Enqueue(&new_element);
+}
+
+void MotionQueueMotorOperations::FillMotionSegment(const LinearSegmentSteps &param,
+                                                   int defining_axis_steps,
+                                                   MotionSegment *element,
+                                                   int extra_loop_cycles) {
+  struct MotionSegment &new_element = *element;
+  new_element = {};
   new_element.direction_bits = 0;
 
   // The new segment is based on the previous position.
-  struct HistorySegment history_segment = shadow_queue_->front();
+  struct HistorySegment history_segment = *shadow_queue_->back();
 
   // The defining_axis_steps is the number of steps of the axis that requires
   // the most number of steps. All the others are a fraction of the steps.
@@ -142,70 +334,53 @@ void MotionQueueMotorOperations::EnqueueInternal(const LinearSegmentSteps &param
     history_segment.pos_info[i].position_steps += param.steps[i];
     const uint64_t delta = abs(param.steps[i]);
     new_element.fractions[i] = delta * max_fraction / defining_axis_steps;
+    if (delta != 0) new_element.motor_mask |= (1 << i);
     history_segment.pos_info[i].fraction = new_element.fractions[i];
   }
 
-  history_segment.aux_bits = param.aux_bits;
-  shadow_queue_->push_front(history_segment);
-
-  // TODO: clamp acceleration to be a minimum value.
-  const int total_loops = LOOPS_PER_STEP * defining_axis_steps;
-  // There are three cases: either we accelerate, travel or decelerate.
-  if (param.v0 == param.v1) {
-    // Travel
-    new_element.loops_accel = new_element.loops_decel = 0;
-    new_element.loops_travel = total_loops;
-    const float travel_speed = clip_hardware_frequency_limit(param.v0);
-    new_element.travel_delay_cycles = round2int(TIMER_FREQUENCY / (LOOPS_PER_STEP * travel_speed));
-  } else if (param.v0 < param.v1) {
-    // acclereate
-    new_element.loops_travel = new_element.loops_decel = new_element.travel_delay_cycles = 0;
-    new_element.loops_accel = total_loops;
-
-    // v1 = v0 + a*t -> t = (v1 - v0)/a
-    // s = a/2 * t^2 + v0 * t; subsitution t from above.
-    // a = (v1^2-v0^2)/(2*s)
-    float acceleration = (sq(param.v1) - sq(param.v0)) / (2.0f * defining_axis_steps);
-    //fprintf(stderr, "M-OP HZ: defining=%d ; accel=%.2f\n", defining_axis_steps, acceleration);
-    // If we accelerated from zero to our first speed, this is how many steps
-    // we needed. We need to go this index into our taylor series.
-    const int accel_loops_from_zero =
-      round2int(LOOPS_PER_STEP * (sq(param.v0 - 0) / (2.0f * acceleration)));
-
-    new_element.accel_series_index = accel_loops_from_zero;
-    new_element.hires_accel_cycles =
-      round2int((1 << DELAY_CYCLE_SHIFT) * calcAccelerationCurveValueAt(new_element.accel_series_index, acceleration));
-  } else {  // v0 > v1
-    // decelerate
-    new_element.loops_travel = new_element.loops_accel = new_element.travel_delay_cycles = 0;
-    new_element.loops_decel = total_loops;
-
-    float acceleration = (sq(param.v0) - sq(param.v1)) / (2.0f * defining_axis_steps);
-    //fprintf(stderr, "M-OP HZ: defining=%d ; decel=%.2f\n", defining_axis_steps, acceleration);
-    // We are into the taylor sequence this value up and reduce from there.
-    const int accel_loops_from_zero =
-      round2int(LOOPS_PER_STEP * (sq(param.v0 - 0) / (2.0f * acceleration)));
-
-    new_element.accel_series_index = accel_loops_from_zero;
-    new_element.hires_accel_cycles =
-      round2int((1 << DELAY_CYCLE_SHIFT) * calcAccelerationCurveValueAt(new_element.accel_series_index, acceleration));
-  }
+  history_segment.SetOutputs(param);
+  PushHistory(history_segment);
 
+  const bool stop_on_input = param.stop_on_input && watching_input_;
+  if (stop_on_input) extra_loop_cycles += LOOP_INPUT_CYCLES;
+  fill_timing(param.v0, param.v1, defining_axis_steps,
+              LOOPS_PER_STEP * defining_axis_steps,
+              hardware_frequency_limit(new_element.motor_mask,
+                                       extra_loop_cycles),
+              &new_element);
   new_element.aux = param.aux_bits;
+  if (stop_on_input) {
+    new_element.stop_on_input = 1;
+    const uint32_t loops = new_element.loops_accel + new_element.loops_travel
+      + new_element.loops_decel;
+    watched_segments_->push_back({ loops, history_segment });
+  }
   new_element.state = STATE_FILLED;
-  backend_->MotorEnable(true);
-  backend_->Enqueue(&new_element);
 }
 
 bool MotionQueueMotorOperations::GetPhysicalStatus(PhysicalStatus *status) {
   // Shrink the queue
   uint32_t loops;
-  const int buffer_size = backend_->GetPendingElements(&loops);
-  const int new_size = buffer_size > 0 ? buffer_size : 1;
-  shadow_queue_->resize(new_size);
+  ShrinkHistory(backend_->GetPendingElements(&loops));
+
+  // Get the oldest element: the one currently executed.
+  const HistorySegment &hs = *(*shadow_queue_)[0];
+  status->aux_bits = hs.aux_bits;
+  memcpy(status->pwm_duty, hs.pwm_duty, sizeof(status->pwm_duty));
+
+  // The hardware counts in the sense of the direction bits, which are
+  // inverted for flipped motors.
+  int32_t counters[MOTION_MOTOR_COUNT];
+  if (backend_->GetStepCounters(counters)) {
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      const int steps = hardware_mapping_->IsMotorFlipped(i)
+        ? -counters[i] : counters[i];
+      status->pos_steps[i] = counter_offset_[i] + steps;
+    }
+    return true;
+  }
 
-  // Get the last element
-  const HistorySegment &hs = shadow_queue_->back();
+  // Otherwise, reconstruct it from the loops left in the executing segment.
   const uint64_t max_fraction = 0xFFFFFFFF / LOOPS_PER_STEP;
 
   // NOTE: Assuming MOTION_MOTOR_COUNT == BEAGLEG_NUM_MOTORS
@@ -219,12 +394,100 @@ bool MotionQueueMotorOperations::GetPhysicalStatus(PhysicalStatus *status) {
     steps /= max_fraction;
     status->pos_steps[i] = pos_info.position_steps - pos_info.sign * (int) steps;
   }
-  status->aux_bits = hs.aux_bits;
   return true;
 }
 
+bool MotionQueueMotorOperations::WatchInput(uint32_t gpio_def,
+                                            bool trigger_level) {
+  WaitQueueEmpty();
+  if (!backend_->WatchInput(gpio_def, trigger_level))
+    return false;
+  watching_input_ = (gpio_def != 0);
+  watched_segments_->clear();
+  return true;
+}
+
+bool MotionQueueMotorOperations::WaitInputStop() {
+  WaitQueueEmpty();
+  uint32_t loops_done;
+  if (!watching_input_ || !backend_->InputTriggered(&loops_done))
+    return false;
+
+  // Find the segment the input stopped; the ones after it were skipped.
+  const uint64_t max_fraction = 0xFFFFFFFF / LOOPS_PER_STEP;
+  HistorySegment stop_position = *shadow_queue_->back();
+  for (const WatchedSegment &segment : *watched_segments_) {
+    if (loops_done >= segment.loops) {
+      loops_done -= segment.loops;
+      stop_position = segment.end;
+      continue;
+    }
+    // Same as in GetPhysicalStatus(), with the loops that were left.
+    const uint32_t loops_left = segment.loops - loops_done;
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      const HistoryPositionInfo &pos_info = segment.end.pos_info[i];
+      uint64_t steps = loops_left / LOOPS_PER_STEP;
+      steps *= pos_info.fraction;
+      steps += max_fraction - 1;
+      steps /= max_fraction;
+      stop_position.pos_info[i] = pos_info;
+      stop_position.pos_info[i].position_steps -= pos_info.sign * (int) steps;
+    }
+    break;
+  }
+  // Outputs are the ones last set.
+  const HistorySegment &newest = *shadow_queue_->back();
+  stop_position.aux_bits = newest.aux_bits;
+  memcpy(stop_position.pwm_duty, newest.pwm_duty, sizeof(newest.pwm_duty));
+  PushHistory(stop_position);
+  watched_segments_->clear();
+  return true;
+}
+
+bool MotionQueueMotorOperations::SetSpeedOverride(float factor,
+                                                  float ramp_seconds) {
+  // The segments stay as planned, just take longer; the positions we
+  // report from the loops done stay valid.
+  return backend_->SetSpeedFactor(factor, ramp_seconds);
+}
+
+bool MotionQueueMotorOperations::RecordQueueState(float v0, int slots_needed) {
+  uint32_t head_loops;
+  const int pending = backend_->GetPendingElements(&head_loops);
+  int bucket = pending * MotionQueueStats::DEPTH_BUCKETS / QUEUE_LEN;
+  if (bucket >= MotionQueueStats::DEPTH_BUCKETS)
+    bucket = MotionQueueStats::DEPTH_BUCKETS - 1;
+  stats_.depth_histogram[bucket]++;
+  // Nothing pending is also the last element still executing; only once it
+  // is done, the motors stopped.
+  if (pending == 0 && head_loops == 0 && v0 > 0)
+    stats_.underruns++;
+  stats_.segments++;
+  return !backend_->HasFreeSlots(slots_needed);
+}
+
+void MotionQueueMotorOperations::RecordWait(int64_t start_usec) {
+  const unsigned long waited = get_time_usec() - start_usec;
+  stats_.waits++;
+  stats_.wait_usec_total += waited;
+  if (waited > stats_.wait_usec_max)
+    stats_.wait_usec_max = waited;
+}
+
+bool MotionQueueMotorOperations::GetQueueStats(MotionQueueStats *stats) {
+  *stats = stats_;
+  stats->queue_depth = backend_->GetPendingElements(NULL);
+  return true;
+}
+
+float MotionQueueMotorOperations::MaxStepFrequency(unsigned motor_mask) const {
+  return hardware_frequency_limit(motor_mask);
+}
+
 void MotionQueueMotorOperations::SetExternalPosition(int axis, int steps) {
-  struct HistorySegment history_segment = shadow_queue_->front();
+  struct HistorySegment history_segment = *shadow_queue_->back();
+  // Where the counters end up is moved the same as the newest position.
+  counter_offset_[axis] += steps - history_segment.pos_info[axis].position_steps;
   if (steps < 0) {
     history_segment.pos_info[axis].sign = -1;
     history_segment.pos_info[axis].position_steps = -steps;
@@ -232,14 +495,9 @@ void MotionQueueMotorOperations::SetExternalPosition(int axis, int steps) {
     history_segment.pos_info[axis].sign = 1;
     history_segment.pos_info[axis].position_steps = steps;
   }
-  shadow_queue_->push_front(history_segment);
-  // Shrink the queue and remove the elements that we are not interested
-  // in anymore.
-  // TODO: We need to find a way to get the maximum number of elements
-  // of the shadow queue (ie backend_->GetQueueStats()?)
-  const int buffer_size = backend_->GetPendingElements(NULL);
-  const int new_size = buffer_size > 0 ? buffer_size : 1;
-  shadow_queue_->resize(new_size);
+  PushHistory(history_segment);
+  // Remove the elements that we are not interested in anymore.
+  ShrinkHistory(backend_->GetPendingElements(NULL));
 }
 
 static int get_defining_axis_steps(const LinearSegmentSteps &param) {
@@ -252,20 +510,213 @@ static int get_defining_axis_steps(const LinearSegmentSteps &param) {
   return defining_axis_steps;
 }
 
+// Arcs are executed by the motion queue turning the velocity vector of the
+// motors in the plane of the circle a little in each loop (see MotionSegment),
+// so we only need to choose the turn per loop and the initial vector. As the
+// motion queue does this in integer arithmetic, we simulate it to know where
+// exactly the motors end up, and finish with a correction of usually a step
+// or two.
+bool MotionQueueMotorOperations::EnqueueArc(const LinearSegmentSteps &param) {
+  if (param.arc_end <= param.arc_start)
+    return false;
+  const int shift = (int)ceil(log2(param.arc_radius / ARC_MAX_STEPS_PER_LOOP));
+  if (shift < 1 || shift > 30)
+    return false;
+  const double angle_per_loop = ldexp(1.0, -shift);
+  const int64_t total_loops =
+    llround((param.arc_end - param.arc_start) / angle_per_loop);
+  if (total_loops < 2 * LOOPS_PER_STEP)
+    return false;  // Too short to be worth it.
+  const unsigned arc_motors = param.arc_rise_motors | param.arc_fall_motors;
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    if ((arc_motors & (1 << i)) == 0
+        && (int64_t)abs(param.steps[i]) * LOOPS_PER_STEP >= total_loops)
+      return false;  // Other motors need to be slower than the arc.
+  }
+
+  // Distance along the circle per loop, as 32 bit fixed point fraction.
+  const double steps_per_loop = param.arc_radius * angle_per_loop;
+  const double arc_fraction = steps_per_loop * 4294967296.0;
+  const uint64_t max_fraction = 0xFFFFFFFF / LOOPS_PER_STEP;
+
+  // The speed profile is set up as if this was a linear segment with
+  // LOOPS_PER_STEP loops per step; scale the speeds accordingly.
+  const double speed_scale = 1.0 / (steps_per_loop * LOOPS_PER_STEP);
+  const double v0 = param.v0 * speed_scale;
+  const double v1 = param.v1 * speed_scale;
+
+  const int pieces = total_loops / MAX_LOOPS_PER_ARC_SEGMENT + 1;
+  int done_steps[MOTION_MOTOR_COUNT] = {};  // Absolute steps done per motor.
+  int64_t loops_done = 0;
+  double previous_speed = v0;
+  backend_->MotorEnable(true);
+  for (int p = 0; p < pieces; ++p) {
+    const int64_t loops = total_loops * (p + 1) / pieces - loops_done;
+    const double angle = param.arc_start + loops_done * angle_per_loop;
+    loops_done += loops;
+
+    struct MotionSegment element = {};
+    struct HistorySegment history_segment = *shadow_queue_->back();
+    element.arc_rise_mask = param.arc_rise_motors;
+    element.arc_fall_mask = param.arc_fall_motors;
+    element.arc_shift = shift;
+    signed char sign[MOTION_MOTOR_COUNT];
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      const bool flip = hardware_mapping_->IsMotorFlipped(i);
+      sign[i] = param.steps[i] < 0 ? -1 : 1;
+      if ((sign[i] < 0) != flip) element.direction_bits |= (1 << i);
+      if (param.arc_rise_motors & (1 << i)) {
+        element.fractions[i] = (uint32_t)(arc_fraction * sin(angle));
+      } else if (param.arc_fall_motors & (1 << i)) {
+        element.fractions[i] = (uint32_t)(arc_fraction * cos(angle));
+      } else {
+        const int64_t target = abs(param.steps[i]) * loops_done / total_loops;
+        const int64_t delta = std::max<int64_t>(0, target - done_steps[i]);
+        element.fractions[i] = delta * max_fraction * LOOPS_PER_STEP / loops;
+      }
+      if (element.fractions[i] != 0 || (arc_motors & (1 << i)))
+        element.motor_mask |= (1 << i);
+    }
+
+    const double speed = (param.v0 == param.v1)
+      ? v0
+      : sqrt(sqd(v0) + (sqd(v1) - sqd(v0)) * loops_done / total_loops);
+    fill_timing(previous_speed, speed, 1.0f * loops / LOOPS_PER_STEP, loops,
+                hardware_frequency_limit(element.motor_mask, LOOP_ARC_CYCLES),
+                &element);
+    previous_speed = speed;
+    element.aux = param.aux_bits;
+    element.state = STATE_FILLED;
+
+    int steps[MOTION_MOTOR_COUNT];
+    simulate_segment_steps(element, steps);
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      HistoryPositionInfo &info = history_segment.pos_info[i];
+      done_steps[i] += steps[i];
+      info.sign = sign[i];
+      info.position_steps += sign[i] * steps[i];
+      info.fraction = steps[i] * max_fraction * LOOPS_PER_STEP / loops;
+    }
+    history_segment.SetOutputs(param);
+    PushHistory(history_segment);
+    backend_->Enqueue(&element);
+  }
+
+  // The circle we went might be a little off the exact steps.
+  struct LinearSegmentSteps correction = {};
+  bool needs_correction = false;
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    const int done = (param.steps[i] < 0) ? -done_steps[i] : done_steps[i];
+    correction.steps[i] = param.steps[i] - done;
+    needs_correction |= (correction.steps[i] != 0);
+  }
+  if (needs_correction) {
+    correction.v0 = correction.v1 = std::max(param.v0, param.v1);
+    correction.aux_bits = param.aux_bits;
+    Enqueue(correction);
+  }
+  return true;
+}
+
+// Raster lines are executed by the motion queue with a pixel clock it
+// advances in each loop, so the pixels are spread evenly over the loops of
+// the segment. The fractions hold the pixels then, so this only works if
+// all moving motors step with the same speed.
+bool MotionQueueMotorOperations::EnqueueRaster(const LinearSegmentSteps &param,
+                                               int defining_axis_steps) {
+  const int pixels = param.raster_pixels;
+  const int loops = LOOPS_PER_STEP * defining_axis_steps;
+  if (pixels > BEAGLEG_MAX_RASTER_PIXELS || pixels > loops
+      || defining_axis_steps > MAX_STEPS_PER_SEGMENT)
+    return false;
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    if (param.steps[i] != 0 && abs(param.steps[i]) != defining_axis_steps)
+      return false;
+  }
+
+  // Every pixel change costs the time of setting the aux bits.
+  const int extra_cycles = LOOP_RASTER_CYCLES
+    + (RASTER_PIXEL_CYCLES * pixels + loops - 1) / loops;
+  struct MotionSegment element;
+  FillMotionSegment(param, defining_axis_steps, &element, extra_cycles);
+  element.raster = 1;
+  memcpy(element.fractions, param.raster_data, sizeof(param.raster_data));
+  // The pixel clock is advanced loops + 1 times; pixel n starts at about
+  // loop n * loops / pixels, and the last one stays to the end.
+  element.fractions[RASTER_PIXEL_WORDS] =
+    (((uint64_t)pixels << 32) - 1) / loops;
+  element.fractions[RASTER_PIXEL_WORDS + 1] = param.raster_aux_bits;
+
+  backend_->MotorEnable(true);
+  backend_->Enqueue(&element);
+  return true;
+}
+
+void MotionQueueMotorOperations::EnqueueRasterRuns(const LinearSegmentSteps &param,
+                                                   int defining_axis_steps) {
+  const double a = (sqd(param.v1) - sqd(param.v0))/(2.0*defining_axis_steps);
+  const int pixels = param.raster_pixels;
+  struct LinearSegmentSteps run = param;
+  run.raster_pixels = 0;
+  int done_steps[BEAGLEG_NUM_MOTORS] = {};
+  int done_defining_steps = 0;
+  double speed = param.v0;
+  for (int p = 0, end; p < pixels; p = end) {
+    const bool on = raster_pixel(param, p);
+    for (end = p + 1; end < pixels && raster_pixel(param, end) == on; ++end)
+      ;
+    for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+      const int target = (int64_t)param.steps[i] * end / pixels;
+      run.steps[i] = target - done_steps[i];
+      done_steps[i] = target;
+    }
+    const int run_steps = get_defining_axis_steps(run);
+    if (run_steps == 0) continue;  // Pixels shorter than a step.
+    done_defining_steps += run_steps;
+    const double v1squared = sqd(param.v0) + 2.0 * a * done_defining_steps;
+    run.v0 = speed;
+    run.v1 = speed = (end == pixels)
+      ? param.v1
+      : (v1squared > 0.0 ? sqrt(v1squared) : 0);
+    run.aux_bits = on
+      ? (param.aux_bits | param.raster_aux_bits)
+      : (param.aux_bits & ~param.raster_aux_bits);
+    Enqueue(run);
+  }
+  if (run.aux_bits != param.aux_bits) {
+    struct LinearSegmentSteps reset_aux = {};
+    reset_aux.aux_bits = param.aux_bits;
+    Enqueue(reset_aux);
+  }
+}
+
 void MotionQueueMotorOperations::Enqueue(const LinearSegmentSteps &param) {
   const int defining_axis_steps = get_defining_axis_steps(param);
 
-  if (defining_axis_steps == 0) {
+  // Only look at the clock if we're going to wait anyway.
+  const int slots_needed =
+    std::min(QUEUE_LEN, defining_axis_steps / MAX_STEPS_PER_SEGMENT + 1);
+  const bool will_wait = RecordQueueState(param.v0, slots_needed);
+  const int64_t wait_start = will_wait ? get_time_usec() : 0;
+
+  if (param.arc_radius > 0 && EnqueueArc(param)) {
+    // Done.
+  }
+  else if (param.raster_pixels > 0 && defining_axis_steps > 0) {
+    if (!EnqueueRaster(param, defining_axis_steps))
+      EnqueueRasterRuns(param, defining_axis_steps);
+  }
+  else if (defining_axis_steps == 0) {
     // The new segment is based on the previous position.
-    struct HistorySegment history_segment = shadow_queue_->front();
+    struct HistorySegment history_segment = *shadow_queue_->back();
 
     // No move, but we still have to set the bits.
     struct MotionSegment empty_element = {};
     empty_element.aux = param.aux_bits;
     empty_element.state = STATE_FILLED;
 
-    history_segment.aux_bits = param.aux_bits;
-    shadow_queue_->push_front(history_segment);
+    history_segment.SetOutputs(param);
+    PushHistory(history_segment);
 
     backend_->Enqueue(&empty_element);
   }
@@ -274,6 +725,7 @@ void MotionQueueMotorOperations::Enqueue(const LinearSegmentSteps &param) {
     // it in pieces.
     const double a = (sqd(param.v1) - sqd(param.v0))/(2.0*defining_axis_steps);
     const int divisions = (defining_axis_steps / MAX_STEPS_PER_SEGMENT) + 1;
+    Trace_instant(TraceEvent::SEGMENT_SPLIT, divisions);
     int64_t hires_steps_per_div[BEAGLEG_NUM_MOTORS];
     for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
       // (+1 to fix rounding trouble in the LSB)
@@ -284,7 +736,15 @@ void MotionQueueMotorOperations::Enqueue(const LinearSegmentSteps &param) {
     int64_t hires_step_accumulator[BEAGLEG_NUM_MOTORS] = {0};
     double previous_speed = param.v0;   // speed calculation in double
 
+    // Hand the pieces to the backend in batches, so that it can transfer
+    // them in one go.
+    struct MotionSegment batch[QUEUE_LEN];
+    int batch_count = 0;
+    backend_->MotorEnable(true);
+
     output.aux_bits = param.aux_bits;  // use the original Aux bits for all segments
+    output.pwm_mask = param.pwm_mask;  // ... and PWM outputs.
+    memcpy(output.pwm_duty, param.pwm_duty, sizeof(output.pwm_duty));
     for (int d = 0; d < divisions; ++d) {
       for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
         hires_step_accumulator[i] += hires_steps_per_div[i];
@@ -303,20 +763,23 @@ void MotionQueueMotorOperations::Enqueue(const LinearSegmentSteps &param) {
       const double v1 = v1squared > 0.0 ? sqrt(v1squared) : 0;
       output.v0 = previous_speed;
       output.v1 = v1;
-      EnqueueInternal(output, division_steps);
+      FillMotionSegment(output, division_steps, &batch[batch_count++]);
+      if (batch_count == QUEUE_LEN) {
+        backend_->EnqueueBatch(batch, batch_count);
+        batch_count = 0;
+      }
       previous = accumulator;
       previous_speed = v1;
     }
+    if (batch_count > 0)
+      backend_->EnqueueBatch(batch, batch_count);
   } else {
     EnqueueInternal(param, defining_axis_steps);
   }
-  // Shrink the queue and remove the elements that we are not interested
-  // in anymore.
-  // TODO: We need to find a way to get the maximum number of elements
-  // of the shadow queue (ie backend_->GetQueueStats()?)
-  const int buffer_size = backend_->GetPendingElements(NULL);
-  const int new_size = buffer_size > 0 ? buffer_size : 1;
-  shadow_queue_->resize(new_size);
+  if (will_wait) RecordWait(wait_start);
+
+  // Remove the elements that we are not interested in anymore.
+  ShrinkHistory(backend_->GetPendingElements(NULL));
 }
 
 void MotionQueueMotorOperations::MotorEnable(bool on) {
@@ -326,4 +789,5 @@ void MotionQueueMotorOperations::MotorEnable(bool on) {
 
 void MotionQueueMotorOperations::WaitQueueEmpty() {
   backend_->WaitQueueEmpty();
+  ShrinkHistory(backend_->GetPendingElements(NULL));
 }
@@ -19,13 +19,24 @@
 #ifndef _BEAGLEG_MOTOR_OPERATIONS_H_
 #define _BEAGLEG_MOTOR_OPERATIONS_H_
 
+#include <stdint.h>
 #include <stdio.h>
-#include <deque>
+
+#include <vector>
 
 class MotionQueue;
+struct MotionSegment;
+
+// Number of motors. Can be set at compile time (see Makefile). The PRU
+// firmware has registers for exactly 8 motors; more can be used with the
+// other motion queues, up to 16 (the width of the motor masks).
+#ifndef BEAGLEG_NUM_MOTORS
+#define BEAGLEG_NUM_MOTORS 8
+#endif
 
 enum {
-  BEAGLEG_NUM_MOTORS = 8
+  BEAGLEG_NUM_PWM_OUTPUTS = 4,
+  BEAGLEG_MAX_RASTER_PIXELS = 192
 };
 
 // The movement command send to motor operations either changes speed, or
@@ -44,6 +55,40 @@ struct LinearSegmentSteps {
   unsigned short aux_bits;   // Aux-bits to switch.
 
   int steps[BEAGLEG_NUM_MOTORS]; // Steps for axis. Negative for reverse.
+
+  // Circular arc. If arc_radius > 0, the motors in arc_rise_motors and
+  // arc_fall_motors don't move in a straight line but on a circle with that
+  // radius (in steps) from angle arc_start to arc_end (radians, with
+  // 0 <= arc_start < arc_end <= pi/2). The speed of the rising motors is
+  // proportional to sin(angle), of the falling motors to cos(angle), and
+  // v0, v1 are speeds along the circle. The "steps" are still the exact
+  // steps to go for each motor; all other motors move linearly.
+  // Only to be used if the MotorOperations SupportsArcs().
+  float arc_radius;
+  float arc_start;
+  float arc_end;
+  unsigned char arc_rise_motors;
+  unsigned char arc_fall_motors;
+
+  // PWM outputs to set when this segment starts executing: for each bit in
+  // pwm_mask, the PWM output (bit 0 = pwm_1) is set to the duty cycle
+  // pwm_duty[] in the range [0..1]. Other PWM outputs keep their value.
+  unsigned char pwm_mask;
+  float pwm_duty[BEAGLEG_NUM_PWM_OUTPUTS];
+
+  // Laser raster. If raster_pixels > 0, the segment is divided into that
+  // many pixels of equal length; the aux bits in raster_aux_bits are set
+  // while moving over a pixel whose bit in raster_data is set (bit n of
+  // byte n / 8 for pixel n, LSB first), and cleared otherwise. Before and
+  // after the segment, aux_bits apply.
+  // Only to be used if the MotorOperations SupportsRaster().
+  unsigned short raster_pixels;
+  unsigned short raster_aux_bits;
+  unsigned char raster_data[BEAGLEG_MAX_RASTER_PIXELS / 8];
+
+  // Stop this segment when the input given in WatchInput() triggers; all
+  // following segments with stop_on_input are skipped then.
+  bool stop_on_input;
 };
 
 // Struct used to return data about the currently executed steps
@@ -51,6 +96,34 @@ struct LinearSegmentSteps {
 struct PhysicalStatus {
   int pos_steps[BEAGLEG_NUM_MOTORS];  // Absolute position in steps.
   unsigned short aux_bits;            // Auxes status
+  float pwm_duty[BEAGLEG_NUM_PWM_OUTPUTS];  // PWM set along with the segments
+};
+
+// Statistics about feeding the motion queue. Useful to tune lookahead and
+// queue length knowing where stalls happen.
+struct MotionQueueStats {
+  enum { DEPTH_BUCKETS = 8 };
+
+  unsigned long segments;    // Number of segments enqueued.
+
+  // Number of times the queue ran empty while the motors were supposed to
+  // still be moving: a new segment starting at a non-zero speed found the
+  // queue empty, with nothing executing anymore.
+  unsigned long underruns;
+
+  // Number of enqueues that had to wait for space in the queue, and the
+  // total and maximum time they waited.
+  unsigned long waits;
+  unsigned long wait_usec_total;
+  unsigned long wait_usec_max;
+
+  // Histogram of the number of queue elements pending when enqueuing. Each
+  // bucket covers an equal fraction of the queue length; the last one
+  // includes a full queue.
+  unsigned long depth_histogram[DEPTH_BUCKETS];
+
+  // Not a statistic but a snapshot: elements pending in the queue right now.
+  unsigned long queue_depth;
 };
 
 class MotorOperations {  // Rename SegmentQueue ?
@@ -77,6 +150,47 @@ public:
   virtual bool GetPhysicalStatus(PhysicalStatus *status) = 0;
 
   virtual void SetExternalPosition(int axis, int steps) = 0;
+
+  // Highest step frequency (steps/s) that can be generated in a segment
+  // moving the motors in the bitmap "motor_mask". Returns 0 if unlimited.
+  virtual float MaxStepFrequency(unsigned motor_mask) const { return 0; }
+
+  // Returns true if segments can be circular arcs (see LinearSegmentSteps).
+  virtual bool SupportsArcs() const { return false; }
+
+  // Returns true if segments can be laser raster lines (see
+  // LinearSegmentSteps).
+  virtual bool SupportsRaster() const { return false; }
+
+  // Get statistics about the queue. Returns 'false' if not supported.
+  virtual bool GetQueueStats(MotionQueueStats *stats) { return false; }
+
+  // Set the PWM outputs of the segments that started executing since the
+  // last call. Returns true if there are PWM changes waiting in the queue,
+  // so this should be called again soon.
+  virtual bool UpdateOutputs() { return false; }
+
+  // Watch the input "gpio_def" for "trigger_level" in the following segments
+  // with stop_on_input set; a "gpio_def" of 0 switches watching off. Only
+  // while the queue is empty. Returns false if not supported; then
+  // stop_on_input is ignored.
+  virtual bool WatchInput(uint32_t gpio_def, bool trigger_level) {
+    return false;
+  }
+
+  // Wait until the queue is empty. Returns true if the watched input stopped
+  // the stop_on_input segments; GetPhysicalStatus() then reports the
+  // position the motors stopped at.
+  virtual bool WaitInputStop() { WaitQueueEmpty(); return false; }
+
+  // Feed hold and override: change the speed of all enqueued segments,
+  // including the one executing, to "factor" (0..1) of their speed; 0 stops
+  // the motors until a factor > 0 is set. The speed changes linearly in time,
+  // from 0 to full speed in "ramp_seconds". Does not block and can be called
+  // from any thread. Returns false if not supported.
+  virtual bool SetSpeedOverride(float factor, float ramp_seconds) {
+    return false;
+  }
 };
 
 class HardwareMapping;
@@ -91,16 +205,70 @@ public:
   void WaitQueueEmpty() final;
   bool GetPhysicalStatus(PhysicalStatus *status) final;
   void SetExternalPosition(int axis, int pos) final;
+  float MaxStepFrequency(unsigned motor_mask) const final;
+  bool SupportsArcs() const final { return true; }
+  bool SupportsRaster() const final { return true; }
+  bool GetQueueStats(MotionQueueStats *stats) final;
+  bool UpdateOutputs() final;
+  bool WatchInput(uint32_t gpio_def, bool trigger_level) final;
+  bool WaitInputStop() final;
+  bool SetSpeedOverride(float factor, float ramp_seconds) final;
 
 private:
+  // Update queue statistics before enqueueing a segment starting with speed
+  // "v0". Returns true, if we are about to block for "slots_needed".
+  bool RecordQueueState(float v0, int slots_needed);
+  void RecordWait(int64_t start_usec);
+
   void EnqueueInternal(const LinearSegmentSteps &param,
                        int defining_axis_steps);
+  // Convert "param" into the MotionSegment "element" and record it in the
+  // shadow queue.
+  // The motion queue spends "extra_loop_cycles" in each loop besides
+  // generating the steps.
+  void FillMotionSegment(const LinearSegmentSteps &param,
+                         int defining_axis_steps, struct MotionSegment *element,
+                         int extra_loop_cycles = 0);
+
+  // Enqueue "param" as circular arc segments, followed by a short linear
+  // correction to arrive at the exact steps. Returns false if the arc can't
+  // be represented in the motion queue; nothing is enqueued then.
+  bool EnqueueArc(const LinearSegmentSteps &param);
+
+  // Enqueue "param" as one raster segment. Returns false if it can't be
+  // represented in the motion queue; nothing is enqueued then.
+  bool EnqueueRaster(const LinearSegmentSteps &param, int defining_axis_steps);
+  // Enqueue "param" as linear segments, one for each run of equal pixels.
+  void EnqueueRasterRuns(const LinearSegmentSteps &param,
+                         int defining_axis_steps);
 
   HardwareMapping *const hardware_mapping_;
   MotionQueue *backend_;
 
   struct HistorySegment;
-  std::deque<struct HistorySegment> *shadow_queue_;
+  class ShadowQueue;
+
+  // Record a new history segment as the newest element.
+  void PushHistory(const HistorySegment &segment);
+  // Drop all history we don't need anymore to reconstruct the position
+  // of the currently executing segment, given the number of elements still
+  // pending in the motion queue.
+  // Also sets the PWM outputs the executing segment asks for.
+  void ShrinkHistory(int pending_elements);
+
+  ShadowQueue *shadow_queue_;
+
+  // Segments enqueued with stop_on_input since WatchInput(), so that we can
+  // find the position the input stopped them.
+  struct WatchedSegment;
+  bool watching_input_;
+  std::vector<WatchedSegment> *watched_segments_;
+  float applied_pwm_[BEAGLEG_NUM_PWM_OUTPUTS];  // Last set on the hardware.
+
+  // If the backend counts steps: position minus the counter of each motor.
+  int counter_offset_[BEAGLEG_NUM_MOTORS];
+
+  MotionQueueStats stats_;
 };
 
 #endif  // _BEAGLEG_MOTOR_OPERATIONS_H_
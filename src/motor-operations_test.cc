@@ -7,6 +7,7 @@
  */
 #include "motion-queue.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,19 +17,31 @@
 #include "common/container.h"
 #include "common/logging.h"
 #include "hardware-mapping.h"
+#include "motor-interface-constants.h"
 #include "motor-operations.h"
 
 class MockMotionQueue : public MotionQueue {
 public:
-  MockMotionQueue() : remaining_loops_(0), queue_size_(0) {}
+  MockMotionQueue() : remaining_loops_(0), queue_size_(0), arc_segments_(0) {}
 
   void Enqueue(MotionSegment *segment) {
     remaining_loops_ = segment->loops_accel
       + segment->loops_travel + segment->loops_decel;
     queue_size_++;
+    if (segment->arc_shift) arc_segments_++;
+    last_segment_ = *segment;
   }
 
   void WaitQueueEmpty() {};
+  bool WatchInput(uint32_t gpio_def, bool trigger_level) {
+    input_loops_ = 0;
+    input_triggered_ = false;
+    return true;
+  }
+  bool InputTriggered(uint32_t *loops_done) {
+    *loops_done = input_loops_;
+    return input_triggered_;
+  }
   void MotorEnable(bool on) {};
   void Shutdown(bool flush_queue) {};
   int GetPendingElements(uint32_t *head_item_progress) {
@@ -45,9 +58,46 @@ public:
     queue_size_ = buffer_size;
   }
 
+  bool GetStepCounters(int32_t counters[MOTION_MOTOR_COUNT]) {
+    if (!counting_steps_) return false;
+    memcpy(counters, step_counters_, sizeof(step_counters_));
+    return true;
+  }
+
+  // Let the hardware count the steps, starting with "counters".
+  void SimStepCounters(const int32_t counters[MOTION_MOTOR_COUNT]) {
+    counting_steps_ = true;
+    memcpy(step_counters_, counters, sizeof(step_counters_));
+  }
+
+  bool SetSpeedFactor(float factor, float ramp_seconds) {
+    speed_factor_ = factor;
+    speed_ramp_seconds_ = ramp_seconds;
+    return true;
+  }
+
+  int arc_segments() const { return arc_segments_; }
+  float speed_factor() const { return speed_factor_; }
+  float speed_ramp_seconds() const { return speed_ramp_seconds_; }
+  const MotionSegment &last_segment() const { return last_segment_; }
+
+  // Simulate the watched input triggering after "loops_done".
+  void SimInputTrigger(uint32_t loops_done) {
+    input_loops_ = loops_done;
+    input_triggered_ = true;
+  }
+
 private:
   uint32_t remaining_loops_;
   unsigned int queue_size_;
+  int arc_segments_;
+  MotionSegment last_segment_;
+  uint32_t input_loops_ = 0;
+  bool input_triggered_ = false;
+  bool counting_steps_ = false;
+  int32_t step_counters_[MOTION_MOTOR_COUNT] = {};
+  float speed_factor_ = 1.0;
+  float speed_ramp_seconds_ = 0;
 };
 
 // Check that on init, the initial position is 0.
@@ -204,6 +254,276 @@ TEST(RealtimePosition, zero_loops_edge) {
   EXPECT_THAT(expected, ::testing::ContainerEq(status.pos_steps));
 }
 
+// If the motion queue counts the steps, these are the position; the history
+// is not needed.
+TEST(RealtimePosition, hardware_step_counters) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  const LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {1000, -500, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);
+  const int32_t counted[MOTION_MOTOR_COUNT] = {123, -45, 0, 0, 0, 0, 0, 0};
+  motion_backend.SimStepCounters(counted);
+
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  const int expected[BEAGLEG_NUM_MOTORS] = {123, -45, 0, 0, 0, 0, 0, 0};
+  EXPECT_THAT(expected, ::testing::ContainerEq(status.pos_steps));
+
+  // Setting the position moves the counted one the same way, that is, where
+  // the counter will be at the end of the queue.
+  motor_operations.SetExternalPosition(0, 3000);
+  motor_operations.GetPhysicalStatus(&status);
+  EXPECT_EQ(123 + 3000 - 1000, status.pos_steps[0]);
+  EXPECT_EQ(-45, status.pos_steps[1]);
+}
+
+// Long moves are one segment, as long as the motion queue can count the
+// loops.
+TEST(RealtimePosition, long_move_one_segment) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  const LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {1000000, -300000, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);
+  EXPECT_EQ(1, motion_backend.GetPendingElements(NULL));
+  EXPECT_EQ(2000000u, motion_backend.last_segment().loops_travel);
+}
+
+// Moves beyond that are split. The history must still track the position
+// of the last one.
+TEST(RealtimePosition, split_move_longer_than_segment) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  const int kSteps = 20000000;  // 2.4 times the steps of a segment.
+  const LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {kSteps, -kSteps / 2, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);
+  EXPECT_EQ(3, motion_backend.GetPendingElements(NULL));
+  motion_backend.SimRun(0, 1);
+
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  const int expected[BEAGLEG_NUM_MOTORS] = {kSteps, -kSteps / 2,
+                                            0, 0, 0, 0, 0, 0};
+  EXPECT_THAT(expected, ::testing::ContainerEq(status.pos_steps));
+}
+
+// A quarter circle is sent as arc segments; afterwards we're exactly at the
+// requested position, even if the firmware arithmetic is slightly off.
+TEST(RealtimePosition, quarter_circle_arc) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+  ASSERT_TRUE(motor_operations.SupportsArcs());
+
+  LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {2000, -2000, 10, 0, 0, 0, 0, 0} /* steps */
+  };
+  segment.arc_radius = 2000;
+  segment.arc_start = 0;
+  segment.arc_end = M_PI / 2;
+  segment.arc_rise_motors = (1 << 0);
+  segment.arc_fall_motors = (1 << 1);
+  motor_operations.Enqueue(segment);
+  EXPECT_GE(motion_backend.arc_segments(), 1);
+  motion_backend.SimRun(0, 0);
+
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  const int expected[BEAGLEG_NUM_MOTORS] = {2000, -2000, 10, 0, 0, 0, 0, 0};
+  EXPECT_THAT(expected, ::testing::ContainerEq(status.pos_steps));
+}
+
+// Raster lines become one segment with the pixels in the fraction words.
+TEST(RealtimePosition, raster_line_segment) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+  ASSERT_TRUE(motor_operations.SupportsRaster());
+
+  LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0x1 /* aux */,
+    {400, -400, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  segment.raster_pixels = 10;
+  segment.raster_aux_bits = 0x4;
+  segment.raster_data[0] = 0x05;
+  segment.raster_data[1] = 0x02;
+  motor_operations.Enqueue(segment);
+  const MotionSegment &s = motion_backend.last_segment();
+  EXPECT_EQ(1, s.raster);
+  EXPECT_EQ(0x3, s.motor_mask);
+  EXPECT_EQ(0x0205u, s.fractions[0]);
+  EXPECT_EQ(0x4u, s.fractions[7]);
+  EXPECT_EQ(0x1, s.aux);
+  const uint32_t loops = s.loops_accel + s.loops_travel + s.loops_decel;
+  // Pixel clock: 10 pixels over the whole segment.
+  EXPECT_EQ(((10ULL << 32) - 1) / loops, s.fractions[6]);
+  motion_backend.SimRun(0, 0);
+
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  const int expected[BEAGLEG_NUM_MOTORS] = {400, -400, 0, 0, 0, 0, 0, 0};
+  EXPECT_THAT(expected, ::testing::ContainerEq(status.pos_steps));
+}
+
+// The input stops the second of two watched segments half way; the ones
+// after are skipped.
+TEST(RealtimePosition, stop_on_input) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+  ASSERT_TRUE(motor_operations.WatchInput(0x1234, true));
+
+  LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {400, -400, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  segment.stop_on_input = true;
+  motor_operations.Enqueue(segment);
+  EXPECT_EQ(1, motion_backend.last_segment().stop_on_input);
+  const MotionSegment &s = motion_backend.last_segment();
+  const uint32_t loops = s.loops_accel + s.loops_travel + s.loops_decel;
+  motor_operations.Enqueue(segment);
+  motor_operations.Enqueue(segment);
+
+  motion_backend.SimInputTrigger(loops + loops / 2);
+  motion_backend.SimRun(0, 0);
+  EXPECT_TRUE(motor_operations.WaitInputStop());
+
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  const int expected[BEAGLEG_NUM_MOTORS] = {600, -600, 0, 0, 0, 0, 0, 0};
+  EXPECT_THAT(expected, ::testing::ContainerEq(status.pos_steps));
+
+  // Not watching anymore: not marked.
+  ASSERT_TRUE(motor_operations.WatchInput(0, false));
+  motor_operations.Enqueue(segment);
+  EXPECT_EQ(0, motion_backend.last_segment().stop_on_input);
+}
+
+// PWM changes only take effect once the segment they come with is executed.
+TEST(RealtimePosition, pwm_set_with_executing_segment) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  LinearSegmentSteps segment = {
+    0 /* v0 */, 0 /* v1 */, 0 /* aux */,
+    {100, 0, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);
+  segment.pwm_mask = 1 << 2;
+  segment.pwm_duty[2] = 0.5;
+  motor_operations.Enqueue(segment);
+  segment.pwm_mask = 0;                // Keeps the PWM as is.
+  segment.pwm_duty[2] = 0;
+  motor_operations.Enqueue(segment);
+
+  // First segment still running.
+  EXPECT_TRUE(motor_operations.UpdateOutputs());
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  EXPECT_EQ(0, status.pwm_duty[2]);
+
+  motion_backend.SimRun(0, 2);
+  EXPECT_FALSE(motor_operations.UpdateOutputs());
+  motor_operations.GetPhysicalStatus(&status);
+  EXPECT_EQ(0.5, status.pwm_duty[2]);
+
+  motion_backend.SimRun(0, 1);
+  motor_operations.GetPhysicalStatus(&status);
+  EXPECT_EQ(0.5, status.pwm_duty[2]);
+  EXPECT_EQ(0, status.pwm_duty[0]);
+}
+
+// Underruns are recorded if the queue was empty while a segment starting
+// at speed was still to come.
+TEST(QueueStats, underruns_and_depth) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  LinearSegmentSteps segment = {
+    0 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {100, 0, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);   // Starting from rest: fine.
+  segment.v0 = 1000;
+  motor_operations.Enqueue(segment);   // One pending: fine.
+  motion_backend.SimRun(0, 0);         // Oops, PRU ran dry.
+  motor_operations.Enqueue(segment);
+
+  MotionQueueStats stats;
+  ASSERT_TRUE(motor_operations.GetQueueStats(&stats));
+  EXPECT_EQ(3u, stats.segments);
+  EXPECT_EQ(1u, stats.underruns);
+  EXPECT_EQ(0u, stats.waits);
+  EXPECT_EQ(3u, stats.depth_histogram[0]);  // All with small queue depth.
+}
+
+// Nothing pending behind the element that is executing is not an underrun
+// yet: the motors are still moving.
+TEST(QueueStats, no_underrun_while_last_element_executes) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  LinearSegmentSteps segment = {
+    0 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {100, 0, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);
+  motion_backend.SimRun(50, 0);        // Last one, halfway through.
+  segment.v0 = 1000;
+  motor_operations.Enqueue(segment);
+
+  MotionQueueStats stats;
+  ASSERT_TRUE(motor_operations.GetQueueStats(&stats));
+  EXPECT_EQ(0u, stats.underruns);
+}
+
+// The speed override goes to the motion queue as is, with the ramp in
+// loops; the queue and the reported position don't change.
+TEST(SpeedOverride, forwarded_to_motion_queue) {
+  HardwareMapping hw;
+  MockMotionQueue motion_backend = MockMotionQueue();
+  MotionQueueMotorOperations motor_operations(&hw, &motion_backend);
+
+  const LinearSegmentSteps segment = {
+    1000 /* v0 */, 1000 /* v1 */, 0 /* aux */,
+    {1000, 0, 0, 0, 0, 0, 0, 0} /* steps */
+  };
+  motor_operations.Enqueue(segment);
+  motion_backend.SimRun(1000, 1);
+
+  ASSERT_TRUE(motor_operations.SetSpeedOverride(0, 0.25));  // Feed hold.
+  EXPECT_EQ(0, motion_backend.speed_factor());
+  EXPECT_EQ(0.25, motion_backend.speed_ramp_seconds());
+  EXPECT_EQ(1, motion_backend.GetPendingElements(NULL));
+
+  PhysicalStatus status;
+  motor_operations.GetPhysicalStatus(&status);
+  EXPECT_EQ(500, status.pos_steps[0]);  // Half of the loops done.
+
+  ASSERT_TRUE(motor_operations.SetSpeedOverride(0.5, 0.25));
+  EXPECT_EQ(0.5, motion_backend.speed_factor());
+}
+
 int main(int argc, char *argv[]) {
   Log_init("/dev/stderr");
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,200 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "path-preview.h"
+
+#include <time.h>
+
+#include "common/string-util.h"
+
+static int64_t get_time_usec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// The default arc and spline interpolation of the EventReceiver calls
+// coordinated_move() for each segment; here, these end up as vertices.
+class PathPreview::SegmentCollector : public GCodeParser::EventReceiver {
+public:
+  explicit SegmentCollector(PathPreview *preview) : preview_(preview) {}
+
+  bool coordinated_move(float feed, const AxesRegister &pos) final {
+    preview_->AddVertex(pos, kLine);
+    return true;
+  }
+  float arc_segment_length(float radius, float feed_mm_p_sec) final {
+    // Same segments as the machine uses.
+    return preview_->delegatee_->arc_segment_length(radius, feed_mm_p_sec);
+  }
+
+  void gcode_start(GCodeParser *parser) final {}
+  void go_home(AxisBitmap_t axis_bitmap) final {}
+  void set_speed_factor(float factor) final {}
+  void set_fanspeed(float value) final {}
+  void set_temperature(float degrees_c) final {}
+  void wait_temperature() final {}
+  void dwell(float time_ms) final {}
+  void motors_enable(bool enable) final {}
+  bool rapid_move(float feed, const AxesRegister &pos) final { return true; }
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    return NULL;
+  }
+
+private:
+  PathPreview *const preview_;
+};
+
+PathPreview::PathPreview(GCodeParser::EventReceiver *delegatee, FILE *out,
+                         int frame_interval_ms)
+  : delegatee_(delegatee), out_(out),
+    frame_interval_usec_((int64_t)frame_interval_ms * 1000),
+    collector_(new SegmentCollector(this)),
+    frame_count_(0), last_frame_usec_(get_time_usec()),
+    position_known_(false) {
+}
+
+PathPreview::~PathPreview() {
+  Flush();
+  delete collector_;
+}
+
+void PathPreview::AddVertex(const AxesRegister &pos, VertexKind kind) {
+  if (!position_known_) {
+    kind = kJump;
+    position_known_ = true;
+  }
+  if (!vertices_.empty()) vertices_.append(", ");
+  vertices_.append(StringPrintf("[%.3f, %.3f, %.3f, %d]",
+                                pos[AXIS_X], pos[AXIS_Y], pos[AXIS_Z], kind));
+  MaybeFlush();
+}
+
+void PathPreview::MaybeFlush() {
+  if (frame_interval_usec_ <= 0) return;
+  if (get_time_usec() - last_frame_usec_ >= frame_interval_usec_) Flush();
+}
+
+void PathPreview::Flush() {
+  last_frame_usec_ = get_time_usec();
+  if (vertices_.empty()) return;
+  fprintf(out_, "{\"frame\":%d, \"vertices\":[%s]}\n",
+          frame_count_, vertices_.c_str());
+  fflush(out_);
+  vertices_.clear();
+  ++frame_count_;
+}
+
+void PathPreview::gcode_start(GCodeParser *parser) {
+  delegatee_->gcode_start(parser);
+}
+void PathPreview::gcode_finished(bool end_of_stream) {
+  delegatee_->gcode_finished(end_of_stream);
+  Flush();
+}
+void PathPreview::inform_origin_offset(const AxesRegister &offset,
+                                       const char *named_offset) {
+  delegatee_->inform_origin_offset(offset, named_offset);
+}
+void PathPreview::gcode_command_done(char letter, float val) {
+  delegatee_->gcode_command_done(letter, val);
+}
+void PathPreview::input_idle(bool is_first) {
+  if (is_first) Flush();
+  delegatee_->input_idle(is_first);
+}
+void PathPreview::wait_for_start() {
+  Flush();
+  delegatee_->wait_for_start();
+}
+void PathPreview::go_home(AxisBitmap_t axis_bitmap) {
+  delegatee_->go_home(axis_bitmap);
+  position_known_ = false;
+}
+bool PathPreview::probe_axis(float feed_mm_p_sec, enum GCodeParserAxis axis,
+                             float *probed_position) {
+  position_known_ = false;
+  return delegatee_->probe_axis(feed_mm_p_sec, axis, probed_position);
+}
+void PathPreview::change_spindle_speed(float value) {
+  delegatee_->change_spindle_speed(value);
+}
+void PathPreview::set_speed_factor(float factor) {
+  delegatee_->set_speed_factor(factor);
+}
+void PathPreview::set_fanspeed(float value) {
+  delegatee_->set_fanspeed(value);
+}
+void PathPreview::set_temperature(float degrees_c) {
+  delegatee_->set_temperature(degrees_c);
+}
+void PathPreview::wait_temperature() {
+  Flush();
+  delegatee_->wait_temperature();
+}
+void PathPreview::dwell(float time_ms) {
+  delegatee_->dwell(time_ms);
+}
+void PathPreview::motors_enable(bool enable) {
+  delegatee_->motors_enable(enable);
+}
+void PathPreview::clamp_to_range(AxisBitmap_t affected, AxesRegister *axes) {
+  delegatee_->clamp_to_range(affected, axes);
+}
+bool PathPreview::coordinated_move(float feed_mm_p_sec,
+                                   const AxesRegister &pos) {
+  if (!delegatee_->coordinated_move(feed_mm_p_sec, pos))
+    return false;
+  AddVertex(pos, kLine);
+  return true;
+}
+bool PathPreview::rapid_move(float feed_mm_p_sec, const AxesRegister &pos) {
+  if (!delegatee_->rapid_move(feed_mm_p_sec, pos))
+    return false;
+  AddVertex(pos, kRapid);
+  return true;
+}
+void PathPreview::arc_move(float feed_mm_p_sec, GCodeParserAxis normal_axis,
+                           bool clockwise, const AxesRegister &start,
+                           const AxesRegister &center,
+                           const AxesRegister &end) {
+  delegatee_->arc_move(feed_mm_p_sec, normal_axis, clockwise,
+                       start, center, end);
+  collector_->arc_move(feed_mm_p_sec, normal_axis, clockwise,
+                       start, center, end);
+}
+void PathPreview::spline_move(float feed_mm_p_sec, const AxesRegister &start,
+                              const AxesRegister &cp1, const AxesRegister &cp2,
+                              const AxesRegister &end) {
+  delegatee_->spline_move(feed_mm_p_sec, start, cp1, cp2, end);
+  collector_->spline_move(feed_mm_p_sec, start, cp1, cp2, end);
+}
+void PathPreview::raster_move(float feed_mm_p_sec, const AxesRegister &start,
+                              const AxesRegister &end,
+                              const uint8_t *power, int count) {
+  delegatee_->raster_move(feed_mm_p_sec, start, end, power, count);
+  collector_->raster_move(feed_mm_p_sec, start, end, power, count);
+}
+float PathPreview::arc_segment_length(float radius, float feed_mm_p_sec) {
+  return delegatee_->arc_segment_length(radius, feed_mm_p_sec);
+}
+const char *PathPreview::unprocessed(char letter, float value,
+                                     const char *rest_of_line) {
+  return delegatee_->unprocessed(letter, value, rest_of_line);
+}
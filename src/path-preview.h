@@ -0,0 +1,116 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_PATH_PREVIEW_H_
+#define _BEAGLEG_PATH_PREVIEW_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "gcode-parser/gcode-parser.h"
+
+// Live preview of a running job. An EventReceiver tap that passes all events
+// on to the "delegatee" (typically the machine control) and collects the
+// G-code path, like gcode2ps does. The path is written as deltas: each frame
+// only contains the vertices that are new since the previous frame, so the
+// work of a viewer is proportional to the new moves, not to the whole job.
+//
+// Frames are one line of JSON each, with the vertex format of the gcode2ps
+// ThreeJS output plus the kind of move:
+//   {"frame":12, "vertices":[[x, y, z, kind], ...]}
+// with kind 0: coordinated move, 1: rapid move, 2: jump to that position
+// without a line (after homing, probing or the first known position).
+// Arcs and splines are sent as the line segments they are interpolated with.
+//
+// A frame is written once the frame interval has passed since the previous
+// one, and whenever the input is idle or finished.
+class PathPreview : public GCodeParser::EventReceiver {
+public:
+  // Write frames to "out", not more often than every "frame_interval_ms".
+  // With an interval of zero, frames are only written on idle input, at
+  // the end of the input or with Flush().
+  PathPreview(GCodeParser::EventReceiver *delegatee, FILE *out,
+              int frame_interval_ms);
+  ~PathPreview() override;
+
+  // Write a frame with the vertices collected so far, if there are any.
+  void Flush();
+
+  int frames_written() const { return frame_count_; }
+
+  void gcode_start(GCodeParser *parser) final;
+  void gcode_finished(bool end_of_stream) final;
+  void inform_origin_offset(const AxesRegister &offset,
+                            const char *named_offset) final;
+  void gcode_command_done(char letter, float val) final;
+  void input_idle(bool is_first) final;
+  void wait_for_start() final;
+  void go_home(AxisBitmap_t axis_bitmap) final;
+  bool probe_axis(float feed_mm_p_sec, enum GCodeParserAxis axis,
+                  float *probed_position) final;
+  void change_spindle_speed(float value) final;
+  void set_speed_factor(float factor) final;
+  void set_fanspeed(float value) final;
+  void set_temperature(float degrees_c) final;
+  void wait_temperature() final;
+  void dwell(float time_ms) final;
+  void motors_enable(bool enable) final;
+  void clamp_to_range(AxisBitmap_t affected, AxesRegister *axes) final;
+  bool coordinated_move(float feed_mm_p_sec,
+                        const AxesRegister &absolute_pos) final;
+  bool rapid_move(float feed_mm_p_sec,
+                  const AxesRegister &absolute_pos) final;
+  void arc_move(float feed_mm_p_sec,
+                GCodeParserAxis normal_axis, bool clockwise,
+                const AxesRegister &start,
+                const AxesRegister &center,
+                const AxesRegister &end) final;
+  void spline_move(float feed_mm_p_sec,
+                   const AxesRegister &start,
+                   const AxesRegister &cp1, const AxesRegister &cp2,
+                   const AxesRegister &end) final;
+  void raster_move(float feed_mm_p_sec,
+                   const AxesRegister &start, const AxesRegister &end,
+                   const uint8_t *power, int count) final;
+  float arc_segment_length(float radius, float feed_mm_p_sec) final;
+  const char *unprocessed(char letter, float value,
+                          const char *rest_of_line) final;
+
+private:
+  enum VertexKind { kLine = 0, kRapid = 1, kJump = 2 };
+
+  // Receives the line segments of interpolated arcs and splines.
+  class SegmentCollector;
+
+  void AddVertex(const AxesRegister &pos, VertexKind kind);
+  void MaybeFlush();
+
+  GCodeParser::EventReceiver *const delegatee_;
+  FILE *const out_;
+  const int64_t frame_interval_usec_;
+  SegmentCollector *const collector_;
+
+  std::string vertices_;      // JSON of the vertices of the next frame.
+  int frame_count_;
+  int64_t last_frame_usec_;
+  bool position_known_;       // If not, the next vertex is a jump.
+};
+
+#endif  // _BEAGLEG_PATH_PREVIEW_H_
@@ -0,0 +1,123 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the live path preview.
+ */
+#include "path-preview.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+namespace {
+// Counts what reaches the machine.
+class CountingReceiver : public GCodeParser::EventReceiver {
+public:
+  void gcode_start(GCodeParser *parser) final {}
+  void go_home(AxisBitmap_t axis_bitmap) final { ++homes; }
+  void set_speed_factor(float factor) final {}
+  void set_fanspeed(float value) final {}
+  void set_temperature(float degrees_c) final {}
+  void wait_temperature() final {}
+  void dwell(float time_ms) final {}
+  void motors_enable(bool enable) final {}
+  bool coordinated_move(float feed, const AxesRegister &pos) final {
+    ++moves;
+    return true;
+  }
+  bool rapid_move(float feed, const AxesRegister &pos) final {
+    ++moves;
+    return true;
+  }
+  void arc_move(float feed, GCodeParserAxis normal_axis, bool clockwise,
+                const AxesRegister &start, const AxesRegister &center,
+                const AxesRegister &end) final {
+    ++arcs;  // Native arc: not split into moves.
+  }
+  float arc_segment_length(float radius, float feed) final { return 1.0; }
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    return NULL;
+  }
+
+  int homes = 0;
+  int moves = 0;
+  int arcs = 0;
+};
+
+// Preview writing into memory.
+class PreviewHarness {
+public:
+  PreviewHarness() : out_(open_memstream(&buffer_, &size_)),
+                     preview_(new PathPreview(&machine_, out_, 0)),
+                     parser_(new GCodeParser(GCodeParser::Config(),
+                                             preview_)) {
+  }
+  ~PreviewHarness() {
+    delete parser_;
+    delete preview_;
+    fclose(out_);
+    free(buffer_);
+  }
+
+  void Parse(const char *gcode) { parser_->ParseBlock(gcode, NULL); }
+  PathPreview *preview() { return preview_; }
+  const CountingReceiver &machine() const { return machine_; }
+
+  std::string Output() {
+    fflush(out_);
+    return std::string(buffer_, size_);
+  }
+
+private:
+  CountingReceiver machine_;
+  char *buffer_ = NULL;
+  size_t size_ = 0;
+  FILE *out_;
+  PathPreview *preview_;
+  GCodeParser *parser_;
+};
+}  // namespace
+
+TEST(PathPreview, FramesOnlyContainNewVertices) {
+  PreviewHarness h;
+  h.Parse("G28\nG1 X10 Y0 F1000\nG0 X0 Y10\n");
+  EXPECT_EQ(1, h.machine().homes);
+  EXPECT_EQ(2, h.machine().moves);
+  EXPECT_EQ("", h.Output());  // Nothing before a time slice is over.
+
+  h.preview()->input_idle(true);
+  EXPECT_EQ("{\"frame\":0, \"vertices\":["
+            "[10.000, 0.000, 0.000, 2], [0.000, 10.000, 0.000, 1]]}\n",
+            h.Output());
+  h.preview()->input_idle(false);  // Nothing new: no frame.
+  EXPECT_EQ(1, h.preview()->frames_written());
+
+  h.Parse("G1 X5 Y10\n");
+  h.preview()->Flush();
+  EXPECT_EQ(2, h.preview()->frames_written());
+  const std::string out = h.Output();
+  EXPECT_EQ("{\"frame\":1, \"vertices\":[[5.000, 10.000, 0.000, 0]]}\n",
+            out.substr(out.find('\n') + 1));
+}
+
+TEST(PathPreview, ArcsAreSentAsSegments) {
+  PreviewHarness h;
+  h.Parse("G1 X10 Y0 F1000\nG3 X0 Y10 I-10 J0\n");
+  EXPECT_EQ(1, h.machine().arcs);  // The machine still gets the arc itself.
+  h.preview()->Flush();
+  const std::string out = h.Output();
+  // Quarter circle of radius 10: about 16 segments of 1mm.
+  int vertices = 0;
+  for (size_t pos = 0; (pos = out.find('[', pos + 1)) != std::string::npos;) {
+    ++vertices;
+  }
+  EXPECT_GE(vertices - 1, 1 + 15);  // Minus the array bracket.
+  EXPECT_NE(std::string::npos, out.find("[0.000, 10.000, 0.000, 0]]}"));
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,77 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Regression test of the planner on representative jobs: the estimated
+ * cycle time and number of segments have to stay as recorded. The time per
+ * line of G-code is checked by "make benchmark", as it depends on the
+ * machine this runs on.
+ *
+ * If a planner change intentionally changes the result, update the golden
+ * values with the ones printed on failure.
+ */
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "config-parser.h"
+#include "determine-print-stats.h"
+#include "gcode-machine-control.h"
+
+// Relative deviation from the golden values we accept.
+static constexpr float kCycleTimeTolerance = 0.005;
+static constexpr float kSegmentTolerance = 0.005;
+
+namespace {
+struct Workload {
+  // Job and the machine it is meant for; "make benchmark" uses the same.
+  const char *gcode_file;
+  const char *config_file;
+
+  // Golden values.
+  float cycle_time_seconds;
+  int segments;
+};
+}  // namespace
+
+static const Workload kWorkloads[] = {
+  // 3D printing: short moves with extrusion, many joints.
+  { "testdata/print-box-layers.gcode", "testdata/print-box-layers.config",
+    270.522, 4510 },
+  // Engraving: back and forth hatch lines, lots of starts and stops.
+  { "testdata/engrave-hatch.gcode", "testdata/engrave-hatch.config",
+    209.069, 2542 },
+  // Milling: everything arcs, cut into segments by the machine control.
+  { "testdata/mill-arc-pockets.gcode", "testdata/mill-arc-pockets.config",
+    813.508, 40408 },
+};
+
+TEST(PlannerRegression, CycleTimeAndSegmentsAsRecorded) {
+  for (const Workload &w : kWorkloads) {
+    ConfigParser config_parser;
+    ASSERT_TRUE(config_parser.SetContentFromFile(w.config_file))
+      << w.config_file;
+    MachineControlConfig config;
+    ASSERT_TRUE(config.ConfigureFromFile(&config_parser)) << w.config_file;
+    config.require_homing = false;
+    config.range_check = false;
+
+    const int fd = open(w.gcode_file, O_RDONLY);
+    ASSERT_GE(fd, 0) << w.gcode_file;
+    BeagleGPrintStats stats;
+    ASSERT_TRUE(determine_print_stats(fd, config, NULL, &stats));
+
+    printf("%-36s %9.3fs %8d segments\n", w.gcode_file,
+           stats.total_time_seconds, stats.segments);
+    EXPECT_NEAR(w.cycle_time_seconds, stats.total_time_seconds,
+                kCycleTimeTolerance * w.cycle_time_seconds) << w.gcode_file;
+    EXPECT_NEAR(w.segments, stats.segments,
+                kSegmentTolerance * w.segments) << w.gcode_file;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
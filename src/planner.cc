@@ -18,17 +18,61 @@
  */
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cmath>  // We use these functions as they work type-agnostic
 
 #include "common/logging.h"
 #include "common/container.h"
+#include "common/trace.h"
 
 #include "planner.h"
+#include "axis-compensation.h"
 #include "hardware-mapping.h"
 #include "gcode-machine-control.h"
+#include "kinematics.h"
 #include "motor-operations.h"
 
 namespace {
+// Type of the geometry on the hot path of the planner: segment vectors,
+// their lengths and the angles between them. The VFP-lite unit of the
+// Cortex-A8 takes several times longer for double than for float, so
+// PLANNER_FLOAT=1 in the Makefile selects float. Speeds and ramps stay in
+// double; they add up over many segments.
+#ifdef PLANNER_FLOAT_KERNEL
+typedef float planner_real;
+#else
+typedef double planner_real;
+#endif
+
+// Number of constant acceleration sub-segments an S-curve ramp is split into.
+enum { S_CURVE_SUBDIVISIONS = 8 };
+
+// Arcs with a smaller radius (in steps) are broken into line segments.
+enum { MIN_ARC_RADIUS_STEPS = 16 };
+
+// Most pieces a move is broken into to follow non-linear kinematics.
+enum { MAX_KINEMATICS_PIECES = 4096 };
+
+// Part of a circular arc that is executed by the motor backend. Arcs are cut
+// at the quadrants of the circle, so that no axis changes direction within
+// one piece.
+struct ArcPiece {
+  GCodeParserAxis plane[3];  // The two axes of the circle; helix axis.
+  double center[2];          // Center in steps of the plane axes.
+  double radius;             // In steps. Zero for linear moves.
+  double start, end;         // Angle at start and end position.
+  double steps;              // Steps along the circle.
+  double accel;              // Acceleration along the circle in steps/s^2.
+};
+
+// Laser raster along a linear move: "aux_bits" are switched on for the
+// pixels that are set in "data" (see LinearSegmentSteps).
+struct RasterLine {
+  int pixels;                // Zero if this is no raster line.
+  unsigned short aux_bits;
+  uint8_t data[BEAGLEG_MAX_RASTER_PIXELS / 8];
+};
+
 // The target position vector is essentially a position in the
 // GCODE_NUM_AXES-dimensional space.
 //
@@ -40,14 +84,45 @@ namespace {
 // used in planning along the path.
 struct AxisTarget {
   int position_steps[GCODE_NUM_AXES];  // Absolute position at end of segment. In steps.
+  int joint_steps[GCODE_NUM_AXES];     // Same, after kinematics (if any).
 
   // Derived values
   int delta_steps[GCODE_NUM_AXES];     // Difference to previous position.
   enum GCodeParserAxis defining_axis;  // index into defining axis.
   double speed;                         // (desired) speed in steps/s on defining axis.
   unsigned short aux_bits;             // Auxillary bits in this segment; set with M42
-  double dx, dy, dz;                    // 3D delta_steps in real units
-  double len;                           // 3D length
+  float pwm_duty[BEAGLEG_NUM_PWM_OUTPUTS];  // PWM outputs in this segment.
+  planner_real dx, dy, dz;              // 3D delta_steps in real units
+  planner_real len;                     // 3D length
+
+  // For arcs, the speed is along the circle and "len" the length of the
+  // arc, while dx, dy, dz are the delta of the end points.
+  struct ArcPiece arc;
+
+  struct RasterLine raster;
+
+  // Highest speed on the defining axis we are allowed to have at the end of
+  // this segment, so that all upcoming segments in the planning buffer can
+  // still decelerate to a full stop in time. Updated by the backward pass.
+  double max_exit_speed;
+};
+
+// The angles that determine_joining_speed() compares with, as cosines: the
+// angle between two segments is the arc cosine of their normalized dot
+// product, and the smaller the angle the larger the cosine. So we can
+// compare directly without calling acos() for each segment.
+struct JoiningAngles {
+  void Set(float threshold_angle, float speed_tune_angle) {
+    const double deg2rad = M_PI / 180.0;
+    // A negative threshold is never reached.
+    cos_threshold = threshold_angle < 0
+      ? 2 : std::cos(std::min(threshold_angle, 180.0f) * deg2rad);
+    cos_tune = std::cos(speed_tune_angle * deg2rad);
+    sin_tune = std::sin(speed_tune_angle * deg2rad);
+  }
+
+  planner_real cos_threshold;
+  planner_real cos_tune, sin_tune;   // of the speed tune angle.
 };
 }  // end anonymous namespace
 
@@ -59,24 +134,77 @@ public:
   ~Impl();
 
   void move_machine_steps(const struct AxisTarget *last_pos,
-                          struct AxisTarget *target_pos,
-                          const struct AxisTarget *upcoming);
+                          struct AxisTarget *target_pos);
 
   void assign_steps_to_motors(struct LinearSegmentSteps *command,
                               enum GCodeParserAxis axis,
                               int steps);
 
+  // Send an acceleration or deceleration segment to the motors; if
+  // configured, break it up into an S-curve velocity profile.
+  void enqueue_ramp(const struct LinearSegmentSteps &ramp);
+
+  void plan_backward();
   void issue_motor_move_if_possible();
-  void machine_move(const AxesRegister &axis, float feedrate);
+  void machine_move(const AxesRegister &axis, float feedrate,
+                    const struct RasterLine *raster = nullptr);
+  // Plan a move to "axis". With kinematics, its joint positions are
+  // "joints_mm" of X, Y, Z or, if nullptr, calculated.
+  void plan_move(const AxesRegister &axis, float feedrate,
+                 const struct RasterLine *raster, const float *joints_mm);
+  // Break a move into pieces that stay close enough to the straight line
+  // with non-linear kinematics.
+  void segmented_move(const AxesRegister &axis, float feedrate);
+  // Set the joint_steps of "t" from its position_steps. Returns false if
+  // out of reach.
+  bool inverse_kinematics(struct AxisTarget *t);
+  bool machine_arc(GCodeParserAxis normal_axis, bool clockwise,
+                   const AxesRegister &center, const AxesRegister &axis,
+                   float feedrate);
+  bool machine_raster(const AxesRegister &axis, float feedrate,
+                      unsigned short raster_aux_bits,
+                      const uint8_t *data, int pixels);
   void bring_path_to_halt();
 
+  // Remember the current aux and PWM outputs in "t", to be set along with it.
+  void capture_outputs(struct AxisTarget *t);
+  // Set the outputs of "t" in "command" and return true if they differ from
+  // the ones enqueued last.
+  bool assign_output_changes(const struct AxisTarget *t,
+                             struct LinearSegmentSteps *command);
+  // Enqueue a segment without steps if outputs of "t" changed.
+  void enqueue_output_changes(const struct AxisTarget *t);
+
+  // Acceleration of the defining axis in steps/s^2 that none of the
+  // participating axes exceeds its own acceleration limit.
   float acceleration_for_move(const int *axis_steps,
-                              enum GCodeParserAxis defining_axis) {
-    return max_axis_accel_[defining_axis];
-    // TODO: we need to scale the acceleration if one of the other axes could't
-    // deal with it. Look at axis steps for that.
+                              enum GCodeParserAxis defining_axis);
+  float acceleration_for_target(const struct AxisTarget *t) {
+    if (t->arc.radius > 0) return t->arc.accel;
+    return acceleration_for_move(t->delta_steps, t->defining_axis);
   }
 
+  // Motor steps of each axis to go from "last_pos" to "t", with the
+  // mechanical compensation applied. Remembers the new direction and motor
+  // position of the axes; "motor_start" receives the previous position.
+  void compensated_steps(const struct AxisTarget *last_pos,
+                         const struct AxisTarget *t,
+                         int *motor_start, int *motor_steps);
+
+  // Steps of the arc "t" going from fraction "from" to "to" of its length
+  // assigned to the motors of "command", which becomes an arc segment.
+  // "motor_start" is the compensated motor position at "last_pos".
+  // Returns true if there are any steps.
+  bool assign_arc_steps(const struct AxisTarget *last_pos,
+                        const struct AxisTarget *t, const int *motor_start,
+                        double from, double to,
+                        struct LinearSegmentSteps *command);
+
+  // Pixels of the raster line "t" from fraction "from" to "to" of its
+  // length assigned to "command".
+  void assign_raster(const struct AxisTarget *t, double from, double to,
+                     struct LinearSegmentSteps *command);
+
   // Avoid division by zero if there is no config defined for axis.
   double axis_delta_to_mm(const AxisTarget *pos, enum GCodeParserAxis axis) {
     if (cfg_->steps_per_mm[axis] != 0.0)
@@ -86,9 +214,58 @@ public:
 
   double euclidian_speed(const struct AxisTarget *t);
 
+  // Euclidian speed of "t" in mm/s.
+  double euclid_speed_mm(const struct AxisTarget *t) {
+    if (t->arc.radius > 0) return t->speed * t->len / t->arc.steps;
+    const double axis_len_mm = std::fabs(axis_delta_to_mm(t, t->defining_axis));
+    if (axis_len_mm == 0) return 0.0;
+    return t->speed / cfg_->steps_per_mm[t->defining_axis] * t->len / axis_len_mm;
+  }
+
+  // The other way around: speed of "t" in its units for euclidian "v_mm".
+  double speed_from_euclid_mm(const struct AxisTarget *t, double v_mm) {
+    if (t->arc.radius > 0) return v_mm * t->arc.steps / t->len;
+    const GCodeParserAxis axis = t->defining_axis;
+    return v_mm * std::fabs(axis_delta_to_mm(t, axis)) / t->len
+      * cfg_->steps_per_mm[axis];
+  }
+
+  // Unit vector of the direction of "t" at its start or end.
+  void direction(const struct AxisTarget *t, bool at_end, planner_real u[3]);
+
+  // Joining speed for arcs without the junction deviation model.
+  double tangent_joining_speed(const struct AxisTarget *from,
+                               const struct AxisTarget *to);
+
+  // Joining speed between "from" and "to" with the junction deviation
+  // cornering model. Returns speed of the defining axis of "from".
+  double junction_deviation_speed(const struct AxisTarget *from,
+                                  const struct AxisTarget *to);
+  // Chooses the configured cornering model.
+  double joining_speed(const struct AxisTarget *from,
+                       const struct AxisTarget *to);
+
   void GetCurrentPosition(AxesRegister *pos);
+  void GetLastTargetPosition(AxesRegister *pos);
+  bool HasPendingPWMChanges() const;
   int DirectDrive(GCodeParserAxis axis, float distance, float v0, float v1);
+  void DirectDrive(const AxesRegister &distance, float v0, float v1);
+  bool DirectDriveToInput(GCodeParserAxis axis, float distance, float v,
+                          const HardwareMapping::SwitchInput &input,
+                          int *steps_moved, bool *triggered);
   void SetExternalPosition(GCodeParserAxis axis, float pos);
+  void ConfigChanged();
+  bool IsPathHalted() const { return path_halted_; }
+
+  // Steps of a homing or probing move of each axis by "distance" mm.
+  void assign_direct_steps(struct LinearSegmentSteps *command,
+                           const AxesRegister &distance);
+  // Highest speed in steps/s "axis" can go in a homing or probing move.
+  float max_direct_speed(GCodeParserAxis axis);
+  // Position of "axis" in steps, as homing and probing see it.
+  int direct_axis_steps(GCodeParserAxis axis, const PhysicalStatus &status);
+  // The joint of "axis" is at "steps": tell the motor operations.
+  void set_external_joint(GCodeParserAxis axis, int steps);
 
   // Given the desired target speed of the defining axis and the steps to be
   // performed on all axes, determine if we need to scale down as to not exceed
@@ -104,16 +281,32 @@ private:
   MotorOperations *const motor_ops_;
 
   // Next buffered positions. Written by incoming gcode, read by outgoing
-  // motor movements.
-  RingDeque<AxisTarget, 4> planning_buffer_;
+  // motor movements. Element [0] is the position we have already reached,
+  // everything after that is to be planned; we keep up to lookahead_ + 1 of
+  // these before emitting the oldest one.
+  // (Capacity: established position + lookahead + new segment + halt)
+  RingDeque<AxisTarget, Planner::MAX_LOOKAHEAD + 3> planning_buffer_;
+  int lookahead_;
 
   // Pre-calculated per axis limits in steps, steps/s, steps/s^2
   // All arrays are indexed by axis.
   AxesRegister max_axis_speed_;   // max travel speed hz
   AxesRegister max_axis_accel_;   // acceleration hz/s
   float highest_accel_;           // hightest accel of all axes.
+  JoiningAngles joining_angles_;
+  // Cosine of the angle up to which arc pieces join tangentially.
+  planner_real cos_tangent_threshold_;
+
+  // Backlash and error table of each axis. Motor steps are emitted for the
+  // compensated position, while the planning happens in axis positions.
+  AxisCompensation compensation_[GCODE_NUM_AXES];
+  Kinematics *kinematics_;                // nullptr for cartesian machines.
+  KinematicsBatch batch_;
+  int travel_direction_[GCODE_NUM_AXES];  // Sign of the last move; 0: unknown
+  int motor_position_[GCODE_NUM_AXES];    // Compensated planning_buffer_[0]
 
   HardwareMapping::AuxBitmap last_aux_bits_;  // last enqueued aux bits.
+  float last_pwm_duty_[BEAGLEG_NUM_PWM_OUTPUTS];  // last enqueued PWM.
 
   bool path_halted_;
   bool position_known_;
@@ -140,10 +333,32 @@ static double get_peak_speed(int s, double v0, double v2, double a) {
   return std::sqrt(v2*v2 + v0*v0 + 2 * a * s) / std::sqrt(2.0);
 }
 
-static double euclid_distance(double x, double y, double z) {
+static planner_real euclid_distance(planner_real x, planner_real y,
+                                    planner_real z) {
   return std::sqrt(x*x + y*y + z*z);
 }
 
+// Steps that the speed of "t" refers to: on the defining axis, or along the
+// circle for arcs.
+static int defining_steps(const struct AxisTarget *t) {
+  if (t->arc.radius > 0) return std::max(1L, std::lround(t->arc.steps));
+  return abs(t->delta_steps[t->defining_axis]);
+}
+
+// Speed "v" in steps/s of the defining axis of "t" converted to steps/s of the
+// defining axis of "other", at the same speed along the path. The defining
+// axes and their share of the path differ between segments, and so do
+// steps/mm of the axes. Moves that have no length in space, e.g. extruder
+// only, keep the value.
+static double convert_speed(const struct AxisTarget *t, double v,
+                            const struct AxisTarget *other) {
+  const int t_steps = defining_steps(t);
+  const int other_steps = defining_steps(other);
+  if (t->len <= 0 || other->len <= 0 || t_steps == 0 || other_steps == 0)
+    return v;
+  return v * t->len * other_steps / (other->len * t_steps);
+}
+
 // Number of steps to accelerate or decelerate (negative "a") from speed
 // v0 to speed v1. Modifies v1 if we can't reach the speed with the allocated
 // number of steps.
@@ -162,6 +377,14 @@ static double steps_for_speed_change(double a, double v0, double *v1,
   return max_steps;
 }
 
+// Returns true if "command" moves any motor.
+static bool has_steps(const struct LinearSegmentSteps &command) {
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    if (command.steps[i] != 0) return true;
+  }
+  return false;
+}
+
 // Returns true, if all results in zero movement
 static bool subtract_steps(struct LinearSegmentSteps *value,
                            const struct LinearSegmentSteps &subtract) {
@@ -188,27 +411,26 @@ static bool within_acceptable_range(double new_val, double old_val,
 // cutting it :)
 static double determine_joining_speed(const struct AxisTarget *from,
                                       const struct AxisTarget *to,
-                                      const double threshold,
-                                      const double speed_tune_angle) {
+                                      const JoiningAngles &angles) {
   // the dot product of the vectors
-  const double dot = from->dx*to->dx + from->dy*to->dy + from->dz*to->dz;
-  const double mag = from->len * to->len;
+  const planner_real dot = from->dx*to->dx + from->dy*to->dy + from->dz*to->dz;
+  const planner_real mag = from->len * to->len;
   if (dot == 0) return 0.0;         // orthogonal 90 degree, full stop
   if (dot < 0) return 0.0;          // turning around, full stop
-  const double dotmag = dot / mag;
+  const planner_real dotmag = dot / mag;
   if (within_acceptable_range(1.0, dotmag, 1e-5))
     return to->speed;               // codirectional 0 degree, keep accelerating
 
-  // the angle between the vectors
-  const double rad2deg = 180.0 / M_PI;
-  const double angle = std::fabs(std::acos(dotmag) * rad2deg);
-
-  if (angle >= 45.0)
-    return 0.0;                     // angle to large, come to full stop
-  if (angle <= threshold) {         // in tolerance, keep accelerating
+  // dotmag is the cosine of the angle between the vectors.
+  if (dotmag <= (planner_real) M_SQRT1_2)
+    return 0.0;                     // 45 degrees or more, come to full stop
+  if (dotmag >= angles.cos_threshold) {  // in tolerance, keep accelerating
     if (dot < 1) {                  // speed tune segments less than 1mm (i.e. arcs)
-      const double deg2rad = M_PI / 180.0;
-      const double angle_speed_adj = std::cos((angle + speed_tune_angle) * deg2rad);
+      // cos(angle + speed_tune_angle), the sine of the angle between the
+      // vectors being positive.
+      const planner_real sin_angle = std::sqrt(1 - dotmag * dotmag);
+      const planner_real angle_speed_adj
+        = dotmag * angles.cos_tune - sin_angle * angles.sin_tune;
       return to->speed * angle_speed_adj;
     }
     return to->speed;
@@ -253,7 +475,19 @@ Planner::Impl::Impl(const MachineControlConfig *config,
                     MotorOperations *motor_backend)
   : cfg_(config), hardware_mapping_(hardware_mapping),
     motor_ops_(motor_backend),
-    highest_accel_(-1), path_halted_(true), position_known_(true) {
+    last_aux_bits_(0),
+    path_halted_(true), position_known_(true) {
+  bzero(last_pwm_duty_, sizeof(last_pwm_duty_));
+  if (!Kinematics::Create(*config, &kinematics_))
+    kinematics_ = nullptr;  // Reported in the config validation.
+  bzero(travel_direction_, sizeof(travel_direction_));
+  bzero(motor_position_, sizeof(motor_position_));
+  for (const GCodeParserAxis axis : AllAxes()) {
+    compensation_[axis] = AxisCompensation(config->steps_per_mm[axis],
+                                           config->backlash_mm[axis],
+                                           config->error_map_spacing[axis],
+                                           config->error_map[axis]);
+  }
   // Initial machine position. We assume the homed position here, which is
   // wherever the endswitch is for each axis.
   struct AxisTarget *init_axis = planning_buffer_.append();
@@ -265,21 +499,30 @@ Planner::Impl::Impl(const MachineControlConfig *config,
     SetExternalPosition(axis, home_pos);
   }
   position_known_ = true;
+  ConfigChanged();
+}
 
-  float lowest_accel = cfg_->max_feedrate[AXIS_X] * cfg_->steps_per_mm[AXIS_X];
+// The values derived from the configuration that can change while running.
+void Planner::Impl::ConfigChanged() {
+  assert(path_halted_);
+  lookahead_ = std::max(1, std::min((int)Planner::MAX_LOOKAHEAD,
+                                    cfg_->lookahead_segments));
+  highest_accel_ = -1;
   for (const GCodeParserAxis i : AllAxes()) {
     max_axis_speed_[i] = cfg_->max_feedrate[i] * cfg_->steps_per_mm[i];
     const float accel = cfg_->acceleration[i] * cfg_->steps_per_mm[i];
     max_axis_accel_[i] = accel;
     if (accel > highest_accel_)
       highest_accel_ = accel;
-    if (accel < lowest_accel)
-      lowest_accel = accel;
   }
+  joining_angles_.Set(cfg_->threshold_angle, cfg_->speed_tune_angle);
+  cos_tangent_threshold_
+    = std::cos(std::max(0.1f, cfg_->threshold_angle) * M_PI / 180.0);
 }
 
 Planner::Impl::~Impl() {
   bring_path_to_halt();
+  delete kinematics_;
 }
 
 // Assign steps to all the motors responsible for given axis.
@@ -289,6 +532,22 @@ void Planner::Impl::assign_steps_to_motors(struct LinearSegmentSteps *command,
   hardware_mapping_->AssignMotorSteps(axis, steps, command);
 }
 
+void Planner::Impl::compensated_steps(const struct AxisTarget *last_pos,
+                                      const struct AxisTarget *t,
+                                      int *motor_start, int *motor_steps) {
+  const int *from = kinematics_ ? last_pos->joint_steps
+                                : last_pos->position_steps;
+  const int *to = kinematics_ ? t->joint_steps : t->position_steps;
+  for (const GCodeParserAxis a : AllAxes()) {
+    const int delta = to[a] - from[a];
+    if (delta != 0) travel_direction_[a] = delta > 0 ? 1 : -1;
+    motor_start[a] = motor_position_[a];
+    motor_position_[a] = compensation_[a].MotorPosition(to[a],
+                                                        travel_direction_[a]);
+    motor_steps[a] = motor_position_[a] - motor_start[a];
+  }
+}
+
 // Example with speed: given i the axis with the highest (relative) out of bounds
 // speed, what's the speed of the defining_axis so that every speed respects i's
 // bounds? The defining axis should be rescaled with this maximum offset.
@@ -308,6 +567,26 @@ double Planner::Impl::clamp_to_limits(enum GCodeParserAxis defining_axis,
   return target_speed * max_offset;
 }
 
+// Each axis accelerates proportionally to its share of the steps of the
+// defining axis. So an axis i limits the defining axis acceleration to
+// max_axis_accel_[i] * defining_steps / steps_i. We take the minimum of these,
+// so that fast axes are only slowed down if a slower one is involved.
+float Planner::Impl::acceleration_for_move(const int *axis_steps,
+                                           enum GCodeParserAxis defining_axis) {
+  const double defining_steps = abs(axis_steps[defining_axis]);
+  double accel = max_axis_accel_[defining_axis];
+  if (defining_steps == 0) return accel;
+  for (const GCodeParserAxis i : AllAxes()) {
+    if (i == defining_axis || axis_steps[i] == 0) continue;
+    if (max_axis_accel_[i] <= 0) continue;  // Not configured, no limit.
+    const double limit = max_axis_accel_[i] * defining_steps / abs(axis_steps[i]);
+    if (limit < accel) accel = limit;
+  }
+  // With S-curves, we don't have full acceleration in the jerk phases; plan
+  // with the average acceleration so that the peak stays within limits.
+  return accel * (1.0 - cfg_->s_curve_fraction / 2);
+}
+
 double Planner::Impl::euclidian_speed(const struct AxisTarget *t) {
   double speed_factor = 1.0;
   if (t->len > 0) {
@@ -317,6 +596,113 @@ double Planner::Impl::euclidian_speed(const struct AxisTarget *t) {
   return t->speed * speed_factor;
 }
 
+// Junction deviation: we pretend to go through the corner on a circular arc
+// that deviates at most cfg_->junction_deviation mm from the actual corner
+// point. The speed at which the centripetal acceleration on that arc stays
+// within what the axes can do is v = sqrt(a * r) with
+// r = deviation * sin(theta/2) / (1 - sin(theta/2)), theta being the
+// angle between the incoming and outgoing segment (180 degrees: straight).
+//
+// Unlike the angle threshold, this gives a smooth, always positive speed
+// for all but complete reversals, so polyline approximations of curves
+// can be traversed without coming to a stop.
+// Axes without configured acceleration don't limit, as everywhere else.
+double Planner::Impl::junction_deviation_speed(const struct AxisTarget *from,
+                                               const struct AxisTarget *to) {
+  if (from->len <= 0 || to->len <= 0) {
+    // Non-euclidian movement, e.g. only extruder or rotational axes.
+    return determine_joining_speed(from, to, joining_angles_);
+  }
+  planner_real from_u[3], to_u[3];
+  direction(from, true, from_u);
+  direction(to, false, to_u);
+  const planner_real from_ux = from_u[0], from_uy = from_u[1], from_uz = from_u[2];
+  const planner_real to_ux = to_u[0], to_uy = to_u[1], to_uz = to_u[2];
+
+  // Speed of "to" in mm/s; nothing joins faster than that.
+  double v_mm = euclid_speed_mm(to);
+
+  const planner_real cos_theta
+    = -(from_ux*to_ux + from_uy*to_uy + from_uz*to_uz);
+  if (cos_theta > 0.999999)
+    return 0.0;   // Reversal.
+  if (cos_theta > -0.999999) {
+    // The centripetal acceleration points along the difference of the unit
+    // vectors. Limit it by the acceleration of each axis in that direction.
+    planner_real jx = to_ux - from_ux, jy = to_uy - from_uy, jz = to_uz - from_uz;
+    const planner_real jlen = euclid_distance(jx, jy, jz);
+    jx /= jlen; jy /= jlen; jz /= jlen;
+    const planner_real j[3] = { jx, jy, jz };
+    double accel = -1;
+    for (int i = AXIS_X; i <= AXIS_Z; ++i) {
+      if (std::fabs(j[i]) < 1e-9) continue;
+      if (cfg_->acceleration[(GCodeParserAxis)i] <= 0) continue;
+      const double axis_accel = cfg_->acceleration[(GCodeParserAxis)i]
+        / std::fabs(j[i]);
+      if (accel < 0 || axis_accel < accel) accel = axis_accel;
+    }
+    const planner_real sin_theta_half = std::sqrt((1 - cos_theta) / 2);
+    const double radius = cfg_->junction_deviation * sin_theta_half
+      / (1.0 - sin_theta_half);
+    if (accel > 0)
+      v_mm = std::min(v_mm, std::sqrt(accel * radius));
+  }
+
+  // Back into steps/s of the defining axis of "from".
+  return speed_from_euclid_mm(from, v_mm);
+}
+
+void Planner::Impl::direction(const struct AxisTarget *t, bool at_end,
+                              planner_real u[3]) {
+  if (t->arc.radius <= 0) {
+    u[0] = t->dx / t->len;
+    u[1] = t->dy / t->len;
+    u[2] = t->dz / t->len;
+    return;
+  }
+  // Tangent of the circle, plus the helix.
+  const ArcPiece &arc = t->arc;
+  const double angle = at_end ? arc.end : arc.start;
+  const double turn = arc.end > arc.start ? 1.0 : -1.0;
+  const double planar_mm = arc.steps / cfg_->steps_per_mm[arc.plane[0]];
+  double v[GCODE_NUM_AXES] = {};
+  v[arc.plane[0]] = -turn * std::sin(angle) * planar_mm / t->len;
+  v[arc.plane[1]] = turn * std::cos(angle) * planar_mm / t->len;
+  v[arc.plane[2]] = axis_delta_to_mm(t, arc.plane[2]) / t->len;
+  u[0] = v[AXIS_X];
+  u[1] = v[AXIS_Y];
+  u[2] = v[AXIS_Z];
+}
+
+// Without the junction deviation, corners are usually judged by comparing
+// the axis speeds of both segments. For arcs we compare the tangents
+// instead: keep going if it doesn't turn more than the threshold angle,
+// stop otherwise.
+double Planner::Impl::tangent_joining_speed(const struct AxisTarget *from,
+                                            const struct AxisTarget *to) {
+  if (from->len <= 0 || to->len <= 0)
+    return 0.0;
+  planner_real from_u[3], to_u[3];
+  direction(from, true, from_u);
+  direction(to, false, to_u);
+  const planner_real cos_angle =
+    from_u[0]*to_u[0] + from_u[1]*to_u[1] + from_u[2]*to_u[2];
+  // Pieces of the same arc join tangentially, up to rounding.
+  if (cos_angle < cos_tangent_threshold_)
+    return 0.0;
+  const double v_mm = std::min(euclid_speed_mm(from), euclid_speed_mm(to));
+  return speed_from_euclid_mm(from, v_mm);
+}
+
+double Planner::Impl::joining_speed(const struct AxisTarget *from,
+                                    const struct AxisTarget *to) {
+  if (cfg_->junction_deviation > 0)
+    return junction_deviation_speed(from, to);
+  if (from->arc.radius > 0 || to->arc.radius > 0)
+    return tangent_joining_speed(from, to);
+  return determine_joining_speed(from, to, joining_angles_);
+}
+
 // Move the given number of machine steps for each axis.
 //
 // This will be up to three segments: accelerating from last_pos speed to
@@ -328,16 +714,9 @@ double Planner::Impl::euclidian_speed(const struct AxisTarget *t) {
 // Since we calculate the deceleration, this modifies the speed of target_pos
 // to reflect what the last speed was at the end of the move.
 void Planner::Impl::move_machine_steps(const struct AxisTarget *last_pos,
-                                       struct AxisTarget *target_pos,
-                                       const struct AxisTarget *upcoming) {
-  if (target_pos->delta_steps[target_pos->defining_axis] == 0) {
-    if (last_aux_bits_ != target_pos->aux_bits) {
-      // Special treatment: bits changed since last time, let's push them through.
-      struct LinearSegmentSteps bit_set_command = {};
-      bit_set_command.aux_bits = target_pos->aux_bits;
-      motor_ops_->Enqueue(bit_set_command);
-      last_aux_bits_ = target_pos->aux_bits;
-    }
+                                       struct AxisTarget *target_pos) {
+  if (defining_steps(target_pos) == 0) {
+    enqueue_output_changes(target_pos);
     return;
   }
   struct LinearSegmentSteps accel_command = {};
@@ -346,32 +725,49 @@ void Planner::Impl::move_machine_steps(const struct AxisTarget *last_pos,
 
   assert(target_pos->speed > 0);  // Speed is always a positive scalar.
 
-  // Aux bits are set synchronously with what we need.
-  move_command.aux_bits = target_pos->aux_bits;
+  // Aux bits and PWM are set synchronously with what we need.
+  assign_output_changes(target_pos, &move_command);
   const enum GCodeParserAxis defining_axis = target_pos->defining_axis;
 
   // Common settings.
   memcpy(&accel_command, &move_command, sizeof(accel_command));
   memcpy(&decel_command, &move_command, sizeof(decel_command));
 
-  // Always start from the last steps/sec speed to avoid motion glitches.
+  // Always start from the last speed to avoid motion glitches.
   // The planner will use that speed to determine what the peak speed for
   // this move is and if we need to accel to reach the desired target speed.
-  const double last_speed = last_pos->speed;
-
-  // We need to arrive at a speed that the upcoming move does not have
-  // to decelerate further (after all, it has a fixed feed-rate it should not
-  // go over).
-  double next_speed = determine_joining_speed(target_pos, upcoming,
-                                             cfg_->threshold_angle,
-                                             cfg_->speed_tune_angle);
+  const double last_speed = convert_speed(last_pos, last_pos->speed,
+                                          target_pos);
+
+  // We need to arrive at a speed that the upcoming moves do not have
+  // to decelerate further (after all, they have a fixed feed-rate they should
+  // not go over) and that still allows them to come to a stop at the end of
+  // what we know so far. This has been determined in plan_backward().
+  double next_speed = target_pos->max_exit_speed;
   // Clamp the next speed to insure that this segment does not go over.
   if (next_speed > target_pos->speed)
     next_speed = target_pos->speed;
 
   const int *axis_steps = target_pos->delta_steps;  // shortcut.
-  const int abs_defining_axis_steps = abs(axis_steps[defining_axis]);
-  const double a = acceleration_for_move(axis_steps, defining_axis);
+  // What the motors do: axis steps, with backlash and error compensation.
+  // Linear moves take up the difference along the way.
+  int motor_start[GCODE_NUM_AXES];
+  int motor_steps[GCODE_NUM_AXES];
+  compensated_steps(last_pos, target_pos, motor_start, motor_steps);
+  const bool is_arc = target_pos->arc.radius > 0;
+  const bool is_raster = target_pos->raster.pixels > 0;
+  const int abs_defining_axis_steps = defining_steps(target_pos);
+  // The motion queue takes the speed of the motor with the most steps,
+  // which, if kinematics mix the axes, is not the one of the defining axis.
+  double motor_speed_factor = 1;
+  if (kinematics_) {
+    int most_steps = 0;
+    for (const GCodeParserAxis a : AllAxes())
+      most_steps = std::max(most_steps, abs(motor_steps[a]));
+    if (most_steps > 0)
+      motor_speed_factor = 1.0 * most_steps / abs_defining_axis_steps;
+  }
+  const double a = acceleration_for_target(target_pos);
   const double peak_speed = get_peak_speed(abs_defining_axis_steps,
                                           last_speed, next_speed, a);
   assert(peak_speed > 0);
@@ -384,10 +780,12 @@ void Planner::Impl::move_machine_steps(const struct AxisTarget *last_pos,
   }
 
   // Make sure the target feedrate for the move is clamped to what all the
-  // moving axes can reach.
-  double target_feedrate = target_pos->speed / cfg_->steps_per_mm[defining_axis];
-  target_feedrate = clamp_to_limits(defining_axis, target_feedrate, axis_steps);
-  target_pos->speed = target_feedrate * cfg_->steps_per_mm[defining_axis];
+  // moving axes can reach. (Arcs have been clamped in machine_arc()).
+  if (!is_arc) {
+    double target_feedrate = target_pos->speed / cfg_->steps_per_mm[defining_axis];
+    target_feedrate = clamp_to_limits(defining_axis, target_feedrate, axis_steps);
+    target_pos->speed = target_feedrate * cfg_->steps_per_mm[defining_axis];
+  }
 
   const double accel_fraction =
     (last_speed < target_pos->speed)
@@ -435,17 +833,24 @@ void Planner::Impl::move_machine_steps(const struct AxisTarget *last_pos,
   bool has_move = false;
   bool has_decel = false;
 
+  // A speed change too short to round to a single step is dropped.
   if (do_accel && accel_fraction * abs_defining_axis_steps > 0) {
-    has_accel = true;
     accel_command.v0 = (float)last_speed;        // Last speed of defining axis
     accel_command.v1 = (float)target_pos->speed; // New speed of defining axis
 
     // Now map axis steps to actual motor driver
-    for (const GCodeParserAxis a : AllAxes()) {
-      const int accel_steps = std::lround(accel_fraction * axis_steps[a]);
-      assign_steps_to_motors(&accel_command, a, accel_steps);
+    if (is_arc) {
+      has_accel = assign_arc_steps(last_pos, target_pos, motor_start,
+                                   0, accel_fraction, &accel_command);
+    } else {
+      for (const GCodeParserAxis a : AllAxes()) {
+        const int accel_steps = std::lround(accel_fraction * motor_steps[a]);
+        assign_steps_to_motors(&accel_command, a, accel_steps);
+      }
+      has_accel = has_steps(accel_command);
     }
-  } else {
+  }
+  if (!has_accel) {
     if (last_speed) target_pos->speed = last_speed; // No accel so use the last speed
   }
 
@@ -453,47 +858,335 @@ void Planner::Impl::move_machine_steps(const struct AxisTarget *last_pos,
   move_command.v1 = (float)target_pos->speed;
 
   if (do_accel && decel_fraction * abs_defining_axis_steps > 0) {
-    has_decel = true;
     decel_command.v0 = (float)target_pos->speed;
     decel_command.v1 = (float)next_speed;
-    target_pos->speed = next_speed;
 
     // Now map axis steps to actual motor driver
-    for (const GCodeParserAxis a : AllAxes()) {
-      const int decel_steps = std::lround(decel_fraction * axis_steps[a]);
-      assign_steps_to_motors(&decel_command, a, decel_steps);
+    if (is_arc) {
+      has_decel = assign_arc_steps(last_pos, target_pos, motor_start,
+                                   1 - decel_fraction, 1, &decel_command);
+    } else {
+      for (const GCodeParserAxis a : AllAxes()) {
+        const int decel_steps = std::lround(decel_fraction * motor_steps[a]);
+        assign_steps_to_motors(&decel_command, a, decel_steps);
+      }
+      has_decel = has_steps(decel_command);
     }
+    if (has_decel) target_pos->speed = next_speed;
   }
 
   // Move is everything that hasn't been covered in speed changes.
   // So we start with all steps and subtract steps done in acceleration and
   // deceleration.
-  for (const GCodeParserAxis a : AllAxes()) {
-    assign_steps_to_motors(&move_command, a, axis_steps[a]);
+  if (is_arc) {
+    has_move = assign_arc_steps(last_pos, target_pos, motor_start,
+                                has_accel ? accel_fraction : 0,
+                                has_decel ? 1 - decel_fraction : 1,
+                                &move_command);
+  } else {
+    for (const GCodeParserAxis a : AllAxes()) {
+      assign_steps_to_motors(&move_command, a, motor_steps[a]);
+    }
+    subtract_steps(&move_command, accel_command);
+    has_move = subtract_steps(&move_command, decel_command);
+  }
+
+  if (is_raster) {
+    if (has_accel) assign_raster(target_pos, 0, accel_fraction, &accel_command);
+    if (has_move) {
+      assign_raster(target_pos, has_accel ? accel_fraction : 0,
+                    has_decel ? 1 - decel_fraction : 1, &move_command);
+    }
+    if (has_decel) {
+      assign_raster(target_pos, 1 - decel_fraction, 1, &decel_command);
+    }
+  }
+
+  if (motor_speed_factor != 1) {
+    for (LinearSegmentSteps *c : { &accel_command, &move_command,
+                                   &decel_command }) {
+      c->v0 *= motor_speed_factor;
+      c->v1 *= motor_speed_factor;
+    }
   }
-  subtract_steps(&move_command, accel_command);
-  has_move = subtract_steps(&move_command, decel_command);
 
   if (cfg_->synchronous) motor_ops_->WaitQueueEmpty();
 
-  if (has_accel) motor_ops_->Enqueue(accel_command);
+  // The S-curve subdivision is linear, so arcs get plain ramps. So do
+  // raster lines, which would have to split their pixels.
+  if (has_accel) {
+    if (is_arc || is_raster) motor_ops_->Enqueue(accel_command);
+    else enqueue_ramp(accel_command);
+  }
   if (has_move) motor_ops_->Enqueue(move_command);
-  if (has_decel) motor_ops_->Enqueue(decel_command);
+  if (has_decel) {
+    if (is_arc || is_raster) motor_ops_->Enqueue(decel_command);
+    else enqueue_ramp(decel_command);
+  }
+
+}
+
+// The speed changes of a raster line usually start within a pixel; that
+// pixel is part of both segments, which shifts the pixels in them by up to
+// a pixel. Raster lines are meant to be run at constant speed anyway.
+void Planner::Impl::assign_raster(const struct AxisTarget *t,
+                                  double from, double to,
+                                  struct LinearSegmentSteps *command) {
+  const struct RasterLine &raster = t->raster;
+  const int first = std::min(raster.pixels - 1,
+                             (int)std::floor(from * raster.pixels + 1e-6));
+  const int end = std::max(first + 1,
+                           (int)std::ceil(to * raster.pixels - 1e-6));
+  command->raster_pixels = end - first;
+  command->raster_aux_bits = raster.aux_bits;
+  for (int n = first; n < end; ++n) {
+    if (raster.data[n / 8] & (1 << (n % 8)))
+      command->raster_data[(n - first) / 8] |= 1 << ((n - first) % 8);
+  }
+}
+
+void Planner::Impl::capture_outputs(struct AxisTarget *t) {
+  t->aux_bits = hardware_mapping_->GetAuxBits();
+  for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+    t->pwm_duty[i] = hardware_mapping_->GetPWMDuty(i);
+  }
+}
+
+bool Planner::Impl::assign_output_changes(const struct AxisTarget *t,
+                                          struct LinearSegmentSteps *command) {
+  bool changed = (t->aux_bits != last_aux_bits_);
+  command->aux_bits = t->aux_bits;
+  last_aux_bits_ = t->aux_bits;
+  for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+    if (t->pwm_duty[i] == last_pwm_duty_[i]) continue;
+    command->pwm_mask |= (1 << i);
+    command->pwm_duty[i] = t->pwm_duty[i];
+    last_pwm_duty_[i] = t->pwm_duty[i];
+    changed = true;
+  }
+  return changed;
+}
+
+void Planner::Impl::enqueue_output_changes(const struct AxisTarget *t) {
+  // Special treatment: outputs changed since last time, let's push them through.
+  struct LinearSegmentSteps bit_set_command = {};
+  if (assign_output_changes(t, &bit_set_command))
+    motor_ops_->Enqueue(bit_set_command);
+}
 
-  last_aux_bits_ = target_pos->aux_bits;
+// Normalized S-curve velocity ramp with time tau in [0..1]. The acceleration
+// rises linearly during the first "p" of the time, stays constant and falls
+// linearly in the last "p" of the time (a 'trapezoidal acceleration').
+// Returns the fraction of the speed change reached at time tau.
+static double s_curve_velocity(double tau, double p) {
+  const double c = 1.0 / (1.0 - p);  // Peak accel; area under accel is 1.
+  if (tau <= p) return c * tau * tau / (2 * p);
+  if (tau <= 1 - p) return c * (p / 2 + (tau - p));
+  return 1.0 - s_curve_velocity(1 - tau, p);
+}
+
+// Integral of s_curve_velocity() from 0 to tau.
+static double s_curve_distance(double tau, double p) {
+  const double c = 1.0 / (1.0 - p);
+  if (tau <= p) return c * tau * tau * tau / (6 * p);
+  if (tau <= 1 - p) {
+    const double t = tau - p;
+    return c * (p * p / 6 + p / 2 * t + t * t / 2);
+  }
+  // Velocity is point-symmetric around tau = 0.5
+  return tau - 0.5 + s_curve_distance(1 - tau, p);
+}
+
+// Speed ramps are executed as constant acceleration by the motion queue.
+// To get a jerk limited motion, we split the ramp into sub-segments of equal
+// time, each with its own constant acceleration, that follow an S-curve.
+//
+// The S-curve is symmetric, so it takes the same time and distance as the
+// linear ramp it replaces; the rest of the plan does not change.
+void Planner::Impl::enqueue_ramp(const struct LinearSegmentSteps &ramp) {
+  const double p = cfg_->s_curve_fraction / 2;
+  int defining_steps = 0;
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    if (abs(ramp.steps[i]) > defining_steps) defining_steps = abs(ramp.steps[i]);
+  }
+  if (p <= 0 || defining_steps < 2 * S_CURVE_SUBDIVISIONS) {
+    motor_ops_->Enqueue(ramp);
+    return;
+  }
+
+  const double v0 = ramp.v0;
+  const double dv = ramp.v1 - ramp.v0;
+  const double total_distance = v0 + dv / 2;  // normalized to time 1.
+  struct LinearSegmentSteps sub = ramp;
+  int done_steps[BEAGLEG_NUM_MOTORS] = {};
+  float last_speed = ramp.v0;
+  for (int k = 1; k <= S_CURVE_SUBDIVISIONS; ++k) {
+    const double tau = 1.0 * k / S_CURVE_SUBDIVISIONS;
+    const double fraction = (k == S_CURVE_SUBDIVISIONS)
+      ? 1.0
+      : (v0 * tau + dv * s_curve_distance(tau, p)) / total_distance;
+    bool has_steps = false;
+    for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+      const int target = std::lround(fraction * ramp.steps[i]);
+      sub.steps[i] = target - done_steps[i];
+      done_steps[i] = target;
+      has_steps |= (sub.steps[i] != 0);
+    }
+    if (!has_steps) continue;
+    sub.v0 = last_speed;
+    sub.v1 = (k == S_CURVE_SUBDIVISIONS)
+      ? ramp.v1
+      : (float)(v0 + dv * s_curve_velocity(tau, p));
+    motor_ops_->Enqueue(sub);
+    last_speed = sub.v1;
+  }
+}
+
+// Speed (on the defining axis of "t") we can enter segment "t" with, so that
+// we still can reach its max_exit_speed at the end of it.
+static double max_entry_speed(const struct AxisTarget *t, double accel) {
+  const int steps = defining_steps(t);
+  const double v = std::sqrt(t->max_exit_speed * t->max_exit_speed
+                             + 2 * accel * steps);
+  return v < t->speed ? v : t->speed;
+}
+
+// Backward pass over the planning buffer after a new segment has been
+// appended at the end.
+//
+// The newest segment has no known successor, so it has to be able to come to
+// a full stop. Going backwards from there, every segment's exit speed is
+// limited by the joining speed to its successor and by the speed the successor
+// can still decelerate from within its length.
+//
+// Segments that are limited by their junction or their own speed are not
+// affected by anything appended later, so we stop as soon as a value does
+// not change anymore. That keeps the cost per segment low even with a deep
+// lookahead.
+void Planner::Impl::plan_backward() {
+  const int n = planning_buffer_.size();
+  planning_buffer_.back()->max_exit_speed = 0.0;
+  // Element [0] is the established position, [1] the next to be emitted.
+  for (int i = n - 1; i >= 2; --i) {
+    struct AxisTarget *from = planning_buffer_[i - 1];
+    const struct AxisTarget *to = planning_buffer_[i];
+    double exit_speed = joining_speed(from, to);
+    if (exit_speed > from->speed)
+      exit_speed = from->speed;
+    const double a = acceleration_for_target(to);
+    const double reachable = convert_speed(to, max_entry_speed(to, a), from);
+    if (reachable < exit_speed)
+      exit_speed = reachable;
+    if (exit_speed == from->max_exit_speed)
+      break;   // Nothing changes further back.
+    from->max_exit_speed = exit_speed;
+  }
 }
 
 // If we have enough data in the queue, issue motor move.
 void Planner::Impl::issue_motor_move_if_possible() {
-  if (planning_buffer_.size() >= 3) {
+  plan_backward();
+  if ((int)planning_buffer_.size() >= lookahead_ + 2) {
     move_machine_steps(planning_buffer_[0],  // Current established position.
-                       planning_buffer_[1],  // Position we want to move to.
-                       planning_buffer_[2]); // Next upcoming.
+                       planning_buffer_[1]); // Position we want to move to.
     planning_buffer_.pop_front();
   }
 }
 
-void Planner::Impl::machine_move(const AxesRegister &axis, float feedrate) {
+void Planner::Impl::machine_move(const AxesRegister &axis, float feedrate,
+                                 const struct RasterLine *raster) {
+  if (kinematics_ && !kinematics_->IsLinear()) {
+    assert(raster == nullptr);   // machine_raster() refuses these.
+    segmented_move(axis, feedrate);
+  } else {
+    plan_move(axis, feedrate, raster, nullptr);
+  }
+}
+
+bool Planner::Impl::inverse_kinematics(struct AxisTarget *t) {
+  memcpy(t->joint_steps, t->position_steps, sizeof(t->joint_steps));
+  batch_.count = 1;
+  float *const pos[3] = { batch_.x, batch_.y, batch_.z };
+  for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+    pos[a][0] = cfg_->steps_per_mm[a] > 0
+      ? t->position_steps[a] / cfg_->steps_per_mm[a] : 0;
+  }
+  if (!kinematics_->Inverse(&batch_))
+    return false;
+  for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+    t->joint_steps[a] = std::lround(pos[a][0] * cfg_->steps_per_mm[a]);
+  }
+  return true;
+}
+
+// A straight line deviates from the straight line in joint space about
+// with the square of its length, so the deviation at the middle tells how
+// many pieces are needed to stay within the arc tolerance. The joint
+// positions of the pieces are calculated in batches.
+void Planner::Impl::segmented_move(const AxesRegister &axis, float feedrate) {
+  const struct AxisTarget *last = planning_buffer_.back();
+  AxesRegister start;
+  for (const GCodeParserAxis a : AllAxes()) {
+    start[a] = cfg_->steps_per_mm[a] > 0
+      ? last->position_steps[a] / cfg_->steps_per_mm[a] : 0;
+  }
+  batch_.count = 3;
+  for (int i = 0; i < 3; ++i) {
+    batch_.x[i] = start[AXIS_X] + i * (axis[AXIS_X] - start[AXIS_X]) / 2;
+    batch_.y[i] = start[AXIS_Y] + i * (axis[AXIS_Y] - start[AXIS_Y]) / 2;
+    batch_.z[i] = start[AXIS_Z] + i * (axis[AXIS_Z] - start[AXIS_Z]) / 2;
+  }
+  if (!kinematics_->Inverse(&batch_)) {
+    Log_error("Move to (%.3f, %.3f, %.3f) out of reach; ignored.",
+              axis[AXIS_X], axis[AXIS_Y], axis[AXIS_Z]);
+    return;
+  }
+  float deviation = 0;
+  for (const float *joint : { batch_.x, batch_.y, batch_.z }) {
+    deviation = std::max(deviation,
+                         std::fabs(joint[1] - (joint[0] + joint[2]) / 2));
+  }
+  const int pieces = std::min((int)MAX_KINEMATICS_PIECES,
+                              std::max(1, (int)std::ceil(std::sqrt(
+                                  deviation / cfg_->arc_tolerance))));
+
+  AxesRegister piece;
+  for (int first = 1; first <= pieces; first += KinematicsBatch::MAX_POINTS) {
+    batch_.count = std::min((int)KinematicsBatch::MAX_POINTS,
+                            pieces - first + 1);
+    for (int i = 0; i < batch_.count; ++i) {
+      const float f = 1.0f * (first + i) / pieces;
+      batch_.x[i] = start[AXIS_X] + f * (axis[AXIS_X] - start[AXIS_X]);
+      batch_.y[i] = start[AXIS_Y] + f * (axis[AXIS_Y] - start[AXIS_Y]);
+      batch_.z[i] = start[AXIS_Z] + f * (axis[AXIS_Z] - start[AXIS_Z]);
+    }
+    if (!kinematics_->Inverse(&batch_)) {
+      Log_error("Move to (%.3f, %.3f, %.3f) out of reach; stopped.",
+                axis[AXIS_X], axis[AXIS_Y], axis[AXIS_Z]);
+      return;
+    }
+    // plan_move() takes the joints of one point together.
+    float joints[KinematicsBatch::MAX_POINTS][3];
+    const int count = batch_.count;
+    for (int i = 0; i < count; ++i) {
+      joints[i][0] = batch_.x[i];
+      joints[i][1] = batch_.y[i];
+      joints[i][2] = batch_.z[i];
+    }
+    for (int i = 0; i < count; ++i) {
+      const float f = 1.0f * (first + i) / pieces;
+      for (const GCodeParserAxis a : AllAxes()) {
+        piece[a] = (f < 1) ? start[a] + f * (axis[a] - start[a]) : axis[a];
+      }
+      plan_move(piece, feedrate, nullptr, joints[i]);
+    }
+  }
+}
+
+void Planner::Impl::plan_move(const AxesRegister &axis, float feedrate,
+                              const struct RasterLine *raster,
+                              const float *joints_mm) {
+  TraceScope trace(TraceEvent::PLANNER_MOVE, planning_buffer_.size());
   assert(position_known_);   // call SetExternalPosition() after DirectDrive()
   // We always have a previous position.
   struct AxisTarget *previous = planning_buffer_.back();
@@ -525,8 +1218,30 @@ void Planner::Impl::machine_move(const AxesRegister &axis, float feedrate) {
 
   assert(max_steps > 0);
 
-  new_pos->aux_bits = hardware_mapping_->GetAuxBits();
+  if (joints_mm) {
+    memcpy(new_pos->joint_steps, new_pos->position_steps,
+           sizeof(new_pos->joint_steps));
+    for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+      new_pos->joint_steps[a] = std::lround(joints_mm[a]
+                                            * cfg_->steps_per_mm[a]);
+    }
+  } else if (kinematics_ && !inverse_kinematics(new_pos)) {
+    Log_error("Move to (%.3f, %.3f, %.3f) out of reach; ignored.",
+              axis[AXIS_X], axis[AXIS_Y], axis[AXIS_Z]);
+    planning_buffer_.pop_back();
+    return;
+  }
+
+  capture_outputs(new_pos);
   new_pos->defining_axis = defining_axis;
+  new_pos->arc = {};
+  if (raster) {
+    // The pixels switch the raster outputs; they are off otherwise.
+    new_pos->raster = *raster;
+    new_pos->aux_bits &= ~raster->aux_bits;
+  } else {
+    new_pos->raster.pixels = 0;
+  }
 
   // Work out the real units values for the euclidian axes now to avoid
   // having to replicate the calcs later.
@@ -541,12 +1256,259 @@ void Planner::Impl::machine_move(const AxesRegister &axis, float feedrate) {
   if (new_pos->speed > max_axis_speed_[defining_axis])
     new_pos->speed = max_axis_speed_[defining_axis];
 
+  // The lookahead relies on the speed being something all axes can do.
+  const double feed = new_pos->speed / cfg_->steps_per_mm[defining_axis];
+  new_pos->speed = clamp_to_limits(defining_axis, feed, new_pos->delta_steps)
+    * cfg_->steps_per_mm[defining_axis];
+
+  // Don't plan for more than the motor backend can generate.
+  unsigned motor_mask = 0;
+  for (const GCodeParserAxis a : AllAxes()) {
+    if (new_pos->delta_steps[a] != 0)
+      motor_mask |= hardware_mapping_->GetMotorMap(a);
+  }
+  const float max_step_frequency = motor_ops_->MaxStepFrequency(motor_mask);
+  if (max_step_frequency > 0 && new_pos->speed > max_step_frequency)
+    new_pos->speed = max_step_frequency;
+  new_pos->max_exit_speed = 0.0;
+
   issue_motor_move_if_possible();
   path_halted_ = false;
 }
 
+// An arc is split at the quadrants of its circle into AxisTargets, which are
+// planned like lines, but know their speed, length and direction along the
+// circle. The speed is limited to what the centripetal acceleration allows.
+bool Planner::Impl::machine_arc(GCodeParserAxis normal_axis, bool clockwise,
+                                const AxesRegister &center,
+                                const AxesRegister &axis, float feedrate) {
+  assert(position_known_);
+  if (!motor_ops_->SupportsArcs() || kinematics_)
+    return false;
+  GCodeParserAxis plane[3];
+  switch (normal_axis) {  // Same orientation as the parser's arc_gen().
+  case AXIS_Z: plane[0] = AXIS_X; plane[1] = AXIS_Y; plane[2] = AXIS_Z; break;
+  case AXIS_X: plane[0] = AXIS_Y; plane[1] = AXIS_Z; plane[2] = AXIS_X; break;
+  case AXIS_Y: plane[0] = AXIS_X; plane[1] = AXIS_Z; plane[2] = AXIS_Y; break;
+  default: return false;
+  }
+  const float steps_per_mm = cfg_->steps_per_mm[plane[0]];
+  if (steps_per_mm <= 0 || cfg_->steps_per_mm[plane[1]] != steps_per_mm)
+    return false;   // Not a circle in steps.
+
+  const AxisTarget *const previous = planning_buffer_.back();
+  int target_steps[GCODE_NUM_AXES];
+  for (const GCodeParserAxis a : AllAxes()) {
+    target_steps[a] = std::lround(axis[a] * cfg_->steps_per_mm[a]);
+    if (a != plane[0] && a != plane[1] && a != plane[2]
+        && target_steps[a] != previous->position_steps[a])
+      return false;  // Only the helix axis can move along.
+  }
+
+  const double center_0 = center[plane[0]] * steps_per_mm;
+  const double center_1 = center[plane[1]] * steps_per_mm;
+  const double r_0 = previous->position_steps[plane[0]] - center_0;
+  const double r_1 = previous->position_steps[plane[1]] - center_1;
+  const double rt_0 = target_steps[plane[0]] - center_0;
+  const double rt_1 = target_steps[plane[1]] - center_1;
+  const double radius = std::hypot(r_0, r_1);
+  if (radius < MIN_ARC_RADIUS_STEPS)
+    return false;
+  double angular_travel = std::atan2(r_0*rt_1 - r_1*rt_0, r_0*rt_0 + r_1*rt_1);
+  if (clockwise) {
+    if (angular_travel >= 0) angular_travel -= 2*M_PI;
+  } else {
+    if (angular_travel <= 0) angular_travel += 2*M_PI;
+  }
+  const double start_angle = std::atan2(r_1, r_0);
+  const double arc_steps = std::fabs(angular_travel) * radius;
+  const int helix_start = previous->position_steps[plane[2]];
+  const int helix_steps = target_steps[plane[2]] - helix_start;
+  const float helix_steps_per_mm = cfg_->steps_per_mm[plane[2]];
+  if (abs(helix_steps) > 0.9 * arc_steps)
+    return false;  // The motion queue needs the helix slower than the arc.
+
+  // Limits along the circle in mm/s, mm/s^2.
+  const double planar_mm = arc_steps / steps_per_mm;
+  const double helix_mm = helix_steps_per_mm > 0
+    ? helix_steps / helix_steps_per_mm : 0;
+  const double len = std::hypot(planar_mm, helix_mm);
+  double speed = feedrate * planar_mm / len;
+  double accel = std::min(cfg_->acceleration[plane[0]],
+                          cfg_->acceleration[plane[1]]);
+  speed = std::min(speed, (double)std::min(cfg_->max_feedrate[plane[0]],
+                                           cfg_->max_feedrate[plane[1]]));
+  if (helix_steps != 0) {
+    const double helix_ratio = std::fabs(helix_mm) / planar_mm;
+    if (cfg_->max_feedrate[plane[2]] > 0)
+      speed = std::min(speed, cfg_->max_feedrate[plane[2]] / helix_ratio);
+    if (cfg_->acceleration[plane[2]] > 0)
+      accel = std::min(accel, cfg_->acceleration[plane[2]] / helix_ratio);
+  }
+  if (accel > 0)  // Centripetal acceleration v^2/r.
+    speed = std::min(speed, std::sqrt(accel * radius / steps_per_mm));
+  speed *= steps_per_mm;
+  const unsigned motor_mask = hardware_mapping_->GetMotorMap(plane[0])
+    | hardware_mapping_->GetMotorMap(plane[1])
+    | (helix_steps != 0 ? hardware_mapping_->GetMotorMap(plane[2]) : 0);
+  const float max_step_frequency = motor_ops_->MaxStepFrequency(motor_mask);
+  if (max_step_frequency > 0 && speed > max_step_frequency)
+    speed = max_step_frequency;
+  if (speed <= 0)
+    return false;
+
+  // Cut at the quadrants.
+  const double quarter = M_PI / 2;
+  const double end_angle = start_angle + angular_travel;
+  double angle = start_angle;
+  while (angle != end_angle) {
+    double piece_end = clockwise
+      ? std::max(end_angle, (std::ceil(angle / quarter - 1e-9) - 1) * quarter)
+      : std::min(end_angle, (std::floor(angle / quarter + 1e-9) + 1) * quarter);
+    // A sliver of less than a step before the end becomes part of the last.
+    if (std::fabs(end_angle - piece_end) * radius < 1.0)
+      piece_end = end_angle;
+    const double fraction = (piece_end - start_angle) / angular_travel;
+    const struct AxisTarget *last = planning_buffer_.back();
+    const bool is_last = (piece_end == end_angle);
+
+    AxesRegister piece_target;
+    for (const GCodeParserAxis a : AllAxes()) {
+      piece_target[a] = cfg_->steps_per_mm[a] > 0
+        ? last->position_steps[a] / cfg_->steps_per_mm[a] : 0;
+    }
+    if (is_last) {
+      piece_target = axis;
+    } else {
+      piece_target[plane[0]] =
+        (center_0 + radius * std::cos(piece_end)) / steps_per_mm;
+      piece_target[plane[1]] =
+        (center_1 + radius * std::sin(piece_end)) / steps_per_mm;
+      if (helix_steps_per_mm > 0) {
+        piece_target[plane[2]] = (helix_start + fraction * helix_steps)
+          / helix_steps_per_mm;
+      }
+    }
+
+    const double piece_steps = std::fabs(piece_end - angle) * radius;
+    if (piece_steps < 1.0) {  // Less than a step: just go there.
+      machine_move(piece_target, feedrate);
+      angle = piece_end;
+      continue;
+    }
+
+    struct AxisTarget *new_pos = planning_buffer_.append();
+    for (const GCodeParserAxis a : AllAxes()) {
+      new_pos->position_steps[a] = is_last
+        ? target_steps[a]
+        : std::lround(piece_target[a] * cfg_->steps_per_mm[a]);
+      new_pos->delta_steps[a] = new_pos->position_steps[a] - last->position_steps[a];
+    }
+    capture_outputs(new_pos);
+    new_pos->raster.pixels = 0;
+    new_pos->defining_axis = plane[0];
+    new_pos->dx = axis_delta_to_mm(new_pos, AXIS_X);
+    new_pos->dy = axis_delta_to_mm(new_pos, AXIS_Y);
+    new_pos->dz = axis_delta_to_mm(new_pos, AXIS_Z);
+    new_pos->len = len * piece_steps / arc_steps;
+    struct ArcPiece &arc = new_pos->arc;
+    arc.plane[0] = plane[0];
+    arc.plane[1] = plane[1];
+    arc.plane[2] = plane[2];
+    arc.center[0] = center_0;
+    arc.center[1] = center_1;
+    arc.radius = radius;
+    arc.start = angle;
+    arc.end = piece_end;
+    arc.steps = piece_steps;
+    arc.accel = accel * steps_per_mm;
+    new_pos->speed = speed;
+    new_pos->max_exit_speed = 0.0;
+
+    issue_motor_move_if_possible();
+    path_halted_ = false;
+    angle = piece_end;
+  }
+  return true;
+}
+
+bool Planner::Impl::assign_arc_steps(const struct AxisTarget *last_pos,
+                                     const struct AxisTarget *t,
+                                     const int *motor_start,
+                                     double from, double to,
+                                     struct LinearSegmentSteps *command) {
+  const ArcPiece &arc = t->arc;
+  // Position at a fraction of the arc. At the ends, exactly the positions
+  // we planned with.
+  auto position = [&](double f, GCodeParserAxis a) -> int {
+    if (f <= 0) return last_pos->position_steps[a];
+    if (f >= 1) return t->position_steps[a];
+    const double angle = arc.start + f * (arc.end - arc.start);
+    if (a == arc.plane[0])
+      return std::lround(arc.center[0] + arc.radius * std::cos(angle));
+    if (a == arc.plane[1])
+      return std::lround(arc.center[1] + arc.radius * std::sin(angle));
+    return last_pos->position_steps[a] + std::lround(f * t->delta_steps[a]);
+  };
+  // Arc pieces don't change direction, so the compensation is the one for
+  // the end; the take-up of backlash happens right at the start.
+  auto motor_position = [&](double f, GCodeParserAxis a) -> int {
+    if (f <= 0) return motor_start[a];
+    return compensation_[a].MotorPosition(position(f, a),
+                                          travel_direction_[a]);
+  };
+  bool has_steps = false;
+  for (const GCodeParserAxis a : AllAxes()) {
+    const int steps = motor_position(to, a) - motor_position(from, a);
+    assign_steps_to_motors(command, a, steps);
+    has_steps |= (steps != 0);
+  }
+
+  // Angles in direction of travel from the start of the quadrant, in which
+  // one axis gets faster (sin), the other slower (cos).
+  const double quarter = M_PI / 2;
+  const bool ccw = arc.end > arc.start;
+  const int quadrant = (int)std::floor(0.5 * (arc.start + arc.end) / quarter);
+  const double base = quadrant * quarter;
+  auto local_angle = [&](double f) -> double {
+    const double angle = arc.start + f * (arc.end - arc.start);
+    const double phi = ccw ? angle - base : base + quarter - angle;
+    return std::max(0.0, std::min(quarter, phi));
+  };
+  const bool first_rises = ((quadrant & 1) == 0) == ccw;
+  command->arc_radius = arc.radius;
+  command->arc_start = local_angle(from);
+  command->arc_end = local_angle(to);
+  command->arc_rise_motors =
+    hardware_mapping_->GetMotorMap(arc.plane[first_rises ? 0 : 1]);
+  command->arc_fall_motors =
+    hardware_mapping_->GetMotorMap(arc.plane[first_rises ? 1 : 0]);
+  return has_steps;
+}
+
+bool Planner::Impl::machine_raster(const AxesRegister &axis, float feedrate,
+                                   unsigned short raster_aux_bits,
+                                   const uint8_t *data, int pixels) {
+  if (!motor_ops_->SupportsRaster()
+      || (kinematics_ && !kinematics_->IsLinear()))
+    return false;
+  assert(pixels > 0 && pixels <= BEAGLEG_MAX_RASTER_PIXELS);
+  struct RasterLine raster = {};
+  raster.pixels = pixels;
+  raster.aux_bits = raster_aux_bits;
+  memcpy(raster.data, data, (pixels + 7) / 8);
+  machine_move(axis, feedrate, &raster);
+  return true;
+}
+
 void Planner::Impl::bring_path_to_halt() {
-  if (path_halted_) return;
+  if (path_halted_) {
+    // Nothing to plan, but outputs might have changed since.
+    struct AxisTarget outputs;
+    capture_outputs(&outputs);
+    enqueue_output_changes(&outputs);
+    return;
+  }
   // Enqueue a new position that is the same position as the last
   // one seen, but zero speed. That will allow the previous segment to
   // slow down. Enqueue.
@@ -554,13 +1516,22 @@ void Planner::Impl::bring_path_to_halt() {
   struct AxisTarget *new_pos = planning_buffer_.append();
   for (const GCodeParserAxis a : AllAxes()) {
     new_pos->position_steps[a] = previous->position_steps[a];
+    new_pos->joint_steps[a] = previous->joint_steps[a];
     new_pos->delta_steps[a] = 0;
   }
   new_pos->defining_axis = AXIS_X;
   new_pos->speed = 0;
-  new_pos->aux_bits = hardware_mapping_->GetAuxBits();
+  capture_outputs(new_pos);
   new_pos->dx = new_pos->dy = new_pos->dz = new_pos->len = 0.0;
-  issue_motor_move_if_possible();
+  new_pos->arc = {};
+  new_pos->raster.pixels = 0;
+  new_pos->max_exit_speed = 0.0;
+  plan_backward();
+  // Flush everything up to the halt position.
+  while (planning_buffer_.size() >= 3) {
+    move_machine_steps(planning_buffer_[0], planning_buffer_[1]);
+    planning_buffer_.pop_front();
+  }
   path_halted_ = true;
 }
 
@@ -575,9 +1546,36 @@ void Planner::Impl::GetCurrentPosition(AxesRegister *pos) {
               hardware_mapping_->GetAxisSteps(a, physical_status));
 #endif
     if (cfg_->steps_per_mm[a] != 0) {
-      (*pos)[a] = hardware_mapping_->GetAxisSteps(a, physical_status) / cfg_->steps_per_mm[a];
+      // Approximate in the backlash: that is the last planned direction.
+      const int steps = compensation_[a].AxisPosition(
+        hardware_mapping_->GetAxisSteps(a, physical_status),
+        travel_direction_[a]);
+      (*pos)[a] = steps / cfg_->steps_per_mm[a];
     }
   }
+  if (kinematics_) {
+    const float joint[3] = { (*pos)[AXIS_X], (*pos)[AXIS_Y], (*pos)[AXIS_Z] };
+    float cartesian[3];
+    if (kinematics_->Forward(joint, cartesian)) {
+      for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z })
+        (*pos)[a] = cartesian[a];
+    }
+  }
+}
+
+bool Planner::Impl::HasPendingPWMChanges() const {
+  for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+    if (hardware_mapping_->GetPWMDuty(i) != last_pwm_duty_[i]) return true;
+  }
+  return false;
+}
+
+void Planner::Impl::GetLastTargetPosition(AxesRegister *pos) {
+  const struct AxisTarget *last = planning_buffer_.back();
+  for (const GCodeParserAxis a : AllAxes()) {
+    (*pos)[a] = cfg_->steps_per_mm[a] > 0
+      ? last->position_steps[a] / cfg_->steps_per_mm[a] : 0;
+  }
 }
 
 int Planner::Impl::DirectDrive(GCodeParserAxis axis, float distance,
@@ -589,17 +1587,21 @@ int Planner::Impl::DirectDrive(GCodeParserAxis axis, float distance,
 
   struct LinearSegmentSteps move_command = {};
 
+  const float max_speed = max_direct_speed(axis);
+
   move_command.v0 = v0 * steps_per_mm;
-  if (move_command.v0 > max_axis_speed_[axis])
-    move_command.v0 = max_axis_speed_[axis];
+  if (move_command.v0 > max_speed)
+    move_command.v0 = max_speed;
   move_command.v1 = v1 * steps_per_mm;
-  if (move_command.v1 > max_axis_speed_[axis])
-    move_command.v1 = max_axis_speed_[axis];
+  if (move_command.v1 > max_speed)
+    move_command.v1 = max_speed;
 
   move_command.aux_bits = hardware_mapping_->GetAuxBits();
 
   const int segment_move_steps = std::lround(distance * steps_per_mm);
-  assign_steps_to_motors(&move_command, axis, segment_move_steps);
+  AxesRegister axis_distance;
+  axis_distance[axis] = distance;
+  assign_direct_steps(&move_command, axis_distance);
 
   motor_ops_->Enqueue(move_command);
   motor_ops_->WaitQueueEmpty();
@@ -607,15 +1609,168 @@ int Planner::Impl::DirectDrive(GCodeParserAxis axis, float distance,
   return segment_move_steps;
 }
 
+void Planner::Impl::DirectDrive(const AxesRegister &distance,
+                                float v0, float v1) {
+  bring_path_to_halt();
+  position_known_ = false;
+
+  struct LinearSegmentSteps move_command = {};
+  assign_direct_steps(&move_command, distance);
+  int most_steps = 0;
+  for (int m = 0; m < BEAGLEG_NUM_MOTORS; ++m)
+    most_steps = std::max(most_steps, abs(move_command.steps[m]));
+  if (most_steps == 0) return;
+
+  // The speed is of the axis that moves farthest, while the motion queue
+  // wants it in steps/s of the motor with the most steps. None of the axes
+  // must get faster than it can.
+  float longest_mm = 0;
+  for (const GCodeParserAxis a : AllAxes())
+    longest_mm = std::max(longest_mm, std::fabs(distance[a]));
+  const float steps_per_mm = most_steps / longest_mm;
+  float max_speed = -1;
+  for (const GCodeParserAxis a : AllAxes()) {
+    const int axis_steps = std::lround(std::fabs(distance[a])
+                                       * cfg_->steps_per_mm[a]);
+    if (axis_steps == 0) continue;
+    const float limit = max_direct_speed(a) * most_steps / axis_steps;
+    if (max_speed < 0 || limit < max_speed) max_speed = limit;
+  }
+  move_command.v0 = std::min(v0 * steps_per_mm, max_speed);
+  move_command.v1 = std::min(v1 * steps_per_mm, max_speed);
+  move_command.aux_bits = hardware_mapping_->GetAuxBits();
+
+  motor_ops_->Enqueue(move_command);
+  motor_ops_->WaitQueueEmpty();
+}
+
+bool Planner::Impl::DirectDriveToInput(GCodeParserAxis axis, float distance,
+                                       float v,
+                                       const HardwareMapping::SwitchInput &input,
+                                       int *steps_moved, bool *triggered) {
+  bring_path_to_halt();
+  if (!motor_ops_->WatchInput(input.gpio_def, input.trigger_level))
+    return false;
+  position_known_ = false;
+
+  PhysicalStatus status;
+  motor_ops_->GetPhysicalStatus(&status);
+  const int start_steps = direct_axis_steps(axis, status);
+
+  const float steps_per_mm = cfg_->steps_per_mm[axis];
+  struct LinearSegmentSteps move_command = {};
+  move_command.v0 = move_command.v1 = std::min(v * steps_per_mm,
+                                               max_direct_speed(axis));
+  move_command.aux_bits = hardware_mapping_->GetAuxBits();
+  move_command.stop_on_input = true;
+  AxesRegister axis_distance;
+  axis_distance[axis] = distance;
+  assign_direct_steps(&move_command, axis_distance);
+  motor_ops_->Enqueue(move_command);
+
+  *triggered = motor_ops_->WaitInputStop();
+  motor_ops_->WatchInput(0, false);
+
+  motor_ops_->GetPhysicalStatus(&status);
+  *steps_moved = direct_axis_steps(axis, status) - start_steps;
+  return true;
+}
+
+float Planner::Impl::max_direct_speed(GCodeParserAxis axis) {
+  const float max_step_frequency =
+    motor_ops_->MaxStepFrequency(hardware_mapping_->GetMotorMap(axis));
+  if (max_step_frequency > 0 && max_step_frequency < max_axis_speed_[axis])
+    return max_step_frequency;
+  return max_axis_speed_[axis];
+}
+
+// With linear kinematics, homing and probing move the cartesian axis, which
+// might take several joints. Otherwise, they move the joint of the axis.
+void Planner::Impl::assign_direct_steps(struct LinearSegmentSteps *command,
+                                        const AxesRegister &distance) {
+  const bool cartesian_xyz = kinematics_ && kinematics_->IsLinear();
+  for (const GCodeParserAxis a : AllAxes()) {
+    if (distance[a] == 0 || (cartesian_xyz && a <= AXIS_Z)) continue;
+    assign_steps_to_motors(command, a,
+                           std::lround(distance[a] * cfg_->steps_per_mm[a]));
+  }
+  if (!cartesian_xyz) return;
+  if (distance[AXIS_X] == 0 && distance[AXIS_Y] == 0 && distance[AXIS_Z] == 0)
+    return;
+  batch_.count = 2;
+  float *const pos[3] = { batch_.x, batch_.y, batch_.z };
+  for (int a = AXIS_X; a <= AXIS_Z; ++a) {
+    pos[a][0] = 0;
+    pos[a][1] = distance[(GCodeParserAxis) a];
+  }
+  kinematics_->Inverse(&batch_);
+  for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+    assign_steps_to_motors(command, a, std::lround((pos[a][1] - pos[a][0])
+                                                   * cfg_->steps_per_mm[a]));
+  }
+}
+
+int Planner::Impl::direct_axis_steps(GCodeParserAxis axis,
+                                     const PhysicalStatus &status) {
+  if (!kinematics_ || !kinematics_->IsLinear() || axis > AXIS_Z)
+    return hardware_mapping_->GetAxisSteps(axis, status);
+  float joint[3], cartesian[3];
+  for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+    joint[a] = cfg_->steps_per_mm[a] > 0
+      ? hardware_mapping_->GetAxisSteps(a, status) / cfg_->steps_per_mm[a]
+      : 0;
+  }
+  kinematics_->Forward(joint, cartesian);
+  return std::lround(cartesian[axis] * cfg_->steps_per_mm[axis]);
+}
+
 void Planner::Impl::SetExternalPosition(GCodeParserAxis axis, float pos) {
   assert(path_halted_);   // Precondition.
   position_known_ = true;
 
-  const int motor_position = std::lround(pos * cfg_->steps_per_mm[axis]);
-  planning_buffer_.back()->position_steps[axis] = motor_position;
-  planning_buffer_[0]->position_steps[axis] = motor_position;
+  const int axis_position = std::lround(pos * cfg_->steps_per_mm[axis]);
+  struct AxisTarget *const last = planning_buffer_.back();
+  if (!kinematics_ || axis > AXIS_Z) {
+    last->position_steps[axis] = axis_position;
+    last->joint_steps[axis] = axis_position;
+    set_external_joint(axis, axis_position);
+  } else if (kinematics_->IsLinear()) {
+    // Homing found the cartesian position, the joints follow.
+    last->position_steps[axis] = axis_position;
+    inverse_kinematics(last);
+    for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z })
+      set_external_joint(a, last->joint_steps[a]);
+  } else {
+    // Homing found the joint position, which tells where we are.
+    last->joint_steps[axis] = axis_position;
+    set_external_joint(axis, axis_position);
+    float joint[3], cartesian[3];
+    for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+      joint[a] = cfg_->steps_per_mm[a] > 0
+        ? last->joint_steps[a] / cfg_->steps_per_mm[a] : 0;
+    }
+    if (kinematics_->Forward(joint, cartesian)) {
+      for (const GCodeParserAxis a : { AXIS_X, AXIS_Y, AXIS_Z }) {
+        last->position_steps[a] = std::lround(cartesian[a]
+                                              * cfg_->steps_per_mm[a]);
+      }
+    }
+  }
+  struct AxisTarget *const reached = planning_buffer_[0];
+  for (const GCodeParserAxis a : AllAxes()) {
+    reached->position_steps[a] = last->position_steps[a];
+    reached->joint_steps[a] = last->joint_steps[a];
+  }
+}
+
+void Planner::Impl::set_external_joint(GCodeParserAxis axis, int steps) {
+  // We don't know on which side of the backlash we are.
+  travel_direction_[axis] = 0;
+  const int motor_position = compensation_[axis].MotorPosition(steps, 0);
+  motor_position_[axis] = motor_position;
 
-  const uint8_t motormap_for_axis = hardware_mapping_->GetMotorMap(axis);
+  const HardwareMapping::MotorBitmap motormap_for_axis =
+    hardware_mapping_->GetMotorMap(axis);
   for (int motor = 0; motor < BEAGLEG_NUM_MOTORS; ++motor) {
     if (motormap_for_axis & (1 << motor))
       motor_ops_->SetExternalPosition(motor, motor_position);
@@ -636,6 +1791,19 @@ void Planner::Enqueue(const AxesRegister &target_pos, float speed) {
   impl_->machine_move(target_pos, speed);
 }
 
+bool Planner::EnqueueArc(GCodeParserAxis normal_axis, bool clockwise,
+                         const AxesRegister &center,
+                         const AxesRegister &target_pos, float speed) {
+  return impl_->machine_arc(normal_axis, clockwise, center, target_pos, speed);
+}
+
+bool Planner::EnqueueRaster(const AxesRegister &target_pos, float speed,
+                            unsigned short raster_aux_bits,
+                            const uint8_t *data, int pixels) {
+  return impl_->machine_raster(target_pos, speed, raster_aux_bits,
+                               data, pixels);
+}
+
 void Planner::BringPathToHalt() {
   impl_->bring_path_to_halt();
 }
@@ -644,11 +1812,39 @@ void Planner::GetCurrentPosition(AxesRegister *pos) {
   impl_->GetCurrentPosition(pos);
 }
 
+bool Planner::HasPendingPWMChanges() const {
+  return impl_->HasPendingPWMChanges();
+}
+
+void Planner::GetLastTargetPosition(AxesRegister *pos) {
+  impl_->GetLastTargetPosition(pos);
+}
+
 int Planner::DirectDrive(GCodeParserAxis axis, float distance,
                           float v0, float v1) {
   return impl_->DirectDrive(axis, distance, v0, v1);
 }
 
+void Planner::DirectDrive(const AxesRegister &distance, float v0, float v1) {
+  impl_->DirectDrive(distance, v0, v1);
+}
+
+bool Planner::DirectDriveToInput(GCodeParserAxis axis, float distance,
+                                 float v,
+                                 const HardwareMapping::SwitchInput &input,
+                                 int *steps_moved, bool *triggered) {
+  return impl_->DirectDriveToInput(axis, distance, v, input,
+                                   steps_moved, triggered);
+}
+
 void Planner::SetExternalPosition(GCodeParserAxis axis, float pos) {
   impl_->SetExternalPosition(axis, pos);
 }
+
+void Planner::ConfigChanged() {
+  impl_->ConfigChanged();
+}
+
+bool Planner::IsPathHalted() const {
+  return impl_->IsPathHalted();
+}
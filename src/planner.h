@@ -20,9 +20,9 @@
 #define _BEAGLEG_PLANNER_H_
 
 #include "gcode-parser/gcode-parser.h"  // AxesRegister
+#include "hardware-mapping.h"
 
 struct MachineControlConfig;
-class HardwareMapping;
 class MotorOperations;
 
 // The planner receives a sequence of desired target positions.
@@ -30,6 +30,11 @@ class MotorOperations;
 // machine, and emits these to the MotorOperations backend.
 class Planner {
 public:
+  // Upper limit for the number of segments we look ahead while planning
+  // (MachineControlConfig::lookahead_segments). Represented as enum, as we
+  // don't have constexpr in this version of c++ yet.
+  enum { MAX_LOOKAHEAD = 256 };
+
   // The planner writes out motor operations to the backend.
   Planner(const MachineControlConfig *config,
           HardwareMapping *hardware_mapping,
@@ -40,14 +45,47 @@ public:
   // the current position.
   void Enqueue(const AxesRegister &target_pos, float speed);
 
+  // Enqueue a circular arc (G2/G3) from the current position to "target_pos"
+  // around "center" in the plane normal to "normal_axis", which moves
+  // linearly (helix). The arc is sent to the motor backend as such, if it
+  // SupportsArcs() and the arc is suited (same steps/mm in the plane, other
+  // axes don't move). Returns false otherwise; nothing is enqueued then and
+  // the caller has to break the arc into line segments.
+  bool EnqueueArc(GCodeParserAxis normal_axis, bool clockwise,
+                  const AxesRegister &center, const AxesRegister &target_pos,
+                  float speed);
+
+  // Enqueue a laser raster line from the current position to "target_pos".
+  // The line is divided into "pixels" (at most BEAGLEG_MAX_RASTER_PIXELS)
+  // of equal length; the aux bits "raster_aux_bits" are switched on while
+  // moving over the pixels whose bit is set in "data" (LSB first), off
+  // otherwise. Returns false if the motor backend does not SupportsRaster();
+  // nothing is enqueued then and the caller has to switch the outputs with
+  // plain moves.
+  bool EnqueueRaster(const AxesRegister &target_pos, float speed,
+                     unsigned short raster_aux_bits,
+                     const uint8_t *data, int pixels);
+
   // Flush the queue and wait until all remaining motor
   // operations have been flushed.
   void BringPathToHalt();
 
-  // Get the latest position enqueued to the motors.
-  // TODO(Leonardo): get actual position of the motor at this moment.
+  // Returns true if nothing has been enqueued since the last
+  // BringPathToHalt().
+  bool IsPathHalted() const;
+
+  // Returns true if PWM outputs changed that are not handed to the motor
+  // operations yet. They go out with the next move or BringPathToHalt().
+  bool HasPendingPWMChanges() const;
+
+  // Get the position of the motors at this moment; exact where the motion
+  // queue counts the steps (see MotionQueue::GetStepCounters()).
   void GetCurrentPosition(AxesRegister *pos);
 
+  // Get the target position of the last enqueued move, i.e. where the next
+  // move starts. Rounded to full steps.
+  void GetLastTargetPosition(AxesRegister *pos);
+
   // Drive an axis directly. Should only be used for cases such as
   // homing which require direct motor driving.
   //
@@ -59,11 +97,32 @@ public:
   // Returns the number of steps the stepmotor for that axis did.
   int DirectDrive(GCodeParserAxis axis, float distance, float v0, float v1);
 
+  // Like DirectDrive(), but moves all axes by their "distance" together.
+  // The speed is that of the axis that moves farthest, so that axes moving
+  // the same distance each go at that speed. Same preconditions.
+  void DirectDrive(const AxesRegister &distance, float v0, float v1);
+
+  // Like DirectDrive() with constant speed "v", but the motion queue stops
+  // the move right when "input" triggers, e.g. an endstop or probe.
+  // Returns false if the motion queue can't watch inputs; nothing is moved
+  // then. Otherwise, the signed number of steps the stepmotor for that axis
+  // did is returned in "steps_moved", and in "triggered" if the input
+  // stopped the move.
+  bool DirectDriveToInput(GCodeParserAxis axis, float distance, float v,
+                          const HardwareMapping::SwitchInput &input,
+                          int *steps_moved, bool *triggered);
+
   // Set the current absolute position of the given axis from an
   // machine move outside of the control of the Planner.
   // Precondition: BringPathToHalt() had been called before.
   void SetExternalPosition(GCodeParserAxis axis, float pos);
 
+  // The configuration passed in the constructor has changed: take the new
+  // speed and acceleration limits and lookahead from it. The steps/mm,
+  // kinematics and axis compensation need to stay the same.
+  // Precondition: BringPathToHalt() had been called before.
+  void ConfigChanged();
+
 private:
   class Impl;
   Impl *const impl_;
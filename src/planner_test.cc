@@ -13,6 +13,7 @@
 
 #include "gcode-machine-control.h"
 #include "hardware-mapping.h"
+#include "kinematics.h"
 #include "motor-operations.h"
 
 // Using different steps/mm speeds results in problems right now.
@@ -39,7 +40,7 @@ static void InitTestConfig(struct MachineControlConfig *c) {
 class FakeMotorOperations : public MotorOperations {
 public:
   FakeMotorOperations(const MachineControlConfig &config)
-    : config_(config) {}
+    : config_(config), max_step_frequency_(0), supports_arcs_(false) {}
 
   void Enqueue(const LinearSegmentSteps &segment) final {
 #if 0
@@ -86,6 +87,14 @@ public:
   void WaitQueueEmpty() final {}
   bool GetPhysicalStatus(PhysicalStatus *status) final { return false; }
   void SetExternalPosition(int axis, int steps) final {}
+  float MaxStepFrequency(unsigned motor_mask) const final {
+    return max_step_frequency_;
+  }
+
+  bool SupportsArcs() const final { return supports_arcs_; }
+
+  void SetMaxStepFrequency(float f) { max_step_frequency_ = f; }
+  void SetSupportsArcs(bool b) { supports_arcs_ = b; }
 
   const std::vector<LinearSegmentSteps> &segments() { return collected_; }
 
@@ -123,6 +132,8 @@ private:
   const MachineControlConfig &config_;
   // We keep this public for easier testing
   std::vector<LinearSegmentSteps> collected_;
+  float max_step_frequency_;
+  bool supports_arcs_;
 };
 
 class PlannerHarness {
@@ -144,6 +155,8 @@ public:
     simulated_hardware_.AddMotorMapping(AXIS_Z, 3, false);
     planner_ = new Planner(config_, &simulated_hardware_, &motor_ops_);
   }
+  const MachineControlConfig &config() const { return *config_; }
+
   ~PlannerHarness() {
     delete planner_;
     delete config_;
@@ -155,6 +168,20 @@ public:
     planner_->Enqueue(target, feed);
   }
 
+  bool EnqueueArc(bool clockwise, const AxesRegister &center,
+                  const AxesRegister &target, float feed) {
+    assert(!finished_);
+    return planner_->EnqueueArc(AXIS_Z, clockwise, center, target, feed);
+  }
+
+  void DirectDrive(const AxesRegister &distance, float v0, float v1) {
+    assert(!finished_);
+    planner_->DirectDrive(distance, v0, v1);
+  }
+
+  void SetMaxStepFrequency(float f) { motor_ops_.SetMaxStepFrequency(f); }
+  void SetSupportsArcs(bool b) { motor_ops_.SetSupportsArcs(b); }
+
   const std::vector<LinearSegmentSteps> &segments() {
     if (!finished_) {
       planner_->BringPathToHalt();
@@ -171,9 +198,24 @@ private:
   Planner *planner_;
 };
 
+// Speed along the path in mm/s of "v" (steps/s of the motor with the most
+// steps) in "segment".
+static double PathSpeed(const MachineControlConfig &config,
+                        const LinearSegmentSteps &segment, float v) {
+  double len_sq = 0;
+  int most_steps = 0;
+  for (int i = AXIS_X; i <= AXIS_Z; ++i) {
+    const double mm = segment.steps[i] / config.steps_per_mm[(GCodeParserAxis) i];
+    len_sq += mm * mm;
+    most_steps = std::max(most_steps, abs(segment.steps[i]));
+  }
+  return most_steps ? v * sqrt(len_sq) / most_steps : 0;
+}
+
 // Conditions that we expect in all moves.
 static void VerifyCommonExpectations(
-      const std::vector<LinearSegmentSteps> &segments) {
+      const std::vector<LinearSegmentSteps> &segments,
+      const MachineControlConfig &config) {
   ASSERT_GT((int)segments.size(), 1) << "Expected more than one segment";
 
   // Some basic assumption: something is moving.
@@ -183,13 +225,20 @@ static void VerifyCommonExpectations(
   EXPECT_EQ(0, segments[0].v0);
   EXPECT_EQ(0, segments[segments.size()-1].v1);
 
-  // The joining speeds between segments match.
-  for (size_t i = 0; i < segments.size()-1; ++i) {
-    // Let's determine the speed in euclidian space.
-#if 1
-    EXPECT_EQ(segments[i].v1, segments[i+1].v0)
-      << "Joining speed between " << i << " and " << (i+1);
-#endif
+  // The joining speeds between segments match. Within a move, the motor
+  // speeds are the same; between moves, the speeds along the path, as
+  // the motor with the most steps might have a different share of it.
+  // Segments without steps, left over from rounding, carry no direction.
+  size_t last = 0;
+  for (size_t i = 1; i < segments.size(); ++i) {
+    if (PathSpeed(config, segments[i], 1) == 0) continue;
+    if (segments[last].v1 != segments[i].v0) {
+      const double v1 = PathSpeed(config, segments[last], segments[last].v1);
+      const double v0 = PathSpeed(config, segments[i], segments[i].v0);
+      EXPECT_NEAR(v1, v0, 0.01 * v1)
+        << "Joining speed between " << last << " and " << i;
+    }
+    last = i;
   }
 }
 
@@ -205,7 +254,7 @@ TEST(PlannerTest, SimpleMove_NeverReachingFullSpeed) {
   // reach, then decelerating.
   EXPECT_EQ(2, (int)plantest.segments().size());
 
-  VerifyCommonExpectations(plantest.segments());
+  VerifyCommonExpectations(plantest.segments(), plantest.config());
 }
 
 TEST(PlannerTest, SimpleMove_ReachesFullSpeed) {
@@ -219,7 +268,7 @@ TEST(PlannerTest, SimpleMove_ReachesFullSpeed) {
   // We expect three segments: accelerating, plateau and decelerating.
   EXPECT_EQ(3, (int)plantest.segments().size());
 
-  VerifyCommonExpectations(plantest.segments());
+  VerifyCommonExpectations(plantest.segments(), plantest.config());
 }
 
 // When we move axes, they should try to reach the speed the user requested
@@ -338,7 +387,7 @@ static std::vector<LinearSegmentSteps> DoAngleMove(float threshold_angle,
   pos[AXIS_Y] = kSegmentLen * sin(radangle) + pos[AXIS_Y];
   plantest.Enqueue(pos, kFeedrate);
   std::vector<LinearSegmentSteps> segments = plantest.segments();
-  VerifyCommonExpectations(segments);
+  VerifyCommonExpectations(segments, plantest.config());
   return segments;
 }
 
@@ -405,6 +454,476 @@ TEST(PlannerTest, CornerMove_Shallow_NegativeAngle) {
   testShallowAngleAllStartingPoints(kThresholdAngle, kTestingAngle);
 }
 
+// Lowest speed between the segments of a path that turns by 4 degrees
+// between two short pieces.
+static float SlowestJoinOfShortPieces(float speed_tune_angle) {
+  PlannerHarness plantest(10, speed_tune_angle);
+  const float kTurn[] = { 0, 4, 8, 8 };
+  const float kLength[] = { 20, 0.5, 0.5, 20 };
+  AxesRegister pos;
+  for (int i = 0; i < 4; ++i) {
+    pos[AXIS_X] += kLength[i] * cos(kTurn[i] * M_PI / 180);
+    pos[AXIS_Y] += kLength[i] * sin(kTurn[i] * M_PI / 180);
+    plantest.Enqueue(pos, 5);
+  }
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  float slowest = -1;
+  for (size_t i = 0; i < segments.size() - 1; ++i) {
+    if (slowest < 0 || segments[i].v1 < slowest) slowest = segments[i].v1;
+  }
+  return slowest;
+}
+
+// Within the threshold angle, short pieces join at cos(angle + speed tune
+// angle) of the speed.
+TEST(PlannerTest, SpeedTuneAngleSlowsShortPieces) {
+  const float untuned = SlowestJoinOfShortPieces(0);
+  const float tuned = SlowestJoinOfShortPieces(10);
+  EXPECT_NEAR(cos(14 * M_PI / 180) / cos(4 * M_PI / 180), tuned / untuned,
+              1e-3);
+}
+
+// Maximum speed on the X axis we reach when moving along a straight line
+// made up of many short segments.
+static float PeakSpeedForShortSegments(int lookahead_segments) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->lookahead_segments = lookahead_segments;
+  PlannerHarness plantest(0, 0, config);
+
+  AxesRegister pos;
+  for (int i = 1; i <= 100; ++i) {
+    pos[AXIS_X] = i * 1.0;   // 1mm segments.
+    plantest.Enqueue(pos, 1000);
+  }
+  VerifyCommonExpectations(plantest.segments(), plantest.config());
+
+  float peak = 0;
+  for (const LinearSegmentSteps &s : plantest.segments()) {
+    if (s.v1 > peak) peak = s.v1;
+  }
+  return peak;
+}
+
+// With a deeper lookahead, we know that we have more room to decelerate, so
+// we can go faster on a path consisting of many short segments.
+TEST(PlannerTest, DeepLookaheadAllowsHigherSpeedOnShortSegments) {
+  const float shallow_speed = PeakSpeedForShortSegments(1);
+  const float deep_speed = PeakSpeedForShortSegments(32);
+  EXPECT_GT(shallow_speed, 0);
+  EXPECT_GT(deep_speed, 2 * shallow_speed);
+}
+
+// Even with a long lookahead, we never exceed what can be stopped from
+// within the segments we know about.
+TEST(PlannerTest, DeepLookaheadStopsInTime) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->lookahead_segments = 64;
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  for (int i = 1; i <= 10; ++i) {
+    pos[AXIS_X] = i * 1.0;
+    plantest.Enqueue(pos, 1000);
+  }
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  // 10mm total travel: accelerate halfway, then decelerate.
+  // v = sqrt(a * s) with a = 100mm/s^2, s = 10mm, 1000 steps/mm.
+  float peak = 0;
+  for (const LinearSegmentSteps &s : segments) {
+    if (s.v1 > peak) peak = s.v1;
+  }
+  EXPECT_NEAR(sqrtf(100 * 10) * 1000, peak, 1000);
+}
+
+// Go around a polygon approximating a circle with the given config and
+// return the lowest speed seen in the joints between segments.
+static float LowestJoiningSpeedOnPolygon(MachineControlConfig *config) {
+  PlannerHarness plantest(0, 0, config);
+  const float kRadius = 50;
+  const int kSteps = 36;   // 10 degree turn at each vertex.
+  AxesRegister pos;
+  for (int i = 1; i <= kSteps; ++i) {
+    const float angle = 2 * M_PI * i / kSteps;
+    pos[AXIS_X] = kRadius * sin(angle);
+    pos[AXIS_Y] = kRadius - kRadius * cos(angle);
+    plantest.Enqueue(pos, 1000);
+  }
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  float lowest = -1;
+  for (size_t i = 0; i < segments.size() - 1; ++i) {
+    if (lowest < 0 || segments[i].v1 < lowest) lowest = segments[i].v1;
+  }
+  return lowest;
+}
+
+TEST(PlannerTest, JunctionDeviationKeepsSpeedInCurves) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->threshold_angle = 5;  // Our 10 degree corners are outside of that.
+  EXPECT_EQ(0, LowestJoiningSpeedOnPolygon(config));
+
+  config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->threshold_angle = 5;
+  config->junction_deviation = 0.05;
+  EXPECT_GT(LowestJoiningSpeedOnPolygon(config), 0);
+}
+
+TEST(PlannerTest, JunctionDeviationStopsOnReversal) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->junction_deviation = 0.05;
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  pos[AXIS_X] = 10;
+  plantest.Enqueue(pos, 100);
+  pos[AXIS_X] = 0;
+  plantest.Enqueue(pos, 100);
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  ASSERT_EQ(4, (int)segments.size());
+  EXPECT_EQ(0, segments[1].v1);
+}
+
+// An axis without acceleration configured does not limit the speed in a
+// corner, as it doesn't limit the acceleration of a move either.
+TEST(PlannerTest, JunctionDeviationIgnoresUnconfiguredAcceleration) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->junction_deviation = 0.05;
+  config->acceleration[AXIS_Z] = 0;
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  pos[AXIS_X] = 10;
+  plantest.Enqueue(pos, 100);
+  pos[AXIS_X] = 20;
+  pos[AXIS_Z] = 0.5;   // Fewer steps than X, which stays the defining axis.
+  plantest.Enqueue(pos, 100);
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  size_t corner = 0;
+  int x_steps = 0;
+  while (corner < segments.size() && x_steps < 10 * 1000)
+    x_steps += segments[corner++].steps[AXIS_X];
+  ASSERT_LT(corner, segments.size());
+  EXPECT_GT(segments[corner - 1].v1, 0);
+}
+
+// A corner between moves with different defining axes and steps/mm: the
+// speed at the corner is what the second move can still stop from, along
+// the path, not in whichever steps/s the first move counts.
+TEST(PlannerTest, MixedAxisCornerLimitedBySecondMove) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->steps_per_mm[AXIS_X] = 80;
+  config->steps_per_mm[AXIS_Z] = 400;
+  config->junction_deviation = 100;   // Not limited by the corner itself.
+  PlannerHarness plantest(0, 0, config);
+
+  AxesRegister pos;
+  pos[AXIS_X] = 10;   // 800 steps on X
+  pos[AXIS_Z] = 1;    // 400 steps on Z
+  plantest.Enqueue(pos, 100);
+  pos[AXIS_X] = 12;   // 160 steps on X
+  pos[AXIS_Z] = 2;    // 400 steps on Z: now the defining axis.
+  plantest.Enqueue(pos, 100);
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+
+  // The first move ends where X has done its 800 steps.
+  size_t corner = 0;
+  int x_steps = 0;
+  while (corner < segments.size() && x_steps < 800)
+    x_steps += segments[corner++].steps[AXIS_X];
+  ASSERT_EQ(800, x_steps);
+  ASSERT_LT(corner, segments.size());
+
+  // X limits the acceleration of the second move: 100mm/s^2 for 2mm of
+  // the sqrt(5)mm path.
+  const double len = sqrt(5.0);
+  const double path_accel = 100 * len / 2;
+  const double v_stop = sqrt(2 * path_accel * len);
+  const double v_corner = PathSpeed(*config, segments[corner - 1],
+                                    segments[corner - 1].v1);
+  EXPECT_NEAR(v_stop, v_corner, 0.02 * v_stop);
+  EXPECT_NEAR(v_corner, PathSpeed(*config, segments[corner], segments[corner].v0),
+              0.01 * v_corner);
+}
+
+// A slow-accelerating axis participating in a move limits the acceleration
+// of the defining axis, so that it never has to exceed its own limit.
+TEST(PlannerTest, AccelerationLimitedByParticipatingAxis) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->steps_per_mm[AXIS_X] = 1000;
+  config->steps_per_mm[AXIS_Y] = 1000;
+  config->acceleration[AXIS_X] = 1000;
+  config->acceleration[AXIS_Y] = 20;   // Slowpoke.
+  PlannerHarness plantest(0, 0, config);
+
+  AxesRegister pos;
+  pos[AXIS_X] = 100;   // X is the defining axis.
+  pos[AXIS_Y] = 10;
+  plantest.Enqueue(pos, 10);
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  const LinearSegmentSteps &accel = segments[0];
+  ASSERT_GT(accel.steps[AXIS_X], 0);
+  // v^2 = 2 * a * s; starting from zero.
+  const float defining_accel = accel.v1 * accel.v1 / (2.0 * accel.steps[AXIS_X]);
+  const float y_accel = defining_accel * accel.steps[AXIS_Y] / accel.steps[AXIS_X];
+  EXPECT_NEAR(20 * 1000, y_accel, 200);
+}
+
+// The step frequency limit reported by the motor backend caps the speed.
+TEST(PlannerTest, SpeedLimitedByMaxStepFrequency) {
+  PlannerHarness plantest;
+  plantest.SetMaxStepFrequency(5000);
+
+  AxesRegister pos;
+  pos[AXIS_X] = 100;
+  plantest.Enqueue(pos, 10);  // 10000 steps/s with 1000 steps/mm.
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  ASSERT_EQ(3, (int)segments.size());
+  for (const LinearSegmentSteps &s : segments) {
+    EXPECT_LE(s.v0, 5000);
+    EXPECT_LE(s.v1, 5000);
+  }
+  EXPECT_FLOAT_EQ(5000, segments[1].v0);   // Plateau at the limit.
+}
+
+// With S-curve, acceleration segments are broken into several pieces whose
+// acceleration first increases, then decreases again.
+TEST(PlannerTest, SCurveSmoothsAcceleration) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->s_curve_fraction = 1.0;
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  pos[AXIS_X] = 100;
+  plantest.Enqueue(pos, 10);
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  ASSERT_GT((int)segments.size(), 3);
+
+  // Collect the accelerations of the first ramp: v1^2 - v0^2 = 2 * a * s
+  std::vector<float> accel;
+  for (const LinearSegmentSteps &s : segments) {
+    if (s.v1 <= s.v0) break;
+    accel.push_back((s.v1*s.v1 - s.v0*s.v0) / (2.0 * s.steps[AXIS_X]));
+  }
+  ASSERT_GT((int)accel.size(), 2);
+  // Gentle start and end; highest acceleration in the middle but within
+  // the configured limits.
+  float peak = 0;
+  for (float a : accel) if (a > peak) peak = a;
+  EXPECT_LT(accel.front(), peak);
+  EXPECT_LT(accel.back(), peak);
+  EXPECT_LE(peak, 1.1 * 100 * 1000);  // 100mm/s^2 @ 1000 steps/mm
+
+  // Total steps are preserved.
+  int total = 0;
+  for (const LinearSegmentSteps &s : segments) total += s.steps[AXIS_X];
+  EXPECT_EQ(100 * 1000, total);
+}
+
+static MachineControlConfig *ArcTestConfig() {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->steps_per_mm[AXIS_Y] = config->steps_per_mm[AXIS_X];
+  return config;
+}
+
+// Arcs are only handed to the motors if they can do them.
+TEST(PlannerTest, ArcRequiresMotorSupport) {
+  PlannerHarness plantest(0, 0, ArcTestConfig());
+  AxesRegister center, target;
+  center[AXIS_X] = 10;
+  target[AXIS_X] = 20;
+  EXPECT_FALSE(plantest.EnqueueArc(true, center, target, 10));
+  plantest.SetSupportsArcs(true);
+  EXPECT_TRUE(plantest.EnqueueArc(true, center, target, 10));
+}
+
+// A full circle is split into quarters, but the motion doesn't stop
+// in between and ends exactly at the start.
+TEST(PlannerTest, FullCircleArcKeepsSpeed) {
+  PlannerHarness plantest(0, 0, ArcTestConfig());
+  plantest.SetSupportsArcs(true);
+  AxesRegister center, target;
+  center[AXIS_X] = 10;
+  ASSERT_TRUE(plantest.EnqueueArc(false, center, target, 10));
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  VerifyCommonExpectations(segments, plantest.config());
+  int sum[2] = { 0, 0 };
+  int arc_segments = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const LinearSegmentSteps &s = segments[i];
+    sum[0] += s.steps[AXIS_X];
+    sum[1] += s.steps[AXIS_Y];
+    if (s.arc_radius > 0) {
+      ++arc_segments;
+      EXPECT_FLOAT_EQ(10 * 1000, s.arc_radius);
+      EXPECT_LE(0, s.arc_start);
+      EXPECT_LT(s.arc_start, s.arc_end);
+      EXPECT_LE(s.arc_end, M_PI/2 + 1e-5);
+      EXPECT_EQ(0, s.arc_rise_motors & s.arc_fall_motors);
+    }
+    if (i < segments.size() - 1) {
+      EXPECT_GT(s.v1, 0) << "Stop at " << i;
+    }
+  }
+  EXPECT_GE(arc_segments, 4);
+  EXPECT_EQ(0, sum[0]);
+  EXPECT_EQ(0, sum[1]);
+}
+
+// Sum of the steps the X motor does in negative and positive direction.
+static void SumXSteps(const std::vector<LinearSegmentSteps> &segments,
+                      int *negative, int *positive) {
+  *negative = *positive = 0;
+  for (const LinearSegmentSteps &s : segments) {
+    if (s.steps[AXIS_X] < 0) *negative += s.steps[AXIS_X];
+    else *positive += s.steps[AXIS_X];
+  }
+}
+
+TEST(PlannerTest, BacklashTakenUpWhenReversing) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->backlash_mm[AXIS_X] = 0.1;
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  pos[AXIS_X] = 10;
+  plantest.Enqueue(pos, 100);
+  pos[AXIS_X] = 0;
+  plantest.Enqueue(pos, 100);
+  pos[AXIS_X] = 5;
+  plantest.Enqueue(pos, 100);
+  int negative, positive;
+  SumXSteps(plantest.segments(), &negative, &positive);
+  EXPECT_EQ(10000 + 100 + 5000, positive);
+  EXPECT_EQ(-10000 - 100, negative);
+}
+
+TEST(PlannerTest, ErrorMapCorrectsMotorSteps) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->error_map_spacing[AXIS_X] = 10;
+  config->error_map[AXIS_X] = { 0, 0.1, -0.2 };   // mm the axis is off.
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  pos[AXIS_X] = 10;
+  plantest.Enqueue(pos, 100);
+  pos[AXIS_X] = 25;
+  plantest.Enqueue(pos, 100);
+  int negative, positive;
+  SumXSteps(plantest.segments(), &negative, &positive);
+  EXPECT_EQ(0, negative);
+  EXPECT_EQ(25000 + 200, positive);   // Beyond the table: last value.
+}
+
+TEST(PlannerTest, CoreXYMovesBothMotors) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->kinematics = "corexy";
+  PlannerHarness plantest(0, 0, config);
+  AxesRegister pos;
+  pos[AXIS_Y] = 10;
+  plantest.Enqueue(pos, 100);
+  int x_steps = 0, y_steps = 0;
+  for (const LinearSegmentSteps &s : plantest.segments()) {
+    x_steps += s.steps[AXIS_X];
+    y_steps += s.steps[AXIS_Y];
+  }
+  EXPECT_EQ(10 * 1000, x_steps);
+  EXPECT_EQ(-10 * 4000, y_steps);
+}
+
+// Homing several axes at once: each gets the speed, limited by the slowest.
+TEST(PlannerTest, DirectDriveOfSeveralAxes) {
+  AxesRegister distance;
+  distance[AXIS_X] = 1;
+  distance[AXIS_Y] = -1;
+  {
+    PlannerHarness plantest;
+    plantest.DirectDrive(distance, 0, 10);
+    const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+    ASSERT_EQ(1, (int)segments.size());
+    EXPECT_EQ(1000, segments[0].steps[AXIS_X]);
+    EXPECT_EQ(-4000, segments[0].steps[AXIS_Y]);
+    EXPECT_EQ(0, segments[0].v0);
+    EXPECT_FLOAT_EQ(10 * 4000, segments[0].v1);  // Y has the most steps.
+  }
+  {
+    PlannerHarness plantest;
+    plantest.SetMaxStepFrequency(20000);
+    plantest.DirectDrive(distance, 10, 10);
+    const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+    ASSERT_EQ(1, (int)segments.size());
+    EXPECT_FLOAT_EQ(20000, segments[0].v0);
+    EXPECT_FLOAT_EQ(20000, segments[0].v1);
+  }
+
+  // With CoreXY, both axes go through the kinematics together.
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->kinematics = "corexy";
+  PlannerHarness plantest(0, 0, config);
+  plantest.DirectDrive(distance, 0, 10);
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  ASSERT_EQ(1, (int)segments.size());
+  EXPECT_EQ(0, segments[0].steps[AXIS_X]);
+  EXPECT_EQ(2 * 4000, segments[0].steps[AXIS_Y]);
+}
+
+TEST(PlannerTest, DeltaMoveIsSegmented) {
+  MachineControlConfig *config = new MachineControlConfig();
+  InitTestConfig(config);
+  config->kinematics = "delta";
+  config->move_range_mm[AXIS_X] = 200;
+  config->move_range_mm[AXIS_Y] = 200;
+  config->delta_radius = 100;
+  config->delta_rod_length = 250;
+  PlannerHarness plantest(0, 0, config);
+  // With all carriages homed at 0, the effector is in the center, below.
+  const float low = -sqrtf(250*250 - 100*100);
+  AxesRegister pos;
+  pos[AXIS_X] = 150;
+  pos[AXIS_Y] = 100;
+  pos[AXIS_Z] = low;
+  plantest.Enqueue(pos, 100);
+
+  Kinematics *kinematics;
+  ASSERT_TRUE(Kinematics::Create(*config, &kinematics));
+  KinematicsBatch batch;
+  batch.count = 1;
+  batch.x[0] = 150; batch.y[0] = 100; batch.z[0] = low;
+  ASSERT_TRUE(kinematics->Inverse(&batch));
+  delete kinematics;
+
+  const std::vector<LinearSegmentSteps> &segments = plantest.segments();
+  EXPECT_GT(segments.size(), 10u);
+  int steps[3] = { 0, 0, 0 };
+  for (const LinearSegmentSteps &s : segments) {
+    for (int i = 0; i < 3; ++i) steps[i] += s.steps[i];
+  }
+  EXPECT_NEAR(batch.x[0] * 1000, steps[0], 1);
+  EXPECT_NEAR(batch.y[0] * 4000, steps[1], 1);
+  EXPECT_NEAR(batch.z[0] * 16000, steps[2], 1);
+}
+
 int main(int argc, char *argv[]) {
   Log_init("/dev/stderr");
   ::testing::InitGoogleTest(&argc, argv);
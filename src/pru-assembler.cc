@@ -0,0 +1,1039 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pru-assembler.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <list>
+#include <set>
+#include <sstream>
+
+#include "common/logging.h"
+
+namespace {
+// A line of the program after the preprocessor: comments removed and
+// defines expanded.
+struct SourceLine {
+  std::string file;
+  int line_no;
+  std::string text;
+};
+
+bool IsIdentifierStart(char c) { return isalpha(c) || c == '_'; }
+bool IsIdentifierChar(char c) { return isalnum(c) || c == '_'; }
+
+std::string Trim(const std::string &s) {
+  size_t start = 0, end = s.size();
+  while (start < end && isspace(s[start])) ++start;
+  while (end > start && isspace(s[end-1])) --end;
+  return s.substr(start, end - start);
+}
+
+std::string ToLower(std::string s) {
+  for (char &c : s) c = tolower(c);
+  return s;
+}
+
+// Split at commas that are not in parentheses.
+std::vector<std::string> SplitOperands(const std::string &s) {
+  std::vector<std::string> result;
+  if (Trim(s).empty()) return result;
+  int depth = 0;
+  std::string current;
+  for (char c : s) {
+    if (c == '(') ++depth;
+    if (c == ')') --depth;
+    if (c == ',' && depth == 0) {
+      result.push_back(Trim(current));
+      current.clear();
+    } else {
+      current += c;
+    }
+  }
+  result.push_back(Trim(current));
+  return result;
+}
+
+// Replace the identifiers in "text" with "replace" returning the
+// replacement. Numbers are skipped, as are names of struct fields
+// following a '.'.
+template <typename Replacer>
+std::string ReplaceIdentifiers(const std::string &text, Replacer replace) {
+  std::string result;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const char c = text[pos];
+    if (isdigit(c) || (IsIdentifierStart(c) && pos > 0 && text[pos-1] == '.')) {
+      const size_t start = pos;
+      while (pos < text.size() && IsIdentifierChar(text[pos])) ++pos;
+      result += text.substr(start, pos - start);
+    } else if (IsIdentifierStart(c)) {
+      const size_t start = pos;
+      while (pos < text.size() && IsIdentifierChar(text[pos])) ++pos;
+      result += replace(text.substr(start, pos - start));
+    } else {
+      result += c;
+      ++pos;
+    }
+  }
+  return result;
+}
+
+// Removes comments: ';' and '//' to the end of the line, /* */ within it.
+std::string RemoveComments(const std::string &line) {
+  std::string result;
+  for (size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == ';' || line.compare(i, 2, "//") == 0)
+      break;
+    if (line.compare(i, 2, "/*") == 0) {
+      const size_t end = line.find("*/", i + 2);
+      if (end == std::string::npos) break;
+      i = end + 1;
+      result += ' ';
+      continue;
+    }
+    result += line[i];
+  }
+  return result;
+}
+
+std::string Directory(const std::string &filename) {
+  const size_t slash = filename.rfind('/');
+  return slash == std::string::npos ? "." : filename.substr(0, slash);
+}
+
+class Preprocessor {
+public:
+  Preprocessor(const std::vector<std::string> &include_dirs,
+               const std::map<std::string, std::string> &defines)
+    : include_dirs_(include_dirs), defines_(defines) {}
+
+  bool ReadFile(const std::string &filename, std::vector<SourceLine> *out) {
+    return Read(filename, 0, out);
+  }
+
+private:
+  struct Conditional {
+    bool active;         // Lines in this branch are used.
+    bool parent_active;  // ... and the ones around.
+    bool seen_else;
+  };
+
+  bool Read(const std::string &filename, int depth,
+            std::vector<SourceLine> *out) {
+    if (depth > 16) {
+      Log_error("%s: #include nested too deep", filename.c_str());
+      return false;
+    }
+    std::ifstream in(filename.c_str());
+    if (!in.good()) {
+      Log_error("Can't read %s", filename.c_str());
+      return false;
+    }
+    std::vector<Conditional> conditionals;
+    std::string raw;
+    int line_no = 0;
+    while (std::getline(in, raw)) {
+      ++line_no;
+      const std::string line = Trim(RemoveComments(raw));
+      const bool active = conditionals.empty() || conditionals.back().active;
+      if (line.empty() || line[0] != '#') {
+        if (active && !line.empty())
+          out->push_back({ filename, line_no, Expand(line) });
+        continue;
+      }
+      std::istringstream directive(line.substr(1));
+      std::string keyword;
+      directive >> keyword;
+      std::string rest;
+      std::getline(directive, rest);
+      rest = Trim(rest);
+      if (keyword == "ifdef" || keyword == "ifndef") {
+        const bool defined = defines_.find(rest) != defines_.end();
+        conditionals.push_back({ active && defined == (keyword == "ifdef"),
+                                 active, false });
+      } else if (keyword == "else") {
+        if (conditionals.empty() || conditionals.back().seen_else)
+          return Error(filename, line_no, "unexpected #else");
+        Conditional &c = conditionals.back();
+        c.active = c.parent_active && !c.active;
+        c.seen_else = true;
+      } else if (keyword == "endif") {
+        if (conditionals.empty())
+          return Error(filename, line_no, "unexpected #endif");
+        conditionals.pop_back();
+      } else if (!active) {
+        continue;
+      } else if (keyword == "define") {
+        size_t name_end = 0;
+        while (name_end < rest.size() && IsIdentifierChar(rest[name_end]))
+          ++name_end;
+        if (name_end == 0 || (name_end < rest.size() && rest[name_end] == '('))
+          return Error(filename, line_no, "only simple #define supported");
+        defines_[rest.substr(0, name_end)] = Trim(rest.substr(name_end));
+      } else if (keyword == "undef") {
+        defines_.erase(rest);
+      } else if (keyword == "include") {
+        std::string path;
+        if (!FindInclude(filename, rest, &path))
+          return Error(filename, line_no, "can't find include " + rest);
+        if (!Read(path, depth + 1, out))
+          return false;
+      } else {
+        return Error(filename, line_no, "unsupported #" + keyword);
+      }
+    }
+    if (!conditionals.empty())
+      return Error(filename, line_no, "missing #endif");
+    return true;
+  }
+
+  // "file" is relative to the including file, then the include
+  // directories; <file> only in the include directories.
+  bool FindInclude(const std::string &including, const std::string &spec,
+                   std::string *path) {
+    if (spec.size() < 3) return false;
+    const bool local = spec[0] == '"' && spec[spec.size()-1] == '"';
+    if (!local && !(spec[0] == '<' && spec[spec.size()-1] == '>'))
+      return false;
+    const std::string name = spec.substr(1, spec.size() - 2);
+    std::vector<std::string> dirs;
+    if (local) dirs.push_back(Directory(including));
+    dirs.insert(dirs.end(), include_dirs_.begin(), include_dirs_.end());
+    for (const std::string &dir : dirs) {
+      *path = dir + "/" + name;
+      if (std::ifstream(path->c_str()).good())
+        return true;
+    }
+    return false;
+  }
+
+  std::string Expand(const std::string &text) const {
+    std::set<std::string> expanding;
+    return Expand(text, &expanding);
+  }
+
+  std::string Expand(const std::string &text,
+                     std::set<std::string> *expanding) const {
+    return ReplaceIdentifiers(text, [&](const std::string &name) {
+        const auto found = defines_.find(name);
+        if (found == defines_.end() || expanding->count(name))
+          return name;
+        expanding->insert(name);
+        const std::string result = Expand(found->second, expanding);
+        expanding->erase(name);
+        return result;
+      });
+  }
+
+  bool Error(const std::string &file, int line_no, const std::string &msg) {
+    Log_error("%s:%d: %s", file.c_str(), line_no, msg.c_str());
+    return false;
+  }
+
+  const std::vector<std::string> include_dirs_;
+  std::map<std::string, std::string> defines_;
+};
+
+// Part of a register, as encoded in the instructions.
+struct RegisterField {
+  int reg;
+  int byte;    // First byte in the register.
+  int bytes;   // 1, 2 or 4.
+
+  // Bit 7..5 select the part, bit 4..0 the register.
+  uint8_t Encode() const {
+    const int sel = bytes == 1 ? byte : (bytes == 2 ? 4 + byte : 7);
+    return sel << 5 | reg;
+  }
+};
+
+struct StructField {
+  std::string name;
+  int offset;
+  int size;
+};
+
+struct StructType {
+  std::vector<StructField> fields;
+  int size;
+  const StructField *Field(const std::string &name) const {
+    for (const StructField &f : fields) {
+      if (f.name == name) return &f;
+    }
+    return NULL;
+  }
+};
+
+// A struct mapped to registers with .assign
+struct Assignment {
+  std::string type;
+  int start_byte;   // 4 * register + byte
+};
+
+struct Macro {
+  std::vector<std::string> params;
+  std::vector<SourceLine> body;
+};
+
+// Labels are looked up in the scope of the macro expansion they are used
+// in, then the ones of the enclosing expansions and the global scope 0.
+struct Scope {
+  int parent;
+  std::map<std::string, uint32_t> labels;
+};
+
+// Instruction waiting to be encoded once all labels are known.
+struct Statement {
+  const SourceLine *line;
+  std::string mnemonic;   // Lower case.
+  std::vector<std::string> operands;
+  int scope;
+  uint32_t address;
+};
+
+enum AluOp {
+  ALU_ADD, ALU_ADC, ALU_SUB, ALU_SUC, ALU_LSL, ALU_LSR, ALU_RSB, ALU_RSC,
+  ALU_AND, ALU_OR, ALU_XOR, ALU_NOT, ALU_MIN, ALU_MAX, ALU_CLR, ALU_SET,
+};
+const char *const kAluMnemonics[] = {
+  "add", "adc", "sub", "suc", "lsl", "lsr", "rsb", "rsc",
+  "and", "or", "xor", "not", "min", "max", "clr", "set",
+};
+
+// Comparison bits of the quick branches: taken if op2 >, == or < rs1.
+enum { CMP_GT = 1, CMP_EQ = 2, CMP_LT = 4 };
+const struct { const char *mnemonic; int cmp; } kQuickBranches[] = {
+  { "qbgt", CMP_GT }, { "qbge", CMP_GT | CMP_EQ }, { "qblt", CMP_LT },
+  { "qble", CMP_LT | CMP_EQ }, { "qbeq", CMP_EQ }, { "qbne", CMP_GT | CMP_LT },
+  { "qba", CMP_GT | CMP_EQ | CMP_LT },
+};
+
+// Broadside devices of ZERO and FILL.
+enum { XFR_FILL = 254, XFR_ZERO = 255 };
+
+// Register pasm's CALL and RET use.
+const RegisterField kCallRegister = { 30, 0, 2 };
+
+class Assembly {
+public:
+  explicit Assembly(const std::vector<SourceLine> &lines) : lines_(lines) {
+    scopes_.push_back({ -1, {} });
+  }
+
+  bool Assemble(std::vector<uint32_t> *program,
+                std::map<std::string, uint32_t> *labels) {
+    address_ = 0;
+    if (!Process(lines_, 0))
+      return false;
+    program->assign(address_, 0);
+    for (const Statement &s : statements_) {
+      if (!Encode(s, program))
+        return false;
+    }
+    *labels = scopes_[0].labels;
+    return true;
+  }
+
+private:
+  // First pass: macros and directives, labels and the size of each
+  // instruction.
+  bool Process(const std::vector<SourceLine> &lines, int scope) {
+    for (size_t i = 0; i < lines.size(); ++i) {
+      const SourceLine &line = lines[i];
+      std::string text = line.text;
+      size_t pos = 0;
+      while (pos < text.size() && IsIdentifierChar(text[pos])) ++pos;
+      if (pos > 0 && pos < text.size() && text[pos] == ':') {
+        const std::string label = text.substr(0, pos);
+        if (scopes_[scope].labels.count(label))
+          return Error(line, "duplicate label " + label);
+        scopes_[scope].labels[label] = address_;
+        text = Trim(text.substr(pos + 1));
+        if (text.empty()) continue;
+      }
+
+      size_t word_end = 0;
+      while (word_end < text.size() && !isspace(text[word_end])) ++word_end;
+      const std::string word = text.substr(0, word_end);
+      const std::vector<std::string> operands
+        = SplitOperands(text.substr(word_end));
+
+      if (ToLower(word) == ".macro") {
+        if (operands.size() != 1)
+          return Error(line, "expected macro name");
+        Macro &macro = macros_[operands[0]];
+        macro = Macro();
+        for (++i; i < lines.size(); ++i) {
+          const std::string &body = lines[i].text;
+          if (ToLower(body) == ".endm") break;
+          if (ToLower(body.substr(0, 7)) == ".mparam") {
+            for (const std::string &p : SplitOperands(body.substr(7)))
+              macro.params.push_back(p);
+          } else {
+            macro.body.push_back(lines[i]);
+          }
+        }
+        if (i == lines.size())
+          return Error(line, "missing .endm");
+        continue;
+      }
+      if (word[0] == '.') {
+        if (!Directive(line, ToLower(word), operands))
+          return false;
+        continue;
+      }
+
+      const auto macro = macros_.find(word);
+      if (macro != macros_.end()) {
+        if (!ExpandMacro(line, macro->second, operands, scope))
+          return false;
+        continue;
+      }
+
+      Statement statement = { &line, ToLower(word), operands, scope, address_ };
+      int words;
+      if (!InstructionWords(statement, &words))
+        return false;
+      statements_.push_back(statement);
+      address_ += words;
+    }
+    return true;
+  }
+
+  bool ExpandMacro(const SourceLine &line, const Macro &macro,
+                   const std::vector<std::string> &args, int scope) {
+    if (args.size() != macro.params.size())
+      return Error(line, "wrong number of macro arguments");
+    if (scopes_.size() > 100000)
+      return Error(line, "too many macro expansions");
+    std::map<std::string, std::string> values;
+    for (size_t i = 0; i < args.size(); ++i)
+      values[macro.params[i]] = args[i];
+    // The expanded lines need to stay where they are for the statements.
+    expansions_.push_back(std::vector<SourceLine>());
+    std::vector<SourceLine> &expanded = expansions_.back();
+    for (const SourceLine &body : macro.body) {
+      SourceLine copy = body;
+      copy.text = ReplaceIdentifiers(body.text, [&](const std::string &name) {
+          const auto found = values.find(name);
+          return found == values.end() ? name : found->second;
+        });
+      expanded.push_back(copy);
+    }
+    scopes_.push_back({ scope, {} });
+    return Process(expanded, scopes_.size() - 1);
+  }
+
+  bool Directive(const SourceLine &line, const std::string &directive,
+                 const std::vector<std::string> &operands) {
+    if (directive == ".origin") {
+      int64_t origin;
+      if (operands.size() != 1 || !Evaluate(line, operands[0], -1, &origin))
+        return Error(line, "expected .origin address");
+      if (origin < address_)
+        return Error(line, ".origin before code already there");
+      address_ = origin;
+      return true;
+    }
+    if (directive == ".entrypoint") {
+      return true;  // The program is started at the beginning.
+    }
+    if (directive == ".struct") {
+      if (operands.size() != 1 || !current_struct_.empty())
+        return Error(line, "unexpected .struct");
+      current_struct_ = operands[0];
+      structs_[current_struct_] = StructType();
+      structs_[current_struct_].size = 0;
+      return true;
+    }
+    if (directive == ".u8" || directive == ".u16" || directive == ".u32") {
+      if (current_struct_.empty() || operands.size() != 1)
+        return Error(line, "field outside of .struct");
+      StructType &type = structs_[current_struct_];
+      const int size = directive == ".u8" ? 1 : (directive == ".u16" ? 2 : 4);
+      if (type.size % size != 0)
+        return Error(line, "field " + operands[0] + " not aligned");
+      type.fields.push_back({ operands[0], type.size, size });
+      type.size += size;
+      return true;
+    }
+    if (directive == ".ends") {
+      if (current_struct_.empty())
+        return Error(line, "unexpected .ends");
+      current_struct_.clear();
+      return true;
+    }
+    if (directive == ".assign") {
+      RegisterField start, end;
+      if (operands.size() != 4 || !structs_.count(operands[0])
+          || !Register(operands[1], &start) || !Register(operands[2], &end))
+        return Error(line, "expected .assign struct, start, end, name");
+      const int start_byte = 4 * start.reg + start.byte;
+      const int end_byte = 4 * end.reg + end.byte + end.bytes;
+      if (end_byte - start_byte != structs_[operands[0]].size)
+        return Error(line, "registers don't match size of " + operands[0]);
+      assignments_[operands[3]] = { operands[0], start_byte };
+      return true;
+    }
+    return Error(line, "unsupported directive " + directive);
+  }
+
+  bool InstructionWords(const Statement &s, int *words) {
+    *words = 1;
+    if (s.mnemonic != "mov")
+      return true;
+    RegisterField dest, source;
+    int64_t value;
+    if (s.operands.size() != 2 || !Register(s.operands[0], &dest))
+      return Error(*s.line, "expected MOV register, value");
+    if (Register(s.operands[1], &source))
+      return true;
+    if (!Evaluate(*s.line, s.operands[1], -1, &value))
+      return false;
+    if ((value & 0xffffffff) > 0xffff) {
+      if (dest.bytes != 4)
+        return Error(*s.line, "value too large for register");
+      *words = 2;
+    }
+    return true;
+  }
+
+  // Second pass.
+  bool Encode(const Statement &s, std::vector<uint32_t> *program) {
+    const std::string &m = s.mnemonic;
+    const std::vector<std::string> &ops = s.operands;
+    uint32_t *out = &(*program)[s.address];
+    RegisterField rd, rs1;
+
+    for (int op = 0; op < 16; ++op) {
+      if (m != kAluMnemonics[op]) continue;
+      const bool single_bit = (op == ALU_CLR || op == ALU_SET);
+      if (op == ALU_NOT && ops.size() == 2)
+        return Alu(s, op, ops[0], ops[1], "0", out);
+      if (single_bit && ops.size() == 2)
+        return Alu(s, op, ops[0], ops[0], ops[1], out);
+      if (ops.size() != 3)
+        return Error(*s.line, "expected three operands");
+      return Alu(s, op, ops[0], ops[1], ops[2], out);
+    }
+
+    if (m == "mov") {
+      int64_t value;
+      if (!Register(ops[0], &rd)) return Error(*s.line, "expected register");
+      if (Register(ops[1], &rs1)) {
+        // pasm moves registers with AND, which keeps the carry.
+        out[0] = ALU_AND << 25 | rs1.Encode() << 16 | rs1.Encode() << 8
+          | rd.Encode();
+        return true;
+      }
+      if (!Evaluate(*s.line, ops[1], -1, &value)) return false;
+      value &= 0xffffffff;
+      if (value > 0xffff) {
+        out[0] = Ldi({ rd.reg, 0, 2 }, value & 0xffff);
+        out[1] = Ldi({ rd.reg, 2, 2 }, value >> 16);
+        return true;
+      }
+      if (rd.bytes == 1 && value > 0xff)
+        return Error(*s.line, "value too large for register");
+      out[0] = Ldi(rd, value);
+      return true;
+    }
+    if (m == "ldi") {
+      int64_t value;
+      if (ops.size() != 2 || !Register(ops[0], &rd)
+          || !Evaluate(*s.line, ops[1], -1, &value) || value < 0
+          || value > 0xffff)
+        return Error(*s.line, "expected LDI register, 16 bit value");
+      out[0] = Ldi(rd, value);
+      return true;
+    }
+
+    if (m == "jmp" || m == "call" || m == "jal" || m == "ret") {
+      RegisterField link = kCallRegister;
+      std::string target;
+      if (m == "ret") {
+        if (!ops.empty()) return Error(*s.line, "RET has no operands");
+        out[0] = 0x20000000 | kCallRegister.Encode() << 16;
+        return true;
+      }
+      if (m == "jal") {
+        if (ops.size() != 2 || !Register(ops[0], &link))
+          return Error(*s.line, "expected JAL register, target");
+        target = ops[1];
+      } else {
+        if (ops.size() != 1) return Error(*s.line, "expected jump target");
+        target = ops[0];
+      }
+      const bool link_call = (m != "jmp");
+      const uint32_t base = link_call ? (0x22000000 | link.Encode()) : 0x20000000;
+      RegisterField reg;
+      if (Register(target, &reg)) {
+        out[0] = base | reg.Encode() << 16;
+        return true;
+      }
+      int64_t address;
+      if (!Evaluate(*s.line, target, s.scope, &address)) return false;
+      if (address < 0 || address > 0xffff)
+        return Error(*s.line, "jump target out of range");
+      out[0] = base | 1 << 24 | address << 8;
+      return true;
+    }
+    if (m == "halt") {
+      out[0] = 0x2a000000;
+      return true;
+    }
+    if (m == "lmbd") {
+      if (ops.size() != 3) return Error(*s.line, "expected three operands");
+      return Format2Op(s, 3, ops[0], ops[1], ops[2], out);
+    }
+    if (m == "zero" || m == "fill") {
+      int64_t bytes;
+      if (ops.size() != 2 || !Register(ops[0], &rd)
+          || !Evaluate(*s.line, ops[1], -1, &bytes) || bytes < 1
+          || bytes > 128 || 4 * rd.reg + rd.byte + bytes > 128)
+        return Error(*s.line, "expected ZERO/FILL &register, bytes");
+      const int device = (m == "zero") ? XFR_ZERO : XFR_FILL;
+      out[0] = 0x2e000000 | 1 << 23 | device << 15 | (bytes - 1) << 7
+        | rd.byte << 5 | rd.reg;
+      return true;
+    }
+
+    for (const auto &branch : kQuickBranches) {
+      if (m != branch.mnemonic) continue;
+      if (m == "qba") {
+        if (ops.size() != 1) return Error(*s.line, "expected branch target");
+        return Branch(s, 0x40000000 | branch.cmp << 27, ops[0], "r0", "0",
+                      out);
+      }
+      if (ops.size() != 3) return Error(*s.line, "expected three operands");
+      return Branch(s, 0x40000000 | branch.cmp << 27, ops[0], ops[1], ops[2],
+                    out);
+    }
+    if (m == "qbbc" || m == "qbbs") {
+      if (ops.size() != 3) return Error(*s.line, "expected three operands");
+      const uint32_t test = (m == "qbbc") ? 1 : 2;
+      return Branch(s, 0xc0000000 | test << 27, ops[0], ops[1], ops[2], out);
+    }
+
+    if (m == "lbco" || m == "sbco" || m == "lbbo" || m == "sbbo") {
+      if (ops.size() != 4) return Error(*s.line, "expected four operands");
+      const bool load = (m[0] == 'l');
+      uint32_t base_field;
+      if (m[2] == 'c') {
+        const std::string c = ToLower(ops[1]);
+        char *end;
+        const long entry = c[0] == 'c' ? strtol(c.c_str() + 1, &end, 10) : -1;
+        if (entry < 0 || entry > 31 || *end != '\0')
+          return Error(*s.line, "expected constant table entry c0..c31");
+        base_field = entry;
+      } else {
+        if (!Register(ops[1], &rs1) || rs1.bytes != 4)
+          return Error(*s.line, "expected base register");
+        base_field = rs1.reg;
+      }
+      return Memory(s, (m[2] == 'c' ? 0x80000000 : 0xe0000000) | load << 28,
+                    ops[0], base_field, ops[2], ops[3], out);
+    }
+    return Error(*s.line, "unsupported instruction " + m);
+  }
+
+  static uint32_t Ldi(const RegisterField &rd, uint32_t value) {
+    return 0x24000000 | value << 8 | rd.Encode();
+  }
+
+  // Second operand: register field with io = 0, or 8 bit immediate.
+  bool Op2(const Statement &s, const std::string &operand, uint32_t *io,
+           uint32_t *value) {
+    RegisterField reg;
+    if (Register(operand, &reg)) {
+      *io = 0;
+      *value = reg.Encode();
+      return true;
+    }
+    int64_t imm;
+    if (!Evaluate(*s.line, operand, -1, &imm)) return false;
+    if (imm < 0 || imm > 255)
+      return Error(*s.line, "immediate out of range 0..255: " + operand);
+    *io = 1;
+    *value = imm;
+    return true;
+  }
+
+  bool Alu(const Statement &s, int op, const std::string &dest,
+           const std::string &source, const std::string &op2, uint32_t *out) {
+    RegisterField rd, rs1;
+    uint32_t io, value;
+    if (!Register(dest, &rd) || !Register(source, &rs1))
+      return Error(*s.line, "expected registers");
+    if (!Op2(s, op2, &io, &value))
+      return false;
+    out[0] = op << 25 | io << 24 | value << 16 | rs1.Encode() << 8
+      | rd.Encode();
+    return true;
+  }
+
+  bool Format2Op(const Statement &s, int subop, const std::string &dest,
+                 const std::string &source, const std::string &op2,
+                 uint32_t *out) {
+    RegisterField rd, rs1;
+    uint32_t io, value;
+    if (!Register(dest, &rd) || !Register(source, &rs1))
+      return Error(*s.line, "expected registers");
+    if (!Op2(s, op2, &io, &value))
+      return false;
+    out[0] = 0x20000000 | subop << 25 | io << 24 | value << 16
+      | rs1.Encode() << 8 | rd.Encode();
+    return true;
+  }
+
+  bool Branch(const Statement &s, uint32_t base, const std::string &target,
+              const std::string &source, const std::string &op2,
+              uint32_t *out) {
+    RegisterField rs1;
+    uint32_t io, value;
+    int64_t address;
+    if (!Register(source, &rs1))
+      return Error(*s.line, "expected register");
+    if (!Op2(s, op2, &io, &value))
+      return false;
+    if (!Evaluate(*s.line, target, s.scope, &address))
+      return false;
+    const int64_t offset = address - s.address;
+    if (offset < -512 || offset > 511)
+      return Error(*s.line, "branch target out of range: " + target);
+    out[0] = base | ((offset >> 8) & 3) << 25 | io << 24 | value << 16
+      | rs1.Encode() << 8 | (offset & 0xff);
+    return true;
+  }
+
+  bool Memory(const Statement &s, uint32_t base, const std::string &reg,
+              uint32_t base_field, const std::string &offset,
+              const std::string &length, uint32_t *out) {
+    RegisterField rd;
+    uint32_t io, offset_value;
+    if (!Register(reg, &rd))
+      return Error(*s.line, "expected register");
+    if (!Op2(s, offset, &io, &offset_value))
+      return false;
+    int code;
+    const std::string len = ToLower(length);
+    if (len.size() == 2 && len[0] == 'b' && len[1] >= '0' && len[1] <= '3') {
+      code = 124 + (len[1] - '0');  // Length in r0.b0..b3
+    } else {
+      int64_t bytes;
+      if (!Evaluate(*s.line, length, -1, &bytes))
+        return false;
+      if (bytes < 1 || bytes > 124 || 4 * rd.reg + rd.byte + bytes > 128)
+        return Error(*s.line, "invalid length " + length);
+      code = bytes - 1;
+    }
+    out[0] = base | ((code >> 4) & 7) << 25 | io << 24 | offset_value << 16
+      | ((code >> 1) & 7) << 13 | base_field << 8 | (code & 1) << 7
+      | rd.byte << 5 | rd.reg;
+    return true;
+  }
+
+  // Registers r0..r31, parts like r1.w2 or r1.b3, and structs assigned to
+  // registers or their fields. An '&' in front is allowed.
+  bool Register(const std::string &operand, RegisterField *field) const {
+    std::string name = Trim(operand);
+    if (!name.empty() && name[0] == '&') name = Trim(name.substr(1));
+    if (name.empty()) return false;
+    const size_t dot = name.find('.');
+    const std::string base = name.substr(0, dot);
+    const std::string part = dot == std::string::npos ? "" : name.substr(dot + 1);
+
+    const auto assigned = assignments_.find(base);
+    if (assigned != assignments_.end()) {
+      const StructType &type = structs_.find(assigned->second.type)->second;
+      int start = assigned->second.start_byte, size = 4;
+      if (!part.empty()) {
+        const StructField *f = type.Field(part);
+        if (f == NULL) return false;
+        start += f->offset;
+        size = f->size;
+      }
+      if (start % size != 0) return false;
+      field->reg = start / 4;
+      field->byte = start % 4;
+      field->bytes = size;
+      return true;
+    }
+
+    const std::string lower = ToLower(base);
+    if (lower.size() < 2 || lower[0] != 'r') return false;
+    char *end;
+    const long reg = strtol(lower.c_str() + 1, &end, 10);
+    if (*end != '\0' || !isdigit(lower[1]) || reg > 31) return false;
+    field->reg = reg;
+    field->byte = 0;
+    field->bytes = 4;
+    if (part.empty()) return true;
+    const std::string p = ToLower(part);
+    if (p.size() != 2) return false;
+    if (p[0] == 'b' && p[1] >= '0' && p[1] <= '3') {
+      field->byte = p[1] - '0';
+      field->bytes = 1;
+      return true;
+    }
+    if (p[0] == 'w' && p[1] >= '0' && p[1] <= '2') {
+      field->byte = p[1] - '0';
+      field->bytes = 2;
+      return true;
+    }
+    return false;
+  }
+
+  // Constant expressions in C syntax. Labels are only known in "scope",
+  // if it is not -1.
+  bool Evaluate(const SourceLine &line, const std::string &expression,
+                int scope, int64_t *value) {
+    ExpressionParser parser(this, expression, scope);
+    if (!parser.Parse(value))
+      return Error(line, parser.error() + " in '" + expression + "'");
+    return true;
+  }
+
+  bool LookupLabel(const std::string &name, int scope, int64_t *value) const {
+    for (int s = scope; s >= 0; s = scopes_[s].parent) {
+      const auto found = scopes_[s].labels.find(name);
+      if (found != scopes_[s].labels.end()) {
+        *value = found->second;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  class ExpressionParser {
+  public:
+    ExpressionParser(const Assembly *assembly, const std::string &text,
+                     int scope)
+      : assembly_(assembly), text_(text), pos_(0), scope_(scope) {}
+
+    bool Parse(int64_t *value) {
+      if (!Binary(0, value)) return false;
+      SkipSpace();
+      if (pos_ != text_.size()) return Fail("unexpected characters");
+      return true;
+    }
+
+    const std::string &error() const { return error_; }
+
+  private:
+    // Binary operators by increasing precedence, as in C.
+    bool Binary(int level, int64_t *value) {
+      static const std::vector<std::vector<std::string> > kLevels = {
+        { "|" }, { "^" }, { "&" }, { "<<", ">>" }, { "+", "-" },
+        { "*", "/", "%" },
+      };
+      if (level == (int)kLevels.size()) return Unary(value);
+      if (!Binary(level + 1, value)) return false;
+      for (;;) {
+        SkipSpace();
+        std::string op;
+        for (const std::string &candidate : kLevels[level]) {
+          if (text_.compare(pos_, candidate.size(), candidate) != 0) continue;
+          // Don't take '<' of '<<' as operator of its own and so on.
+          if (candidate.size() == 1 && pos_ + 1 < text_.size()
+              && (text_[pos_+1] == '<' || text_[pos_+1] == '>'
+                  || (candidate == "&" && text_[pos_+1] == '&')
+                  || (candidate == "|" && text_[pos_+1] == '|')))
+            continue;
+          op = candidate;
+        }
+        if (op.empty()) return true;
+        pos_ += op.size();
+        int64_t rhs;
+        if (!Binary(level + 1, &rhs)) return false;
+        if (op == "|") *value |= rhs;
+        else if (op == "^") *value ^= rhs;
+        else if (op == "&") *value &= rhs;
+        else if (op == "<<") *value <<= rhs;
+        else if (op == ">>") *value >>= rhs;
+        else if (op == "+") *value += rhs;
+        else if (op == "-") *value -= rhs;
+        else if (op == "*") *value *= rhs;
+        else if (rhs == 0) return Fail("division by zero");
+        else if (op == "/") *value /= rhs;
+        else *value %= rhs;
+      }
+    }
+
+    bool Unary(int64_t *value) {
+      SkipSpace();
+      if (pos_ < text_.size() && (text_[pos_] == '-' || text_[pos_] == '~'
+                                  || text_[pos_] == '+')) {
+        const char op = text_[pos_++];
+        if (!Unary(value)) return false;
+        if (op == '-') *value = -*value;
+        if (op == '~') *value = ~*value;
+        return true;
+      }
+      return Primary(value);
+    }
+
+    bool Primary(int64_t *value) {
+      SkipSpace();
+      if (pos_ >= text_.size()) return Fail("expression expected");
+      if (text_[pos_] == '(') {
+        ++pos_;
+        if (!Binary(0, value)) return false;
+        SkipSpace();
+        if (pos_ >= text_.size() || text_[pos_] != ')')
+          return Fail("missing )");
+        ++pos_;
+        return true;
+      }
+      if (isdigit(text_[pos_])) {
+        const char *start = text_.c_str() + pos_;
+        char *end;
+        *value = strtoll(start, &end, 0);
+        pos_ += end - start;
+        if (pos_ < text_.size() && IsIdentifierChar(text_[pos_]))
+          return Fail("invalid number");
+        return true;
+      }
+      if (!IsIdentifierStart(text_[pos_])) return Fail("expression expected");
+      const std::string name = Name();
+      SkipSpace();
+      if ((name == "SIZE" || name == "OFFSET") && pos_ < text_.size()
+          && text_[pos_] == '(') {
+        ++pos_;
+        SkipSpace();
+        const std::string argument = Name();
+        SkipSpace();
+        if (pos_ >= text_.size() || text_[pos_] != ')')
+          return Fail("missing )");
+        ++pos_;
+        return name == "SIZE" ? Size(argument, value)
+                              : Offset(argument, value);
+      }
+      if (scope_ >= 0 && assembly_->LookupLabel(name, scope_, value))
+        return true;
+      return Fail("unknown symbol " + name);
+    }
+
+    // Identifier, possibly with a struct field.
+    std::string Name() {
+      const size_t start = pos_;
+      while (pos_ < text_.size()
+             && (IsIdentifierChar(text_[pos_]) || text_[pos_] == '.'))
+        ++pos_;
+      return text_.substr(start, pos_ - start);
+    }
+
+    // Struct types or the name they are assigned to.
+    const StructType *FindStruct(const std::string &name) {
+      const auto type = assembly_->structs_.find(name);
+      if (type != assembly_->structs_.end()) return &type->second;
+      const auto assigned = assembly_->assignments_.find(name);
+      if (assigned != assembly_->assignments_.end())
+        return &assembly_->structs_.find(assigned->second.type)->second;
+      return NULL;
+    }
+
+    bool Size(const std::string &name, int64_t *value) {
+      const size_t dot = name.find('.');
+      const StructType *type = FindStruct(name.substr(0, dot));
+      if (type == NULL) return Fail("unknown struct " + name);
+      if (dot == std::string::npos) {
+        *value = type->size;
+        return true;
+      }
+      const StructField *field = type->Field(name.substr(dot + 1));
+      if (field == NULL) return Fail("unknown field " + name);
+      *value = field->size;
+      return true;
+    }
+
+    bool Offset(const std::string &name, int64_t *value) {
+      const size_t dot = name.find('.');
+      const StructType *type = FindStruct(name.substr(0, dot));
+      if (type == NULL || dot == std::string::npos)
+        return Fail("expected struct.field: " + name);
+      const StructField *field = type->Field(name.substr(dot + 1));
+      if (field == NULL) return Fail("unknown field " + name);
+      *value = field->offset;
+      return true;
+    }
+
+    void SkipSpace() {
+      while (pos_ < text_.size() && isspace(text_[pos_])) ++pos_;
+    }
+
+    bool Fail(const std::string &msg) {
+      error_ = msg;
+      return false;
+    }
+
+    const Assembly *const assembly_;
+    const std::string text_;
+    size_t pos_;
+    const int scope_;
+    std::string error_;
+  };
+
+  bool Error(const SourceLine &line, const std::string &msg) const {
+    Log_error("%s:%d: %s", line.file.c_str(), line.line_no, msg.c_str());
+    return false;
+  }
+
+  const std::vector<SourceLine> &lines_;
+  uint32_t address_;
+  std::string current_struct_;
+  std::map<std::string, StructType> structs_;
+  std::map<std::string, Assignment> assignments_;
+  std::map<std::string, Macro> macros_;
+  std::vector<Scope> scopes_;
+  std::vector<Statement> statements_;
+  std::list<std::vector<SourceLine> > expansions_;
+};
+}  // namespace
+
+PruAssembler::PruAssembler() {}
+
+void PruAssembler::AddIncludeDir(const std::string &dir) {
+  include_dirs_.push_back(dir);
+}
+
+void PruAssembler::Define(const std::string &name, const std::string &value) {
+  defines_[name] = value;
+}
+
+bool PruAssembler::AssembleFile(const std::string &filename) {
+  program_.clear();
+  labels_.clear();
+  std::vector<SourceLine> lines;
+  Preprocessor preprocessor(include_dirs_, defines_);
+  if (!preprocessor.ReadFile(filename, &lines))
+    return false;
+  Assembly assembly(lines);
+  return assembly.Assemble(&program_, &labels_);
+}
+
+int PruAssembler::LabelAddress(const std::string &label) const {
+  const auto found = labels_.find(label);
+  return found == labels_.end() ? -1 : found->second;
+}
@@ -0,0 +1,69 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BEAGLEG_PRU_ASSEMBLER_H
+#define BEAGLEG_PRU_ASSEMBLER_H
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Assembler for our PRU programs, so that the tests can run the actual
+// firmware in the PruEmulator on any host; pasm is only available with the
+// am335x PRU package.
+//
+// Understands the part of the pasm language the firmware uses:
+//  - The preprocessor: #include "file" and <file>, #define of simple
+//    values, #undef, #ifdef/#ifndef/#else/#endif.
+//  - .origin, .entrypoint, .struct/.ends with .u8/.u16/.u32 fields,
+//    .assign of structs to registers, .macro/.mparam/.endm. Labels defined
+//    in a macro are local to each of its expansions.
+//  - The instructions the PruEmulator executes, with pasm's
+//    pseudo-instructions MOV, CALL, RET, ZERO and FILL. Operands can be
+//    constant expressions with SIZE() and OFFSET().
+// The instructions are encoded as pasm -V3 does (see pru-emulator.cc).
+class PruAssembler {
+public:
+  PruAssembler();
+
+  // Like pasm -I<dir>, directory to look for #include files.
+  void AddIncludeDir(const std::string &dir);
+
+  // Like pasm -D<name>=<value>.
+  void Define(const std::string &name, const std::string &value = "1");
+
+  // Assemble the program in "filename". Returns 'false' and logs the
+  // reason if it can't be assembled.
+  bool AssembleFile(const std::string &filename);
+
+  // The assembled program, from address 0.
+  const std::vector<uint32_t> &program() const { return program_; }
+
+  // Address of the global "label" in instruction words, -1 if not defined.
+  int LabelAddress(const std::string &label) const;
+
+private:
+  std::vector<std::string> include_dirs_;
+  std::map<std::string, std::string> defines_;
+  std::vector<uint32_t> program_;
+  std::map<std::string, uint32_t> labels_;
+};
+
+#endif  // BEAGLEG_PRU_ASSEMBLER_H
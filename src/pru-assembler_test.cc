@@ -0,0 +1,210 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the PRU assembler, checked against the encodings of pasm and
+ * by running the result in the emulator.
+ */
+#include "pru-assembler.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "pru-emulator.h"
+
+namespace {
+// Directory with source files that is removed at the end.
+class SourceDir {
+public:
+  SourceDir() {
+    char tmpl[] = "/tmp/pru-assembler-test.XXXXXX";
+    dir_ = mkdtemp(tmpl);
+  }
+  ~SourceDir() {
+    const std::string cmd = "rm -rf " + dir_;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "Can't remove %s\n", cmd.c_str());
+  }
+
+  std::string Add(const std::string &name, const std::string &content) {
+    const std::string path = dir_ + "/" + name;
+    FILE *f = fopen(path.c_str(), "w");
+    fwrite(content.data(), 1, content.size(), f);
+    fclose(f);
+    return path;
+  }
+
+  const std::string &dir() const { return dir_; }
+
+private:
+  std::string dir_;
+};
+
+std::vector<uint32_t> Assemble(const std::string &source) {
+  SourceDir dir;
+  PruAssembler assembler;
+  if (!assembler.AssembleFile(dir.Add("test.p", source)))
+    return {};
+  return assembler.program();
+}
+}  // namespace
+
+// Instruction words as generated by pasm -V3.
+TEST(PruAssembler, KnownEncodings) {
+  const std::vector<uint32_t> program = Assemble(
+    "\tLBCO r0, C4, 4, 4\n"
+    "\tCLR r0, r0, 4\n"
+    "\tSBCO r0, C4, 4, 4\n"
+    "\tMOV r2, 76\n"
+    "\tCALL 7\n"
+    "\tHALT\n"
+    "\tRET\n");
+  const std::vector<uint32_t> expected = {
+    0x91042480, 0x1d04e0e0, 0x81042480, 0x24004ce2,
+    0x2300079e, 0x2a000000, 0x209e0000,
+  };
+  EXPECT_EQ(expected, program);
+}
+
+TEST(PruAssembler, MoveOfLargeImmediateNeedsTwoInstructions) {
+  const std::vector<uint32_t> program = Assemble(
+    "\tMOV r1, 0x12345678\n"
+    "\tMOV r2.w2, 0xffff\n"
+    "\tMOV r3, r1.w2\n"
+    "\tHALT\n");
+  ASSERT_EQ(5u, program.size());
+  PruEmulator pru(program.data(), program.size());
+  EXPECT_EQ(PruEmulator::StopReason::HALT, pru.Run(100));
+  EXPECT_EQ(0x12345678u, pru.reg(1));
+  EXPECT_EQ(0xffff0000u, pru.reg(2));
+  EXPECT_EQ(0x1234u, pru.reg(3));
+}
+
+TEST(PruAssembler, StructsAssignedToRegisters) {
+  const std::vector<uint32_t> program = Assemble(
+    ".struct Header\n"
+    "\t.u8 state\n"
+    "\t.u8 flags\n"
+    "\t.u16 count\n"
+    "\t.u32 value\n"
+    ".ends\n"
+    ".assign Header, r4, r5, header\n"
+    "\tMOV header.state, SIZE(Header)\n"
+    "\tMOV header.count, OFFSET(Header.value) * 100\n"
+    "\tFILL &header.value, SIZE(header.value)\n"
+    "\tZERO &r6, 8\n"
+    "\tHALT\n");
+  PruEmulator pru(program.data(), program.size());
+  pru.set_reg(6, 1);
+  pru.set_reg(7, 2);
+  EXPECT_EQ(PruEmulator::StopReason::HALT, pru.Run(100));
+  EXPECT_EQ(400u << 16 | 8, pru.reg(4));
+  EXPECT_EQ(0xffffffffu, pru.reg(5));
+  EXPECT_EQ(0u, pru.reg(6));
+  EXPECT_EQ(0u, pru.reg(7));
+}
+
+TEST(PruAssembler, MacroLabelsAreLocalToEachExpansion) {
+  const std::vector<uint32_t> program = Assemble(
+    ";; Count bits of 'value' into 'count'.\n"
+    ".macro CountBit\n"
+    ".mparam value, bit, count\n"
+    "\tQBBC skip, value, bit   // Label in each expansion\n"
+    "\tADD count, count, 1\n"
+    "skip:\n"
+    ".endm\n"
+    ".macro CountThree\n"
+    ".mparam value\n"
+    "\tCountBit value, 0, r2\n"
+    "\tCountBit value, 1, r2\n"
+    "\tCountBit value, 2, r2\n"
+    "\tQBA done\n"
+    ".endm\n"
+    "start:  CountThree r1\n"
+    "done: halt\n");
+  ASSERT_FALSE(program.empty());
+  PruEmulator pru(program.data(), program.size());
+  pru.set_reg(1, 5);
+  EXPECT_EQ(PruEmulator::StopReason::HALT, pru.Run(100));
+  EXPECT_EQ(2u, pru.reg(2));
+}
+
+TEST(PruAssembler, PreprocessorAndExpressions) {
+  SourceDir dir;
+  dir.Add("values.h",
+          "// Included from the directory of the including file.\n"
+          "#define BASE 0x4804c000\n"
+          "#define PIN_VALUE (BASE | 17)\n"
+          "#ifndef HAVE_OPTION\n"
+          "#define OPTION_VALUE 1\n"
+          "#else\n"
+          "#define OPTION_VALUE 2\n"
+          "#endif\n");
+  const std::string file = dir.Add(
+    "test.p",
+    "#include \"values.h\"\n"
+    "\tMOV r1, (PIN_VALUE & 0xfffff000) + 0x138\n"
+    "\tMOV r2, 1 << (PIN_VALUE & 0x1f)\n"
+    "\tMOV r3, OPTION_VALUE * ~-2 - 17 % 5\n"
+    "\tMOV r4, VALUE_FROM_COMMAND_LINE\n"
+    "\tHALT\n");
+  PruAssembler assembler;
+  assembler.Define("HAVE_OPTION");
+  assembler.Define("VALUE_FROM_COMMAND_LINE", "(3 + 4)");
+  ASSERT_TRUE(assembler.AssembleFile(file));
+  const std::vector<uint32_t> &program = assembler.program();
+  PruEmulator pru(program.data(), program.size());
+  EXPECT_EQ(PruEmulator::StopReason::HALT, pru.Run(100));
+  EXPECT_EQ(0x4804c138u, pru.reg(1));
+  EXPECT_EQ(1u << 17, pru.reg(2));
+  EXPECT_EQ(2u * 1 - 2, pru.reg(3));
+  EXPECT_EQ(7u, pru.reg(4));
+}
+
+TEST(PruAssembler, LabelAddresses) {
+  SourceDir dir;
+  PruAssembler assembler;
+  ASSERT_TRUE(assembler.AssembleFile(dir.Add(
+    "test.p",
+    ".origin 0\n"
+    ".entrypoint START\n"
+    "START:\n"
+    "\tMOV r1, 0x10000\n"
+    "LOOP:\tSUB r1, r1, 1\n"
+    "\tQBNE LOOP, r1, 0\n"
+    "\tHALT\n")));
+  EXPECT_EQ(0, assembler.LabelAddress("START"));
+  EXPECT_EQ(2, assembler.LabelAddress("LOOP"));
+  EXPECT_EQ(-1, assembler.LabelAddress("loop"));
+  const std::vector<uint32_t> &program = assembler.program();
+  PruEmulator pru(program.data(), program.size());
+  EXPECT_EQ(PruEmulator::StopReason::HALT, pru.Run(1000000));
+  EXPECT_EQ(2 + 2 * 0x10000 + 1u, pru.cycles());
+}
+
+TEST(PruAssembler, Errors) {
+  EXPECT_TRUE(Assemble("\tQBA nowhere\n").empty());
+  EXPECT_TRUE(Assemble("\tADD r1, r1, 256\n").empty());  // Immediate too big
+  EXPECT_TRUE(Assemble("\tMOV r1.b0, 0x1234\n").empty());
+  EXPECT_TRUE(Assemble("\tLBCO r30, C24, 0, 12\n").empty());  // Beyond r31
+  EXPECT_TRUE(Assemble("\tFOO r1\n").empty());
+  EXPECT_TRUE(Assemble("x:\nx:\n\tHALT\n").empty());
+  EXPECT_TRUE(Assemble("#ifdef X\n\tHALT\n").empty());
+
+  // Branches reach 511 instructions ahead.
+  std::string far = "\tQBA target\n";
+  for (int i = 0; i < 510; ++i) far += "\tADD r1, r1, 1\n";
+  EXPECT_FALSE(Assemble(far + "target: HALT\n").empty());
+  far += "\tADD r1, r1, 1\n";
+  EXPECT_TRUE(Assemble(far + "target: HALT\n").empty());
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/stderr");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
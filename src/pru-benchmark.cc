@@ -0,0 +1,257 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cycle count of the PRU firmware: runs the assembled motor-interface-pru
+// in the PruEmulator with a few typical segments and reports the cycles
+// of each loop per phase of the motion profile, compared to the delay the
+// host asked for. Changes in the firmware that break the timing, or make
+// the loop more expensive, show up here without the need of a BeagleBone
+// and an oscilloscope.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "common/logging.h"
+#include "hardware-mapping.h"
+#include "motion-queue.h"
+#include "motor-interface-constants.h"
+#include "pru-emulator.h"
+
+// Generated PRU code from motor-interface-pru.p
+#include "motor-interface-pru_bin.h"
+
+#ifdef DUAL_PRU
+// ... and for the other PRU from motor-interface-pru1.p. Same array name.
+namespace pru1 {
+#include "motor-interface-pru1_bin.h"
+}
+#endif
+
+namespace {
+enum Phase { ACCEL, TRAVEL, DECEL, NUM_PHASES };
+const char *const kPhaseName[NUM_PHASES] = { "accel", "travel", "decel" };
+
+struct Scenario {
+  const char *name;
+  MotionSegment segment;
+  uint32_t watch_input;   // gpio_def to watch (that never triggers), or 0.
+};
+
+struct PhaseStats {
+  PhaseStats() : loops(0), cycles(0), nominal(0), min(0), max(0) {}
+  void Add(uint64_t loop_cycles, uint64_t nominal_cycles) {
+    if (loops == 0 || loop_cycles < min) min = loop_cycles;
+    if (loop_cycles > max) max = loop_cycles;
+    ++loops;
+    cycles += loop_cycles;
+    nominal += nominal_cycles;
+  }
+  uint64_t loops;
+  uint64_t cycles;
+  uint64_t nominal;   // Sum of the delays asked for.
+  uint64_t min, max;
+};
+
+// A status update the PRU writes in each loop.
+struct StatusUpdate {
+  uint64_t cycle;
+  uint32_t loops_left;
+};
+
+MotionSegment LinearSegment(int motors, int loops, uint32_t delay) {
+  MotionSegment segment = {};
+  segment.state = STATE_FILLED;
+  segment.motor_mask = (1 << motors) - 1;
+  segment.loops_accel = segment.loops_travel = segment.loops_decel = loops;
+  segment.accel_series_index = 0;
+  segment.hires_accel_cycles = (8 * delay) << DELAY_CYCLE_SHIFT;
+  segment.travel_delay_cycles = delay;
+  for (int i = 0; i < motors; ++i) {
+    segment.fractions[i] = 0x7fffffff >> i;
+  }
+  return segment;
+}
+
+// The delay of each loop as calculated by the PRU, before it subtracts
+// the cycles it spends itself. In units of TIMER_FREQUENCY.
+std::vector<uint32_t> RequestedDelays(const MotionSegment &s) {
+  std::vector<uint32_t> result;
+  uint32_t hires = s.hires_accel_cycles;
+  uint32_t index = s.accel_series_index;
+  uint32_t remainder = 0;
+  for (uint32_t i = 0; i < s.loops_accel; ++i) {
+    if (index != 0) {
+      const uint32_t divident = (hires << 1) + remainder;
+      const uint32_t divisor = (index << 2) + 1;
+      remainder = divident % divisor;
+      hires -= divident / divisor;
+    }
+    ++index;
+    result.push_back(hires >> DELAY_CYCLE_SHIFT);
+  }
+  for (uint32_t i = 0; i < s.loops_travel; ++i) {
+    result.push_back(s.travel_delay_cycles);
+  }
+  for (uint32_t i = 0; i < s.loops_decel; ++i) {
+    const uint32_t divident = (hires << 1) + remainder;
+    const uint32_t divisor = (index << 2) - 1;
+    remainder = divident % divisor;
+    hires += divident / divisor;
+    --index;
+    result.push_back(hires >> DELAY_CYCLE_SHIFT);
+  }
+  return result;
+}
+
+Phase PhaseOfLoop(const MotionSegment &s, uint32_t loop) {
+  if (loop < s.loops_accel) return ACCEL;
+  if (loop < s.loops_accel + s.loops_travel) return TRAVEL;
+  return DECEL;
+}
+
+// Between the status updates of two loops, there is the delay of the first
+// and the calculation of the second. Attribute that to the first.
+void CollectStats(const MotionSegment &s,
+                  const std::vector<StatusUpdate> &updates,
+                  PhaseStats stats[NUM_PHASES]) {
+  const std::vector<uint32_t> delays = RequestedDelays(s);
+  const uint32_t total = delays.size();
+  for (size_t i = 1; i < updates.size(); ++i) {
+    const int loop = total - updates[i].loops_left - 2;
+    if (loop < 0 || loop >= (int)total ||
+        updates[i].loops_left + 1 != updates[i-1].loops_left)
+      continue;  // Segment start or one that stopped early.
+    stats[PhaseOfLoop(s, loop)].Add(updates[i].cycle - updates[i-1].cycle,
+                                    2 * delays[loop]);
+  }
+}
+
+int usage(const char *prog) {
+  fprintf(stderr, "Usage: %s [options]\n"
+          "Options:\n"
+          "\t-l <loops>  : Loops in each phase (Default: 1000)\n"
+          "\t-d <delay>  : Travel delay; in units of %d Hz (Default: 2000)\n",
+          prog, TIMER_FREQUENCY);
+  return 1;
+}
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int loops = 1000;
+  uint32_t delay = 2000;
+  int opt;
+  while ((opt = getopt(argc, argv, "l:d:")) != -1) {
+    switch (opt) {
+    case 'l':
+      loops = atoi(optarg);
+      if (loops < 2 || 3 * loops > MOTION_MAX_LOOPS_PER_SEGMENT)
+        return usage(argv[0]);
+      break;
+    case 'd':
+      delay = atoi(optarg);
+      if (delay < 100) return usage(argv[0]);
+      break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+
+  Log_init("/dev/stderr");
+
+  std::vector<Scenario> scenarios;
+  scenarios.push_back({ "1 motor", LinearSegment(1, loops, delay), 0 });
+  scenarios.push_back({ "4 motors", LinearSegment(4, loops, delay), 0 });
+  scenarios.push_back({ "8 motors", LinearSegment(8, loops, delay), 0 });
+
+  Scenario arc = { "arc", LinearSegment(2, loops, delay), 0 };
+  arc.segment.arc_rise_mask = 0x01;
+  arc.segment.arc_fall_mask = 0x02;
+  arc.segment.arc_shift = 12;
+  arc.segment.fractions[1] = arc.segment.fractions[0];
+  scenarios.push_back(arc);
+
+  Scenario raster = { "raster", LinearSegment(2, loops, delay), 0 };
+  raster.segment.raster = 1;
+  raster.segment.fractions[0] = raster.segment.fractions[1] = 0x2aaaaaaa;
+  raster.segment.fractions[6] = 0x08000000;  // 16 loops per pixel.
+  raster.segment.fractions[7] = 0x0001;
+  scenarios.push_back(raster);
+
+  Scenario input = { "stop on input", LinearSegment(4, loops, delay),
+                     GPIO_1_BASE | 17 };
+  input.segment.stop_on_input = 1;
+  scenarios.push_back(input);
+
+#ifdef DUAL_PRU
+  EmulatedPruInterface pru(PRUcode, sizeof(PRUcode) / sizeof(PRUcode[0]),
+                           pru1::PRUcode,
+                           sizeof(pru1::PRUcode) / sizeof(pru1::PRUcode[0]));
+#else
+  EmulatedPruInterface pru(PRUcode, sizeof(PRUcode) / sizeof(PRUcode[0]));
+#endif
+  PruEmulator *const emulator = pru.emulator();
+  std::vector<StatusUpdate> updates;
+  emulator->SetStoreObserver([&](uint32_t address, int bytes) {
+      if (address != 0 || bytes != 4) return;
+      uint32_t status;
+      memcpy(&status, emulator->data_ram(), sizeof(status));
+      updates.push_back({ emulator->cycles(), status & 0xffffff });
+    });
+
+  HardwareMapping hardware;  // Unconfigured: nothing to switch.
+  PRUMotionQueue motion_queue(&hardware, &pru);
+
+  printf("%-14s %-6s %6s %12s %8s %8s %9s %9s\n", "segment", "phase",
+         "loops", "cycles/loop", "min", "max", "nominal", "overhead");
+  for (const Scenario &scenario : scenarios) {
+    if (scenario.watch_input)
+      motion_queue.WatchInput(scenario.watch_input, true);
+    updates.clear();
+    const uint64_t bus_writes_before = emulator->bus_writes();
+    MotionSegment segment = scenario.segment;
+    motion_queue.Enqueue(&segment);
+    motion_queue.WaitQueueEmpty();
+    if (scenario.watch_input)
+      motion_queue.WatchInput(0, false);
+
+    PhaseStats stats[NUM_PHASES];
+    CollectStats(scenario.segment, updates, stats);
+    for (int p = 0; p < NUM_PHASES; ++p) {
+      const PhaseStats &s = stats[p];
+      if (s.loops == 0) continue;
+      printf("%-14s %-6s %6llu %12.1f %8llu %8llu %9.1f %+9.1f\n",
+             scenario.name, kPhaseName[p], (unsigned long long)s.loops,
+             1.0 * s.cycles / s.loops, (unsigned long long)s.min,
+             (unsigned long long)s.max, 1.0 * s.nominal / s.loops,
+             (1.0 * s.cycles - s.nominal) / s.loops);
+    }
+    printf("%-14s %-6s %6s %12.1f (GPIO writes/loop)\n", scenario.name,
+           "", "", 1.0 * (emulator->bus_writes() - bus_writes_before)
+           / (3 * loops));
+  }
+  motion_queue.Shutdown(true);
+
+  printf("Cycles total: %llu\n", (unsigned long long)emulator->cycles());
+  return 0;
+}
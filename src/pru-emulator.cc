@@ -0,0 +1,468 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pru-emulator.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "common/logging.h"
+
+// Instruction encoding of the PRU (V3 core, as generated by pasm -V3).
+// Register fields are 8 bit: bit 7..5 select the part of the register
+// (0..3: byte 0..3, 4..6: half word at byte 0..2, 7: all 32 bit), bit 4..0
+// are the register number.
+//
+//  Arithmetic/logic  000 aluop:4 io:1 op2:8        rs1:8 rd:8
+//  Format 2          001 subop:4 io:1 op2/imm16...       rd:8
+//  Quick branch      01 cmp:3 broff[9:8]:2 io:1 op2:8 rs1:8 broff[7:0]:8
+//  LBCO/SBCO         100 load:1 len[6:4]:3 io:1 offset:8 len[3:1]:3 c:5
+//                        len[0]:1 rd_byte:2 rd:5
+//  Bit test branch   110 test:2 broff[9:8]:2 io:1 bit:8 rs1:8 broff[7:0]:8
+//  LBBO/SBBO         like LBCO, with the base register instead of c.
+//
+// The second operand "op2" is an 8 bit immediate if io is set, otherwise a
+// register field.
+namespace {
+enum AluOp {
+  ALU_ADD, ALU_ADC, ALU_SUB, ALU_SUC, ALU_LSL, ALU_LSR, ALU_RSB, ALU_RSC,
+  ALU_AND, ALU_OR, ALU_XOR, ALU_NOT, ALU_MIN, ALU_MAX, ALU_CLR, ALU_SET,
+};
+enum Format2Op {
+  F2_JMP = 0, F2_JAL = 1, F2_LDI = 2, F2_LMBD = 3, F2_HALT = 5, F2_XFR = 7,
+};
+// Broadside devices pasm uses to implement ZERO and FILL.
+enum { XFR_FILL = 254, XFR_ZERO = 255 };
+
+// Fixed entries of the constant table we use; the others are
+// programmable and not needed by the firmware.
+bool ConstantTableEntry(int c, uint32_t *address) {
+  switch (c) {
+  case 4:  *address = 0x00026000; return true;  // PRU-ICSS configuration
+  case 24: *address = 0x00000000; return true;  // Own data RAM
+  case 25: *address = 0x00002000; return true;  // Other PRU's data RAM
+  }
+  return false;
+}
+
+inline uint32_t Bits(uint32_t value, int lsb, int count) {
+  return (value >> lsb) & ((1u << count) - 1);
+}
+
+// Signed branch offset in instruction words.
+inline int32_t BranchOffset(uint32_t instruction) {
+  const int32_t offset = Bits(instruction, 25, 2) << 8 | Bits(instruction, 0, 8);
+  return offset >= 512 ? offset - 1024 : offset;
+}
+}  // namespace
+
+PruEmulator::PruEmulator(const uint32_t *program, size_t words,
+                         const Timing &timing)
+  : program_(program, program + words), timing_(timing),
+    cycles_(0), bus_writes_(0) {
+  bzero(data_ram_, sizeof(data_ram_));
+  Reset();
+}
+
+void PruEmulator::Reset() {
+  bzero(regs_, sizeof(regs_));
+  pc_ = 0;
+  carry_ = false;
+}
+
+uint32_t PruEmulator::bus_read(uint32_t address) const {
+  std::map<uint32_t, uint32_t>::const_iterator found = bus_.find(address);
+  return found == bus_.end() ? 0 : found->second;
+}
+
+int PruEmulator::FieldBits(uint8_t field) {
+  const int sel = field >> 5;
+  return sel < 4 ? 8 : (sel < 7 ? 16 : 32);
+}
+
+uint32_t PruEmulator::ReadField(uint8_t field) const {
+  const int sel = field >> 5;
+  const uint32_t value = regs_[field & 0x1f];
+  if (sel == 7) return value;
+  const int shift = 8 * (sel < 4 ? sel : sel - 4);
+  return (value >> shift) & (sel < 4 ? 0xff : 0xffff);
+}
+
+void PruEmulator::WriteField(uint8_t field, uint32_t value) {
+  const int sel = field >> 5;
+  uint32_t *reg = &regs_[field & 0x1f];
+  if (sel == 7) {
+    *reg = value;
+  } else {
+    const int shift = 8 * (sel < 4 ? sel : sel - 4);
+    const uint32_t mask = (sel < 4 ? 0xff : 0xffff) << shift;
+    *reg = (*reg & ~mask) | ((value << shift) & mask);
+  }
+}
+
+uint8_t PruEmulator::LoadByte(uint32_t address) const {
+  if (address < DATA_RAM_SIZE)
+    return data_ram_[address];
+  return bus_read(address & ~3u) >> (8 * (address & 3));
+}
+
+uint8_t *PruEmulator::LocalMemory(uint32_t address, int bytes) {
+  if (address + bytes <= DATA_RAM_SIZE)
+    return data_ram_ + address;
+  for (const MappedMemory &m : mapped_) {
+    if (address >= m.address && address + bytes <= m.address + m.size)
+      return m.memory + (address - m.address);
+  }
+  return NULL;
+}
+
+void PruEmulator::MapMemory(uint32_t address, uint8_t *memory, size_t size) {
+  mapped_.push_back({address, memory, size});
+}
+
+void PruEmulator::StoreByte(uint32_t address, uint8_t value) {
+  if (address < DATA_RAM_SIZE) {
+    data_ram_[address] = value;
+  } else {
+    const int shift = 8 * (address & 3);
+    uint32_t *word = &bus_[address & ~3u];
+    *word = (*word & ~(0xffu << shift)) | (uint32_t) value << shift;
+  }
+}
+
+bool PruEmulator::ExecuteAlu(uint32_t instruction) {
+  const uint32_t op2 = Bits(instruction, 24, 1)
+    ? Bits(instruction, 16, 8)
+    : ReadField(Bits(instruction, 16, 8));
+  const uint32_t a = ReadField(Bits(instruction, 8, 8));
+  const uint8_t rd = Bits(instruction, 0, 8);
+  const int bits = FieldBits(rd);
+  uint64_t result = 0;
+  switch (Bits(instruction, 25, 4)) {
+  case ALU_ADD: result = (uint64_t)a + op2; break;
+  case ALU_ADC: result = (uint64_t)a + op2 + carry_; break;
+  case ALU_SUB: result = (uint64_t)a - op2; break;
+  case ALU_SUC: result = (uint64_t)a - op2 - carry_; break;
+  case ALU_RSB: result = (uint64_t)op2 - a; break;
+  case ALU_RSC: result = (uint64_t)op2 - a - carry_; break;
+  case ALU_LSL: result = (uint64_t)a << (op2 & 0x1f); break;
+  case ALU_LSR: result = a >> (op2 & 0x1f); break;
+  case ALU_AND: result = a & op2; break;
+  case ALU_OR:  result = a | op2; break;
+  case ALU_XOR: result = a ^ op2; break;
+  case ALU_NOT: result = ~a; break;
+  case ALU_MIN: result = a < op2 ? a : op2; break;
+  case ALU_MAX: result = a > op2 ? a : op2; break;
+  case ALU_CLR: result = a & ~(1u << (op2 & 0x1f)); break;
+  case ALU_SET: result = a | (1u << (op2 & 0x1f)); break;
+  }
+  switch (Bits(instruction, 25, 4)) {
+  case ALU_ADD: case ALU_ADC:
+    carry_ = (result >> bits) & 1;
+    break;
+  case ALU_SUB: case ALU_SUC: case ALU_RSB: case ALU_RSC:
+    carry_ = (result >> 63) & 1;  // Borrow.
+    break;
+  }
+  WriteField(rd, result);
+  ++pc_;
+  return true;
+}
+
+bool PruEmulator::ExecuteXfr(uint32_t instruction) {
+  const int device = Bits(instruction, 15, 8);
+  if (Bits(instruction, 23, 2) != 1 || (device != XFR_ZERO &&
+                                        device != XFR_FILL)) {
+    Log_error("PRU emulator: unsupported XFR 0x%08x at %u",
+              instruction, pc_);
+    return false;
+  }
+  const int start = 4 * Bits(instruction, 0, 5) + Bits(instruction, 5, 2);
+  const int bytes = Bits(instruction, 7, 7) + 1;
+  if (start + bytes > 4 * 32) {
+    Log_error("PRU emulator: XFR beyond r31 at %u", pc_);
+    return false;
+  }
+  memset((uint8_t*)regs_ + start, device == XFR_FILL ? 0xff : 0x00, bytes);
+  ++pc_;
+  return true;
+}
+
+bool PruEmulator::ExecuteFormat2(uint32_t instruction, StopReason *stop) {
+  const bool immediate = Bits(instruction, 24, 1);
+  switch (Bits(instruction, 25, 4)) {
+  case F2_JMP:
+  case F2_JAL: {
+    const uint32_t target = immediate
+      ? Bits(instruction, 8, 16)
+      : ReadField(Bits(instruction, 16, 8));
+    if (Bits(instruction, 25, 4) == F2_JAL)
+      WriteField(Bits(instruction, 0, 8), pc_ + 1);
+    pc_ = target;
+    return true;
+  }
+  case F2_LDI:
+    WriteField(Bits(instruction, 0, 8), Bits(instruction, 8, 16));
+    ++pc_;
+    return true;
+  case F2_LMBD: {
+    const uint32_t op2 = immediate
+      ? Bits(instruction, 16, 8)
+      : ReadField(Bits(instruction, 16, 8));
+    const uint32_t a = ReadField(Bits(instruction, 8, 8));
+    uint32_t result = 32;
+    for (int bit = 31; bit >= 0; --bit) {
+      if (((a >> bit) & 1) == (op2 & 1)) {
+        result = bit;
+        break;
+      }
+    }
+    WriteField(Bits(instruction, 0, 8), result);
+    ++pc_;
+    return true;
+  }
+  case F2_HALT:
+    *stop = StopReason::HALT;
+    return true;
+  case F2_XFR:
+    return ExecuteXfr(instruction);
+  }
+  Log_error("PRU emulator: unsupported instruction 0x%08x at %u",
+            instruction, pc_);
+  return false;
+}
+
+// LBBO/SBBO/LBCO/SBCO at the given base address.
+bool PruEmulator::ExecuteMemory(uint32_t instruction, uint32_t address) {
+  address += Bits(instruction, 24, 1)
+    ? Bits(instruction, 16, 8)
+    : ReadField(Bits(instruction, 16, 8));
+  const int length_code = (Bits(instruction, 25, 3) << 4
+                           | Bits(instruction, 13, 3) << 1
+                           | Bits(instruction, 7, 1));
+  // The codes 124..127 mean: length in r0.b0..b3.
+  const int bytes = length_code < 124
+    ? length_code + 1
+    : (regs_[0] >> (8 * (length_code - 124))) & 0xff;
+  const int start = 4 * Bits(instruction, 0, 5) + Bits(instruction, 5, 2);
+  if (start + bytes > 4 * 32) {
+    Log_error("PRU emulator: memory access beyond r31 at %u", pc_);
+    return false;
+  }
+  const bool load = Bits(instruction, 28, 1);
+  uint8_t *const local = LocalMemory(address, bytes);
+  uint8_t *reg_bytes = (uint8_t*)regs_ + start;
+  if (local) {
+    if (load && load_observer_ && address < DATA_RAM_SIZE)
+      load_observer_(address, bytes);
+    if (load)
+      memcpy(reg_bytes, local, bytes);
+    else
+      memcpy(local, reg_bytes, bytes);
+  } else {
+    for (int i = 0; i < bytes; ++i) {
+      if (load)
+        reg_bytes[i] = LoadByte(address + i);
+      else
+        StoreByte(address + i, reg_bytes[i]);
+    }
+  }
+
+  const int extra_words = bytes > 0 ? (bytes - 1) / 4 : 0;
+  if (local) {
+    cycles_ += (load ? timing_.local_load : timing_.local_store) - 1
+      + extra_words * timing_.local_word;
+    if (!load && store_observer_ && address < DATA_RAM_SIZE)
+      store_observer_(address, bytes);
+  } else {
+    cycles_ += (load ? timing_.external_load : timing_.external_store) - 1
+      + extra_words * timing_.local_word;
+    if (!load) {
+      ++bus_writes_;
+      if (bus_write_observer_)
+        bus_write_observer_(address & ~3u, bus_read(address & ~3u));
+    }
+  }
+  ++pc_;
+  return true;
+}
+
+bool PruEmulator::Execute(uint32_t instruction, StopReason *stop) {
+  switch (instruction >> 29) {
+  case 0:
+    return ExecuteAlu(instruction);
+  case 1:
+    return ExecuteFormat2(instruction, stop);
+  case 2: case 3: {  // Quick branch
+    const uint32_t op2 = Bits(instruction, 24, 1)
+      ? Bits(instruction, 16, 8)
+      : ReadField(Bits(instruction, 16, 8));
+    const uint32_t a = ReadField(Bits(instruction, 8, 8));
+    const int cmp = Bits(instruction, 27, 3);
+    const bool taken = (((cmp & 1) && op2 > a)
+                        || ((cmp & 2) && op2 == a)
+                        || ((cmp & 4) && op2 < a));
+    pc_ += taken ? BranchOffset(instruction) : 1;
+    return true;
+  }
+  case 4: {
+    uint32_t base;
+    if (!ConstantTableEntry(Bits(instruction, 8, 5), &base)) {
+      Log_error("PRU emulator: unsupported constant c%d at %u",
+                Bits(instruction, 8, 5), pc_);
+      return false;
+    }
+    return ExecuteMemory(instruction, base);
+  }
+  case 6: {  // Bit test branch
+    const uint32_t bit = (Bits(instruction, 24, 1)
+                          ? Bits(instruction, 16, 8)
+                          : ReadField(Bits(instruction, 16, 8))) & 0x1f;
+    const bool set = (ReadField(Bits(instruction, 8, 8)) >> bit) & 1;
+    const int test = Bits(instruction, 27, 2);
+    const bool taken = (test == 1 && !set) || (test == 2 && set) || test == 3;
+    pc_ += taken ? BranchOffset(instruction) : 1;
+    return true;
+  }
+  case 7:
+    return ExecuteMemory(instruction, regs_[Bits(instruction, 8, 5)]);
+  }
+  Log_error("PRU emulator: unsupported instruction 0x%08x at %u",
+            instruction, pc_);
+  return false;
+}
+
+PruEmulator::StopReason PruEmulator::Run(uint64_t max_cycles) {
+  const uint64_t end = cycles_ + max_cycles;
+  while (cycles_ < end) {
+    if (pc_ >= program_.size()) {
+      Log_error("PRU emulator: program counter %u outside program", pc_);
+      return StopReason::ERROR;
+    }
+    StopReason stop = StopReason::CYCLE_LIMIT;
+    regs_[31] = 0;  // Reading gives the inputs; we have none.
+    if (!Execute(program_[pc_], &stop))
+      return StopReason::ERROR;
+    ++cycles_;
+    if (stop == StopReason::HALT)
+      return stop;
+    // Writing r31 with bit 5 set sends event 16 + bit 3..0 to the host.
+    if (regs_[31] & 0x20)
+      return StopReason::EVENT;
+  }
+  return StopReason::CYCLE_LIMIT;
+}
+
+EmulatedPruInterface::EmulatedPruInterface(const uint32_t *program,
+                                           size_t words,
+                                           const PruEmulator::Timing &timing)
+  : emulator_(program, words, timing), pru1_running_(false),
+    running_(false) {
+}
+
+EmulatedPruInterface::EmulatedPruInterface(const uint32_t *program,
+                                           size_t words,
+                                           const uint32_t *pru1_program,
+                                           size_t pru1_words,
+                                           const PruEmulator::Timing &timing)
+  : emulator_(program, words, timing),
+    pru1_emulator_(new PruEmulator(pru1_program, pru1_words, timing)),
+    pru1_running_(false), running_(false) {
+  emulator_.MapMemory(PruEmulator::OTHER_DATA_RAM_ADDRESS,
+                      pru1_emulator_->data_ram(), PruEmulator::DATA_RAM_SIZE);
+  emulator_.MapMemory(PruEmulator::SHARED_RAM_ADDRESS,
+                      shared_ram_, sizeof(shared_ram_));
+  pru1_emulator_->MapMemory(PruEmulator::OTHER_DATA_RAM_ADDRESS,
+                            emulator_.data_ram(), PruEmulator::DATA_RAM_SIZE);
+  pru1_emulator_->MapMemory(PruEmulator::SHARED_RAM_ADDRESS,
+                            shared_ram_, sizeof(shared_ram_));
+}
+
+bool EmulatedPruInterface::AllocateSharedMem(void **pru_mmap,
+                                             const size_t size) {
+  if (size > PruEmulator::DATA_RAM_SIZE) {
+    Log_error("PRU emulator: %zu bytes don't fit in the data RAM.", size);
+    return false;
+  }
+  *pru_mmap = emulator_.data_ram();
+  bzero(*pru_mmap, size);
+  return true;
+}
+
+bool EmulatedPruInterface::StartExecution() {
+  if (pru1_emulator_) {
+    bzero(shared_ram_, sizeof(shared_ram_));
+    pru1_emulator_->Reset();
+    pru1_running_ = true;
+  }
+  emulator_.Reset();
+  running_ = true;
+  return true;
+}
+
+PruEmulator::StopReason EmulatedPruInterface::RunBoth(uint64_t max_cycles) {
+  if (!pru1_running_)
+    return emulator_.Run(max_cycles);
+  // Short enough that neither gets far ahead of the other.
+  static constexpr uint64_t kSliceCycles = 8;
+  const uint64_t end = emulator_.cycles() + max_cycles;
+  while (emulator_.cycles() < end) {
+    if (pru1_running_ && pru1_emulator_->cycles() <= emulator_.cycles()) {
+      switch (pru1_emulator_->Run(kSliceCycles)) {
+      case PruEmulator::StopReason::CYCLE_LIMIT:
+      case PruEmulator::StopReason::EVENT:   // PRU1 doesn't send events.
+        break;
+      case PruEmulator::StopReason::HALT:
+        pru1_running_ = false;
+        break;
+      case PruEmulator::StopReason::ERROR:
+        return PruEmulator::StopReason::ERROR;
+      }
+      continue;
+    }
+    const PruEmulator::StopReason reason = emulator_.Run(kSliceCycles);
+    if (reason != PruEmulator::StopReason::CYCLE_LIMIT)
+      return reason;
+  }
+  return PruEmulator::StopReason::CYCLE_LIMIT;
+}
+
+unsigned EmulatedPruInterface::WaitEvent() {
+  if (!running_) return 0;
+  switch (RunBoth(MAX_WAIT_CYCLES)) {
+  case PruEmulator::StopReason::EVENT:
+    return 1;
+  case PruEmulator::StopReason::HALT:
+    running_ = false;
+    return 0;
+  case PruEmulator::StopReason::CYCLE_LIMIT:
+    Log_error("PRU emulator: no event after %d cycles at %u",
+              MAX_WAIT_CYCLES, emulator_.pc());
+    break;
+  case PruEmulator::StopReason::ERROR:
+    break;
+  }
+  abort();  // The queue would wait forever.
+}
+
+bool EmulatedPruInterface::Shutdown() {
+  running_ = pru1_running_ = false;
+  return true;
+}
@@ -0,0 +1,205 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BEAGLEG_PRU_EMULATOR_H
+#define BEAGLEG_PRU_EMULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "pru-hardware-interface.h"
+
+// Emulator of the PRU core, executing the assembled PRU program (as
+// generated by pasm) on the host and counting cycles. This allows to see
+// what a change in the firmware does to the timing without the hardware.
+//
+// Implements the subset of the instruction set pasm generates for our
+// firmware: arithmetic and logic, branches, CALL/RET, LDI, ZERO/FILL,
+// LBBO/SBBO, LBCO/SBCO and HALT. Executing anything else stops with an
+// error.
+//
+// Each instruction takes one cycle; memory accesses take longer, following
+// the Timing below. The local data RAM is emulated, and other memory of the
+// PRU subsystem can be mapped in (see MapMemory()); everything else on the
+// bus (GPIO, PRU configuration) is a plain memory that is counted.
+class PruEmulator {
+public:
+  enum {
+    DATA_RAM_SIZE = 8192,
+    OTHER_DATA_RAM_ADDRESS = 0x00002000,  // Where each PRU sees the other's.
+    SHARED_RAM_ADDRESS = 0x00010000,
+    SHARED_RAM_SIZE = 12288,
+  };
+
+  // Cost of memory accesses, in cycles.
+  struct Timing {
+    Timing() : local_load(3), local_store(2), local_word(1),
+               external_load(40), external_store(2) {}
+    int local_load;       // LBBO/LBCO of the first word of data RAM.
+    int local_store;      // SBBO/SBCO of the first word...
+    int local_word;       // ... and for each further 4 bytes.
+    int external_load;    // Reading from the bus, e.g. GPIO. Stalls.
+    int external_store;   // Writes are posted.
+  };
+
+  enum class StopReason {
+    CYCLE_LIMIT,   // Ran the cycles asked for.
+    EVENT,         // Sent an event to the host (write to r31).
+    HALT,          // HALT instruction.
+    ERROR,         // Invalid instruction or memory access. See Log_error().
+  };
+
+  // "program" of "words" instructions.
+  PruEmulator(const uint32_t *program, size_t words,
+              const Timing &timing = Timing());
+
+  // Start again from the beginning: clear registers, keep memory.
+  void Reset();
+
+  // Run until "max_cycles" more cycles are executed or something happened.
+  StopReason Run(uint64_t max_cycles);
+
+  // Cycles executed since construction.
+  uint64_t cycles() const { return cycles_; }
+
+  // Program counter, in instruction words.
+  uint32_t pc() const { return pc_; }
+
+  // Register file r0..r31.
+  uint32_t reg(int r) const { return regs_[r]; }
+  void set_reg(int r, uint32_t value) { regs_[r] = value; }
+
+  // The local data RAM of the PRU, as the host sees it mapped.
+  uint8_t *data_ram() { return data_ram_; }
+
+  // Make "size" bytes of "memory" appear at "address", with the timing of
+  // the data RAM, e.g. the shared RAM or the other PRU's data RAM. It needs
+  // to stay valid as long as the emulator runs.
+  void MapMemory(uint32_t address, uint8_t *memory, size_t size);
+
+  // Memory outside the data RAM, by 32 bit aligned address. Unwritten
+  // addresses read as zero. Can be set to emulate inputs.
+  uint32_t bus_read(uint32_t address) const;
+  void bus_write(uint32_t address, uint32_t value) { bus_[address] = value; }
+
+  // Number of writes to the bus, e.g. to switch GPIOs.
+  uint64_t bus_writes() const { return bus_writes_; }
+
+  // Called after each store into the data RAM with address and byte count.
+  void SetStoreObserver(const std::function<void(uint32_t, int)> &observer) {
+    store_observer_ = observer;
+  }
+
+  // Called before each load from the data RAM with address and byte count,
+  // e.g. to change what the program reads there.
+  void SetLoadObserver(const std::function<void(uint32_t, int)> &observer) {
+    load_observer_ = observer;
+  }
+
+  // Called after each store to the bus with its 32 bit aligned address and
+  // the value there, e.g. to follow the GPIO outputs.
+  void SetBusWriteObserver(
+    const std::function<void(uint32_t, uint32_t)> &observer) {
+    bus_write_observer_ = observer;
+  }
+
+private:
+  // Register fields, as encoded in the instructions: full register, one of
+  // its half words or bytes.
+  uint32_t ReadField(uint8_t field) const;
+  void WriteField(uint8_t field, uint32_t value);
+  static int FieldBits(uint8_t field);
+
+  bool Execute(uint32_t instruction, StopReason *stop);
+  bool ExecuteAlu(uint32_t instruction);
+  bool ExecuteFormat2(uint32_t instruction, StopReason *stop);
+  bool ExecuteMemory(uint32_t instruction, uint32_t address);
+  bool ExecuteXfr(uint32_t instruction);
+
+  uint8_t LoadByte(uint32_t address) const;
+  void StoreByte(uint32_t address, uint8_t value);
+  // Data RAM or mapped memory at "address", NULL if not local.
+  uint8_t *LocalMemory(uint32_t address, int bytes);
+
+  struct MappedMemory {
+    uint32_t address;
+    uint8_t *memory;
+    size_t size;
+  };
+
+  const std::vector<uint32_t> program_;
+  const Timing timing_;
+  uint32_t regs_[32];
+  uint32_t pc_;
+  bool carry_;
+  uint64_t cycles_;
+  uint8_t data_ram_[DATA_RAM_SIZE];
+  std::vector<MappedMemory> mapped_;
+  std::map<uint32_t, uint32_t> bus_;
+  uint64_t bus_writes_;
+  std::function<void(uint32_t, int)> store_observer_;
+  std::function<void(uint32_t, int)> load_observer_;
+  std::function<void(uint32_t, uint32_t)> bus_write_observer_;
+};
+
+// PruHardwareInterface running the program in the PruEmulator, to drive a
+// PRUMotionQueue without the hardware. The emulator only runs while the
+// queue waits for an event.
+// PRU0 running "program", and, if given, PRU1 running "pru1_program" with
+// the shared RAM and each other's data RAM mapped in, like the dual PRU
+// mode uses them. The two are run alternately in slices of a few cycles.
+class EmulatedPruInterface : public PruHardwareInterface {
+public:
+  // Give up waiting for an event after this many cycles (10 seconds of
+  // PRU time), as the program would spin forever.
+  enum { MAX_WAIT_CYCLES = 2000000000 };
+
+  EmulatedPruInterface(const uint32_t *program, size_t words,
+                       const PruEmulator::Timing &timing
+                       = PruEmulator::Timing());
+  EmulatedPruInterface(const uint32_t *program, size_t words,
+                       const uint32_t *pru1_program, size_t pru1_words,
+                       const PruEmulator::Timing &timing
+                       = PruEmulator::Timing());
+
+  bool Init() final { return true; }
+  bool AllocateSharedMem(void **pru_mmap, const size_t size) final;
+  bool StartExecution() final;
+  unsigned WaitEvent() final;
+  bool Shutdown() final;
+
+  PruEmulator *emulator() { return &emulator_; }
+  PruEmulator *pru1_emulator() { return pru1_emulator_.get(); }  // or NULL
+
+private:
+  // Run until PRU0 stops, with PRU1 in lockstep.
+  PruEmulator::StopReason RunBoth(uint64_t max_cycles);
+
+  PruEmulator emulator_;
+  std::unique_ptr<PruEmulator> pru1_emulator_;
+  bool pru1_running_;
+  uint8_t shared_ram_[PruEmulator::SHARED_RAM_SIZE];
+  bool running_;
+};
+
+#endif  // BEAGLEG_PRU_EMULATOR_H
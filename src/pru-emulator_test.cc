@@ -0,0 +1,233 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the PRU emulator, with small hand assembled programs.
+ */
+#include "pru-emulator.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+namespace {
+// Register fields.
+uint8_t R(int n)  { return 0xe0 | n; }
+uint8_t W0(int n) { return 0x80 | n; }
+uint8_t W2(int n) { return 0xc0 | n; }
+uint8_t B0(int n) { return n; }
+
+enum { ADD = 0, ADC = 1, SUB = 2, LSL = 4, AND = 8, SET = 15 };
+
+uint32_t AluImm(int op, uint8_t rd, uint8_t rs1, uint8_t imm) {
+  return op << 25 | 1 << 24 | imm << 16 | rs1 << 8 | rd;
+}
+uint32_t AluReg(int op, uint8_t rd, uint8_t rs1, uint8_t rs2) {
+  return op << 25 | rs2 << 16 | rs1 << 8 | rd;
+}
+uint32_t Ldi(uint8_t rd, uint16_t value) {
+  return 0x24000000 | value << 8 | rd;
+}
+uint32_t Jal(uint8_t rd, uint16_t target) {
+  return 0x23000000 | target << 8 | rd;
+}
+uint32_t Ret(uint8_t reg) { return 0x20000000 | reg << 16; }
+uint32_t Halt() { return 0x2a000000; }
+uint32_t Zero(int reg, int bytes) {
+  return 0x2eff8000 | (bytes - 1) << 7 | reg;
+}
+
+// Quick branch with comparison bits GT=1 EQ=2 LT=4.
+uint32_t Qb(int cmp, int offset, uint8_t rs1, uint8_t imm) {
+  offset &= 0x3ff;
+  return 0x40000000 | cmp << 27 | (offset >> 8) << 25 | 1 << 24
+    | imm << 16 | rs1 << 8 | (offset & 0xff);
+}
+uint32_t Qbbs(int offset, uint8_t rs1, int bit) {
+  offset &= 0x3ff;
+  return 0xd0000000 | (offset >> 8) << 25 | 1 << 24 | bit << 16 | rs1 << 8
+    | (offset & 0xff);
+}
+
+// LBCO/SBCO c24 (data RAM) with an immediate offset.
+uint32_t DataRam(bool load, int reg, uint8_t offset, int bytes) {
+  const int len = bytes - 1;
+  return 0x80000000 | load << 28 | (len >> 4) << 25 | 1 << 24 | offset << 16
+    | ((len >> 1) & 7) << 13 | 24 << 8 | (len & 1) << 7 | reg;
+}
+// SBBO/LBBO to the address in "base".
+uint32_t Sbbo(int reg, int base, int bytes) {
+  const int len = bytes - 1;
+  return 0xe0000000 | (len >> 4) << 25 | 1 << 24
+    | ((len >> 1) & 7) << 13 | base << 8 | (len & 1) << 7 | reg;
+}
+uint32_t Lbbo(int reg, int base, int bytes) {
+  return Sbbo(reg, base, bytes) | 1 << 28;
+}
+
+PruEmulator::StopReason RunProgram(PruEmulator *pru) {
+  return pru->Run(10000);
+}
+}  // namespace
+
+TEST(PruEmulator, Arithmetic) {
+  const std::vector<uint32_t> program = {
+    Ldi(W0(1), 1000),
+    AluImm(ADD, R(1), R(1), 234),     // r1 = 1234
+    AluImm(LSL, R(2), R(1), 4),       // r2 = 1234 << 4
+    AluReg(SUB, R(3), R(2), R(1)),    // r3 = 1234 * 15
+    AluImm(AND, B0(4), R(3), 0x0f),
+    AluImm(SET, R(5), R(5), 31),
+    Halt(),
+  };
+  PruEmulator pru(program.data(), program.size());
+  EXPECT_EQ(PruEmulator::StopReason::HALT, RunProgram(&pru));
+  EXPECT_EQ(1234u, pru.reg(1));
+  EXPECT_EQ(1234u << 4, pru.reg(2));
+  EXPECT_EQ(1234u * 15, pru.reg(3));
+  EXPECT_EQ((1234u * 15) & 0x0f, pru.reg(4));
+  EXPECT_EQ(0x80000000u, pru.reg(5));
+  EXPECT_EQ(7u, pru.cycles());
+}
+
+TEST(PruEmulator, CarryFor64BitAdd) {
+  const std::vector<uint32_t> program = {
+    AluImm(ADD, R(1), R(1), 1),          // lo + 1 overflows.
+    AluImm(ADC, R(2), R(2), 0),          // hi + carry
+    Halt(),
+  };
+  PruEmulator pru(program.data(), program.size());
+  pru.set_reg(1, 0xffffffff);
+  pru.set_reg(2, 41);
+  EXPECT_EQ(PruEmulator::StopReason::HALT, RunProgram(&pru));
+  EXPECT_EQ(0u, pru.reg(1));
+  EXPECT_EQ(42u, pru.reg(2));
+}
+
+TEST(PruEmulator, BranchesAndCalls) {
+  const std::vector<uint32_t> program = {
+    /* 0 */ Ldi(R(1), 10),
+    /* 1 */ AluImm(SUB, R(1), R(1), 1),   // Two cycles per loop.
+    /* 2 */ Qb(5 /*NE*/, -1, R(1), 0),
+    /* 3 */ Jal(W0(30), 6),
+    /* 4 */ Qbbs(2, R(2), 3),             // Skip next if bit 3.
+    /* 5 */ Ldi(R(3), 1),                 // not reached
+    /* 6 */ Qb(2 /*EQ*/, 3, R(2), 8),     // second time: r2 == 8 done.
+    /* 7 */ Ldi(R(2), 8),
+    /* 8 */ Ret(W0(30)),
+    /* 9 */ Halt(),
+  };
+  PruEmulator pru(program.data(), program.size());
+  EXPECT_EQ(PruEmulator::StopReason::HALT, RunProgram(&pru));
+  EXPECT_EQ(0u, pru.reg(1));
+  EXPECT_EQ(8u, pru.reg(2));
+  EXPECT_EQ(0u, pru.reg(3));
+  EXPECT_EQ(9u, pru.pc());
+  EXPECT_EQ(1 + 2 * 10 + 7u, pru.cycles());
+}
+
+TEST(PruEmulator, DataRamAndBus) {
+  const std::vector<uint32_t> program = {
+    DataRam(true, 1, 16, 8),       // r1, r2 = data RAM 16..23
+    AluImm(ADD, R(1), R(1), 1),
+    DataRam(false, 1, 0, 8),       // data RAM 0..7 = r1, r2
+    Ldi(W0(3), 0x4000),
+    Sbbo(1, 3, 4),                 // Bus write: 0x4000 = r1
+    Zero(1, 8),
+    Halt(),
+  };
+  PruEmulator::Timing timing;
+  PruEmulator pru(program.data(), program.size(), timing);
+  const uint32_t ram[2] = { 41, 0 };
+  memcpy(pru.data_ram() + 16, ram, sizeof(ram));
+  std::vector<uint32_t> loads;
+  pru.SetLoadObserver([&pru, &loads](uint32_t address, int bytes) {
+      loads.push_back(address);
+      loads.push_back(bytes);
+      pru.data_ram()[20] = 7;  // Seen by the load.
+    });
+  std::vector<uint32_t> stores;
+  pru.SetStoreObserver([&stores](uint32_t address, int bytes) {
+      stores.push_back(address);
+      stores.push_back(bytes);
+    });
+
+  EXPECT_EQ(PruEmulator::StopReason::HALT, RunProgram(&pru));
+  uint32_t result[2];
+  memcpy(result, pru.data_ram(), sizeof(result));
+  EXPECT_EQ(42u, result[0]);
+  EXPECT_EQ(7u, result[1]);
+  EXPECT_EQ(std::vector<uint32_t>({ 16, 8 }), loads);
+  EXPECT_EQ(std::vector<uint32_t>({ 0, 8 }), stores);
+  EXPECT_EQ(42u, pru.bus_read(0x4000));
+  EXPECT_EQ(1u, pru.bus_writes());
+  EXPECT_EQ(0u, pru.reg(1));
+  EXPECT_EQ(0u, pru.reg(2));
+  const uint64_t expected_cycles =
+    (timing.local_load + timing.local_word) + 1
+    + (timing.local_store + timing.local_word) + 1
+    + timing.external_store + 1 + 1;
+  EXPECT_EQ(expected_cycles, pru.cycles());
+}
+
+TEST(PruEmulator, EventToHost) {
+  const std::vector<uint32_t> program = {
+    Ldi(B0(31), 16 + 19),  // PRU0_ARM_INTERRUPT
+    Halt(),
+  };
+  EmulatedPruInterface pru(program.data(), program.size());
+  void *mem;
+  ASSERT_TRUE(pru.AllocateSharedMem(&mem, 100));
+  EXPECT_TRUE(mem == pru.emulator()->data_ram());
+  ASSERT_TRUE(pru.StartExecution());
+  EXPECT_EQ(1u, pru.WaitEvent());
+  EXPECT_EQ(0u, pru.WaitEvent());  // Halted.
+  EXPECT_EQ(0u, pru.WaitEvent());
+}
+
+// PRU1 writes into PRU0's data RAM and then the shared RAM, which PRU0
+// waits for.
+TEST(PruEmulator, TwoPrusShareMemory) {
+  const std::vector<uint32_t> pru0_program = {
+    Ldi(W2(3), PruEmulator::SHARED_RAM_ADDRESS >> 16),
+    Lbbo(1, 3, 4),
+    Qb(2, -1, R(1), 0),    // Until r1 != 0
+    Ldi(B0(31), 16 + 19),  // PRU0_ARM_INTERRUPT
+    Halt(),
+  };
+  const std::vector<uint32_t> pru1_program = {
+    Ldi(W0(1), 42),
+    Ldi(W0(4), PruEmulator::OTHER_DATA_RAM_ADDRESS),
+    Sbbo(1, 4, 4),
+    AluImm(ADD, R(1), R(1), 1),
+    Ldi(W2(3), PruEmulator::SHARED_RAM_ADDRESS >> 16),
+    Sbbo(1, 3, 4),
+    Halt(),
+  };
+  EmulatedPruInterface pru(pru0_program.data(), pru0_program.size(),
+                           pru1_program.data(), pru1_program.size());
+  void *mem;
+  ASSERT_TRUE(pru.AllocateSharedMem(&mem, 100));
+  ASSERT_TRUE(pru.StartExecution());
+  EXPECT_EQ(1u, pru.WaitEvent());
+  EXPECT_EQ(43u, pru.emulator()->reg(1));
+  uint32_t value;
+  memcpy(&value, mem, sizeof(value));
+  EXPECT_EQ(42u, value);
+  EXPECT_EQ(0u, pru.emulator()->bus_writes());  // All of it is local.
+  EXPECT_EQ(0u, pru.pru1_emulator()->bus_writes());
+}
+
+TEST(PruEmulator, InvalidInstruction) {
+  const std::vector<uint32_t> program = { 0xa0000000 };
+  PruEmulator pru(program.data(), program.size());
+  EXPECT_EQ(PruEmulator::StopReason::ERROR, RunProgram(&pru));
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
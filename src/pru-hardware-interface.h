@@ -40,17 +40,31 @@ public:
   // Wait for a beagleg-mapped event. Return number of events that have occured.
   virtual unsigned WaitEvent() = 0;
 
+  // File descriptor that becomes readable when an event occured, so that
+  // it can be used in an event loop. WaitEvent() will then not block.
+  // Returns -1 if not supported.
+  virtual int EventFd() { return -1; }
+
   // Halt the PRU
   virtual bool Shutdown() = 0;
 };
 
 class UioPrussInterface : public PruHardwareInterface {
 public:
+  UioPrussInterface() : initialized_(false) {}
+
+  // Opens the driver and loads the firmware, but doesn't start it yet. This
+  // can be done early, e.g. in a thread while reading the configuration;
+  // once successful, further calls don't do anything.
   bool Init();
   bool AllocateSharedMem(void **pru_mmap, const size_t size);
   bool StartExecution();
   unsigned WaitEvent();
+  int EventFd();
   bool Shutdown();
+
+private:
+  bool initialized_;
 };
 
 #endif  // BEAGLEG_PRU_HARDWARE_INTERFACE_
@@ -24,17 +24,24 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include "common/logging.h"
+#include "common/trace.h"
 
 #include "generic-gpio.h"
 #include "pwm-timer.h"
 #include "hardware-mapping.h"
 #include "pru-hardware-interface.h"
 
+using internal::PackedSegment;
 using internal::QueueStatus;
 
 //#define DEBUG_QUEUE
@@ -45,19 +52,50 @@ using internal::QueueStatus;
 // an endswitch fires.
 struct PRUCommunication {
   volatile QueueStatus status;
-  volatile MotionSegment ring_buffer[QUEUE_LEN];
+  struct {
+    uint16_t current;      // Set by the PRU, ramping towards the target.
+    uint16_t target;       // In units of SPEED_SCALE_ONE; 0 to hold.
+    uint16_t ramp;         // Change of current in each ramp_tick.
+    uint16_t reserved;
+    uint32_t ramp_time;    // PRU internal: time since the last change.
+    uint32_t ramp_tick;    // In units of TIMER_FREQUENCY.
+  } volatile speed_scale;
+  volatile uint8_t ring_buffer[QUEUE_BYTES];  // PackedSegments.
+  volatile uint32_t arc_state[2];  // PRU internal: rising, falling fraction.
+  volatile uint32_t raster_state[2];  // PRU internal: pixel clock, pixel.
+  struct {
+    uint32_t gpio_datain;  // Address of the GPIO bank input register.
+    uint32_t mask;         // Bit of the input; 0 if not watching.
+    uint32_t level;        // "mask" if triggering on high, 0 on low.
+    uint32_t triggered;    // Set by the PRU.
+    uint32_t loops;        // Loops done in stop_on_input segments.
+  } volatile input_watch;
+  volatile uint8_t loops_high[4];  // PRU internal: high bits of the loops left.
 } __attribute__((packed));
 
+// The PRU addresses the queue in its own 8KiB data RAM and reports the
+// executing slot in the 8 bit QueueStatus::index.
+static_assert(sizeof(PRUCommunication) <= 8192,
+              "QUEUE_LEN too large to fit in PRU data RAM");
+static_assert(MOTION_MOTOR_COUNT == 8,
+              "The PRU firmware drives 8 motors; see BEAGLEG_NUM_MOTORS");
+// The PRU compares the index with QUEUE_LEN as 8 bit immediate.
+static_assert(QUEUE_LEN <= 255, "QUEUE_LEN too large for QueueStatus::index");
+static_assert(QUEUE_BYTES % 4 == 0 && sizeof(PackedSegment) % 4 == 0,
+              "Elements in the ring buffer are aligned to 32 bit");
+#ifdef DUAL_PRU
+// PRU1 must never get a full round ahead of PRU0 in the queue.
+static_assert(DELAY_FIFO_LEN < QUEUE_LEN, "QUEUE_LEN too small for dual PRU");
+#endif
+
 #ifdef DEBUG_QUEUE
-static void DumpMotionSegment(volatile const struct MotionSegment *e,
-                              volatile struct PRUCommunication *pru_data) {
-  if (e->state == STATE_EXIT) {
-    Log_debug("enqueue[%02td]: EXIT", e - pru_data->ring_buffer);
+static void DumpMotionSegment(const MotionSegment &copy, unsigned index) {
+  if (copy.state == STATE_EXIT) {
+    Log_debug("enqueue[%02u]: EXIT", index);
   } else {
-    MotionSegment copy = (MotionSegment&) *e;
     std::string line;
-    line = StringPrintf("enqueue[%02td]: dir:0x%02x s:(%5d + %5d + %5d) = %5d ",
-                        e - pru_data->ring_buffer, copy.direction_bits,
+    line = StringPrintf("enqueue[%02u]: dir:0x%02x s:(%5u + %5u + %5u) = %5u ",
+                        index, copy.direction_bits,
                         copy.loops_accel, copy.loops_travel, copy.loops_decel,
                         copy.loops_accel + copy.loops_travel + copy.loops_decel);
 
@@ -72,6 +110,11 @@ static void DumpMotionSegment(volatile const struct MotionSegment *e,
                            TIMER_FREQUENCY / (2.0*copy.travel_delay_cycles),
                            copy.travel_delay_cycles);
     }
+    if (copy.arc_shift > 0) {
+      line += StringPrintf("arc: rise:0x%02x fall:0x%02x shift:%d;",
+                           copy.arc_rise_mask, copy.arc_fall_mask,
+                           copy.arc_shift);
+    }
 #if 0
     // The fractional parts.
     for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
@@ -91,15 +134,117 @@ static inline unsigned int RingbufferOffset(unsigned int current, int offset) {
   return (QUEUE_LEN + current + offset) % QUEUE_LEN;
 }
 
+// Offset of the element following one of "size" bytes at "offset" in the
+// ring buffer; same as the PRU does it.
+static inline unsigned int NextOffset(unsigned int offset, int size) {
+  offset += size;
+  return (offset + sizeof(PackedSegment) > QUEUE_BYTES) ? 0 : offset;
+}
+
+// Bytes of an element in the ring buffer.
+static inline int PackedSize(uint8_t motor_mask, uint8_t raster) {
+  const int fractions = raster ? MOTION_MOTOR_COUNT
+                               : __builtin_popcount(motor_mask);
+  return sizeof(PackedSegment) - 4 * (MOTION_MOTOR_COUNT - fractions);
+}
+
+static inline volatile PackedSegment *
+ElementAt(volatile PRUCommunication *pru_data, unsigned int offset) {
+  return (volatile PackedSegment *) &pru_data->ring_buffer[offset];
+}
+
+// Only the fractions of the motors that move go to the PRU.
+static void PackSegment(const MotionSegment &s, PackedSegment *out) {
+  out->state = s.state;
+  out->direction_bits = s.direction_bits;
+  out->motor_mask = s.motor_mask;
+  out->raster = s.raster;
+  out->loops_accel = s.loops_accel & 0xffff;
+  out->loops_travel = s.loops_travel & 0xffff;
+  out->loops_decel = s.loops_decel & 0xffff;
+  out->aux = s.aux;
+  out->accel_series_index = s.accel_series_index;
+  out->hires_accel_cycles = s.hires_accel_cycles;
+  out->travel_delay_cycles = s.travel_delay_cycles;
+  out->arc_rise_mask = s.arc_rise_mask;
+  out->arc_fall_mask = s.arc_fall_mask;
+  out->arc_shift = s.arc_shift;
+  out->stop_on_input = s.stop_on_input;
+  out->loops_accel_high = s.loops_accel >> 16;
+  out->loops_travel_high = s.loops_travel >> 16;
+  out->loops_decel_high = s.loops_decel >> 16;
+  out->loops_high_total = (out->loops_accel_high + out->loops_travel_high
+                           + out->loops_decel_high);
+  int packed = 0;
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    if (s.raster || (s.motor_mask & (1 << i)))
+      out->fractions[packed++] = s.fractions[i];
+  }
+}
+
+// Steps each motor does in the first "additions" fraction additions of
+// "segment", the same way the PRU does them: a step each time the top bit
+// of the motor state gets set, counted down for motors with the direction
+// bit set. A segment does one addition more than it has loops. Arcs turn
+// their fractions after each addition, so we need to go through these;
+// otherwise, this is in closed form.
+static void CountSteps(const MotionSegment &segment, uint32_t additions,
+                       int32_t steps[MOTION_MOTOR_COUNT]) {
+  uint32_t fractions[MOTION_MOTOR_COUNT];
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    const bool moving = segment.motor_mask & (1 << i);
+    if (!moving)
+      fractions[i] = 0;
+    else
+      fractions[i] = segment.raster ? RASTER_MOTOR_FRACTION
+                                    : segment.fractions[i];
+  }
+
+  if (segment.arc_shift == 0) {
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      steps[i] = ((uint64_t)additions * fractions[i] + 0x80000000) >> 32;
+    }
+  } else {
+    uint32_t state[MOTION_MOTOR_COUNT] = {};
+    uint32_t rise = 0, fall = 0;
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      if (segment.arc_rise_mask & (1 << i)) rise = fractions[i];
+      if (segment.arc_fall_mask & (1 << i)) fall = fractions[i];
+      steps[i] = 0;
+    }
+    for (uint32_t n = 0; n < additions; ++n) {
+      for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+        const uint32_t before = state[i];
+        state[i] += fractions[i];
+        if (~before & state[i] & 0x80000000) ++steps[i];
+      }
+      const uint32_t fall_delta = rise >> segment.arc_shift;
+      fall -= (fall_delta <= fall) ? fall_delta : fall;
+      rise += fall >> segment.arc_shift;
+      for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+        if (segment.arc_rise_mask & (1 << i)) fractions[i] = rise;
+        if (segment.arc_fall_mask & (1 << i)) fractions[i] = fall;
+      }
+    }
+  }
+
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    if (segment.direction_bits & (1 << i)) steps[i] = -steps[i];
+  }
+}
+
+static inline uint32_t TotalLoops(const MotionSegment &segment) {
+  return segment.loops_accel + segment.loops_travel + segment.loops_decel;
+}
+
 int PRUMotionQueue::GetPendingElements(uint32_t *head_item_progress) {
   // Get data from the PRU
   const struct QueueStatus status = *(struct QueueStatus*) &pru_data_->status;
-  const unsigned int last_insert_index = RingbufferOffset(queue_pos_, -1);
   if (head_item_progress) {
     *head_item_progress = status.counter;
   }
 
-  if (pru_data_->ring_buffer[last_insert_index].state == STATE_EMPTY) {
+  if (ElementAt(pru_data_, last_offset_)->state == STATE_EMPTY) {
     return 0;
   }
 
@@ -108,47 +253,221 @@ int PRUMotionQueue::GetPendingElements(uint32_t *head_item_progress) {
   return queue_len;
 }
 
-// Stop gap for compiler attempting to be overly clever when copying between
-// host and PRU memory.
-static void unaligned_memcpy(volatile void *dest, const void *src, size_t size) {
-  volatile char *d = (volatile char*) dest;
-  const char *s = (char*) src;
-  const volatile char *end = d + size;
+// The ring buffer elements in PRU memory are packed after the 32 bit status.
+// We copy in 16 bit words, which halves the number of bus accesses compared
+// to byte-wise copying while not relying on unaligned access support of the
+// memory mapping.
+// (This is also a stop gap for the compiler attempting to be overly clever
+// when copying between host and PRU memory.)
+static void halfword_memcpy(volatile void *dest, const void *src, size_t size) {
+  assert(((uintptr_t) dest & 1) == 0);
+  volatile uint16_t *d = (volatile uint16_t*) dest;
+  const char *s = (const char*) src;
+  const volatile uint16_t *end = d + size / 2;
   while (d < end) {
-    *d++ = *s++;
+    uint16_t value;
+    memcpy(&value, s, sizeof(value));  // Source might be unaligned.
+    *d++ = value;
+    s += sizeof(value);
   }
 }
 
-void PRUMotionQueue::Enqueue(MotionSegment *element) {
-  const uint8_t state_to_send = element->state;
-  assert(state_to_send != STATE_EMPTY);  // forgot to set proper state ?
-  // Initially, we copy everything with 'STATE_EMPTY', then flip the state
-  // to avoid a race condition while copying.
-  element->state = STATE_EMPTY;
+void PRUMotionQueue::ReleaseDone() {
+  while (in_flight_ > 0) {
+    volatile PackedSegment *tail = ElementAt(pru_data_, tail_offset_);
+    if (tail->state != STATE_EMPTY)
+      break;
+    const MotionSegment &done = enqueued_[RingbufferOffset(queue_pos_,
+                                                           -in_flight_)];
+    const uint32_t loops = TotalLoops(done);
+    uint32_t additions = loops + 1;
+    if (done.stop_on_input && pru_data_->input_watch.mask != 0) {
+      const uint32_t watched = WatchedLoopsDone(loops);
+      if (watched < loops) additions = watched;  // Stopped at the input.
+      watched_loops_ += watched;
+    }
+    int32_t steps[MOTION_MOTOR_COUNT];
+    CountSteps(done, additions, steps);
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      done_steps_[i] += steps[i];
+    }
+    started_ = true;
+    tail_offset_ = NextOffset(tail_offset_,
+                              PackedSize(tail->motor_mask, tail->raster));
+    --in_flight_;
+  }
+}
 
-  queue_pos_ %= QUEUE_LEN;
-  while (pru_data_->ring_buffer[queue_pos_].state != STATE_EMPTY) {
-    pru_interface_->WaitEvent();
+int PRUMotionQueue::FreeSlots(const MotionSegment *segments, int count) {
+  ReleaseDone();
+  // The elements not done yet are from tail_offset_ up to write_offset_,
+  // possibly wrapping around the end.
+  unsigned int offset = write_offset_;
+  int pending = in_flight_;
+  int count_fit = 0;
+  while (count_fit < count && pending < QUEUE_LEN) {
+    const int size = segments
+      ? PackedSize(segments[count_fit].motor_mask, segments[count_fit].raster)
+      : sizeof(PackedSegment);
+    if (pending > 0 && offset <= tail_offset_ &&
+        offset + size > tail_offset_) {
+      break;
+    }
+    offset = NextOffset(offset, size);
+    ++pending;
+    ++count_fit;
   }
+  return count_fit;
+}
 
-  volatile MotionSegment *queue_element = &pru_data_->ring_buffer[queue_pos_++];
-  unaligned_memcpy(queue_element, element, sizeof(*queue_element));
+bool PRUMotionQueue::HasFreeSlots(int count) {
+  queue_pos_ %= QUEUE_LEN;
+  return FreeSlots(NULL, count) >= count;
+}
+
+int PRUMotionQueue::EventFd() {
+  return pru_interface_->EventFd();
+}
+
+void PRUMotionQueue::AcknowledgeEvent() {
+  pru_interface_->WaitEvent();  // Doesn't block if the fd is readable.
+}
 
-  // Fully initialized. Tell busy-waiting PRU by flipping the state.
-  queue_element->state = state_to_send;
+void PRUMotionQueue::Enqueue(MotionSegment *element) {
+  EnqueueBatch(element, 1);
+}
+
+void PRUMotionQueue::EnqueueBatch(MotionSegment *elements, int count) {
+  TraceScope trace(TraceEvent::QUEUE_ENQUEUE, count);
+  queue_pos_ %= QUEUE_LEN;
+  while (count > 0) {
+    int free_slots;
+    while ((free_slots = FreeSlots(elements, count)) == 0) {
+      pru_interface_->WaitEvent();
+    }
+
+    // Initially, we copy everything with 'STATE_EMPTY', then flip the states
+    // to avoid a race condition while copying.
+    unsigned int offset = write_offset_;
+    for (int i = 0; i < free_slots; ++i) {
+      assert(elements[i].state != STATE_EMPTY);  // forgot to set proper state ?
+      assert(elements[i].loops_accel + elements[i].loops_travel
+             + elements[i].loops_decel <= MOTION_MAX_LOOPS_PER_SEGMENT);
+      PackedSegment packed;
+      PackSegment(elements[i], &packed);
+      packed.state = STATE_EMPTY;
+      const int size = PackedSize(packed.motor_mask, packed.raster);
+      halfword_memcpy(&pru_data_->ring_buffer[offset], &packed, size);
+      offset = NextOffset(offset, size);
+    }
+    // The PRU goes on with the element behind: that needs to read empty,
+    // unless it is the oldest one, which the PRU empties itself first.
+    if (offset != tail_offset_) {
+      ElementAt(pru_data_, offset)->state = STATE_EMPTY;
+    }
 
+    // Fully initialized. Tell busy-waiting PRU by flipping the states in
+    // the sequence it is going to pick them up.
+    for (int i = 0; i < free_slots; ++i) {
+      enqueued_[queue_pos_] = elements[i];  // To count its steps later.
+      ElementAt(pru_data_, write_offset_)->state = elements[i].state;
+      last_offset_ = write_offset_;
+      write_offset_ = NextOffset(write_offset_,
+                                 PackedSize(elements[i].motor_mask,
+                                            elements[i].raster));
 #ifdef DEBUG_QUEUE
-  DumpMotionSegment(queue_element, pru_data_);
+      DumpMotionSegment(elements[i], queue_pos_);
 #endif
+      queue_pos_ = RingbufferOffset(queue_pos_, 1);
+    }
+    in_flight_ += free_slots;
+
+    elements += free_slots;
+    count -= free_slots;
+  }
 }
 
 void PRUMotionQueue::WaitQueueEmpty() {
-  const unsigned int last_insert_index = RingbufferOffset(queue_pos_, -1);
-  while (pru_data_->ring_buffer[last_insert_index].state != STATE_EMPTY) {
+  TraceScope trace(TraceEvent::QUEUE_WAIT_EMPTY);
+  while (ElementAt(pru_data_, last_offset_)->state != STATE_EMPTY) {
     pru_interface_->WaitEvent();
   }
 }
 
+bool PRUMotionQueue::WatchInput(uint32_t gpio_def, bool trigger_level) {
+  assert(ElementAt(pru_data_, last_offset_)->state == STATE_EMPTY);
+  const uint32_t mask = gpio_def ? 1 << (gpio_def & 0x1f) : 0;
+  pru_data_->input_watch.mask = 0;  // Consistent state while changing.
+  pru_data_->input_watch.gpio_datain = (gpio_def & 0xfffff000) + GPIO_DATAIN;
+  pru_data_->input_watch.level = trigger_level ? mask : 0;
+  pru_data_->input_watch.triggered = 0;
+  pru_data_->input_watch.loops = 0;
+  pru_data_->input_watch.mask = mask;
+  watched_loops_ = 0;
+  return true;
+}
+
+uint32_t PRUMotionQueue::WatchedLoopsDone(uint32_t loops) {
+  if (!pru_data_->input_watch.triggered)
+    return loops;
+  // The PRU adds all loops of these elements when starting them and
+  // subtracts the ones left if the input stops them; the ones following
+  // are skipped. So beyond the loops of the elements we released, these
+  // are the ones done in the oldest one, and maybe in later ones.
+  const uint32_t done = pru_data_->input_watch.loops - watched_loops_;
+  return done < loops ? done : loops;
+}
+
+bool PRUMotionQueue::GetStepCounters(int32_t counters[MOTION_MOTOR_COUNT]) {
+  // The elements the PRU is done with, plus the part done of the one it
+  // is executing. That is the oldest one, once the PRU reports its index.
+  ReleaseDone();
+  memcpy(counters, done_steps_, sizeof(done_steps_));
+  const unsigned int tail_pos = RingbufferOffset(queue_pos_, -in_flight_);
+  const struct QueueStatus status = *(struct QueueStatus*) &pru_data_->status;
+  // Until the PRU starts the very first element, the status is all zero;
+  // then, it might look like the element is in its last loop.
+  started_ |= (status.counter != 0);
+  if (in_flight_ == 0 || !started_ || status.index != tail_pos)
+    return true;
+
+  const MotionSegment &executing = enqueued_[tail_pos];
+  const uint32_t loops = TotalLoops(executing);
+  uint32_t additions = loops - std::min(loops, (uint32_t)status.counter);
+  if (executing.stop_on_input && pru_data_->input_watch.mask != 0)
+    additions = std::min(additions, WatchedLoopsDone(loops));
+  int32_t steps[MOTION_MOTOR_COUNT];
+  CountSteps(executing, additions, steps);
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    counters[i] += steps[i];
+  }
+  return true;
+}
+
+bool PRUMotionQueue::SetSpeedFactor(float factor, float ramp_seconds) {
+  if (factor < 0) factor = 0;
+  if (factor > 1) factor = 1;  // The segments are at the limits already.
+  uint32_t target = roundf(factor * SPEED_SCALE_ONE);
+  if (target > 0 && target < SPEED_SCALE_MIN) target = SPEED_SCALE_MIN;
+  // The PRU changes the scale by "ramp" once per tick; ramps that would
+  // need less than one per SPEED_RAMP_TICK get longer ticks.
+  const float ramp_time = std::max(ramp_seconds, 0.0f) * TIMER_FREQUENCY;
+  const uint32_t tick = std::min(std::max(ramp_time / SPEED_SCALE_ONE,
+                                          (float)SPEED_RAMP_TICK), 1e9f);
+  const uint32_t ramp = (ramp_time > tick)
+    ? ceilf((float)SPEED_SCALE_ONE * tick / ramp_time) : SPEED_SCALE_ONE;
+  // The PRU reads them at once; the new ramp applies to the new target.
+  pru_data_->speed_scale.ramp_tick = tick;
+  pru_data_->speed_scale.ramp = ramp;
+  pru_data_->speed_scale.target = target;
+  return true;
+}
+
+bool PRUMotionQueue::InputTriggered(uint32_t *loops_done) {
+  if (loops_done) *loops_done = pru_data_->input_watch.loops;
+  return pru_data_->input_watch.triggered != 0;
+}
+
 void PRUMotionQueue::MotorEnable(bool on) {
   hardware_mapping_->EnableMotors(on);
 }
@@ -164,11 +483,14 @@ void PRUMotionQueue::Shutdown(bool flush_queue) {
   MotorEnable(false);
 }
 
-PRUMotionQueue::~PRUMotionQueue() {}
+PRUMotionQueue::~PRUMotionQueue() {
+  delete [] enqueued_;
+}
 
 PRUMotionQueue::PRUMotionQueue(HardwareMapping *hw, PruHardwareInterface *pru)
   : hardware_mapping_(hw),
-    pru_interface_(pru) {
+    pru_interface_(pru),
+    enqueued_(new MotionSegment[QUEUE_LEN]) {
   const bool success = Init();
   // For now, we just assert-fail here, if things fail.
   // Typically hardware-doomed event anyway.
@@ -184,10 +506,20 @@ bool PRUMotionQueue::Init() {
                                          sizeof(*pru_data_)))
     return false;
 
-  for (int i = 0; i < QUEUE_LEN; ++i) {
-    pru_data_->ring_buffer[i].state = STATE_EMPTY;
+  for (int i = 0; i < QUEUE_BYTES; ++i) {
+    pru_data_->ring_buffer[i] = 0;  // STATE_EMPTY where the PRU looks.
   }
+  pru_data_->speed_scale.current = SPEED_SCALE_ONE;
+  pru_data_->speed_scale.target = SPEED_SCALE_ONE;
+  pru_data_->speed_scale.ramp = SPEED_SCALE_ONE;
+  pru_data_->speed_scale.ramp_time = 0;
+  pru_data_->speed_scale.ramp_tick = SPEED_RAMP_TICK;
   queue_pos_ = 0;
+  write_offset_ = last_offset_ = tail_offset_ = 0;
+  in_flight_ = 0;
+  bzero(done_steps_, sizeof(done_steps_));
+  started_ = false;
+  WatchInput(0, false);
 
   return pru_interface_->StartExecution();
 }
@@ -24,12 +24,22 @@
 // PRU-side mock implementation of the ring buffer.
 struct MockPRUCommunication {
   internal::QueueStatus status;
-  MotionSegment ring_buffer[QUEUE_LEN];
+  struct SpeedScale {
+    uint16_t current;
+    uint16_t target;
+    uint16_t ramp;
+    uint16_t reserved;
+    uint32_t ramp_time;
+    uint32_t ramp_tick;
+  } speed_scale;
+  uint8_t ring_buffer[QUEUE_BYTES];
 } __attribute__((packed));
 
 class MockPRUInterface : public PruHardwareInterface {
 public:
-  MockPRUInterface() : execution_index_(QUEUE_LEN - 1) { mmap = NULL; }
+  MockPRUInterface()
+    : execution_index_(QUEUE_LEN - 1), execution_offset_(0),
+      next_offset_(0) { mmap = NULL; }
   ~MockPRUInterface() { free(mmap); }
 
   bool Init() { return true; }
@@ -48,20 +58,44 @@ public:
               bool last_not_executed = true) {
     // Simulate the execution of num_exec motion segments
     for (int i=0; i < num_exec; ++i) {
+      // The PRU empties the one it was executing when done with it.
+      if (executing_) Element(execution_offset_)->state = STATE_EMPTY;
+      executing_ = false;
       execution_index_ = (execution_index_ + 1) % QUEUE_LEN;
-      assert(mmap->ring_buffer[execution_index_].state != STATE_EMPTY);
-      mmap->ring_buffer[execution_index_].state = STATE_EMPTY;
+      execution_offset_ = next_offset_;
+      internal::PackedSegment *element = Element(execution_offset_);
+      assert(element->state != STATE_EMPTY);
+      element->state = STATE_EMPTY;
+      const int fractions = element->raster
+        ? MOTION_MOTOR_COUNT
+        : __builtin_popcount(element->motor_mask);
+      next_offset_ += sizeof(internal::PackedSegment)
+        - 4 * (MOTION_MOTOR_COUNT - fractions);
+      if (next_offset_ + sizeof(internal::PackedSegment) > QUEUE_BYTES)
+        next_offset_ = 0;
     }
     if (last_not_executed || loops_left ) {
-      mmap->ring_buffer[execution_index_].state = STATE_FILLED;
+      Element(execution_offset_)->state = STATE_FILLED;
+      executing_ = (num_exec > 0 || executing_);
     }
     mmap->status.index = execution_index_;
     mmap->status.counter = loops_left;
   }
 
+  MockPRUCommunication::SpeedScale speed_scale() const {
+    return mmap->speed_scale;
+  }
+
+  internal::PackedSegment *Element(unsigned int offset) {
+    return (internal::PackedSegment *) &mmap->ring_buffer[offset];
+  }
+
 private:
   struct MockPRUCommunication *mmap;
   unsigned int execution_index_;
+  unsigned int execution_offset_;
+  unsigned int next_offset_;
+  bool executing_ = false;   // Element at execution_offset_ not done yet.
 };
 
 TEST(PruMotionQueue, status_init) {
@@ -158,6 +192,187 @@ TEST(PruMotionQueue, exec_index_lt_queue_pos) {
   EXPECT_EQ(motion_backend.GetPendingElements(NULL), 2);
 }
 
+TEST(PruMotionQueue, batch_enqueue) {
+  MockPRUInterface pru_interface = MockPRUInterface();
+  HardwareMapping hmap = HardwareMapping();
+  PRUMotionQueue motion_backend(&hmap, (PruHardwareInterface*) &pru_interface);
+
+  struct MotionSegment segments[3] = {};
+  for (int i = 0; i < 3; ++i) {
+    segments[i].state = STATE_FILLED;
+    segments[i].loops_travel = 100 + i;
+    segments[i].fractions[MOTION_MOTOR_COUNT-1] = 0x12345678 + i;
+  }
+  motion_backend.EnqueueBatch(segments, 3);
+  EXPECT_EQ(motion_backend.GetPendingElements(NULL), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(STATE_FILLED, segments[i].state);  // Restored for caller.
+  }
+
+  // Wrap around the end of the ring buffer.
+  pru_interface.SimRun(3, 0, false);
+  struct MotionSegment many[QUEUE_LEN] = {};
+  for (int i = 0; i < QUEUE_LEN; ++i) many[i].state = STATE_FILLED;
+  motion_backend.EnqueueBatch(many, QUEUE_LEN);
+  // All slots are filled: the simulated PRU asserts that it only executes
+  // non-empty elements.
+  pru_interface.SimRun(QUEUE_LEN, 0);
+  EXPECT_EQ(motion_backend.GetPendingElements(NULL), 1);
+}
+
+TEST(PruMotionQueue, only_fractions_of_moving_motors) {
+  MockPRUInterface pru_interface = MockPRUInterface();
+  HardwareMapping hmap = HardwareMapping();
+  PRUMotionQueue motion_backend(&hmap, (PruHardwareInterface*) &pru_interface);
+
+  struct MotionSegment segment = {};
+  segment.state = STATE_FILLED;
+  segment.motor_mask = 0x05;
+  segment.fractions[0] = 0x1111;
+  segment.fractions[2] = 0x3333;
+  motion_backend.Enqueue(&segment);
+
+  struct MotionSegment raster = {};
+  raster.state = STATE_FILLED;
+  raster.raster = 1;
+  raster.motor_mask = 0x01;
+  raster.fractions[7] = 0x7777;
+  motion_backend.Enqueue(&raster);
+
+  const int fixed_size = sizeof(internal::PackedSegment) - 4*MOTION_MOTOR_COUNT;
+  const internal::PackedSegment *first = pru_interface.Element(0);
+  EXPECT_EQ(0x1111u, first->fractions[0]);
+  EXPECT_EQ(0x3333u, first->fractions[1]);
+  const internal::PackedSegment *second = pru_interface.Element(fixed_size + 8);
+  EXPECT_EQ(STATE_FILLED, second->state);
+  EXPECT_EQ(0x7777u, second->fractions[7]);  // Raster: all of them.
+  EXPECT_EQ(STATE_EMPTY,
+            pru_interface.Element(fixed_size + 8 + sizeof(*second))->state);
+
+  pru_interface.SimRun(2, 0, false);
+  EXPECT_EQ(motion_backend.GetPendingElements(NULL), 0);
+}
+
+TEST(PruMotionQueue, loop_counters_split_in_low_and_high_bits) {
+  MockPRUInterface pru_interface = MockPRUInterface();
+  HardwareMapping hmap = HardwareMapping();
+  PRUMotionQueue motion_backend(&hmap, (PruHardwareInterface*) &pru_interface);
+
+  struct MotionSegment segment = {};
+  segment.state = STATE_FILLED;
+  segment.motor_mask = 0x01;
+  segment.loops_accel = 0x012345;
+  segment.loops_travel = 0x00ffff;
+  segment.loops_decel = 0x100000;
+  motion_backend.Enqueue(&segment);
+
+  const internal::PackedSegment *element = pru_interface.Element(0);
+  EXPECT_EQ(0x2345, element->loops_accel);
+  EXPECT_EQ(0x01, element->loops_accel_high);
+  EXPECT_EQ(0xffff, element->loops_travel);
+  EXPECT_EQ(0x00, element->loops_travel_high);
+  EXPECT_EQ(0x0000, element->loops_decel);
+  EXPECT_EQ(0x10, element->loops_decel_high);
+  EXPECT_EQ(0x11, element->loops_high_total);
+}
+
+// The steps are counted from the loops done, the way the PRU steps.
+TEST(PruMotionQueue, step_counters) {
+  MockPRUInterface pru_interface = MockPRUInterface();
+  HardwareMapping hmap = HardwareMapping();
+  PRUMotionQueue motion_backend(&hmap, (PruHardwareInterface*) &pru_interface);
+
+  struct MotionSegment segment = {};
+  segment.state = STATE_FILLED;
+  segment.motor_mask = 0x03;
+  segment.direction_bits = 0x02;
+  segment.loops_travel = 100;
+  segment.fractions[0] = 0x7fffffff;  // A step every two loops.
+  segment.fractions[1] = 0x40000000;  // ... every four, backwards.
+  motion_backend.Enqueue(&segment);
+  motion_backend.Enqueue(&segment);
+
+  int32_t counters[MOTION_MOTOR_COUNT];
+  ASSERT_TRUE(motion_backend.GetStepCounters(counters));
+  EXPECT_EQ(0, counters[0]);  // Not started yet.
+  EXPECT_EQ(0, counters[1]);
+
+  pru_interface.SimRun(1, 60);
+  ASSERT_TRUE(motion_backend.GetStepCounters(counters));
+  EXPECT_EQ(20, counters[0]);
+  EXPECT_EQ(-10, counters[1]);
+  EXPECT_EQ(0, counters[2]);
+
+  // The first one is done with the final addition after its last loop.
+  pru_interface.SimRun(1, 0);
+  ASSERT_TRUE(motion_backend.GetStepCounters(counters));
+  EXPECT_EQ(50 + 50, counters[0]);
+  EXPECT_EQ(-25 - 25, counters[1]);
+}
+
+TEST(PruMotionQueue, speed_factor) {
+  MockPRUInterface pru_interface = MockPRUInterface();
+  HardwareMapping hmap = HardwareMapping();
+  PRUMotionQueue motion_backend(&hmap, (PruHardwareInterface*) &pru_interface);
+  MockPRUCommunication::SpeedScale speed = pru_interface.speed_scale();
+  EXPECT_EQ(SPEED_SCALE_ONE, speed.current);  // Full speed from the start.
+  EXPECT_EQ(SPEED_SCALE_ONE, speed.target);
+
+  EXPECT_EQ((uint32_t)SPEED_RAMP_TICK, speed.ramp_tick);
+
+  // 10ms from zero to full speed: 61 ticks.
+  ASSERT_TRUE(motion_backend.SetSpeedFactor(0.5, 0.01));
+  speed = pru_interface.speed_scale();
+  EXPECT_EQ(SPEED_SCALE_ONE / 2, speed.target);
+  EXPECT_EQ((uint32_t)SPEED_RAMP_TICK, speed.ramp_tick);
+  EXPECT_EQ(68, speed.ramp);  // Rounded up to get there in time.
+  EXPECT_EQ(SPEED_SCALE_ONE, speed.current);  // Left to the PRU.
+
+  ASSERT_TRUE(motion_backend.SetSpeedFactor(0, 0));  // Hold immediately.
+  speed = pru_interface.speed_scale();
+  EXPECT_EQ(0, speed.target);
+  EXPECT_EQ(SPEED_SCALE_ONE, speed.ramp);
+
+  // Long ramps change in steps of one with longer ticks.
+  ASSERT_TRUE(motion_backend.SetSpeedFactor(0.5, 10));
+  speed = pru_interface.speed_scale();
+  EXPECT_EQ(1, speed.ramp);
+  EXPECT_EQ(10u * TIMER_FREQUENCY / SPEED_SCALE_ONE, speed.ramp_tick);
+
+  // Too slow to make sense: slowest we do. No speeding up of segments.
+  ASSERT_TRUE(motion_backend.SetSpeedFactor(0.001, 1));
+  EXPECT_EQ(SPEED_SCALE_MIN, pru_interface.speed_scale().target);
+  ASSERT_TRUE(motion_backend.SetSpeedFactor(1.5, 1));
+  EXPECT_EQ(SPEED_SCALE_ONE, pru_interface.speed_scale().target);
+}
+
+TEST(PruMotionQueue, ring_buffer_bytes_limit_large_segments) {
+  MockPRUInterface pru_interface = MockPRUInterface();
+  HardwareMapping hmap = HardwareMapping();
+  PRUMotionQueue motion_backend(&hmap, (PruHardwareInterface*) &pru_interface);
+
+  struct MotionSegment segment = {};
+  segment.motor_mask = (1 << MOTION_MOTOR_COUNT) - 1;
+  int count = 0;
+  while (motion_backend.HasFreeSlots(1)) {
+    segment.state = STATE_FILLED;
+    motion_backend.Enqueue(&segment);
+    ++count;
+  }
+  const int size = sizeof(internal::PackedSegment);
+  EXPECT_EQ((QUEUE_BYTES - size) / size + 1, count);
+  EXPECT_LT(count, QUEUE_LEN);
+
+  // Each one the PRU is done with makes room for the next.
+  for (int i = 0; i < 2 * QUEUE_LEN; ++i) {
+    pru_interface.SimRun(1, 0, false);
+    ASSERT_TRUE(motion_backend.HasFreeSlots(1));
+    segment.state = STATE_FILLED;
+    motion_backend.Enqueue(&segment);
+    EXPECT_FALSE(motion_backend.HasFreeSlots(1));
+  }
+}
+
 int main(int argc, char *argv[]) {
   Log_init("/dev/stderr");
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,480 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "segment-cache.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common/logging.h"
+
+// File layout: header, followed by entries of one type byte and, for
+// segments, the raw MotionSegment. Only valid on the machine (and build)
+// it was recorded with, which the key takes care of.
+static const char kMagic[4] = { 'B', 'G', 'S', 'C' };
+enum { kFormatVersion = 1 };
+
+struct CacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t segment_size;    // sizeof(MotionSegment)
+  uint32_t home_axes;       // Axes to home before replay.
+  uint64_t key;
+} __attribute__((packed));
+
+enum EntryType {
+  ENTRY_SEGMENT = 1,
+  ENTRY_MOTOR_ENABLE,
+  ENTRY_MOTOR_DISABLE,
+};
+
+// FNV-1a, 64 bit. Not cryptographic, but plenty to tell jobs apart.
+static const uint64_t kFnvOffset = 0xcbf29ce484222325ULL;
+static const uint64_t kFnvPrime = 0x100000001b3ULL;
+
+SegmentCacheKey::SegmentCacheKey() : hash_(kFnvOffset) {
+  // Segments of a different layout or format are never the same.
+  Add(StringPiece((const char*)&kMagic, sizeof(kMagic)));
+  const uint32_t layout[2] = { kFormatVersion, sizeof(MotionSegment) };
+  Add(StringPiece((const char*)layout, sizeof(layout)));
+}
+
+void SegmentCacheKey::Add(const StringPiece &data) {
+  AddBytes(data.data(), data.length());
+  AddLength(data.length());
+}
+
+void SegmentCacheKey::AddBytes(const char *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    hash_ ^= (uint8_t)data[i];
+    hash_ *= kFnvPrime;
+  }
+}
+
+// Length as separator, so that "ab"+"c" is different from "a"+"bc".
+void SegmentCacheKey::AddLength(uint64_t len) {
+  for (size_t i = 0; i < sizeof(len); ++i) {
+    hash_ ^= (len >> (8 * i)) & 0xff;
+    hash_ *= kFnvPrime;
+  }
+}
+
+bool SegmentCacheKey::AddFile(const char *filename) {
+  FILE *f = fopen(filename, "rb");
+  if (f == NULL) return false;
+  char buffer[65536];
+  uint64_t len = 0;
+  size_t r;
+  while ((r = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    AddBytes(buffer, r);
+    len += r;
+  }
+  const bool ok = !ferror(f);
+  fclose(f);
+  AddLength(len);
+  return ok;
+}
+
+std::string SegmentCacheKey::filename() const {
+  return StringPrintf("%016llx.segments", (unsigned long long)hash_);
+}
+
+SegmentRecorder::SegmentRecorder(MotionQueue *delegate,
+                                 const std::string &cache_dir,
+                                 const SegmentCacheKey &key)
+  : delegate_(delegate), key_(key.value()),
+    filename_(cache_dir + "/" + key.filename()),
+    tmp_filename_(filename_ + StringPrintf(".tmp-%d", getpid())),
+    out_(fopen(tmp_filename_.c_str(), "wb")), ok_(out_ != NULL) {
+  if (!ok_) {
+    Log_error("Segment cache: can't write %s: %s", tmp_filename_.c_str(),
+              strerror(errno));
+  }
+  WriteHeader(0);
+}
+
+SegmentRecorder::~SegmentRecorder() {
+  Finish(false);
+}
+
+void SegmentRecorder::WriteHeader(AxisBitmap_t home_axes) {
+  CacheHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kFormatVersion;
+  header.segment_size = sizeof(MotionSegment);
+  header.home_axes = home_axes;
+  header.key = key_;
+  Write(&header, sizeof(header));
+}
+
+void SegmentRecorder::Write(const void *data, size_t len) {
+  if (ok_ && fwrite(data, 1, len, out_) != len) {
+    Log_error("Segment cache: error writing %s", tmp_filename_.c_str());
+    ok_ = false;
+  }
+}
+
+void SegmentRecorder::Restart(AxisBitmap_t home_axes) {
+  if (!out_) return;
+  rewind(out_);
+  if (ftruncate(fileno(out_), 0) != 0) ok_ = false;
+  WriteHeader(home_axes);
+}
+
+bool SegmentRecorder::Finish(bool keep) {
+  if (!out_) return false;
+  const bool write_ok = (fclose(out_) == 0) && ok_;
+  out_ = NULL;
+  if (keep && write_ok && rename(tmp_filename_.c_str(), filename_.c_str()) == 0) {
+    Log_info("Segment cache: stored %s", filename_.c_str());
+    return true;
+  }
+  unlink(tmp_filename_.c_str());
+  return false;
+}
+
+// Recorded before handing on, as the queue might modify the segment.
+void SegmentRecorder::Enqueue(MotionSegment *segment) {
+  const uint8_t type = ENTRY_SEGMENT;
+  Write(&type, 1);
+  Write(segment, sizeof(*segment));
+  delegate_->Enqueue(segment);
+}
+
+void SegmentRecorder::EnqueueBatch(MotionSegment *segments, int count) {
+  const uint8_t type = ENTRY_SEGMENT;
+  for (int i = 0; i < count; ++i) {
+    Write(&type, 1);
+    Write(&segments[i], sizeof(segments[i]));
+  }
+  delegate_->EnqueueBatch(segments, count);
+}
+
+void SegmentRecorder::MotorEnable(bool on) {
+  const uint8_t type = on ? ENTRY_MOTOR_ENABLE : ENTRY_MOTOR_DISABLE;
+  Write(&type, 1);
+  delegate_->MotorEnable(on);
+}
+
+SegmentStreamer::SegmentStreamer(const std::vector<int> &fds)
+  : fds_(fds), home_axes_(0), started_(false), lost_machine_(false) {}
+
+SegmentStreamer::~SegmentStreamer() {
+  Finish();
+}
+
+void SegmentStreamer::Restart(AxisBitmap_t home_axes) {
+  if (started_) {
+    Log_error("Segment stream: can't home once segments are sent.");
+    lost_machine_ = true;  // Machines will be in the wrong place.
+    return;
+  }
+  buffer_.clear();
+  home_axes_ = home_axes;
+}
+
+void SegmentStreamer::Append(const void *data, size_t len) {
+  buffer_.append((const char*)data, len);
+  if (started_ && buffer_.size() >= 65536) Flush();
+}
+
+void SegmentStreamer::Flush() {
+  if (!started_) {
+    // The header goes out with the first segment, so that homing at the
+    // beginning of the job can still be announced in it.
+    CacheHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.segment_size = sizeof(MotionSegment);
+    header.home_axes = home_axes_;
+    header.key = SegmentCacheKey().value();  // Only the format.
+    buffer_.insert(0, (const char*)&header, sizeof(header));
+    started_ = true;
+  }
+  for (size_t i = 0; i < fds_.size(); /**/) {
+    size_t written = 0;
+    while (written < buffer_.size()) {
+      // No SIGPIPE if a machine went away; we just drop it.
+      const ssize_t w = send(fds_[i], buffer_.data() + written,
+                             buffer_.size() - written, MSG_NOSIGNAL);
+      if (w < 0 && errno == EINTR) continue;
+      if (w <= 0) break;
+      written += w;
+    }
+    if (written < buffer_.size()) {
+      Log_error("Segment stream: lost machine on fd %d: %s", fds_[i],
+                strerror(errno));
+      close(fds_[i]);
+      fds_.erase(fds_.begin() + i);
+      lost_machine_ = true;
+      continue;
+    }
+    ++i;
+  }
+  buffer_.clear();
+}
+
+void SegmentStreamer::WaitQueueEmpty() {
+  if (started_) Flush();  // Before the first segment, keep homing possible.
+}
+
+bool SegmentStreamer::Finish() {
+  if (fds_.empty()) return !lost_machine_;
+  Flush();
+  for (int fd : fds_) close(fd);
+  fds_.clear();
+  return !lost_machine_;
+}
+
+void SegmentStreamer::Enqueue(MotionSegment *segment) {
+  const uint8_t type = ENTRY_SEGMENT;
+  Append(&type, 1);
+  Append(segment, sizeof(*segment));
+  if (!started_) Flush();  // Get the machines going.
+}
+
+void SegmentStreamer::EnqueueBatch(MotionSegment *segments, int count) {
+  for (int i = 0; i < count; ++i) Enqueue(&segments[i]);
+}
+
+void SegmentStreamer::MotorEnable(bool on) {
+  const uint8_t type = on ? ENTRY_MOTOR_ENABLE : ENTRY_MOTOR_DISABLE;
+  Append(&type, 1);
+}
+
+SegmentCacheReader::SegmentCacheReader()
+  : in_(NULL), home_axes_(0), corrupt_(false) {}
+SegmentCacheReader::~SegmentCacheReader() {
+  if (in_) fclose(in_);
+}
+
+bool SegmentCacheReader::Open(const std::string &cache_dir,
+                              const SegmentCacheKey &key) {
+  const std::string filename = cache_dir + "/" + key.filename();
+  in_ = fopen(filename.c_str(), "rb");
+  if (in_ == NULL) return false;
+  CacheHeader header;
+  if (fread(&header, sizeof(header), 1, in_) != 1
+      || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kFormatVersion
+      || header.segment_size != sizeof(MotionSegment)
+      || header.key != key.value()) {
+    Log_error("Segment cache: ignoring invalid %s", filename.c_str());
+    fclose(in_);
+    in_ = NULL;
+    return false;
+  }
+  home_axes_ = header.home_axes;
+  return true;
+}
+
+bool SegmentCacheReader::OpenStream(int fd) {
+  in_ = fdopen(fd, "rb");
+  if (in_ == NULL) {
+    close(fd);
+    return false;
+  }
+  CacheHeader header;
+  if (fread(&header, sizeof(header), 1, in_) != 1
+      || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kFormatVersion
+      || header.segment_size != sizeof(MotionSegment)
+      || header.key != SegmentCacheKey().value()) {
+    Log_error("Segment stream: not a segment stream of this BeagleG version.");
+    fclose(in_);
+    in_ = NULL;
+    return false;
+  }
+  home_axes_ = header.home_axes;
+  return true;
+}
+
+bool SegmentCacheReader::Replay(MotionQueue *queue) {
+  while (ReplayBatch(queue)) {}
+  return !corrupt_;
+}
+
+bool SegmentCacheReader::ReplayBatch(MotionQueue *queue) {
+  if (!in_ || corrupt_) return false;
+  // Batches amortize the transfer to the hardware.
+  MotionSegment batch[kBatchSize];
+  int batch_count = 0;
+  int type;
+  while (batch_count < kBatchSize && (type = fgetc(in_)) != EOF) {
+    switch (type) {
+    case ENTRY_SEGMENT:
+      if (fread(&batch[batch_count], sizeof(MotionSegment), 1, in_) != 1) {
+        corrupt_ = true;
+        break;
+      }
+      ++batch_count;
+      break;
+    case ENTRY_MOTOR_ENABLE:
+    case ENTRY_MOTOR_DISABLE:
+      if (batch_count) queue->EnqueueBatch(batch, batch_count);
+      batch_count = 0;
+      queue->MotorEnable(type == ENTRY_MOTOR_ENABLE);
+      break;
+    default:
+      corrupt_ = true;
+    }
+    if (corrupt_) break;
+  }
+  if (batch_count) queue->EnqueueBatch(batch, batch_count);
+  if (corrupt_) {
+    Log_error("Segment cache: corrupt cache file.");
+    return false;
+  }
+  return batch_count == kBatchSize;  // Otherwise, we reached the end.
+}
+
+SegmentCacheEventFilter::SegmentCacheEventFilter(
+  GCodeParser::EventReceiver *delegatee, SegmentWriter *recorder)
+  : delegatee_(delegatee), recorder_(recorder), cacheable_(true),
+    reached_end_(false), moved_(false), home_axes_(0) {
+}
+
+void SegmentCacheEventFilter::NotCacheable(const char *reason) {
+  if (cacheable_) Log_info("Segment cache: job not cacheable (%s).", reason);
+  cacheable_ = false;
+}
+
+void SegmentCacheEventFilter::gcode_start(GCodeParser *parser) {
+  delegatee_->gcode_start(parser);
+}
+void SegmentCacheEventFilter::gcode_finished(bool end_of_stream) {
+  if (end_of_stream) reached_end_ = true;  // Not interrupted.
+  delegatee_->gcode_finished(end_of_stream);
+}
+void SegmentCacheEventFilter::inform_origin_offset(const AxesRegister &offset,
+                                                   const char *named_offset) {
+  delegatee_->inform_origin_offset(offset, named_offset);
+}
+void SegmentCacheEventFilter::gcode_command_done(char letter, float val) {
+  delegatee_->gcode_command_done(letter, val);
+}
+void SegmentCacheEventFilter::input_idle(bool is_first) {
+  delegatee_->input_idle(is_first);
+}
+void SegmentCacheEventFilter::wait_for_start() {
+  NotCacheable("waits for start");
+  delegatee_->wait_for_start();
+}
+
+void SegmentCacheEventFilter::go_home(AxisBitmap_t axis_bitmap) {
+  if (moved_) NotCacheable("homing in the middle of the job");
+  delegatee_->go_home(axis_bitmap);
+  if (!moved_) {
+    // Homing is waited for, so the queue has all its segments already.
+    home_axes_ |= axis_bitmap;
+    recorder_->Restart(home_axes_);
+  }
+}
+
+bool SegmentCacheEventFilter::probe_axis(float feed_mm_p_sec,
+                                         enum GCodeParserAxis axis,
+                                         float *probed_position) {
+  NotCacheable("probing");
+  return delegatee_->probe_axis(feed_mm_p_sec, axis, probed_position);
+}
+void SegmentCacheEventFilter::change_spindle_speed(float value) {
+  NotCacheable("spindle");
+  delegatee_->change_spindle_speed(value);
+}
+void SegmentCacheEventFilter::set_speed_factor(float factor) {
+  delegatee_->set_speed_factor(factor);  // Part of the planning.
+}
+void SegmentCacheEventFilter::set_fanspeed(float value) {
+  if (value != 0) NotCacheable("fan");  // Initial reset to zero is fine.
+  delegatee_->set_fanspeed(value);
+}
+void SegmentCacheEventFilter::set_temperature(float degrees_c) {
+  if (degrees_c != 0) NotCacheable("temperature");
+  delegatee_->set_temperature(degrees_c);
+}
+void SegmentCacheEventFilter::wait_temperature() {
+  NotCacheable("temperature");
+  delegatee_->wait_temperature();
+}
+void SegmentCacheEventFilter::dwell(float time_ms) {
+  NotCacheable("dwell");
+  delegatee_->dwell(time_ms);
+}
+void SegmentCacheEventFilter::motors_enable(bool enable) {
+  delegatee_->motors_enable(enable);
+}
+void SegmentCacheEventFilter::clamp_to_range(AxisBitmap_t affected,
+                                             AxesRegister *axes) {
+  delegatee_->clamp_to_range(affected, axes);
+}
+bool SegmentCacheEventFilter::coordinated_move(float feed_mm_p_sec,
+                                               const AxesRegister &pos) {
+  Moved();
+  return delegatee_->coordinated_move(feed_mm_p_sec, pos);
+}
+bool SegmentCacheEventFilter::rapid_move(float feed_mm_p_sec,
+                                         const AxesRegister &pos) {
+  Moved();
+  return delegatee_->rapid_move(feed_mm_p_sec, pos);
+}
+void SegmentCacheEventFilter::arc_move(float feed_mm_p_sec,
+                                       GCodeParserAxis normal_axis,
+                                       bool clockwise,
+                                       const AxesRegister &start,
+                                       const AxesRegister &center,
+                                       const AxesRegister &end) {
+  Moved();
+  delegatee_->arc_move(feed_mm_p_sec, normal_axis, clockwise,
+                       start, center, end);
+}
+void SegmentCacheEventFilter::spline_move(float feed_mm_p_sec,
+                                          const AxesRegister &start,
+                                          const AxesRegister &cp1,
+                                          const AxesRegister &cp2,
+                                          const AxesRegister &end) {
+  Moved();
+  delegatee_->spline_move(feed_mm_p_sec, start, cp1, cp2, end);
+}
+void SegmentCacheEventFilter::raster_move(float feed_mm_p_sec,
+                                          const AxesRegister &start,
+                                          const AxesRegister &end,
+                                          const uint8_t *power, int count) {
+  Moved();
+  delegatee_->raster_move(feed_mm_p_sec, start, end, power, count);
+}
+
+const char *SegmentCacheEventFilter::unprocessed(char letter, float value,
+                                                 const char *rest_of_line) {
+  // M-codes whose effect is in the aux bits of the segments, or that only
+  // print something, are fine. Everything else acts outside the queue.
+  if (letter == 'M') {
+    switch ((int)value) {
+    case 7: case 8: case 9: case 10: case 11:
+    case 42: case 62: case 63:
+    case 114: case 115: case 117: case 119:
+    case 245: case 246: case 355:
+      break;
+    default:
+      NotCacheable(StringPrintf("M%d", (int)value).c_str());
+    }
+  }
+  return delegatee_->unprocessed(letter, value, rest_of_line);
+}
@@ -0,0 +1,245 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_SEGMENT_CACHE_H_
+#define _BEAGLEG_SEGMENT_CACHE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "common/string-util.h"
+#include "gcode-parser/gcode-parser.h"
+#include "motion-queue.h"
+
+// Cache of the final MotionSegment stream of a job, so that re-running the
+// same job with the same configuration does not need parsing and planning
+// at all: the segments are fed straight into the MotionQueue.
+//
+// Only jobs whose effects are entirely in the motion queue can be cached;
+// SegmentCacheEventFilter decides that while the job runs the first time.
+
+// Key identifying a job: hash of everything that influences the segments.
+class SegmentCacheKey {
+public:
+  SegmentCacheKey();
+
+  void Add(const StringPiece &data);
+  bool AddFile(const char *filename);  // Returns false if it can't be read.
+
+  uint64_t value() const { return hash_; }
+  std::string filename() const;  // Hex representation + suffix.
+
+private:
+  // Hash bytes and the length separator. Add() does both, AddFile()
+  // hashes the file in chunks and the length once at the end.
+  void AddBytes(const char *data, size_t len);
+  void AddLength(uint64_t len);
+
+  uint64_t hash_;
+};
+
+// A MotionQueue writing the segment stream of a job somewhere to be
+// replayed later or elsewhere.
+class SegmentWriter : public MotionQueue {
+public:
+  // Forget everything written so far, e.g. after homing at the beginning
+  // of a job; "home_axes" will be performed at replay before the segments.
+  virtual void Restart(AxisBitmap_t home_axes) = 0;
+};
+
+// A MotionQueue that passes everything on to "delegate" and records the
+// segments and motor enable calls to a temporary file. Finish() makes it
+// the cache file for "key" in "cache_dir" if the job was cacheable.
+class SegmentRecorder : public SegmentWriter {
+public:
+  SegmentRecorder(MotionQueue *delegate, const std::string &cache_dir,
+                  const SegmentCacheKey &key);
+  ~SegmentRecorder() override;
+
+  void Restart(AxisBitmap_t home_axes) final;
+
+  // Store the recording if "keep" is true and writing succeeded, otherwise
+  // just discard. Returns true if it was stored.
+  bool Finish(bool keep);
+
+  void Enqueue(MotionSegment *segment) final;
+  void EnqueueBatch(MotionSegment *segments, int count) final;
+  void WaitQueueEmpty() final { delegate_->WaitQueueEmpty(); }
+  bool HasFreeSlots(int count) final { return delegate_->HasFreeSlots(count); }
+  int EventFd() final { return delegate_->EventFd(); }
+  void AcknowledgeEvent() final { delegate_->AcknowledgeEvent(); }
+  void MotorEnable(bool on) final;
+  void Shutdown(bool flush_queue) final { delegate_->Shutdown(flush_queue); }
+  int GetPendingElements(uint32_t *head_item_progress) final {
+    return delegate_->GetPendingElements(head_item_progress);
+  }
+
+private:
+  void WriteHeader(AxisBitmap_t home_axes);
+  void Write(const void *data, size_t len);
+
+  MotionQueue *const delegate_;
+  const uint64_t key_;
+  const std::string filename_;
+  const std::string tmp_filename_;
+  FILE *out_;
+  bool ok_;
+};
+
+// Sends the segment stream of a job, in the cache file format, to the
+// machines connected on "fds", which replay it without parsing or planning
+// (see SegmentCacheReader::OpenStream()). That way, a fast host plans a job
+// once for several machines with the same configuration.
+// There is no hardware to wait for: the queue is always empty and never
+// full; the machines pace the stream by reading it as their queues drain.
+// A machine that can't be written to is dropped from the stream.
+class SegmentStreamer : public SegmentWriter {
+public:
+  explicit SegmentStreamer(const std::vector<int> &fds);
+  ~SegmentStreamer() override;
+
+  // Only possible as long as no segment has been sent.
+  void Restart(AxisBitmap_t home_axes) final;
+
+  // Send what is left and close the connections. Returns true if the stream
+  // reached all machines.
+  bool Finish();
+
+  void Enqueue(MotionSegment *segment) final;
+  void EnqueueBatch(MotionSegment *segments, int count) final;
+  void WaitQueueEmpty() final;
+  void MotorEnable(bool on) final;
+  void Shutdown(bool flush_queue) final { Finish(); }
+  int GetPendingElements(uint32_t *head_item_progress) final {
+    if (head_item_progress) *head_item_progress = 0;
+    return 0;
+  }
+
+private:
+  void Append(const void *data, size_t len);
+  void Flush();
+
+  std::vector<int> fds_;
+  std::string buffer_;
+  AxisBitmap_t home_axes_;
+  bool started_;       // Header with the home_axes_ is sent.
+  bool lost_machine_;
+};
+
+// Replays a cache file or stream.
+class SegmentCacheReader {
+public:
+  SegmentCacheReader();
+  ~SegmentCacheReader();
+
+  // Open cache for "key" in "cache_dir". Returns false if there is none.
+  bool Open(const std::string &cache_dir, const SegmentCacheKey &key);
+
+  // Read a stream sent by a SegmentStreamer from "fd", which is closed
+  // with the reader. Returns false if it is not a stream of this version
+  // of BeagleG.
+  bool OpenStream(int fd);
+
+  // Axes to home before replaying.
+  AxisBitmap_t home_axes() const { return home_axes_; }
+
+  enum { kBatchSize = 16 };
+
+  // Send all segments to "queue". Returns false if the file was truncated
+  // or corrupt; in that case, some segments might have been sent already.
+  bool Replay(MotionQueue *queue);
+
+  // Send the next up to kBatchSize segments to "queue", for callers that
+  // want to do something else in between. Returns false once everything
+  // is sent or the file turned out to be truncated or corrupt.
+  bool ReplayBatch(MotionQueue *queue);
+  bool corrupt() const { return corrupt_; }
+
+private:
+  FILE *in_;
+  AxisBitmap_t home_axes_;
+  bool corrupt_;
+};
+
+// Passes all events on to "delegatee", but watches for what the segment
+// stream can't reproduce: anything waiting for the outside world (homing in
+// the middle of a job, probing, temperatures, start button), dwell timing,
+// spindle, fan, and M-codes handled outside the motion queue.
+// Homing before the first move is fine: passed to the recorder to be
+// repeated at replay.
+class SegmentCacheEventFilter : public GCodeParser::EventReceiver {
+public:
+  SegmentCacheEventFilter(GCodeParser::EventReceiver *delegatee,
+                          SegmentWriter *recorder);
+
+  // True if the whole input was seen and nothing prevents caching.
+  bool cacheable() const { return cacheable_ && reached_end_; }
+
+  void gcode_start(GCodeParser *parser) final;
+  void gcode_finished(bool end_of_stream) final;
+  void inform_origin_offset(const AxesRegister &offset,
+                            const char *named_offset) final;
+  void gcode_command_done(char letter, float val) final;
+  void input_idle(bool is_first) final;
+  void wait_for_start() final;
+  void go_home(AxisBitmap_t axis_bitmap) final;
+  bool probe_axis(float feed_mm_p_sec, enum GCodeParserAxis axis,
+                  float *probed_position) final;
+  void change_spindle_speed(float value) final;
+  void set_speed_factor(float factor) final;
+  void set_fanspeed(float value) final;
+  void set_temperature(float degrees_c) final;
+  void wait_temperature() final;
+  void dwell(float time_ms) final;
+  void motors_enable(bool enable) final;
+  void clamp_to_range(AxisBitmap_t affected, AxesRegister *axes) final;
+  bool coordinated_move(float feed_mm_p_sec,
+                        const AxesRegister &absolute_pos) final;
+  bool rapid_move(float feed_mm_p_sec,
+                  const AxesRegister &absolute_pos) final;
+  void arc_move(float feed_mm_p_sec,
+                GCodeParserAxis normal_axis, bool clockwise,
+                const AxesRegister &start,
+                const AxesRegister &center,
+                const AxesRegister &end) final;
+  void spline_move(float feed_mm_p_sec,
+                   const AxesRegister &start,
+                   const AxesRegister &cp1, const AxesRegister &cp2,
+                   const AxesRegister &end) final;
+  void raster_move(float feed_mm_p_sec,
+                   const AxesRegister &start, const AxesRegister &end,
+                   const uint8_t *power, int count) final;
+  const char *unprocessed(char letter, float value,
+                          const char *rest_of_line) final;
+
+private:
+  void NotCacheable(const char *reason);
+  void Moved() { moved_ = true; }
+
+  GCodeParser::EventReceiver *const delegatee_;
+  SegmentWriter *const recorder_;
+  bool cacheable_;
+  bool reached_end_;
+  bool moved_;
+  AxisBitmap_t home_axes_;
+};
+
+#endif  // _BEAGLEG_SEGMENT_CACHE_H_
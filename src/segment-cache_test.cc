@@ -0,0 +1,304 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the pre-planned segment cache.
+ */
+#include "segment-cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+namespace {
+// Collects all segments and motor enable calls.
+class CollectingMotionQueue : public MotionQueue {
+public:
+  void Enqueue(MotionSegment *segment) final {
+    segments.push_back(*segment);
+    segment->state = 0xff;  // Queues may modify the segment.
+  }
+  void WaitQueueEmpty() final {}
+  void MotorEnable(bool on) final { enable_calls.push_back(on); }
+  void Shutdown(bool flush_queue) final {}
+  int GetPendingElements(uint32_t *head_item_progress) final { return 0; }
+
+  std::vector<MotionSegment> segments;
+  std::vector<bool> enable_calls;
+};
+
+class NullEventReceiver : public GCodeParser::EventReceiver {
+public:
+  void gcode_start(GCodeParser *parser) final {}
+  void go_home(AxisBitmap_t axis_bitmap) final {}
+  void set_speed_factor(float factor) final {}
+  void set_fanspeed(float value) final {}
+  void set_temperature(float degrees_c) final {}
+  void wait_temperature() final {}
+  void dwell(float time_ms) final {}
+  void motors_enable(bool enable) final {}
+  bool coordinated_move(float feed, const AxesRegister &pos) final {
+    return true;
+  }
+  bool rapid_move(float feed, const AxesRegister &pos) final { return true; }
+  const char *unprocessed(char letter, float value, const char *rest) final {
+    return NULL;
+  }
+};
+
+class CacheDir {
+public:
+  CacheDir() {
+    char tmpl[] = "/tmp/segment-cache-test.XXXXXX";
+    dir_ = mkdtemp(tmpl);
+  }
+  ~CacheDir() {
+    const std::string cmd = "rm -rf " + dir_;
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "Can't remove %s\n", cmd.c_str());
+  }
+  const std::string &dir() const { return dir_; }
+
+private:
+  std::string dir_;
+};
+
+MotionSegment MakeSegment(uint16_t loops) {
+  MotionSegment segment;
+  bzero(&segment, sizeof(segment));
+  segment.state = 1;
+  segment.loops_travel = loops;
+  segment.fractions[0] = 0x1000 * loops;
+  return segment;
+}
+
+SegmentCacheKey MakeKey(const char *gcode) {
+  SegmentCacheKey key;
+  key.Add(gcode);
+  return key;
+}
+}  // namespace
+
+TEST(SegmentCache, RecordAndReplay) {
+  CacheDir cache;
+  const SegmentCacheKey key = MakeKey("G1 X10");
+  CollectingMotionQueue live;
+  {
+    SegmentRecorder recorder(&live, cache.dir(), key);
+    recorder.MotorEnable(true);
+    MotionSegment single = MakeSegment(1);
+    recorder.Enqueue(&single);
+    MotionSegment batch[3] = { MakeSegment(2), MakeSegment(3), MakeSegment(4) };
+    recorder.EnqueueBatch(batch, 3);
+    recorder.MotorEnable(false);
+    EXPECT_TRUE(recorder.Finish(true));
+  }
+  ASSERT_EQ(4u, live.segments.size());
+
+  SegmentCacheReader reader;
+  ASSERT_TRUE(reader.Open(cache.dir(), key));
+  EXPECT_EQ(0u, reader.home_axes());
+  CollectingMotionQueue replayed;
+  EXPECT_TRUE(reader.Replay(&replayed));
+  ASSERT_EQ(live.segments.size(), replayed.segments.size());
+  for (size_t i = 0; i < live.segments.size(); ++i) {
+    EXPECT_EQ(0, memcmp(&live.segments[i], &replayed.segments[i],
+                        sizeof(MotionSegment))) << i;
+  }
+  EXPECT_EQ(live.enable_calls, replayed.enable_calls);
+}
+
+// Replaying batch by batch sends the same as all at once.
+TEST(SegmentCache, ReplayInBatches) {
+  CacheDir cache;
+  const SegmentCacheKey key = MakeKey("G1 X20");
+  const int kSegments = 2 * SegmentCacheReader::kBatchSize + 3;
+  CollectingMotionQueue live;
+  {
+    SegmentRecorder recorder(&live, cache.dir(), key);
+    recorder.MotorEnable(true);
+    for (int i = 0; i < kSegments; ++i) {
+      MotionSegment segment = MakeSegment(i + 1);
+      recorder.Enqueue(&segment);
+    }
+    recorder.MotorEnable(false);
+    EXPECT_TRUE(recorder.Finish(true));
+  }
+
+  SegmentCacheReader reader;
+  ASSERT_TRUE(reader.Open(cache.dir(), key));
+  CollectingMotionQueue replayed;
+  EXPECT_TRUE(reader.ReplayBatch(&replayed));
+  EXPECT_EQ((size_t)SegmentCacheReader::kBatchSize, replayed.segments.size());
+  EXPECT_TRUE(reader.ReplayBatch(&replayed));
+  EXPECT_FALSE(reader.ReplayBatch(&replayed));  // Last, partial batch.
+  EXPECT_FALSE(reader.corrupt());
+  ASSERT_EQ(live.segments.size(), replayed.segments.size());
+  for (size_t i = 0; i < live.segments.size(); ++i) {
+    EXPECT_EQ(0, memcmp(&live.segments[i], &replayed.segments[i],
+                        sizeof(MotionSegment))) << i;
+  }
+  EXPECT_EQ(live.enable_calls, replayed.enable_calls);
+}
+
+// Files are hashed in chunks, but the key is the same as of their content.
+TEST(SegmentCache, FileKeyIsKeyOfContent) {
+  CacheDir cache;
+  std::string content;
+  for (int i = 0; content.size() < 200000; ++i) {
+    content.append(StringPrintf("G1 X%d Y%d\n", i, i % 17));
+  }
+  const std::string filename = cache.dir() + "/job.gcode";
+  FILE *f = fopen(filename.c_str(), "wb");
+  ASSERT_TRUE(f != NULL);
+  fwrite(content.data(), 1, content.size(), f);
+  fclose(f);
+
+  SegmentCacheKey from_file;
+  EXPECT_TRUE(from_file.AddFile(filename.c_str()));
+  SegmentCacheKey from_content;
+  from_content.Add(content);
+  EXPECT_EQ(from_content.value(), from_file.value());
+
+  SegmentCacheKey missing;
+  EXPECT_FALSE(missing.AddFile((cache.dir() + "/nonexistent").c_str()));
+}
+
+TEST(SegmentCache, DiscardedOrOtherKeyIsNotFound) {
+  CacheDir cache;
+  CollectingMotionQueue live;
+  {
+    SegmentRecorder recorder(&live, cache.dir(), MakeKey("G1 X10"));
+    MotionSegment segment = MakeSegment(1);
+    recorder.Enqueue(&segment);
+    EXPECT_FALSE(recorder.Finish(false));
+  }
+  SegmentCacheReader reader;
+  EXPECT_FALSE(reader.Open(cache.dir(), MakeKey("G1 X10")));
+
+  {
+    SegmentRecorder recorder(&live, cache.dir(), MakeKey("G1 X10"));
+    EXPECT_TRUE(recorder.Finish(true));
+  }
+  SegmentCacheReader other;
+  EXPECT_FALSE(other.Open(cache.dir(), MakeKey("G1 X11")));
+}
+
+TEST(SegmentCache, HomingAtStartIsReplayedFirst) {
+  CacheDir cache;
+  const SegmentCacheKey key = MakeKey("G28\nG1 X10");
+  CollectingMotionQueue live;
+  NullEventReceiver machine;
+  {
+    SegmentRecorder recorder(&live, cache.dir(), key);
+    SegmentCacheEventFilter filter(&machine, &recorder);
+    MotionSegment homing = MakeSegment(1);
+    recorder.Enqueue(&homing);  // Homing moves: not part of the replay.
+    filter.go_home((1 << AXIS_X) | (1 << AXIS_Y));
+    filter.coordinated_move(10, AxesRegister());
+    MotionSegment move = MakeSegment(2);
+    recorder.Enqueue(&move);
+    EXPECT_FALSE(filter.cacheable());  // Not seen everything yet.
+    filter.gcode_finished(true);
+    EXPECT_TRUE(filter.cacheable());
+    EXPECT_TRUE(recorder.Finish(filter.cacheable()));
+  }
+  SegmentCacheReader reader;
+  ASSERT_TRUE(reader.Open(cache.dir(), key));
+  EXPECT_EQ((1u << AXIS_X) | (1u << AXIS_Y), reader.home_axes());
+  CollectingMotionQueue replayed;
+  EXPECT_TRUE(reader.Replay(&replayed));
+  ASSERT_EQ(1u, replayed.segments.size());
+  EXPECT_EQ(2u, replayed.segments[0].loops_travel);
+}
+
+TEST(SegmentCache, JobsDependingOnOutsideWorldAreNotCacheable) {
+  CacheDir cache;
+  CollectingMotionQueue live;
+  NullEventReceiver machine;
+  SegmentRecorder recorder(&live, cache.dir(), MakeKey(""));
+
+  {
+    SegmentCacheEventFilter filter(&machine, &recorder);
+    filter.set_fanspeed(0);       // Initial state from the parser: fine.
+    filter.set_temperature(0);
+    filter.unprocessed('M', 7, "");  // Aux bits in the segments: fine.
+    filter.coordinated_move(10, AxesRegister());
+    filter.gcode_finished(true);
+    EXPECT_TRUE(filter.cacheable());
+    filter.go_home(1 << AXIS_X);  // Homing in the middle of a job.
+    EXPECT_FALSE(filter.cacheable());
+  }
+  {
+    SegmentCacheEventFilter filter(&machine, &recorder);
+    filter.dwell(100);
+    EXPECT_FALSE(filter.cacheable());
+  }
+  {
+    SegmentCacheEventFilter filter(&machine, &recorder);
+    filter.unprocessed('M', 3, "");
+    EXPECT_FALSE(filter.cacheable());
+  }
+  {
+    SegmentCacheEventFilter filter(&machine, &recorder);
+    filter.set_fanspeed(255);
+    EXPECT_FALSE(filter.cacheable());
+  }
+  recorder.Finish(false);
+}
+
+TEST(SegmentCache, StreamToSeveralMachines) {
+  int machine_a[2], machine_b[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, machine_a));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, machine_b));
+  NullEventReceiver machine;
+  {
+    SegmentStreamer streamer({ machine_a[0], machine_b[0] });
+    SegmentCacheEventFilter filter(&machine, &streamer);
+    streamer.MotorEnable(true);
+    streamer.WaitQueueEmpty();      // Nothing sent yet: homing still fine.
+    filter.go_home(1 << AXIS_Z);
+    filter.coordinated_move(10, AxesRegister());
+    MotionSegment batch[2] = { MakeSegment(1), MakeSegment(2) };
+    streamer.EnqueueBatch(batch, 2);
+    streamer.MotorEnable(false);
+    filter.gcode_finished(true);
+    EXPECT_TRUE(filter.cacheable());
+    EXPECT_TRUE(streamer.Finish());
+  }
+  for (int fd : { machine_a[1], machine_b[1] }) {
+    SegmentCacheReader reader;
+    ASSERT_TRUE(reader.OpenStream(fd));
+    EXPECT_EQ(1u << AXIS_Z, reader.home_axes());
+    CollectingMotionQueue replayed;
+    EXPECT_TRUE(reader.Replay(&replayed));
+    ASSERT_EQ(2u, replayed.segments.size());
+    EXPECT_EQ(2u, replayed.segments[1].loops_travel);
+    EXPECT_EQ(std::vector<bool>({ false }), replayed.enable_calls);
+  }
+}
+
+TEST(SegmentCache, StreamWithoutMachineIsNotReplayed) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ASSERT_EQ(5, write(fds[1], "G1 X1", 5));
+  close(fds[1]);
+  SegmentCacheReader reader;
+  EXPECT_FALSE(reader.OpenStream(fds[0]));
+
+  ASSERT_EQ(0, pipe(fds));
+  close(fds[0]);                    // Machine gone.
+  SegmentStreamer streamer({ fds[1] });
+  MotionSegment segment = MakeSegment(1);
+  streamer.Enqueue(&segment);
+  EXPECT_FALSE(streamer.Finish());
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
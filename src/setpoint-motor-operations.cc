@@ -0,0 +1,182 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "setpoint-motor-operations.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t get_time_usec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+SetpointMotorOperations::SetpointMotorOperations(int rate_hz)
+  : period_(1.0 / rate_hz), aux_bits_(0), motors_enabled_(false),
+    phase_(period_), consumed_aux_bits_(0) {
+  assert(rate_hz > 0);
+  sem_init(&free_slots_, 0, RING_SIZE - 1);
+  bzero(position_, sizeof(position_));
+  bzero(pwm_duty_, sizeof(pwm_duty_));
+  bzero(&stats_, sizeof(stats_));
+  for (std::atomic<int> &pos : consumed_position_) pos = 0;
+}
+
+SetpointMotorOperations::~SetpointMotorOperations() {
+  sem_destroy(&free_slots_);
+}
+
+bool SetpointMotorOperations::PopSetpoint(ServoSetpoint *setpoint) {
+  const ServoSetpoint *next = ring_.read_slot();
+  if (next == NULL) return false;
+  *setpoint = *next;
+  ring_.commit_read();
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    consumed_position_[i].store(lround(setpoint->position[i]),
+                                std::memory_order_relaxed);
+  }
+  consumed_aux_bits_.store(setpoint->aux_bits, std::memory_order_relaxed);
+  sem_post(&free_slots_);
+  return true;
+}
+
+int SetpointMotorOperations::PendingSetpoints() {
+  int free_slots = 0;
+  sem_getvalue(&free_slots_, &free_slots);
+  return RING_SIZE - 1 - free_slots;
+}
+
+void SetpointMotorOperations::PushSetpoint(const LinearSegmentSteps &segment,
+                                           double fraction) {
+  if (sem_trywait(&free_slots_) != 0) {
+    const int64_t start = get_time_usec();
+    while (sem_wait(&free_slots_) != 0 && errno == EINTR)
+      ;
+    const unsigned long waited = get_time_usec() - start;
+    stats_.waits++;
+    stats_.wait_usec_total += waited;
+    if (waited > stats_.wait_usec_max)
+      stats_.wait_usec_max = waited;
+  }
+  ServoSetpoint *setpoint = ring_.write_slot();
+  assert(setpoint != NULL);   // Semaphore guarantees a free slot.
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    setpoint->position[i] = position_[i] + fraction * segment.steps[i];
+  }
+  setpoint->aux_bits = aux_bits_;
+  memcpy(setpoint->pwm_duty, pwm_duty_, sizeof(pwm_duty_));
+  setpoint->motors_enabled = motors_enabled_;
+  ring_.commit_write();
+}
+
+void SetpointMotorOperations::Enqueue(const LinearSegmentSteps &segment) {
+  const int pending = PendingSetpoints();
+  int bucket = pending * MotionQueueStats::DEPTH_BUCKETS / (RING_SIZE - 1);
+  if (bucket >= MotionQueueStats::DEPTH_BUCKETS)
+    bucket = MotionQueueStats::DEPTH_BUCKETS - 1;
+  stats_.depth_histogram[bucket]++;
+  if (pending == 0 && segment.v0 > 0)
+    stats_.underruns++;
+  stats_.segments++;
+
+  // Outputs change at the start of the segment, i.e. with its first sample.
+  aux_bits_ = segment.aux_bits;
+  for (int i = 0; i < BEAGLEG_NUM_PWM_OUTPUTS; ++i) {
+    if (segment.pwm_mask & (1 << i)) pwm_duty_[i] = segment.pwm_duty[i];
+  }
+
+  int defining_steps = 0;
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    const int steps = abs(segment.steps[i]);
+    if (steps > defining_steps) defining_steps = steps;
+  }
+  const double v0 = segment.v0;
+  const double v1 = segment.v1;
+  if (defining_steps == 0 || v0 + v1 <= 0) {
+    // No time passes. While standing, the fieldbus still needs to see
+    // the new outputs or, for a degenerate move, where we are now.
+    const bool standing = (phase_ == period_);
+    if (defining_steps > 0 || standing) {
+      PushSetpoint(segment, 1.0);
+      phase_ = period_;
+    }
+  } else {
+    // Constant acceleration from v0 to v1 over the steps of the motor
+    // with the most steps; all others move proportionally.
+    const double duration = 2.0 * defining_steps / (v0 + v1);
+    const double half_accel = (v1 - v0) / duration / 2;
+    double t = phase_;
+    for (/**/; t < duration; t += period_) {
+      PushSetpoint(segment, (v0 + half_accel * t) * t / defining_steps);
+    }
+    phase_ = t - duration;
+    if (v1 <= 0) {
+      // Stopped; the motors arrive at the end before the next sample,
+      // and the next move starts from standing.
+      PushSetpoint(segment, 1.0);
+      phase_ = period_;
+    }
+  }
+
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    position_[i] += segment.steps[i];
+  }
+}
+
+void SetpointMotorOperations::MotorEnable(bool on) {
+  WaitQueueEmpty();
+  motors_enabled_ = on;
+  const LinearSegmentSteps standstill = {};
+  PushSetpoint(standstill, 0.0);
+}
+
+void SetpointMotorOperations::WaitQueueEmpty() {
+  while (!ring_.empty()) {
+    usleep(period_ * 1e6 / 2);
+  }
+}
+
+bool SetpointMotorOperations::GetPhysicalStatus(PhysicalStatus *status) {
+  for (int i = 0; i < BEAGLEG_NUM_MOTORS; ++i) {
+    status->pos_steps[i] =
+      consumed_position_[i].load(std::memory_order_relaxed);
+  }
+  status->aux_bits = consumed_aux_bits_.load(std::memory_order_relaxed);
+  memcpy(status->pwm_duty, pwm_duty_, sizeof(pwm_duty_));
+  return true;
+}
+
+void SetpointMotorOperations::SetExternalPosition(int motor, int pos) {
+  assert(motor >= 0 && motor < BEAGLEG_NUM_MOTORS);
+  position_[motor] = pos;
+  if (ring_.empty())
+    consumed_position_[motor].store(pos, std::memory_order_relaxed);
+}
+
+bool SetpointMotorOperations::GetQueueStats(MotionQueueStats *stats) {
+  *stats = stats_;
+  stats->queue_depth = PendingSetpoints();
+  return true;
+}
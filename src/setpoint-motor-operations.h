@@ -0,0 +1,99 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_SETPOINT_MOTOR_OPERATIONS_H_
+#define _BEAGLEG_SETPOINT_MOTOR_OPERATIONS_H_
+
+#include <semaphore.h>
+
+#include <atomic>
+
+#include "common/spsc-ring.h"
+#include "motor-operations.h"
+
+// Position of all motors at one point in time.
+struct ServoSetpoint {
+  double position[BEAGLEG_NUM_MOTORS];  // In steps; fractional in between.
+  unsigned short aux_bits;
+  float pwm_duty[BEAGLEG_NUM_PWM_OUTPUTS];
+  bool motors_enabled;
+};
+
+// MotorOperations for servo drives that take a new position every cycle
+// of a fieldbus (e.g. cyclic synchronous position mode on EtherCAT)
+// instead of step pulses.
+//
+// The segments from the planner are sampled at a fixed rate into setpoints
+// that are put into a lock-free ring. The fieldbus thread takes one with
+// PopSetpoint() every cycle; the drives interpolate in between. Enqueue()
+// blocks while the ring is full, so it is filled as much ahead as the
+// planner is, and latency of the fieldbus cycle does not depend on it.
+//
+// Segments are linear moves; arcs and raster are left to the planner.
+class SetpointMotorOperations : public MotorOperations {
+public:
+  enum { RING_SIZE = 1024 };
+
+  // Sample "rate_hz" setpoints per second; that is the cycle rate of the
+  // fieldbus calling PopSetpoint().
+  explicit SetpointMotorOperations(int rate_hz);
+  ~SetpointMotorOperations() override;
+
+  // -- Consumer side; the fieldbus thread.
+
+  // Copy the next setpoint to "setpoint". Returns false if there is none;
+  // then the servos should stay at the last position.
+  // Never blocks nor does a system call, unless the planner is waiting
+  // for space in the ring.
+  bool PopSetpoint(ServoSetpoint *setpoint);
+
+  // -- MotorOperations; called from the planner thread.
+
+  void Enqueue(const LinearSegmentSteps &segment) final;
+  void MotorEnable(bool on) final;
+  void WaitQueueEmpty() final;
+  bool GetPhysicalStatus(PhysicalStatus *status) final;
+  // Only changes the coordinates of the following setpoints; the fieldbus
+  // side has to compensate if the drives count absolute.
+  void SetExternalPosition(int motor, int pos) final;
+  bool GetQueueStats(MotionQueueStats *stats) final;
+
+private:
+  // Sample the segment starting at position_ that has moved "fraction"
+  // of its steps.
+  void PushSetpoint(const LinearSegmentSteps &segment, double fraction);
+  int PendingSetpoints();
+
+  const double period_;           // Seconds between setpoints.
+  SPSCRing<ServoSetpoint, RING_SIZE> ring_;
+  sem_t free_slots_;              // Posted by consumer for each setpoint.
+
+  // State of the planner side. Positions at the start of the next segment.
+  int position_[BEAGLEG_NUM_MOTORS];
+  unsigned short aux_bits_;
+  float pwm_duty_[BEAGLEG_NUM_PWM_OUTPUTS];
+  bool motors_enabled_;
+  double phase_;   // Time into the next segment of its first sample.
+  MotionQueueStats stats_;
+
+  // Position of the setpoint last taken by the consumer.
+  std::atomic<int> consumed_position_[BEAGLEG_NUM_MOTORS];
+  std::atomic<unsigned short> consumed_aux_bits_;
+};
+
+#endif  // _BEAGLEG_SETPOINT_MOTOR_OPERATIONS_H_
@@ -0,0 +1,149 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for sampling segments into servo setpoints.
+ */
+#include "setpoint-motor-operations.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+namespace {
+LinearSegmentSteps Segment(float v0, float v1, int steps0, int steps1 = 0) {
+  LinearSegmentSteps segment = {};
+  segment.v0 = v0;
+  segment.v1 = v1;
+  segment.steps[0] = steps0;
+  segment.steps[1] = steps1;
+  return segment;
+}
+
+std::vector<ServoSetpoint> PopAll(SetpointMotorOperations *ops) {
+  std::vector<ServoSetpoint> result;
+  ServoSetpoint setpoint;
+  while (ops->PopSetpoint(&setpoint)) result.push_back(setpoint);
+  return result;
+}
+}  // namespace
+
+TEST(SetpointMotorOperations, ConstantSpeedSamplesEvenly) {
+  SetpointMotorOperations ops(1000);
+  ServoSetpoint setpoint;
+  EXPECT_FALSE(ops.PopSetpoint(&setpoint));
+
+  // 1000 steps/s for 100 steps: 0.1s, one step per sample, and the next
+  // segment continues in the same rhythm.
+  ops.Enqueue(Segment(1000, 1000, 100));
+  ops.Enqueue(Segment(1000, 1000, 100));
+  const std::vector<ServoSetpoint> setpoints = PopAll(&ops);
+  ASSERT_GE(setpoints.size(), 199u);
+  ASSERT_LE(setpoints.size(), 200u);
+  for (size_t i = 0; i < setpoints.size(); ++i) {
+    EXPECT_NEAR(i + 1, setpoints[i].position[0], 1e-6) << i;
+    EXPECT_EQ(0, setpoints[i].position[1]);
+  }
+}
+
+TEST(SetpointMotorOperations, AccelerateAndStopAtEnd) {
+  SetpointMotorOperations ops(1000);
+  ops.Enqueue(Segment(0, 1000, 50, -25));
+  ops.Enqueue(Segment(1000, 0, 50, -25));
+  const std::vector<ServoSetpoint> setpoints = PopAll(&ops);
+
+  // 100ms at an average of 500 steps/s.
+  ASSERT_GE(setpoints.size(), 199u);
+  ASSERT_LE(setpoints.size(), 201u);
+  double last = 0;
+  for (const ServoSetpoint &setpoint : setpoints) {
+    const double speed = (setpoint.position[0] - last) * 1000;
+    EXPECT_GE(speed, 0);
+    EXPECT_LE(speed, 1000 + 1e-3);
+    EXPECT_NEAR(-setpoint.position[0] / 2, setpoint.position[1], 1e-6);
+    last = setpoint.position[0];
+  }
+  // Half the distance after half the time, the end exactly.
+  EXPECT_NEAR(50, setpoints[99].position[0], 0.5);
+  EXPECT_EQ(100, setpoints.back().position[0]);
+  EXPECT_EQ(-50, setpoints.back().position[1]);
+
+  PhysicalStatus status;
+  ASSERT_TRUE(ops.GetPhysicalStatus(&status));
+  EXPECT_EQ(100, status.pos_steps[0]);
+  EXPECT_EQ(-50, status.pos_steps[1]);
+
+  // Next move starts from standing; first sample one period later.
+  ops.Enqueue(Segment(0, 1000, 50));
+  ServoSetpoint setpoint;
+  ASSERT_TRUE(ops.PopSetpoint(&setpoint));
+  EXPECT_NEAR(100.005, setpoint.position[0], 1e-6);  // At 10000 steps/s^2
+}
+
+TEST(SetpointMotorOperations, OutputsAndEnable) {
+  SetpointMotorOperations ops(1000);
+  ops.MotorEnable(true);   // No consumer yet, ring already empty.
+  LinearSegmentSteps aux_only = {};
+  aux_only.aux_bits = 0x5;
+  aux_only.pwm_mask = 0x1;
+  aux_only.pwm_duty[0] = 0.25;
+  ops.Enqueue(aux_only);   // Standing: applies right away.
+
+  const std::vector<ServoSetpoint> setpoints = PopAll(&ops);
+  ASSERT_EQ(2u, setpoints.size());
+  EXPECT_TRUE(setpoints[0].motors_enabled);
+  EXPECT_EQ(0, setpoints[0].aux_bits);
+  EXPECT_EQ(0x5, setpoints[1].aux_bits);
+  EXPECT_FLOAT_EQ(0.25, setpoints[1].pwm_duty[0]);
+
+  PhysicalStatus status;
+  ASSERT_TRUE(ops.GetPhysicalStatus(&status));
+  EXPECT_EQ(0x5, status.aux_bits);
+
+  ops.SetExternalPosition(0, 1000);
+  ops.Enqueue(Segment(1000, 0, 1));
+  ServoSetpoint setpoint;
+  ASSERT_TRUE(ops.PopSetpoint(&setpoint));
+  EXPECT_NEAR(1000.75, setpoint.position[0], 1e-6);
+}
+
+TEST(SetpointMotorOperations, EnqueueWaitsForFieldbus) {
+  SetpointMotorOperations ops(10000);
+  std::vector<ServoSetpoint> received;
+  std::atomic<bool> stop(false);
+  std::thread fieldbus([&]() {
+      ServoSetpoint setpoint;
+      while (!stop) {
+        if (ops.PopSetpoint(&setpoint))
+          received.push_back(setpoint);
+        else
+          usleep(10);
+      }
+    });
+  // Three seconds worth of setpoints, much more than the ring holds.
+  ops.Enqueue(Segment(10000, 10000, 10000));
+  ops.Enqueue(Segment(10000, 0, 10000));
+  ops.WaitQueueEmpty();
+  stop = true;
+  fieldbus.join();
+  ASSERT_GT(received.size(), (size_t) SetpointMotorOperations::RING_SIZE);
+  EXPECT_EQ(20000, received.back().position[0]);
+  for (size_t i = 1; i < received.size(); ++i) {
+    ASSERT_GE(received[i].position[0], received[i-1].position[0]) << i;
+  }
+
+  MotionQueueStats stats;
+  ASSERT_TRUE(ops.GetQueueStats(&stats));
+  EXPECT_EQ(2u, stats.segments);
+  EXPECT_GT(stats.waits, 0u);
+  EXPECT_EQ(0u, stats.queue_depth);
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
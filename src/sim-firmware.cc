@@ -86,6 +86,8 @@ plot "/tmp/foo.data" using 1:3 title "velocity Euclid" with lines ls 1, '' using
 #include <strings.h>
 #include <stdio.h>
 
+#include <algorithm>
+
 #include "motion-queue.h"
 #include "motor-interface-constants.h"
 
@@ -144,11 +146,11 @@ struct HardwareState {
   uint32_t m[MOTION_MOTOR_COUNT];
 };
 
-static double sim_time;
-static int sim_steps[MOTION_MOTOR_COUNT];  // we are only looking at the defining axis steps.
-
 static struct HardwareState state;
 
+// Time it takes to update the motors in each loop, besides the delay.
+static const double kLoopUpdateTime = 160e-9;
+
 // Default mapping of our motors to axis in typical test-setups.
 // Should match Motor-Mapping in config file.
 enum {
@@ -161,10 +163,137 @@ static double euclid(double x, double y, double z) {
   return sqrt(x*x + y*y + z*z);
 }
 
-// This simulates what happens in the PRU. For testing purposes.
 void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
   if (segment->state == STATE_EXIT)
     return;
+
+  // Raster segments: the moving motors all step with the same fraction;
+  // the pixels only switch aux bits, which we don't simulate.
+  if (segment->raster) {
+    for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+      segment->fractions[i] = (segment->motor_mask & (1 << i))
+        ? RASTER_MOTOR_FRACTION : 0;
+    }
+  }
+
+  if (sample_interval_ > 0 && segment->arc_shift == 0)
+    EnqueueClosedForm(*segment);
+  else
+    EnqueueLoops(segment);
+}
+
+void SimFirmwareQueue::PrintSample(double dt, uint32_t delay_loops,
+                                   const int *steps,
+                                   const double *motor_speeds,
+                                   double velocity, double acceleration,
+                                   const char *msg) {
+  const double euklid_factor = euclid(motor_speeds[X_MOTOR],
+                                      motor_speeds[Y_MOTOR],
+                                      motor_speeds[Z_MOTOR]);
+  // Total time; speed; acceleration; delay_loops. [steps walked for all motors].
+  fprintf(out_, "%12.8f %10d %12.4f %12.4f      ",
+          sim_time_ + dt, delay_loops,
+          euklid_factor * velocity,
+          euklid_factor * acceleration);
+  for (int i = 0; i < relevant_motors_; ++i) {
+    fprintf(out_, "%5d %10.4f %12.4f ", steps[i],
+            motor_speeds[i] * velocity,
+            motor_speeds[i] * acceleration);
+  }
+  fprintf(out_, "%s\n", msg);
+}
+
+// Steps of a motor at "fraction" after "additions" loops, starting with a
+// zero state: each time the top bit goes from 0 to 1.
+static int64_t steps_after(uint64_t additions, uint32_t fraction) {
+  return (additions * fraction + 0x80000000u) >> 32;
+}
+
+// The PRU delays each loop of an acceleration by the Taylor series
+// c(n) = c * (sqrt(n+1) - sqrt(n)) (with the first one adjusted). Summing
+// that up gives k(t) = (sqrt(n0) + t/c)^2 loops since the virtual start at
+// zero speed, when starting at series index n0. So speed and acceleration
+// are functions of that in closed form, for all motors at once.
+void SimFirmwareQueue::EnqueueClosedForm(const MotionSegment &segment) {
+  const double div = 1.0 * 2147483647u;   // Simulates fixed point div
+  double motor_speeds[MOTION_MOTOR_COUNT];
+  int start_steps[MOTION_MOTOR_COUNT];
+  int direction[MOTION_MOTOR_COUNT];
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    motor_speeds[i] = segment.fractions[i] / div;
+    start_steps[i] = sim_steps_[i];
+    direction[i] = ((1 << i) & segment.direction_bits) ? -1 : 1;
+  }
+
+  // Series factor c in seconds. Same for acceleration and deceleration.
+  double index = segment.accel_series_index;
+  double c = 1.0 * segment.hires_accel_cycles / (1 << DELAY_CYCLE_SHIFT)
+    / (sqrt(index + 1) - sqrt(index)) / TIMER_FREQUENCY;
+  if (index == 0) c /= 0.67605;
+
+  enum Phase { ACCEL, TRAVEL, DECEL };
+  const uint32_t phase_loops[3] = { segment.loops_accel, segment.loops_travel,
+                                    segment.loops_decel };
+  uint64_t loops_done = 0;
+  int steps[MOTION_MOTOR_COUNT];
+  for (int phase = ACCEL; phase <= DECEL; ++phase) {
+    const uint32_t loops = phase_loops[phase];
+    if (loops == 0) continue;
+    const double root_start = sqrt(index);
+    double duration;
+    if (phase == TRAVEL) {
+      duration = 1.0 * loops * segment.travel_delay_cycles / TIMER_FREQUENCY;
+    } else if (phase == ACCEL) {
+      duration = c * (sqrt(index + loops) - root_start);
+    } else {
+      duration = c * (root_start - sqrt(index > loops ? index - loops : 0));
+    }
+    duration += loops * kLoopUpdateTime;
+    const double time_per_loop = duration / loops;
+
+    for (; next_sample_time_ < sim_time_ + duration;
+         next_sample_time_ += sample_interval_) {
+      const double dt = next_sample_time_ - sim_time_;
+      double loops_in_phase, loop_rate, loop_accel;
+      uint32_t delay_loops;
+      if (phase == TRAVEL) {
+        loops_in_phase = dt / time_per_loop;
+        loop_rate = 1 / time_per_loop;
+        loop_accel = 0;
+        delay_loops = segment.travel_delay_cycles;
+      } else {
+        // Without the update time, which only makes this a bit slower.
+        const double t = dt * (duration - loops * kLoopUpdateTime) / duration;
+        const double sign = (phase == ACCEL) ? 1 : -1;
+        const double root = std::max(0.0, root_start + sign * t / c);
+        loops_in_phase = sign * (root * root - index);
+        loop_rate = 2 * root / c;
+        loop_accel = sign * 2 / (c * c);
+        delay_loops = TIMER_FREQUENCY * c * (sqrt(root*root + 1) - root);
+      }
+      const uint64_t additions = loops_done + (uint64_t)loops_in_phase + 1;
+      for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+        steps[i] = start_steps[i]
+          + direction[i] * steps_after(additions, segment.fractions[i]);
+      }
+      PrintSample(dt, delay_loops, steps, motor_speeds,
+                  loop_rate / LOOPS_PER_STEP, loop_accel / LOOPS_PER_STEP, "");
+    }
+    sim_time_ += duration;
+    loops_done += loops;
+    if (phase == ACCEL) index += loops;
+    if (phase == DECEL) index = (index > loops) ? index - loops : 0;
+  }
+
+  // Just like the PRU, we add the fractions one more time when done.
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    sim_steps_[i] = start_steps[i]
+      + direction[i] * steps_after(loops_done + 1, segment.fractions[i]);
+  }
+}
+
+// This simulates what happens in the PRU, loop by loop.
+void SimFirmwareQueue::EnqueueLoops(MotionSegment *segment) {
   // setting output direction according to segment->direction_bits;
 
   bzero(&state, sizeof(state));
@@ -175,15 +304,18 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
   for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
     motor_speeds[i] = segment->fractions[i] / div;
   }
-  const double euklid_factor = euclid(motor_speeds[X_MOTOR],
-                                      motor_speeds[Y_MOTOR],
-                                      motor_speeds[Z_MOTOR]);
-
 #if JERK_EXPERIMENT
   uint32_t jerk_index = 1;
 #endif
   bool is_first = true;
   uint32_t remainder = 0;
+
+  // Arcs: all rising (falling) motors start with the same fraction.
+  uint32_t arc_rise = 0, arc_fall = 0;
+  for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+    if (segment->arc_rise_mask & (1 << i)) arc_rise = segment->fractions[i];
+    if (segment->arc_fall_mask & (1 << i)) arc_fall = segment->fractions[i];
+  }
   const char *msg = "";
 
   for (;;) {
@@ -194,12 +326,24 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
       // Top bit is our step bit. Collect all of these and output to hardware.
       int after = (state.m[i] & 0x80000000) != 0;
       if (!before && after) {  // transition 0->1
-        sim_steps[i] += ((1 << i) & segment->direction_bits) ? -1 : 1;
+        sim_steps_[i] += ((1 << i) & segment->direction_bits) ? -1 : 1;
+      }
+    }
+
+    if (segment->arc_shift > 0) {
+      // Turn the velocity vector for the next loop.
+      const uint32_t fall_delta = arc_rise >> segment->arc_shift;
+      arc_fall -= (fall_delta <= arc_fall) ? fall_delta : arc_fall;
+      arc_rise += arc_fall >> segment->arc_shift;
+      for (int i = 0; i < MOTION_MOTOR_COUNT; ++i) {
+        if (segment->arc_rise_mask & (1 << i)) segment->fractions[i] = arc_rise;
+        if (segment->arc_fall_mask & (1 << i)) segment->fractions[i] = arc_fall;
+        motor_speeds[i] = segment->fractions[i] / div;
       }
     }
 
     msg = "";
-    sim_time += 160e-9;  // Updating the motor takes this time.
+    sim_time_ += kLoopUpdateTime;  // Updating the motor takes this time.
 
     uint32_t delay_loops = 0;
 
@@ -238,8 +382,8 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
       if (segment->loops_accel > 0) {
       if (is_first) {
         msg = "# accel.";
-        fprintf(stderr, "SIM: Accel start _/ : accel-series-idx=%5u, "
-                "accel-timer-cycles=%10.3f (%d loops)\n",
+        if (sample_interval_ == 0) fprintf(stderr, "SIM: Accel start _/ : accel-series-idx=%5u, "
+                "accel-timer-cycles=%10.3f (%u loops)\n",
                 segment->accel_series_index,
                 1.0 * segment->hires_accel_cycles / (1<<DELAY_CYCLE_SHIFT),
                 segment->loops_accel);
@@ -255,7 +399,7 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
       --segment->loops_accel;
       delay_loops = segment->hires_accel_cycles >> DELAY_CYCLE_SHIFT;
       hires_delay = 1.0 * segment->hires_accel_cycles / (1<<DELAY_CYCLE_SHIFT);
-      if (segment->loops_accel == 0) {
+      if (segment->loops_accel == 0 && sample_interval_ == 0) {
         fprintf(stderr, "SIM: Accel end   /‾ : accel-series-idx=%5u, accel-timer-cycles=%10.3f\n",
                 segment->accel_series_index,
                 1.0 * segment->hires_accel_cycles / (1<<DELAY_CYCLE_SHIFT));
@@ -266,7 +410,7 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
       hires_delay = segment->travel_delay_cycles;
       if (is_first) {
         msg = "# travel.";
-        fprintf(stderr, "SIM: travel      -- :                               timer-cycles=%6u     (%d loops)\n", delay_loops,
+        if (sample_interval_ == 0) fprintf(stderr, "SIM: travel      -- :                               timer-cycles=%6u     (%u loops)\n", delay_loops,
                 segment->loops_travel);
         is_first = false;
       }
@@ -275,8 +419,8 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
     else if (segment->loops_decel > 0) {
       if (is_first) {
         msg = "# decel.";
-        fprintf(stderr, "SIM: Decel start ‾\\ : accel-series-idx=%5u, "
-                "decel-timer-cycles=%10.3f (%d loops)\n",
+        if (sample_interval_ == 0) fprintf(stderr, "SIM: Decel start ‾\\ : accel-series-idx=%5u, "
+                "decel-timer-cycles=%10.3f (%u loops)\n",
                 segment->accel_series_index,
                 1.0 * segment->hires_accel_cycles / (1<<DELAY_CYCLE_SHIFT),
                 segment->loops_decel);
@@ -290,7 +434,7 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
       --segment->loops_decel;
       delay_loops = segment->hires_accel_cycles >> DELAY_CYCLE_SHIFT;
       hires_delay = 1.0 * segment->hires_accel_cycles / (1<<DELAY_CYCLE_SHIFT);
-      if (segment->loops_decel == 0) {
+      if (segment->loops_decel == 0 && sample_interval_ == 0) {
         fprintf(stderr, "SIM: Decel end   \\_ : accel-series-idx=%5u, decel-timer-cycles=%10.3f\n",
                 segment->accel_series_index,
                 1.0 * segment->hires_accel_cycles / (1<<DELAY_CYCLE_SHIFT));
@@ -302,31 +446,35 @@ void SimFirmwareQueue::Enqueue(MotionSegment *segment) {
     double wait_time = 1.0 * delay_loops / TIMER_FREQUENCY;
     averager_->PushDeltaTime(1.0 * hires_delay / TIMER_FREQUENCY);
     double acceleration = averager_->GetAcceleration();
-    sim_time += wait_time;
+    sim_time_ += wait_time;
     double velocity = (1 / wait_time) / LOOPS_PER_STEP;  // in Hz.
 
-    // Total time; speed; acceleration; delay_loops. [steps walked for all motors].
-    fprintf(out_, "%12.8f %10d %12.4f %12.4f      ",
-            sim_time, delay_loops,
-            euklid_factor * velocity,
-            euklid_factor * acceleration);
-    for (int i = 0; i < relevant_motors_; ++i) {
-      fprintf(out_, "%5d %10.4f %12.4f ", sim_steps[i],
-              motor_speeds[i] * velocity,
-              motor_speeds[i] * acceleration);
+    if (sample_interval_ > 0) {
+      if (sim_time_ < next_sample_time_) continue;
+      next_sample_time_ += sample_interval_ *
+        (1 + floor((sim_time_ - next_sample_time_) / sample_interval_));
     }
-    fprintf(out_, "%s\n", msg);
+    PrintSample(0, delay_loops, sim_steps_, motor_speeds,
+                velocity, acceleration, msg);
   }
 }
 
 SimFirmwareQueue::SimFirmwareQueue(FILE *out, int relevant_motors)
+  : SimFirmwareQueue(out, relevant_motors, 0) {
+}
+
+SimFirmwareQueue::SimFirmwareQueue(FILE *out, int relevant_motors,
+                                   double sample_interval)
   : out_(out),
     relevant_motors_(relevant_motors < MOTION_MOTOR_COUNT
                      ? relevant_motors
                      : MOTION_MOTOR_COUNT),
-    averager_(new Averager()) {
+    sample_interval_(sample_interval),
+    averager_(new Averager()),
+    sim_time_(0), next_sample_time_(0) {
+  bzero(sim_steps_, sizeof(sim_steps_));
   // Total time; speed; acceleration; delay_loops. [steps walked for all motors].
-  printf("%12s %10s %12s %12s      ", "time", "timer-loop", "Euclid-speed", "Euclid-accel");
+  fprintf(out_, "%12s %10s %12s %12s      ", "time", "timer-loop", "Euclid-speed", "Euclid-accel");
   for (int i = 0; i < relevant_motors_; ++i) {
     fprintf(out_, "%4s%d %9s%d %11s%d ",
             "s", i,
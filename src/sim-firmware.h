@@ -21,9 +21,18 @@
 
 #include <stdio.h>
 
+// Simulates what the PRU does with the motion segments, printing time,
+// speed and acceleration of the motors as columns for gnuplot.
 class SimFirmwareQueue : public MotionQueue {
 public:
+  // Print a line for every loop of the motion queue. That is detailed, but
+  // slow and a lot of output for anything but a short test.
   SimFirmwareQueue(FILE *out, int relevant_motors = MOTION_MOTOR_COUNT);
+
+  // Fast mode: compute each phase of a segment in closed form and only
+  // print a sample every "sample_interval" seconds of simulated time. Fast
+  // enough to run whole jobs. Arcs are still simulated loop by loop.
+  SimFirmwareQueue(FILE *out, int relevant_motors, double sample_interval);
   ~SimFirmwareQueue() override;
 
   void Enqueue(MotionSegment *segment) final;
@@ -36,10 +45,28 @@ public:
     return 1;
   }
 
+  // Simulated time so far in seconds, and steps of the given motor.
+  double sim_time() const { return sim_time_; }
+  int sim_steps(int motor) const { return sim_steps_[motor]; }
+
 private:
   class Averager;
 
+  void EnqueueLoops(MotionSegment *segment);
+  void EnqueueClosedForm(const MotionSegment &segment);
+
+  // Print a line for time "sim_time_ + dt". "steps" are the steps of each
+  // motor, "velocity" and "acceleration" of the defining axis.
+  void PrintSample(double dt, uint32_t delay_loops, const int *steps,
+                   const double *motor_speeds, double velocity,
+                   double acceleration, const char *msg);
+
   FILE *const out_;
   const int relevant_motors_;
+  const double sample_interval_;  // 0 for every loop.
   Averager *const averager_;
+
+  double sim_time_;
+  double next_sample_time_;
+  int sim_steps_[MOTION_MOTOR_COUNT];
 };
@@ -0,0 +1,85 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for the firmware simulation: the fast closed form mode has to agree
+ * with the loop by loop simulation.
+ */
+#include "sim-firmware.h"
+
+#include <stdio.h>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+#include "hardware-mapping.h"
+#include "motor-operations.h"
+
+namespace {
+// Runs the same moves through a loop by loop and a fast simulation.
+class SimComparison {
+public:
+  SimComparison(double sample_interval)
+    : null_out_(fopen("/dev/null", "w")), sample_out_(tmpfile()),
+      loops_(null_out_, 3), fast_(sample_out_, 3, sample_interval),
+      loop_ops_(&hw_, &loops_), fast_ops_(&hw_, &fast_) {
+  }
+  ~SimComparison() {
+    fclose(null_out_);
+    fclose(sample_out_);
+  }
+
+  void Move(float v0, float v1, int x, int y) {
+    LinearSegmentSteps segment = {};
+    segment.v0 = v0;
+    segment.v1 = v1;
+    segment.steps[0] = x;
+    segment.steps[1] = y;
+    loop_ops_.Enqueue(segment);
+    fast_ops_.Enqueue(segment);
+  }
+
+  const SimFirmwareQueue &loops() const { return loops_; }
+  const SimFirmwareQueue &fast() const { return fast_; }
+
+  int SampleLines() {
+    fflush(sample_out_);
+    rewind(sample_out_);
+    int lines = 0;
+    for (int c; (c = fgetc(sample_out_)) != EOF;) {
+      if (c == '\n') ++lines;
+    }
+    return lines - 1;  // Header.
+  }
+
+private:
+  FILE *const null_out_;
+  FILE *const sample_out_;
+  HardwareMapping hw_;
+  SimFirmwareQueue loops_;
+  SimFirmwareQueue fast_;
+  MotionQueueMotorOperations loop_ops_;
+  MotionQueueMotorOperations fast_ops_;
+};
+}  // namespace
+
+TEST(SimFirmware, FastModeAgreesWithLoops) {
+  SimComparison sim(1e-3);
+  sim.Move(0, 2000, 1000, -500);      // Accelerate.
+  sim.Move(2000, 2000, 4000, -2000);  // Travel.
+  sim.Move(2000, 500, 1000, -500);    // Decelerate.
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(sim.loops().sim_steps(i), sim.fast().sim_steps(i));
+  }
+  EXPECT_EQ(6000, sim.fast().sim_steps(0));
+  EXPECT_EQ(-3000, sim.fast().sim_steps(1));
+  EXPECT_NEAR(sim.loops().sim_time(), sim.fast().sim_time(),
+              0.01 * sim.loops().sim_time());
+
+  // One sample per millisecond.
+  EXPECT_NEAR(sim.fast().sim_time() * 1000, sim.SampleLines(), 2);
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/null");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -25,12 +25,17 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <time.h>
 #include <errno.h>
 
+#include <deque>
+#include <initializer_list>
 #include <memory>
+#include <string>
 
+#include "common/fd-mux.h"
 #include "common/logging.h"
 #include "common/string-util.h"
 
@@ -51,8 +56,12 @@ static const int kMaxRPM = 3000;
 static const float kRampEpsilon = 0.1;
 static const int kRampDelayMs = 10;
 
+// Pololu SMC: time between retries if the serial port is busy, and how long
+// to wait for responses.
+static const int kSerialRetryMs = 1;
+static const int kSerialTimeoutMs = 500;
+
 static void sleep_ms(int ms) {
-  // TODO(hzeller): This needs to hook up with the file multiplexer
   if (ms <= 0) return;
   struct timespec req;
   struct timespec rem;
@@ -119,20 +128,82 @@ public:
   virtual void On(bool ccw, int rpm) = 0;
   virtual void Off() = 0;
 
-  // Right now, this sets the output immediately, but we might want to do this
-  // along with the move if this is a laser.
+  void RunAsync(FDMultiplexer *event_server,
+                const std::function<void()> &on_done) final {
+    event_server_ = event_server;
+    on_done_ = on_done;
+  }
+  bool IsBusy() final { return !steps_.empty(); }
+
+  // Right now, this sets the output immediately; the LaserSpindle sets its
+  // outputs along with the moves instead.
   void set_output_synchronous(HardwareMapping::NamedOutput out, bool is_on) {
     hardware_mapping_->UpdateAuxBitmap(out, is_on);
     hardware_mapping_->SetAuxOutputs();
   }
 
 protected:
+  // Spindle changes that take time are a sequence of steps. Each step
+  // runs its action, then waits "delay_ms" before the next. If the action
+  // returns true, it is run again after the delay.
+  typedef std::function<bool()> StepAction;
+  void AddStep(int delay_ms, const StepAction &action) {
+    steps_.push_back({ action, delay_ms });
+  }
+
+  // Run the steps added so far; blocking or in timers if RunAsync().
+  void RunSteps() {
+    if (timer_ < 0) ContinueSteps();
+  }
+
+  // Steps only make sense on a known state, so before planning a new
+  // change, we finish a previous one that is still in progress.
+  void FinishSteps() {
+    if (timer_ >= 0) {
+      event_server_->CancelTimer(timer_);
+      timer_ = -1;
+    }
+    FDMultiplexer *const event_server = event_server_;
+    event_server_ = nullptr;  // Run synchronously.
+    ContinueSteps();
+    event_server_ = event_server;
+  }
+
   const SpindleConfig config_;
   HardwareMapping *const hardware_mapping_;
 
   bool is_off_ = true;
   bool is_ccw_ = false;
   float duty_cycle_ = 0;
+
+private:
+  struct Step {
+    StepAction action;
+    int delay_ms;
+  };
+
+  void ContinueSteps() {
+    while (!steps_.empty()) {
+      Step &step = steps_.front();
+      const int delay_ms = step.delay_ms;
+      if (!step.action()) steps_.pop_front();
+      if (event_server_ && delay_ms > 0) {
+        timer_ = event_server_->RunAfter(delay_ms * 1000, [this]() {
+            timer_ = -1;
+            ContinueSteps();
+            return false;
+          });
+        return;
+      }
+      sleep_ms(delay_ms);
+    }
+    if (event_server_ && on_done_) on_done_();
+  }
+
+  FDMultiplexer *event_server_ = nullptr;
+  std::function<void()> on_done_;
+  std::deque<Step> steps_;
+  int timer_ = -1;
 };
 
 class PWMSpindle : public BaseSpindle {
@@ -166,63 +237,113 @@ public:
       Log_debug("Spindle: ccw rotation is not allowed");
       return;
     }
+    FinishSteps();
 
     // Turn on spindle power if necessary.
-    if (is_off_) {
-      set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, true);
-      sleep_ms(config_.pwr_delay_ms);
+    const bool was_off = is_off_;
+    if (was_off) {
+      AddStep(config_.pwr_delay_ms, [this]() {
+          set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, true);
+          return false;
+        });
     }
 
     // direction change? ramp down spindle
-    if (ccw != is_ccw_) ramp_down();
+    float duty_cycle = duty_cycle_;
+    if (ccw != is_ccw_) {
+      ramp_to(duty_cycle, 0);
+      duty_cycle = 0;
+    }
 
     // set the spindle direction
-    set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE_DIRECTION, ccw);
-    is_ccw_ = ccw;
+    AddStep(0, [this, ccw]() {
+        set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE_DIRECTION,
+                               ccw);
+        is_ccw_ = ccw;
+        return false;
+      });
 
     // ramp the spindle to the target speed
-    const float target = std::min((float)rpm / config_.max_rpm, 1.0f);
-    const float epsilon = (duty_cycle_ < target) ? kRampEpsilon : -kRampEpsilon;
-    while (duty_cycle_ != target) {
-      duty_cycle_ += epsilon;
-      if ((epsilon < 0 && duty_cycle_ < target) ||
-          (epsilon > 0 && duty_cycle_ > target))
-        duty_cycle_ = target;
-      hardware_mapping_->SetPWMOutput(HardwareMapping::NamedOutput::SPINDLE_SPEED,
-                                      duty_cycle_);
-      sleep_ms(kRampDelayMs);
-    }
+    ramp_to(duty_cycle, std::min((float)rpm / config_.max_rpm, 1.0f));
 
     // optionally delay before continuing
-    if (is_off_) {
-      sleep_ms(config_.on_delay_ms);
-      is_off_ = false;
+    if (was_off) {
+      AddStep(config_.on_delay_ms, [this]() { is_off_ = false; return false; });
     }
 
-    Log_debug("PWMSpindle: on %s at %d RPM (duty_cycle: %f)",
-              ccw ? "ccw" : "cw",
-              (int)(config_.max_rpm * duty_cycle_), duty_cycle_);
+    AddStep(0, [this]() {
+        Log_debug("PWMSpindle: on %s at %d RPM (duty_cycle: %f)",
+                  is_ccw_ ? "ccw" : "cw",
+                  (int)(config_.max_rpm * duty_cycle_), duty_cycle_);
+        return false;
+      });
+    RunSteps();
   }
 
   void Off() final {
-    ramp_down();
-    sleep_ms(config_.off_delay_ms);
-    set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, false);
-    is_off_ = true;
-    Log_debug("PWMSpindle: off");
+    FinishSteps();
+    ramp_to(duty_cycle_, 0);
+    AddStep(config_.off_delay_ms, []() { return false; });
+    AddStep(0, [this]() {
+        set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, false);
+        is_off_ = true;
+        Log_debug("PWMSpindle: off");
+        return false;
+      });
+    RunSteps();
   }
 
 private:
-  void ramp_down() {
-    while (duty_cycle_ > 0) {
-      if (duty_cycle_ >= kRampEpsilon)
-        duty_cycle_ -= kRampEpsilon;
-      else
-        duty_cycle_ = 0;
-      hardware_mapping_->SetPWMOutput(HardwareMapping::NamedOutput::SPINDLE_SPEED,
-                                      duty_cycle_);
-      sleep_ms(kRampDelayMs);
+  // Ramp the PWM duty cycle from "start" to "target" in kRampEpsilon steps.
+  void ramp_to(float start, float target) {
+    if (start == target) return;
+    AddStep(kRampDelayMs, [this, target]() {
+        if (duty_cycle_ < target)
+          duty_cycle_ = std::min(duty_cycle_ + kRampEpsilon, target);
+        else
+          duty_cycle_ = std::max(duty_cycle_ - kRampEpsilon, target);
+        hardware_mapping_->SetPWMOutput(
+          HardwareMapping::NamedOutput::SPINDLE_SPEED, duty_cycle_);
+        return duty_cycle_ != target;
+      });
+  }
+};
+
+// A spindle that follows changes right away, such as a laser. There are no
+// ramps or delays: the outputs are set along with the moves, so that the
+// power changes exactly where the G-code asks for it.
+class LaserSpindle : public BaseSpindle {
+public:
+  LaserSpindle(const SpindleConfig &config, HardwareMapping *hardware_mapping)
+    : BaseSpindle(config, hardware_mapping) {
+    Log_debug("LaserSpindle");
+  }
+
+  bool IsSynchronous() final { return true; }
+
+  void On(bool ccw, int rpm) final {
+    if (!config_.allow_ccw && ccw) {
+      Log_debug("Spindle: ccw rotation is not allowed");
+      return;
     }
+    duty_cycle_ = std::min((float)rpm / config_.max_rpm, 1.0f);
+    hardware_mapping_->UpdateAuxBitmap(HardwareMapping::NamedOutput::SPINDLE,
+                                       true);
+    hardware_mapping_->UpdateAuxBitmap(
+      HardwareMapping::NamedOutput::SPINDLE_DIRECTION, ccw);
+    hardware_mapping_->UpdatePWMOutput(
+      HardwareMapping::NamedOutput::SPINDLE_SPEED, duty_cycle_);
+    is_off_ = false;
+    is_ccw_ = ccw;
+  }
+
+  void Off() final {
+    duty_cycle_ = 0;
+    hardware_mapping_->UpdateAuxBitmap(HardwareMapping::NamedOutput::SPINDLE,
+                                       false);
+    hardware_mapping_->UpdatePWMOutput(
+      HardwareMapping::NamedOutput::SPINDLE_SPEED, 0);
+    is_off_ = true;
   }
 };
 
@@ -326,7 +447,7 @@ public:
   }
 
   ~PololuSMCSpindle() {
-    if (fd_) close(fd_);
+    if (fd_ >= 0) close(fd_);
   }
 
   // Litmus test before constructing.
@@ -354,10 +475,16 @@ public:
     options.c_oflag &= ~(ONLCR | OCRNL);
     tcsetattr(fd_, TCSANOW, &options);
 
+    // From here on, we never block on the serial port: if it is not ready,
+    // a command is retried in the next step.
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+
     const unsigned char command = CMD_GET_FIRMWARE_VER;
-    send(&command, 1);
+    if (!send_all(&command, 1))
+      return false;
     unsigned char response[4];
-    receive(response, 4);
+    if (!receive(response, 4))
+      return false;
     Log_debug("PololuSMCSpindle: initialized  ProductID:0x%04x  Firmware:%d.%d\n",
            response[0] + 256 * response[1], response[3], response[2]);
 
@@ -373,64 +500,116 @@ public:
       Log_debug("Spindle: ccw rotation is not allowed");
       return;
     }
-
-    if (is_off_) {
-      set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, true);
-      sleep_ms(config_.pwr_delay_ms);
-      exit_safe_start();
+    FinishSteps();
+
+    const bool was_off = is_off_;
+    if (was_off) {
+      AddStep(config_.pwr_delay_ms, [this]() {
+          set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, true);
+          return false;
+        });
+      AddSendStep({ CMD_EXIT_SAFE_START });
     }
 
     // scale the desired RPM to the MAX_SPEED of the SMC
-    int speed = std::min(rpm * MAX_SPEED / config_.max_rpm, (int)MAX_SPEED);
-
-    unsigned char command[3];
-    command[0] = (ccw) ? CMD_MOTOR_REVERSE : CMD_MOTOR_FORWARD;
-    command[1] = speed & 0x1f;
-    command[2] = (speed >> 5) & 0x7f;
-    send(command, sizeof(command));
-
-    if (is_off_) {
-      sleep_ms(config_.on_delay_ms);
-      is_off_ = false;
+    const int speed = std::min(rpm * MAX_SPEED / config_.max_rpm,
+                               (int)MAX_SPEED);
+    AddSendStep({ (unsigned char)(ccw ? CMD_MOTOR_REVERSE : CMD_MOTOR_FORWARD),
+                  (unsigned char)(speed & 0x1f),
+                  (unsigned char)((speed >> 5) & 0x7f) });
+
+    // The controller ramps on its own; this is the time to reach speed.
+    if (was_off) {
+      AddStep(config_.on_delay_ms, [this]() { is_off_ = false; return false; });
     }
 
-    float duty_cycle = std::min((float)rpm / config_.max_rpm, 1.0f);
-    Log_debug("PololuSMCSpindle: on %s at %d RPM (speed: %d)",
-              ccw ? "ccw" : "cw", (int)(config_.max_rpm * duty_cycle), speed);
+    AddStep(0, [this, ccw, rpm, speed]() {
+        const float duty_cycle = std::min((float)rpm / config_.max_rpm, 1.0f);
+        Log_debug("PololuSMCSpindle: on %s at %d RPM (speed: %d)",
+                  ccw ? "ccw" : "cw", (int)(config_.max_rpm * duty_cycle),
+                  speed);
+        return false;
+      });
+    RunSteps();
   }
 
-  void Off() {
+  void Off() final {
     if (fd_ == -1) return;
 
-    const unsigned char command = CMD_STOP_MOTOR;
-    send(&command, 1);
-
-    sleep_ms(config_.off_delay_ms);
-    set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, false);
-    is_off_ = true;
-    Log_debug("PololuSMCSpindle: off");
+    FinishSteps();
+    AddSendStep({ CMD_STOP_MOTOR });
+    AddStep(config_.off_delay_ms, []() { return false; });
+    AddStep(0, [this]() {
+        set_output_synchronous(HardwareMapping::NamedOutput::SPINDLE, false);
+        is_off_ = true;
+        Log_debug("PololuSMCSpindle: off");
+        return false;
+      });
+    RunSteps();
   }
 
 private:
-  void exit_safe_start() {
-    const unsigned char command = CMD_EXIT_SAFE_START;
-    send(&command, 1);
+  // Add a step that sends "command". If the serial port can't take all of
+  // it right now, the rest is sent in a retry of the step.
+  void AddSendStep(std::initializer_list<unsigned char> command) {
+    std::shared_ptr<std::string> pending(
+      new std::string(command.begin(), command.end()));
+    AddStep(kSerialRetryMs, [this, pending]() {
+        const ssize_t sent = write(fd_, pending->data(), pending->size());
+        if (sent < 0) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return true;
+          Log_error("PololuSMCSpindle: send() error: %s", strerror(errno));
+          return false;  // Give up on this command.
+        }
+        pending->erase(0, sent);
+        return !pending->empty();
+      });
   }
 
-  void send(const void *buf, int count) {
-    int sent = write(fd_, buf, count);
-    if (sent == -1)
-      perror("PololuSMCSpindle: send() error");
-    else if (sent != count)
-      Log_debug("PololuSMCSpindle: send() short write %d of %d bytes", sent, count);
+  // Only used in Init(), before anything runs: blocks until all is sent.
+  bool send_all(const unsigned char *buf, int count) {
+    while (count > 0) {
+      if (!wait_for(POLLOUT)) {
+        Log_error("PololuSMCSpindle: timeout sending.");
+        return false;
+      }
+      const ssize_t sent = write(fd_, buf, count);
+      if (sent < 0) {
+        if (errno == EAGAIN || errno == EINTR) continue;
+        Log_error("PololuSMCSpindle: send() error: %s", strerror(errno));
+        return false;
+      }
+      buf += sent;
+      count -= sent;
+    }
+    return true;
+  }
+
+  // Only used in Init(): read "count" bytes, waiting at most
+  // kSerialTimeoutMs for each part of the response.
+  bool receive(unsigned char *buf, int count) {
+    while (count > 0) {
+      if (!wait_for(POLLIN)) {
+        Log_error("PololuSMCSpindle: timeout waiting for response.");
+        return false;
+      }
+      const ssize_t got = read(fd_, buf, count);
+      if (got < 0) {
+        if (errno == EAGAIN || errno == EINTR) continue;
+        Log_error("PololuSMCSpindle: receive() error: %s", strerror(errno));
+        return false;
+      }
+      if (got == 0) return false;
+      buf += got;
+      count -= got;
+    }
+    return true;
   }
 
-  void receive(void *buf, int count) {
-    int got = read(fd_, buf, count);
-    if (got == -1)
-      perror("PololuSMCSpindle: receive() error");
-    else if (got != count)
-      Log_debug("PololuSMCSpindle: receive() short read %d of %d bytes", got, count);
+  bool wait_for(short events) {
+    struct pollfd p = { fd_, events, 0 };
+    return poll(&p, 1, kSerialTimeoutMs) > 0;
   }
 
   int fd_;
@@ -449,6 +628,10 @@ Spindle *Spindle::CreateFromConfig(const SpindleConfig &config,
       PWMSpindle::CheckRequiredHardware(config, hardware_mapping)) {
     spindle.reset(new PWMSpindle(config, hardware_mapping));
   }
+  else if (config.type == "laser" &&
+           PWMSpindle::CheckRequiredHardware(config, hardware_mapping)) {
+    spindle.reset(new LaserSpindle(config, hardware_mapping));
+  }
   else if (config.type == "pololu-smc" &&
            PololuSMCSpindle::CheckRequiredHardware(config, hardware_mapping)) {
     spindle.reset(new PololuSMCSpindle(config, hardware_mapping));
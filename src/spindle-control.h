@@ -20,10 +20,13 @@
 #ifndef BEAGLEG_SPINDLE_CONTROL_
 #define BEAGLEG_SPINDLE_CONTROL_
 
+#include <functional>
+
 #include "common/string-util.h"
 
 class HardwareMapping;
 class ConfigParser;
+class FDMultiplexer;
 
 // Spindle configuration as read from config file.
 struct SpindleConfig {
@@ -57,6 +60,19 @@ public:
 
    // Turn spindle off (M5)
   virtual void Off() = 0;
+
+  // By default, On() and Off() block while the spindle ramps or waits for
+  // the configured delays. With an "event_server", they return right away
+  // and the change continues in timers; IsBusy() returns true until then and
+  // "on_done" is called when finished.
+  virtual void RunAsync(FDMultiplexer *event_server,
+                        const std::function<void()> &on_done) {}
+  virtual bool IsBusy() { return false; }
+
+  // Returns true if On() and Off() only update the buffered outputs, which
+  // are set along with the next move. Then, there is no need to bring the
+  // path to a halt before switching.
+  virtual bool IsSynchronous() { return false; }
 };
 
 #endif  // BEAGLEG_SPINDLE_CONTROL_
@@ -0,0 +1,925 @@
+; Engraving workload: horizontal hatch filling a flower outline,
+; then the outline itself in short segments.
+G21
+G90
+G0 Z1 F1200
+G0 X67.411 Y19.500 F6000
+G1 Z-0.1 F600
+G1 X65.441 F2400
+G0 Z1
+G0 X34.559 Y19.500 F6000
+G1 Z-0.1 F600
+G1 X32.589 F2400
+G0 Z1
+G0 X30.453 Y20.000 F6000
+G1 Z-0.1 F600
+G1 X37.113 F2400
+G0 Z1
+G0 X62.887 Y20.000 F6000
+G1 Z-0.1 F600
+G1 X69.547 F2400
+G0 Z1
+G0 X70.584 Y20.500 F6000
+G1 Z-0.1 F600
+G1 X61.419 F2400
+G0 Z1
+G0 X38.581 Y20.500 F6000
+G1 Z-0.1 F600
+G1 X29.416 F2400
+G0 Z1
+G0 X28.676 Y21.000 F6000
+G1 Z-0.1 F600
+G1 X39.762 F2400
+G0 Z1
+G0 X60.238 Y21.000 F6000
+G1 Z-0.1 F600
+G1 X71.324 F2400
+G0 Z1
+G0 X71.904 Y21.500 F6000
+G1 Z-0.1 F600
+G1 X59.209 F2400
+G0 Z1
+G0 X40.791 Y21.500 F6000
+G1 Z-0.1 F600
+G1 X28.096 F2400
+G0 Z1
+G0 X27.626 Y22.000 F6000
+G1 Z-0.1 F600
+G1 X41.726 F2400
+G0 Z1
+G0 X58.274 Y22.000 F6000
+G1 Z-0.1 F600
+G1 X72.374 F2400
+G0 Z1
+G0 X72.767 Y22.500 F6000
+G1 Z-0.1 F600
+G1 X57.401 F2400
+G0 Z1
+G0 X42.599 Y22.500 F6000
+G1 Z-0.1 F600
+G1 X27.233 F2400
+G0 Z1
+G0 X26.900 Y23.000 F6000
+G1 Z-0.1 F600
+G1 X43.432 F2400
+G0 Z1
+G0 X56.568 Y23.000 F6000
+G1 Z-0.1 F600
+G1 X73.100 F2400
+G0 Z1
+G0 X73.381 Y23.500 F6000
+G1 Z-0.1 F600
+G1 X55.758 F2400
+G0 Z1
+G0 X44.242 Y23.500 F6000
+G1 Z-0.1 F600
+G1 X26.619 F2400
+G0 Z1
+G0 X26.380 Y24.000 F6000
+G1 Z-0.1 F600
+G1 X45.047 F2400
+G0 Z1
+G0 X54.953 Y24.000 F6000
+G1 Z-0.1 F600
+G1 X73.620 F2400
+G0 Z1
+G0 X73.825 Y24.500 F6000
+G1 Z-0.1 F600
+G1 X54.130 F2400
+G0 Z1
+G0 X45.870 Y24.500 F6000
+G1 Z-0.1 F600
+G1 X26.175 F2400
+G0 Z1
+G0 X26.004 Y25.000 F6000
+G1 Z-0.1 F600
+G1 X46.751 F2400
+G0 Z1
+G0 X53.249 Y25.000 F6000
+G1 Z-0.1 F600
+G1 X73.996 F2400
+G0 Z1
+G0 X74.141 Y25.500 F6000
+G1 Z-0.1 F600
+G1 X52.214 F2400
+G0 Z1
+G0 X47.786 Y25.500 F6000
+G1 Z-0.1 F600
+G1 X25.859 F2400
+G0 Z1
+G0 X25.740 Y26.000 F6000
+G1 Z-0.1 F600
+G1 X74.260 F2400
+G0 Z1
+G0 X74.357 Y26.500 F6000
+G1 Z-0.1 F600
+G1 X25.643 F2400
+G0 Z1
+G0 X25.568 Y27.000 F6000
+G1 Z-0.1 F600
+G1 X74.432 F2400
+G0 Z1
+G0 X74.489 Y27.500 F6000
+G1 Z-0.1 F600
+G1 X25.511 F2400
+G0 Z1
+G0 X25.472 Y28.000 F6000
+G1 Z-0.1 F600
+G1 X74.528 F2400
+G0 Z1
+G0 X74.550 Y28.500 F6000
+G1 Z-0.1 F600
+G1 X25.450 F2400
+G0 Z1
+G0 X25.442 Y29.000 F6000
+G1 Z-0.1 F600
+G1 X74.558 F2400
+G0 Z1
+G0 X74.550 Y29.500 F6000
+G1 Z-0.1 F600
+G1 X25.450 F2400
+G0 Z1
+G0 X25.471 Y30.000 F6000
+G1 Z-0.1 F600
+G1 X74.529 F2400
+G0 Z1
+G0 X74.496 Y30.500 F6000
+G1 Z-0.1 F600
+G1 X25.504 F2400
+G0 Z1
+G0 X25.550 Y31.000 F6000
+G1 Z-0.1 F600
+G1 X74.450 F2400
+G0 Z1
+G0 X74.393 Y31.500 F6000
+G1 Z-0.1 F600
+G1 X25.607 F2400
+G0 Z1
+G0 X25.674 Y32.000 F6000
+G1 Z-0.1 F600
+G1 X74.326 F2400
+G0 Z1
+G0 X74.248 Y32.500 F6000
+G1 Z-0.1 F600
+G1 X25.752 F2400
+G0 Z1
+G0 X25.837 Y33.000 F6000
+G1 Z-0.1 F600
+G1 X74.163 F2400
+G0 Z1
+G0 X74.069 Y33.500 F6000
+G1 Z-0.1 F600
+G1 X25.931 F2400
+G0 Z1
+G0 X26.033 Y34.000 F6000
+G1 Z-0.1 F600
+G1 X73.967 F2400
+G0 Z1
+G0 X73.859 Y34.500 F6000
+G1 Z-0.1 F600
+G1 X26.141 F2400
+G0 Z1
+G0 X26.255 Y35.000 F6000
+G1 Z-0.1 F600
+G1 X73.745 F2400
+G0 Z1
+G0 X73.627 Y35.500 F6000
+G1 Z-0.1 F600
+G1 X26.373 F2400
+G0 Z1
+G0 X26.494 Y36.000 F6000
+G1 Z-0.1 F600
+G1 X73.506 F2400
+G0 Z1
+G0 X26.741 Y37.000 F6000
+G1 Z-0.1 F600
+G1 X73.259 F2400
+G0 Z1
+G0 X73.137 Y37.500 F6000
+G1 Z-0.1 F600
+G1 X26.863 F2400
+G0 Z1
+G0 X26.981 Y38.000 F6000
+G1 Z-0.1 F600
+G1 X73.019 F2400
+G0 Z1
+G0 X72.908 Y38.500 F6000
+G1 Z-0.1 F600
+G1 X27.092 F2400
+G0 Z1
+G0 X27.193 Y39.000 F6000
+G1 Z-0.1 F600
+G1 X72.807 F2400
+G0 Z1
+G0 X72.719 Y39.500 F6000
+G1 Z-0.1 F600
+G1 X27.281 F2400
+G0 Z1
+G0 X27.351 Y40.000 F6000
+G1 Z-0.1 F600
+G1 X72.649 F2400
+G0 Z1
+G0 X72.604 Y40.500 F6000
+G1 Z-0.1 F600
+G1 X27.396 F2400
+G0 Z1
+G0 X27.412 Y41.000 F6000
+G1 Z-0.1 F600
+G1 X72.588 F2400
+G0 Z1
+G0 X72.610 Y41.500 F6000
+G1 Z-0.1 F600
+G1 X27.390 F2400
+G0 Z1
+G0 X27.322 Y42.000 F6000
+G1 Z-0.1 F600
+G1 X72.678 F2400
+G0 Z1
+G0 X72.800 Y42.500 F6000
+G1 Z-0.1 F600
+G1 X27.200 F2400
+G0 Z1
+G0 X27.016 Y43.000 F6000
+G1 Z-0.1 F600
+G1 X72.984 F2400
+G0 Z1
+G0 X73.237 Y43.500 F6000
+G1 Z-0.1 F600
+G1 X26.763 F2400
+G0 Z1
+G0 X26.439 Y44.000 F6000
+G1 Z-0.1 F600
+G1 X73.561 F2400
+G0 Z1
+G0 X73.955 Y44.500 F6000
+G1 Z-0.1 F600
+G1 X26.045 F2400
+G0 Z1
+G0 X25.588 Y45.000 F6000
+G1 Z-0.1 F600
+G1 X74.412 F2400
+G0 Z1
+G0 X74.923 Y45.500 F6000
+G1 Z-0.1 F600
+G1 X25.077 F2400
+G0 Z1
+G0 X24.526 Y46.000 F6000
+G1 Z-0.1 F600
+G1 X75.474 F2400
+G0 Z1
+G0 X76.051 Y46.500 F6000
+G1 Z-0.1 F600
+G1 X23.949 F2400
+G0 Z1
+G0 X23.359 Y47.000 F6000
+G1 Z-0.1 F600
+G1 X76.641 F2400
+G0 Z1
+G0 X77.234 Y47.500 F6000
+G1 Z-0.1 F600
+G1 X22.766 F2400
+G0 Z1
+G0 X22.179 Y48.000 F6000
+G1 Z-0.1 F600
+G1 X77.821 F2400
+G0 Z1
+G0 X78.395 Y48.500 F6000
+G1 Z-0.1 F600
+G1 X21.605 F2400
+G0 Z1
+G0 X21.048 Y49.000 F6000
+G1 Z-0.1 F600
+G1 X78.952 F2400
+G0 Z1
+G0 X79.488 Y49.500 F6000
+G1 Z-0.1 F600
+G1 X20.512 F2400
+G0 Z1
+G0 X80.487 Y50.500 F6000
+G1 Z-0.1 F600
+G1 X19.513 F2400
+G0 Z1
+G0 X19.052 Y51.000 F6000
+G1 Z-0.1 F600
+G1 X80.948 F2400
+G0 Z1
+G0 X81.382 Y51.500 F6000
+G1 Z-0.1 F600
+G1 X18.618 F2400
+G0 Z1
+G0 X18.210 Y52.000 F6000
+G1 Z-0.1 F600
+G1 X81.790 F2400
+G0 Z1
+G0 X82.171 Y52.500 F6000
+G1 Z-0.1 F600
+G1 X17.829 F2400
+G0 Z1
+G0 X17.476 Y53.000 F6000
+G1 Z-0.1 F600
+G1 X82.524 F2400
+G0 Z1
+G0 X82.850 Y53.500 F6000
+G1 Z-0.1 F600
+G1 X17.150 F2400
+G0 Z1
+G0 X16.851 Y54.000 F6000
+G1 Z-0.1 F600
+G1 X83.149 F2400
+G0 Z1
+G0 X83.419 Y54.500 F6000
+G1 Z-0.1 F600
+G1 X16.581 F2400
+G0 Z1
+G0 X16.336 Y55.000 F6000
+G1 Z-0.1 F600
+G1 X83.664 F2400
+G0 Z1
+G0 X83.879 Y55.500 F6000
+G1 Z-0.1 F600
+G1 X16.121 F2400
+G0 Z1
+G0 X15.932 Y56.000 F6000
+G1 Z-0.1 F600
+G1 X84.068 F2400
+G0 Z1
+G0 X84.226 Y56.500 F6000
+G1 Z-0.1 F600
+G1 X15.774 F2400
+G0 Z1
+G0 X15.641 Y57.000 F6000
+G1 Z-0.1 F600
+G1 X84.359 F2400
+G0 Z1
+G0 X84.459 Y57.500 F6000
+G1 Z-0.1 F600
+G1 X15.541 F2400
+G0 Z1
+G0 X15.468 Y58.000 F6000
+G1 Z-0.1 F600
+G1 X84.532 F2400
+G0 Z1
+G0 X84.573 Y58.500 F6000
+G1 Z-0.1 F600
+G1 X15.427 F2400
+G0 Z1
+G0 X15.417 Y59.000 F6000
+G1 Z-0.1 F600
+G1 X84.583 F2400
+G0 Z1
+G0 X84.559 Y59.500 F6000
+G1 Z-0.1 F600
+G1 X15.441 F2400
+G0 Z1
+G0 X15.498 Y60.000 F6000
+G1 Z-0.1 F600
+G1 X84.502 F2400
+G0 Z1
+G0 X84.409 Y60.500 F6000
+G1 Z-0.1 F600
+G1 X15.591 F2400
+G0 Z1
+G0 X15.725 Y61.000 F6000
+G1 Z-0.1 F600
+G1 X84.275 F2400
+G0 Z1
+G0 X84.103 Y61.500 F6000
+G1 Z-0.1 F600
+G1 X15.897 F2400
+G0 Z1
+G0 X16.113 Y62.000 F6000
+G1 Z-0.1 F600
+G1 X83.887 F2400
+G0 Z1
+G0 X83.620 Y62.500 F6000
+G1 Z-0.1 F600
+G1 X16.380 F2400
+G0 Z1
+G0 X16.700 Y63.000 F6000
+G1 Z-0.1 F600
+G1 X83.300 F2400
+G0 Z1
+G0 X82.921 Y63.500 F6000
+G1 Z-0.1 F600
+G1 X17.079 F2400
+G0 Z1
+G0 X17.526 Y64.000 F6000
+G1 Z-0.1 F600
+G1 X82.474 F2400
+G0 Z1
+G0 X81.947 Y64.500 F6000
+G1 Z-0.1 F600
+G1 X18.053 F2400
+G0 Z1
+G0 X18.675 Y65.000 F6000
+G1 Z-0.1 F600
+G1 X81.325 F2400
+G0 Z1
+G0 X80.583 Y65.500 F6000
+G1 Z-0.1 F600
+G1 X19.417 F2400
+G0 Z1
+G0 X20.313 Y66.000 F6000
+G1 Z-0.1 F600
+G1 X79.687 F2400
+G0 Z1
+G0 X22.870 Y67.000 F6000
+G1 Z-0.1 F600
+G1 X77.130 F2400
+G0 Z1
+G0 X75.040 Y67.500 F6000
+G1 Z-0.1 F600
+G1 X24.960 F2400
+G0 Z1
+G0 X29.035 Y68.000 F6000
+G1 Z-0.1 F600
+G1 X70.965 F2400
+G0 Z1
+G0 X66.277 Y68.500 F6000
+G1 Z-0.1 F600
+G1 X33.723 F2400
+G0 Z1
+G0 X35.199 Y69.000 F6000
+G1 Z-0.1 F600
+G1 X64.801 F2400
+G0 Z1
+G0 X63.997 Y69.500 F6000
+G1 Z-0.1 F600
+G1 X36.003 F2400
+G0 Z1
+G0 X36.554 Y70.000 F6000
+G1 Z-0.1 F600
+G1 X63.446 F2400
+G0 Z1
+G0 X63.027 Y70.500 F6000
+G1 Z-0.1 F600
+G1 X36.973 F2400
+G0 Z1
+G0 X37.315 Y71.000 F6000
+G1 Z-0.1 F600
+G1 X62.685 F2400
+G0 Z1
+G0 X62.392 Y71.500 F6000
+G1 Z-0.1 F600
+G1 X37.608 F2400
+G0 Z1
+G0 X37.868 Y72.000 F6000
+G1 Z-0.1 F600
+G1 X62.132 F2400
+G0 Z1
+G0 X61.895 Y72.500 F6000
+G1 Z-0.1 F600
+G1 X38.105 F2400
+G0 Z1
+G0 X38.328 Y73.000 F6000
+G1 Z-0.1 F600
+G1 X61.672 F2400
+G0 Z1
+G0 X61.459 Y73.500 F6000
+G1 Z-0.1 F600
+G1 X38.541 F2400
+G0 Z1
+G0 X38.747 Y74.000 F6000
+G1 Z-0.1 F600
+G1 X61.253 F2400
+G0 Z1
+G0 X61.049 Y74.500 F6000
+G1 Z-0.1 F600
+G1 X38.951 F2400
+G0 Z1
+G0 X39.154 Y75.000 F6000
+G1 Z-0.1 F600
+G1 X60.846 F2400
+G0 Z1
+G0 X60.641 Y75.500 F6000
+G1 Z-0.1 F600
+G1 X39.359 F2400
+G0 Z1
+G0 X39.567 Y76.000 F6000
+G1 Z-0.1 F600
+G1 X60.433 F2400
+G0 Z1
+G0 X60.219 Y76.500 F6000
+G1 Z-0.1 F600
+G1 X39.781 F2400
+G0 Z1
+G0 X40.001 Y77.000 F6000
+G1 Z-0.1 F600
+G1 X59.999 F2400
+G0 Z1
+G0 X59.772 Y77.500 F6000
+G1 Z-0.1 F600
+G1 X40.228 F2400
+G0 Z1
+G0 X40.466 Y78.000 F6000
+G1 Z-0.1 F600
+G1 X59.534 F2400
+G0 Z1
+G0 X59.286 Y78.500 F6000
+G1 Z-0.1 F600
+G1 X40.714 F2400
+G0 Z1
+G0 X40.975 Y79.000 F6000
+G1 Z-0.1 F600
+G1 X59.025 F2400
+G0 Z1
+G0 X58.751 Y79.500 F6000
+G1 Z-0.1 F600
+G1 X41.249 F2400
+G0 Z1
+G0 X41.540 Y80.000 F6000
+G1 Z-0.1 F600
+G1 X58.460 F2400
+G0 Z1
+G0 X58.152 Y80.500 F6000
+G1 Z-0.1 F600
+G1 X41.848 F2400
+G0 Z1
+G0 X42.178 Y81.000 F6000
+G1 Z-0.1 F600
+G1 X57.822 F2400
+G0 Z1
+G0 X57.468 Y81.500 F6000
+G1 Z-0.1 F600
+G1 X42.532 F2400
+G0 Z1
+G0 X42.912 Y82.000 F6000
+G1 Z-0.1 F600
+G1 X57.088 F2400
+G0 Z1
+G0 X56.672 Y82.500 F6000
+G1 Z-0.1 F600
+G1 X43.328 F2400
+G0 Z1
+G0 X43.783 Y83.000 F6000
+G1 Z-0.1 F600
+G1 X56.217 F2400
+G0 Z1
+G0 X55.712 Y83.500 F6000
+G1 Z-0.1 F600
+G1 X44.288 F2400
+G0 Z1
+G0 X80.000 Y50.000 F6000
+G1 Z-0.3 F600
+G1 X80.518 Y50.533 F1500
+G1 X81.023 Y51.083 F1500
+G1 X81.510 Y51.651 F1500
+G1 X81.974 Y52.236 F1500
+G1 X82.412 Y52.836 F1500
+G1 X82.819 Y53.449 F1500
+G1 X83.192 Y54.075 F1500
+G1 X83.527 Y54.712 F1500
+G1 X83.821 Y55.357 F1500
+G1 X84.071 Y56.008 F1500
+G1 X84.273 Y56.662 F1500
+G1 X84.427 Y57.318 F1500
+G1 X84.530 Y57.972 F1500
+G1 X84.580 Y58.622 F1500
+G1 X84.576 Y59.265 F1500
+G1 X84.518 Y59.898 F1500
+G1 X84.405 Y60.519 F1500
+G1 X84.238 Y61.125 F1500
+G1 X84.017 Y61.713 F1500
+G1 X83.743 Y62.282 F1500
+G1 X83.418 Y62.828 F1500
+G1 X83.043 Y63.350 F1500
+G1 X82.621 Y63.847 F1500
+G1 X82.153 Y64.316 F1500
+G1 X81.644 Y64.756 F1500
+G1 X81.095 Y65.166 F1500
+G1 X80.510 Y65.546 F1500
+G1 X79.894 Y65.895 F1500
+G1 X79.249 Y66.213 F1500
+G1 X78.579 Y66.500 F1500
+G1 X77.889 Y66.757 F1500
+G1 X77.182 Y66.985 F1500
+G1 X76.463 Y67.185 F1500
+G1 X75.735 Y67.358 F1500
+G1 X75.003 Y67.507 F1500
+G1 X74.271 Y67.634 F1500
+G1 X73.541 Y67.740 F1500
+G1 X72.819 Y67.828 F1500
+G1 X72.108 Y67.902 F1500
+G1 X71.409 Y67.965 F1500
+G1 X70.728 Y68.018 F1500
+G1 X70.065 Y68.067 F1500
+G1 X69.424 Y68.113 F1500
+G1 X68.806 Y68.161 F1500
+G1 X68.213 Y68.213 F1500
+G1 X67.647 Y68.274 F1500
+G1 X67.108 Y68.346 F1500
+G1 X66.597 Y68.433 F1500
+G1 X66.114 Y68.537 F1500
+G1 X65.659 Y68.662 F1500
+G1 X65.232 Y68.810 F1500
+G1 X64.832 Y68.984 F1500
+G1 X64.457 Y69.185 F1500
+G1 X64.107 Y69.416 F1500
+G1 X63.779 Y69.678 F1500
+G1 X63.472 Y69.972 F1500
+G1 X63.183 Y70.300 F1500
+G1 X62.910 Y70.660 F1500
+G1 X62.650 Y71.054 F1500
+G1 X62.402 Y71.481 F1500
+G1 X62.161 Y71.940 F1500
+G1 X61.926 Y72.430 F1500
+G1 X61.694 Y72.950 F1500
+G1 X61.460 Y73.497 F1500
+G1 X61.224 Y74.070 F1500
+G1 X60.982 Y74.666 F1500
+G1 X60.731 Y75.281 F1500
+G1 X60.469 Y75.913 F1500
+G1 X60.195 Y76.558 F1500
+G1 X59.904 Y77.212 F1500
+G1 X59.597 Y77.871 F1500
+G1 X59.271 Y78.532 F1500
+G1 X58.924 Y79.189 F1500
+G1 X58.556 Y79.839 F1500
+G1 X58.166 Y80.478 F1500
+G1 X57.754 Y81.100 F1500
+G1 X57.319 Y81.702 F1500
+G1 X56.861 Y82.279 F1500
+G1 X56.381 Y82.827 F1500
+G1 X55.879 Y83.342 F1500
+G1 X55.357 Y83.821 F1500
+G1 X54.815 Y84.260 F1500
+G1 X54.255 Y84.655 F1500
+G1 X53.679 Y85.003 F1500
+G1 X53.089 Y85.303 F1500
+G1 X52.486 Y85.551 F1500
+G1 X51.873 Y85.746 F1500
+G1 X51.253 Y85.887 F1500
+G1 X50.628 Y85.972 F1500
+G1 X50.000 Y86.000 F1500
+G1 X49.372 Y85.972 F1500
+G1 X48.747 Y85.887 F1500
+G1 X48.127 Y85.746 F1500
+G1 X47.514 Y85.551 F1500
+G1 X46.911 Y85.303 F1500
+G1 X46.321 Y85.003 F1500
+G1 X45.745 Y84.655 F1500
+G1 X45.185 Y84.260 F1500
+G1 X44.643 Y83.821 F1500
+G1 X44.121 Y83.342 F1500
+G1 X43.619 Y82.827 F1500
+G1 X43.139 Y82.279 F1500
+G1 X42.681 Y81.702 F1500
+G1 X42.246 Y81.100 F1500
+G1 X41.834 Y80.478 F1500
+G1 X41.444 Y79.839 F1500
+G1 X41.076 Y79.189 F1500
+G1 X40.729 Y78.532 F1500
+G1 X40.403 Y77.871 F1500
+G1 X40.096 Y77.212 F1500
+G1 X39.805 Y76.558 F1500
+G1 X39.531 Y75.913 F1500
+G1 X39.269 Y75.281 F1500
+G1 X39.018 Y74.666 F1500
+G1 X38.776 Y74.070 F1500
+G1 X38.540 Y73.497 F1500
+G1 X38.306 Y72.950 F1500
+G1 X38.074 Y72.430 F1500
+G1 X37.839 Y71.940 F1500
+G1 X37.598 Y71.481 F1500
+G1 X37.350 Y71.054 F1500
+G1 X37.090 Y70.660 F1500
+G1 X36.817 Y70.300 F1500
+G1 X36.528 Y69.972 F1500
+G1 X36.221 Y69.678 F1500
+G1 X35.893 Y69.416 F1500
+G1 X35.543 Y69.185 F1500
+G1 X35.168 Y68.984 F1500
+G1 X34.768 Y68.810 F1500
+G1 X34.341 Y68.662 F1500
+G1 X33.886 Y68.537 F1500
+G1 X33.403 Y68.433 F1500
+G1 X32.892 Y68.346 F1500
+G1 X32.353 Y68.274 F1500
+G1 X31.787 Y68.213 F1500
+G1 X31.194 Y68.161 F1500
+G1 X30.576 Y68.113 F1500
+G1 X29.935 Y68.067 F1500
+G1 X29.272 Y68.018 F1500
+G1 X28.591 Y67.965 F1500
+G1 X27.892 Y67.902 F1500
+G1 X27.181 Y67.828 F1500
+G1 X26.459 Y67.740 F1500
+G1 X25.729 Y67.634 F1500
+G1 X24.997 Y67.507 F1500
+G1 X24.265 Y67.358 F1500
+G1 X23.537 Y67.185 F1500
+G1 X22.818 Y66.985 F1500
+G1 X22.111 Y66.757 F1500
+G1 X21.421 Y66.500 F1500
+G1 X20.751 Y66.213 F1500
+G1 X20.106 Y65.895 F1500
+G1 X19.490 Y65.546 F1500
+G1 X18.905 Y65.166 F1500
+G1 X18.356 Y64.756 F1500
+G1 X17.847 Y64.316 F1500
+G1 X17.379 Y63.847 F1500
+G1 X16.957 Y63.350 F1500
+G1 X16.582 Y62.828 F1500
+G1 X16.257 Y62.282 F1500
+G1 X15.983 Y61.713 F1500
+G1 X15.762 Y61.125 F1500
+G1 X15.595 Y60.519 F1500
+G1 X15.482 Y59.898 F1500
+G1 X15.424 Y59.265 F1500
+G1 X15.420 Y58.622 F1500
+G1 X15.470 Y57.972 F1500
+G1 X15.573 Y57.318 F1500
+G1 X15.727 Y56.662 F1500
+G1 X15.929 Y56.008 F1500
+G1 X16.179 Y55.357 F1500
+G1 X16.473 Y54.712 F1500
+G1 X16.808 Y54.075 F1500
+G1 X17.181 Y53.449 F1500
+G1 X17.588 Y52.836 F1500
+G1 X18.026 Y52.236 F1500
+G1 X18.490 Y51.651 F1500
+G1 X18.977 Y51.083 F1500
+G1 X19.482 Y50.533 F1500
+G1 X20.000 Y50.000 F1500
+G1 X20.527 Y49.486 F1500
+G1 X21.060 Y48.989 F1500
+G1 X21.592 Y48.511 F1500
+G1 X22.120 Y48.050 F1500
+G1 X22.640 Y47.606 F1500
+G1 X23.148 Y47.178 F1500
+G1 X23.639 Y46.763 F1500
+G1 X24.111 Y46.362 F1500
+G1 X24.560 Y45.971 F1500
+G1 X24.982 Y45.589 F1500
+G1 X25.376 Y45.214 F1500
+G1 X25.738 Y44.843 F1500
+G1 X26.067 Y44.475 F1500
+G1 X26.362 Y44.106 F1500
+G1 X26.620 Y43.735 F1500
+G1 X26.842 Y43.360 F1500
+G1 X27.027 Y42.976 F1500
+G1 X27.175 Y42.584 F1500
+G1 X27.286 Y42.179 F1500
+G1 X27.362 Y41.760 F1500
+G1 X27.403 Y41.326 F1500
+G1 X27.412 Y40.874 F1500
+G1 X27.390 Y40.403 F1500
+G1 X27.341 Y39.911 F1500
+G1 X27.265 Y39.399 F1500
+G1 X27.167 Y38.864 F1500
+G1 X27.050 Y38.306 F1500
+G1 X26.917 Y37.726 F1500
+G1 X26.771 Y37.124 F1500
+G1 X26.617 Y36.500 F1500
+G1 X26.459 Y35.855 F1500
+G1 X26.299 Y35.190 F1500
+G1 X26.142 Y34.507 F1500
+G1 X25.993 Y33.807 F1500
+G1 X25.854 Y33.093 F1500
+G1 X25.729 Y32.366 F1500
+G1 X25.623 Y31.631 F1500
+G1 X25.539 Y30.889 F1500
+G1 X25.479 Y30.143 F1500
+G1 X25.447 Y29.397 F1500
+G1 X25.445 Y28.655 F1500
+G1 X25.476 Y27.919 F1500
+G1 X25.542 Y27.193 F1500
+G1 X25.646 Y26.481 F1500
+G1 X25.787 Y25.787 F1500
+G1 X25.967 Y25.114 F1500
+G1 X26.188 Y24.465 F1500
+G1 X26.449 Y23.844 F1500
+G1 X26.751 Y23.255 F1500
+G1 X27.092 Y22.700 F1500
+G1 X27.473 Y22.182 F1500
+G1 X27.892 Y21.703 F1500
+G1 X28.348 Y21.267 F1500
+G1 X28.840 Y20.875 F1500
+G1 X29.364 Y20.529 F1500
+G1 X29.920 Y20.230 F1500
+G1 X30.504 Y19.979 F1500
+G1 X31.115 Y19.777 F1500
+G1 X31.748 Y19.624 F1500
+G1 X32.402 Y19.519 F1500
+G1 X33.073 Y19.463 F1500
+G1 X33.758 Y19.453 F1500
+G1 X34.454 Y19.490 F1500
+G1 X35.158 Y19.570 F1500
+G1 X35.867 Y19.692 F1500
+G1 X36.578 Y19.853 F1500
+G1 X37.287 Y20.051 F1500
+G1 X37.993 Y20.282 F1500
+G1 X38.692 Y20.543 F1500
+G1 X39.383 Y20.830 F1500
+G1 X40.063 Y21.140 F1500
+G1 X40.729 Y21.468 F1500
+G1 X41.382 Y21.811 F1500
+G1 X42.018 Y22.164 F1500
+G1 X42.637 Y22.522 F1500
+G1 X43.239 Y22.882 F1500
+G1 X43.822 Y23.240 F1500
+G1 X44.386 Y23.590 F1500
+G1 X44.932 Y23.929 F1500
+G1 X45.460 Y24.254 F1500
+G1 X45.971 Y24.560 F1500
+G1 X46.464 Y24.843 F1500
+G1 X46.943 Y25.102 F1500
+G1 X47.407 Y25.332 F1500
+G1 X47.859 Y25.531 F1500
+G1 X48.301 Y25.697 F1500
+G1 X48.733 Y25.829 F1500
+G1 X49.159 Y25.924 F1500
+G1 X49.581 Y25.981 F1500
+G1 X50.000 Y26.000 F1500
+G1 X50.419 Y25.981 F1500
+G1 X50.841 Y25.924 F1500
+G1 X51.267 Y25.829 F1500
+G1 X51.699 Y25.697 F1500
+G1 X52.141 Y25.531 F1500
+G1 X52.593 Y25.332 F1500
+G1 X53.057 Y25.102 F1500
+G1 X53.536 Y24.843 F1500
+G1 X54.029 Y24.560 F1500
+G1 X54.540 Y24.254 F1500
+G1 X55.068 Y23.929 F1500
+G1 X55.614 Y23.590 F1500
+G1 X56.178 Y23.240 F1500
+G1 X56.761 Y22.882 F1500
+G1 X57.363 Y22.522 F1500
+G1 X57.982 Y22.164 F1500
+G1 X58.618 Y21.811 F1500
+G1 X59.271 Y21.468 F1500
+G1 X59.937 Y21.140 F1500
+G1 X60.617 Y20.830 F1500
+G1 X61.308 Y20.543 F1500
+G1 X62.007 Y20.282 F1500
+G1 X62.713 Y20.051 F1500
+G1 X63.422 Y19.853 F1500
+G1 X64.133 Y19.692 F1500
+G1 X64.842 Y19.570 F1500
+G1 X65.546 Y19.490 F1500
+G1 X66.242 Y19.453 F1500
+G1 X66.927 Y19.463 F1500
+G1 X67.598 Y19.519 F1500
+G1 X68.252 Y19.624 F1500
+G1 X68.885 Y19.777 F1500
+G1 X69.496 Y19.979 F1500
+G1 X70.080 Y20.230 F1500
+G1 X70.636 Y20.529 F1500
+G1 X71.160 Y20.875 F1500
+G1 X71.652 Y21.267 F1500
+G1 X72.108 Y21.703 F1500
+G1 X72.527 Y22.182 F1500
+G1 X72.908 Y22.700 F1500
+G1 X73.249 Y23.255 F1500
+G1 X73.551 Y23.844 F1500
+G1 X73.812 Y24.465 F1500
+G1 X74.033 Y25.114 F1500
+G1 X74.213 Y25.787 F1500
+G1 X74.354 Y26.481 F1500
+G1 X74.458 Y27.193 F1500
+G1 X74.524 Y27.919 F1500
+G1 X74.555 Y28.655 F1500
+G1 X74.553 Y29.397 F1500
+G1 X74.521 Y30.143 F1500
+G1 X74.461 Y30.889 F1500
+G1 X74.377 Y31.631 F1500
+G1 X74.271 Y32.366 F1500
+G1 X74.146 Y33.093 F1500
+G1 X74.007 Y33.807 F1500
+G1 X73.858 Y34.507 F1500
+G1 X73.701 Y35.190 F1500
+G1 X73.541 Y35.855 F1500
+G1 X73.383 Y36.500 F1500
+G1 X73.229 Y37.124 F1500
+G1 X73.083 Y37.726 F1500
+G1 X72.950 Y38.306 F1500
+G1 X72.833 Y38.864 F1500
+G1 X72.735 Y39.399 F1500
+G1 X72.659 Y39.911 F1500
+G1 X72.610 Y40.403 F1500
+G1 X72.588 Y40.874 F1500
+G1 X72.597 Y41.326 F1500
+G1 X72.638 Y41.760 F1500
+G1 X72.714 Y42.179 F1500
+G1 X72.825 Y42.584 F1500
+G1 X72.973 Y42.976 F1500
+G1 X73.158 Y43.360 F1500
+G1 X73.380 Y43.735 F1500
+G1 X73.638 Y44.106 F1500
+G1 X73.933 Y44.475 F1500
+G1 X74.262 Y44.843 F1500
+G1 X74.624 Y45.214 F1500
+G1 X75.018 Y45.589 F1500
+G1 X75.440 Y45.971 F1500
+G1 X75.889 Y46.362 F1500
+G1 X76.361 Y46.763 F1500
+G1 X76.852 Y47.178 F1500
+G1 X77.360 Y47.606 F1500
+G1 X77.880 Y48.050 F1500
+G1 X78.408 Y48.511 F1500
+G1 X78.940 Y48.989 F1500
+G1 X79.473 Y49.486 F1500
+G1 X80.000 Y50.000 F1500
+G0 Z5
+G0 X0 Y0
@@ -0,0 +1,563 @@
+; Milling workload: circular pockets cleared with G2 rings after a
+; helical entry, then a contour of alternating tangent arcs.
+G21
+G90
+G17
+G0 Z5 F3000
+G0 X26.000 Y25.000
+G1 Z0.000 F300
+G2 X26.000 Y25.000 Z-0.250 I-1 J0 F600
+G2 X26.000 Y25.000 Z-0.500 I-1 J0 F600
+G2 X26.000 Y25.000 Z-0.750 I-1 J0 F600
+G2 X26.000 Y25.000 Z-1.000 I-1 J0 F600
+G1 X26.800 Y25.000 F900
+G2 X23.200 Y25.000 I-1.800 J0
+G2 X26.800 Y25.000 I1.800 J0
+G1 X27.600 Y25.000 F900
+G2 X22.400 Y25.000 I-2.600 J0
+G2 X27.600 Y25.000 I2.600 J0
+G1 X28.400 Y25.000 F900
+G2 X21.600 Y25.000 I-3.400 J0
+G2 X28.400 Y25.000 I3.400 J0
+G1 X29.200 Y25.000 F900
+G2 X20.800 Y25.000 I-4.200 J0
+G2 X29.200 Y25.000 I4.200 J0
+G1 X30.000 Y25.000 F900
+G2 X20.000 Y25.000 I-5.000 J0
+G2 X30.000 Y25.000 I5.000 J0
+G1 X30.800 Y25.000 F900
+G2 X19.200 Y25.000 I-5.800 J0
+G2 X30.800 Y25.000 I5.800 J0
+G1 X31.600 Y25.000 F900
+G2 X18.400 Y25.000 I-6.600 J0
+G2 X31.600 Y25.000 I6.600 J0
+G1 X32.400 Y25.000 F900
+G2 X17.600 Y25.000 I-7.400 J0
+G2 X32.400 Y25.000 I7.400 J0
+G1 X33.200 Y25.000 F900
+G2 X16.800 Y25.000 I-8.200 J0
+G2 X33.200 Y25.000 I8.200 J0
+G1 X34.000 Y25.000 F900
+G2 X16.000 Y25.000 I-9.000 J0
+G2 X34.000 Y25.000 I9.000 J0
+G1 X34.800 Y25.000 F900
+G2 X15.200 Y25.000 I-9.800 J0
+G2 X34.800 Y25.000 I9.800 J0
+G1 X35.600 Y25.000 F900
+G2 X14.400 Y25.000 I-10.600 J0
+G2 X35.600 Y25.000 I10.600 J0
+G0 Z5
+G0 X26.000 Y25.000
+G1 Z-1.000 F300
+G2 X26.000 Y25.000 Z-1.250 I-1 J0 F600
+G2 X26.000 Y25.000 Z-1.500 I-1 J0 F600
+G2 X26.000 Y25.000 Z-1.750 I-1 J0 F600
+G2 X26.000 Y25.000 Z-2.000 I-1 J0 F600
+G1 X26.800 Y25.000 F900
+G2 X23.200 Y25.000 I-1.800 J0
+G2 X26.800 Y25.000 I1.800 J0
+G1 X27.600 Y25.000 F900
+G2 X22.400 Y25.000 I-2.600 J0
+G2 X27.600 Y25.000 I2.600 J0
+G1 X28.400 Y25.000 F900
+G2 X21.600 Y25.000 I-3.400 J0
+G2 X28.400 Y25.000 I3.400 J0
+G1 X29.200 Y25.000 F900
+G2 X20.800 Y25.000 I-4.200 J0
+G2 X29.200 Y25.000 I4.200 J0
+G1 X30.000 Y25.000 F900
+G2 X20.000 Y25.000 I-5.000 J0
+G2 X30.000 Y25.000 I5.000 J0
+G1 X30.800 Y25.000 F900
+G2 X19.200 Y25.000 I-5.800 J0
+G2 X30.800 Y25.000 I5.800 J0
+G1 X31.600 Y25.000 F900
+G2 X18.400 Y25.000 I-6.600 J0
+G2 X31.600 Y25.000 I6.600 J0
+G1 X32.400 Y25.000 F900
+G2 X17.600 Y25.000 I-7.400 J0
+G2 X32.400 Y25.000 I7.400 J0
+G1 X33.200 Y25.000 F900
+G2 X16.800 Y25.000 I-8.200 J0
+G2 X33.200 Y25.000 I8.200 J0
+G1 X34.000 Y25.000 F900
+G2 X16.000 Y25.000 I-9.000 J0
+G2 X34.000 Y25.000 I9.000 J0
+G1 X34.800 Y25.000 F900
+G2 X15.200 Y25.000 I-9.800 J0
+G2 X34.800 Y25.000 I9.800 J0
+G1 X35.600 Y25.000 F900
+G2 X14.400 Y25.000 I-10.600 J0
+G2 X35.600 Y25.000 I10.600 J0
+G0 Z5
+G0 X26.000 Y25.000
+G1 Z-2.000 F300
+G2 X26.000 Y25.000 Z-2.250 I-1 J0 F600
+G2 X26.000 Y25.000 Z-2.500 I-1 J0 F600
+G2 X26.000 Y25.000 Z-2.750 I-1 J0 F600
+G2 X26.000 Y25.000 Z-3.000 I-1 J0 F600
+G1 X26.800 Y25.000 F900
+G2 X23.200 Y25.000 I-1.800 J0
+G2 X26.800 Y25.000 I1.800 J0
+G1 X27.600 Y25.000 F900
+G2 X22.400 Y25.000 I-2.600 J0
+G2 X27.600 Y25.000 I2.600 J0
+G1 X28.400 Y25.000 F900
+G2 X21.600 Y25.000 I-3.400 J0
+G2 X28.400 Y25.000 I3.400 J0
+G1 X29.200 Y25.000 F900
+G2 X20.800 Y25.000 I-4.200 J0
+G2 X29.200 Y25.000 I4.200 J0
+G1 X30.000 Y25.000 F900
+G2 X20.000 Y25.000 I-5.000 J0
+G2 X30.000 Y25.000 I5.000 J0
+G1 X30.800 Y25.000 F900
+G2 X19.200 Y25.000 I-5.800 J0
+G2 X30.800 Y25.000 I5.800 J0
+G1 X31.600 Y25.000 F900
+G2 X18.400 Y25.000 I-6.600 J0
+G2 X31.600 Y25.000 I6.600 J0
+G1 X32.400 Y25.000 F900
+G2 X17.600 Y25.000 I-7.400 J0
+G2 X32.400 Y25.000 I7.400 J0
+G1 X33.200 Y25.000 F900
+G2 X16.800 Y25.000 I-8.200 J0
+G2 X33.200 Y25.000 I8.200 J0
+G1 X34.000 Y25.000 F900
+G2 X16.000 Y25.000 I-9.000 J0
+G2 X34.000 Y25.000 I9.000 J0
+G1 X34.800 Y25.000 F900
+G2 X15.200 Y25.000 I-9.800 J0
+G2 X34.800 Y25.000 I9.800 J0
+G1 X35.600 Y25.000 F900
+G2 X14.400 Y25.000 I-10.600 J0
+G2 X35.600 Y25.000 I10.600 J0
+G0 Z5
+G0 X76.000 Y25.000
+G1 Z0.000 F300
+G2 X76.000 Y25.000 Z-0.250 I-1 J0 F600
+G2 X76.000 Y25.000 Z-0.500 I-1 J0 F600
+G2 X76.000 Y25.000 Z-0.750 I-1 J0 F600
+G2 X76.000 Y25.000 Z-1.000 I-1 J0 F600
+G1 X76.800 Y25.000 F900
+G2 X73.200 Y25.000 I-1.800 J0
+G2 X76.800 Y25.000 I1.800 J0
+G1 X77.600 Y25.000 F900
+G2 X72.400 Y25.000 I-2.600 J0
+G2 X77.600 Y25.000 I2.600 J0
+G1 X78.400 Y25.000 F900
+G2 X71.600 Y25.000 I-3.400 J0
+G2 X78.400 Y25.000 I3.400 J0
+G1 X79.200 Y25.000 F900
+G2 X70.800 Y25.000 I-4.200 J0
+G2 X79.200 Y25.000 I4.200 J0
+G1 X80.000 Y25.000 F900
+G2 X70.000 Y25.000 I-5.000 J0
+G2 X80.000 Y25.000 I5.000 J0
+G1 X80.800 Y25.000 F900
+G2 X69.200 Y25.000 I-5.800 J0
+G2 X80.800 Y25.000 I5.800 J0
+G1 X81.600 Y25.000 F900
+G2 X68.400 Y25.000 I-6.600 J0
+G2 X81.600 Y25.000 I6.600 J0
+G1 X82.400 Y25.000 F900
+G2 X67.600 Y25.000 I-7.400 J0
+G2 X82.400 Y25.000 I7.400 J0
+G1 X83.200 Y25.000 F900
+G2 X66.800 Y25.000 I-8.200 J0
+G2 X83.200 Y25.000 I8.200 J0
+G1 X84.000 Y25.000 F900
+G2 X66.000 Y25.000 I-9.000 J0
+G2 X84.000 Y25.000 I9.000 J0
+G1 X84.800 Y25.000 F900
+G2 X65.200 Y25.000 I-9.800 J0
+G2 X84.800 Y25.000 I9.800 J0
+G1 X85.600 Y25.000 F900
+G2 X64.400 Y25.000 I-10.600 J0
+G2 X85.600 Y25.000 I10.600 J0
+G0 Z5
+G0 X76.000 Y25.000
+G1 Z-1.000 F300
+G2 X76.000 Y25.000 Z-1.250 I-1 J0 F600
+G2 X76.000 Y25.000 Z-1.500 I-1 J0 F600
+G2 X76.000 Y25.000 Z-1.750 I-1 J0 F600
+G2 X76.000 Y25.000 Z-2.000 I-1 J0 F600
+G1 X76.800 Y25.000 F900
+G2 X73.200 Y25.000 I-1.800 J0
+G2 X76.800 Y25.000 I1.800 J0
+G1 X77.600 Y25.000 F900
+G2 X72.400 Y25.000 I-2.600 J0
+G2 X77.600 Y25.000 I2.600 J0
+G1 X78.400 Y25.000 F900
+G2 X71.600 Y25.000 I-3.400 J0
+G2 X78.400 Y25.000 I3.400 J0
+G1 X79.200 Y25.000 F900
+G2 X70.800 Y25.000 I-4.200 J0
+G2 X79.200 Y25.000 I4.200 J0
+G1 X80.000 Y25.000 F900
+G2 X70.000 Y25.000 I-5.000 J0
+G2 X80.000 Y25.000 I5.000 J0
+G1 X80.800 Y25.000 F900
+G2 X69.200 Y25.000 I-5.800 J0
+G2 X80.800 Y25.000 I5.800 J0
+G1 X81.600 Y25.000 F900
+G2 X68.400 Y25.000 I-6.600 J0
+G2 X81.600 Y25.000 I6.600 J0
+G1 X82.400 Y25.000 F900
+G2 X67.600 Y25.000 I-7.400 J0
+G2 X82.400 Y25.000 I7.400 J0
+G1 X83.200 Y25.000 F900
+G2 X66.800 Y25.000 I-8.200 J0
+G2 X83.200 Y25.000 I8.200 J0
+G1 X84.000 Y25.000 F900
+G2 X66.000 Y25.000 I-9.000 J0
+G2 X84.000 Y25.000 I9.000 J0
+G1 X84.800 Y25.000 F900
+G2 X65.200 Y25.000 I-9.800 J0
+G2 X84.800 Y25.000 I9.800 J0
+G1 X85.600 Y25.000 F900
+G2 X64.400 Y25.000 I-10.600 J0
+G2 X85.600 Y25.000 I10.600 J0
+G0 Z5
+G0 X76.000 Y25.000
+G1 Z-2.000 F300
+G2 X76.000 Y25.000 Z-2.250 I-1 J0 F600
+G2 X76.000 Y25.000 Z-2.500 I-1 J0 F600
+G2 X76.000 Y25.000 Z-2.750 I-1 J0 F600
+G2 X76.000 Y25.000 Z-3.000 I-1 J0 F600
+G1 X76.800 Y25.000 F900
+G2 X73.200 Y25.000 I-1.800 J0
+G2 X76.800 Y25.000 I1.800 J0
+G1 X77.600 Y25.000 F900
+G2 X72.400 Y25.000 I-2.600 J0
+G2 X77.600 Y25.000 I2.600 J0
+G1 X78.400 Y25.000 F900
+G2 X71.600 Y25.000 I-3.400 J0
+G2 X78.400 Y25.000 I3.400 J0
+G1 X79.200 Y25.000 F900
+G2 X70.800 Y25.000 I-4.200 J0
+G2 X79.200 Y25.000 I4.200 J0
+G1 X80.000 Y25.000 F900
+G2 X70.000 Y25.000 I-5.000 J0
+G2 X80.000 Y25.000 I5.000 J0
+G1 X80.800 Y25.000 F900
+G2 X69.200 Y25.000 I-5.800 J0
+G2 X80.800 Y25.000 I5.800 J0
+G1 X81.600 Y25.000 F900
+G2 X68.400 Y25.000 I-6.600 J0
+G2 X81.600 Y25.000 I6.600 J0
+G1 X82.400 Y25.000 F900
+G2 X67.600 Y25.000 I-7.400 J0
+G2 X82.400 Y25.000 I7.400 J0
+G1 X83.200 Y25.000 F900
+G2 X66.800 Y25.000 I-8.200 J0
+G2 X83.200 Y25.000 I8.200 J0
+G1 X84.000 Y25.000 F900
+G2 X66.000 Y25.000 I-9.000 J0
+G2 X84.000 Y25.000 I9.000 J0
+G1 X84.800 Y25.000 F900
+G2 X65.200 Y25.000 I-9.800 J0
+G2 X84.800 Y25.000 I9.800 J0
+G1 X85.600 Y25.000 F900
+G2 X64.400 Y25.000 I-10.600 J0
+G2 X85.600 Y25.000 I10.600 J0
+G0 Z5
+G0 X26.000 Y75.000
+G1 Z0.000 F300
+G2 X26.000 Y75.000 Z-0.250 I-1 J0 F600
+G2 X26.000 Y75.000 Z-0.500 I-1 J0 F600
+G2 X26.000 Y75.000 Z-0.750 I-1 J0 F600
+G2 X26.000 Y75.000 Z-1.000 I-1 J0 F600
+G1 X26.800 Y75.000 F900
+G2 X23.200 Y75.000 I-1.800 J0
+G2 X26.800 Y75.000 I1.800 J0
+G1 X27.600 Y75.000 F900
+G2 X22.400 Y75.000 I-2.600 J0
+G2 X27.600 Y75.000 I2.600 J0
+G1 X28.400 Y75.000 F900
+G2 X21.600 Y75.000 I-3.400 J0
+G2 X28.400 Y75.000 I3.400 J0
+G1 X29.200 Y75.000 F900
+G2 X20.800 Y75.000 I-4.200 J0
+G2 X29.200 Y75.000 I4.200 J0
+G1 X30.000 Y75.000 F900
+G2 X20.000 Y75.000 I-5.000 J0
+G2 X30.000 Y75.000 I5.000 J0
+G1 X30.800 Y75.000 F900
+G2 X19.200 Y75.000 I-5.800 J0
+G2 X30.800 Y75.000 I5.800 J0
+G1 X31.600 Y75.000 F900
+G2 X18.400 Y75.000 I-6.600 J0
+G2 X31.600 Y75.000 I6.600 J0
+G1 X32.400 Y75.000 F900
+G2 X17.600 Y75.000 I-7.400 J0
+G2 X32.400 Y75.000 I7.400 J0
+G1 X33.200 Y75.000 F900
+G2 X16.800 Y75.000 I-8.200 J0
+G2 X33.200 Y75.000 I8.200 J0
+G1 X34.000 Y75.000 F900
+G2 X16.000 Y75.000 I-9.000 J0
+G2 X34.000 Y75.000 I9.000 J0
+G1 X34.800 Y75.000 F900
+G2 X15.200 Y75.000 I-9.800 J0
+G2 X34.800 Y75.000 I9.800 J0
+G1 X35.600 Y75.000 F900
+G2 X14.400 Y75.000 I-10.600 J0
+G2 X35.600 Y75.000 I10.600 J0
+G0 Z5
+G0 X26.000 Y75.000
+G1 Z-1.000 F300
+G2 X26.000 Y75.000 Z-1.250 I-1 J0 F600
+G2 X26.000 Y75.000 Z-1.500 I-1 J0 F600
+G2 X26.000 Y75.000 Z-1.750 I-1 J0 F600
+G2 X26.000 Y75.000 Z-2.000 I-1 J0 F600
+G1 X26.800 Y75.000 F900
+G2 X23.200 Y75.000 I-1.800 J0
+G2 X26.800 Y75.000 I1.800 J0
+G1 X27.600 Y75.000 F900
+G2 X22.400 Y75.000 I-2.600 J0
+G2 X27.600 Y75.000 I2.600 J0
+G1 X28.400 Y75.000 F900
+G2 X21.600 Y75.000 I-3.400 J0
+G2 X28.400 Y75.000 I3.400 J0
+G1 X29.200 Y75.000 F900
+G2 X20.800 Y75.000 I-4.200 J0
+G2 X29.200 Y75.000 I4.200 J0
+G1 X30.000 Y75.000 F900
+G2 X20.000 Y75.000 I-5.000 J0
+G2 X30.000 Y75.000 I5.000 J0
+G1 X30.800 Y75.000 F900
+G2 X19.200 Y75.000 I-5.800 J0
+G2 X30.800 Y75.000 I5.800 J0
+G1 X31.600 Y75.000 F900
+G2 X18.400 Y75.000 I-6.600 J0
+G2 X31.600 Y75.000 I6.600 J0
+G1 X32.400 Y75.000 F900
+G2 X17.600 Y75.000 I-7.400 J0
+G2 X32.400 Y75.000 I7.400 J0
+G1 X33.200 Y75.000 F900
+G2 X16.800 Y75.000 I-8.200 J0
+G2 X33.200 Y75.000 I8.200 J0
+G1 X34.000 Y75.000 F900
+G2 X16.000 Y75.000 I-9.000 J0
+G2 X34.000 Y75.000 I9.000 J0
+G1 X34.800 Y75.000 F900
+G2 X15.200 Y75.000 I-9.800 J0
+G2 X34.800 Y75.000 I9.800 J0
+G1 X35.600 Y75.000 F900
+G2 X14.400 Y75.000 I-10.600 J0
+G2 X35.600 Y75.000 I10.600 J0
+G0 Z5
+G0 X26.000 Y75.000
+G1 Z-2.000 F300
+G2 X26.000 Y75.000 Z-2.250 I-1 J0 F600
+G2 X26.000 Y75.000 Z-2.500 I-1 J0 F600
+G2 X26.000 Y75.000 Z-2.750 I-1 J0 F600
+G2 X26.000 Y75.000 Z-3.000 I-1 J0 F600
+G1 X26.800 Y75.000 F900
+G2 X23.200 Y75.000 I-1.800 J0
+G2 X26.800 Y75.000 I1.800 J0
+G1 X27.600 Y75.000 F900
+G2 X22.400 Y75.000 I-2.600 J0
+G2 X27.600 Y75.000 I2.600 J0
+G1 X28.400 Y75.000 F900
+G2 X21.600 Y75.000 I-3.400 J0
+G2 X28.400 Y75.000 I3.400 J0
+G1 X29.200 Y75.000 F900
+G2 X20.800 Y75.000 I-4.200 J0
+G2 X29.200 Y75.000 I4.200 J0
+G1 X30.000 Y75.000 F900
+G2 X20.000 Y75.000 I-5.000 J0
+G2 X30.000 Y75.000 I5.000 J0
+G1 X30.800 Y75.000 F900
+G2 X19.200 Y75.000 I-5.800 J0
+G2 X30.800 Y75.000 I5.800 J0
+G1 X31.600 Y75.000 F900
+G2 X18.400 Y75.000 I-6.600 J0
+G2 X31.600 Y75.000 I6.600 J0
+G1 X32.400 Y75.000 F900
+G2 X17.600 Y75.000 I-7.400 J0
+G2 X32.400 Y75.000 I7.400 J0
+G1 X33.200 Y75.000 F900
+G2 X16.800 Y75.000 I-8.200 J0
+G2 X33.200 Y75.000 I8.200 J0
+G1 X34.000 Y75.000 F900
+G2 X16.000 Y75.000 I-9.000 J0
+G2 X34.000 Y75.000 I9.000 J0
+G1 X34.800 Y75.000 F900
+G2 X15.200 Y75.000 I-9.800 J0
+G2 X34.800 Y75.000 I9.800 J0
+G1 X35.600 Y75.000 F900
+G2 X14.400 Y75.000 I-10.600 J0
+G2 X35.600 Y75.000 I10.600 J0
+G0 Z5
+G0 X76.000 Y75.000
+G1 Z0.000 F300
+G2 X76.000 Y75.000 Z-0.250 I-1 J0 F600
+G2 X76.000 Y75.000 Z-0.500 I-1 J0 F600
+G2 X76.000 Y75.000 Z-0.750 I-1 J0 F600
+G2 X76.000 Y75.000 Z-1.000 I-1 J0 F600
+G1 X76.800 Y75.000 F900
+G2 X73.200 Y75.000 I-1.800 J0
+G2 X76.800 Y75.000 I1.800 J0
+G1 X77.600 Y75.000 F900
+G2 X72.400 Y75.000 I-2.600 J0
+G2 X77.600 Y75.000 I2.600 J0
+G1 X78.400 Y75.000 F900
+G2 X71.600 Y75.000 I-3.400 J0
+G2 X78.400 Y75.000 I3.400 J0
+G1 X79.200 Y75.000 F900
+G2 X70.800 Y75.000 I-4.200 J0
+G2 X79.200 Y75.000 I4.200 J0
+G1 X80.000 Y75.000 F900
+G2 X70.000 Y75.000 I-5.000 J0
+G2 X80.000 Y75.000 I5.000 J0
+G1 X80.800 Y75.000 F900
+G2 X69.200 Y75.000 I-5.800 J0
+G2 X80.800 Y75.000 I5.800 J0
+G1 X81.600 Y75.000 F900
+G2 X68.400 Y75.000 I-6.600 J0
+G2 X81.600 Y75.000 I6.600 J0
+G1 X82.400 Y75.000 F900
+G2 X67.600 Y75.000 I-7.400 J0
+G2 X82.400 Y75.000 I7.400 J0
+G1 X83.200 Y75.000 F900
+G2 X66.800 Y75.000 I-8.200 J0
+G2 X83.200 Y75.000 I8.200 J0
+G1 X84.000 Y75.000 F900
+G2 X66.000 Y75.000 I-9.000 J0
+G2 X84.000 Y75.000 I9.000 J0
+G1 X84.800 Y75.000 F900
+G2 X65.200 Y75.000 I-9.800 J0
+G2 X84.800 Y75.000 I9.800 J0
+G1 X85.600 Y75.000 F900
+G2 X64.400 Y75.000 I-10.600 J0
+G2 X85.600 Y75.000 I10.600 J0
+G0 Z5
+G0 X76.000 Y75.000
+G1 Z-1.000 F300
+G2 X76.000 Y75.000 Z-1.250 I-1 J0 F600
+G2 X76.000 Y75.000 Z-1.500 I-1 J0 F600
+G2 X76.000 Y75.000 Z-1.750 I-1 J0 F600
+G2 X76.000 Y75.000 Z-2.000 I-1 J0 F600
+G1 X76.800 Y75.000 F900
+G2 X73.200 Y75.000 I-1.800 J0
+G2 X76.800 Y75.000 I1.800 J0
+G1 X77.600 Y75.000 F900
+G2 X72.400 Y75.000 I-2.600 J0
+G2 X77.600 Y75.000 I2.600 J0
+G1 X78.400 Y75.000 F900
+G2 X71.600 Y75.000 I-3.400 J0
+G2 X78.400 Y75.000 I3.400 J0
+G1 X79.200 Y75.000 F900
+G2 X70.800 Y75.000 I-4.200 J0
+G2 X79.200 Y75.000 I4.200 J0
+G1 X80.000 Y75.000 F900
+G2 X70.000 Y75.000 I-5.000 J0
+G2 X80.000 Y75.000 I5.000 J0
+G1 X80.800 Y75.000 F900
+G2 X69.200 Y75.000 I-5.800 J0
+G2 X80.800 Y75.000 I5.800 J0
+G1 X81.600 Y75.000 F900
+G2 X68.400 Y75.000 I-6.600 J0
+G2 X81.600 Y75.000 I6.600 J0
+G1 X82.400 Y75.000 F900
+G2 X67.600 Y75.000 I-7.400 J0
+G2 X82.400 Y75.000 I7.400 J0
+G1 X83.200 Y75.000 F900
+G2 X66.800 Y75.000 I-8.200 J0
+G2 X83.200 Y75.000 I8.200 J0
+G1 X84.000 Y75.000 F900
+G2 X66.000 Y75.000 I-9.000 J0
+G2 X84.000 Y75.000 I9.000 J0
+G1 X84.800 Y75.000 F900
+G2 X65.200 Y75.000 I-9.800 J0
+G2 X84.800 Y75.000 I9.800 J0
+G1 X85.600 Y75.000 F900
+G2 X64.400 Y75.000 I-10.600 J0
+G2 X85.600 Y75.000 I10.600 J0
+G0 Z5
+G0 X76.000 Y75.000
+G1 Z-2.000 F300
+G2 X76.000 Y75.000 Z-2.250 I-1 J0 F600
+G2 X76.000 Y75.000 Z-2.500 I-1 J0 F600
+G2 X76.000 Y75.000 Z-2.750 I-1 J0 F600
+G2 X76.000 Y75.000 Z-3.000 I-1 J0 F600
+G1 X76.800 Y75.000 F900
+G2 X73.200 Y75.000 I-1.800 J0
+G2 X76.800 Y75.000 I1.800 J0
+G1 X77.600 Y75.000 F900
+G2 X72.400 Y75.000 I-2.600 J0
+G2 X77.600 Y75.000 I2.600 J0
+G1 X78.400 Y75.000 F900
+G2 X71.600 Y75.000 I-3.400 J0
+G2 X78.400 Y75.000 I3.400 J0
+G1 X79.200 Y75.000 F900
+G2 X70.800 Y75.000 I-4.200 J0
+G2 X79.200 Y75.000 I4.200 J0
+G1 X80.000 Y75.000 F900
+G2 X70.000 Y75.000 I-5.000 J0
+G2 X80.000 Y75.000 I5.000 J0
+G1 X80.800 Y75.000 F900
+G2 X69.200 Y75.000 I-5.800 J0
+G2 X80.800 Y75.000 I5.800 J0
+G1 X81.600 Y75.000 F900
+G2 X68.400 Y75.000 I-6.600 J0
+G2 X81.600 Y75.000 I6.600 J0
+G1 X82.400 Y75.000 F900
+G2 X67.600 Y75.000 I-7.400 J0
+G2 X82.400 Y75.000 I7.400 J0
+G1 X83.200 Y75.000 F900
+G2 X66.800 Y75.000 I-8.200 J0
+G2 X83.200 Y75.000 I8.200 J0
+G1 X84.000 Y75.000 F900
+G2 X66.000 Y75.000 I-9.000 J0
+G2 X84.000 Y75.000 I9.000 J0
+G1 X84.800 Y75.000 F900
+G2 X65.200 Y75.000 I-9.800 J0
+G2 X84.800 Y75.000 I9.800 J0
+G1 X85.600 Y75.000 F900
+G2 X64.400 Y75.000 I-10.600 J0
+G2 X85.600 Y75.000 I10.600 J0
+G0 Z5
+G0 X5 Y50
+G1 Z-2 F300
+G2 X10.000 Y50 I2.5 J0 F1200
+G3 X15.000 Y50 I2.5 J0 F1200
+G2 X20.000 Y50 I2.5 J0 F1200
+G3 X25.000 Y50 I2.5 J0 F1200
+G2 X30.000 Y50 I2.5 J0 F1200
+G3 X35.000 Y50 I2.5 J0 F1200
+G2 X40.000 Y50 I2.5 J0 F1200
+G3 X45.000 Y50 I2.5 J0 F1200
+G2 X50.000 Y50 I2.5 J0 F1200
+G3 X55.000 Y50 I2.5 J0 F1200
+G2 X60.000 Y50 I2.5 J0 F1200
+G3 X65.000 Y50 I2.5 J0 F1200
+G2 X70.000 Y50 I2.5 J0 F1200
+G3 X75.000 Y50 I2.5 J0 F1200
+G2 X80.000 Y50 I2.5 J0 F1200
+G3 X85.000 Y50 I2.5 J0 F1200
+G2 X90.000 Y50 I2.5 J0 F1200
+G3 X95.000 Y50 I2.5 J0 F1200
+G1 Y95
+G2 X90.000 Y95 I-2.5 J0
+G3 X85.000 Y95 I-2.5 J0
+G2 X80.000 Y95 I-2.5 J0
+G3 X75.000 Y95 I-2.5 J0
+G2 X70.000 Y95 I-2.5 J0
+G3 X65.000 Y95 I-2.5 J0
+G2 X60.000 Y95 I-2.5 J0
+G3 X55.000 Y95 I-2.5 J0
+G2 X50.000 Y95 I-2.5 J0
+G3 X45.000 Y95 I-2.5 J0
+G2 X40.000 Y95 I-2.5 J0
+G3 X35.000 Y95 I-2.5 J0
+G2 X30.000 Y95 I-2.5 J0
+G3 X25.000 Y95 I-2.5 J0
+G2 X20.000 Y95 I-2.5 J0
+G3 X15.000 Y95 I-2.5 J0
+G2 X10.000 Y95 I-2.5 J0
+G3 X5.000 Y95 I-2.5 J0
+G0 Z5
+G0 X0 Y0
@@ -0,0 +1,1522 @@
+; 3D print workload: perimeters and diagonal infill of a rounded
+; 40x40mm box over 12 layers, with retracts and travel moves.
+G21
+G90
+M82
+G92 E0
+G0 Z0.2 F3000
+G0 Z0.20 F3000
+G1 E0.00000 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E0.02589 F1800
+G1 X66.545 Y30.245 E0.05178 F1800
+G1 X67.270 Y30.545 E0.07767 F1800
+G1 X67.939 Y30.955 E0.10357 F1800
+G1 X68.536 Y31.464 E0.12946 F1800
+G1 X69.045 Y32.061 E0.15535 F1800
+G1 X69.455 Y32.730 E0.18124 F1800
+G1 X69.755 Y33.455 E0.20713 F1800
+G1 X69.938 Y34.218 E0.23302 F1800
+G1 X70.000 Y65.000 E1.24884 F1800
+G1 X69.938 Y65.782 E1.27473 F1800
+G1 X69.755 Y66.545 E1.30062 F1800
+G1 X69.455 Y67.270 E1.32651 F1800
+G1 X69.045 Y67.939 E1.35240 F1800
+G1 X68.536 Y68.536 E1.37829 F1800
+G1 X67.939 Y69.045 E1.40419 F1800
+G1 X67.270 Y69.455 E1.43008 F1800
+G1 X66.545 Y69.755 E1.45597 F1800
+G1 X65.782 Y69.938 E1.48186 F1800
+G1 X35.000 Y70.000 E2.49767 F1800
+G1 X34.218 Y69.938 E2.52357 F1800
+G1 X33.455 Y69.755 E2.54946 F1800
+G1 X32.730 Y69.455 E2.57535 F1800
+G1 X32.061 Y69.045 E2.60124 F1800
+G1 X31.464 Y68.536 E2.62713 F1800
+G1 X30.955 Y67.939 E2.65302 F1800
+G1 X30.545 Y67.270 E2.67891 F1800
+G1 X30.245 Y66.545 E2.70481 F1800
+G1 X30.062 Y65.782 E2.73070 F1800
+G1 X30.000 Y35.000 E3.74651 F1800
+G1 X30.062 Y34.218 E3.77240 F1800
+G1 X30.245 Y33.455 E3.79829 F1800
+G1 X30.545 Y32.730 E3.82419 F1800
+G1 X30.955 Y32.061 E3.85008 F1800
+G1 X31.464 Y31.464 E3.87597 F1800
+G1 X32.061 Y30.955 E3.90186 F1800
+G1 X32.730 Y30.545 E3.92775 F1800
+G1 X33.455 Y30.245 E3.95364 F1800
+G1 X34.218 Y30.062 E3.97954 F1800
+G1 X65.000 Y30.000 E4.99535 F1800
+G1 E3.99535 F2400
+G1 E4.99535 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E5.02124 F1800
+G1 X66.095 Y30.695 E5.04713 F1800
+G1 X66.820 Y30.995 E5.07302 F1800
+G1 X67.489 Y31.405 E5.09891 F1800
+G1 X68.086 Y31.914 E5.12481 F1800
+G1 X68.595 Y32.511 E5.15070 F1800
+G1 X69.005 Y33.180 E5.17659 F1800
+G1 X69.305 Y33.905 E5.20248 F1800
+G1 X69.488 Y34.668 E5.22837 F1800
+G1 X69.550 Y64.550 E6.21449 F1800
+G1 X69.488 Y65.332 E6.24038 F1800
+G1 X69.305 Y66.095 E6.26627 F1800
+G1 X69.005 Y66.820 E6.29216 F1800
+G1 X68.595 Y67.489 E6.31805 F1800
+G1 X68.086 Y68.086 E6.34394 F1800
+G1 X67.489 Y68.595 E6.36984 F1800
+G1 X66.820 Y69.005 E6.39573 F1800
+G1 X66.095 Y69.305 E6.42162 F1800
+G1 X65.332 Y69.488 E6.44751 F1800
+G1 X35.450 Y69.550 E7.43362 F1800
+G1 X34.668 Y69.488 E7.45952 F1800
+G1 X33.905 Y69.305 E7.48541 F1800
+G1 X33.180 Y69.005 E7.51130 F1800
+G1 X32.511 Y68.595 E7.53719 F1800
+G1 X31.914 Y68.086 E7.56308 F1800
+G1 X31.405 Y67.489 E7.58897 F1800
+G1 X30.995 Y66.820 E7.61486 F1800
+G1 X30.695 Y66.095 E7.64076 F1800
+G1 X30.512 Y65.332 E7.66665 F1800
+G1 X30.450 Y35.450 E8.65276 F1800
+G1 X30.512 Y34.668 E8.67865 F1800
+G1 X30.695 Y33.905 E8.70454 F1800
+G1 X30.995 Y33.180 E8.73044 F1800
+G1 X31.405 Y32.511 E8.75633 F1800
+G1 X31.914 Y31.914 E8.78222 F1800
+G1 X32.511 Y31.405 E8.80811 F1800
+G1 X33.180 Y30.995 E8.83400 F1800
+G1 X33.905 Y30.695 E8.85989 F1800
+G1 X34.668 Y30.512 E8.88578 F1800
+G1 X64.550 Y30.450 E9.87190 F1800
+G1 E8.87190 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E9.87190 F3000
+G1 X31.500 Y33.500 E9.93790 F3000
+G1 X33.500 Y31.500 E10.03124 F3000
+G1 X35.500 Y31.500 E10.09724 F3000
+G1 X31.500 Y35.500 E10.28391 F3000
+G1 X31.500 Y37.500 E10.34991 F3000
+G1 X37.500 Y31.500 E10.62993 F3000
+G1 X39.500 Y31.500 E10.69593 F3000
+G1 X31.500 Y39.500 E11.06928 F3000
+G1 X31.500 Y41.500 E11.13528 F3000
+G1 X41.500 Y31.500 E11.60197 F3000
+G1 X43.500 Y31.500 E11.66797 F3000
+G1 X31.500 Y43.500 E12.22800 F3000
+G1 X31.500 Y45.500 E12.29400 F3000
+G1 X45.500 Y31.500 E12.94736 F3000
+G1 X47.500 Y31.500 E13.01336 F3000
+G1 X31.500 Y47.500 E13.76007 F3000
+G1 X31.500 Y49.500 E13.82607 F3000
+G1 X49.500 Y31.500 E14.66611 F3000
+G1 X51.500 Y31.500 E14.73211 F3000
+G1 X31.500 Y51.500 E15.66549 F3000
+G1 X31.500 Y53.500 E15.73149 F3000
+G1 X53.500 Y31.500 E16.75821 F3000
+G1 X55.500 Y31.500 E16.82421 F3000
+G1 X31.500 Y55.500 E17.94427 F3000
+G1 X31.500 Y57.500 E18.01027 F3000
+G1 X57.500 Y31.500 E19.22366 F3000
+G1 X59.500 Y31.500 E19.28966 F3000
+G1 X31.500 Y59.500 E20.59640 F3000
+G1 X31.500 Y61.500 E20.66240 F3000
+G1 X61.500 Y31.500 E22.06247 F3000
+G1 X63.500 Y31.500 E22.12847 F3000
+G1 X31.500 Y63.500 E23.62188 F3000
+G1 X31.500 Y65.500 E23.68788 F3000
+G1 X65.500 Y31.500 E25.27463 F3000
+G1 X67.500 Y31.500 E25.34063 F3000
+G1 X31.500 Y67.500 E27.02071 F3000
+G1 E26.02071 F2400
+G0 Z0.40 F3000
+G1 E27.02071 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E27.04660 F1800
+G1 X66.545 Y30.245 E27.07250 F1800
+G1 X67.270 Y30.545 E27.09839 F1800
+G1 X67.939 Y30.955 E27.12428 F1800
+G1 X68.536 Y31.464 E27.15017 F1800
+G1 X69.045 Y32.061 E27.17606 F1800
+G1 X69.455 Y32.730 E27.20195 F1800
+G1 X69.755 Y33.455 E27.22784 F1800
+G1 X69.938 Y34.218 E27.25374 F1800
+G1 X70.000 Y65.000 E28.26955 F1800
+G1 X69.938 Y65.782 E28.29544 F1800
+G1 X69.755 Y66.545 E28.32133 F1800
+G1 X69.455 Y67.270 E28.34722 F1800
+G1 X69.045 Y67.939 E28.37312 F1800
+G1 X68.536 Y68.536 E28.39901 F1800
+G1 X67.939 Y69.045 E28.42490 F1800
+G1 X67.270 Y69.455 E28.45079 F1800
+G1 X66.545 Y69.755 E28.47668 F1800
+G1 X65.782 Y69.938 E28.50257 F1800
+G1 X35.000 Y70.000 E29.51839 F1800
+G1 X34.218 Y69.938 E29.54428 F1800
+G1 X33.455 Y69.755 E29.57017 F1800
+G1 X32.730 Y69.455 E29.59606 F1800
+G1 X32.061 Y69.045 E29.62195 F1800
+G1 X31.464 Y68.536 E29.64784 F1800
+G1 X30.955 Y67.939 E29.67374 F1800
+G1 X30.545 Y67.270 E29.69963 F1800
+G1 X30.245 Y66.545 E29.72552 F1800
+G1 X30.062 Y65.782 E29.75141 F1800
+G1 X30.000 Y35.000 E30.76722 F1800
+G1 X30.062 Y34.218 E30.79312 F1800
+G1 X30.245 Y33.455 E30.81901 F1800
+G1 X30.545 Y32.730 E30.84490 F1800
+G1 X30.955 Y32.061 E30.87079 F1800
+G1 X31.464 Y31.464 E30.89668 F1800
+G1 X32.061 Y30.955 E30.92257 F1800
+G1 X32.730 Y30.545 E30.94846 F1800
+G1 X33.455 Y30.245 E30.97436 F1800
+G1 X34.218 Y30.062 E31.00025 F1800
+G1 X65.000 Y30.000 E32.01606 F1800
+G1 E31.01606 F2400
+G1 E32.01606 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E32.04195 F1800
+G1 X66.095 Y30.695 E32.06784 F1800
+G1 X66.820 Y30.995 E32.09374 F1800
+G1 X67.489 Y31.405 E32.11963 F1800
+G1 X68.086 Y31.914 E32.14552 F1800
+G1 X68.595 Y32.511 E32.17141 F1800
+G1 X69.005 Y33.180 E32.19730 F1800
+G1 X69.305 Y33.905 E32.22319 F1800
+G1 X69.488 Y34.668 E32.24908 F1800
+G1 X69.550 Y64.550 E33.23520 F1800
+G1 X69.488 Y65.332 E33.26109 F1800
+G1 X69.305 Y66.095 E33.28698 F1800
+G1 X69.005 Y66.820 E33.31287 F1800
+G1 X68.595 Y67.489 E33.33876 F1800
+G1 X68.086 Y68.086 E33.36466 F1800
+G1 X67.489 Y68.595 E33.39055 F1800
+G1 X66.820 Y69.005 E33.41644 F1800
+G1 X66.095 Y69.305 E33.44233 F1800
+G1 X65.332 Y69.488 E33.46822 F1800
+G1 X35.450 Y69.550 E34.45434 F1800
+G1 X34.668 Y69.488 E34.48023 F1800
+G1 X33.905 Y69.305 E34.50612 F1800
+G1 X33.180 Y69.005 E34.53201 F1800
+G1 X32.511 Y68.595 E34.55790 F1800
+G1 X31.914 Y68.086 E34.58379 F1800
+G1 X31.405 Y67.489 E34.60968 F1800
+G1 X30.995 Y66.820 E34.63558 F1800
+G1 X30.695 Y66.095 E34.66147 F1800
+G1 X30.512 Y65.332 E34.68736 F1800
+G1 X30.450 Y35.450 E35.67347 F1800
+G1 X30.512 Y34.668 E35.69936 F1800
+G1 X30.695 Y33.905 E35.72526 F1800
+G1 X30.995 Y33.180 E35.75115 F1800
+G1 X31.405 Y32.511 E35.77704 F1800
+G1 X31.914 Y31.914 E35.80293 F1800
+G1 X32.511 Y31.405 E35.82882 F1800
+G1 X33.180 Y30.995 E35.85471 F1800
+G1 X33.905 Y30.695 E35.88061 F1800
+G1 X34.668 Y30.512 E35.90650 F1800
+G1 X64.550 Y30.450 E36.89261 F1800
+G1 E35.89261 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E36.89261 F3000
+G1 X33.500 Y31.500 E36.95861 F3000
+G1 X31.500 Y33.500 E37.05195 F3000
+G1 X31.500 Y35.500 E37.11795 F3000
+G1 X35.500 Y31.500 E37.30462 F3000
+G1 X37.500 Y31.500 E37.37062 F3000
+G1 X31.500 Y37.500 E37.65064 F3000
+G1 X31.500 Y39.500 E37.71664 F3000
+G1 X39.500 Y31.500 E38.08999 F3000
+G1 X41.500 Y31.500 E38.15599 F3000
+G1 X31.500 Y41.500 E38.62268 F3000
+G1 X31.500 Y43.500 E38.68868 F3000
+G1 X43.500 Y31.500 E39.24871 F3000
+G1 X45.500 Y31.500 E39.31471 F3000
+G1 X31.500 Y45.500 E39.96808 F3000
+G1 X31.500 Y47.500 E40.03408 F3000
+G1 X47.500 Y31.500 E40.78078 F3000
+G1 X49.500 Y31.500 E40.84678 F3000
+G1 X31.500 Y49.500 E41.68682 F3000
+G1 X31.500 Y51.500 E41.75282 F3000
+G1 X51.500 Y31.500 E42.68621 F3000
+G1 X53.500 Y31.500 E42.75221 F3000
+G1 X31.500 Y53.500 E43.77892 F3000
+G1 X31.500 Y55.500 E43.84492 F3000
+G1 X55.500 Y31.500 E44.96498 F3000
+G1 X57.500 Y31.500 E45.03098 F3000
+G1 X31.500 Y57.500 E46.24438 F3000
+G1 X31.500 Y59.500 E46.31038 F3000
+G1 X59.500 Y31.500 E47.61711 F3000
+G1 X61.500 Y31.500 E47.68311 F3000
+G1 X31.500 Y61.500 E49.08318 F3000
+G1 X31.500 Y63.500 E49.14918 F3000
+G1 X63.500 Y31.500 E50.64259 F3000
+G1 X65.500 Y31.500 E50.70859 F3000
+G1 X31.500 Y65.500 E52.29534 F3000
+G1 X31.500 Y67.500 E52.36134 F3000
+G1 X67.500 Y31.500 E54.04142 F3000
+G1 E53.04142 F2400
+G0 Z0.60 F3000
+G1 E54.04142 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E54.06732 F1800
+G1 X66.545 Y30.245 E54.09321 F1800
+G1 X67.270 Y30.545 E54.11910 F1800
+G1 X67.939 Y30.955 E54.14499 F1800
+G1 X68.536 Y31.464 E54.17088 F1800
+G1 X69.045 Y32.061 E54.19677 F1800
+G1 X69.455 Y32.730 E54.22267 F1800
+G1 X69.755 Y33.455 E54.24856 F1800
+G1 X69.938 Y34.218 E54.27445 F1800
+G1 X70.000 Y65.000 E55.29026 F1800
+G1 X69.938 Y65.782 E55.31615 F1800
+G1 X69.755 Y66.545 E55.34204 F1800
+G1 X69.455 Y67.270 E55.36794 F1800
+G1 X69.045 Y67.939 E55.39383 F1800
+G1 X68.536 Y68.536 E55.41972 F1800
+G1 X67.939 Y69.045 E55.44561 F1800
+G1 X67.270 Y69.455 E55.47150 F1800
+G1 X66.545 Y69.755 E55.49739 F1800
+G1 X65.782 Y69.938 E55.52329 F1800
+G1 X35.000 Y70.000 E56.53910 F1800
+G1 X34.218 Y69.938 E56.56499 F1800
+G1 X33.455 Y69.755 E56.59088 F1800
+G1 X32.730 Y69.455 E56.61677 F1800
+G1 X32.061 Y69.045 E56.64267 F1800
+G1 X31.464 Y68.536 E56.66856 F1800
+G1 X30.955 Y67.939 E56.69445 F1800
+G1 X30.545 Y67.270 E56.72034 F1800
+G1 X30.245 Y66.545 E56.74623 F1800
+G1 X30.062 Y65.782 E56.77212 F1800
+G1 X30.000 Y35.000 E57.78794 F1800
+G1 X30.062 Y34.218 E57.81383 F1800
+G1 X30.245 Y33.455 E57.83972 F1800
+G1 X30.545 Y32.730 E57.86561 F1800
+G1 X30.955 Y32.061 E57.89150 F1800
+G1 X31.464 Y31.464 E57.91739 F1800
+G1 X32.061 Y30.955 E57.94329 F1800
+G1 X32.730 Y30.545 E57.96918 F1800
+G1 X33.455 Y30.245 E57.99507 F1800
+G1 X34.218 Y30.062 E58.02096 F1800
+G1 X65.000 Y30.000 E59.03677 F1800
+G1 E58.03677 F2400
+G1 E59.03677 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E59.06267 F1800
+G1 X66.095 Y30.695 E59.08856 F1800
+G1 X66.820 Y30.995 E59.11445 F1800
+G1 X67.489 Y31.405 E59.14034 F1800
+G1 X68.086 Y31.914 E59.16623 F1800
+G1 X68.595 Y32.511 E59.19212 F1800
+G1 X69.005 Y33.180 E59.21801 F1800
+G1 X69.305 Y33.905 E59.24391 F1800
+G1 X69.488 Y34.668 E59.26980 F1800
+G1 X69.550 Y64.550 E60.25591 F1800
+G1 X69.488 Y65.332 E60.28180 F1800
+G1 X69.305 Y66.095 E60.30769 F1800
+G1 X69.005 Y66.820 E60.33359 F1800
+G1 X68.595 Y67.489 E60.35948 F1800
+G1 X68.086 Y68.086 E60.38537 F1800
+G1 X67.489 Y68.595 E60.41126 F1800
+G1 X66.820 Y69.005 E60.43715 F1800
+G1 X66.095 Y69.305 E60.46304 F1800
+G1 X65.332 Y69.488 E60.48893 F1800
+G1 X35.450 Y69.550 E61.47505 F1800
+G1 X34.668 Y69.488 E61.50094 F1800
+G1 X33.905 Y69.305 E61.52683 F1800
+G1 X33.180 Y69.005 E61.55272 F1800
+G1 X32.511 Y68.595 E61.57861 F1800
+G1 X31.914 Y68.086 E61.60451 F1800
+G1 X31.405 Y67.489 E61.63040 F1800
+G1 X30.995 Y66.820 E61.65629 F1800
+G1 X30.695 Y66.095 E61.68218 F1800
+G1 X30.512 Y65.332 E61.70807 F1800
+G1 X30.450 Y35.450 E62.69419 F1800
+G1 X30.512 Y34.668 E62.72008 F1800
+G1 X30.695 Y33.905 E62.74597 F1800
+G1 X30.995 Y33.180 E62.77186 F1800
+G1 X31.405 Y32.511 E62.79775 F1800
+G1 X31.914 Y31.914 E62.82364 F1800
+G1 X32.511 Y31.405 E62.84953 F1800
+G1 X33.180 Y30.995 E62.87543 F1800
+G1 X33.905 Y30.695 E62.90132 F1800
+G1 X34.668 Y30.512 E62.92721 F1800
+G1 X64.550 Y30.450 E63.91332 F1800
+G1 E62.91332 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E63.91332 F3000
+G1 X31.500 Y33.500 E63.97932 F3000
+G1 X33.500 Y31.500 E64.07266 F3000
+G1 X35.500 Y31.500 E64.13866 F3000
+G1 X31.500 Y35.500 E64.32534 F3000
+G1 X31.500 Y37.500 E64.39134 F3000
+G1 X37.500 Y31.500 E64.67135 F3000
+G1 X39.500 Y31.500 E64.73735 F3000
+G1 X31.500 Y39.500 E65.11070 F3000
+G1 X31.500 Y41.500 E65.17670 F3000
+G1 X41.500 Y31.500 E65.64339 F3000
+G1 X43.500 Y31.500 E65.70939 F3000
+G1 X31.500 Y43.500 E66.26942 F3000
+G1 X31.500 Y45.500 E66.33542 F3000
+G1 X45.500 Y31.500 E66.98879 F3000
+G1 X47.500 Y31.500 E67.05479 F3000
+G1 X31.500 Y47.500 E67.80149 F3000
+G1 X31.500 Y49.500 E67.86749 F3000
+G1 X49.500 Y31.500 E68.70754 F3000
+G1 X51.500 Y31.500 E68.77354 F3000
+G1 X31.500 Y51.500 E69.70692 F3000
+G1 X31.500 Y53.500 E69.77292 F3000
+G1 X53.500 Y31.500 E70.79964 F3000
+G1 X55.500 Y31.500 E70.86564 F3000
+G1 X31.500 Y55.500 E71.98569 F3000
+G1 X31.500 Y57.500 E72.05169 F3000
+G1 X57.500 Y31.500 E73.26509 F3000
+G1 X59.500 Y31.500 E73.33109 F3000
+G1 X31.500 Y59.500 E74.63782 F3000
+G1 X31.500 Y61.500 E74.70382 F3000
+G1 X61.500 Y31.500 E76.10389 F3000
+G1 X63.500 Y31.500 E76.16989 F3000
+G1 X31.500 Y63.500 E77.66330 F3000
+G1 X31.500 Y65.500 E77.72930 F3000
+G1 X65.500 Y31.500 E79.31605 F3000
+G1 X67.500 Y31.500 E79.38205 F3000
+G1 X31.500 Y67.500 E81.06214 F3000
+G1 E80.06214 F2400
+G0 Z0.80 F3000
+G1 E81.06214 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E81.08803 F1800
+G1 X66.545 Y30.245 E81.11392 F1800
+G1 X67.270 Y30.545 E81.13981 F1800
+G1 X67.939 Y30.955 E81.16570 F1800
+G1 X68.536 Y31.464 E81.19159 F1800
+G1 X69.045 Y32.061 E81.21749 F1800
+G1 X69.455 Y32.730 E81.24338 F1800
+G1 X69.755 Y33.455 E81.26927 F1800
+G1 X69.938 Y34.218 E81.29516 F1800
+G1 X70.000 Y65.000 E82.31097 F1800
+G1 X69.938 Y65.782 E82.33687 F1800
+G1 X69.755 Y66.545 E82.36276 F1800
+G1 X69.455 Y67.270 E82.38865 F1800
+G1 X69.045 Y67.939 E82.41454 F1800
+G1 X68.536 Y68.536 E82.44043 F1800
+G1 X67.939 Y69.045 E82.46632 F1800
+G1 X67.270 Y69.455 E82.49221 F1800
+G1 X66.545 Y69.755 E82.51811 F1800
+G1 X65.782 Y69.938 E82.54400 F1800
+G1 X35.000 Y70.000 E83.55981 F1800
+G1 X34.218 Y69.938 E83.58570 F1800
+G1 X33.455 Y69.755 E83.61159 F1800
+G1 X32.730 Y69.455 E83.63749 F1800
+G1 X32.061 Y69.045 E83.66338 F1800
+G1 X31.464 Y68.536 E83.68927 F1800
+G1 X30.955 Y67.939 E83.71516 F1800
+G1 X30.545 Y67.270 E83.74105 F1800
+G1 X30.245 Y66.545 E83.76694 F1800
+G1 X30.062 Y65.782 E83.79284 F1800
+G1 X30.000 Y35.000 E84.80865 F1800
+G1 X30.062 Y34.218 E84.83454 F1800
+G1 X30.245 Y33.455 E84.86043 F1800
+G1 X30.545 Y32.730 E84.88632 F1800
+G1 X30.955 Y32.061 E84.91221 F1800
+G1 X31.464 Y31.464 E84.93811 F1800
+G1 X32.061 Y30.955 E84.96400 F1800
+G1 X32.730 Y30.545 E84.98989 F1800
+G1 X33.455 Y30.245 E85.01578 F1800
+G1 X34.218 Y30.062 E85.04167 F1800
+G1 X65.000 Y30.000 E86.05749 F1800
+G1 E85.05749 F2400
+G1 E86.05749 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E86.08338 F1800
+G1 X66.095 Y30.695 E86.10927 F1800
+G1 X66.820 Y30.995 E86.13516 F1800
+G1 X67.489 Y31.405 E86.16105 F1800
+G1 X68.086 Y31.914 E86.18694 F1800
+G1 X68.595 Y32.511 E86.21284 F1800
+G1 X69.005 Y33.180 E86.23873 F1800
+G1 X69.305 Y33.905 E86.26462 F1800
+G1 X69.488 Y34.668 E86.29051 F1800
+G1 X69.550 Y64.550 E87.27662 F1800
+G1 X69.488 Y65.332 E87.30251 F1800
+G1 X69.305 Y66.095 E87.32841 F1800
+G1 X69.005 Y66.820 E87.35430 F1800
+G1 X68.595 Y67.489 E87.38019 F1800
+G1 X68.086 Y68.086 E87.40608 F1800
+G1 X67.489 Y68.595 E87.43197 F1800
+G1 X66.820 Y69.005 E87.45786 F1800
+G1 X66.095 Y69.305 E87.48376 F1800
+G1 X65.332 Y69.488 E87.50965 F1800
+G1 X35.450 Y69.550 E88.49576 F1800
+G1 X34.668 Y69.488 E88.52165 F1800
+G1 X33.905 Y69.305 E88.54754 F1800
+G1 X33.180 Y69.005 E88.57344 F1800
+G1 X32.511 Y68.595 E88.59933 F1800
+G1 X31.914 Y68.086 E88.62522 F1800
+G1 X31.405 Y67.489 E88.65111 F1800
+G1 X30.995 Y66.820 E88.67700 F1800
+G1 X30.695 Y66.095 E88.70289 F1800
+G1 X30.512 Y65.332 E88.72878 F1800
+G1 X30.450 Y35.450 E89.71490 F1800
+G1 X30.512 Y34.668 E89.74079 F1800
+G1 X30.695 Y33.905 E89.76668 F1800
+G1 X30.995 Y33.180 E89.79257 F1800
+G1 X31.405 Y32.511 E89.81846 F1800
+G1 X31.914 Y31.914 E89.84436 F1800
+G1 X32.511 Y31.405 E89.87025 F1800
+G1 X33.180 Y30.995 E89.89614 F1800
+G1 X33.905 Y30.695 E89.92203 F1800
+G1 X34.668 Y30.512 E89.94792 F1800
+G1 X64.550 Y30.450 E90.93404 F1800
+G1 E89.93404 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E90.93404 F3000
+G1 X33.500 Y31.500 E91.00004 F3000
+G1 X31.500 Y33.500 E91.09337 F3000
+G1 X31.500 Y35.500 E91.15937 F3000
+G1 X35.500 Y31.500 E91.34605 F3000
+G1 X37.500 Y31.500 E91.41205 F3000
+G1 X31.500 Y37.500 E91.69206 F3000
+G1 X31.500 Y39.500 E91.75806 F3000
+G1 X39.500 Y31.500 E92.13142 F3000
+G1 X41.500 Y31.500 E92.19742 F3000
+G1 X31.500 Y41.500 E92.66411 F3000
+G1 X31.500 Y43.500 E92.73011 F3000
+G1 X43.500 Y31.500 E93.29014 F3000
+G1 X45.500 Y31.500 E93.35614 F3000
+G1 X31.500 Y45.500 E94.00950 F3000
+G1 X31.500 Y47.500 E94.07550 F3000
+G1 X47.500 Y31.500 E94.82221 F3000
+G1 X49.500 Y31.500 E94.88821 F3000
+G1 X31.500 Y49.500 E95.72825 F3000
+G1 X31.500 Y51.500 E95.79425 F3000
+G1 X51.500 Y31.500 E96.72763 F3000
+G1 X53.500 Y31.500 E96.79363 F3000
+G1 X31.500 Y53.500 E97.82035 F3000
+G1 X31.500 Y55.500 E97.88635 F3000
+G1 X55.500 Y31.500 E99.00641 F3000
+G1 X57.500 Y31.500 E99.07241 F3000
+G1 X31.500 Y57.500 E100.28580 F3000
+G1 X31.500 Y59.500 E100.35180 F3000
+G1 X59.500 Y31.500 E101.65854 F3000
+G1 X61.500 Y31.500 E101.72454 F3000
+G1 X31.500 Y61.500 E103.12461 F3000
+G1 X31.500 Y63.500 E103.19061 F3000
+G1 X63.500 Y31.500 E104.68402 F3000
+G1 X65.500 Y31.500 E104.75002 F3000
+G1 X31.500 Y65.500 E106.33676 F3000
+G1 X31.500 Y67.500 E106.40276 F3000
+G1 X67.500 Y31.500 E108.08285 F3000
+G1 E107.08285 F2400
+G0 Z1.00 F3000
+G1 E108.08285 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E108.10874 F1800
+G1 X66.545 Y30.245 E108.13463 F1800
+G1 X67.270 Y30.545 E108.16052 F1800
+G1 X67.939 Y30.955 E108.18642 F1800
+G1 X68.536 Y31.464 E108.21231 F1800
+G1 X69.045 Y32.061 E108.23820 F1800
+G1 X69.455 Y32.730 E108.26409 F1800
+G1 X69.755 Y33.455 E108.28998 F1800
+G1 X69.938 Y34.218 E108.31587 F1800
+G1 X70.000 Y65.000 E109.33169 F1800
+G1 X69.938 Y65.782 E109.35758 F1800
+G1 X69.755 Y66.545 E109.38347 F1800
+G1 X69.455 Y67.270 E109.40936 F1800
+G1 X69.045 Y67.939 E109.43525 F1800
+G1 X68.536 Y68.536 E109.46114 F1800
+G1 X67.939 Y69.045 E109.48704 F1800
+G1 X67.270 Y69.455 E109.51293 F1800
+G1 X66.545 Y69.755 E109.53882 F1800
+G1 X65.782 Y69.938 E109.56471 F1800
+G1 X35.000 Y70.000 E110.58052 F1800
+G1 X34.218 Y69.938 E110.60642 F1800
+G1 X33.455 Y69.755 E110.63231 F1800
+G1 X32.730 Y69.455 E110.65820 F1800
+G1 X32.061 Y69.045 E110.68409 F1800
+G1 X31.464 Y68.536 E110.70998 F1800
+G1 X30.955 Y67.939 E110.73587 F1800
+G1 X30.545 Y67.270 E110.76176 F1800
+G1 X30.245 Y66.545 E110.78766 F1800
+G1 X30.062 Y65.782 E110.81355 F1800
+G1 X30.000 Y35.000 E111.82936 F1800
+G1 X30.062 Y34.218 E111.85525 F1800
+G1 X30.245 Y33.455 E111.88114 F1800
+G1 X30.545 Y32.730 E111.90704 F1800
+G1 X30.955 Y32.061 E111.93293 F1800
+G1 X31.464 Y31.464 E111.95882 F1800
+G1 X32.061 Y30.955 E111.98471 F1800
+G1 X32.730 Y30.545 E112.01060 F1800
+G1 X33.455 Y30.245 E112.03649 F1800
+G1 X34.218 Y30.062 E112.06238 F1800
+G1 X65.000 Y30.000 E113.07820 F1800
+G1 E112.07820 F2400
+G1 E113.07820 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E113.10409 F1800
+G1 X66.095 Y30.695 E113.12998 F1800
+G1 X66.820 Y30.995 E113.15587 F1800
+G1 X67.489 Y31.405 E113.18176 F1800
+G1 X68.086 Y31.914 E113.20766 F1800
+G1 X68.595 Y32.511 E113.23355 F1800
+G1 X69.005 Y33.180 E113.25944 F1800
+G1 X69.305 Y33.905 E113.28533 F1800
+G1 X69.488 Y34.668 E113.31122 F1800
+G1 X69.550 Y64.550 E114.29734 F1800
+G1 X69.488 Y65.332 E114.32323 F1800
+G1 X69.305 Y66.095 E114.34912 F1800
+G1 X69.005 Y66.820 E114.37501 F1800
+G1 X68.595 Y67.489 E114.40090 F1800
+G1 X68.086 Y68.086 E114.42679 F1800
+G1 X67.489 Y68.595 E114.45268 F1800
+G1 X66.820 Y69.005 E114.47858 F1800
+G1 X66.095 Y69.305 E114.50447 F1800
+G1 X65.332 Y69.488 E114.53036 F1800
+G1 X35.450 Y69.550 E115.51647 F1800
+G1 X34.668 Y69.488 E115.54236 F1800
+G1 X33.905 Y69.305 E115.56826 F1800
+G1 X33.180 Y69.005 E115.59415 F1800
+G1 X32.511 Y68.595 E115.62004 F1800
+G1 X31.914 Y68.086 E115.64593 F1800
+G1 X31.405 Y67.489 E115.67182 F1800
+G1 X30.995 Y66.820 E115.69771 F1800
+G1 X30.695 Y66.095 E115.72360 F1800
+G1 X30.512 Y65.332 E115.74950 F1800
+G1 X30.450 Y35.450 E116.73561 F1800
+G1 X30.512 Y34.668 E116.76150 F1800
+G1 X30.695 Y33.905 E116.78739 F1800
+G1 X30.995 Y33.180 E116.81328 F1800
+G1 X31.405 Y32.511 E116.83918 F1800
+G1 X31.914 Y31.914 E116.86507 F1800
+G1 X32.511 Y31.405 E116.89096 F1800
+G1 X33.180 Y30.995 E116.91685 F1800
+G1 X33.905 Y30.695 E116.94274 F1800
+G1 X34.668 Y30.512 E116.96863 F1800
+G1 X64.550 Y30.450 E117.95475 F1800
+G1 E116.95475 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E117.95475 F3000
+G1 X31.500 Y33.500 E118.02075 F3000
+G1 X33.500 Y31.500 E118.11409 F3000
+G1 X35.500 Y31.500 E118.18009 F3000
+G1 X31.500 Y35.500 E118.36676 F3000
+G1 X31.500 Y37.500 E118.43276 F3000
+G1 X37.500 Y31.500 E118.71278 F3000
+G1 X39.500 Y31.500 E118.77878 F3000
+G1 X31.500 Y39.500 E119.15213 F3000
+G1 X31.500 Y41.500 E119.21813 F3000
+G1 X41.500 Y31.500 E119.68482 F3000
+G1 X43.500 Y31.500 E119.75082 F3000
+G1 X31.500 Y43.500 E120.31085 F3000
+G1 X31.500 Y45.500 E120.37685 F3000
+G1 X45.500 Y31.500 E121.03021 F3000
+G1 X47.500 Y31.500 E121.09621 F3000
+G1 X31.500 Y47.500 E121.84292 F3000
+G1 X31.500 Y49.500 E121.90892 F3000
+G1 X49.500 Y31.500 E122.74896 F3000
+G1 X51.500 Y31.500 E122.81496 F3000
+G1 X31.500 Y51.500 E123.74834 F3000
+G1 X31.500 Y53.500 E123.81434 F3000
+G1 X53.500 Y31.500 E124.84106 F3000
+G1 X55.500 Y31.500 E124.90706 F3000
+G1 X31.500 Y55.500 E126.02712 F3000
+G1 X31.500 Y57.500 E126.09312 F3000
+G1 X57.500 Y31.500 E127.30651 F3000
+G1 X59.500 Y31.500 E127.37251 F3000
+G1 X31.500 Y59.500 E128.67925 F3000
+G1 X31.500 Y61.500 E128.74525 F3000
+G1 X61.500 Y31.500 E130.14532 F3000
+G1 X63.500 Y31.500 E130.21132 F3000
+G1 X31.500 Y63.500 E131.70473 F3000
+G1 X31.500 Y65.500 E131.77073 F3000
+G1 X65.500 Y31.500 E133.35748 F3000
+G1 X67.500 Y31.500 E133.42348 F3000
+G1 X31.500 Y67.500 E135.10356 F3000
+G1 E134.10356 F2400
+G0 Z1.20 F3000
+G1 E135.10356 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E135.12945 F1800
+G1 X66.545 Y30.245 E135.15534 F1800
+G1 X67.270 Y30.545 E135.18124 F1800
+G1 X67.939 Y30.955 E135.20713 F1800
+G1 X68.536 Y31.464 E135.23302 F1800
+G1 X69.045 Y32.061 E135.25891 F1800
+G1 X69.455 Y32.730 E135.28480 F1800
+G1 X69.755 Y33.455 E135.31069 F1800
+G1 X69.938 Y34.218 E135.33659 F1800
+G1 X70.000 Y65.000 E136.35240 F1800
+G1 X69.938 Y65.782 E136.37829 F1800
+G1 X69.755 Y66.545 E136.40418 F1800
+G1 X69.455 Y67.270 E136.43007 F1800
+G1 X69.045 Y67.939 E136.45597 F1800
+G1 X68.536 Y68.536 E136.48186 F1800
+G1 X67.939 Y69.045 E136.50775 F1800
+G1 X67.270 Y69.455 E136.53364 F1800
+G1 X66.545 Y69.755 E136.55953 F1800
+G1 X65.782 Y69.938 E136.58542 F1800
+G1 X35.000 Y70.000 E137.60124 F1800
+G1 X34.218 Y69.938 E137.62713 F1800
+G1 X33.455 Y69.755 E137.65302 F1800
+G1 X32.730 Y69.455 E137.67891 F1800
+G1 X32.061 Y69.045 E137.70480 F1800
+G1 X31.464 Y68.536 E137.73069 F1800
+G1 X30.955 Y67.939 E137.75659 F1800
+G1 X30.545 Y67.270 E137.78248 F1800
+G1 X30.245 Y66.545 E137.80837 F1800
+G1 X30.062 Y65.782 E137.83426 F1800
+G1 X30.000 Y35.000 E138.85007 F1800
+G1 X30.062 Y34.218 E138.87597 F1800
+G1 X30.245 Y33.455 E138.90186 F1800
+G1 X30.545 Y32.730 E138.92775 F1800
+G1 X30.955 Y32.061 E138.95364 F1800
+G1 X31.464 Y31.464 E138.97953 F1800
+G1 X32.061 Y30.955 E139.00542 F1800
+G1 X32.730 Y30.545 E139.03131 F1800
+G1 X33.455 Y30.245 E139.05721 F1800
+G1 X34.218 Y30.062 E139.08310 F1800
+G1 X65.000 Y30.000 E140.09891 F1800
+G1 E139.09891 F2400
+G1 E140.09891 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E140.12480 F1800
+G1 X66.095 Y30.695 E140.15069 F1800
+G1 X66.820 Y30.995 E140.17659 F1800
+G1 X67.489 Y31.405 E140.20248 F1800
+G1 X68.086 Y31.914 E140.22837 F1800
+G1 X68.595 Y32.511 E140.25426 F1800
+G1 X69.005 Y33.180 E140.28015 F1800
+G1 X69.305 Y33.905 E140.30604 F1800
+G1 X69.488 Y34.668 E140.33193 F1800
+G1 X69.550 Y64.550 E141.31805 F1800
+G1 X69.488 Y65.332 E141.34394 F1800
+G1 X69.305 Y66.095 E141.36983 F1800
+G1 X69.005 Y66.820 E141.39572 F1800
+G1 X68.595 Y67.489 E141.42161 F1800
+G1 X68.086 Y68.086 E141.44751 F1800
+G1 X67.489 Y68.595 E141.47340 F1800
+G1 X66.820 Y69.005 E141.49929 F1800
+G1 X66.095 Y69.305 E141.52518 F1800
+G1 X65.332 Y69.488 E141.55107 F1800
+G1 X35.450 Y69.550 E142.53719 F1800
+G1 X34.668 Y69.488 E142.56308 F1800
+G1 X33.905 Y69.305 E142.58897 F1800
+G1 X33.180 Y69.005 E142.61486 F1800
+G1 X32.511 Y68.595 E142.64075 F1800
+G1 X31.914 Y68.086 E142.66664 F1800
+G1 X31.405 Y67.489 E142.69253 F1800
+G1 X30.995 Y66.820 E142.71843 F1800
+G1 X30.695 Y66.095 E142.74432 F1800
+G1 X30.512 Y65.332 E142.77021 F1800
+G1 X30.450 Y35.450 E143.75632 F1800
+G1 X30.512 Y34.668 E143.78221 F1800
+G1 X30.695 Y33.905 E143.80811 F1800
+G1 X30.995 Y33.180 E143.83400 F1800
+G1 X31.405 Y32.511 E143.85989 F1800
+G1 X31.914 Y31.914 E143.88578 F1800
+G1 X32.511 Y31.405 E143.91167 F1800
+G1 X33.180 Y30.995 E143.93756 F1800
+G1 X33.905 Y30.695 E143.96345 F1800
+G1 X34.668 Y30.512 E143.98935 F1800
+G1 X64.550 Y30.450 E144.97546 F1800
+G1 E143.97546 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E144.97546 F3000
+G1 X33.500 Y31.500 E145.04146 F3000
+G1 X31.500 Y33.500 E145.13480 F3000
+G1 X31.500 Y35.500 E145.20080 F3000
+G1 X35.500 Y31.500 E145.38747 F3000
+G1 X37.500 Y31.500 E145.45347 F3000
+G1 X31.500 Y37.500 E145.73349 F3000
+G1 X31.500 Y39.500 E145.79949 F3000
+G1 X39.500 Y31.500 E146.17284 F3000
+G1 X41.500 Y31.500 E146.23884 F3000
+G1 X31.500 Y41.500 E146.70553 F3000
+G1 X31.500 Y43.500 E146.77153 F3000
+G1 X43.500 Y31.500 E147.33156 F3000
+G1 X45.500 Y31.500 E147.39756 F3000
+G1 X31.500 Y45.500 E148.05093 F3000
+G1 X31.500 Y47.500 E148.11693 F3000
+G1 X47.500 Y31.500 E148.86363 F3000
+G1 X49.500 Y31.500 E148.92963 F3000
+G1 X31.500 Y49.500 E149.76967 F3000
+G1 X31.500 Y51.500 E149.83567 F3000
+G1 X51.500 Y31.500 E150.76906 F3000
+G1 X53.500 Y31.500 E150.83506 F3000
+G1 X31.500 Y53.500 E151.86177 F3000
+G1 X31.500 Y55.500 E151.92777 F3000
+G1 X55.500 Y31.500 E153.04783 F3000
+G1 X57.500 Y31.500 E153.11383 F3000
+G1 X31.500 Y57.500 E154.32723 F3000
+G1 X31.500 Y59.500 E154.39323 F3000
+G1 X59.500 Y31.500 E155.69996 F3000
+G1 X61.500 Y31.500 E155.76596 F3000
+G1 X31.500 Y61.500 E157.16603 F3000
+G1 X31.500 Y63.500 E157.23203 F3000
+G1 X63.500 Y31.500 E158.72544 F3000
+G1 X65.500 Y31.500 E158.79144 F3000
+G1 X31.500 Y65.500 E160.37819 F3000
+G1 X31.500 Y67.500 E160.44419 F3000
+G1 X67.500 Y31.500 E162.12427 F3000
+G1 E161.12427 F2400
+G0 Z1.40 F3000
+G1 E162.12427 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E162.15017 F1800
+G1 X66.545 Y30.245 E162.17606 F1800
+G1 X67.270 Y30.545 E162.20195 F1800
+G1 X67.939 Y30.955 E162.22784 F1800
+G1 X68.536 Y31.464 E162.25373 F1800
+G1 X69.045 Y32.061 E162.27962 F1800
+G1 X69.455 Y32.730 E162.30551 F1800
+G1 X69.755 Y33.455 E162.33141 F1800
+G1 X69.938 Y34.218 E162.35730 F1800
+G1 X70.000 Y65.000 E163.37311 F1800
+G1 X69.938 Y65.782 E163.39900 F1800
+G1 X69.755 Y66.545 E163.42489 F1800
+G1 X69.455 Y67.270 E163.45079 F1800
+G1 X69.045 Y67.939 E163.47668 F1800
+G1 X68.536 Y68.536 E163.50257 F1800
+G1 X67.939 Y69.045 E163.52846 F1800
+G1 X67.270 Y69.455 E163.55435 F1800
+G1 X66.545 Y69.755 E163.58024 F1800
+G1 X65.782 Y69.938 E163.60613 F1800
+G1 X35.000 Y70.000 E164.62195 F1800
+G1 X34.218 Y69.938 E164.64784 F1800
+G1 X33.455 Y69.755 E164.67373 F1800
+G1 X32.730 Y69.455 E164.69962 F1800
+G1 X32.061 Y69.045 E164.72551 F1800
+G1 X31.464 Y68.536 E164.75141 F1800
+G1 X30.955 Y67.939 E164.77730 F1800
+G1 X30.545 Y67.270 E164.80319 F1800
+G1 X30.245 Y66.545 E164.82908 F1800
+G1 X30.062 Y65.782 E164.85497 F1800
+G1 X30.000 Y35.000 E165.87079 F1800
+G1 X30.062 Y34.218 E165.89668 F1800
+G1 X30.245 Y33.455 E165.92257 F1800
+G1 X30.545 Y32.730 E165.94846 F1800
+G1 X30.955 Y32.061 E165.97435 F1800
+G1 X31.464 Y31.464 E166.00024 F1800
+G1 X32.061 Y30.955 E166.02613 F1800
+G1 X32.730 Y30.545 E166.05203 F1800
+G1 X33.455 Y30.245 E166.07792 F1800
+G1 X34.218 Y30.062 E166.10381 F1800
+G1 X65.000 Y30.000 E167.11962 F1800
+G1 E166.11962 F2400
+G1 E167.11962 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E167.14551 F1800
+G1 X66.095 Y30.695 E167.17141 F1800
+G1 X66.820 Y30.995 E167.19730 F1800
+G1 X67.489 Y31.405 E167.22319 F1800
+G1 X68.086 Y31.914 E167.24908 F1800
+G1 X68.595 Y32.511 E167.27497 F1800
+G1 X69.005 Y33.180 E167.30086 F1800
+G1 X69.305 Y33.905 E167.32676 F1800
+G1 X69.488 Y34.668 E167.35265 F1800
+G1 X69.550 Y64.550 E168.33876 F1800
+G1 X69.488 Y65.332 E168.36465 F1800
+G1 X69.305 Y66.095 E168.39054 F1800
+G1 X69.005 Y66.820 E168.41643 F1800
+G1 X68.595 Y67.489 E168.44233 F1800
+G1 X68.086 Y68.086 E168.46822 F1800
+G1 X67.489 Y68.595 E168.49411 F1800
+G1 X66.820 Y69.005 E168.52000 F1800
+G1 X66.095 Y69.305 E168.54589 F1800
+G1 X65.332 Y69.488 E168.57178 F1800
+G1 X35.450 Y69.550 E169.55790 F1800
+G1 X34.668 Y69.488 E169.58379 F1800
+G1 X33.905 Y69.305 E169.60968 F1800
+G1 X33.180 Y69.005 E169.63557 F1800
+G1 X32.511 Y68.595 E169.66146 F1800
+G1 X31.914 Y68.086 E169.68736 F1800
+G1 X31.405 Y67.489 E169.71325 F1800
+G1 X30.995 Y66.820 E169.73914 F1800
+G1 X30.695 Y66.095 E169.76503 F1800
+G1 X30.512 Y65.332 E169.79092 F1800
+G1 X30.450 Y35.450 E170.77704 F1800
+G1 X30.512 Y34.668 E170.80293 F1800
+G1 X30.695 Y33.905 E170.82882 F1800
+G1 X30.995 Y33.180 E170.85471 F1800
+G1 X31.405 Y32.511 E170.88060 F1800
+G1 X31.914 Y31.914 E170.90649 F1800
+G1 X32.511 Y31.405 E170.93238 F1800
+G1 X33.180 Y30.995 E170.95828 F1800
+G1 X33.905 Y30.695 E170.98417 F1800
+G1 X34.668 Y30.512 E171.01006 F1800
+G1 X64.550 Y30.450 E171.99617 F1800
+G1 E170.99617 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E171.99617 F3000
+G1 X31.500 Y33.500 E172.06217 F3000
+G1 X33.500 Y31.500 E172.15551 F3000
+G1 X35.500 Y31.500 E172.22151 F3000
+G1 X31.500 Y35.500 E172.40819 F3000
+G1 X31.500 Y37.500 E172.47419 F3000
+G1 X37.500 Y31.500 E172.75420 F3000
+G1 X39.500 Y31.500 E172.82020 F3000
+G1 X31.500 Y39.500 E173.19355 F3000
+G1 X31.500 Y41.500 E173.25955 F3000
+G1 X41.500 Y31.500 E173.72624 F3000
+G1 X43.500 Y31.500 E173.79224 F3000
+G1 X31.500 Y43.500 E174.35227 F3000
+G1 X31.500 Y45.500 E174.41827 F3000
+G1 X45.500 Y31.500 E175.07164 F3000
+G1 X47.500 Y31.500 E175.13764 F3000
+G1 X31.500 Y47.500 E175.88434 F3000
+G1 X31.500 Y49.500 E175.95034 F3000
+G1 X49.500 Y31.500 E176.79039 F3000
+G1 X51.500 Y31.500 E176.85639 F3000
+G1 X31.500 Y51.500 E177.78977 F3000
+G1 X31.500 Y53.500 E177.85577 F3000
+G1 X53.500 Y31.500 E178.88249 F3000
+G1 X55.500 Y31.500 E178.94849 F3000
+G1 X31.500 Y55.500 E180.06854 F3000
+G1 X31.500 Y57.500 E180.13454 F3000
+G1 X57.500 Y31.500 E181.34794 F3000
+G1 X59.500 Y31.500 E181.41394 F3000
+G1 X31.500 Y59.500 E182.72067 F3000
+G1 X31.500 Y61.500 E182.78667 F3000
+G1 X61.500 Y31.500 E184.18674 F3000
+G1 X63.500 Y31.500 E184.25274 F3000
+G1 X31.500 Y63.500 E185.74615 F3000
+G1 X31.500 Y65.500 E185.81215 F3000
+G1 X65.500 Y31.500 E187.39890 F3000
+G1 X67.500 Y31.500 E187.46490 F3000
+G1 X31.500 Y67.500 E189.14499 F3000
+G1 E188.14499 F2400
+G0 Z1.60 F3000
+G1 E189.14499 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E189.17088 F1800
+G1 X66.545 Y30.245 E189.19677 F1800
+G1 X67.270 Y30.545 E189.22266 F1800
+G1 X67.939 Y30.955 E189.24855 F1800
+G1 X68.536 Y31.464 E189.27444 F1800
+G1 X69.045 Y32.061 E189.30034 F1800
+G1 X69.455 Y32.730 E189.32623 F1800
+G1 X69.755 Y33.455 E189.35212 F1800
+G1 X69.938 Y34.218 E189.37801 F1800
+G1 X70.000 Y65.000 E190.39382 F1800
+G1 X69.938 Y65.782 E190.41972 F1800
+G1 X69.755 Y66.545 E190.44561 F1800
+G1 X69.455 Y67.270 E190.47150 F1800
+G1 X69.045 Y67.939 E190.49739 F1800
+G1 X68.536 Y68.536 E190.52328 F1800
+G1 X67.939 Y69.045 E190.54917 F1800
+G1 X67.270 Y69.455 E190.57506 F1800
+G1 X66.545 Y69.755 E190.60096 F1800
+G1 X65.782 Y69.938 E190.62685 F1800
+G1 X35.000 Y70.000 E191.64266 F1800
+G1 X34.218 Y69.938 E191.66855 F1800
+G1 X33.455 Y69.755 E191.69444 F1800
+G1 X32.730 Y69.455 E191.72034 F1800
+G1 X32.061 Y69.045 E191.74623 F1800
+G1 X31.464 Y68.536 E191.77212 F1800
+G1 X30.955 Y67.939 E191.79801 F1800
+G1 X30.545 Y67.270 E191.82390 F1800
+G1 X30.245 Y66.545 E191.84979 F1800
+G1 X30.062 Y65.782 E191.87568 F1800
+G1 X30.000 Y35.000 E192.89150 F1800
+G1 X30.062 Y34.218 E192.91739 F1800
+G1 X30.245 Y33.455 E192.94328 F1800
+G1 X30.545 Y32.730 E192.96917 F1800
+G1 X30.955 Y32.061 E192.99506 F1800
+G1 X31.464 Y31.464 E193.02096 F1800
+G1 X32.061 Y30.955 E193.04685 F1800
+G1 X32.730 Y30.545 E193.07274 F1800
+G1 X33.455 Y30.245 E193.09863 F1800
+G1 X34.218 Y30.062 E193.12452 F1800
+G1 X65.000 Y30.000 E194.14034 F1800
+G1 E193.14034 F2400
+G1 E194.14034 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E194.16623 F1800
+G1 X66.095 Y30.695 E194.19212 F1800
+G1 X66.820 Y30.995 E194.21801 F1800
+G1 X67.489 Y31.405 E194.24390 F1800
+G1 X68.086 Y31.914 E194.26979 F1800
+G1 X68.595 Y32.511 E194.29568 F1800
+G1 X69.005 Y33.180 E194.32158 F1800
+G1 X69.305 Y33.905 E194.34747 F1800
+G1 X69.488 Y34.668 E194.37336 F1800
+G1 X69.550 Y64.550 E195.35947 F1800
+G1 X69.488 Y65.332 E195.38536 F1800
+G1 X69.305 Y66.095 E195.41126 F1800
+G1 X69.005 Y66.820 E195.43715 F1800
+G1 X68.595 Y67.489 E195.46304 F1800
+G1 X68.086 Y68.086 E195.48893 F1800
+G1 X67.489 Y68.595 E195.51482 F1800
+G1 X66.820 Y69.005 E195.54071 F1800
+G1 X66.095 Y69.305 E195.56660 F1800
+G1 X65.332 Y69.488 E195.59250 F1800
+G1 X35.450 Y69.550 E196.57861 F1800
+G1 X34.668 Y69.488 E196.60450 F1800
+G1 X33.905 Y69.305 E196.63039 F1800
+G1 X33.180 Y69.005 E196.65628 F1800
+G1 X32.511 Y68.595 E196.68218 F1800
+G1 X31.914 Y68.086 E196.70807 F1800
+G1 X31.405 Y67.489 E196.73396 F1800
+G1 X30.995 Y66.820 E196.75985 F1800
+G1 X30.695 Y66.095 E196.78574 F1800
+G1 X30.512 Y65.332 E196.81163 F1800
+G1 X30.450 Y35.450 E197.79775 F1800
+G1 X30.512 Y34.668 E197.82364 F1800
+G1 X30.695 Y33.905 E197.84953 F1800
+G1 X30.995 Y33.180 E197.87542 F1800
+G1 X31.405 Y32.511 E197.90131 F1800
+G1 X31.914 Y31.914 E197.92720 F1800
+G1 X32.511 Y31.405 E197.95310 F1800
+G1 X33.180 Y30.995 E197.97899 F1800
+G1 X33.905 Y30.695 E198.00488 F1800
+G1 X34.668 Y30.512 E198.03077 F1800
+G1 X64.550 Y30.450 E199.01688 F1800
+G1 E198.01688 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E199.01688 F3000
+G1 X33.500 Y31.500 E199.08288 F3000
+G1 X31.500 Y33.500 E199.17622 F3000
+G1 X31.500 Y35.500 E199.24222 F3000
+G1 X35.500 Y31.500 E199.42890 F3000
+G1 X37.500 Y31.500 E199.49490 F3000
+G1 X31.500 Y37.500 E199.77491 F3000
+G1 X31.500 Y39.500 E199.84091 F3000
+G1 X39.500 Y31.500 E200.21427 F3000
+G1 X41.500 Y31.500 E200.28027 F3000
+G1 X31.500 Y41.500 E200.74696 F3000
+G1 X31.500 Y43.500 E200.81296 F3000
+G1 X43.500 Y31.500 E201.37298 F3000
+G1 X45.500 Y31.500 E201.43898 F3000
+G1 X31.500 Y45.500 E202.09235 F3000
+G1 X31.500 Y47.500 E202.15835 F3000
+G1 X47.500 Y31.500 E202.90506 F3000
+G1 X49.500 Y31.500 E202.97106 F3000
+G1 X31.500 Y49.500 E203.81110 F3000
+G1 X31.500 Y51.500 E203.87710 F3000
+G1 X51.500 Y31.500 E204.81048 F3000
+G1 X53.500 Y31.500 E204.87648 F3000
+G1 X31.500 Y53.500 E205.90320 F3000
+G1 X31.500 Y55.500 E205.96920 F3000
+G1 X55.500 Y31.500 E207.08926 F3000
+G1 X57.500 Y31.500 E207.15526 F3000
+G1 X31.500 Y57.500 E208.36865 F3000
+G1 X31.500 Y59.500 E208.43465 F3000
+G1 X59.500 Y31.500 E209.74138 F3000
+G1 X61.500 Y31.500 E209.80738 F3000
+G1 X31.500 Y61.500 E211.20746 F3000
+G1 X31.500 Y63.500 E211.27346 F3000
+G1 X63.500 Y31.500 E212.76687 F3000
+G1 X65.500 Y31.500 E212.83287 F3000
+G1 X31.500 Y65.500 E214.41961 F3000
+G1 X31.500 Y67.500 E214.48561 F3000
+G1 X67.500 Y31.500 E216.16570 F3000
+G1 E215.16570 F2400
+G0 Z1.80 F3000
+G1 E216.16570 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E216.19159 F1800
+G1 X66.545 Y30.245 E216.21748 F1800
+G1 X67.270 Y30.545 E216.24337 F1800
+G1 X67.939 Y30.955 E216.26926 F1800
+G1 X68.536 Y31.464 E216.29516 F1800
+G1 X69.045 Y32.061 E216.32105 F1800
+G1 X69.455 Y32.730 E216.34694 F1800
+G1 X69.755 Y33.455 E216.37283 F1800
+G1 X69.938 Y34.218 E216.39872 F1800
+G1 X70.000 Y65.000 E217.41454 F1800
+G1 X69.938 Y65.782 E217.44043 F1800
+G1 X69.755 Y66.545 E217.46632 F1800
+G1 X69.455 Y67.270 E217.49221 F1800
+G1 X69.045 Y67.939 E217.51810 F1800
+G1 X68.536 Y68.536 E217.54399 F1800
+G1 X67.939 Y69.045 E217.56989 F1800
+G1 X67.270 Y69.455 E217.59578 F1800
+G1 X66.545 Y69.755 E217.62167 F1800
+G1 X65.782 Y69.938 E217.64756 F1800
+G1 X35.000 Y70.000 E218.66337 F1800
+G1 X34.218 Y69.938 E218.68926 F1800
+G1 X33.455 Y69.755 E218.71516 F1800
+G1 X32.730 Y69.455 E218.74105 F1800
+G1 X32.061 Y69.045 E218.76694 F1800
+G1 X31.464 Y68.536 E218.79283 F1800
+G1 X30.955 Y67.939 E218.81872 F1800
+G1 X30.545 Y67.270 E218.84461 F1800
+G1 X30.245 Y66.545 E218.87051 F1800
+G1 X30.062 Y65.782 E218.89640 F1800
+G1 X30.000 Y35.000 E219.91221 F1800
+G1 X30.062 Y34.218 E219.93810 F1800
+G1 X30.245 Y33.455 E219.96399 F1800
+G1 X30.545 Y32.730 E219.98989 F1800
+G1 X30.955 Y32.061 E220.01578 F1800
+G1 X31.464 Y31.464 E220.04167 F1800
+G1 X32.061 Y30.955 E220.06756 F1800
+G1 X32.730 Y30.545 E220.09345 F1800
+G1 X33.455 Y30.245 E220.11934 F1800
+G1 X34.218 Y30.062 E220.14523 F1800
+G1 X65.000 Y30.000 E221.16105 F1800
+G1 E220.16105 F2400
+G1 E221.16105 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E221.18694 F1800
+G1 X66.095 Y30.695 E221.21283 F1800
+G1 X66.820 Y30.995 E221.23872 F1800
+G1 X67.489 Y31.405 E221.26461 F1800
+G1 X68.086 Y31.914 E221.29051 F1800
+G1 X68.595 Y32.511 E221.31640 F1800
+G1 X69.005 Y33.180 E221.34229 F1800
+G1 X69.305 Y33.905 E221.36818 F1800
+G1 X69.488 Y34.668 E221.39407 F1800
+G1 X69.550 Y64.550 E222.38019 F1800
+G1 X69.488 Y65.332 E222.40608 F1800
+G1 X69.305 Y66.095 E222.43197 F1800
+G1 X69.005 Y66.820 E222.45786 F1800
+G1 X68.595 Y67.489 E222.48375 F1800
+G1 X68.086 Y68.086 E222.50964 F1800
+G1 X67.489 Y68.595 E222.53553 F1800
+G1 X66.820 Y69.005 E222.56143 F1800
+G1 X66.095 Y69.305 E222.58732 F1800
+G1 X65.332 Y69.488 E222.61321 F1800
+G1 X35.450 Y69.550 E223.59932 F1800
+G1 X34.668 Y69.488 E223.62521 F1800
+G1 X33.905 Y69.305 E223.65111 F1800
+G1 X33.180 Y69.005 E223.67700 F1800
+G1 X32.511 Y68.595 E223.70289 F1800
+G1 X31.914 Y68.086 E223.72878 F1800
+G1 X31.405 Y67.489 E223.75467 F1800
+G1 X30.995 Y66.820 E223.78056 F1800
+G1 X30.695 Y66.095 E223.80645 F1800
+G1 X30.512 Y65.332 E223.83235 F1800
+G1 X30.450 Y35.450 E224.81846 F1800
+G1 X30.512 Y34.668 E224.84435 F1800
+G1 X30.695 Y33.905 E224.87024 F1800
+G1 X30.995 Y33.180 E224.89613 F1800
+G1 X31.405 Y32.511 E224.92203 F1800
+G1 X31.914 Y31.914 E224.94792 F1800
+G1 X32.511 Y31.405 E224.97381 F1800
+G1 X33.180 Y30.995 E224.99970 F1800
+G1 X33.905 Y30.695 E225.02559 F1800
+G1 X34.668 Y30.512 E225.05148 F1800
+G1 X64.550 Y30.450 E226.03760 F1800
+G1 E225.03760 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E226.03760 F3000
+G1 X31.500 Y33.500 E226.10360 F3000
+G1 X33.500 Y31.500 E226.19694 F3000
+G1 X35.500 Y31.500 E226.26294 F3000
+G1 X31.500 Y35.500 E226.44961 F3000
+G1 X31.500 Y37.500 E226.51561 F3000
+G1 X37.500 Y31.500 E226.79563 F3000
+G1 X39.500 Y31.500 E226.86163 F3000
+G1 X31.500 Y39.500 E227.23498 F3000
+G1 X31.500 Y41.500 E227.30098 F3000
+G1 X41.500 Y31.500 E227.76767 F3000
+G1 X43.500 Y31.500 E227.83367 F3000
+G1 X31.500 Y43.500 E228.39370 F3000
+G1 X31.500 Y45.500 E228.45970 F3000
+G1 X45.500 Y31.500 E229.11306 F3000
+G1 X47.500 Y31.500 E229.17906 F3000
+G1 X31.500 Y47.500 E229.92577 F3000
+G1 X31.500 Y49.500 E229.99177 F3000
+G1 X49.500 Y31.500 E230.83181 F3000
+G1 X51.500 Y31.500 E230.89781 F3000
+G1 X31.500 Y51.500 E231.83119 F3000
+G1 X31.500 Y53.500 E231.89719 F3000
+G1 X53.500 Y31.500 E232.92391 F3000
+G1 X55.500 Y31.500 E232.98991 F3000
+G1 X31.500 Y55.500 E234.10997 F3000
+G1 X31.500 Y57.500 E234.17597 F3000
+G1 X57.500 Y31.500 E235.38936 F3000
+G1 X59.500 Y31.500 E235.45536 F3000
+G1 X31.500 Y59.500 E236.76210 F3000
+G1 X31.500 Y61.500 E236.82810 F3000
+G1 X61.500 Y31.500 E238.22817 F3000
+G1 X63.500 Y31.500 E238.29417 F3000
+G1 X31.500 Y63.500 E239.78758 F3000
+G1 X31.500 Y65.500 E239.85358 F3000
+G1 X65.500 Y31.500 E241.44033 F3000
+G1 X67.500 Y31.500 E241.50633 F3000
+G1 X31.500 Y67.500 E243.18641 F3000
+G1 E242.18641 F2400
+G0 Z2.00 F3000
+G1 E243.18641 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E243.21230 F1800
+G1 X66.545 Y30.245 E243.23819 F1800
+G1 X67.270 Y30.545 E243.26409 F1800
+G1 X67.939 Y30.955 E243.28998 F1800
+G1 X68.536 Y31.464 E243.31587 F1800
+G1 X69.045 Y32.061 E243.34176 F1800
+G1 X69.455 Y32.730 E243.36765 F1800
+G1 X69.755 Y33.455 E243.39354 F1800
+G1 X69.938 Y34.218 E243.41943 F1800
+G1 X70.000 Y65.000 E244.43525 F1800
+G1 X69.938 Y65.782 E244.46114 F1800
+G1 X69.755 Y66.545 E244.48703 F1800
+G1 X69.455 Y67.270 E244.51292 F1800
+G1 X69.045 Y67.939 E244.53881 F1800
+G1 X68.536 Y68.536 E244.56471 F1800
+G1 X67.939 Y69.045 E244.59060 F1800
+G1 X67.270 Y69.455 E244.61649 F1800
+G1 X66.545 Y69.755 E244.64238 F1800
+G1 X65.782 Y69.938 E244.66827 F1800
+G1 X35.000 Y70.000 E245.68409 F1800
+G1 X34.218 Y69.938 E245.70998 F1800
+G1 X33.455 Y69.755 E245.73587 F1800
+G1 X32.730 Y69.455 E245.76176 F1800
+G1 X32.061 Y69.045 E245.78765 F1800
+G1 X31.464 Y68.536 E245.81354 F1800
+G1 X30.955 Y67.939 E245.83943 F1800
+G1 X30.545 Y67.270 E245.86533 F1800
+G1 X30.245 Y66.545 E245.89122 F1800
+G1 X30.062 Y65.782 E245.91711 F1800
+G1 X30.000 Y35.000 E246.93292 F1800
+G1 X30.062 Y34.218 E246.95881 F1800
+G1 X30.245 Y33.455 E246.98471 F1800
+G1 X30.545 Y32.730 E247.01060 F1800
+G1 X30.955 Y32.061 E247.03649 F1800
+G1 X31.464 Y31.464 E247.06238 F1800
+G1 X32.061 Y30.955 E247.08827 F1800
+G1 X32.730 Y30.545 E247.11416 F1800
+G1 X33.455 Y30.245 E247.14006 F1800
+G1 X34.218 Y30.062 E247.16595 F1800
+G1 X65.000 Y30.000 E248.18176 F1800
+G1 E247.18176 F2400
+G1 E248.18176 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E248.20765 F1800
+G1 X66.095 Y30.695 E248.23354 F1800
+G1 X66.820 Y30.995 E248.25943 F1800
+G1 X67.489 Y31.405 E248.28533 F1800
+G1 X68.086 Y31.914 E248.31122 F1800
+G1 X68.595 Y32.511 E248.33711 F1800
+G1 X69.005 Y33.180 E248.36300 F1800
+G1 X69.305 Y33.905 E248.38889 F1800
+G1 X69.488 Y34.668 E248.41478 F1800
+G1 X69.550 Y64.550 E249.40090 F1800
+G1 X69.488 Y65.332 E249.42679 F1800
+G1 X69.305 Y66.095 E249.45268 F1800
+G1 X69.005 Y66.820 E249.47857 F1800
+G1 X68.595 Y67.489 E249.50446 F1800
+G1 X68.086 Y68.086 E249.53036 F1800
+G1 X67.489 Y68.595 E249.55625 F1800
+G1 X66.820 Y69.005 E249.58214 F1800
+G1 X66.095 Y69.305 E249.60803 F1800
+G1 X65.332 Y69.488 E249.63392 F1800
+G1 X35.450 Y69.550 E250.62003 F1800
+G1 X34.668 Y69.488 E250.64593 F1800
+G1 X33.905 Y69.305 E250.67182 F1800
+G1 X33.180 Y69.005 E250.69771 F1800
+G1 X32.511 Y68.595 E250.72360 F1800
+G1 X31.914 Y68.086 E250.74949 F1800
+G1 X31.405 Y67.489 E250.77538 F1800
+G1 X30.995 Y66.820 E250.80128 F1800
+G1 X30.695 Y66.095 E250.82717 F1800
+G1 X30.512 Y65.332 E250.85306 F1800
+G1 X30.450 Y35.450 E251.83917 F1800
+G1 X30.512 Y34.668 E251.86506 F1800
+G1 X30.695 Y33.905 E251.89096 F1800
+G1 X30.995 Y33.180 E251.91685 F1800
+G1 X31.405 Y32.511 E251.94274 F1800
+G1 X31.914 Y31.914 E251.96863 F1800
+G1 X32.511 Y31.405 E251.99452 F1800
+G1 X33.180 Y30.995 E252.02041 F1800
+G1 X33.905 Y30.695 E252.04630 F1800
+G1 X34.668 Y30.512 E252.07220 F1800
+G1 X64.550 Y30.450 E253.05831 F1800
+G1 E252.05831 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E253.05831 F3000
+G1 X33.500 Y31.500 E253.12431 F3000
+G1 X31.500 Y33.500 E253.21765 F3000
+G1 X31.500 Y35.500 E253.28365 F3000
+G1 X35.500 Y31.500 E253.47032 F3000
+G1 X37.500 Y31.500 E253.53632 F3000
+G1 X31.500 Y37.500 E253.81634 F3000
+G1 X31.500 Y39.500 E253.88234 F3000
+G1 X39.500 Y31.500 E254.25569 F3000
+G1 X41.500 Y31.500 E254.32169 F3000
+G1 X31.500 Y41.500 E254.78838 F3000
+G1 X31.500 Y43.500 E254.85438 F3000
+G1 X43.500 Y31.500 E255.41441 F3000
+G1 X45.500 Y31.500 E255.48041 F3000
+G1 X31.500 Y45.500 E256.13378 F3000
+G1 X31.500 Y47.500 E256.19978 F3000
+G1 X47.500 Y31.500 E256.94648 F3000
+G1 X49.500 Y31.500 E257.01248 F3000
+G1 X31.500 Y49.500 E257.85252 F3000
+G1 X31.500 Y51.500 E257.91852 F3000
+G1 X51.500 Y31.500 E258.85190 F3000
+G1 X53.500 Y31.500 E258.91790 F3000
+G1 X31.500 Y53.500 E259.94462 F3000
+G1 X31.500 Y55.500 E260.01062 F3000
+G1 X55.500 Y31.500 E261.13068 F3000
+G1 X57.500 Y31.500 E261.19668 F3000
+G1 X31.500 Y57.500 E262.41008 F3000
+G1 X31.500 Y59.500 E262.47608 F3000
+G1 X59.500 Y31.500 E263.78281 F3000
+G1 X61.500 Y31.500 E263.84881 F3000
+G1 X31.500 Y61.500 E265.24888 F3000
+G1 X31.500 Y63.500 E265.31488 F3000
+G1 X63.500 Y31.500 E266.80829 F3000
+G1 X65.500 Y31.500 E266.87429 F3000
+G1 X31.500 Y65.500 E268.46104 F3000
+G1 X31.500 Y67.500 E268.52704 F3000
+G1 X67.500 Y31.500 E270.20712 F3000
+G1 E269.20712 F2400
+G0 Z2.20 F3000
+G1 E270.20712 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E270.23302 F1800
+G1 X66.545 Y30.245 E270.25891 F1800
+G1 X67.270 Y30.545 E270.28480 F1800
+G1 X67.939 Y30.955 E270.31069 F1800
+G1 X68.536 Y31.464 E270.33658 F1800
+G1 X69.045 Y32.061 E270.36247 F1800
+G1 X69.455 Y32.730 E270.38836 F1800
+G1 X69.755 Y33.455 E270.41426 F1800
+G1 X69.938 Y34.218 E270.44015 F1800
+G1 X70.000 Y65.000 E271.45596 F1800
+G1 X69.938 Y65.782 E271.48185 F1800
+G1 X69.755 Y66.545 E271.50774 F1800
+G1 X69.455 Y67.270 E271.53364 F1800
+G1 X69.045 Y67.939 E271.55953 F1800
+G1 X68.536 Y68.536 E271.58542 F1800
+G1 X67.939 Y69.045 E271.61131 F1800
+G1 X67.270 Y69.455 E271.63720 F1800
+G1 X66.545 Y69.755 E271.66309 F1800
+G1 X65.782 Y69.938 E271.68898 F1800
+G1 X35.000 Y70.000 E272.70480 F1800
+G1 X34.218 Y69.938 E272.73069 F1800
+G1 X33.455 Y69.755 E272.75658 F1800
+G1 X32.730 Y69.455 E272.78247 F1800
+G1 X32.061 Y69.045 E272.80836 F1800
+G1 X31.464 Y68.536 E272.83426 F1800
+G1 X30.955 Y67.939 E272.86015 F1800
+G1 X30.545 Y67.270 E272.88604 F1800
+G1 X30.245 Y66.545 E272.91193 F1800
+G1 X30.062 Y65.782 E272.93782 F1800
+G1 X30.000 Y35.000 E273.95364 F1800
+G1 X30.062 Y34.218 E273.97953 F1800
+G1 X30.245 Y33.455 E274.00542 F1800
+G1 X30.545 Y32.730 E274.03131 F1800
+G1 X30.955 Y32.061 E274.05720 F1800
+G1 X31.464 Y31.464 E274.08309 F1800
+G1 X32.061 Y30.955 E274.10898 F1800
+G1 X32.730 Y30.545 E274.13488 F1800
+G1 X33.455 Y30.245 E274.16077 F1800
+G1 X34.218 Y30.062 E274.18666 F1800
+G1 X65.000 Y30.000 E275.20247 F1800
+G1 E274.20247 F2400
+G1 E275.20247 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E275.22836 F1800
+G1 X66.095 Y30.695 E275.25426 F1800
+G1 X66.820 Y30.995 E275.28015 F1800
+G1 X67.489 Y31.405 E275.30604 F1800
+G1 X68.086 Y31.914 E275.33193 F1800
+G1 X68.595 Y32.511 E275.35782 F1800
+G1 X69.005 Y33.180 E275.38371 F1800
+G1 X69.305 Y33.905 E275.40960 F1800
+G1 X69.488 Y34.668 E275.43550 F1800
+G1 X69.550 Y64.550 E276.42161 F1800
+G1 X69.488 Y65.332 E276.44750 F1800
+G1 X69.305 Y66.095 E276.47339 F1800
+G1 X69.005 Y66.820 E276.49928 F1800
+G1 X68.595 Y67.489 E276.52518 F1800
+G1 X68.086 Y68.086 E276.55107 F1800
+G1 X67.489 Y68.595 E276.57696 F1800
+G1 X66.820 Y69.005 E276.60285 F1800
+G1 X66.095 Y69.305 E276.62874 F1800
+G1 X65.332 Y69.488 E276.65463 F1800
+G1 X35.450 Y69.550 E277.64075 F1800
+G1 X34.668 Y69.488 E277.66664 F1800
+G1 X33.905 Y69.305 E277.69253 F1800
+G1 X33.180 Y69.005 E277.71842 F1800
+G1 X32.511 Y68.595 E277.74431 F1800
+G1 X31.914 Y68.086 E277.77020 F1800
+G1 X31.405 Y67.489 E277.79610 F1800
+G1 X30.995 Y66.820 E277.82199 F1800
+G1 X30.695 Y66.095 E277.84788 F1800
+G1 X30.512 Y65.332 E277.87377 F1800
+G1 X30.450 Y35.450 E278.85988 F1800
+G1 X30.512 Y34.668 E278.88578 F1800
+G1 X30.695 Y33.905 E278.91167 F1800
+G1 X30.995 Y33.180 E278.93756 F1800
+G1 X31.405 Y32.511 E278.96345 F1800
+G1 X31.914 Y31.914 E278.98934 F1800
+G1 X32.511 Y31.405 E279.01523 F1800
+G1 X33.180 Y30.995 E279.04112 F1800
+G1 X33.905 Y30.695 E279.06702 F1800
+G1 X34.668 Y30.512 E279.09291 F1800
+G1 X64.550 Y30.450 E280.07902 F1800
+G1 E279.07902 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E280.07902 F3000
+G1 X31.500 Y33.500 E280.14502 F3000
+G1 X33.500 Y31.500 E280.23836 F3000
+G1 X35.500 Y31.500 E280.30436 F3000
+G1 X31.500 Y35.500 E280.49104 F3000
+G1 X31.500 Y37.500 E280.55704 F3000
+G1 X37.500 Y31.500 E280.83705 F3000
+G1 X39.500 Y31.500 E280.90305 F3000
+G1 X31.500 Y39.500 E281.27640 F3000
+G1 X31.500 Y41.500 E281.34240 F3000
+G1 X41.500 Y31.500 E281.80909 F3000
+G1 X43.500 Y31.500 E281.87509 F3000
+G1 X31.500 Y43.500 E282.43512 F3000
+G1 X31.500 Y45.500 E282.50112 F3000
+G1 X45.500 Y31.500 E283.15449 F3000
+G1 X47.500 Y31.500 E283.22049 F3000
+G1 X31.500 Y47.500 E283.96719 F3000
+G1 X31.500 Y49.500 E284.03319 F3000
+G1 X49.500 Y31.500 E284.87324 F3000
+G1 X51.500 Y31.500 E284.93924 F3000
+G1 X31.500 Y51.500 E285.87262 F3000
+G1 X31.500 Y53.500 E285.93862 F3000
+G1 X53.500 Y31.500 E286.96534 F3000
+G1 X55.500 Y31.500 E287.03134 F3000
+G1 X31.500 Y55.500 E288.15139 F3000
+G1 X31.500 Y57.500 E288.21739 F3000
+G1 X57.500 Y31.500 E289.43079 F3000
+G1 X59.500 Y31.500 E289.49679 F3000
+G1 X31.500 Y59.500 E290.80352 F3000
+G1 X31.500 Y61.500 E290.86952 F3000
+G1 X61.500 Y31.500 E292.26959 F3000
+G1 X63.500 Y31.500 E292.33559 F3000
+G1 X31.500 Y63.500 E293.82900 F3000
+G1 X31.500 Y65.500 E293.89500 F3000
+G1 X65.500 Y31.500 E295.48175 F3000
+G1 X67.500 Y31.500 E295.54775 F3000
+G1 X31.500 Y67.500 E297.22784 F3000
+G1 E296.22784 F2400
+G0 Z2.40 F3000
+G1 E297.22784 F2400
+G0 X65.000 Y30.000 F9000
+G1 X65.782 Y30.062 E297.25373 F1800
+G1 X66.545 Y30.245 E297.27962 F1800
+G1 X67.270 Y30.545 E297.30551 F1800
+G1 X67.939 Y30.955 E297.33140 F1800
+G1 X68.536 Y31.464 E297.35729 F1800
+G1 X69.045 Y32.061 E297.38319 F1800
+G1 X69.455 Y32.730 E297.40908 F1800
+G1 X69.755 Y33.455 E297.43497 F1800
+G1 X69.938 Y34.218 E297.46086 F1800
+G1 X70.000 Y65.000 E298.47667 F1800
+G1 X69.938 Y65.782 E298.50256 F1800
+G1 X69.755 Y66.545 E298.52846 F1800
+G1 X69.455 Y67.270 E298.55435 F1800
+G1 X69.045 Y67.939 E298.58024 F1800
+G1 X68.536 Y68.536 E298.60613 F1800
+G1 X67.939 Y69.045 E298.63202 F1800
+G1 X67.270 Y69.455 E298.65791 F1800
+G1 X66.545 Y69.755 E298.68381 F1800
+G1 X65.782 Y69.938 E298.70970 F1800
+G1 X35.000 Y70.000 E299.72551 F1800
+G1 X34.218 Y69.938 E299.75140 F1800
+G1 X33.455 Y69.755 E299.77729 F1800
+G1 X32.730 Y69.455 E299.80319 F1800
+G1 X32.061 Y69.045 E299.82908 F1800
+G1 X31.464 Y68.536 E299.85497 F1800
+G1 X30.955 Y67.939 E299.88086 F1800
+G1 X30.545 Y67.270 E299.90675 F1800
+G1 X30.245 Y66.545 E299.93264 F1800
+G1 X30.062 Y65.782 E299.95853 F1800
+G1 X30.000 Y35.000 E300.97435 F1800
+G1 X30.062 Y34.218 E301.00024 F1800
+G1 X30.245 Y33.455 E301.02613 F1800
+G1 X30.545 Y32.730 E301.05202 F1800
+G1 X30.955 Y32.061 E301.07791 F1800
+G1 X31.464 Y31.464 E301.10381 F1800
+G1 X32.061 Y30.955 E301.12970 F1800
+G1 X32.730 Y30.545 E301.15559 F1800
+G1 X33.455 Y30.245 E301.18148 F1800
+G1 X34.218 Y30.062 E301.20737 F1800
+G1 X65.000 Y30.000 E302.22318 F1800
+G1 E301.22318 F2400
+G1 E302.22318 F2400
+G0 X64.550 Y30.450 F9000
+G1 X65.332 Y30.512 E302.24908 F1800
+G1 X66.095 Y30.695 E302.27497 F1800
+G1 X66.820 Y30.995 E302.30086 F1800
+G1 X67.489 Y31.405 E302.32675 F1800
+G1 X68.086 Y31.914 E302.35264 F1800
+G1 X68.595 Y32.511 E302.37853 F1800
+G1 X69.005 Y33.180 E302.40443 F1800
+G1 X69.305 Y33.905 E302.43032 F1800
+G1 X69.488 Y34.668 E302.45621 F1800
+G1 X69.550 Y64.550 E303.44232 F1800
+G1 X69.488 Y65.332 E303.46821 F1800
+G1 X69.305 Y66.095 E303.49411 F1800
+G1 X69.005 Y66.820 E303.52000 F1800
+G1 X68.595 Y67.489 E303.54589 F1800
+G1 X68.086 Y68.086 E303.57178 F1800
+G1 X67.489 Y68.595 E303.59767 F1800
+G1 X66.820 Y69.005 E303.62356 F1800
+G1 X66.095 Y69.305 E303.64945 F1800
+G1 X65.332 Y69.488 E303.67535 F1800
+G1 X35.450 Y69.550 E304.66146 F1800
+G1 X34.668 Y69.488 E304.68735 F1800
+G1 X33.905 Y69.305 E304.71324 F1800
+G1 X33.180 Y69.005 E304.73913 F1800
+G1 X32.511 Y68.595 E304.76503 F1800
+G1 X31.914 Y68.086 E304.79092 F1800
+G1 X31.405 Y67.489 E304.81681 F1800
+G1 X30.995 Y66.820 E304.84270 F1800
+G1 X30.695 Y66.095 E304.86859 F1800
+G1 X30.512 Y65.332 E304.89448 F1800
+G1 X30.450 Y35.450 E305.88060 F1800
+G1 X30.512 Y34.668 E305.90649 F1800
+G1 X30.695 Y33.905 E305.93238 F1800
+G1 X30.995 Y33.180 E305.95827 F1800
+G1 X31.405 Y32.511 E305.98416 F1800
+G1 X31.914 Y31.914 E306.01005 F1800
+G1 X32.511 Y31.405 E306.03595 F1800
+G1 X33.180 Y30.995 E306.06184 F1800
+G1 X33.905 Y30.695 E306.08773 F1800
+G1 X34.668 Y30.512 E306.11362 F1800
+G1 X64.550 Y30.450 E307.09973 F1800
+G1 E306.09973 F2400
+G0 X31.500 Y31.500 F9000
+G1 X31.500 Y31.500 E307.09973 F3000
+G1 X33.500 Y31.500 E307.16573 F3000
+G1 X31.500 Y33.500 E307.25907 F3000
+G1 X31.500 Y35.500 E307.32507 F3000
+G1 X35.500 Y31.500 E307.51175 F3000
+G1 X37.500 Y31.500 E307.57775 F3000
+G1 X31.500 Y37.500 E307.85776 F3000
+G1 X31.500 Y39.500 E307.92376 F3000
+G1 X39.500 Y31.500 E308.29712 F3000
+G1 X41.500 Y31.500 E308.36312 F3000
+G1 X31.500 Y41.500 E308.82981 F3000
+G1 X31.500 Y43.500 E308.89581 F3000
+G1 X43.500 Y31.500 E309.45583 F3000
+G1 X45.500 Y31.500 E309.52183 F3000
+G1 X31.500 Y45.500 E310.17520 F3000
+G1 X31.500 Y47.500 E310.24120 F3000
+G1 X47.500 Y31.500 E310.98791 F3000
+G1 X49.500 Y31.500 E311.05391 F3000
+G1 X31.500 Y49.500 E311.89395 F3000
+G1 X31.500 Y51.500 E311.95995 F3000
+G1 X51.500 Y31.500 E312.89333 F3000
+G1 X53.500 Y31.500 E312.95933 F3000
+G1 X31.500 Y53.500 E313.98605 F3000
+G1 X31.500 Y55.500 E314.05205 F3000
+G1 X55.500 Y31.500 E315.17211 F3000
+G1 X57.500 Y31.500 E315.23811 F3000
+G1 X31.500 Y57.500 E316.45150 F3000
+G1 X31.500 Y59.500 E316.51750 F3000
+G1 X59.500 Y31.500 E317.82423 F3000
+G1 X61.500 Y31.500 E317.89023 F3000
+G1 X31.500 Y61.500 E319.29031 F3000
+G1 X31.500 Y63.500 E319.35631 F3000
+G1 X63.500 Y31.500 E320.84972 F3000
+G1 X65.500 Y31.500 E320.91572 F3000
+G1 X31.500 Y65.500 E322.50246 F3000
+G1 X31.500 Y67.500 E322.56846 F3000
+G1 X67.500 Y31.500 E324.24855 F3000
+G1 E323.24855 F2400
+G0 Z10 F3000
+G0 X0 Y0 F9000
+M84
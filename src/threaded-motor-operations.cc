@@ -0,0 +1,196 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2015 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "threaded-motor-operations.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include "common/logging.h"
+
+// Semaphore wait that is not disturbed by signals arriving.
+static void sem_wait_retry(sem_t *sem) {
+  while (sem_wait(sem) != 0 && errno == EINTR)
+    ;
+}
+
+ThreadedMotorOperations::ThreadedMotorOperations(MotorOperations *delegate,
+                                                 int realtime_priority)
+  : delegate_(delegate) {
+  sem_init(&filled_slots_, 0, 0);
+  sem_init(&free_slots_, 0, RING_SIZE - 1);
+  sem_init(&done_, 0, 0);
+  UpdateSnapshot();  // No thread yet; no lock needed.
+  thread_ = std::thread(&ThreadedMotorOperations::Run, this,
+                        realtime_priority);
+}
+
+ThreadedMotorOperations::~ThreadedMotorOperations() {
+  NextSlot()->type = Command::EXIT;
+  Submit(false);
+  thread_.join();
+  sem_destroy(&done_);
+  sem_destroy(&free_slots_);
+  sem_destroy(&filled_slots_);
+}
+
+ThreadedMotorOperations::Command *ThreadedMotorOperations::NextSlot() {
+  sem_wait_retry(&free_slots_);
+  Command *cmd = ring_.write_slot();
+  assert(cmd != NULL);   // Semaphore guarantees a free slot.
+  return cmd;
+}
+
+void ThreadedMotorOperations::Submit(bool wait_done) {
+  ring_.commit_write();
+  sem_post(&filled_slots_);
+  if (wait_done) sem_wait_retry(&done_);
+}
+
+void ThreadedMotorOperations::Enqueue(const LinearSegmentSteps &segment) {
+  Command *cmd = NextSlot();
+  cmd->type = Command::ENQUEUE;
+  cmd->segment = segment;
+  Submit(false);
+}
+
+void ThreadedMotorOperations::MotorEnable(bool on) {
+  Command *cmd = NextSlot();
+  cmd->type = Command::MOTOR_ENABLE;
+  cmd->value = on;
+  Submit(true);
+}
+
+void ThreadedMotorOperations::WaitQueueEmpty() {
+  NextSlot()->type = Command::WAIT_QUEUE_EMPTY;
+  Submit(true);
+}
+
+void ThreadedMotorOperations::SetExternalPosition(int axis, int pos) {
+  Command *cmd = NextSlot();
+  cmd->type = Command::SET_POSITION;
+  cmd->axis = axis;
+  cmd->value = pos;
+  Submit(false);
+}
+
+void ThreadedMotorOperations::UpdateSnapshot() {
+  PhysicalStatus status = {};
+  MotionQueueStats stats = {};
+  const bool have_status = delegate_->GetPhysicalStatus(&status);
+  const bool have_stats = delegate_->GetQueueStats(&stats);
+  std::lock_guard<std::mutex> l(snapshot_mutex_);
+  have_status_ = have_status;
+  status_ = status;
+  have_stats_ = have_stats;
+  stats_ = stats;
+}
+
+bool ThreadedMotorOperations::GetPhysicalStatus(PhysicalStatus *status) {
+  // Segments still in our ring have not reached the motors yet, so the
+  // delegate knows everything about the physical status. If it is busy,
+  // possibly waiting for space in the queue, take what it said last.
+  std::unique_lock<std::mutex> l(delegate_mutex_, std::try_to_lock);
+  if (l.owns_lock()) return delegate_->GetPhysicalStatus(status);
+  std::lock_guard<std::mutex> s(snapshot_mutex_);
+  *status = status_;
+  return have_status_;
+}
+
+bool ThreadedMotorOperations::GetQueueStats(MotionQueueStats *stats) {
+  std::unique_lock<std::mutex> l(delegate_mutex_, std::try_to_lock);
+  if (l.owns_lock()) return delegate_->GetQueueStats(stats);
+  std::lock_guard<std::mutex> s(snapshot_mutex_);
+  *stats = stats_;
+  return have_stats_;
+}
+
+bool ThreadedMotorOperations::UpdateOutputs() {
+  // Don't wait while the delegate blocks on a full queue: it updates the
+  // outputs itself after each enqueue, and we are called again anyway.
+  std::unique_lock<std::mutex> l(delegate_mutex_, std::try_to_lock);
+  if (!l.owns_lock()) return true;
+  int waiting_commands = 0;
+  sem_getvalue(&filled_slots_, &waiting_commands);
+  return delegate_->UpdateOutputs() || waiting_commands > 0;
+}
+
+bool ThreadedMotorOperations::WatchInput(uint32_t gpio_def,
+                                         bool trigger_level) {
+  WaitQueueEmpty();  // Segments before it are not watched.
+  std::lock_guard<std::mutex> l(delegate_mutex_);
+  return delegate_->WatchInput(gpio_def, trigger_level);
+}
+
+bool ThreadedMotorOperations::WaitInputStop() {
+  WaitQueueEmpty();
+  std::lock_guard<std::mutex> l(delegate_mutex_);
+  return delegate_->WaitInputStop();
+}
+
+void ThreadedMotorOperations::Run(int realtime_priority) {
+  if (realtime_priority > 0) {
+    struct sched_param p;
+    p.sched_priority = realtime_priority;
+    const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &p);
+    if (err != 0) {
+      Log_info("Motion thread: can't set realtime priority %d (%s). "
+               "Continuing with normal priority.",
+               realtime_priority, strerror(err));
+    }
+  }
+
+  for (;;) {
+    sem_wait_retry(&filled_slots_);
+    const Command *cmd = ring_.read_slot();
+    assert(cmd != NULL);
+    if (cmd->type == Command::EXIT)
+      break;
+    bool is_synchronous = false;
+    {
+      std::lock_guard<std::mutex> l(delegate_mutex_);
+      switch (cmd->type) {
+      case Command::ENQUEUE:
+        delegate_->Enqueue(cmd->segment);
+        break;
+      case Command::MOTOR_ENABLE:
+        delegate_->MotorEnable(cmd->value);
+        is_synchronous = true;
+        break;
+      case Command::WAIT_QUEUE_EMPTY:
+        delegate_->WaitQueueEmpty();
+        is_synchronous = true;
+        break;
+      case Command::SET_POSITION:
+        delegate_->SetExternalPosition(cmd->axis, cmd->value);
+        break;
+      case Command::EXIT:
+        break;
+      }
+      UpdateSnapshot();
+    }
+    ring_.commit_read();
+    sem_post(&free_slots_);
+    if (is_synchronous) sem_post(&done_);
+  }
+  ring_.commit_read();
+}
@@ -0,0 +1,111 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2015 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _BEAGLEG_THREADED_MOTOR_OPERATIONS_H_
+#define _BEAGLEG_THREADED_MOTOR_OPERATIONS_H_
+
+#include <semaphore.h>
+
+#include <mutex>
+#include <thread>
+
+#include "common/spsc-ring.h"
+#include "motor-operations.h"
+
+// MotorOperations that pass all operations to a delegate which is called
+// from a separate, possibly realtime, thread. The caller (parser and planner)
+// only blocks if the pre-allocated segment ring is full, so a slow parse
+// does not directly starve the motion queue behind the delegate.
+//
+// All operations are executed in the order they are issued. MotorEnable()
+// and WaitQueueEmpty() return after the delegate has finished them.
+//
+// The ring itself is lock-free; semaphores wake up the waiting side, and a
+// mutex serializes calls to the delegate. GetPhysicalStatus() and
+// GetQueueStats() never wait for a delegate that blocks on a full queue:
+// they then return what the delegate reported after the last command.
+class ThreadedMotorOperations : public MotorOperations {
+public:
+  enum { RING_SIZE = 256 };
+
+  // Start the feeding thread for "delegate". If "realtime_priority" is > 0,
+  // attempt to run it with SCHED_FIFO at that priority; this needs
+  // privileges, so create this before dropping them.
+  ThreadedMotorOperations(MotorOperations *delegate, int realtime_priority);
+
+  // Finishes all pending operations and stops the thread.
+  ~ThreadedMotorOperations() override;
+
+  void Enqueue(const LinearSegmentSteps &segment) final;
+  void MotorEnable(bool on) final;
+  void WaitQueueEmpty() final;
+  bool GetPhysicalStatus(PhysicalStatus *status) final;
+  void SetExternalPosition(int axis, int pos) final;
+  float MaxStepFrequency(unsigned motor_mask) const final {
+    return delegate_->MaxStepFrequency(motor_mask);  // No state; thread-safe.
+  }
+  bool SupportsArcs() const final { return delegate_->SupportsArcs(); }
+  bool SupportsRaster() const final { return delegate_->SupportsRaster(); }
+  bool GetQueueStats(MotionQueueStats *stats) final;
+  bool UpdateOutputs() final;
+  bool WatchInput(uint32_t gpio_def, bool trigger_level) final;
+  bool WaitInputStop() final;
+  bool SetSpeedOverride(float factor, float ramp_seconds) final {
+    // Not through the ring: the feeding thread might be blocked on a full
+    // queue. Thread-safe by contract.
+    return delegate_->SetSpeedOverride(factor, ramp_seconds);
+  }
+
+private:
+  struct Command {
+    enum Type { ENQUEUE, MOTOR_ENABLE, WAIT_QUEUE_EMPTY,
+                SET_POSITION, EXIT } type;
+    LinearSegmentSteps segment;
+    int axis;
+    int value;
+  };
+
+  void Run(int realtime_priority);
+  void UpdateSnapshot();         // With delegate_mutex_ held.
+  Command *NextSlot();           // Blocks until a slot is free.
+  void Submit(bool wait_done);  // Publish slot, optionally wait for it.
+
+  MotorOperations *const delegate_;
+  SPSCRing<Command, RING_SIZE> ring_;
+  sem_t filled_slots_;   // Posted by producer for each new command.
+  sem_t free_slots_;     // Posted by consumer for each finished command.
+  sem_t done_;           // Posted by consumer after a synchronous command.
+
+  // Calls to the delegate happen in the feeding thread; only
+  // GetPhysicalStatus(), GetQueueStats(), UpdateOutputs() and the input
+  // watching (once the ring is drained) are called from outside, so we
+  // serialize these. Outside callers only try to get it if the feeding
+  // thread could be busy.
+  std::mutex delegate_mutex_;
+
+  // State of the delegate after the last command of the feeding thread.
+  std::mutex snapshot_mutex_;
+  bool have_status_;
+  PhysicalStatus status_;
+  bool have_stats_;
+  MotionQueueStats stats_;
+
+  std::thread thread_;
+};
+
+#endif  // _BEAGLEG_THREADED_MOTOR_OPERATIONS_H_
@@ -0,0 +1,135 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * Test for motor operations that are fed from a separate thread.
+ */
+#include "threaded-motor-operations.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "common/logging.h"
+
+// Records all calls. Enqueue is slow to simulate a motion queue that
+// is full and drains at the speed of the motors.
+class RecordingMotorOperations : public MotorOperations {
+public:
+  RecordingMotorOperations() : enabled_(false), pos_(0) {}
+
+  void Enqueue(const LinearSegmentSteps &segment) override {
+    usleep(100);
+    calling_thread_ = std::this_thread::get_id();
+    received_.push_back(segment.steps[0]);
+  }
+  void MotorEnable(bool on) override { enabled_ = on; }
+  void WaitQueueEmpty() override {}
+  bool GetPhysicalStatus(PhysicalStatus *status) override {
+    bzero(status, sizeof(*status));
+    status->pos_steps[0] = pos_;
+    return true;
+  }
+  void SetExternalPosition(int axis, int steps) override { pos_ = steps; }
+
+  std::vector<int> received_;
+  std::thread::id calling_thread_;
+  bool enabled_;
+  int pos_;
+};
+
+TEST(ThreadedMotorOperations, all_segments_arrive_in_order) {
+  RecordingMotorOperations delegate;
+  ThreadedMotorOperations motor_ops(&delegate, 0);
+
+  // More than fit into the ring, so we also see the producer wait for space.
+  const int kSegments = 2 * ThreadedMotorOperations::RING_SIZE;
+  LinearSegmentSteps segment = {};
+  for (int i = 0; i < kSegments; ++i) {
+    segment.steps[0] = i;
+    motor_ops.Enqueue(segment);
+  }
+  motor_ops.WaitQueueEmpty();
+
+  ASSERT_EQ(kSegments, (int)delegate.received_.size());
+  for (int i = 0; i < kSegments; ++i) {
+    EXPECT_EQ(i, delegate.received_[i]);
+  }
+  EXPECT_NE(std::this_thread::get_id(), delegate.calling_thread_);
+}
+
+TEST(ThreadedMotorOperations, synchronous_operations) {
+  RecordingMotorOperations delegate;
+  ThreadedMotorOperations motor_ops(&delegate, 0);
+
+  LinearSegmentSteps segment = {};
+  motor_ops.Enqueue(segment);
+  motor_ops.MotorEnable(true);
+  // MotorEnable() waits for the segment before it to reach the delegate.
+  EXPECT_EQ(1, (int)delegate.received_.size());
+  EXPECT_TRUE(delegate.enabled_);
+
+  motor_ops.SetExternalPosition(0, 42);
+  motor_ops.WaitQueueEmpty();
+  PhysicalStatus status;
+  ASSERT_TRUE(motor_ops.GetPhysicalStatus(&status));
+  EXPECT_EQ(42, status.pos_steps[0]);
+}
+
+TEST(ThreadedMotorOperations, destructor_flushes_pending) {
+  RecordingMotorOperations delegate;
+  {
+    ThreadedMotorOperations motor_ops(&delegate, 0);
+    LinearSegmentSteps segment = {};
+    for (int i = 0; i < 10; ++i) motor_ops.Enqueue(segment);
+  }
+  EXPECT_EQ(10, (int)delegate.received_.size());
+}
+
+// Enqueue blocks until released, like a full motion queue.
+class BlockingMotorOperations : public RecordingMotorOperations {
+public:
+  BlockingMotorOperations() : release_(false) {}
+  void Enqueue(const LinearSegmentSteps &segment) override {
+    while (!release_) usleep(1000);
+    RecordingMotorOperations::Enqueue(segment);
+  }
+  bool GetQueueStats(MotionQueueStats *stats) override {
+    bzero(stats, sizeof(*stats));
+    stats->segments = received_.size();
+    return true;
+  }
+  std::atomic<bool> release_;
+};
+
+TEST(ThreadedMotorOperations, status_while_delegate_blocks) {
+  BlockingMotorOperations delegate;
+  ThreadedMotorOperations motor_ops(&delegate, 0);
+  motor_ops.SetExternalPosition(0, 42);
+  motor_ops.WaitQueueEmpty();
+
+  LinearSegmentSteps segment = {};
+  motor_ops.Enqueue(segment);
+  usleep(10000);  // Feeding thread now waits in the delegate.
+
+  // We get the last known state instead of waiting.
+  PhysicalStatus status;
+  ASSERT_TRUE(motor_ops.GetPhysicalStatus(&status));
+  EXPECT_EQ(42, status.pos_steps[0]);
+  MotionQueueStats stats;
+  ASSERT_TRUE(motor_ops.GetQueueStats(&stats));
+  EXPECT_EQ(0u, stats.segments);
+
+  delegate.release_ = true;
+  motor_ops.WaitQueueEmpty();
+  ASSERT_TRUE(motor_ops.GetQueueStats(&stats));
+  EXPECT_EQ(1u, stats.segments);
+}
+
+int main(int argc, char *argv[]) {
+  Log_init("/dev/stderr");
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
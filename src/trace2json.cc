@@ -0,0 +1,86 @@
+/* -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+ * (c) 2016 Henner Zeller <h.zeller@acm.org>
+ *
+ * This file is part of BeagleG. http://github.com/hzeller/beagleg
+ *
+ * BeagleG is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BeagleG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BeagleG.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Convert a trace written with machine-control --trace into the Chrome
+// trace event format, to look at in chrome://tracing or
+// https://ui.perfetto.dev
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/logging.h"
+#include "common/trace.h"
+
+static int usage(const char *prog) {
+  fprintf(stderr, "Usage: %s <trace-file> [<json-file>]\n"
+          "Converts the binary <trace-file> into Chrome trace format,\n"
+          "written to <json-file> or stdout.\n", prog);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) return usage(argv[0]);
+  Log_init("/dev/stderr");
+
+  std::vector<TraceThread> threads;
+  if (!Trace_read(argv[1], &threads))
+    return 1;
+
+  FILE *out = (argc == 3) ? fopen(argv[2], "w") : stdout;
+  if (!out) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  // Timestamps relative to the first event, in microseconds.
+  uint64_t start_ns = UINT64_MAX;
+  for (const TraceThread &t : threads) {
+    if (!t.records.empty() && t.records[0].time_ns < start_ns)
+      start_ns = t.records[0].time_ns;
+  }
+
+  static const char phase_names[] = { 'B', 'E', 'i' };
+  fprintf(out, "{\"traceEvents\":[\n");
+  const char *separator = "";
+  for (const TraceThread &t : threads) {
+    int depth = 0;  // The oldest events might be ENDs of overwritten BEGINs.
+    for (const TraceRecord &r : t.records) {
+      if (r.phase >= sizeof(phase_names)) continue;
+      if (r.phase == (uint8_t)TracePhase::BEGIN) ++depth;
+      if (r.phase == (uint8_t)TracePhase::END && depth-- == 0) {
+        depth = 0;
+        continue;
+      }
+      fprintf(out, "%s{\"name\":\"%s\", \"ph\":\"%c\", \"ts\":%.3f, "
+              "\"pid\":1, \"tid\":%d", separator, Trace_event_name(r.event),
+              phase_names[r.phase], (r.time_ns - start_ns) / 1000.0, t.tid);
+      if (r.phase == (uint8_t)TracePhase::INSTANT)
+        fprintf(out, ", \"s\":\"t\"");
+      if (r.phase != (uint8_t)TracePhase::END)
+        fprintf(out, ", \"args\":{\"arg\":%u}", r.arg);
+      fprintf(out, "}");
+      separator = ",\n";
+    }
+  }
+  fprintf(out, "\n]}\n");
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -27,15 +27,25 @@
 #include <errno.h>
 #include <pruss_intc_mapping.h>
 #include <prussdrv.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <strings.h>
 #include <string.h>
 
 #include "common/logging.h"
 
+#include "motor-interface-constants.h"
+
 // Generated PRU code from motor-interface-pru.p
 #include "motor-interface-pru_bin.h"
 
+#ifdef DUAL_PRU
+// ... and for the other PRU from motor-interface-pru1.p. Same array name.
+namespace pru1 {
+#include "motor-interface-pru1_bin.h"
+}
+#endif
+
 // Target PRU
 #define PRU_NUM 0
 
@@ -49,7 +59,12 @@
 #  define PRU_ARM_INTERRUPT PRU1_ARM_INTERRUPT
 #endif
 
+#if defined(DUAL_PRU) && PRU_NUM != 0
+#  error "In dual PRU mode, PRU1 expects the queue in the data RAM of PRU0"
+#endif
+
 bool UioPrussInterface::Init() {
+  if (initialized_) return true;
   tpruss_intc_initdata pruss_intc_initdata = PRUSS_INTC_INITDATA;
   prussdrv_init();
 
@@ -60,6 +75,18 @@ bool UioPrussInterface::Init() {
     return false;
   }
   prussdrv_pruintc_init(&pruss_intc_initdata);
+
+  // Might still run if a previous instance didn't shut down. Loading the
+  // firmware now leaves StartExecution() only to enable it, once the queue
+  // is cleared.
+  prussdrv_pru_disable(PRU_NUM);
+#ifdef DUAL_PRU
+  prussdrv_pru_disable(1);
+  prussdrv_pru_write_memory(PRUSS0_PRU1_IRAM, 0,
+                            pru1::PRUcode, sizeof(pru1::PRUcode));
+#endif
+  prussdrv_pru_write_memory(PRU_INSTRUCTIONRAM, 0, PRUcode, sizeof(PRUcode));
+  initialized_ = true;
   return true;
 }
 
@@ -74,7 +101,17 @@ bool UioPrussInterface::AllocateSharedMem(void **pru_mmap, const size_t size) {
 }
 
 bool UioPrussInterface::StartExecution() {
-  prussdrv_pru_write_memory(PRU_INSTRUCTIONRAM, 0, PRUcode, sizeof(PRUcode));
+#ifdef DUAL_PRU
+  // The delay calculating PRU first; it waits for the queue to fill.
+  void *shared_ram = NULL;
+  prussdrv_map_prumem(PRUSS0_SHARED_DATARAM, &shared_ram);
+  if (shared_ram == NULL) {
+    Log_error("Couldn't map PRU shared memory.\n");
+    return false;
+  }
+  bzero(shared_ram, DELAY_FIFO_OFFSET + DELAY_FIFO_LEN * sizeof(uint32_t));
+  prussdrv_pru_enable(1);
+#endif
   prussdrv_pru_enable(PRU_NUM);
   return true;
 }
@@ -85,8 +122,16 @@ unsigned UioPrussInterface::WaitEvent() {
   return num_events;
 }
 
+int UioPrussInterface::EventFd() {
+  return prussdrv_pru_event_fd(PRU_EVTOUT_0);
+}
+
 bool UioPrussInterface::Shutdown() {
   prussdrv_pru_disable(PRU_NUM);
+#ifdef DUAL_PRU
+  prussdrv_pru_disable(1);
+#endif
   prussdrv_exit();
+  initialized_ = false;
   return true;
 }